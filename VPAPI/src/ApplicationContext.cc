@@ -272,6 +272,10 @@ bool ApplicationContext::extractModelNameFromFileName(const std::string &path, s
 
 ITexture *ApplicationContext::uploadTextureOpaque(const uint8 *data, vsize size, const std::string &key, int flags, ModelContext *context)
 {
+    /* the texture is already decoded concurrently by ModelContext#prefetchTextures */
+    if (context->isTexturePrefetched(key)) {
+        return context->createTextureFromMemory(data, size, key, flags);
+    }
     QImage image;
     image.loadFromData(data, size);
     ITexture *texturePtr = uploadTextureQt(image, key, flags, context);
@@ -283,6 +287,9 @@ ITexture *ApplicationContext::uploadTextureOpaque(const uint8 *data, vsize size,
 
 ITexture *ApplicationContext::uploadTextureOpaque(const std::string &path, int flags, ModelContext *context)
 {
+    if (context->isTexturePrefetched(path)) {
+        return context->createTextureFromFile(path, flags);
+    }
     QImage image;
     image.load(QString::fromStdString(path));
     ITexture *texturePtr = uploadTextureQt(image, path, flags, context);
@@ -338,6 +345,8 @@ void ApplicationContext::uploadEnqueuedModelProxies(ProjectProxy *projectProxy,
         engine->setUpdateOptions(IRenderEngine::kParallelUpdate);
         IEffect *effectRef = 0;
         engine->setEffect(effectRef, IEffect::kAutoDetection, &context);
+        /* decodes all textures of the model concurrently before uploading them */
+        context.prefetchTextures(modelRef, false);
         if (engine->upload(&context)) {
             parseOffscreenSemantic(effectRef, &dir);
             modelRef->setEdgeWidth(1.0f);
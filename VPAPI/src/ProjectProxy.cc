@@ -36,6 +36,7 @@
 */
 
 #include <vpvl2/vpvl2.h>
+#include <vpvl2/asset/Model.h>
 #include <vpvl2/extensions/Pose.h>
 #include <vpvl2/extensions/World.h>
 #include <vpvl2/extensions/XMLProject.h>
@@ -125,25 +126,34 @@ public:
 
     bool load(QScopedPointer<IModel> &model, QString &errorString) {
         QFile file(m_fileUrl.toLocalFile());
+        const QFileInfo fileInfo(file);
+        const QString &cachePath = assetCachePath(fileInfo);
         bool ok = false;
-        if (file.open(QFile::ReadOnly)) {
+        if (loadAssetCache(cachePath, fileInfo, model)) {
+            ok = true;
+        }
+        else if (file.open(QFile::ReadOnly)) {
             const QByteArray &bytes = file.readAll();
             const uint8_t *ptr = reinterpret_cast<const uint8_t *>(bytes.constData());
             model.reset(m_factoryRef->createModel(ptr, file.size(), ok));
-            if (ok) {
-                /* set filename of the model if the name of the model is null such as asset */
-                if (!model->name(IEncoding::kDefaultLanguage)) {
-                    const qt::String s(QFileInfo(file.fileName()).fileName());
-                    model->setName(&s, IEncoding::kDefaultLanguage);
-                }
-            }
-            else {
-                errorString = QStringLiteral("errno=%1").arg(model->error());
-                model.reset();
+            if (ok && model->type() == IModel::kAssetModel) {
+                saveAssetCache(cachePath, model.data());
             }
         }
         else {
             errorString = file.errorString();
+            return ok;
+        }
+        if (ok) {
+            /* set filename of the model if the name of the model is null such as asset */
+            if (!model->name(IEncoding::kDefaultLanguage)) {
+                const qt::String s(fileInfo.fileName());
+                model->setName(&s, IEncoding::kDefaultLanguage);
+            }
+        }
+        else {
+            errorString = QStringLiteral("errno=%1").arg(model->error());
+            model.reset();
         }
         return ok;
     }
@@ -152,6 +162,45 @@ signals:
     void modelDidLoad(IModel *model, QUrl fileUrl, bool skipConfirm, QString errorString);
 
 private:
+    static QString assetCachePath(const QFileInfo &fileInfo) {
+        const QByteArray &hash = QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(), QCryptographicHash::Sha1);
+        const QString &directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        return QDir(directory).filePath(QStringLiteral("assets/%1.vpvl2asset").arg(QString::fromLatin1(hash.toHex())));
+    }
+    bool loadAssetCache(const QString &cachePath, const QFileInfo &fileInfo, QScopedPointer<IModel> &model) const {
+        /* the cache is only used while it is newer than the source asset, otherwise falls back to Assimp */
+        const QFileInfo cacheInfo(cachePath);
+        if (!cacheInfo.exists() || cacheInfo.lastModified() < fileInfo.lastModified()) {
+            return false;
+        }
+        QFile cache(cachePath);
+        if (cache.open(QFile::ReadOnly)) {
+            if (uchar *ptr = cache.map(0, cache.size())) {
+                bool ok = false;
+                if (asset::Model::isCacheData(ptr, cache.size())) {
+                    model.reset(m_factoryRef->createModel(ptr, cache.size(), ok));
+                }
+                cache.unmap(ptr);
+                if (ok) {
+                    VPVL2_VLOG(1, "Loaded an asset from the cache: " << cachePath.toStdString());
+                    return true;
+                }
+            }
+        }
+        model.reset();
+        return false;
+    }
+    static void saveAssetCache(const QString &cachePath, const IModel *model) {
+        QByteArray bytes(int(model->estimateSize()), 0);
+        vsize written = 0;
+        model->save(reinterpret_cast<uint8 *>(bytes.data()), written);
+        QDir().mkpath(QFileInfo(cachePath).absolutePath());
+        QSaveFile cache(cachePath);
+        if (written > 0 && cache.open(QFile::WriteOnly)) {
+            cache.write(bytes.constData(), written);
+            cache.commit();
+        }
+    }
     void run() {
         QScopedPointer<IModel> model;
         QString errorString;
@@ -40,10 +40,12 @@
 #define ENCODINGTASK_H_
 
 #include <QDir>
+#include <QList>
 #include <QObject>
 #include <QProcess>
 #include <QSize>
 
+class QOpenGLBuffer;
 class QOpenGLFramebufferObject;
 class QQuickWindow;
 class QTemporaryDir;
@@ -56,19 +58,29 @@ public:
     EncodingTask(QObject *parent = 0);
     ~EncodingTask();
 
+    static const int kMaxFramesInFlight = 3;
+    static const int kMaxQueuedFrames = 8;
+
     bool isRunning() const;
+    bool isStreaming() const;
     void setSize(const QSize &value);
     void setTitle(const QString &value);
     void setInputImageFormat(const QString &value);
     void setOutputPath(const QString &value);
     void setOutputFormat(const QString &value);
     void setEstimatedFrameCount(const qint64 value);
+    void setFrameRate(const qreal &value);
+    void setStreamingEnabled(bool value);
 
     void reset();
     QOpenGLFramebufferObject *generateFramebufferObject(QQuickWindow *win);
     QString generateFilename(const qreal &timeIndex);
+    void enqueueFrame(QOpenGLFramebufferObject *fbo);
+    void finishStreaming();
+    void releasePixelBuffers();
 
     void stop();
+    void cancel();
     void release();
 
 public slots:
@@ -76,6 +88,7 @@ public slots:
     void handleReadyRead();
     void handleStateChanged();
     void handleError(QProcess::ProcessError error);
+    void handleStreamFinished(bool isNormalExit);
     void launch();
 
 signals:
@@ -84,10 +97,19 @@ signals:
     void encodeDidFinish(bool isNormalExit);
 
 private:
+    class FrameQueue;
+    class StreamWriter;
+
     void getArguments(QStringList &arguments);
+    void getStreamingArguments(QStringList &arguments);
+    void retireFrame();
 
     QScopedPointer<QProcess> m_process;
     QScopedPointer<QOpenGLFramebufferObject> m_fbo;
+    QScopedPointer<QOpenGLFramebufferObject> m_resolveFbo;
+    QScopedPointer<FrameQueue> m_frameQueue;
+    QScopedPointer<StreamWriter> m_streamWriter;
+    QList<QOpenGLBuffer *> m_pixelBuffers;
     QScopedPointer<QTemporaryDir> m_workerDir;
     QProcess::ProcessState m_lastState;
     QDir m_workerDirPath;
@@ -101,6 +123,11 @@ private:
     QString m_outputFormat;
     QString m_pixelFormat;
     quint64 m_estimatedFrameCount;
+    quint64 m_nrequestedFrames;
+    quint64 m_nretiredFrames;
+    qreal m_frameRate;
+    bool m_streaming;
+    bool m_cancelled;
 };
 
 #endif
@@ -231,6 +231,7 @@ private slots:
     void drawOffscreenForVideo();
     void writeExportedImage();
     void launchEncodingTask();
+    void releaseEncodingResources();
     void prepareSyncMotionState();
     void prepareUpdatingLight();
     void synchronizeExplicitly();
@@ -133,6 +133,7 @@ Tab {
                             ListModel {
                                 id: frameImageTypeModel
                                 ListElement { text: "BMP"; value: "bmp" }
+                                ListElement { text: "Raw (Streaming)"; value: "rawvideo" }
                                 ListElement { text: "PNG"; value: "png" }
                             }
                             ComboBox {
@@ -39,15 +39,183 @@
 #include "EncodingTask.h"
 
 #include <QtCore>
+#include <QOpenGLBuffer>
+#include <QOpenGLFramebufferObject>
 #include <QQuickWindow>
 #include <vpvl2/vpvl2.h>
 
 using namespace vpvl2;
 
+namespace {
+
+static bool ParseProgress(const QByteArray &output, quint64 &proceeded)
+{
+    /* QRegExp keeps capture state, so it must not be shared between the GUI and writer threads */
+    QRegExp regexp("^frame\\s*=\\s*(\\d+)");
+    if (regexp.indexIn(output) >= 0) {
+        proceeded = regexp.cap(1).toLongLong();
+        return true;
+    }
+    return false;
+}
+
+}
+
+/* bounded FIFO of raw frames between the render thread (producer) and StreamWriter (consumer) */
+class EncodingTask::FrameQueue {
+public:
+    FrameQueue(int capacity)
+        : m_capacity(capacity),
+          m_closed(false),
+          m_aborted(false)
+    {
+    }
+    ~FrameQueue() {
+    }
+
+    bool enqueue(const QByteArray &frame) {
+        QMutexLocker locker(&m_mutex); Q_UNUSED(locker);
+        while (m_frames.size() >= m_capacity && !m_aborted) {
+            m_notFull.wait(&m_mutex);
+        }
+        if (m_aborted || m_closed) {
+            return false;
+        }
+        m_frames.enqueue(frame);
+        m_notEmpty.wakeOne();
+        return true;
+    }
+    bool dequeue(QByteArray &frame) {
+        QMutexLocker locker(&m_mutex); Q_UNUSED(locker);
+        while (m_frames.isEmpty() && !m_closed && !m_aborted) {
+            m_notEmpty.wait(&m_mutex);
+        }
+        if (m_aborted || m_frames.isEmpty()) {
+            return false;
+        }
+        frame = m_frames.dequeue();
+        m_notFull.wakeOne();
+        return true;
+    }
+    void close() {
+        QMutexLocker locker(&m_mutex); Q_UNUSED(locker);
+        m_closed = true;
+        m_notEmpty.wakeAll();
+    }
+    void abort() {
+        QMutexLocker locker(&m_mutex); Q_UNUSED(locker);
+        m_aborted = true;
+        m_frames.clear();
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+    bool isAborted() const {
+        QMutexLocker locker(&m_mutex); Q_UNUSED(locker);
+        return m_aborted;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<QByteArray> m_frames;
+    const int m_capacity;
+    bool m_closed;
+    bool m_aborted;
+};
+
+/* owns the encoder process and feeds raw frames of FrameQueue into its standard input */
+class EncodingTask::StreamWriter : public QThread {
+public:
+    StreamWriter(EncodingTask *task, FrameQueue *queue, const QString &program, const QStringList &arguments)
+        : m_taskRef(task),
+          m_queueRef(queue),
+          m_program(program),
+          m_arguments(arguments),
+          m_estimatedFrameCount(int(task->m_estimatedFrameCount))
+    {
+    }
+    ~StreamWriter() {
+    }
+
+    void setEstimatedFrameCount(quint64 value) {
+        m_estimatedFrameCount.store(int(value));
+    }
+
+protected:
+    void run() {
+        QProcess process;
+        process.setProgram(m_program);
+        process.setArguments(m_arguments);
+        process.setProcessChannelMode(QProcess::MergedChannels);
+        /* disable color output from standard output */
+        QStringList environments = process.environment();
+        environments << "AV_LOG_FORCE_NOCOLOR" << "1";
+        process.setEnvironment(environments);
+        process.start();
+        if (!process.waitForStarted(-1)) {
+            VPVL2_LOG(ERROR, "Cannot start encoder: message=" << process.errorString().toStdString());
+            m_queueRef->abort();
+            finish(false);
+            return;
+        }
+        QMetaObject::invokeMethod(m_taskRef, "handleStarted", Qt::QueuedConnection);
+        QByteArray frame;
+        bool ok = true;
+        while (ok && m_queueRef->dequeue(frame)) {
+            process.write(frame);
+            while (ok && process.bytesToWrite() > 0) {
+                ok = process.waitForBytesWritten(-1);
+            }
+            readOutput(process);
+        }
+        if (m_queueRef->isAborted() || !ok) {
+            /* wakes the render thread up if it is blocked by the full queue */
+            m_queueRef->abort();
+            process.kill();
+            process.waitForFinished(5000);
+            finish(false);
+            return;
+        }
+        process.closeWriteChannel();
+        process.waitForFinished(-1);
+        readOutput(process);
+        VPVL2_VLOG(1, "Finished streaming encoding task: code=" << process.exitCode() << " status=" << process.exitStatus());
+        finish(process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0);
+    }
+
+private:
+    void readOutput(QProcess &process) {
+        const QByteArray &output = process.readAll();
+        quint64 proceeded = 0;
+        if (!output.isEmpty()) {
+            VPVL2_VLOG(2, output.constData());
+            if (ParseProgress(output, proceeded)) {
+                QMetaObject::invokeMethod(m_taskRef, "encodeDidProceed", Qt::QueuedConnection,
+                                          Q_ARG(quint64, proceeded), Q_ARG(quint64, quint64(m_estimatedFrameCount.load())));
+            }
+        }
+    }
+    void finish(bool isNormalExit) {
+        QMetaObject::invokeMethod(m_taskRef, "handleStreamFinished", Qt::QueuedConnection, Q_ARG(bool, isNormalExit));
+    }
+
+    EncodingTask *m_taskRef;
+    FrameQueue *m_queueRef;
+    const QString m_program;
+    const QStringList m_arguments;
+    QAtomicInt m_estimatedFrameCount;
+};
+
 EncodingTask::EncodingTask(QObject *parent)
     : QObject(parent),
       m_lastState(QProcess::NotRunning),
-      m_estimatedFrameCount(0)
+      m_estimatedFrameCount(0),
+      m_nrequestedFrames(0),
+      m_nretiredFrames(0),
+      m_frameRate(Scene::defaultFPS()),
+      m_streaming(false),
+      m_cancelled(false)
 {
 }
 
@@ -58,9 +226,17 @@ EncodingTask::~EncodingTask()
 
 bool EncodingTask::isRunning() const
 {
+    if (m_streamWriter) {
+        return m_streamWriter->isRunning();
+    }
     return m_process && m_process->state() == QProcess::Running;
 }
 
+bool EncodingTask::isStreaming() const
+{
+    return m_streaming;
+}
+
 void EncodingTask::setSize(const QSize &value)
 {
     m_size = value;
@@ -95,6 +271,21 @@ void EncodingTask::setOutputFormat(const QString &value)
 void EncodingTask::setEstimatedFrameCount(const qint64 value)
 {
     m_estimatedFrameCount = value;
+    if (m_streamWriter) {
+        m_streamWriter->setEstimatedFrameCount(value);
+    }
+}
+
+void EncodingTask::setFrameRate(const qreal &value)
+{
+    if (value > 0) {
+        m_frameRate = value;
+    }
+}
+
+void EncodingTask::setStreamingEnabled(bool value)
+{
+    m_streaming = value;
 }
 
 void EncodingTask::reset()
@@ -106,6 +297,11 @@ void EncodingTask::reset()
     m_outputFormat = "png";
     m_pixelFormat = "rgb24";
     m_fbo.reset();
+    m_resolveFbo.reset();
+    m_nrequestedFrames = m_nretiredFrames = 0;
+    m_frameRate = Scene::defaultFPS();
+    m_streaming = false;
+    m_cancelled = false;
 }
 
 QOpenGLFramebufferObject *EncodingTask::generateFramebufferObject(QQuickWindow *win)
@@ -128,8 +324,105 @@ QString EncodingTask::generateFilename(const qreal &timeIndex)
     return path;
 }
 
+void EncodingTask::enqueueFrame(QOpenGLFramebufferObject *fbo)
+{
+    Q_ASSERT(m_streaming);
+    if (!m_frameQueue) {
+        return;
+    }
+    QOpenGLFramebufferObject *target = fbo;
+    if (fbo->format().samples() > 0) {
+        /* glReadPixels cannot read multisampled framebuffer directly */
+        if (!m_resolveFbo) {
+            m_resolveFbo.reset(new QOpenGLFramebufferObject(fbo->size()));
+        }
+        QOpenGLFramebufferObject::blitFramebuffer(m_resolveFbo.data(), fbo);
+        target = m_resolveFbo.data();
+    }
+    const int size = m_size.width() * m_size.height() * 4;
+    if (m_pixelBuffers.isEmpty()) {
+        for (int i = 0; i < kMaxFramesInFlight; i++) {
+            QScopedPointer<QOpenGLBuffer> buffer(new QOpenGLBuffer(QOpenGLBuffer::PixelPackBuffer));
+            if (!buffer->create()) {
+                break;
+            }
+            buffer->setUsagePattern(QOpenGLBuffer::StreamRead);
+            buffer->bind();
+            buffer->allocate(size);
+            buffer->release();
+            m_pixelBuffers.append(buffer.take());
+        }
+        if (m_pixelBuffers.size() < kMaxFramesInFlight) {
+            VPVL2_LOG(WARNING, "Cannot create pixel buffer objects, fallback to synchronous readback");
+            releasePixelBuffers();
+        }
+    }
+    target->bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (!m_pixelBuffers.isEmpty()) {
+        /* readback is queued into the ring and retired a few frames later so the GPU is not stalled */
+        QOpenGLBuffer *buffer = m_pixelBuffers.at(m_nrequestedFrames % m_pixelBuffers.size());
+        buffer->bind();
+        glReadPixels(0, 0, m_size.width(), m_size.height(), GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        buffer->release();
+        m_nrequestedFrames++;
+        if (m_nrequestedFrames - m_nretiredFrames >= quint64(m_pixelBuffers.size())) {
+            retireFrame();
+        }
+    }
+    else {
+        QByteArray frame(size, Qt::Uninitialized);
+        glReadPixels(0, 0, m_size.width(), m_size.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+        m_frameQueue->enqueue(frame);
+    }
+    target->release();
+}
+
+void EncodingTask::finishStreaming()
+{
+    Q_ASSERT(m_streaming);
+    while (m_frameQueue && m_nretiredFrames < m_nrequestedFrames) {
+        retireFrame();
+    }
+    releasePixelBuffers();
+    if (m_frameQueue) {
+        m_frameQueue->close();
+    }
+}
+
+void EncodingTask::releasePixelBuffers()
+{
+    qDeleteAll(m_pixelBuffers);
+    m_pixelBuffers.clear();
+    m_resolveFbo.reset();
+}
+
+void EncodingTask::retireFrame()
+{
+    QOpenGLBuffer *buffer = m_pixelBuffers.at(m_nretiredFrames % m_pixelBuffers.size());
+    buffer->bind();
+    const int size = buffer->size();
+    if (const void *address = buffer->map(QOpenGLBuffer::ReadOnly)) {
+        /* blocks when the encoder is behind and the queue is full */
+        m_frameQueue->enqueue(QByteArray(static_cast<const char *>(address), size));
+        buffer->unmap();
+    }
+    else {
+        VPVL2_LOG(WARNING, "Cannot map pixel buffer object: frame=" << m_nretiredFrames);
+    }
+    buffer->release();
+    m_nretiredFrames++;
+}
+
 void EncodingTask::stop()
 {
+    if (m_streamWriter) {
+        if (m_frameQueue) {
+            m_frameQueue->abort();
+        }
+        m_streamWriter->wait();
+        return;
+    }
     if (isRunning()) {
         m_process->kill();
         VPVL2_LOG(INFO, "Tried killing encode process " << m_process->pid());
@@ -145,10 +438,19 @@ void EncodingTask::stop()
     }
 }
 
+void EncodingTask::cancel()
+{
+    /* the caller notifies the cancellation, so stopping must not report encodeDidFinish again */
+    m_cancelled = true;
+    stop();
+}
+
 void EncodingTask::release()
 {
     QFile::remove(m_encoderFilePath);
     m_process.reset();
+    m_streamWriter.reset();
+    m_frameQueue.reset();
     m_workerDir.reset();
     m_fbo.reset();
     m_estimatedFrameCount = 0;
@@ -162,11 +464,10 @@ void EncodingTask::handleStarted()
 
 void EncodingTask::handleReadyRead()
 {
-    static const QRegExp regexp("^frame\\s*=\\s*(\\d+)");
     const QByteArray &output = m_process->readAll();
+    quint64 proceeded = 0;
     VPVL2_VLOG(2, output.constData());
-    if (regexp.indexIn(output) >= 0) {
-        quint64 proceeded = regexp.cap(1).toLongLong();
+    if (ParseProgress(output, proceeded)) {
         emit encodeDidProceed(proceeded, m_estimatedFrameCount);
     }
 }
@@ -184,7 +485,9 @@ void EncodingTask::handleStateChanged()
             QFile::remove(m_encoderFilePath);
             m_workerDir.reset();
             m_estimatedFrameCount = 0;
-            emit encodeDidFinish(status == QProcess::NormalExit);
+            if (!m_cancelled) {
+                emit encodeDidFinish(status == QProcess::NormalExit);
+            }
         }
     }
     m_lastState = state;
@@ -194,12 +497,30 @@ void EncodingTask::handleError(QProcess::ProcessError error)
 {
     QFile::remove(m_encoderFilePath);
     VPVL2_LOG(ERROR, "Error happened at encoding: error=" << error << " message=" << m_process->errorString().toStdString());
-    emit encodeDidFinish(false);
+    if (!m_cancelled) {
+        emit encodeDidFinish(false);
+    }
+}
+
+void EncodingTask::handleStreamFinished(bool isNormalExit)
+{
+    if (m_streamWriter) {
+        m_streamWriter->wait();
+    }
+    QFile::remove(m_encoderFilePath);
+    m_workerDir.reset();
+    m_estimatedFrameCount = 0;
+    if (!m_cancelled) {
+        emit encodeDidFinish(isNormalExit);
+    }
 }
 
 void EncodingTask::launch()
 {
     stop();
+    m_cancelled = false;
+    m_streamWriter.reset();
+    m_frameQueue.reset();
     QStringList arguments;
     QScopedPointer<QTemporaryFile> file(new QTemporaryFile());
     file->open();
@@ -207,6 +528,15 @@ void EncodingTask::launch()
     file.reset();
     if (QFile::copy(":libav/avconv", m_encoderFilePath)) {
         QFile::setPermissions(m_encoderFilePath, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+        if (m_streaming) {
+            /* frames are fed by enqueueFrame while rendering, so no intermediate image is written */
+            getStreamingArguments(arguments);
+            m_frameQueue.reset(new FrameQueue(kMaxQueuedFrames));
+            m_streamWriter.reset(new StreamWriter(this, m_frameQueue.data(), m_encoderFilePath, arguments));
+            m_streamWriter->start();
+            VPVL2_VLOG(1, "executable=" << m_encoderFilePath.toStdString() << " arguments=" << arguments.join(" ").toStdString());
+            return;
+        }
         getArguments(arguments);
         m_process.reset(new QProcess(this));
         m_process->setArguments(arguments);
@@ -238,7 +568,7 @@ void EncodingTask::getArguments(QStringList &arguments)
     arguments.append("debug");
 #endif
     arguments.append("-r");
-    arguments.append(QStringLiteral("%1").arg(30));
+    arguments.append(QString::number(m_frameRate));
     arguments.append("-s");
     arguments.append(QStringLiteral("%1x%2").arg(m_size.width()).arg(m_size.height()));
     arguments.append("-qscale");
@@ -258,3 +588,34 @@ void EncodingTask::getArguments(QStringList &arguments)
     arguments.append("-y");
     arguments.append(m_outputPath);
 }
+
+void EncodingTask::getStreamingArguments(QStringList &arguments)
+{
+#ifndef QT_NO_DEBUG
+    arguments.append("-v");
+    arguments.append("debug");
+#endif
+    arguments.append("-f");
+    arguments.append("rawvideo");
+    arguments.append("-pix_fmt");
+    arguments.append("rgba");
+    arguments.append("-s");
+    arguments.append(QStringLiteral("%1x%2").arg(m_size.width()).arg(m_size.height()));
+    arguments.append("-r");
+    arguments.append(QString::number(m_frameRate));
+    arguments.append("-i");
+    arguments.append("-");
+    /* rows of glReadPixels are bottom-up */
+    arguments.append("-vf");
+    arguments.append("vflip");
+    arguments.append("-metadata");
+    arguments.append(QStringLiteral("title=\"%1\"").arg(m_title));
+    arguments.append("-map");
+    arguments.append("0");
+    arguments.append("-c:v");
+    arguments.append(m_outputFormat);
+    arguments.append("-pix_fmt:v");
+    arguments.append(m_pixelFormat);
+    arguments.append("-y");
+    arguments.append(m_outputPath);
+}
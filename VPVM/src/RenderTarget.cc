@@ -807,6 +807,13 @@ void RenderTarget::exportVideo(const QUrl &fileUrl, const QSize &size, const QSt
     encodingTaskRef->setInputImageFormat(frameImageType);
     encodingTaskRef->setOutputFormat(videoType);
     encodingTaskRef->setOutputPath(fileUrl.toLocalFile());
+    encodingTaskRef->setFrameRate(m_projectProxyRef->globalSetting("video.fps", QVariant(Scene::defaultFPS())).toReal());
+    /* "rawvideo" pipes frames to the encoder while rendering instead of writing an image sequence */
+    if (frameImageType == QStringLiteral("rawvideo")) {
+        encodingTaskRef->setStreamingEnabled(true);
+        encodingTaskRef->setEstimatedFrameCount(qRound64(m_projectProxyRef->durationTimeIndex() - m_currentTimeIndex));
+        encodingTaskRef->launch();
+    }
     setPlaying(true);
     connect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::drawOffscreenForVideo, Qt::DirectConnection);
 }
@@ -817,10 +824,14 @@ void RenderTarget::cancelExportingVideo()
     disconnect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::drawOffscreenForVideo);
     disconnect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::launchEncodingTask);
     if (m_encodingTask && m_encodingTask->isRunning()) {
-        m_encodingTask->stop();
+        m_encodingTask->cancel();
         setPlaying(false);
         emit encodeDidCancel();
     }
+    if (m_encodingTask && m_encodingTask->isStreaming()) {
+        /* pixel buffer objects must be released on the render thread */
+        connect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::releaseEncodingResources, Qt::DirectConnection);
+    }
 }
 
 void RenderTarget::loadJson(const QUrl &fileUrl)
@@ -1088,7 +1099,21 @@ void RenderTarget::drawOffscreenForVideo()
         encodingTaskRef->setEstimatedFrameCount(m_currentTimeIndex);
         setPlaying(false);
         disconnect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::drawOffscreenForVideo);
-        connect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::launchEncodingTask);
+        if (encodingTaskRef->isStreaming()) {
+            encodingTaskRef->finishStreaming();
+            m_exportSize = QSize();
+        }
+        else {
+            connect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::launchEncodingTask);
+        }
+    }
+    else if (encodingTaskRef->isStreaming()) {
+        /* queues readback of this frame, the frame is handed to the encoder a few frames later */
+        const qreal &currentTimeIndex = m_currentTimeIndex;
+        encodingTaskRef->enqueueFrame(fbo);
+        setCurrentTimeIndex(currentTimeIndex + 1);
+        m_projectProxyRef->update(Scene::kUpdateAll);
+        emit videoFrameDidSave(currentTimeIndex, m_projectProxyRef->durationTimeIndex());
     }
     else {
         const qreal &currentTimeIndex = m_currentTimeIndex;
@@ -1150,6 +1175,15 @@ void RenderTarget::launchEncodingTask()
     m_exportSize = QSize();
 }
 
+void RenderTarget::releaseEncodingResources()
+{
+    Q_ASSERT(window());
+    Q_ASSERT(window()->thread() == thread());
+    disconnect(window(), &QQuickWindow::frameSwapped, this, &RenderTarget::releaseEncodingResources);
+    encodingTask()->releasePixelBuffers();
+    m_exportSize = QSize();
+}
+
 void RenderTarget::prepareSyncMotionState()
 {
     Q_ASSERT(window());
@@ -170,6 +170,11 @@ endfunction()
 function(vpvl2_link_icu target)
   if(NOT VPVL2_ENABLE_LAZY_LINK AND VPVL2_ENABLE_EXTENSIONS_STRING)
     target_link_libraries(${target} ${ICU_LIBRARY_I18N} ${ICU_LIBRARY_UC} ${ICU_LIBRARY_DATA})
+    # the string interner locks with pthread unless Intel TBB is linked
+    if(NOT VPVL2_LINK_INTEL_TBB AND NOT WIN32)
+      find_package(Threads)
+      target_link_libraries(${target} ${CMAKE_THREAD_LIBS_INIT})
+    endif()
   endif()
 endfunction()
 
@@ -509,6 +514,14 @@ function(vpvl2_add_qt)
       file(GLOB vpvl2_unit_tests_sources "${CMAKE_CURRENT_SOURCE_DIR}/test/*.cc")
       file(GLOB vpvl2_unit_tests_pmd_sources "${CMAKE_CURRENT_SOURCE_DIR}/test/pmd/*.cc")
       file(GLOB vpvl2_unit_tests_pmx_sources "${CMAKE_CURRENT_SOURCE_DIR}/test/pmx/*.cc")
+      if(NOT VPVL2_ENABLE_EXTENSIONS_WORLD)
+        list(REMOVE_ITEM vpvl2_unit_tests_sources "${CMAKE_CURRENT_SOURCE_DIR}/test/PlaybackSchedulerTest.cc")
+      endif()
+      if(NOT VPVL2_ENABLE_EXTENSIONS_APPLICATIONCONTEXT)
+        list(REMOVE_ITEM vpvl2_unit_tests_sources "${CMAKE_CURRENT_SOURCE_DIR}/test/ProgramBinaryCacheTest.cc"
+                                                  "${CMAKE_CURRENT_SOURCE_DIR}/test/TextureCacheTest.cc"
+                                                  "${CMAKE_CURRENT_SOURCE_DIR}/test/TextureDecoderTest.cc")
+      endif()
       source_group("VPVL2 Test Case Classes" FILES ${vpvl2_unit_tests_sources} ${vpvl2_unit_tests_pmd_sources} ${vpvl2_unit_tests_pmx_sources})
       file(GLOB vpvl2_mock_headers "${CMAKE_CURRENT_SOURCE_DIR}/test/mock/*.h")
       source_group("VPVL2 Mock Classes" FILES ${vpvl2_mock_headers})
@@ -531,6 +544,49 @@ function(vpvl2_add_qt)
   endif()
 endfunction()
 
+function(vpvl2_add_benchmarks)
+  if(VPVL2_BUILD_BENCHMARKS AND VPVL2_ENABLE_EXTENSIONS_STRING)
+    set(VPVL2_EXECUTABLE vpvl2_motion_benchmark)
+    add_executable(${VPVL2_EXECUTABLE} "${CMAKE_CURRENT_SOURCE_DIR}/test/benchmark/motion.cc")
+    vpvl2_create_executable(${VPVL2_EXECUTABLE})
+    set(VPVL2_EXECUTABLE vpvl2_model_benchmark)
+    add_executable(${VPVL2_EXECUTABLE} "${CMAKE_CURRENT_SOURCE_DIR}/test/benchmark/model.cc")
+    vpvl2_create_executable(${VPVL2_EXECUTABLE})
+    set(VPVL2_EXECUTABLE vpvl2_skinning_benchmark)
+    add_executable(${VPVL2_EXECUTABLE} "${CMAKE_CURRENT_SOURCE_DIR}/test/benchmark/skinning.cc")
+    vpvl2_create_executable(${VPVL2_EXECUTABLE})
+    if(VPVL2_ENABLE_OPENMP)
+      find_package(OpenMP)
+      if(OPENMP_FOUND)
+        # needs omp_set_num_threads to switch between serial and OpenMP modes
+        set_target_properties(${VPVL2_EXECUTABLE} PROPERTIES COMPILE_FLAGS "${OpenMP_CXX_FLAGS}" LINK_FLAGS "${OpenMP_CXX_FLAGS}")
+      endif()
+    endif()
+    if(VPVL2_ENABLE_EXTENSIONS_APPLICATIONCONTEXT)
+      set(VPVL2_EXECUTABLE vpvl2_texture_benchmark)
+      add_executable(${VPVL2_EXECUTABLE} "${CMAKE_CURRENT_SOURCE_DIR}/test/benchmark/texture.cc")
+      vpvl2_create_executable(${VPVL2_EXECUTABLE})
+    endif()
+  endif()
+endfunction()
+
+function(vpvl2_add_tools)
+  if(VPVL2_BUILD_TOOLS AND VPVL2_ENABLE_EXTENSIONS_STRING)
+    set(VPVL2_EXECUTABLE vpvl2_reduce)
+    add_executable(${VPVL2_EXECUTABLE} "${CMAKE_CURRENT_SOURCE_DIR}/tools/motion/reduce.cc")
+    vpvl2_create_executable(${VPVL2_EXECUTABLE})
+    set(VPVL2_EXECUTABLE vpvl2_convert)
+    add_executable(${VPVL2_EXECUTABLE} "${CMAKE_CURRENT_SOURCE_DIR}/tools/motion/convert.cc")
+    vpvl2_create_executable(${VPVL2_EXECUTABLE})
+    if(VPVL2_ENABLE_OPENMP)
+      find_package(OpenMP)
+      if(OPENMP_FOUND)
+        set_target_properties(${VPVL2_EXECUTABLE} PROPERTIES COMPILE_FLAGS "${OpenMP_CXX_FLAGS}" LINK_FLAGS "${OpenMP_CXX_FLAGS}")
+      endif()
+    endif()
+  endif()
+endfunction()
+
 function(vpvl2_add_sdl_renderer)
   if(VPVL2_LINK_SDL2)
     __get_install_path(SDL_INSTALL_DIR "SDL2-src")
@@ -641,6 +697,19 @@ function(vpvl2_add_egl_renderer)
   endif()
 endfunction()
 
+function(vpvl2_add_batch_renderer)
+  if(VPVL2_LINK_EGL AND VPVL2_ENABLE_EXTENSIONS_PROJECT)
+    find_path(EGL_INCLUDE_DIR NAMES EGL/egl.h PATHS $ENV{QTSDK_TOOLCHAIN}/include/QtANGLE)
+    find_library(EGL_LIBRARY NAMES EGL libEGL PATHS $ENV{QTSDK_TOOLCHAIN}/lib)
+    set(vpvl2_batch_sources "render/batch/main.cc")
+    set(VPVL2_EXECUTABLE vpvl2_batch)
+    add_executable(${VPVL2_EXECUTABLE} ${vpvl2_batch_sources})
+    target_link_libraries(${VPVL2_EXECUTABLE} ${EGL_LIBRARY})
+    include_directories(${EGL_INCLUDE_DIR})
+    vpvl2_create_executable(${VPVL2_EXECUTABLE})
+  endif()
+endfunction()
+
 function(vpvl2_create_library project_name library_type extra_sources extra_public_headers extra_private_headers)
   file(GLOB sources_core "${CMAKE_CURRENT_SOURCE_DIR}/src/core/*.cc")
   file(GLOB sources_base "${CMAKE_CURRENT_SOURCE_DIR}/src/core/base/*.cc")
@@ -81,6 +81,11 @@ typedef Vector4           Color;
 struct HashString : public btHashString {
     HashString() : btHashString(0) {}
     HashString(const char *value) : btHashString(value) {}
+    /* value must be already hashed as btHashString does and stay on memory while using this */
+    HashString(const char *value, unsigned int hash) : btHashString("") {
+        m_string = value;
+        m_hash = hash;
+    }
 };
 
 static const Vector3 kZeroV3 = Vector3(0, 0, 0);
@@ -186,6 +191,11 @@ public:
         Array<T *>::removeAt(index);
         m_released = Array<T *>::count() == 0;
     }
+    inline void clear() {
+        /* drops references only, the caller must not own items of this array */
+        Array<T *>::clear();
+        m_released = true;
+    }
     inline void releaseAll() {
         Array<T *>::releaseAll();
         m_released = true;
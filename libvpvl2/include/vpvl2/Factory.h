@@ -98,6 +98,24 @@ public:
      */
     IModel *createModel(const uint8 *data, vsize size, bool &ok) const;
 
+    /**
+     * 読み込み済みの Model インスタンスを元に軽量な Model インスタンスを作成します.
+     *
+     * PMX の場合は頂点属性とインデックス及びレンダリングエンジンの静的な頂点バッファとインデックスバッファを共有し、
+     * ポーズ、モーフの重み、剛体と動的な頂点バッファのみをインスタンス毎に持ちます。
+     * ただしボーンと材質の参照及びモーフの差分を持つ頂点オブジェクトは頂点毎に作成されるため、
+     * インスタンス毎のメモリ使用量は頂点数に比例します。
+     * PMX 以外の場合は source を保存したデータから新たに Model インスタンスを作成します。
+     *
+     * 作成に成功した場合第２引数の ok が true に、失敗した場合は false にセットされます。
+     * 失敗した場合は null を返します。
+     *
+     * @param source
+     * @param ok
+     * @return IModel
+     */
+    IModel *createModelInstance(IModel *source, bool &ok) const;
+
     /**
      * 空の Motion インスタンスを返します.
      *
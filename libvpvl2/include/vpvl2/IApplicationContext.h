@@ -123,6 +123,27 @@ public:
         virtual void *resolveSymbol(const char *name) const = 0;
         virtual int query(QueryType type) const = 0;
     };
+    struct ProgramBinaryCache {
+        virtual ~ProgramBinaryCache() {}
+        virtual bool findProgramBinary(const char *key, uint32 &format, Array<uint8> &bytes) = 0;
+        virtual void storeProgramBinary(const char *key, uint32 format, const uint8 *bytes, vsize size) = 0;
+    };
+    struct SharedModelBuffers {
+        SharedModelBuffers()
+            : staticVertexBuffer(0),
+              indexBuffer(0),
+              refCount(0)
+        {
+        }
+        ~SharedModelBuffers() {
+            staticVertexBuffer = 0;
+            indexBuffer = 0;
+            refCount = 0;
+        }
+        uint32 staticVertexBuffer;
+        uint32 indexBuffer;
+        int refCount;
+    };
 
     struct SharedTextureParameter {
         SharedTextureParameter(IEffect::Parameter *parameter = 0)
@@ -352,6 +373,54 @@ public:
     virtual bool tryGetSharedTextureParameter(const char *name, SharedTextureParameter &parameter) const = 0;
 
     virtual FunctionResolver *sharedFunctionResolverInstance() const = 0;
+
+    /**
+     * リンク済みのシェーダプログラムのバイナリを保存するキャッシュを返します.
+     *
+     * キーはシェーダのソースとドライバの文字列から作成されるため、同じソースを持つプログラムは
+     * コンパイルとリンクが省略されます。キャッシュを使わない場合は 0 を返してください。
+     *
+     * @brief sharedProgramBinaryCacheInstance
+     * @return
+     */
+    virtual ProgramBinaryCache *sharedProgramBinaryCacheInstance() const = 0;
+
+    /**
+     * インスタンス化されたモデルの間で共有される静的な頂点バッファとインデックスバッファを返します.
+     *
+     * バッファはこのコンテキストの OpenGL コンテキストに属するため、同じコンテキストを使うレンダリングエンジンの間でのみ
+     * 共有されます。key に対応するバッファが登録されていない場合は 0 を返してください。
+     * デフォルトの実装は常に 0 を返します。
+     *
+     * @brief findSharedModelBuffersRef
+     * @param key
+     * @return
+     */
+    virtual SharedModelBuffers *findSharedModelBuffersRef(const void * /* key */) { return 0; }
+
+    /**
+     * インスタンス化されたモデルの間で共有される静的な頂点バッファとインデックスバッファを登録します.
+     *
+     * バッファの削除はレンダリングエンジン側が行うため、ここではバッファの名前と参照カウントのみを保持します。
+     * 登録したバッファを返してください。デフォルトの実装は何も登録せずに 0 を返すため、
+     * レンダリングエンジンはバッファを共有せずにモデルごとに作成します。
+     *
+     * @brief addSharedModelBuffers
+     * @param key
+     * @param value
+     * @return
+     */
+    virtual SharedModelBuffers *addSharedModelBuffers(const void * /* key */, const SharedModelBuffers & /* value */) { return 0; }
+
+    /**
+     * addSharedModelBuffers で登録したバッファを登録解除します.
+     *
+     * デフォルトの実装は何もしません。
+     *
+     * @brief removeSharedModelBuffers
+     * @param key
+     */
+    virtual void removeSharedModelBuffers(const void * /* key */) {}
 };
 
 } /* namespace VPVL2_VERSION_NS */
@@ -82,6 +82,7 @@ public:
             kUVA3Stride,
             kUVA4Stride,
             kIndexStride,
+            kBonePaletteIndexStride,
             kMaxStrideType
         };
         virtual ~Buffer() {}
@@ -114,8 +115,10 @@ public:
     struct MatrixBuffer {
         virtual ~MatrixBuffer() {}
         virtual void update(void *address) = 0;
-        virtual const float32 *bytes(int materialIndex) const = 0;
-        virtual vsize size(int materialIndex) const = 0;
+        virtual int countSubsets(int materialIndex) const = 0;
+        virtual void getSubsetIndexRange(int materialIndex, int subsetIndex, int &offset, int &count) const = 0;
+        virtual const float32 *bytes(int materialIndex, int subsetIndex) const = 0;
+        virtual vsize size(int materialIndex, int subsetIndex) const = 0;
     };
     /**
       * Type of parsing errors.
@@ -652,6 +655,11 @@ public:
      * IDynamicVertexBuffer と IIndexBuffer は同じ型で取得したインスタンスを渡す必要があります。
      * 条件を満たさない場合は matrixBuffer に 0 が入ります。
      *
+     * 各材質は参照するボーン数がパレットの上限以下になるサブセットに分割されます。
+     * サブセットごとに getSubsetIndexRange のインデックス範囲を描画し、その前に bytes と size で
+     * 得られるパレットのみを転送します。頂点のボーンインデックスは kBonePaletteIndexStride の
+     * 位置にあるパレット内の相対インデックスを使用します。
+     *
      * @brief getMatrixBuffer
      * @param matrixBuffer
      * @param dynamicBuffer
@@ -681,6 +689,27 @@ public:
      */
     virtual void getAabb(Vector3 &min, Vector3 &max) const = 0;
 
+    /**
+     * ボーンの変形から保守的な AABB (Axis Aligned Bounding Box) の最小値と最大値を計算します.
+     *
+     * 頂点のスキニングを行わず、初回呼び出し時にボーンごとに求めた頂点の範囲を現在のボーンの変形で変換して求めるため、
+     * ボーン数に比例した計算量で済みます。結果は実際にスキニングした頂点を必ず含みますが、実際の AABB より大きくなります。
+     * 視錐台カリングなどスキニング前に描画の要否を判定する用途を想定しています。
+     *
+     * materialAabbs が NULL でない場合は材質の順番で材質ごとの最小値と最大値が交互に入ります。
+     * materialEdgeSizes が NULL でない場合は材質の順番で材質に含まれる頂点のエッジ倍率の最大値が入ります。
+     * エッジは法線方向にカメラの位置に依存する幅で押し出されるため、AABB には含まれません。
+     * ボーンを持たない場合や QDEF の頂点を持つなど計算できない場合は false を返します。
+     *
+     * @brief computeConservativeAabb
+     * @param min
+     * @param max
+     * @param materialAabbs
+     * @param materialEdgeSizes
+     * @return
+     */
+    virtual bool computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const = 0;
+
     /**
      * モデルのバージョンを返します.
      *
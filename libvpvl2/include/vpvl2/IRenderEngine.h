@@ -55,7 +55,9 @@ class VPVL2_API IRenderEngine
 public:
     enum UpdateOptionFlags {
         kNone = 0,
-        kParallelUpdate = 1
+        kParallelUpdate = 1,
+        kExactAabbUpdate = 2,
+        kSkipUnchangedUpdate = 4
     };
 
     virtual ~IRenderEngine() {}
@@ -84,6 +84,14 @@ public:
         kForceUpdateAllMorphs = 0x20,
         kMaxUpdateTypeFlags   = 0x40
     };
+    enum CullingTypeFlags {
+        kCullingViewFrustum   = 0x1,
+        kCullingGroundShadow  = 0x2,
+        kCullingShadowFrustum = 0x4,
+        kCullingEdge          = 0x8,
+        kCullingAll           = kCullingViewFrustum | kCullingGroundShadow | kCullingShadowFrustum | kCullingEdge,
+        kMaxCullingTypeFlags  = 0x10
+    };
     struct Deleter {
         void operator()(IModel *model) const {
             Scene::deleteModelUnlessReferred(model);
@@ -597,6 +605,65 @@ public:
      */
     void setWorldRef(btDiscreteDynamicsWorld *worldRef) VPVL2_DECL_NOEXCEPT;
 
+    /**
+     * 視錐台カリングが有効かを返します.
+     *
+     * @brief isCullingEnabled
+     * @return
+     */
+    bool isCullingEnabled() const VPVL2_DECL_NOEXCEPT;
+
+    /**
+     * 視錐台カリングを有効にするかを設定します.
+     *
+     * 初期状態では無効です。有効にした場合でも setCullingMatrix でそのフレームのカメラの行列が設定されるまではカリングされません。
+     * オフスクリーンレンダーターゲットを持つエフェクトがある場合は別の視点から描画されるため、自動的にカリングを行いません。
+     *
+     * @brief setCullingEnable
+     * @param value
+     */
+    void setCullingEnable(bool value) VPVL2_DECL_NOEXCEPT;
+
+    /**
+     * カリングに使う視錐台をビュー射影行列 (列優先の 4x4 行列) から設定します.
+     *
+     * type には kCullingViewFrustum (カメラ) か kCullingShadowFrustum (セルフシャドウの照明) を指定します。
+     * 地面影 (kCullingGroundShadow) はカメラの視錐台と照明の向きから、エッジ (kCullingEdge) はカメラの視錐台と
+     * エッジの幅から求めるため設定不要です。
+     * value に NULL を渡すと対象の視錐台を無効にします。
+     * 判定は update で kUpdateRenderEngines を指定したときに行われるため、update の前に設定する必要があります。
+     * 設定した行列はその update でのみ使われるため、前のフレームの視錐台でカリングしないようにフレームごとに設定してください。
+     *
+     * @brief setCullingMatrix
+     * @param type
+     * @param value
+     */
+    void setCullingMatrix(CullingTypeFlags type, const float32 *value) VPVL2_DECL_NOEXCEPT;
+
+    /**
+     * モデルが flags で指定した全ての描画で見えないかを返します.
+     *
+     * IModel#computeConservativeAabb から求めた AABB で判定するため、true の場合は描画を省略できます。
+     * flags に kCullingAll を指定して true が返るモデルは update でスキニングも省略されます。
+     *
+     * @brief isModelCulled
+     * @param model
+     * @param flags
+     * @return
+     */
+    bool isModelCulled(const IModel *model, int flags) const;
+
+    /**
+     * モデルの材質が flags で指定した全ての描画で見えないかを返します.
+     *
+     * @brief isMaterialCulled
+     * @param model
+     * @param materialIndex
+     * @param flags
+     * @return
+     */
+    bool isMaterialCulled(const IModel *model, int materialIndex, int flags) const;
+
 private:
     VPVL2_DISABLE_COPY_AND_ASSIGN(Scene)
     struct PrivateContext;
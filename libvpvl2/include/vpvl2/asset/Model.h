@@ -57,6 +57,8 @@
 #pragma clang diagnostic pop
 #endif
 
+#include <string>
+
 class btDiscreteDynamicsWorld;
 struct aiNode;
 
@@ -70,6 +72,43 @@ namespace asset
 class VPVL2_API Model VPVL2_DECL_FINAL : public IModel
 {
 public:
+    enum PrimitiveType {
+        kTriangles,
+        kLines,
+        kPoints
+    };
+    /**
+     * Vertex of the flattened mesh, node transforms are already applied.
+     */
+    struct MeshVertex {
+        Vector3 position;
+        Vector3 normal;
+        Vector3 texcoord;
+        Vector3 tangent;
+        Vector3 bitangent;
+    };
+    /**
+     * Sub range of the flattened index buffer drawn with a same material.
+     *
+     * Material properties are resolved at load time so render engines don't need to query aiMaterial.
+     */
+    struct MaterialBatch {
+        std::string texturePath;
+        Color ambient;
+        Color diffuse;
+        Color specular;
+        Color emissive;
+        float32 shininess;
+        float32 opacity;
+        int materialIndex;
+        int primitiveType;
+        int indexOffset;
+        int nindices;
+        bool hasShininess;
+        bool hasOpacity;
+        bool isTwoSided;
+    };
+
     Model(IEncoding *encoding);
     ~Model();
 
@@ -81,8 +120,8 @@ public:
     bool isPhysicsEnabled() const { return false; }
     ErrorType error() const { return kNoError; }
     bool load(const uint8 *data, vsize size);
-    void save(uint8 * /* data */, vsize & /* written */) const {}
-    vsize estimateSize() const { return 0; }
+    void save(uint8 *data, vsize &written) const;
+    vsize estimateSize() const;
     void joinWorld(btDiscreteDynamicsWorld * /* world */) {}
     void leaveWorld(btDiscreteDynamicsWorld * /* world */) {}
     void resetAllVerticesTransform() {}
@@ -139,6 +178,7 @@ public:
                          const IndexBuffer * /* indexBuffer */) const { matrixBuffer = 0; }
     void setAabb(const Vector3 &min, const Vector3 &max);
     void getAabb(Vector3 &min, Vector3 &max) const;
+    bool computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const;
 
     float32 version() const;
     void setVersion(float32 value);
@@ -176,16 +216,36 @@ public:
     IProgressReporter *progressReporterRef() const;
     void setProgressReporterRef(IProgressReporter *value);
 
+    /**
+     * Returns true if the data is the native cache written by Model#save.
+     *
+     * The cache stores flattened meshes and material batches so Model#load skips Assimp with it.
+     */
+    static bool isCacheData(const uint8 *data, vsize size);
+
+    /**
+     * Returns vertices of all meshes merged by material, built once at load.
+     */
+    const Array<MeshVertex> &meshVertices() const { return m_meshVertices; }
+    const Array<uint32> &meshIndices() const { return m_meshIndices; }
+    const Array<MaterialBatch> &materialBatches() const { return m_materialBatches; }
+
 #if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
     const aiScene *aiScenePtr() const { return m_scene; }
+    /**
+     * Rebuilds meshVertices, meshIndices and materialBatches from the scene.
+     *
+     * Node transforms are baked into vertices and meshes sharing a material and a primitive type are merged.
+     */
+    void buildMaterialBatches(const aiScene *scene);
 #endif
 
 private:
 #if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
     void setIndicesRecurse(const aiScene *scene, const aiNode *node);
-    void setMaterialRefsRecurse(const aiScene *scene, const aiNode *node);
-    void setVertexRefsRecurse(const aiScene *scene, const aiNode *node);
-    void getBoundingBoxRecurse(const aiScene *scene, const aiNode *node, Vector3 &min, Vector3 &max) const;
+    void setMaterialRefs();
+    void setVertexRefs();
+    bool loadCache(const uint8 *data, vsize size);
     Assimp::Importer m_importer;
     const aiScene *m_scene;
 #endif
@@ -206,6 +266,9 @@ private:
     mutable PointerArray<IMorph> m_morphs;
     mutable PointerArray<IVertex> m_vertices;
     mutable Array<uint32> m_indices;
+    Array<MeshVertex> m_meshVertices;
+    Array<uint32> m_meshIndices;
+    Array<MaterialBatch> m_materialBatches;
     Hash<HashString, IBone *> m_name2boneRefs;
     Hash<HashString, IMorph *> m_name2morphRefs;
     Vector3 m_aabbMax;
@@ -42,6 +42,7 @@
 #include <vpvl2/IEncoding.h>
 
 #include <set>
+#include <string>
 #include <vector>
 
 namespace vpvl2
@@ -64,6 +65,7 @@ public:
         kOpenCurrentFileError,
         kReadCurrentFileError,
         kCloseCurrentFileError,
+        kMapFileError,
         kMaxError
     };
 
@@ -74,6 +76,10 @@ public:
     bool close();
     bool uncompress(const EntrySet &entries);
     bool uncompressEntry(const std::string &name);
+    vsize entrySize(const std::string &name) const;
+    bool readEntry(const std::string &name, uint8 *buffer, vsize size) const;
+    const uint8 *storedEntryRef(const std::string &name, vsize &size) const;
+    void releaseEntry(const std::string &name);
     void setBasePath(const std::string &value);
     Archive::ErrorType error() const;
     const EntryNames entryNames() const;
@@ -44,6 +44,9 @@
 #include <vpvl2/IEffect.h>
 #include <vpvl2/Scene.h>
 #include <vpvl2/extensions/StringMap.h>
+#include <vpvl2/extensions/ProgramBinaryCache.h>
+#include <vpvl2/extensions/TextureCache.h>
+#include <vpvl2/extensions/TextureDecoder.h>
 #include <vpvl2/gl/FrameBufferObject.h>
 
 /* STL */
@@ -158,6 +161,8 @@ public:
         ITexture *createTextureFromFile(const std::string &path, int flags);
         ITexture *createTextureFromMemory(const uint8 *data, vsize size, const std::string &key, int flags);
         void storeTexture(const std::string &key, int flags, ITexture *textureRef);
+        void prefetchTextures(const IModel *modelRef, bool enableMipmap);
+        bool isTexturePrefetched(const std::string &key) const;
         void getTextureRefCaches(TextureRefCacheMap &value) const;
         int countTextures() const;
         bool flipVertically() const;
@@ -168,6 +173,7 @@ public:
         Archive *m_archiveRef;
         BaseApplicationContext *m_applicationContextRef;
         TextureRefCacheMap m_textureRefCache;
+        TextureDecoder m_textureDecoder;
         float m_maxAnisotropyValue;
         bool m_flipVertically;
     };
@@ -262,6 +268,11 @@ public:
     int samplesMSAA() const;
     void setSamplesMSAA(int value);
     Scene *sceneRef() const;
+    TextureCache *textureCacheRef();
+    IApplicationContext::ProgramBinaryCache *sharedProgramBinaryCacheInstance() const;
+    SharedModelBuffers *findSharedModelBuffersRef(const void *key);
+    SharedModelBuffers *addSharedModelBuffers(const void *key, const SharedModelBuffers &value);
+    void removeSharedModelBuffers(const void *key);
     void getCameraMatrices(glm::mat4 &world, glm::mat4 &view, glm::mat4 &projection) const;
     void setCameraMatrices(const glm::mat4 &world, const glm::mat4 &view, const glm::mat4 &projection);
     void getLightMatrices(glm::mat4 &world, glm::mat4 &view, glm::mat4 &projection) const;
@@ -274,6 +285,7 @@ public:
     void renderShadowMap();
 
     ITexture *uploadTexture(const void *ptr, const gl::BaseSurface::Format &format, const Vector3 &size) const;
+    ITexture *uploadTexture(const TextureDecoder::Image *imageRef) const;
     ITexture *uploadTextureFromMemory(const uint8 *data, vsize size, bool flipVertically);
     void optimizeTexture(ITexture *texture);
 
@@ -333,6 +345,7 @@ protected:
 
     typedef PointerHash<HashPtr, gl::FrameBufferObject> RenderTargetMap;
     typedef PointerHash<HashString, IEffect> Path2EffectMap;
+    typedef PointerHash<HashPtr, SharedModelBuffers> SharedModelBuffersMap;
     typedef Hash<HashPtr, std::string> ModelRef2PathMap;
     typedef Hash<HashPtr, std::string> ModelRef2BasenameMap;
     typedef Hash<HashPtr, IModel *> EffectRef2ModelRefMap;
@@ -356,8 +369,11 @@ protected:
     EffectRef2ParameterUIRefMap m_effectRef2ParameterUIs;
     RenderTargetMap m_renderTargets;
     SharedTextureParameterMap m_sharedParameters;
+    SharedModelBuffersMap m_sharedModelBuffers;
     Array<IEffect::Technique *> m_offscreenTechniques;
     Array<IEffect *> m_dirtyEffects;
+    TextureCache m_textureCache;
+    mutable extensions::ProgramBinaryCache m_programBinaryCache;
 #ifdef VPVl2_ENABLE_NVIDIA_CG
     typedef PointerArray<OffscreenTexture> OffscreenTextureList;
     OffscreenTextureList m_offscreenTextures;
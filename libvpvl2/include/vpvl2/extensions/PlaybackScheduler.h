@@ -0,0 +1,172 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#pragma once
+#ifndef VPVL2_EXTENSIONS_PLAYBACKSCHEDULER_H_
+#define VPVL2_EXTENSIONS_PLAYBACKSCHEDULER_H_
+
+#include <vpvl2/IKeyframe.h>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+
+class Scene;
+
+namespace extensions
+{
+
+class World;
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * PlaybackScheduler drives Scene from a clock instead of from the host's frame count.
+ *
+ * The target time index is derived from a monotonic clock (or from an audio clock
+ * supplied by the host through IClock) and is quantized to Scene#preferredFPS slots.
+ * Frames that would be presented past their deadline skip skinning (render engine
+ * updates) and are reported as skipped, while physics is always stepped at a fixed
+ * rate so the simulation does not depend on the rendering rate.
+ *
+ * The scheduler takes no locks; it only pulls IClock#currentSeconds once per tick,
+ * so an audio clock implementation must be safe to read from the rendering thread.
+ */
+
+class VPVL2_API PlaybackScheduler VPVL2_DECL_FINAL
+{
+public:
+    class IClock {
+    public:
+        virtual ~IClock() {}
+        /**
+         * Returns current position of the clock in seconds.
+         *
+         * The value may advance coarsely (audio buffer granularity for example),
+         * the scheduler interpolates it with the monotonic clock.
+         */
+        virtual float64 currentSeconds() const = 0;
+    };
+    class VPVL2_API MonotonicClock VPVL2_DECL_FINAL : public IClock {
+    public:
+        MonotonicClock() {}
+        ~MonotonicClock() {}
+        float64 currentSeconds() const;
+    private:
+        VPVL2_DISABLE_COPY_AND_ASSIGN(MonotonicClock)
+    };
+    enum FrameStatus {
+        kFrameIdle,
+        kFramePresent,
+        kFrameSkipped,
+        kMaxFrameStatus
+    };
+    struct Statistics {
+        Statistics()
+            : numPresentedFrames(0),
+              numSkippedFrames(0),
+              numMissedFrames(0),
+              numPhysicsSteps(0),
+              numDiscardedPhysicsSteps(0),
+              averageFrameCostSeconds(0),
+              maxLatenessSeconds(0)
+        {
+        }
+        int64 numDroppedFrames() const {
+            return numSkippedFrames + numMissedFrames;
+        }
+        /* frames updated and presented */
+        int64 numPresentedFrames;
+        /* frames late to the deadline, updated without skinning and not presented */
+        int64 numSkippedFrames;
+        /* frame slots passed without any tick */
+        int64 numMissedFrames;
+        int64 numPhysicsSteps;
+        /* physics steps thrown away to catch up after a stall */
+        int64 numDiscardedPhysicsSteps;
+        float64 averageFrameCostSeconds;
+        float64 maxLatenessSeconds;
+    };
+
+    static const int kDefaultMaxPhysicsSubSteps;
+    static const int kDefaultMaxConsecutiveSkips;
+    static const float64 kDefaultLateThreshold;
+
+    PlaybackScheduler(Scene *sceneRef, World *worldRef);
+    ~PlaybackScheduler();
+
+    void start();
+    void stop();
+    void seek(const IKeyframe::TimeIndex &timeIndex);
+    FrameStatus tick();
+    void finishFrame();
+    float64 secondsUntilNextFrame() const;
+    void resetStatistics();
+
+    bool isRunning() const;
+    IKeyframe::TimeIndex currentTimeIndex() const;
+    const Statistics &statistics() const;
+    IClock *clockRef() const;
+    void setClockRef(IClock *value);
+    Scalar physicsFPS() const;
+    void setPhysicsFPS(const Scalar &value);
+    int maxPhysicsSubSteps() const;
+    void setMaxPhysicsSubSteps(int value);
+    int maxConsecutiveSkips() const;
+    void setMaxConsecutiveSkips(int value);
+    float64 lateThreshold() const;
+    void setLateThreshold(const float64 &value);
+
+private:
+    struct PrivateContext;
+    PrivateContext *m_context;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(PlaybackScheduler)
+};
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+using namespace VPVL2_VERSION_NS;
+
+} /* namespace vpvl2 */
+
+#endif
@@ -0,0 +1,92 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_EXTENSIONS_PROGRAMBINARYCACHE_H_
+#define VPVL2_EXTENSIONS_PROGRAMBINARYCACHE_H_
+
+#include <vpvl2/IApplicationContext.h>
+
+#include <string>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * ProgramBinaryCache class holds linked shader program binaries keyed by hash of the sources
+ * and the driver so render engines sharing the same programs compile them only once.
+ * Binaries can be also written to the cache directory and restored from it on next session.
+ * This class is not thread safe.
+ */
+
+class VPVL2_API ProgramBinaryCache VPVL2_DECL_FINAL : public IApplicationContext::ProgramBinaryCache
+{
+public:
+    ProgramBinaryCache();
+    ~ProgramBinaryCache();
+
+    bool findProgramBinary(const char *key, uint32 &format, Array<uint8> &bytes);
+    void storeProgramBinary(const char *key, uint32 format, const uint8 *bytes, vsize size);
+    int countBinaries() const;
+    void release();
+
+    std::string directory() const;
+    void setDirectory(const std::string &value);
+
+private:
+    struct PrivateContext;
+    PrivateContext *m_context;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(ProgramBinaryCache)
+};
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+using namespace VPVL2_VERSION_NS;
+
+} /* namespace vpvl2 */
+
+#endif
@@ -0,0 +1,123 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_EXTENSIONS_TEXTURECACHE_H_
+#define VPVL2_EXTENSIONS_TEXTURECACHE_H_
+
+#include <vpvl2/extensions/TextureDecoder.h>
+
+#include <string>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * TextureCache class holds decoded images keyed by hash of the encoded source bytes
+ * so identical textures referenced by different models are decoded only once.
+ * Decoded images can be also written to the cache directory and restored from it
+ * on next session to skip decoding. This class is not thread safe.
+ *
+ * Each image is reference counted. Images no longer referenced are kept until the total
+ * size of the cached images exceeds maxBytes() and evicted from the least recently used one.
+ */
+
+class VPVL2_API TextureCache VPVL2_DECL_FINAL
+{
+public:
+    struct VPVL2_API Key {
+        Key();
+        bool operator<(const Key &other) const;
+        std::string toString() const;
+        uint64 hash;
+        uint64 size;
+        int flags;
+    };
+
+    static const vsize kDefaultMaxBytes = 128 * 1024 * 1024;
+    static Key createKey(const uint8 *data, vsize size, int flags);
+
+    TextureCache();
+    ~TextureCache();
+
+    /**
+     * Returns the image of the key and acquires its reference, or null if it's neither cached nor
+     * stored in the cache directory. The reference must be released by releaseImageRef.
+     */
+    const TextureDecoder::Image *find(const Key &key);
+    /**
+     * Takes ownership of the decoded image and acquires its reference, returns the image
+     * previously cached instead if the same key is already inserted.
+     */
+    const TextureDecoder::Image *insert(const Key &key, TextureDecoder::Image *image);
+    void releaseImageRef(const Key &key);
+    int countImages() const;
+    vsize totalBytes() const;
+    /**
+     * Deletes all of the images not referenced, images still referenced are kept.
+     */
+    void release();
+
+    vsize maxBytes() const;
+    void setMaxBytes(vsize value);
+
+    std::string directory() const;
+    void setDirectory(const std::string &value);
+
+private:
+    struct PrivateContext;
+    PrivateContext *m_context;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(TextureCache)
+};
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+using namespace VPVL2_VERSION_NS;
+
+} /* namespace vpvl2 */
+
+#endif
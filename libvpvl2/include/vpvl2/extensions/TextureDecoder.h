@@ -0,0 +1,134 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_EXTENSIONS_TEXTUREDECODER_H_
+#define VPVL2_EXTENSIONS_TEXTUREDECODER_H_
+
+#include <vpvl2/Common.h>
+
+#include <string>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * TextureDecoder class decodes encoded images (BMP/JPG/PNG/TGA/DDS) into RGBA8 pixels
+ * concurrently without any OpenGL context. Only uploading decoded pixels must be done
+ * on the thread that owns the OpenGL context.
+ */
+
+class TextureCache;
+
+class VPVL2_API TextureDecoder VPVL2_DECL_FINAL
+{
+public:
+    enum OptionFlags {
+        kNone            = 0x0,
+        kFlipVertically  = 0x1,
+        kGenerateMipmaps = 0x2
+    };
+    static const int kNumComponents = 4;
+
+    class VPVL2_API Image VPVL2_DECL_FINAL {
+    public:
+        Image(const std::string &key, const uint8 *dataRef, vsize size, int flags);
+        ~Image();
+
+        void decode();
+        bool restore(const uint8 *data, vsize size);
+        void serialize(std::string &bytes) const;
+        bool isDecoded() const;
+        int countLevels() const;
+        const uint8 *levelPixels(int level) const;
+        Vector3 levelSize(int level) const;
+        vsize levelBytes(int level) const;
+        vsize totalBytes() const;
+        const std::string &key() const;
+
+    private:
+        void flipVertically();
+        void generateMipmaps();
+
+        const std::string m_key;
+        const uint8 *m_dataRef;
+        const vsize m_dataSize;
+        const int m_flags;
+        uint8 *m_pixels;
+        std::string m_restoredBytes;
+        Array<uint8 *> m_mipmaps;
+        Array<const uint8 *> m_levelRefs;
+        Array<Vector3> m_sizes;
+
+        VPVL2_DISABLE_COPY_AND_ASSIGN(Image)
+    };
+
+    TextureDecoder();
+    ~TextureDecoder();
+
+    void addJob(const std::string &key, const uint8 *data, vsize size, int flags);
+    void decode(bool enableParallel);
+    const Image *findImage(const std::string &key) const;
+    int countImages() const;
+    void release();
+
+    TextureCache *cacheRef() const;
+    void setCacheRef(TextureCache *value);
+
+private:
+    struct PrivateContext;
+    PrivateContext *m_context;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(TextureDecoder)
+};
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+using namespace VPVL2_VERSION_NS;
+
+} /* namespace vpvl2 */
+
+#endif
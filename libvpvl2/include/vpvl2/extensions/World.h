@@ -65,6 +65,7 @@ public:
     void removeRigidBody(btRigidBody *value);
     void deleteAll();
     void stepSimulation(const Scalar &deltaTimeIndex, const Scalar &motionFPS);
+    void stepFixedSimulation(const Scalar &fixedTimeStep);
 
     const Vector3 gravity() const;
     btDiscreteDynamicsWorld *dynamicWorldRef() const;
@@ -55,6 +55,14 @@ namespace extensions
 namespace icu4c
 {
 
+/**
+ * String stores its contents in a process-wide interner shared by every instance with the
+ * same contents. The interned entry holds one canonical UTF-8 buffer with a precomputed hash
+ * and builds the UTF-16 form on demand, so toHashString and equals do not scan the contents.
+ * Only creating a new entry and dropping the last reference of an entry take the lock of the
+ * interner. A string with unpaired surrogates keeps its original UTF-16 form as UTF-8 cannot
+ * hold them (toStdString replaces them with U+FFFD).
+ */
 class VPVL2_API String VPVL2_DECL_FINAL : public IString {
 public:
     struct Converter {
@@ -105,6 +113,11 @@ public:
     static IString *create(const std::string &value);
     static std::string toStdString(const UnicodeString &value);
 
+    /**
+     * Returns the number of distinct strings currently held by the interner.
+     */
+    static vsize countInternedStrings();
+
     explicit String(const UnicodeString &value, IString::Codec codec = IString::kUTF8, const Converter *converterRef = 0);
     ~String();
 
@@ -122,10 +135,13 @@ public:
     vsize size() const;
 
 private:
+    struct Entry;
+    String(Entry *entry, IString::Codec codec, const Converter *converterRef);
+    const UnicodeString &unicodeValue() const;
+
     const Converter *m_converterRef;
-    const UnicodeString m_value;
+    Entry *m_entry;
     const IString::Codec m_codec;
-    const std::string m_utf8;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(String)
 };
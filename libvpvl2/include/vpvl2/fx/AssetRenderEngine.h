@@ -44,11 +44,7 @@
 
 #include "vpvl2/fx/EffectEngine.h"
 #include <map>
-
-struct aiMaterial;
-struct aiMesh;
-struct aiNode;
-struct aiScene;
+#include <string>
 
 namespace vpvl2
 {
@@ -107,7 +103,7 @@ public:
     void setOverridePass(IEffect::Pass *pass);
     bool testVisible();
 
-    void bindVertexBundle(const aiMesh *mesh);
+    void bindVertexBundle();
 
     IApplicationContext *applicationContextRef() const { return m_applicationContextRef; }
     Scene *sceneRef() const { return m_sceneRef; }
@@ -156,18 +152,16 @@ private:
         Vector4 uva4;
     };
     typedef Array<Vertex> Vertices;
-    typedef Array<int> Indices;
+    typedef Array<uint32> Indices;
 
-    bool uploadRecurse(const aiScene *scene, const aiNode *node, void *userData);
+    void uploadTexture(const std::string &path, int flags, bool isSphereMap, void *userData);
     void initializeEffectParameters();
     void refreshEffect();
-    void renderRecurse(const aiScene *scene, const aiNode *node, IEffect::Pass *overridePass, const bool hasShadowMap);
-    void renderZPlotRecurse(const aiScene *scene, const aiNode *node, IEffect::Pass *overridePass);
-    void setAssetMaterial(const aiMaterial *material, bool &hasTexture, bool &hasSphereMap);
-    void createVertexBundle(const aiMesh *mesh, const Vertices &vertices, const Indices &indices);
-    void unbindVertexBundle(const aiMesh *mesh);
+    void setAssetMaterial(int batchIndex, bool &hasTexture, bool &hasSphereMap);
+    void createVertexBundle(const Vertices &vertices, const Indices &indices);
+    void unbindVertexBundle();
     void bindStaticVertexAttributePointers();
-    void setDrawCommandMode(EffectEngine::DrawPrimitiveCommand &command, const aiMesh *mesh);
+    void setDrawCommand(EffectEngine::DrawPrimitiveCommand &command, int batchIndex);
     __attribute__((format(printf, 2, 3)))
     void annotate(const char *const format, ...);
 
@@ -179,9 +173,8 @@ private:
     PointerArray<PrivateEffectEngine> m_oseffects;
     PointerHash<HashPtr, ITexture> m_allocatedTextures;
     Textures m_textureMap;
-    Hash<HashPtr, int> m_numIndices;
-    PointerHash<HashPtr, gl::VertexBundle> m_vbo;
-    PointerHash<HashPtr, gl::VertexBundleLayout> m_vao;
+    gl::VertexBundle *m_vbo;
+    gl::VertexBundleLayout *m_vao;
     IEffect *m_defaultEffectRef;
     int m_nvertices;
     int m_nmeshes;
@@ -172,6 +172,7 @@ private:
     void getDrawPrimitivesCommand(EffectEngine::DrawPrimitiveCommand &command) const;
     void updateDrawPrimitivesCommand(const IMaterial *material, EffectEngine::DrawPrimitiveCommand &command) const;
     void updateBoneTransformMatrixPaletteData();
+    void performSkinning(void *address);
     void updateMaterialParameters(const IMaterial *material, const MaterialContext &context);
     void uploadToonTexture(const IMaterial *material,
                            const IString *toonTexturePath,
@@ -207,10 +208,13 @@ private:
     PointerArray<PrivateEffectEngine> m_oseffects;
     IEffect *m_defaultEffectRef;
     gl::GLenum m_indexType;
+    Array<uint8> m_exactAabbBuffer;
+    Array<Vector3> m_exactAabbs;
     Vector3 m_aabbMin;
     Vector3 m_aabbMax;
     bool m_cullFaceState;
     bool m_updateEvenBuffer;
+    bool m_enableExactAabb;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(PMXRenderEngine)
 };
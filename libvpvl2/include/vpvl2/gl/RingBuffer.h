@@ -0,0 +1,351 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_GL_RINGBUFFER_H_
+#define VPVL2_GL_RINGBUFFER_H_
+
+#include <vpvl2/gl/Global.h>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace gl
+{
+
+/**
+ * A vertex buffer split into N equally sized segments that are written in turn.
+ *
+ * Each segment is guarded by a fence so the writer never waits for the draws of the previous
+ * frame. The buffer is mapped persistently when ARB_buffer_storage is available, otherwise each
+ * segment is mapped unsynchronized with explicit flushing (ARB_map_buffer_range), so both paths
+ * only transfer the ranges marked dirty. ARB_sync is required for either path.
+ *
+ * A segment is rewritten N frames after it was last written, so begin() reports the range that
+ * changed in the meantime through getPendingRange() and the writer must rewrite it as well.
+ */
+class RingBuffer VPVL2_DECL_FINAL {
+public:
+    static const int kDefaultNumSegments = 3;
+    static const GLenum kGL_ARRAY_BUFFER = 0x8892;
+    static const GLenum kGL_DYNAMIC_DRAW = 0x88E8;
+    static const GLbitfield kGL_MAP_WRITE_BIT = 0x0002;
+    static const GLbitfield kGL_MAP_FLUSH_EXPLICIT_BIT = 0x0010;
+    static const GLbitfield kGL_MAP_UNSYNCHRONIZED_BIT = 0x0020;
+    static const GLbitfield kGL_MAP_PERSISTENT_BIT = 0x0040;
+    static const GLenum kGL_SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+    static const GLbitfield kGL_SYNC_FLUSH_COMMANDS_BIT = 0x00000001;
+    static const GLenum kGL_ALREADY_SIGNALED = 0x911A;
+    static const GLenum kGL_TIMEOUT_EXPIRED = 0x911B;
+    static const GLenum kGL_CONDITION_SATISFIED = 0x911C;
+    static const GLenum kGL_WAIT_FAILED = 0x911D;
+
+    enum MapType {
+        kNoneMap,
+        kPersistentMap,
+        kFlushExplicitMap,
+        kMaxMapType
+    };
+
+    RingBuffer(const IApplicationContext::FunctionResolver *resolver, int nsegments = kDefaultNumSegments)
+        : genBuffers(reinterpret_cast<PFNGLGENBUFFERSPROC>(resolver->resolveSymbol("glGenBuffers"))),
+          bindBuffer(reinterpret_cast<PFNGLBINDBUFFERPROC>(resolver->resolveSymbol("glBindBuffer"))),
+          bufferData(reinterpret_cast<PFNGLBUFFERDATAPROC>(resolver->resolveSymbol("glBufferData"))),
+          deleteBuffers(reinterpret_cast<PFNGLDELETEBUFFERSPROC>(resolver->resolveSymbol("glDeleteBuffers"))),
+          unmapBuffer(reinterpret_cast<PFNGLUNMAPBUFFERPROC>(resolver->resolveSymbol("glUnmapBuffer"))),
+          bufferStorage(0),
+          mapBufferRange(0),
+          flushMappedBufferRange(0),
+          fenceSync(0),
+          clientWaitSync(0),
+          deleteSync(0),
+          m_mapType(kNoneMap),
+          m_address(0),
+          m_segmentSize(0),
+          m_dirtyBegin(0),
+          m_dirtyEnd(0),
+          m_name(0),
+          m_current(-1),
+          m_nsegments(btMax(nsegments, 2))
+    {
+        const int version = resolver->query(IApplicationContext::FunctionResolver::kQueryVersion);
+        if (version >= gl::makeVersion(3, 2) || resolver->hasExtension("ARB_sync")) {
+            fenceSync = reinterpret_cast<PFNGLFENCESYNCPROC>(resolver->resolveSymbol("glFenceSync"));
+            clientWaitSync = reinterpret_cast<PFNGLCLIENTWAITSYNCPROC>(resolver->resolveSymbol("glClientWaitSync"));
+            deleteSync = reinterpret_cast<PFNGLDELETESYNCPROC>(resolver->resolveSymbol("glDeleteSync"));
+        }
+        if (version >= gl::makeVersion(3, 0) || resolver->hasExtension("ARB_map_buffer_range")) {
+            mapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEPROC>(resolver->resolveSymbol("glMapBufferRange"));
+            flushMappedBufferRange = reinterpret_cast<PFNGLFLUSHMAPPEDBUFFERRANGEPROC>(resolver->resolveSymbol("glFlushMappedBufferRange"));
+        }
+        if (version >= gl::makeVersion(4, 4) || resolver->hasExtension("ARB_buffer_storage")) {
+            bufferStorage = reinterpret_cast<PFNGLBUFFERSTORAGEPROC>(resolver->resolveSymbol("glBufferStorage"));
+        }
+        m_fences.resize(m_nsegments);
+        m_pendingBegin.resize(m_nsegments);
+        m_pendingEnd.resize(m_nsegments);
+        for (int i = 0; i < m_nsegments; i++) {
+            m_fences[i] = 0;
+        }
+    }
+    ~RingBuffer() {
+        release();
+        m_nsegments = 0;
+    }
+
+    bool isSupported() const {
+        return fenceSync && clientWaitSync && deleteSync && mapBufferRange && flushMappedBufferRange;
+    }
+    bool create(vsize segmentSize) {
+        release();
+        if (!isSupported() || segmentSize == 0) {
+            return false;
+        }
+        const vsize size = segmentSize * m_nsegments;
+        genBuffers(1, &m_name);
+        bindBuffer(kGL_ARRAY_BUFFER, m_name);
+        if (bufferStorage) {
+            static const GLbitfield kFlags = kGL_MAP_WRITE_BIT | kGL_MAP_PERSISTENT_BIT;
+            bufferStorage(kGL_ARRAY_BUFFER, size, 0, kFlags);
+            m_address = static_cast<uint8 *>(mapBufferRange(kGL_ARRAY_BUFFER, 0, size, kFlags | kGL_MAP_FLUSH_EXPLICIT_BIT));
+            m_mapType = kPersistentMap;
+        }
+        if (!m_address) {
+            bufferData(kGL_ARRAY_BUFFER, size, 0, kGL_DYNAMIC_DRAW);
+            m_mapType = kFlushExplicitMap;
+        }
+        bindBuffer(kGL_ARRAY_BUFFER, 0);
+        m_segmentSize = segmentSize;
+        for (int i = 0; i < m_nsegments; i++) {
+            m_pendingBegin[i] = 0;
+            m_pendingEnd[i] = segmentSize;
+        }
+        m_current = -1;
+        VPVL2_VLOG(2, "Created a ring buffer: name=" << m_name << " segments=" << m_nsegments << " size=" << segmentSize << " persistent=" << (m_mapType == kPersistentMap));
+        return true;
+    }
+    void release() {
+        for (int i = 0; i < m_fences.count(); i++) {
+            if (GLsync &fence = m_fences[i]) {
+                deleteSync(fence);
+                fence = 0;
+            }
+        }
+        if (m_name) {
+            if (m_address) {
+                bindBuffer(kGL_ARRAY_BUFFER, m_name);
+                unmapBuffer(kGL_ARRAY_BUFFER);
+                bindBuffer(kGL_ARRAY_BUFFER, 0);
+            }
+            deleteBuffers(1, &m_name);
+        }
+        m_mapType = kNoneMap;
+        m_address = 0;
+        m_segmentSize = 0;
+        m_name = 0;
+        m_current = -1;
+    }
+    /* fences the draws of the current segment, waits for the next one and returns it to write */
+    void *begin() {
+        if (!m_name) {
+            return 0;
+        }
+        if (m_current >= 0) {
+            /* a retry after a failed begin replaces the fence with the one covering the latest draws */
+            if (GLsync &fence = m_fences[m_current]) {
+                deleteSync(fence);
+            }
+            m_fences[m_current] = fenceSync(kGL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        /* the current segment is kept until the next one is ready to be written */
+        const int next = (m_current + 1) % m_nsegments;
+        if (!waitFence(m_fences[next], next)) {
+            return 0;
+        }
+        const vsize offset = next * m_segmentSize;
+        void *address = 0;
+        bindBuffer(kGL_ARRAY_BUFFER, m_name);
+        if (m_mapType == kPersistentMap) {
+            address = m_address + offset;
+        }
+        else {
+            static const GLbitfield kFlags = kGL_MAP_WRITE_BIT | kGL_MAP_FLUSH_EXPLICIT_BIT | kGL_MAP_UNSYNCHRONIZED_BIT;
+            address = mapBufferRange(kGL_ARRAY_BUFFER, offset, m_segmentSize, kFlags);
+        }
+        if (!address) {
+            bindBuffer(kGL_ARRAY_BUFFER, 0);
+            return 0;
+        }
+        m_current = next;
+        m_dirtyBegin = m_dirtyEnd = 0;
+        return address;
+    }
+    /* marks a byte range relative to the segment as written in this frame */
+    void markDirty(vsize offset, vsize size) {
+        const vsize end = btMin(offset + size, m_segmentSize);
+        if (offset < end) {
+            if (m_dirtyBegin < m_dirtyEnd) {
+                m_dirtyBegin = btMin(m_dirtyBegin, offset);
+                m_dirtyEnd = btMax(m_dirtyEnd, end);
+            }
+            else {
+                m_dirtyBegin = offset;
+                m_dirtyEnd = end;
+            }
+        }
+    }
+    /* flushes ranges dirtied since the segment was written last and publishes the segment */
+    void end() {
+        if (!m_name || m_current < 0) {
+            return;
+        }
+        vsize flushBegin = m_pendingBegin[m_current], flushEnd = m_pendingEnd[m_current];
+        mergeRange(flushBegin, flushEnd, m_dirtyBegin, m_dirtyEnd);
+        for (int i = 0; i < m_nsegments; i++) {
+            if (i == m_current) {
+                m_pendingBegin[i] = m_pendingEnd[i] = 0;
+            }
+            else {
+                mergeRange(m_pendingBegin[i], m_pendingEnd[i], m_dirtyBegin, m_dirtyEnd);
+            }
+        }
+        if (flushBegin < flushEnd) {
+            const vsize offset = m_mapType == kPersistentMap ? segmentOffset() + flushBegin : flushBegin;
+            flushMappedBufferRange(kGL_ARRAY_BUFFER, offset, flushEnd - flushBegin);
+        }
+        if (m_mapType != kPersistentMap) {
+            unmapBuffer(kGL_ARRAY_BUFFER);
+        }
+        bindBuffer(kGL_ARRAY_BUFFER, 0);
+    }
+    /* returns the range changed by other segments that the writer has to rewrite in addition */
+    void getPendingRange(vsize &offset, vsize &size) const {
+        if (m_current >= 0) {
+            offset = m_pendingBegin[m_current];
+            size = m_pendingEnd[m_current] - offset;
+        }
+        else {
+            offset = size = 0;
+        }
+    }
+    MapType mapType() const { return m_mapType; }
+    GLuint name() const { return m_name; }
+    int currentSegment() const { return btMax(m_current, 0); }
+    int countSegments() const { return m_nsegments; }
+    vsize segmentSize() const { return m_segmentSize; }
+    vsize segmentOffset() const { return currentSegment() * m_segmentSize; }
+
+private:
+    typedef struct __GLsync *GLsync;
+    typedef uint64 GLuint64;
+    typedef void (GLAPIENTRY * PFNGLGENBUFFERSPROC) (GLsizei n, GLuint* buffers);
+    typedef void (GLAPIENTRY * PFNGLBINDBUFFERPROC) (GLenum target, GLuint buffer);
+    typedef void (GLAPIENTRY * PFNGLBUFFERDATAPROC) (GLenum target, GLsizeiptr size, const GLvoid* data, GLenum usage);
+    typedef void (GLAPIENTRY * PFNGLDELETEBUFFERSPROC) (GLsizei n, const GLuint* buffers);
+    typedef GLboolean (GLAPIENTRY * PFNGLUNMAPBUFFERPROC) (GLenum target);
+    typedef void (GLAPIENTRY * PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
+    typedef GLvoid * (GLAPIENTRY * PFNGLMAPBUFFERRANGEPROC) (GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    typedef void (GLAPIENTRY * PFNGLFLUSHMAPPEDBUFFERRANGEPROC) (GLenum target, GLintptr offset, GLsizeiptr length);
+    typedef GLsync (GLAPIENTRY * PFNGLFENCESYNCPROC) (GLenum condition, GLbitfield flags);
+    typedef GLenum (GLAPIENTRY * PFNGLCLIENTWAITSYNCPROC) (GLsync sync, GLbitfield flags, GLuint64 timeout);
+    typedef void (GLAPIENTRY * PFNGLDELETESYNCPROC) (GLsync sync);
+
+    static void mergeRange(vsize &begin, vsize &end, vsize otherBegin, vsize otherEnd) {
+        if (otherBegin < otherEnd) {
+            if (begin < end) {
+                begin = btMin(begin, otherBegin);
+                end = btMax(end, otherEnd);
+            }
+            else {
+                begin = otherBegin;
+                end = otherEnd;
+            }
+        }
+    }
+    bool waitFence(GLsync &fence, int segment) {
+        bool succeeded = true;
+        if (fence) {
+            static const GLuint64 kTimeout = 1000000000; /* 1 second in nanoseconds */
+            GLenum result = kGL_TIMEOUT_EXPIRED;
+            while (result == kGL_TIMEOUT_EXPIRED) {
+                result = clientWaitSync(fence, kGL_SYNC_FLUSH_COMMANDS_BIT, kTimeout);
+            }
+            if (result == kGL_WAIT_FAILED) {
+                VPVL2_LOG(WARNING, "Waiting a fence of the ring buffer was failed: name=" << m_name << " segment=" << segment);
+                succeeded = false;
+            }
+            deleteSync(fence);
+            fence = 0;
+        }
+        return succeeded;
+    }
+
+    PFNGLGENBUFFERSPROC genBuffers;
+    PFNGLBINDBUFFERPROC bindBuffer;
+    PFNGLBUFFERDATAPROC bufferData;
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+    PFNGLUNMAPBUFFERPROC unmapBuffer;
+    PFNGLBUFFERSTORAGEPROC bufferStorage;
+    PFNGLMAPBUFFERRANGEPROC mapBufferRange;
+    PFNGLFLUSHMAPPEDBUFFERRANGEPROC flushMappedBufferRange;
+    PFNGLFENCESYNCPROC fenceSync;
+    PFNGLCLIENTWAITSYNCPROC clientWaitSync;
+    PFNGLDELETESYNCPROC deleteSync;
+
+    Array<GLsync> m_fences;
+    Array<vsize> m_pendingBegin;
+    Array<vsize> m_pendingEnd;
+    MapType m_mapType;
+    uint8 *m_address;
+    vsize m_segmentSize;
+    vsize m_dirtyBegin;
+    vsize m_dirtyEnd;
+    GLuint m_name;
+    int m_current;
+    int m_nsegments;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(RingBuffer)
+};
+
+} /* namespace gl */
+} /* namespace VPVL2_VERSION_NS */
+using namespace VPVL2_VERSION_NS;
+
+} /* namespace vpvl2 */
+
+#endif
@@ -42,6 +42,10 @@
 #include <vpvl2/IString.h>
 #include <vpvl2/gl/Global.h>
 
+#include <cstring>
+#include <sstream>
+#include <string>
+
 namespace vpvl2
 {
 namespace VPVL2_VERSION_NS
@@ -58,6 +62,12 @@ public:
     static const GLenum kGL_INFO_LOG_LENGTH = 0x8B84;
     static const GLenum kGL_FRAGMENT_SHADER = 0x8B30;
     static const GLenum kGL_VERTEX_SHADER = 0x8B31;
+    static const GLenum kGL_VENDOR = 0x1F00;
+    static const GLenum kGL_RENDERER = 0x1F01;
+    static const GLenum kGL_VERSION = 0x1F02;
+    static const GLenum kGL_PROGRAM_BINARY_RETRIEVABLE_HINT = 0x8257;
+    static const GLenum kGL_PROGRAM_BINARY_LENGTH = 0x8741;
+    static const GLenum kGL_NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
 
     ShaderProgram(const IApplicationContext::FunctionResolver *resolver)
         : createProgarm(reinterpret_cast<PFNGLCREATEPROGRAMPROC>(resolver->resolveSymbol("glCreateProgram"))),
@@ -84,9 +94,33 @@ public:
           uniformMatrix4fv(reinterpret_cast<PFNGLUNIFORMMATRIX3FVPROC>(resolver->resolveSymbol("glUniformMatrix4fv"))),
           activeTexture(reinterpret_cast<PFNGLACTIVETEXTUREPROC>(resolver->resolveSymbol("glActiveTexture"))),
           bindTexture(reinterpret_cast<PFNGLBINDTEXTUREPROC>(resolver->resolveSymbol("glBindTexture"))),
+          getProgramBinary(0),
+          programBinary(0),
+          programParameteri(0),
           m_program(0),
+          m_binaryCacheRef(0),
+          m_sourceHash(0),
           m_linked(false)
     {
+        if (resolver->query(IApplicationContext::FunctionResolver::kQueryVersion) >= gl::makeVersion(4, 1) || resolver->hasExtension("ARB_get_program_binary")) {
+            typedef void (GLAPIENTRY * PFNGLGETINTEGERVPROC) (GLenum pname, GLint *params);
+            typedef const unsigned char * (GLAPIENTRY * PFNGLGETSTRINGPROC) (GLenum name);
+            PFNGLGETINTEGERVPROC getIntegerv = reinterpret_cast<PFNGLGETINTEGERVPROC>(resolver->resolveSymbol("glGetIntegerv"));
+            PFNGLGETSTRINGPROC getString = reinterpret_cast<PFNGLGETSTRINGPROC>(resolver->resolveSymbol("glGetString"));
+            GLint nformats = 0;
+            getIntegerv(kGL_NUM_PROGRAM_BINARY_FORMATS, &nformats);
+            if (nformats > 0) {
+                getProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(resolver->resolveSymbol("glGetProgramBinary"));
+                programBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(resolver->resolveSymbol("glProgramBinary"));
+                programParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(resolver->resolveSymbol("glProgramParameteri"));
+                /* binaries are only valid on the same driver */
+                static const GLenum kDriverStrings[] = { kGL_VENDOR, kGL_RENDERER, kGL_VERSION };
+                for (vsize i = 0; i < sizeof(kDriverStrings) / sizeof(kDriverStrings[0]); i++) {
+                    const char *value = reinterpret_cast<const char *>(getString(kDriverStrings[i]));
+                    m_driverString.append(value ? value : "").append("\n");
+                }
+            }
+        }
     }
     virtual ~ShaderProgram() {
         if (m_program) {
@@ -101,31 +135,51 @@ public:
             m_program = createProgarm();
         }
     }
+    /**
+     * Sets the cache to restore the linked program from instead of compiling sources.
+     *
+     * While the cache is set, sources are compiled in link() only when the cache misses or the
+     * driver rejects the binary. Attribute locations are not a part of the key, so they must be
+     * determined by the sources.
+     */
+    void setBinaryCacheRef(IApplicationContext::ProgramBinaryCache *value) {
+        m_binaryCacheRef = getProgramBinary && programBinary ? value : 0;
+    }
     bool addShaderSource(const char *source, GLenum type) {
-        GLuint shader = createShader(type);
-        shaderSource(shader, 1, &source, 0);
-        compileShader(shader);
-        GLint compiled;
-        getShaderiv(shader, kGL_COMPILE_STATUS, &compiled);
-        if (!compiled) {
-            GLint len;
-            getShaderiv(shader, kGL_INFO_LOG_LENGTH, &len);
-            if (len > 0) {
-                m_message.resize(len);
-                getShaderInfoLog(shader, len, &len, &m_message[0]);
-                VPVL2_LOG(WARNING, "Cannot compile this shader: " << static_cast<const char *>(&m_message[0]));
-            }
-            deleteShader(shader);
-            return false;
+        if (m_binaryCacheRef) {
+            m_pendingSources.append(std::make_pair(type, std::string(source)));
+            m_sourceHash = hashBytes(reinterpret_cast<const uint8 *>(&type), sizeof(type), m_sourceHash);
+            m_sourceHash = hashBytes(reinterpret_cast<const uint8 *>(source), std::strlen(source), m_sourceHash);
+            return true;
         }
-        attachShader(m_program, shader);
-        deleteShader(shader);
-        return true;
+        return compileShaderSource(source, type);
     }
     bool addShaderSource(const IString *source, GLenum type) {
         return addShaderSource(source ? reinterpret_cast<const char *>(source->toByteArray()) : "", type);
     }
     bool link() {
+        std::string key;
+        if (m_binaryCacheRef && m_pendingSources.count() > 0) {
+            std::ostringstream stream;
+            stream << std::hex << m_sourceHash << "-" << hashBytes(reinterpret_cast<const uint8 *>(m_driverString.c_str()), m_driverString.size(), 0);
+            key = stream.str();
+            if (restoreBinary(key)) {
+                m_pendingSources.clear();
+                m_linked = true;
+                return true;
+            }
+            /* falls back to compile the sources if not found or rejected by the driver */
+            const int nsources = m_pendingSources.count();
+            for (int i = 0; i < nsources; i++) {
+                const std::pair<GLenum, std::string> &source = m_pendingSources[i];
+                if (!compileShaderSource(source.second.c_str(), source.first)) {
+                    m_pendingSources.clear();
+                    return false;
+                }
+            }
+            m_pendingSources.clear();
+            programParameteri(m_program, kGL_PROGRAM_BINARY_RETRIEVABLE_HINT, kGL_TRUE);
+        }
         GLint linked;
         linkProgram(m_program);
         getProgramiv(m_program, kGL_LINK_STATUS, &linked);
@@ -140,6 +194,9 @@ public:
             deleteProgram(m_program);
             return false;
         }
+        if (!key.empty()) {
+            storeBinary(key);
+        }
         m_linked = true;
         return true;
     }
@@ -181,6 +238,9 @@ protected:
     typedef void (GLAPIENTRY * PFNGLUNIFORMMATRIX4FVPROC) (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
     typedef void (GLAPIENTRY * PFNGLACTIVETEXTUREPROC) (GLenum texture);
     typedef void (GLAPIENTRY * PFNGLBINDTEXTUREPROC) (GLenum target, GLuint texture);
+    typedef void (GLAPIENTRY * PFNGLGETPROGRAMBINARYPROC) (GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, GLvoid *binary);
+    typedef void (GLAPIENTRY * PFNGLPROGRAMBINARYPROC) (GLuint program, GLenum binaryFormat, const GLvoid *binary, GLsizei length);
+    typedef void (GLAPIENTRY * PFNGLPROGRAMPARAMETERIPROC) (GLuint program, GLenum pname, GLint value);
     PFNGLCREATEPROGRAMPROC createProgarm;
     PFNGLCREATESHADERPROC createShader;
     PFNGLSHADERSOURCEPROC shaderSource;
@@ -205,11 +265,78 @@ protected:
     PFNGLUNIFORMMATRIX4FVPROC uniformMatrix4fv;
     PFNGLACTIVETEXTUREPROC activeTexture;
     PFNGLBINDTEXTUREPROC bindTexture;
+    PFNGLGETPROGRAMBINARYPROC getProgramBinary;
+    PFNGLPROGRAMBINARYPROC programBinary;
+    PFNGLPROGRAMPARAMETERIPROC programParameteri;
 
     GLuint m_program;
 
 private:
+    static uint64 hashBytes(const uint8 *data, vsize size, uint64 hash) {
+        /* 64bit FNV-1a, starts from the offset basis if hash is zero */
+        static const uint64 kOffsetBasis = 14695981039346656037ull, kPrime = 1099511628211ull;
+        if (hash == 0) {
+            hash = kOffsetBasis;
+        }
+        for (vsize i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= kPrime;
+        }
+        return hash;
+    }
+    bool compileShaderSource(const char *source, GLenum type) {
+        GLuint shader = createShader(type);
+        shaderSource(shader, 1, &source, 0);
+        compileShader(shader);
+        GLint compiled;
+        getShaderiv(shader, kGL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            GLint len;
+            getShaderiv(shader, kGL_INFO_LOG_LENGTH, &len);
+            if (len > 0) {
+                m_message.resize(len);
+                getShaderInfoLog(shader, len, &len, &m_message[0]);
+                VPVL2_LOG(WARNING, "Cannot compile this shader: " << static_cast<const char *>(&m_message[0]));
+            }
+            deleteShader(shader);
+            return false;
+        }
+        attachShader(m_program, shader);
+        deleteShader(shader);
+        return true;
+    }
+    bool restoreBinary(const std::string &key) {
+        uint32 format = 0;
+        Array<uint8> bytes;
+        if (m_binaryCacheRef->findProgramBinary(key.c_str(), format, bytes) && bytes.count() > 0) {
+            GLint linked = 0;
+            programBinary(m_program, format, &bytes[0], bytes.count());
+            getProgramiv(m_program, kGL_LINK_STATUS, &linked);
+            if (linked) {
+                VPVL2_VLOG(2, "Restored the shader program from the binary cache: key=" << key << " size=" << bytes.count());
+                return true;
+            }
+            VPVL2_LOG(WARNING, "The cached program binary was rejected: key=" << key);
+        }
+        return false;
+    }
+    void storeBinary(const std::string &key) {
+        GLint length = 0;
+        getProgramiv(m_program, kGL_PROGRAM_BINARY_LENGTH, &length);
+        if (length > 0) {
+            Array<uint8> bytes;
+            GLenum format = 0;
+            bytes.resize(length);
+            getProgramBinary(m_program, length, &length, &format, &bytes[0]);
+            m_binaryCacheRef->storeProgramBinary(key.c_str(), format, &bytes[0], length);
+        }
+    }
+
+    IApplicationContext::ProgramBinaryCache *m_binaryCacheRef;
+    Array<std::pair<GLenum, std::string> > m_pendingSources;
+    std::string m_driverString;
     Array<char> m_message;
+    uint64 m_sourceHash;
     bool m_linked;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(ShaderProgram)
@@ -74,6 +74,21 @@ public:
             allocate(pixels);
         }
     }
+    void fillPixelLevels(const void *const *pixels, int nlevels) {
+        const GLsizei width = GLsizei(m_size.x()), height = GLsizei(m_size.y());
+        if (m_hasTextureStorage) {
+            texStorage2D(m_format.target, nlevels, m_format.internal, width, height);
+        }
+        for (int i = 0; i < nlevels; i++) {
+            const GLsizei levelWidth = btMax(width >> i, 1), levelHeight = btMax(height >> i, 1);
+            if (m_hasTextureStorage) {
+                texSubImage2D(m_format.target, i, 0, 0, levelWidth, levelHeight, m_format.external, m_format.type, pixels[i]);
+            }
+            else {
+                texImage2D(m_format.target, i, m_format.internal, levelWidth, levelHeight, 0, m_format.external, m_format.type, pixels[i]);
+            }
+        }
+    }
     void allocate(const void *pixels) {
         texImage2D(m_format.target, 0, m_format.internal, GLsizei(m_size.x()), GLsizei(m_size.y()), 0, m_format.external, m_format.type, pixels);
     }
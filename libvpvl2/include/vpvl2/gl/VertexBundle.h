@@ -89,7 +89,8 @@ public:
           unmapBuffer(reinterpret_cast<PFNGLUNMAPBUFFERPROC>(resolver->resolveSymbol("glUnmapBuffer"))),
           mapBufferRange(0),
           m_indexBuffer(0),
-          m_query(0)
+          m_query(0),
+          m_indexBufferShared(false)
     {
         if (resolver->hasExtension("ARB_map_buffer_range")) {
             mapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEPROC>(resolver->resolveSymbol("glMapBufferRange"));
@@ -113,7 +114,9 @@ public:
         const int numVertexBuffers = m_vertexBuffers.count();
         for (int i = 0; i < numVertexBuffers; i++) {
             const GLuint *value = m_vertexBuffers.value(i);
-            deleteBuffers(1, value);
+            if (!isSharedVertexBuffer(*value)) {
+                deleteBuffers(1, value);
+            }
         }
         if (m_query) {
             deleteQueries(1, &m_query);
@@ -142,16 +145,61 @@ public:
         switch (value) {
         case kVertexBuffer: {
             if (const GLuint *buffer = m_vertexBuffers.find(key)) {
-                deleteBuffers(1, buffer);
+                if (!isSharedVertexBuffer(*buffer)) {
+                    deleteBuffers(1, buffer);
+                }
+                m_sharedVertexBuffers.remove(key);
                 m_vertexBuffers.remove(key);
             }
             break;
         }
         case kIndexBuffer: {
-            if (m_indexBuffer) {
+            if (m_indexBuffer && !m_indexBufferShared) {
                 deleteBuffers(1, &m_indexBuffer);
-                m_indexBuffer = 0;
             }
+            m_indexBuffer = 0;
+            m_indexBufferShared = false;
+            break;
+        }
+        case kMaxVertexBufferType:
+        default:
+            break;
+        }
+    }
+    /* binds the buffer owned by another bundle, it is not deleted by this bundle until unshare is called */
+    void share(Type value, GLuint key, GLuint name) {
+        switch (value) {
+        case kVertexBuffer: {
+            const GLuint *buffer = m_vertexBuffers.find(key);
+            if (buffer && *buffer != name) {
+                release(value, key);
+            }
+            m_vertexBuffers.insert(key, name);
+            m_sharedVertexBuffers.insert(key, name);
+            break;
+        }
+        case kIndexBuffer: {
+            if (m_indexBuffer != name) {
+                release(value, key);
+            }
+            m_indexBuffer = name;
+            m_indexBufferShared = true;
+            break;
+        }
+        case kMaxVertexBufferType:
+        default:
+            break;
+        }
+    }
+    /* takes ownership of the shared buffer back to delete it with this bundle */
+    void unshare(Type value, GLuint key) {
+        switch (value) {
+        case kVertexBuffer: {
+            m_sharedVertexBuffers.remove(key);
+            break;
+        }
+        case kIndexBuffer: {
+            m_indexBufferShared = false;
             break;
         }
         case kMaxVertexBufferType:
@@ -255,6 +303,9 @@ public:
         }
         return 0;
     }
+    GLuint indexBufferName() const {
+        return m_indexBuffer;
+    }
     inline void dumpFeedbackOutput(GLuint program, int nindices) const {
         char name[128];
         GLsizei length(0), size(0);
@@ -266,6 +317,15 @@ public:
     }
 
 private:
+    bool isSharedVertexBuffer(GLuint name) const {
+        const int numSharedVertexBuffers = m_sharedVertexBuffers.count();
+        for (int i = 0; i < numSharedVertexBuffers; i++) {
+            if (*m_sharedVertexBuffers.value(i) == name) {
+                return true;
+            }
+        }
+        return false;
+    }
     GLuint internalCreate(GLenum target, GLenum usage, const void *ptr, vsize size) {
         GLuint name;
         genBuffers(1, &name);
@@ -326,8 +386,10 @@ private:
     PFNGLMAPBUFFERRANGEPROC mapBufferRange;
 
     Hash<HashInt, GLuint> m_vertexBuffers;
+    Hash<HashInt, GLuint> m_sharedVertexBuffers;
     GLuint m_indexBuffer;
     GLuint m_query;
+    bool m_indexBufferShared;
 #ifdef VPVL2_ENABLE_GLES2
     Array<uint8_t> m_bytes;
 #endif
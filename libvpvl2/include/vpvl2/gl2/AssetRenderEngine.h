@@ -48,10 +48,7 @@
 #include "vpvl2/IRenderEngine.h"
 #include "vpvl2/gl/VertexBundleLayout.h"
 
-struct aiMaterial;
-struct aiMesh;
-struct aiNode;
-struct aiScene;
+#include <string>
 
 namespace vpvl2
 {
@@ -134,22 +131,17 @@ private:
         Vector3 texcoord;
     };
     typedef Array<Vertex> Vertices;
-    typedef Array<int> Indices;
+    typedef Array<uint32> Indices;
     class PrivateContext;
-    bool uploadRecurse(const aiScene *scene, const aiNode *node, void *userData);
-    void deleteRecurse(const aiScene *scene, const aiNode *node);
-    void renderRecurse(const aiScene *scene, const aiNode *node);
-    void renderZPlotRecurse(const aiScene *scene, const aiNode *node);
-    void setAssetMaterial(const aiMaterial *material, Program *program);
+    bool uploadTexture(const std::string &path, void *userData);
+    void setAssetMaterial(int batchIndex, Program *program);
     bool createProgram(BaseShaderProgram *program,
                        IApplicationContext::ShaderType vertexShaderType,
                        IApplicationContext::ShaderType fragmentShaderType,
                        void *userData);
-    void createVertexBundle(const aiMesh *mesh,
-                            const Vertices &vertices,
-                            const Indices &indices);
-    void bindVertexBundle(const aiMesh *mesh);
-    void unbindVertexBundle(const aiMesh *mesh);
+    void createVertexBundle(const Vertices &vertices, const Indices &indices);
+    void bindVertexBundle();
+    void unbindVertexBundle();
     void bindStaticVertexAttributePointers();
 
     IApplicationContext *m_applicationContextRef;
@@ -97,6 +97,7 @@ private:
     typedef void (GLAPIENTRY * PFNGLENABLEPROC) (gl::GLenum cap);
     typedef void (GLAPIENTRY * PFNGLDISABLEPROC) (gl::GLenum cap);
     typedef void (GLAPIENTRY * PFNGLDRAWELEMENTSPROC) (gl::GLenum mode, gl::GLsizei count, gl::GLenum type, const gl::GLvoid *indices);
+    typedef void (GLAPIENTRY * PFNGLDRAWELEMENTSBASEVERTEXPROC) (gl::GLenum mode, gl::GLsizei count, gl::GLenum type, const gl::GLvoid *indices, gl::GLint basevertex);
     typedef void (GLAPIENTRY * PFNGLGENQUERIESPROC) (gl::GLsizei n, gl::GLuint* ids);
     typedef void (GLAPIENTRY * PFNGLBEGINQUERYPROC) (gl::GLenum target, gl::GLuint id);
     typedef void (GLAPIENTRY * PFNGLENDQUERYPROC) (gl::GLenum target);
@@ -108,6 +109,7 @@ private:
     PFNGLENABLEPROC enable;
     PFNGLDISABLEPROC disable;
     PFNGLDRAWELEMENTSPROC drawElements;
+    PFNGLDRAWELEMENTSBASEVERTEXPROC drawElementsBaseVertex;
     PFNGLGENQUERIESPROC genQueries;
     PFNGLBEGINQUERYPROC beginQuery;
     PFNGLENDQUERYPROC endQuery;
@@ -131,6 +133,9 @@ private:
     void bindDynamicVertexAttributePointers();
     void bindEdgeVertexAttributePointers();
     void bindStaticVertexAttributePointers();
+    void drawIndices(int nindices, vsize offset);
+    template<typename TProgram>
+    void drawMaterial(TProgram *program, int materialIndex, int nindices, vsize offset);
 
     cl::PMXAccelerator *m_accelerator;
     IApplicationContext *m_applicationContextRef;
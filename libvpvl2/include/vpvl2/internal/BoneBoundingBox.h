@@ -0,0 +1,275 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_INTERNAL_BONEBOUNDINGBOX_H_
+#define VPVL2_INTERNAL_BONEBOUNDINGBOX_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IBone.h"
+#include "vpvl2/IMaterial.h"
+#include "vpvl2/IMorph.h"
+#include "vpvl2/IVertex.h"
+#include "vpvl2/internal/util.h"
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace internal
+{
+
+/**
+ * Bind pose extents of vertices grouped by the bone that deforms them.
+ *
+ * A BDEF skinned position is a convex combination of the bone transformed positions, so the union
+ * of each bone's extents transformed by its current local (skinning) transform always contains
+ * the skinned mesh. Vertex morphs are covered by growing each vertex by the sum of its morph offsets.
+ *
+ * SDEF rotates a vertex around the blended center instead, so each SDEF vertex is grown by twice
+ * its distance to the center (plus the distances of R0/R1 to the center) that bounds the difference
+ * between the blended rotation and the linear blend. QDEF (dual quaternion) has no such bound and
+ * the whole model is reported as not computable. Edges are extruded along normals by a camera
+ * dependent width, so the largest vertex edge size of each material is kept for the caller to pad.
+ */
+class BoneBoundingBox VPVL2_DECL_FINAL {
+public:
+    struct Extent {
+        Extent()
+            : boneRef(0),
+              min(kZeroV3),
+              max(kZeroV3)
+        {
+        }
+        const IBone *boneRef;
+        Vector3 min;
+        Vector3 max;
+    };
+
+    BoneBoundingBox()
+        : m_built(false),
+          m_hasDualQuaternionVertices(false)
+    {
+    }
+    ~BoneBoundingBox() {
+        invalidate();
+    }
+
+    static inline void transformExtent(const Transform &transform, const Vector3 &min, const Vector3 &max,
+                                       Vector3 &aabbMin, Vector3 &aabbMax) VPVL2_DECL_NOEXCEPT {
+        const Matrix3x3 &basis = transform.getBasis().absolute();
+        const Vector3 &center = transform * ((min + max) * 0.5f), &extent = basis * ((max - min) * 0.5f);
+        aabbMin.setMin(center - extent);
+        aabbMax.setMax(center + extent);
+    }
+
+    template<typename TBone, typename TVertex, typename TMaterial, typename TMorph>
+    void build(const Array<TBone *> &bones,
+               const Array<TVertex *> &vertices,
+               const Array<int> &indices,
+               const Array<TMaterial *> &materials,
+               const Array<TMorph *> &morphs) {
+        invalidate();
+        const int nbones = bones.count(), nvertices = vertices.count(), nindices = indices.count();
+        Array<Scalar> paddings;
+        paddings.resize(nvertices);
+        for (int i = 0; i < nvertices; i++) {
+            paddings[i] = 0;
+        }
+        Array<IMorph::Vertex *> vertexMorphs;
+        for (int i = 0, nmorphs = morphs.count(); i < nmorphs; i++) {
+            const TMorph *morph = morphs[i];
+            if (morph->type() != IMorph::kVertexMorph) {
+                continue;
+            }
+            morph->getVertexMorphs(vertexMorphs);
+            for (int j = 0, nvertexMorphs = vertexMorphs.count(); j < nvertexMorphs; j++) {
+                const IMorph::Vertex *v = vertexMorphs[j];
+                const int index = v->vertex ? v->vertex->index() : int(v->index);
+                if (checkBound(index, 0, nvertices)) {
+                    paddings[index] += v->position.length();
+                }
+            }
+        }
+        Array<Extent> extents;
+        Array<int> stamps;
+        extents.resize(nbones);
+        stamps.resize(nbones);
+        for (int i = 0; i < nbones; i++) {
+            stamps[i] = -1;
+        }
+        for (int i = 0; i < nvertices; i++) {
+            const TVertex *vertex = vertices[i];
+            switch (vertex->type()) {
+            case IVertex::kSdef: {
+                const Vector3 &center = vertex->sdefC();
+                paddings[i] += vertex->origin().distance(center) * 2
+                        + vertex->sdefR0().distance(center) + vertex->sdefR1().distance(center);
+                break;
+            }
+            case IVertex::kQdef:
+                m_hasDualQuaternionVertices = true;
+                break;
+            default:
+                break;
+            }
+            expand(vertex, paddings[i], 0, extents, stamps);
+        }
+        collect(extents, stamps, 0, m_boneExtents);
+        /* material extents use own bone set to keep small parts (eyes, accessories) tight */
+        const int nmaterials = materials.count();
+        m_materialOffsets.append(0);
+        for (int i = 0, offset = 0; i < nmaterials; i++) {
+            const int stamp = i + 1, nmaterialIndices = materials[i]->indexRange().count;
+            Scalar edgeSize = 0;
+            for (int j = offset, end = btMin(offset + nmaterialIndices, nindices); j < end; j++) {
+                const int index = indices[j];
+                if (checkBound(index, 0, nvertices)) {
+                    const TVertex *vertex = vertices[index];
+                    expand(vertex, paddings[index], stamp, extents, stamps);
+                    edgeSize = btMax(edgeSize, Scalar(vertex->edgeSize()));
+                }
+            }
+            collect(extents, stamps, stamp, m_materialExtents);
+            m_materialOffsets.append(m_materialExtents.count());
+            m_materialEdgeSizes.append(edgeSize);
+            offset += nmaterialIndices;
+        }
+        m_built = true;
+    }
+    bool compute(Vector3 &aabbMin, Vector3 &aabbMax, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const {
+        if (!m_built || m_hasDualQuaternionVertices || m_boneExtents.count() == 0) {
+            return false;
+        }
+        aabbMin.setValue(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY);
+        aabbMax.setValue(-SIMD_INFINITY, -SIMD_INFINITY, -SIMD_INFINITY);
+        for (int i = 0, nextents = m_boneExtents.count(); i < nextents; i++) {
+            const Extent &extent = m_boneExtents[i];
+            transformExtent(extent.boneRef->localTransform(), extent.min, extent.max, aabbMin, aabbMax);
+        }
+        if (materialAabbs) {
+            materialAabbs->clear();
+            for (int i = 0, nmaterials = m_materialOffsets.count() - 1; i < nmaterials; i++) {
+                Vector3 materialMin(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY),
+                        materialMax(-SIMD_INFINITY, -SIMD_INFINITY, -SIMD_INFINITY);
+                for (int j = m_materialOffsets[i], end = m_materialOffsets[i + 1]; j < end; j++) {
+                    const Extent &extent = m_materialExtents[j];
+                    transformExtent(extent.boneRef->localTransform(), extent.min, extent.max, materialMin, materialMax);
+                }
+                materialAabbs->append(materialMin);
+                materialAabbs->append(materialMax);
+            }
+        }
+        if (materialEdgeSizes) {
+            materialEdgeSizes->copy(m_materialEdgeSizes);
+        }
+        return true;
+    }
+    void invalidate() {
+        m_boneExtents.clear();
+        m_materialExtents.clear();
+        m_materialOffsets.clear();
+        m_materialEdgeSizes.clear();
+        m_built = false;
+        m_hasDualQuaternionVertices = false;
+    }
+    bool isBuilt() const VPVL2_DECL_NOEXCEPT {
+        return m_built;
+    }
+
+private:
+    static inline bool isInfluenced(const IVertex *vertex, int index) VPVL2_DECL_NOEXCEPT {
+        switch (vertex->type()) {
+        case IVertex::kBdef1:
+            return index == 0;
+        case IVertex::kBdef2:
+        case IVertex::kSdef: {
+            const IVertex::WeightPrecision &weight = vertex->weight(0);
+            return index == 0 ? !btFuzzyZero(Scalar(weight)) : (index == 1 && !btFuzzyZero(Scalar(1 - weight)));
+        }
+        case IVertex::kBdef4:
+        case IVertex::kQdef:
+            return index < 4 && vertex->weight(index) > 0;
+        default:
+            return false;
+        }
+    }
+    static inline void expand(const IVertex *vertex, const Scalar &padding, int stamp, Array<Extent> &extents, Array<int> &stamps) {
+        const Vector3 &origin = vertex->origin(), radius(padding, padding, padding);
+        const int nbones = extents.count();
+        for (int i = 0; i < 4; i++) {
+            const IBone *bone = isInfluenced(vertex, i) ? vertex->boneRef(i) : 0;
+            const int boneIndex = bone ? bone->index() : -1;
+            if (!checkBound(boneIndex, 0, nbones)) {
+                continue;
+            }
+            Extent &extent = extents[boneIndex];
+            if (stamps[boneIndex] != stamp) {
+                stamps[boneIndex] = stamp;
+                extent.boneRef = bone;
+                extent.min = origin - radius;
+                extent.max = origin + radius;
+            }
+            else {
+                extent.min.setMin(origin - radius);
+                extent.max.setMax(origin + radius);
+            }
+        }
+    }
+    static inline void collect(const Array<Extent> &extents, const Array<int> &stamps, int stamp, Array<Extent> &values) {
+        for (int i = 0, nextents = extents.count(); i < nextents; i++) {
+            if (stamps[i] == stamp) {
+                values.append(extents[i]);
+            }
+        }
+    }
+
+    Array<Extent> m_boneExtents;
+    Array<Extent> m_materialExtents;
+    Array<int> m_materialOffsets;
+    Array<Scalar> m_materialEdgeSizes;
+    bool m_built;
+    bool m_hasDualQuaternionVertices;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(BoneBoundingBox)
+};
+
+} /* namespace internal */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
+
+#endif
@@ -0,0 +1,355 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_INTERNAL_BONEPALETTE_H_
+#define VPVL2_INTERNAL_BONEPALETTE_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IBone.h"
+#include "vpvl2/IVertex.h"
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace internal
+{
+
+/**
+ * Splits materials into subsets that each reference at most a fixed number of bones
+ * so vertex shader skinning only has to upload a small matrix palette per draw.
+ *
+ * Every bone gets one palette slot for the whole model, chosen so that no two bones sharing
+ * a triangle get the same slot. A vertex therefore has the same relative bone indices in
+ * every subset that references it and no vertex has to be duplicated. Subsets are contiguous
+ * runs of triangles in the original index order, so the index buffer is left as it is.
+ *
+ * If the slots cannot be assigned (a bone shares triangles with too many other bones),
+ * each bone keeps its own index as a slot and each material becomes one subset referencing
+ * the whole skeleton.
+ */
+class BonePalette VPVL2_DECL_FINAL {
+public:
+    static const int kMaxVertexBones = 4;
+    static const int kDefaultPaletteSize = 50;
+
+    struct Subset {
+        Subset()
+            : indexOffset(0),
+              indexCount(0)
+        {
+        }
+        /* offset from the first index of the material */
+        int indexOffset;
+        int indexCount;
+        /* palette slot to bone index, -1 for unused slots */
+        Array<int> boneIndices;
+    };
+
+    static int countVertexBones(const IVertex *vertex) {
+        switch (vertex->type()) {
+        case IVertex::kBdef1:
+            return 1;
+        case IVertex::kBdef2:
+        case IVertex::kSdef:
+            return 2;
+        case IVertex::kBdef4:
+        case IVertex::kQdef:
+            return 4;
+        case IVertex::kMaxType:
+        default:
+            return 0;
+        }
+    }
+    template<typename TVertex>
+    static void collectVertexBones(const Array<TVertex *> &vertices, Array<int> &vertexBones) {
+        const int nvertices = vertices.count();
+        vertexBones.resize(nvertices * kMaxVertexBones);
+        for (int i = 0; i < nvertices; i++) {
+            const IVertex *vertex = vertices[i];
+            const int nbones = countVertexBones(vertex);
+            int *bonesPtr = &vertexBones[i * kMaxVertexBones];
+            for (int j = 0; j < kMaxVertexBones; j++) {
+                const IBone *bone = j < nbones ? vertex->boneRef(j) : 0;
+                bonesPtr[j] = bone ? bone->index() : -1;
+            }
+        }
+    }
+
+    explicit BonePalette(int paletteSize = kDefaultPaletteSize)
+        : m_paletteSize(btMax(paletteSize, kMaxVertexBones * 3)),
+          m_generation(0),
+          m_built(false),
+          m_fallback(false)
+    {
+    }
+    ~BonePalette() {
+        release();
+    }
+
+    /**
+     * Builds subsets from bones of each vertex (kMaxVertexBones entries per vertex, -1 is unused),
+     * the triangle indices and the index count of each material.
+     *
+     * Returns false if the palette slots could not be assigned and the whole skeleton fallback is used.
+     */
+    bool build(const Array<int> &vertexBones, const Array<int> &indices, const Array<int> &materialIndexCounts) {
+        release();
+        const int nvertices = vertexBones.count() / kMaxVertexBones;
+        int nbones = 0;
+        for (int i = 0, nitems = nvertices * kMaxVertexBones; i < nitems; i++) {
+            nbones = btMax(nbones, vertexBones[i] + 1);
+        }
+        m_boneSlots.resize(nbones);
+        for (int i = 0; i < nbones; i++) {
+            m_boneSlots[i] = -1;
+        }
+        m_fallback = !assignSlots(vertexBones, indices, nbones);
+        if (m_fallback) {
+            for (int i = 0; i < nbones; i++) {
+                m_boneSlots[i] = i;
+            }
+        }
+        buildSubsets(vertexBones, indices, materialIndexCounts, nbones);
+        m_built = true;
+        return !m_fallback;
+    }
+    void release() {
+        m_subsets.releaseAll();
+        m_materialSubsetOffsets.clear();
+        m_boneSlots.clear();
+        m_generation++;
+        m_built = false;
+        m_fallback = false;
+    }
+
+    int countSubsets(int materialIndex) const {
+        if (materialIndex >= 0 && materialIndex < m_materialSubsetOffsets.count() - 1) {
+            return m_materialSubsetOffsets[materialIndex + 1] - m_materialSubsetOffsets[materialIndex];
+        }
+        return 0;
+    }
+    int findSubsetIndex(int materialIndex, int subsetIndex) const {
+        if (subsetIndex >= 0 && subsetIndex < countSubsets(materialIndex)) {
+            return m_materialSubsetOffsets[materialIndex] + subsetIndex;
+        }
+        return -1;
+    }
+    const Subset *subsetAt(int materialIndex, int subsetIndex) const {
+        return subsetAt(findSubsetIndex(materialIndex, subsetIndex));
+    }
+    int countAllSubsets() const {
+        return m_subsets.count();
+    }
+    const Subset *subsetAt(int index) const {
+        return index >= 0 && index < m_subsets.count() ? m_subsets[index] : 0;
+    }
+    int boneSlot(int boneIndex) const {
+        return boneIndex >= 0 && boneIndex < m_boneSlots.count() ? m_boneSlots[boneIndex] : -1;
+    }
+    int paletteSize() const {
+        return m_paletteSize;
+    }
+    /* changes whenever the subsets are released or rebuilt, so holders of per subset data can detect stale layouts */
+    uint32 generation() const {
+        return m_generation;
+    }
+    bool isBuilt() const {
+        return m_built;
+    }
+    bool isFallback() const {
+        return m_fallback;
+    }
+
+private:
+    static int collectTriangleBones(const Array<int> &vertexBones, const Array<int> &indices, int offset, int nindices, int *bones) {
+        int nbones = 0;
+        for (int i = 0; i < nindices; i++) {
+            const int *bonesPtr = &vertexBones[indices[offset + i] * kMaxVertexBones];
+            for (int j = 0; j < kMaxVertexBones; j++) {
+                const int boneIndex = bonesPtr[j];
+                bool found = boneIndex < 0;
+                for (int k = 0; k < nbones && !found; k++) {
+                    found = bones[k] == boneIndex;
+                }
+                if (!found) {
+                    bones[nbones++] = boneIndex;
+                }
+            }
+        }
+        return nbones;
+    }
+    bool assignSlots(const Array<int> &vertexBones, const Array<int> &indices, int nbones) {
+        /* bones sharing a triangle must not share a slot, so collect neighbours first */
+        PointerArray< Array<int> > neighbours;
+        Array<int> order;
+        Array<uint8> visited;
+        neighbours.reserve(nbones);
+        visited.resize(nbones);
+        for (int i = 0; i < nbones; i++) {
+            neighbours.append(new Array<int>());
+            visited[i] = false;
+        }
+        int triangleBones[kMaxVertexBones * 3];
+        for (int offset = 0, nindices = indices.count(); offset < nindices; offset += 3) {
+            const int ntriangleBones = collectTriangleBones(vertexBones, indices, offset, btMin(3, nindices - offset), triangleBones);
+            for (int i = 0; i < ntriangleBones; i++) {
+                const int boneIndex = triangleBones[i];
+                Array<int> *neighbourRefs = neighbours[boneIndex];
+                for (int j = 0; j < ntriangleBones; j++) {
+                    const int neighbourIndex = triangleBones[j];
+                    if (neighbourIndex != boneIndex && neighbourRefs->count() < m_paletteSize) {
+                        bool found = false;
+                        for (int k = 0, nneighbours = neighbourRefs->count(); k < nneighbours && !found; k++) {
+                            found = neighbourRefs->at(k) == neighbourIndex;
+                        }
+                        if (!found) {
+                            neighbourRefs->append(neighbourIndex);
+                        }
+                    }
+                }
+                if (!visited[boneIndex]) {
+                    /* first appearance order keeps bones of the same material on different slots */
+                    order.append(boneIndex);
+                    visited[boneIndex] = true;
+                }
+            }
+        }
+        Array<uint8> usedSlots;
+        usedSlots.resize(m_paletteSize);
+        int cursor = 0;
+        bool succeeded = true;
+        for (int i = 0, norders = order.count(); i < norders && succeeded; i++) {
+            const int boneIndex = order[i];
+            const Array<int> *neighbourRefs = neighbours[boneIndex];
+            const int nneighbours = neighbourRefs->count();
+            if (nneighbours >= m_paletteSize) {
+                succeeded = false;
+                break;
+            }
+            for (int j = 0; j < m_paletteSize; j++) {
+                usedSlots[j] = false;
+            }
+            for (int j = 0; j < nneighbours; j++) {
+                const int slot = m_boneSlots[neighbourRefs->at(j)];
+                if (slot >= 0) {
+                    usedSlots[slot] = true;
+                }
+            }
+            /* round robin so bones introduced together end up on different slots */
+            for (int j = 0; j < m_paletteSize; j++) {
+                const int slot = (cursor + j) % m_paletteSize;
+                if (!usedSlots[slot]) {
+                    m_boneSlots[boneIndex] = slot;
+                    cursor = slot + 1;
+                    break;
+                }
+            }
+        }
+        neighbours.releaseAll();
+        return succeeded;
+    }
+    void buildSubsets(const Array<int> &vertexBones, const Array<int> &indices, const Array<int> &materialIndexCounts, int nbones) {
+        const int nslots = m_fallback ? nbones : m_paletteSize;
+        Array<int> slotBones;
+        slotBones.resize(nslots);
+        int triangleBones[kMaxVertexBones * 3];
+        const int nmaterials = materialIndexCounts.count(), nallIndices = indices.count();
+        for (int i = 0, offset = 0; i < nmaterials; i++) {
+            const int nindices = btMin(materialIndexCounts[i], nallIndices - offset);
+            m_materialSubsetOffsets.append(m_subsets.count());
+            Subset *subset = 0;
+            for (int j = 0; j < nindices; j += 3) {
+                const int ntriangleIndices = btMin(3, nindices - j);
+                const int ntriangleBones = collectTriangleBones(vertexBones, indices, offset + j, ntriangleIndices, triangleBones);
+                bool fit = subset != 0;
+                for (int k = 0; k < ntriangleBones && fit; k++) {
+                    const int boneIndex = slotBones[m_boneSlots[triangleBones[k]]];
+                    fit = boneIndex < 0 || boneIndex == triangleBones[k];
+                }
+                if (!fit) {
+                    if (subset) {
+                        closeSubset(subset, slotBones);
+                    }
+                    subset = m_subsets.append(new Subset());
+                    subset->indexOffset = j;
+                    for (int k = 0; k < nslots; k++) {
+                        slotBones[k] = -1;
+                    }
+                }
+                for (int k = 0; k < ntriangleBones; k++) {
+                    const int boneIndex = triangleBones[k];
+                    slotBones[m_boneSlots[boneIndex]] = boneIndex;
+                }
+                subset->indexCount += ntriangleIndices;
+            }
+            if (subset) {
+                closeSubset(subset, slotBones);
+            }
+            offset += btMax(nindices, 0);
+        }
+        m_materialSubsetOffsets.append(m_subsets.count());
+    }
+    static void closeSubset(Subset *subset, const Array<int> &slotBones) {
+        /* unused trailing slots are not uploaded */
+        int nslots = slotBones.count();
+        while (nslots > 0 && slotBones[nslots - 1] < 0) {
+            nslots--;
+        }
+        subset->boneIndices.resize(nslots);
+        for (int i = 0; i < nslots; i++) {
+            subset->boneIndices[i] = slotBones[i];
+        }
+    }
+
+    PointerArray<Subset> m_subsets;
+    Array<int> m_materialSubsetOffsets;
+    Array<int> m_boneSlots;
+    int m_paletteSize;
+    uint32 m_generation;
+    bool m_built;
+    bool m_fallback;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(BonePalette)
+};
+
+} /* namespace internal */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
+
+#endif
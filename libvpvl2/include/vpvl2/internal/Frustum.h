@@ -0,0 +1,149 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_INTERNAL_FRUSTUM_H_
+#define VPVL2_INTERNAL_FRUSTUM_H_
+
+#include "vpvl2/Common.h"
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace internal
+{
+
+/**
+ * Six planes of a view frustum extracted from a view projection matrix, used to cull
+ * axis aligned bounding boxes. The planes are stored in order of left, right, bottom,
+ * top, near and far and the normals point inside of the frustum.
+ */
+class Frustum VPVL2_DECL_FINAL {
+public:
+    enum PlaneType {
+        kLeftPlane,
+        kRightPlane,
+        kBottomPlane,
+        kTopPlane,
+        kNearPlane,
+        kFarPlane,
+        kMaxPlaneType
+    };
+
+    Frustum()
+        : m_enabled(false)
+    {
+        for (int i = 0; i < kMaxPlaneType; i++) {
+            m_normals[i].setZero();
+            m_distances[i] = 0;
+        }
+    }
+    ~Frustum() {
+        m_enabled = false;
+    }
+
+    /**
+     * Projects the box onto the ground plane (y = 0) along the light direction and returns
+     * the box bounding the projective shadow. Returns false if the light is parallel to the ground.
+     */
+    static inline bool projectOntoGround(const Vector3 &min, const Vector3 &max, const Vector3 &lightDirection,
+                                         Vector3 &shadowMin, Vector3 &shadowMax) VPVL2_DECL_NOEXCEPT {
+        if (btFuzzyZero(lightDirection.y())) {
+            return false;
+        }
+        shadowMin = min;
+        shadowMax = max;
+        for (int i = 0; i < 8; i++) {
+            const Vector3 corner((i & 1) ? max.x() : min.x(), (i & 2) ? max.y() : min.y(), (i & 4) ? max.z() : min.z());
+            const Vector3 &projected = corner - lightDirection * (corner.y() / lightDirection.y());
+            shadowMin.setMin(projected);
+            shadowMax.setMax(projected);
+        }
+        return true;
+    }
+
+    void setMatrix(const float32 *value) VPVL2_DECL_NOEXCEPT {
+        if (value) {
+            /* planes from rows of column major view projection matrix (Gribb/Hartmann) */
+            const Vector3 row3(value[3], value[7], value[11]);
+            for (int i = 0; i < 3; i++) {
+                const Vector3 row(value[i], value[i + 4], value[i + 8]);
+                m_normals[i * 2] = row3 + row;
+                m_distances[i * 2] = value[15] + value[i + 12];
+                m_normals[i * 2 + 1] = row3 - row;
+                m_distances[i * 2 + 1] = value[15] - value[i + 12];
+            }
+        }
+        m_enabled = value != 0;
+    }
+    void getPlane(PlaneType type, Vector3 &normal, Scalar &distance) const VPVL2_DECL_NOEXCEPT {
+        if (type >= 0 && type < kMaxPlaneType) {
+            normal = m_normals[type];
+            distance = m_distances[type];
+        }
+    }
+    bool intersects(const Vector3 &min, const Vector3 &max) const VPVL2_DECL_NOEXCEPT {
+        for (int i = 0; i < kMaxPlaneType; i++) {
+            const Vector3 &normal = m_normals[i];
+            const Vector3 v(normal.x() >= 0 ? max.x() : min.x(),
+                            normal.y() >= 0 ? max.y() : min.y(),
+                            normal.z() >= 0 ? max.z() : min.z());
+            /* a degenerated plane (far plane of infinite perspective) never rejects */
+            if (normal.dot(v) + m_distances[i] < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool isEnabled() const VPVL2_DECL_NOEXCEPT {
+        return m_enabled;
+    }
+
+private:
+    Vector3 m_normals[kMaxPlaneType];
+    Scalar m_distances[kMaxPlaneType];
+    bool m_enabled;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(Frustum)
+};
+
+} /* namespace internal */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
+
+#endif
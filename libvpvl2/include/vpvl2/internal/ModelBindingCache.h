@@ -0,0 +1,219 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_INTERNAL_MODELBINDINGCACHE_H_
+#define VPVL2_INTERNAL_MODELBINDINGCACHE_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IBone.h"
+#include "vpvl2/IEncoding.h"
+#include "vpvl2/IModel.h"
+#include "vpvl2/IMorph.h"
+#include "vpvl2/IString.h"
+#include "vpvl2/internal/util.h"
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace internal
+{
+
+/**
+ * Returns the generation of models that is advanced by advanceModelGeneration().
+ *
+ * Every model advances the generation on its destruction, so a binding cache built before
+ * the current generation may refer to a deleted model whose address is reused later. Models
+ * are deleted and motions are attached on the same thread as the rest of the scene.
+ */
+VPVL2_API int modelGeneration() VPVL2_DECL_NOEXCEPT;
+VPVL2_API void advanceModelGeneration() VPVL2_DECL_NOEXCEPT;
+
+/**
+ * Caches which bone or morph (T is IBone or IMorph) of a model each track of a motion drives.
+ *
+ * A motion identifies its tracks by their position in the array of track names and resolves
+ * all tracks once per model. Attaching the motion again to a model seen before reuses the
+ * cached objects after checking that the object count still matches and that each object
+ * is still at its cached index with the same name, so swapping motions between models does
+ * not look up every track by name again. The owner must call clear() whenever its track ids
+ * change. Bindings of all models are dropped once any model is deleted (see modelGeneration),
+ * so the cache never keeps entries of deleted models.
+ */
+template<typename T>
+class ModelBindingCache VPVL2_DECL_FINAL {
+public:
+    ModelBindingCache()
+        : m_generation(modelGeneration())
+    {
+    }
+    ~ModelBindingCache() {
+        clear();
+    }
+
+    /**
+     * Returns the object of each track name (null if the model has no object of the name).
+     *
+     * The returned array is owned by the cache and valid until the next call of resolve or clear.
+     */
+    const Array<T *> &resolve(const IModel *model, const Array<const IString *> &names) {
+        const int generation = modelGeneration();
+        if (m_generation != generation) {
+            m_bindings.releaseAll();
+            m_generation = generation;
+        }
+        Binding *binding = 0;
+        if (Binding *const *bindingPtr = m_bindings.find(model)) {
+            binding = *bindingPtr;
+            if (!isValid(binding, model, names)) {
+                m_bindings.remove(model);
+                /* deleteObject also resets binding to rebuild below */
+                deleteObject(binding);
+            }
+        }
+        if (!binding) {
+            binding = m_bindings.insert(model, new Binding());
+            build(binding, model, names);
+        }
+        return binding->objectRefs;
+    }
+    void remove(const IModel *model) {
+        if (Binding *const *bindingPtr = m_bindings.find(model)) {
+            Binding *binding = *bindingPtr;
+            m_bindings.remove(model);
+            deleteObject(binding);
+        }
+    }
+    void clear() {
+        m_bindings.releaseAll();
+    }
+    int countBindings() const {
+        return m_bindings.count();
+    }
+
+private:
+    struct Binding {
+        Binding()
+            : nobjects(0)
+        {
+        }
+        Array<T *> objectRefs;
+        Array<int> indices;
+        int nobjects;
+    };
+
+    static T *findObjectRef(const IModel *model, const IString *name);
+    static T *findObjectRefAt(const IModel *model, int index);
+    static int countObjects(const IModel *model);
+
+    static bool isValid(const Binding *binding, const IModel *model, const Array<const IString *> &names) {
+        const int nnames = names.count();
+        if (binding->objectRefs.count() != nnames || binding->nobjects != countObjects(model)) {
+            return false;
+        }
+        for (int i = 0; i < nnames; i++) {
+            if (const T *object = binding->objectRefs[i]) {
+                /* interned names make this a pointer comparison in most cases */
+                if (findObjectRefAt(model, binding->indices[i]) != object ||
+                        !names[i]->equals(object->name(IEncoding::kDefaultLanguage))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    static void build(Binding *binding, const IModel *model, const Array<const IString *> &names) {
+        const int nnames = names.count();
+        binding->objectRefs.resize(nnames);
+        binding->indices.resize(nnames);
+        for (int i = 0; i < nnames; i++) {
+            const IString *name = names[i];
+            T *object = name ? findObjectRef(model, name) : 0;
+            binding->objectRefs[i] = object;
+            binding->indices[i] = object ? object->index() : -1;
+        }
+        binding->nobjects = countObjects(model);
+    }
+
+    PointerHash<HashPtr, Binding> m_bindings;
+    int m_generation;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(ModelBindingCache)
+};
+
+template<>
+inline IBone *ModelBindingCache<IBone>::findObjectRef(const IModel *model, const IString *name)
+{
+    return model->findBoneRef(name);
+}
+
+template<>
+inline IBone *ModelBindingCache<IBone>::findObjectRefAt(const IModel *model, int index)
+{
+    return model->findBoneRefAt(index);
+}
+
+template<>
+inline int ModelBindingCache<IBone>::countObjects(const IModel *model)
+{
+    return model->count(IModel::kBone);
+}
+
+template<>
+inline IMorph *ModelBindingCache<IMorph>::findObjectRef(const IModel *model, const IString *name)
+{
+    return model->findMorphRef(name);
+}
+
+template<>
+inline IMorph *ModelBindingCache<IMorph>::findObjectRefAt(const IModel *model, int index)
+{
+    return model->findMorphRefAt(index);
+}
+
+template<>
+inline int ModelBindingCache<IMorph>::countObjects(const IModel *model)
+{
+    return model->count(IModel::kMorph);
+}
+
+} /* namespace internal */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
+
+#endif
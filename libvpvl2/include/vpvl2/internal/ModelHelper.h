@@ -90,6 +90,35 @@ public:
         outPosition.setInterpolate3(v2, v1, w);
         outNormal.setInterpolate3(n2, n1, w);
     }
+    static inline void performSkinning(const IModel *modelRef,
+                                       const IModel::DynamicVertexBuffer *dynamicBuffer,
+                                       void *address,
+                                       const Vector3 &cameraPosition,
+                                       bool enableExactAabb,
+                                       Array<uint8> &scratchBuffer,
+                                       Array<Vector3> &exactAabbs,
+                                       Vector3 &aabbMin,
+                                       Vector3 &aabbMax)
+    {
+        if (enableExactAabb) {
+            /* the mapped buffer is write only, so skin into a scratch buffer and read positions back from it */
+            const vsize size = dynamicBuffer->size();
+            scratchBuffer.resize(int(size));
+            uint8 *scratchPtr = &scratchBuffer[0];
+            dynamicBuffer->performTransform(scratchPtr, cameraPosition);
+            copyBytes(static_cast<uint8 *>(address), scratchPtr, size);
+            exactAabbs.clear();
+            dynamicBuffer->computeAabb(scratchPtr, exactAabbs);
+            const int naabbs = exactAabbs.count();
+            aabbMin = exactAabbs[naabbs - 2];
+            aabbMax = exactAabbs[naabbs - 1];
+        }
+        else {
+            /* O(bones): derived from the bone local extents precomputed at load */
+            dynamicBuffer->performTransform(address, cameraPosition);
+            modelRef->computeConservativeAabb(aabbMin, aabbMax, 0, 0);
+        }
+    }
     static inline uint8 adjustSharedToonTextureIndex(uint8 value) VPVL2_DECL_NOEXCEPT {
         return (value == 0xff) ? 0 : value + 1;
     }
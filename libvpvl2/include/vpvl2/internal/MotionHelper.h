@@ -100,6 +100,49 @@ public:
         fromIndex = toIndex <= 1 ? 0 : toIndex - 1;
         lastIndex = fromIndex;
     }
+    template<typename T>
+    static bool isKeyframesSorted(const Array<T *> &keyframes) VPVL2_DECL_NOEXCEPT
+    {
+        const int nkeyframes = keyframes.count();
+        for (int i = 1; i < nkeyframes; i++) {
+            if (keyframes[i]->timeIndex() < keyframes[i - 1]->timeIndex()) {
+                return false;
+            }
+        }
+        return true;
+    }
+    template<typename T>
+    static bool appendKeyframe(T *keyframe, Array<T *> &keyframes)
+    {
+        /*
+         * returns false if the keyframe breaks the order, callers sort once after adding all keyframes
+         * instead of inserting each keyframe into the sorted position
+         */
+        const int nkeyframes = keyframes.count();
+        keyframes.append(keyframe);
+        return nkeyframes == 0 || !(keyframe->timeIndex() < keyframes[nkeyframes - 1]->timeIndex());
+    }
+    template<typename T>
+    static bool removeKeyframeSorted(const IKeyframe *keyframe, Array<T *> &keyframes)
+    {
+        /* Array#remove swaps with the last item, so shift manually to keep the order */
+        const int nkeyframes = keyframes.count();
+        int index = -1;
+        for (int i = 0; i < nkeyframes; i++) {
+            if (keyframes[i] == keyframe) {
+                index = i;
+                break;
+            }
+        }
+        if (index >= 0) {
+            for (int i = index; i < nkeyframes - 1; i++) {
+                keyframes[i] = keyframes[i + 1];
+            }
+            keyframes.resize(nkeyframes - 1);
+            return true;
+        }
+        return false;
+    }
     template<typename TMotion>
     static inline bool isReachedToDuration(const TMotion &motion, const IKeyframe::TimeIndex &atEnd) VPVL2_DECL_NOEXCEPT
     {
@@ -41,6 +41,7 @@
 
 #include <vpvl2/Common.h>
 #include <vpvl2/IMaterial.h>
+#include <vpvl2/IModel.h>
 
 #ifdef VPVL2_LINK_INTEL_TBB
 #include <tbb/tbb.h>
@@ -357,18 +358,24 @@ private:
 template<typename TMaterial, typename TUnit>
 class ParallelComputeAabbProcessor VPVL2_DECL_FINAL {
 public:
-    ParallelComputeAabbProcessor(const Array<TMaterial *> *materials, Array<Vector3> *value, const void *address)
+    ParallelComputeAabbProcessor(const Array<TMaterial *> *materials,
+                                 const IModel::IndexBuffer *indexBufferRef,
+                                 Array<Vector3> *value,
+                                 const void *address)
         : m_materials(materials),
+          m_indexBufferRef(indexBufferRef),
           m_bufferRef(static_cast<const TUnit *>(address)),
           m_aabb(value)
     {
     }
     ~ParallelComputeAabbProcessor() {
+        m_indexBufferRef = 0;
         m_bufferRef = 0;
     }
 
-    static inline void performTransform(int i, const TUnit *bufferRef, Vector3 &min, Vector3 &max) {
-        const TUnit &v = bufferRef[i];
+    static inline void performTransform(int i, const IModel::IndexBuffer *indexBufferRef, const TUnit *bufferRef, Vector3 &min, Vector3 &max) {
+        /* material ranges address the index buffer, not the vertex buffer */
+        const TUnit &v = bufferRef[indexBufferRef->indexAt(i)];
         const Vector3 &position = v.position;
         min.setMin(position);
         max.setMax(position);
@@ -376,19 +383,22 @@ public:
 
 #ifdef VPVL2_LINK_INTEL_TBB
     struct MaterialAabb {
+        const IModel::IndexBuffer *indexBufferRef;
         const TUnit *bufferRef;
         Vector3 min;
         Vector3 max;
         MaterialAabb()
-            : bufferRef(0),
+            : indexBufferRef(0),
+              bufferRef(0),
               min(kAabbMin),
               max(kAabbMax)
         {
         }
         MaterialAabb(const MaterialAabb &self, tbb::split /* split */)
-            : bufferRef(self.bufferRef),
-              min(self.min),
-              max(self.max)
+            : indexBufferRef(self.indexBufferRef),
+              bufferRef(self.bufferRef),
+              min(kAabbMin),
+              max(kAabbMax)
         {
         }
         void join(const MaterialAabb &self) VPVL2_DECL_NOEXCEPT {
@@ -396,12 +406,10 @@ public:
             max.setMax(self.max);
         }
         void operator()(const tbb::blocked_range<int> &range) {
-            Vector3 aabbMin(kAabbMin), aabbMax(kAabbMax);
+            /* a body may be reused for several subranges, so accumulate instead of overwriting */
             for (int i = range.begin(), end = range.end(); i != end; ++i) {
-                performTransform(i, bufferRef, aabbMin, aabbMax);
+                performTransform(i, indexBufferRef, bufferRef, min, max);
             }
-            min = aabbMin;
-            max = aabbMax;
         }
     };
 #endif
@@ -409,18 +417,23 @@ public:
     void execute(bool enableParallel) {
         const int nmaterials = m_materials->count();
         Vector3 modelAabbMin(kAabbMin), modelAabbMax(kAabbMax);
+        int offset = 0;
 #if defined(VPVL2_LINK_INTEL_TBB)
         if (enableParallel) {
-            MaterialAabb aabb;
             for (int i = 0; i < nmaterials; i++) {
                 const IMaterial *material = m_materials->at(i);
-                const IMaterial::IndexRange &range = material->indexRange();
+                const int nindices = material->indexRange().count;
+                MaterialAabb aabb;
+                aabb.indexBufferRef = m_indexBufferRef;
                 aabb.bufferRef = m_bufferRef;
-                tbb::parallel_reduce(tbb::blocked_range<int>(range.start, range.count), aabb);
+                if (nindices > 0) {
+                    tbb::parallel_reduce(tbb::blocked_range<int>(offset, offset + nindices), aabb);
+                }
                 m_aabb->append(aabb.min);
                 m_aabb->append(aabb.max);
                 modelAabbMin.setMin(aabb.min);
                 modelAabbMax.setMax(aabb.max);
+                offset += nindices;
             }
         }
         else {
@@ -430,15 +443,16 @@ public:
 #endif /* VPVL2_LINK_INTEL_TBB */
             for (int i = 0; i < nmaterials; i++) {
                 const IMaterial *material = m_materials->at(i);
-                const IMaterial::IndexRange &range = material->indexRange();
+                const int nindices = material->indexRange().count;
                 Vector3 aabbMin(kAabbMin), aabbMax(kAabbMax);
-                for (int j = range.start, count = range.count; j < count; j++) {
-                    performTransform(i, m_bufferRef, aabbMin, aabbMax);
+                for (int j = offset, end = offset + nindices; j < end; j++) {
+                    performTransform(j, m_indexBufferRef, m_bufferRef, aabbMin, aabbMax);
                 }
                 m_aabb->append(aabbMin);
                 m_aabb->append(aabbMax);
                 modelAabbMin.setMin(aabbMin);
                 modelAabbMax.setMax(aabbMax);
+                offset += nindices;
             }
         }
         m_aabb->append(modelAabbMin);
@@ -447,6 +461,7 @@ public:
 
 private:
     const Array<TMaterial *> *m_materials;
+    const IModel::IndexBuffer *m_indexBufferRef;
     const TUnit *m_bufferRef;
     Array<Vector3> *m_aabb;
 };
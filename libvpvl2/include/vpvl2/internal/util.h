@@ -449,7 +449,11 @@ static inline void writeStringAsByteArray(const IString *string, const IEncoding
     int size = bufsiz;
     uint8 *bytes = encodingRef->toByteArray(string, codec, size);
     zerofill(dst, bufsiz);
-    writeBytes(bytes, size, dst);
+    if (bytes) {
+        copyBytes(dst, bytes, btMin(vsize(size), bufsiz));
+    }
+    /* the field is fixed length even if the converted string is shorter */
+    dst += bufsiz;
     encodingRef->disposeByteArray(bytes);
 }
 
@@ -478,6 +482,21 @@ static inline int memcmp(const void *left, const void *right, size_t size)
 #endif
 }
 
+static inline uint64 hashBytes(const void *data, vsize size, uint64 hash = 0)
+{
+    /* 64bit FNV-1a, starts from the offset basis if hash is zero */
+    static const uint64 kOffsetBasis = 14695981039346656037ull, kPrime = 1099511628211ull;
+    const uint8 *ptr = static_cast<const uint8 *>(data);
+    if (hash == 0) {
+        hash = kOffsetBasis;
+    }
+    for (vsize i = 0; i < size; i++) {
+        hash ^= ptr[i];
+        hash *= kPrime;
+    }
+    return hash;
+}
+
 static inline void dump(const Vector3 &v)
 {
     (void) v;
@@ -72,10 +72,14 @@ public:
     IEncoding *encodingRef() const;
 
 private:
+    int addNewName(const IString *name);
+
     PointerArray<const IString> m_strings;
     Hash<HashInt, const IString *> m_key2StringRefs;
     Hash<HashString, int> m_string2Keys;
+    Array<int> m_transientKeys;
     IEncoding *m_encoding;
+    int m_nextKey;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(NameListSection)
 };
@@ -125,6 +125,7 @@ public:
     void getMatrixBuffer(MatrixBuffer *&matrixBuffer, DynamicVertexBuffer *dynamicBuffer, const IndexBuffer *indexBuffer) const;
     void setAabb(const Vector3 &min, const Vector3 &max);
     void getAabb(Vector3 &min, Vector3 &max) const;
+    bool computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const;
     void setSkinnningEnable(bool value);
 
     float32 version() const;
@@ -51,6 +51,11 @@ namespace VPVL2_VERSION_NS
 class IEncoding;
 class IString;
 
+namespace internal
+{
+class BonePalette;
+} /* namespace internal */
+
 namespace pmd2
 {
 
@@ -166,6 +171,7 @@ public:
     bool preparse(const uint8 *data, vsize size, DataInfo &info);
     void setVisible(bool value);
     void getAabb(Vector3 &min, Vector3 &max) const;
+    bool computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const;
     void setAabb(const Vector3 &min, const Vector3 &max);
 
     float32 version() const;
@@ -217,6 +223,7 @@ public:
     const PointerArray<Label> &labels() const;
     const PointerArray<RigidBody> &rigidBodies() const;
     const PointerArray<Joint> &joints() const;
+    const internal::BonePalette *bonePaletteRef() const;
 
     void getIndexBuffer(IndexBuffer *&indexBuffer) const;
     void getStaticVertexBuffer(StaticVertexBuffer *&staticBuffer) const;
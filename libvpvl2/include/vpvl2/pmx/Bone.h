@@ -180,6 +180,17 @@ public:
     void setAngleLimit(float32 value);
     void getJointRefs(Array<IKJoint *> &value) const;
 
+    /**
+     * Append an IK link of the target bone to this bone.
+     *
+     * The link is owned by this bone. setHasInverseKinematics(true) and setEffectorBoneRef
+     * must also be called to be written by save.
+     *
+     * @param targetBoneRef A bone of the same model rotated by the IK solver
+     * @return The appended link
+     */
+    IKJoint *addIKJoint(IBone *targetBoneRef);
+
 private:
     struct PrivateContext;
     PrivateContext *m_context;
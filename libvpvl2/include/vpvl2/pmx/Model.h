@@ -51,6 +51,11 @@ namespace vpvl2
 {
 namespace VPVL2_VERSION_NS
 {
+namespace internal
+{
+class BonePalette;
+} /* namespace internal */
+
 namespace pmx
 {
 
@@ -147,6 +152,33 @@ public:
     void save(uint8 *data, vsize &written) const;
     vsize estimateSize() const;
 
+    /**
+     * Create a lightweight instance of the loaded model.
+     *
+     * The instance shares vertex attributes, indices and the serialized data of this model,
+     * and owns bones, morphs, materials, rigid bodies and joints to keep pose and physics
+     * independently. Returns null if the instance cannot be created.
+     *
+     * Note that the instance still creates a Vertex for every vertex to hold its bone and
+     * material references and morph deltas, so the memory of each instance is O(vertices)
+     * (about 150 bytes per vertex on 64-bit platforms) even though the attributes are shared.
+     *
+     * @return Model
+     */
+    Model *createInstance();
+
+    /**
+     * Returns an opaque pointer identifying data shared between instances, or null unless instanced.
+     *
+     * Render engines use this to share static vertex and index buffers.
+     */
+    const void *sharedDataRef() const;
+
+    /**
+     * Returns the bone palette partition used by vertex shader skinning, built once on the first call.
+     */
+    const internal::BonePalette *bonePaletteRef() const;
+
     void joinWorld(btDiscreteDynamicsWorld *worldRef);
     void leaveWorld(btDiscreteDynamicsWorld *worldRef);
     void resetAllVerticesTransform();
@@ -223,6 +255,7 @@ public:
                          const IndexBuffer *indexBuffer) const;
     void setAabb(const Vector3 &min, const Vector3 &max);
     void getAabb(Vector3 &min, Vector3 &max) const;
+    bool computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const;
 
     float32 version() const;
     void setVersion(float32 value);
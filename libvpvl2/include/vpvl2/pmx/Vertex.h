@@ -87,6 +87,15 @@ public:
      * @param size Size of vertex to be output
      */
     void read(const uint8 *data, const Model::DataInfo &info, vsize &size);
+    /**
+     * Share immutable attributes (position, normal, UVs and skinning weights) with the vertex.
+     *
+     * Setters copy shared attributes before modifying, so the source vertex is never changed.
+     * Bone and material references and morph deltas are still owned by each vertex.
+     *
+     * @param source The vertex to share attributes with
+     */
+    void shareAttributes(const Vertex *source);
     void write(uint8 *&data, const Model::DataInfo &info) const;
     vsize estimateSize(const Model::DataInfo &info) const;
     void reset();
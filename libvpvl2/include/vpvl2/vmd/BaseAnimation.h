@@ -71,21 +71,24 @@ public:
     virtual void read(const uint8 *data, int size) = 0;
     virtual void seek(const IKeyframe::TimeIndex &timeIndexAt) = 0;
     virtual void createFirstKeyframeUnlessFound() = 0;
+    virtual void update();
+    virtual void addKeyframe(IKeyframe *keyframe);
+    virtual void removeKeyframe(IKeyframe *keyframe);
     void advance(const IKeyframe::TimeIndex &deltaTimeIndex);
     void rewind(const IKeyframe::TimeIndex &target, const IKeyframe::TimeIndex &deltaTimeIndex);
     void reset();
-    void addKeyframe(IKeyframe *keyframe);
-    void removeKeyframe(IKeyframe *keyframe);
     void deleteKeyframe(IKeyframe *&keyframe);
     void getKeyframes(const IKeyframe::TimeIndex &timeIndex, Array<IKeyframe *> &keyframes) const;
     void getAllKeyframes(Array<IKeyframe *> &value) const;
     void setAllKeyframes(const Array<IKeyframe *> &value, IKeyframe::Type type);
+    void shareKeyframes(const BaseAnimation *source);
     IKeyframe::SmoothPrecision interpolateTimeIndex(const IKeyframe::TimeIndex &from, const IKeyframe::TimeIndex &to) const;
 
-    int countKeyframes() const { return m_keyframes.count(); }
+    int countKeyframes() const { return keyframeRefs().count(); }
     IKeyframe::TimeIndex previousTimeIndex() const { return m_previousTimeIndex; }
     IKeyframe::TimeIndex currentTimeIndex() const { return m_currentTimeIndex; }
     IKeyframe::TimeIndex duration() const { return m_durationTimeIndex; }
+    const BaseAnimation *sharedAnimationRef() const { return m_sharedAnimationRef; }
 
 protected:
     template<typename T>
@@ -107,12 +110,32 @@ protected:
         return -1;
     }
 
+    const Array<IKeyframe *> &keyframeRefs() const {
+        return m_sharedAnimationRef ? m_sharedAnimationRef->m_keyframes : m_keyframes;
+    }
+    void addKeyframeToBucket(IKeyframe *keyframe);
+    void removeKeyframeFromBucket(IKeyframe *keyframe);
+    void updateKeyframeBuckets();
+
+    /* always empty while m_sharedAnimationRef is set, use keyframeRefs() to read keyframes */
     PointerArray<IKeyframe> m_keyframes;
+    const BaseAnimation *m_sharedAnimationRef;
+    /* count of m_keyframes covered by the per track index of subclasses, -1 forces rebuilding */
+    int m_numIndexedKeyframes;
     int m_lastTimeIndex;
     IKeyframe::TimeIndex m_durationTimeIndex;
     IKeyframe::TimeIndex m_currentTimeIndex;
     IKeyframe::TimeIndex m_previousTimeIndex;
 
+private:
+    struct KeyframeBucket;
+    void appendKeyframeToBucket(IKeyframe *keyframe);
+    void rebuildKeyframeBuckets();
+    bool isKeyframeBucketsValid() const;
+
+    PointerHash<HashInt, KeyframeBucket> m_timeIndex2buckets;
+    int m_numBucketedKeyframes;
+
     VPVL2_DISABLE_COPY_AND_ASSIGN(BaseAnimation)
 };
 
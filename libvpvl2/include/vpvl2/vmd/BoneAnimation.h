@@ -51,6 +51,11 @@ namespace VPVL2_VERSION_NS
 
 class IEncoding;
 
+namespace internal
+{
+template<typename T> class ModelBindingCache;
+} /* namespace internal */
+
 namespace vmd
 {
 class BoneKeyframe;
@@ -75,15 +80,20 @@ public:
     void read(const uint8 *data, int size);
     void seek(const IKeyframe::TimeIndex &timeIndexAt);
     void createFirstKeyframeUnlessFound();
+    void update();
+    void addKeyframe(IKeyframe *keyframe);
+    void removeKeyframe(IKeyframe *keyframe);
     void reset();
     void setParentModelRef(IModel *model);
     BoneKeyframe *findKeyframeAt(int i) const;
     BoneKeyframe *findKeyframe(const IKeyframe::TimeIndex &timeIndex, const IString *name) const;
 
+    IModel *parentModelRef() const { return m_modelRef; }
     bool isNullFrameEnabled() const { return m_enableNullFrame; }
     void setNullFrameEnable(bool value) { m_enableNullFrame = value; }
 
 private:
+    struct Track;
     struct PrivateContext;
     static IKeyframe::SmoothPrecision weightValue(const BoneKeyframe *keyFrame,
                                                   const IKeyframe::SmoothPrecision &w,
@@ -94,11 +104,23 @@ private:
                             const IKeyframe::SmoothPrecision &w,
                             int at,
                             IKeyframe::SmoothPrecision &value);
-    void createPrivateContexts(IModel *model);
+    const BoneAnimation *tracksOwnerRef() const;
+    void updateTracks();
+    void createPrivateContexts();
+    void bindPrivateContexts();
+    Track *resolveTrack(const IString *name);
+    void updateDurationTimeIndex();
     void calculateKeyframes(const IKeyframe::TimeIndex &timeIndexAt, PrivateContext *context);
 
     IEncoding *m_encodingRef;
-    PointerHash<HashString, PrivateContext> m_name2contexts;
+    /* owned tracks of keyframes by name, always empty while the keyframes are shared */
+    PointerHash<HashString, Track> m_name2tracks;
+    /* playback state of each track of tracksOwnerRef() in the same order */
+    PointerArray<PrivateContext> m_contexts;
+    /* advanced whenever m_name2tracks is changed, contexts are rebuilt on mismatch */
+    int m_tracksRevision;
+    int m_contextsRevision;
+    internal::ModelBindingCache<IBone> *m_bindingCache;
     IModel *m_modelRef;
     bool m_enableNullFrame;
 
@@ -73,6 +73,10 @@ public:
     void setDefaultInterpolationParameter();
     void getInterpolationParameter(InterpolationType type, QuadWord &value) const;
     void setInterpolationParameter(InterpolationType type, const QuadWord &value);
+    /**
+     * Sets parameters of all interpolation types and builds their tables once.
+     */
+    void setInterpolationParameters(const InterpolationParameter &value);
 
     VPVL2_KEYFRAME_DEFINE_METHODS()
     Vector3 localTranslation() const { return m_position; }
@@ -88,6 +92,7 @@ public:
     void setIKEnable(bool value);
 
 private:
+    void updateInterpolationTable();
     void setInterpolationTable(const int8 *table);
     void setInterpolationParameterInternal(InterpolationType type, const QuadWord &value);
     QuadWord &getInterpolationParameterInternal(InterpolationType type) const;
@@ -0,0 +1,135 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_VMD_COMPRESSEDBONEANIMATION_H_
+#define VPVL2_VMD_COMPRESSEDBONEANIMATION_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IKeyframe.h"
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+
+class IEncoding;
+class IModel;
+
+namespace vmd
+{
+class BoneAnimation;
+class BoneKeyframe;
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * CompressedBoneAnimation class is a read only copy of bone keyframes of BoneAnimation
+ * for playback of long motions.
+ *
+ * Keyframes are packed into a few flat arrays instead of a BoneKeyframe object per keyframe:
+ *
+ * - time indices are stored as variable length deltas from the previous keyframe of the track
+ *   with a checkpoint every kCheckpointInterval keyframes to find keyframes without decoding
+ *   the whole track
+ * - orientations are stored as the smallest three components quantized to 15 bits each
+ * - translations are quantized to 16 bits per axis in the range of each track and omitted
+ *   for tracks that never move
+ * - interpolation parameters are shared in a palette and referred by a 16 bit id
+ *
+ * seek decompresses the two keyframes around the time index of each track and interpolates
+ * them the same way as BoneAnimation. The error of the pose is bounded by the quantization
+ * (see maxOrientationError and maxTranslationError). Time indices are stored as integral
+ * frame indices as VMD does.
+ */
+
+class VPVL2_API CompressedBoneAnimation VPVL2_DECL_FINAL
+{
+public:
+    static const int kCheckpointInterval = 32;
+
+    CompressedBoneAnimation();
+    ~CompressedBoneAnimation();
+
+    /**
+     * Compresses all bone keyframes of the animation and replaces the current ones.
+     *
+     * The animation is not referred after this call. Returns false if the keyframes cannot be
+     * compressed (too many distinct interpolation parameters).
+     */
+    bool compress(const BoneAnimation &animation);
+
+    /**
+     * Appends a new keyframe decompressed from each compressed keyframe to keyframes.
+     *
+     * Decompressed keyframes are owned by the caller. The orientation and the translation of
+     * each keyframe differ from the original one within the quantization error.
+     */
+    void decompress(Array<BoneKeyframe *> &keyframes, IEncoding *encodingRef) const;
+    void seek(const IKeyframe::TimeIndex &timeIndexAt);
+    void reset();
+    void setParentModelRef(IModel *model);
+
+    /**
+     * Returns the size of memory of compressed keyframes in bytes.
+     */
+    vsize estimateMemorySize() const;
+    int countTracks() const;
+    int countKeyframes() const;
+    int countInterpolationParameters() const;
+    Scalar maxTranslationError() const;
+
+    IModel *parentModelRef() const;
+    IKeyframe::TimeIndex currentTimeIndex() const;
+    IKeyframe::TimeIndex duration() const;
+    static Scalar maxOrientationError();
+
+private:
+    struct PrivateContext;
+    PrivateContext *m_context;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(CompressedBoneAnimation)
+};
+
+} /* namespace vmd */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
+
+#endif
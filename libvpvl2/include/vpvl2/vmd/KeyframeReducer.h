@@ -0,0 +1,111 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#pragma once
+#ifndef VPVL2_VMD_KEYFRAMEREDUCER_H_
+#define VPVL2_VMD_KEYFRAMEREDUCER_H_
+
+#include "vpvl2/Common.h"
+#include "vpvl2/IMorph.h"
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace vmd
+{
+class Motion;
+
+/**
+ * @file
+ * @author hkrn
+ *
+ * @section DESCRIPTION
+ *
+ * KeyframeReducer class removes redundant bone and morph keyframes of a motion such as
+ * motion captured one that has a keyframe on every frame.
+ *
+ * Each bone track is split greedily into the longest segments whose samples are reproduced
+ * within the tolerances by the Bezier interpolation parameters of the keyframe at the end of
+ * the segment, which are fitted from a grid of the parameters. Morph tracks are split the
+ * same way with linear interpolation as VMD does. A segment spans 256 keyframes at most, so
+ * the time to reduce is linear in the number of keyframes. Kept keyframes preserve their original
+ * values, so the reduced motion is still a valid VMD. Tracks are processed in parallel if
+ * Intel TBB or OpenMP is available.
+ */
+
+class VPVL2_API KeyframeReducer VPVL2_DECL_FINAL
+{
+public:
+    KeyframeReducer();
+    ~KeyframeReducer();
+
+    /**
+     * Replaces bone and morph keyframes of the motion with the reduced ones.
+     *
+     * Returns false if keyframes of the motion cannot be modified (a shared instance).
+     */
+    bool reduce(Motion *motion);
+
+    /**
+     * Returns the number of bone and morph keyframes before and after the last reduce call.
+     */
+    int countSourceKeyframes() const;
+    int countReducedKeyframes() const;
+
+    Scalar translationTolerance() const;
+    Scalar orientationTolerance() const;
+    IMorph::WeightPrecision morphWeightTolerance() const;
+    void setTranslationTolerance(const Scalar &value);
+    /**
+     * Sets the maximum difference of orientations in radians.
+     */
+    void setOrientationTolerance(const Scalar &value);
+    void setMorphWeightTolerance(const IMorph::WeightPrecision &value);
+
+private:
+    struct PrivateContext;
+    PrivateContext *m_context;
+
+    VPVL2_DISABLE_COPY_AND_ASSIGN(KeyframeReducer)
+};
+
+} /* namespace vmd */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
+
+#endif
@@ -65,7 +65,6 @@ public:
     void createFirstKeyframeUnlessFound();
     void setParentModelRef(IModel *model);
     void reset();
-    void update();
     vsize estimateSize() const;
     ModelKeyframe *findKeyframeAt(int i) const;
     ModelKeyframe *findKeyframe(const IKeyframe::TimeIndex &timeIndex) const;
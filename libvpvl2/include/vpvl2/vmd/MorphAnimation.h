@@ -51,6 +51,11 @@ namespace VPVL2_VERSION_NS
 
 class IEncoding;
 
+namespace internal
+{
+template<typename T> class ModelBindingCache;
+} /* namespace internal */
+
 namespace vmd
 {
 
@@ -76,21 +81,38 @@ public:
     void read(const uint8 *data, int size);
     void seek(const IKeyframe::TimeIndex &timeIndexAt);
     void createFirstKeyframeUnlessFound();
+    void update();
+    void addKeyframe(IKeyframe *keyframe);
+    void removeKeyframe(IKeyframe *keyframe);
     void setParentModelRef(IModel *model);
     void reset();
     MorphKeyframe *findKeyframeAt(int i) const;
     MorphKeyframe *findKeyframe(const IKeyframe::TimeIndex &timeIndex, const IString *name) const;
 
+    IModel *parentModelRef() const { return m_modelRef; }
     bool isNullFrameEnabled() const { return m_enableNullFrame; }
     void setNullFrameEnable(bool value) { m_enableNullFrame = value; }
 
 private:
+    struct Track;
     struct PrivateContext;
-    void createPrivateContexts(const IModel *model);
+    const MorphAnimation *tracksOwnerRef() const;
+    void updateTracks();
+    void createPrivateContexts();
+    void bindPrivateContexts();
+    Track *resolveTrack(const IString *name);
+    void updateDurationTimeIndex();
     void calculateFrames(const IKeyframe::TimeIndex &timeIndexAt, PrivateContext *context);
 
     IEncoding *m_encodingRef;
-    PointerHash<HashString, PrivateContext> m_name2contexts;
+    /* owned tracks of keyframes by name, always empty while the keyframes are shared */
+    PointerHash<HashString, Track> m_name2tracks;
+    /* playback state of each track of tracksOwnerRef() in the same order */
+    PointerArray<PrivateContext> m_contexts;
+    /* advanced whenever m_name2tracks is changed, contexts are rebuilt on mismatch */
+    int m_tracksRevision;
+    int m_contextsRevision;
+    internal::ModelBindingCache<IMorph> *m_bindingCache;
     IModel *m_modelRef;
     bool m_enableNullFrame;
 
@@ -45,6 +45,7 @@
 #include "vpvl2/IMotion.h"
 #include "vpvl2/vmd/BoneAnimation.h"
 #include "vpvl2/vmd/CameraAnimation.h"
+#include "vpvl2/vmd/CompressedBoneAnimation.h"
 #include "vpvl2/vmd/LightAnimation.h"
 #include "vpvl2/vmd/MorphAnimation.h"
 
@@ -159,6 +160,26 @@ public:
     void createFirstKeyframesUnlessFound();
     IMotion *clone() const;
 
+    /*
+     * The instance shares keyframes of this motion and owns only playback state of each track.
+     * Shared keyframes are reference counted, so they stay alive until both of this motion and
+     * all of the instances are deleted. Keyframes can be added to this motion while instances
+     * exist (call update() of the instance after editing this), but loading, replacing, removing
+     * and deleting keyframes are rejected until all of the instances are deleted.
+     */
+    Motion *createInstance(IModel *modelRef) const;
+    bool isSharedInstance() const;
+
+    /*
+     * Replaces bone keyframes with CompressedBoneAnimation and deletes them to save memory of
+     * long motions only to be played back. Bone keyframes of the compacted motion cannot be
+     * edited nor shared with instances until the motion is loaded again. save() and clone()
+     * decompress them within the quantization error. Returns false if the motion is shared
+     * with instances or keyframes cannot be compressed.
+     */
+    bool compactBoneKeyframes();
+    const CompressedBoneAnimation *compressedBoneAnimation() const;
+
     const IString *name() const;
     Scene *parentSceneRef() const;
     IModel *parentModelRef() const;
@@ -0,0 +1,747 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * Headless batch renderer.
+ *
+ * Renders a frame range of a project (or models with motions and a camera motion) into an
+ * EGL pbuffer and streams raw RGBA frames (top-down rows, width * height * 4 bytes each) to
+ * stdout or to a file, for example:
+ *
+ *   vpvl2_batch --model foo.pmx --motion foo.vmd --camera camera.vmd --end 300 \
+ *       --size 1280x720 | ffmpeg -f rawvideo -pix_fmt rgba -s 1280x720 -r 30 -i - out.mp4
+ *
+ * Readback goes through a ring of pixel buffer objects so the GPU keeps N frames in flight,
+ * and motion evaluation and physics of the next frame run on a worker task while the GL
+ * thread waits for the GPU and writes out previous frames.
+ */
+
+#include "../helper.h"
+#include <vpvl2/extensions/XMLProject.h>
+#include <vpvl2/extensions/PlaybackScheduler.h>
+#include <vpvl2/extensions/egl/ApplicationContext.h>
+
+#ifdef VPVL2_LINK_INTEL_TBB
+#include <tbb/task_group.h>
+#endif
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace vpvl2::extensions::egl;
+using namespace vpvl2::extensions::icu4c;
+
+namespace {
+
+enum Phase {
+    kPhaseLoad,
+    kPhasePose,
+    kPhaseSkinning,
+    kPhaseDraw,
+    kPhaseReadback,
+    kPhaseWrite,
+    kMaxPhase
+};
+
+static const char *const kPhaseNames[kMaxPhase] = {
+    "load", "pose", "skinning", "draw", "readback", "write"
+};
+
+struct Options {
+    Options()
+        : configPath("config.ini"),
+          outputPath("-"),
+          width(640),
+          height(480),
+          beginFrame(0),
+          endFrame(-1),
+          fps(30),
+          framesInFlight(2),
+          enablePhysics(true),
+          enablePipeline(true),
+          enableGLES(false)
+    {
+    }
+    std::string configPath;
+    std::string projectPath;
+    std::string cameraPath;
+    std::string outputPath;
+    std::vector<std::string> modelPaths;
+    std::vector<std::string> motionPaths;
+    int width;
+    int height;
+    int beginFrame;
+    int endFrame;
+    int fps;
+    int framesInFlight;
+    bool enablePhysics;
+    bool enablePipeline;
+    bool enableGLES;
+};
+
+class PhaseTimer {
+public:
+    PhaseTimer() {
+        for (int i = 0; i < kMaxPhase; i++) {
+            m_seconds[i] = 0;
+        }
+    }
+
+    float64 now() const {
+        return m_clock.currentSeconds();
+    }
+    void add(Phase phase, float64 start) {
+        m_seconds[phase] += m_clock.currentSeconds() - start;
+    }
+    void print(int nframes, float64 elapsed) const {
+        std::fprintf(stderr, "%-10s %12s %12s\n", "phase", "total ms", "frame ms");
+        for (int i = 0; i < kMaxPhase; i++) {
+            std::fprintf(stderr, "%-10s %12.2f %12.3f\n", kPhaseNames[i], m_seconds[i] * 1000.0,
+                         i != kPhaseLoad && nframes > 0 ? m_seconds[i] * 1000.0 / nframes : 0.0);
+        }
+        std::fprintf(stderr, "rendered %d frames in %.2f s (%.2f fps)\n", nframes, elapsed, elapsed > 0 ? nframes / elapsed : 0.0);
+    }
+
+private:
+    PlaybackScheduler::MonotonicClock m_clock;
+    float64 m_seconds[kMaxPhase];
+};
+
+class FrameSink {
+public:
+    FrameSink(int width, int height)
+        : m_file(0),
+          m_width(width),
+          m_height(height),
+          m_ownFile(false)
+    {
+    }
+    ~FrameSink() {
+        if (m_file) {
+            std::fflush(m_file);
+        }
+        if (m_ownFile && m_file) {
+            std::fclose(m_file);
+        }
+        m_file = 0;
+    }
+
+    bool open(const std::string &path) {
+        if (path == "-") {
+            m_file = stdout;
+        }
+        else {
+            m_file = std::fopen(path.c_str(), "wb");
+            m_ownFile = true;
+        }
+        return m_file != 0;
+    }
+    bool write(const uint8 *pixels) {
+        /* glReadPixels returns bottom-up rows, write top-down to match rawvideo consumers */
+        const vsize stride = vsize(m_width) * 4;
+        for (int y = m_height - 1; y >= 0; y--) {
+            if (std::fwrite(pixels + stride * y, 1, stride, m_file) != stride) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    FILE *m_file;
+    int m_width;
+    int m_height;
+    bool m_ownFile;
+};
+
+class FrameReadback {
+public:
+    static const GLenum kGL_PIXEL_PACK_BUFFER = 0x88EB;
+    static const GLenum kGL_STREAM_READ = 0x88E1;
+    static const GLenum kGL_READ_ONLY = 0x88B8;
+    static const GLenum kGL_MAP_READ_BIT = 0x0001;
+
+    FrameReadback(const IApplicationContext::FunctionResolver *resolver, int width, int height, int framesInFlight, bool enablePBO)
+        : genBuffers(0),
+          bindBuffer(0),
+          bufferData(0),
+          deleteBuffers(0),
+          mapBuffer(0),
+          mapBufferRange(0),
+          unmapBuffer(0),
+          m_width(width),
+          m_height(height),
+          m_size(vsize(width) * height * 4),
+          m_nrequested(0),
+          m_nretired(0)
+    {
+        if (enablePBO && (resolver->query(IApplicationContext::FunctionResolver::kQueryVersion) >= vpvl2::gl::makeVersion(2, 1) ||
+                          resolver->hasExtension("ARB_pixel_buffer_object"))) {
+            genBuffers = reinterpret_cast<PFNGLGENBUFFERSPROC>(resolver->resolveSymbol("glGenBuffers"));
+            bindBuffer = reinterpret_cast<PFNGLBINDBUFFERPROC>(resolver->resolveSymbol("glBindBuffer"));
+            bufferData = reinterpret_cast<PFNGLBUFFERDATAPROC>(resolver->resolveSymbol("glBufferData"));
+            deleteBuffers = reinterpret_cast<PFNGLDELETEBUFFERSPROC>(resolver->resolveSymbol("glDeleteBuffers"));
+            mapBuffer = reinterpret_cast<PFNGLMAPBUFFERPROC>(resolver->resolveSymbol("glMapBuffer"));
+            unmapBuffer = reinterpret_cast<PFNGLUNMAPBUFFERPROC>(resolver->resolveSymbol("glUnmapBuffer"));
+            if (resolver->hasExtension("ARB_map_buffer_range")) {
+                mapBufferRange = reinterpret_cast<PFNGLMAPBUFFERRANGEPROC>(resolver->resolveSymbol("glMapBufferRange"));
+            }
+            m_buffers.resize(btMax(framesInFlight, 1));
+            genBuffers(GLsizei(m_buffers.size()), &m_buffers[0]);
+            for (vsize i = 0; i < m_buffers.size(); i++) {
+                bindBuffer(kGL_PIXEL_PACK_BUFFER, m_buffers[i]);
+                bufferData(kGL_PIXEL_PACK_BUFFER, m_size, 0, kGL_STREAM_READ);
+            }
+            bindBuffer(kGL_PIXEL_PACK_BUFFER, 0);
+        }
+        m_pixels.resize(m_size);
+    }
+    ~FrameReadback() {
+        if (!m_buffers.empty()) {
+            deleteBuffers(GLsizei(m_buffers.size()), &m_buffers[0]);
+        }
+    }
+
+    bool isAsync() const {
+        return !m_buffers.empty();
+    }
+    bool hasPendingFrame() const {
+        return m_nretired < m_nrequested;
+    }
+    bool isFull() const {
+        return m_nrequested - m_nretired >= (isAsync() ? int(m_buffers.size()) : 1);
+    }
+    void request() {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        if (isAsync()) {
+            bindBuffer(kGL_PIXEL_PACK_BUFFER, m_buffers[m_nrequested % m_buffers.size()]);
+            glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            bindBuffer(kGL_PIXEL_PACK_BUFFER, 0);
+        }
+        else {
+            glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, &m_pixels[0]);
+        }
+        m_nrequested++;
+    }
+    /* waits for the oldest frame in flight and copies it to the sink */
+    bool retire(FrameSink &sink, PhaseTimer &timer) {
+        bool ok = true;
+        float64 start = timer.now();
+        if (isAsync()) {
+            bindBuffer(kGL_PIXEL_PACK_BUFFER, m_buffers[m_nretired % m_buffers.size()]);
+            const void *address = mapBufferRange ? mapBufferRange(kGL_PIXEL_PACK_BUFFER, 0, m_size, kGL_MAP_READ_BIT)
+                                                 : mapBuffer(kGL_PIXEL_PACK_BUFFER, kGL_READ_ONLY);
+            timer.add(kPhaseReadback, start);
+            start = timer.now();
+            ok = address && sink.write(static_cast<const uint8 *>(address));
+            unmapBuffer(kGL_PIXEL_PACK_BUFFER);
+            bindBuffer(kGL_PIXEL_PACK_BUFFER, 0);
+        }
+        else {
+            timer.add(kPhaseReadback, start);
+            start = timer.now();
+            ok = sink.write(&m_pixels[0]);
+        }
+        timer.add(kPhaseWrite, start);
+        m_nretired++;
+        return ok;
+    }
+
+private:
+    typedef void (GLAPIENTRY * PFNGLGENBUFFERSPROC) (GLsizei n, GLuint* buffers);
+    typedef void (GLAPIENTRY * PFNGLBINDBUFFERPROC) (GLenum target, GLuint buffer);
+    typedef void (GLAPIENTRY * PFNGLBUFFERDATAPROC) (GLenum target, std::ptrdiff_t size, const GLvoid* data, GLenum usage);
+    typedef void (GLAPIENTRY * PFNGLDELETEBUFFERSPROC) (GLsizei n, const GLuint* buffers);
+    typedef GLvoid* (GLAPIENTRY * PFNGLMAPBUFFERPROC) (GLenum target, GLenum access);
+    typedef GLvoid * (GLAPIENTRY * PFNGLMAPBUFFERRANGEPROC) (GLenum target, std::ptrdiff_t offset, std::ptrdiff_t length, GLbitfield access);
+    typedef GLboolean (GLAPIENTRY * PFNGLUNMAPBUFFERPROC) (GLenum target);
+    PFNGLGENBUFFERSPROC genBuffers;
+    PFNGLBINDBUFFERPROC bindBuffer;
+    PFNGLBUFFERDATAPROC bufferData;
+    PFNGLDELETEBUFFERSPROC deleteBuffers;
+    PFNGLMAPBUFFERPROC mapBuffer;
+    PFNGLMAPBUFFERRANGEPROC mapBufferRange;
+    PFNGLUNMAPBUFFERPROC unmapBuffer;
+
+    std::vector<GLuint> m_buffers;
+    std::vector<uint8> m_pixels;
+    int m_width;
+    int m_height;
+    vsize m_size;
+    int m_nrequested;
+    int m_nretired;
+};
+
+class ProjectDelegate : public XMLProject::IDelegate {
+public:
+    ProjectDelegate(Factory *factoryRef, IEncoding *encodingRef)
+        : m_applicationContextRef(0),
+          m_sceneRef(0),
+          m_factoryRef(factoryRef),
+          m_encodingRef(encodingRef)
+    {
+    }
+    ~ProjectDelegate() {
+        m_archives.releaseAll();
+    }
+
+    void setApplicationContextRef(BaseApplicationContext *value, Scene *sceneRef) {
+        m_applicationContextRef = value;
+        m_sceneRef = sceneRef;
+    }
+    std::string toStdFromString(const IString *value) const {
+        return value ? static_cast<const String *>(value)->toStdString() : std::string();
+    }
+    IString *toStringFromStd(const std::string &value) const {
+        return String::create(value);
+    }
+    bool loadModel(const XMLProject::UUID &uuid, const StringMap &settings, IModel::Type /* type */, IModel *&model, IRenderEngine *&engine, int &priority) {
+        std::string path = settings.value(XMLProject::kSettingArchiveURIKey, std::string());
+        if (path.empty()) {
+            path = settings.value(XMLProject::kSettingURIKey, std::string());
+        }
+        if (path.compare(0, 7, "file://") == 0) {
+            path = path.substr(7);
+        }
+        const UnicodeString &modelPath = UnicodeString::fromUTF8(path);
+        ArchiveSmartPtr archive;
+        IModelSmartPtr modelPtr;
+        if (!::ui::loadModel(modelPath, m_applicationContextRef, m_factoryRef, m_encodingRef, archive, modelPtr)) {
+            VPVL2_LOG(WARNING, "Cannot load the model of the project: uuid=" << uuid << " path=" << path);
+            return false;
+        }
+        String dir(modelPath.tempSubString(0, modelPath.lastIndexOf("/")));
+        BaseApplicationContext::ModelContext modelContext(m_applicationContextRef, archive.get(), &dir, modelPtr->type() == IModel::kAssetModel);
+        IRenderEngineSmartPtr enginePtr(m_sceneRef->createRenderEngine(m_applicationContextRef, modelPtr.get(), 0));
+        m_applicationContextRef->addModelFilePath(modelPtr.get(), path);
+        modelContext.prefetchTextures(modelPtr.get(), false);
+        if (!enginePtr->upload(&modelContext)) {
+            return false;
+        }
+        enginePtr->setUpdateOptions(IRenderEngine::kParallelUpdate | IRenderEngine::kSkipUnchangedUpdate);
+        priority = settings.value(XMLProject::kSettingOrderKey, 0);
+        if (Archive *archiveRef = archive.release()) {
+            m_archives.append(archiveRef);
+        }
+        model = modelPtr.release();
+        engine = enginePtr.release();
+        return true;
+    }
+
+private:
+    BaseApplicationContext *m_applicationContextRef;
+    Scene *m_sceneRef;
+    Factory *m_factoryRef;
+    IEncoding *m_encodingRef;
+    PointerArray<Archive> m_archives;
+};
+
+static void PrintUsage(const char *argv0)
+{
+    std::fprintf(stderr,
+                 "usage: %s [options]\n"
+                 "  --config path          settings file (default: config.ini)\n"
+                 "  --project path         project (.xml) to render\n"
+                 "  --model path           model to render, may be repeated\n"
+                 "  --motion path          motion of the last --model\n"
+                 "  --camera path          camera motion\n"
+                 "  --size WxH             resolution (default: 640x480)\n"
+                 "  --begin N, --end N     frame range, --end defaults to the end of motions\n"
+                 "  --fps N                frames per second (default: 30)\n"
+                 "  --frames-in-flight N   readbacks queued on the GPU (default: 2)\n"
+                 "  --output path          output file, \"-\" for stdout (default)\n"
+                 "  --no-physics           disable physics simulation\n"
+                 "  --no-pipeline          evaluate motions on the GL thread\n"
+                 "  --gles                 use OpenGL ES instead of desktop OpenGL\n",
+                 argv0);
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--config" && hasValue) {
+            options.configPath = argv[++i];
+        }
+        else if (arg == "--project" && hasValue) {
+            options.projectPath = argv[++i];
+        }
+        else if (arg == "--model" && hasValue) {
+            options.modelPaths.push_back(argv[++i]);
+            options.motionPaths.push_back(std::string());
+        }
+        else if (arg == "--motion" && hasValue && !options.motionPaths.empty()) {
+            options.motionPaths.back() = argv[++i];
+        }
+        else if (arg == "--camera" && hasValue) {
+            options.cameraPath = argv[++i];
+        }
+        else if (arg == "--size" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) {
+                return false;
+            }
+        }
+        else if (arg == "--begin" && hasValue) {
+            options.beginFrame = std::atoi(argv[++i]);
+        }
+        else if (arg == "--end" && hasValue) {
+            options.endFrame = std::atoi(argv[++i]);
+        }
+        else if (arg == "--fps" && hasValue) {
+            options.fps = std::atoi(argv[++i]);
+        }
+        else if (arg == "--frames-in-flight" && hasValue) {
+            options.framesInFlight = std::atoi(argv[++i]);
+        }
+        else if (arg == "--output" && hasValue) {
+            options.outputPath = argv[++i];
+        }
+        else if (arg == "--no-physics") {
+            options.enablePhysics = false;
+        }
+        else if (arg == "--no-pipeline") {
+            options.enablePipeline = false;
+        }
+        else if (arg == "--gles") {
+            options.enableGLES = true;
+        }
+        else {
+            return false;
+        }
+    }
+    return options.width > 0 && options.height > 0 && options.fps > 0 && options.framesInFlight > 0 &&
+            (!options.projectPath.empty() || !options.modelPaths.empty());
+}
+
+static bool CreateHeadlessContext(const Options &options, EGLDisplay &display, EGLSurface &surface, EGLContext &context)
+{
+    eglBindAPI(options.enableGLES ? EGL_OPENGL_ES_API : EGL_OPENGL_API);
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (!eglInitialize(display, &major, &minor)) {
+        std::cerr << "Cannot initialize EGL session: " << eglGetError() << std::endl;
+        return false;
+    }
+    const EGLint attrs[] = {
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_STENCIL_SIZE, 8,
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, options.enableGLES ? EGL_OPENGL_ES2_BIT : EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint nconfigs;
+    if (!eglChooseConfig(display, attrs, &config, 1, &nconfigs) || nconfigs == 0) {
+        std::cerr << "Cannot choose EGL configuration: " << eglGetError() << std::endl;
+        return false;
+    }
+    const EGLint surfaceAttribs[] = {
+        EGL_WIDTH, options.width,
+        EGL_HEIGHT, options.height,
+        EGL_NONE
+    };
+    surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    if (surface == EGL_NO_SURFACE) {
+        std::cerr << "Cannot create EGL pbuffer surface: " << eglGetError() << std::endl;
+        return false;
+    }
+    Array<EGLint> contextAttribs;
+    if (options.enableGLES) {
+        contextAttribs.append(EGL_CONTEXT_CLIENT_VERSION);
+        contextAttribs.append(3);
+    }
+    contextAttribs.append(EGL_NONE);
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, &contextAttribs[0]);
+    if (context == EGL_NO_CONTEXT) {
+        std::cerr << "Cannot create EGL context: " << eglGetError() << std::endl;
+        return false;
+    }
+    if (!eglMakeCurrent(display, surface, surface, context)) {
+        std::cerr << "Cannot make OpenGL context current: " << eglGetError() << std::endl;
+        return false;
+    }
+    std::cerr << "GL_VERSION: " << glGetString(GL_VERSION) << std::endl;
+    std::cerr << "GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
+
+static void TerminateHeadlessContext(EGLDisplay display, EGLSurface surface, EGLContext context)
+{
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, context);
+    }
+    if (surface != EGL_NO_SURFACE) {
+        eglDestroySurface(display, surface);
+    }
+    eglTerminate(display);
+}
+
+/* motion evaluation and physics of a frame, touches model state only and never calls GL */
+class PoseTask {
+public:
+    PoseTask(Scene *sceneRef, World *worldRef, const Options &options, PhaseTimer &timer)
+        : m_sceneRef(sceneRef),
+          m_worldRef(worldRef),
+          m_timer(timer),
+          m_fps(options.fps),
+          m_enablePhysics(options.enablePhysics),
+          m_frame(0),
+          m_resetMotionState(false)
+    {
+    }
+
+    void setFrame(int frame, bool resetMotionState) {
+        m_frame = frame;
+        m_resetMotionState = resetMotionState;
+    }
+    void operator()() const {
+        const float64 start = m_timer.now();
+        m_sceneRef->seekSeconds(float64(m_frame) / m_fps, Scene::kUpdateModels);
+        if (m_resetMotionState) {
+            m_sceneRef->update(Scene::kUpdateModels | Scene::kResetMotionState);
+        }
+        else {
+            if (m_enablePhysics) {
+                m_worldRef->stepFixedSimulation(Scalar(1.0 / m_fps));
+            }
+            m_sceneRef->update(Scene::kUpdateModels);
+        }
+        m_timer.add(kPhasePose, start);
+    }
+
+private:
+    Scene *m_sceneRef;
+    World *m_worldRef;
+    PhaseTimer &m_timer;
+    int m_fps;
+    bool m_enablePhysics;
+    int m_frame;
+    bool m_resetMotionState;
+};
+
+static int FindLastFrame(const Scene &scene, int fps)
+{
+    IKeyframe::TimeIndex duration = scene.durationTimeIndex();
+    if (const ICamera *camera = scene.cameraRef()) {
+        if (const IMotion *motion = camera->motion()) {
+            btSetMax(duration, motion->durationTimeIndex());
+        }
+    }
+    /* time index of motions is based on 30 fps */
+    return int(duration * fps / Scene::defaultFPS());
+}
+
+/* tears down the scene before the application context on every exit path of RenderAllFrames */
+class SceneScope {
+public:
+    SceneScope(std::auto_ptr<Scene> &scene, ApplicationContext &applicationContext)
+        : m_scene(scene),
+          m_applicationContext(applicationContext)
+    {
+    }
+    ~SceneScope() {
+        m_scene->setWorldRef(0);
+        m_scene.reset();
+        m_applicationContext.release();
+    }
+
+private:
+    std::auto_ptr<Scene> &m_scene;
+    ApplicationContext &m_applicationContext;
+};
+
+static bool RenderAllFrames(const Options &options, StringMap &settings, PhaseTimer &timer, float64 loadStart)
+{
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    Factory factory(&encoding);
+    ProjectDelegate delegate(&factory, &encoding);
+    std::auto_ptr<Scene> scene(options.projectPath.empty() ? new Scene(true) : new XMLProject(&delegate, &factory, true));
+    ApplicationContext applicationContext(scene.get(), &encoding, &settings, options.enableGLES);
+    World world;
+    SceneScope scope(scene, applicationContext);
+    applicationContext.initialize(false);
+    applicationContext.setViewportRegion(glm::vec4(0, 0, options.width, options.height));
+    ::ui::initializeDictionary(settings, dictionary);
+    delegate.setApplicationContextRef(&applicationContext, scene.get());
+    scene->setPreferredFPS(Scalar(options.fps));
+    if (!options.projectPath.empty()) {
+        if (!static_cast<XMLProject *>(scene.get())->load(options.projectPath.c_str())) {
+            std::cerr << "Cannot load the project: " << options.projectPath << std::endl;
+            return false;
+        }
+    }
+    else {
+        const int nmodels = int(options.modelPaths.size());
+        settings["models/size"] = XMLProject::toStringFromFloat32(float32(nmodels));
+        for (int i = 0; i < nmodels; i++) {
+            std::ostringstream prefix;
+            prefix << "models/" << (i + 1);
+            settings[prefix.str() + "/path"] = options.modelPaths[i];
+            settings[prefix.str() + "/motion"] = options.motionPaths[i];
+            settings[prefix.str() + "/enable.physics"] = options.enablePhysics ? "true" : "false";
+        }
+        ::ui::loadAllModels(settings, &applicationContext, scene.get(), &factory, &encoding);
+    }
+    if (!options.cameraPath.empty()) {
+        BaseApplicationContext::MapBuffer buffer(&applicationContext);
+        bool ok = false;
+        if (applicationContext.mapFile(options.cameraPath, &buffer)) {
+            IMotion *motion = factory.createMotion(buffer.address, buffer.size, 0, ok);
+            if (ok) {
+                scene->cameraRef()->setMotion(motion);
+            }
+            else {
+                delete motion;
+            }
+        }
+        if (!ok) {
+            std::cerr << "Cannot load the camera motion: " << options.cameraPath << std::endl;
+        }
+    }
+    scene->setWorldRef(options.enablePhysics ? world.dynamicWorldRef() : 0);
+    const int endFrame = options.endFrame >= 0 ? options.endFrame : FindLastFrame(*scene, options.fps);
+    timer.add(kPhaseLoad, loadStart);
+
+    FrameSink sink(options.width, options.height);
+    if (!sink.open(options.outputPath)) {
+        std::cerr << "Cannot open the output: " << options.outputPath << std::endl;
+        return false;
+    }
+    FrameReadback readback(ApplicationContext::staticSharedFunctionResolverInstance(),
+                           options.width, options.height, options.framesInFlight, !options.enableGLES);
+    PoseTask poseTask(scene.get(), &world, options, timer);
+#ifdef VPVL2_LINK_INTEL_TBB
+    tbb::task_group tasks;
+#endif
+    poseTask.setFrame(options.beginFrame, true);
+    poseTask();
+    bool ok = true;
+    int nframes = 0;
+    const float64 renderStart = timer.now();
+    glViewport(0, 0, options.width, options.height);
+    glClearColor(0, 0, 0, 1);
+    for (int frame = options.beginFrame; frame <= endFrame && ok; frame++) {
+        float64 start = timer.now();
+        scene->seekSeconds(float64(frame) / options.fps, Scene::kUpdateCamera | Scene::kUpdateLight);
+        scene->update(Scene::kUpdateCamera | Scene::kUpdateLight | Scene::kUpdateRenderEngines);
+        applicationContext.updateCameraMatrices();
+        timer.add(kPhaseSkinning, start);
+        start = timer.now();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        ::ui::drawScreen(*scene);
+        timer.add(kPhaseDraw, start);
+        /*
+         * all draw calls of this frame are issued, so the next pose can be evaluated while the GPU
+         * renders and the GL thread retires older frames. readback of this frame is queued first.
+         */
+        start = timer.now();
+        readback.request();
+        timer.add(kPhaseReadback, start);
+        const bool hasNextFrame = frame < endFrame;
+        if (hasNextFrame) {
+            poseTask.setFrame(frame + 1, false);
+        }
+#ifdef VPVL2_LINK_INTEL_TBB
+        if (hasNextFrame && options.enablePipeline) {
+            tasks.run(poseTask);
+        }
+#endif
+        if (readback.isFull()) {
+            ok = readback.retire(sink, timer);
+        }
+#ifdef VPVL2_LINK_INTEL_TBB
+        if (hasNextFrame && options.enablePipeline) {
+            tasks.wait();
+        }
+        else
+#endif
+        if (hasNextFrame) {
+            poseTask();
+        }
+        nframes++;
+    }
+    while (ok && readback.hasPendingFrame()) {
+        ok = readback.retire(sink, timer);
+    }
+    timer.print(nframes, timer.now() - renderStart);
+    return ok;
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    tbb::task_scheduler_init initializer; (void) initializer;
+    BaseApplicationContext::initializeOnce(argv[0], 0, 0);
+
+    PhaseTimer timer;
+    const float64 start = timer.now();
+    StringMap settings;
+    ::ui::loadSettings(options.configPath, settings);
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    bool ok = false;
+    if (!CreateHeadlessContext(options, display, surface, context)) {
+        /* an error is already reported */
+    }
+    else if (!Scene::initialize(ApplicationContext::staticSharedFunctionResolverInstance())) {
+        std::cerr << "Cannot initialize the scene" << std::endl;
+    }
+    else {
+        ok = RenderAllFrames(options, settings, timer, start);
+    }
+    /* every exit path after creating the context goes through here */
+    TerminateHeadlessContext(display, surface, context);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -226,6 +226,8 @@ static void loadAllModels(const StringMap &settings,
                  engine->setEffect(effectRef, IEffect::kAutoDetection, &modelContext);
 #endif
             }
+            /* decodes all textures of the model concurrently before uploading them */
+            modelContext.prefetchTextures(model.get(), settings.value("enable.mipmap.cpu", false));
             if (engine->upload(&modelContext)) {
                 engine->setUpdateOptions(parallel ? IRenderEngine::kParallelUpdate : IRenderEngine::kNone);
                 model->setEdgeWidth(settings.value(prefix + "/edge.width", 1.0f));
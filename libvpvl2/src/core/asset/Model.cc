@@ -37,6 +37,7 @@
 
 #include "vpvl2/vpvl2.h"
 #include "vpvl2/asset/Model.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/ModelHelper.h"
 
 #if defined(VPVL2_LINK_ASSIMP3)
@@ -49,6 +50,9 @@
 #include <assimp/aiScene.h>
 #endif
 
+#include <map>
+#include <vector>
+
 namespace {
 
 #if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
@@ -282,34 +286,27 @@ private:
 
 class Material : public IMaterial {
 public:
-    Material(asset::Model *modelRef, const aiMaterial *materialRef, IEncoding *encodingRef, int nindices, int index)
-        : m_materialRef(materialRef),
-          m_modelRef(modelRef),
+    Material(asset::Model *modelRef, const asset::Model::MaterialBatch &batch, IEncoding *encodingRef, int index)
+        : m_modelRef(modelRef),
           m_encodingRef(encodingRef),
           m_mainTexture(0),
           m_sphereTexture(0),
           m_sphereTextureRenderMode(kNone),
-          m_nindices(nindices),
+          m_nindices(batch.nindices),
           m_index(index),
           m_visible(true)
     {
-        aiColor4D color;
-        aiGetMaterialColor(m_materialRef, AI_MATKEY_COLOR_AMBIENT, &color);
-        m_ambient.setValue(color.r, color.g, color.b, 1);
-        aiGetMaterialColor(m_materialRef, AI_MATKEY_COLOR_DIFFUSE, &color);
-        m_diffuse.setValue(color.r, color.g, color.b, color.a);
-        aiGetMaterialColor(m_materialRef, AI_MATKEY_COLOR_SPECULAR, &color);
-        m_specular.setValue(color.r, color.g, color.b, 1);
-        float shininess;
-        aiGetMaterialFloat(m_materialRef, AI_MATKEY_SHININESS, &shininess);
-        m_shininess = shininess;
-        setMaterialTextures();
+        const Color &ambient = batch.ambient, &specular = batch.specular;
+        m_ambient.setValue(ambient.x(), ambient.y(), ambient.z(), 1);
+        m_diffuse = batch.diffuse;
+        m_specular.setValue(specular.x(), specular.y(), specular.z(), 1);
+        m_shininess = batch.shininess;
+        setMaterialTextures(batch.texturePath);
     }
     ~Material() {
         internal::deleteObject(m_mainTexture);
         internal::deleteObject(m_sphereTexture);
         m_modelRef = 0;
-        m_materialRef = 0;
         m_encodingRef = 0;
         m_ambient.setZero();
         m_diffuse.setZero();
@@ -380,14 +377,13 @@ public:
     void setVisible(bool value) { m_visible = value; }
 
 private:
-    void setMaterialTextures() {
-        aiString texturePath;
-        if (m_materialRef->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == aiReturn_SUCCESS) {
-            const uint8 *path = reinterpret_cast<const uint8 *>(texturePath.data);
+    void setMaterialTextures(const std::string &texturePath) {
+        if (!texturePath.empty()) {
+            const uint8 *path = reinterpret_cast<const uint8 *>(texturePath.c_str());
             const IString *separator = m_encodingRef->stringConstant(IEncoding::kAsterisk);
             const IString *sph = m_encodingRef->stringConstant(IEncoding::kSPHExtension);
             const IString *spa = m_encodingRef->stringConstant(IEncoding::kSPAExtension);
-            IString *texture = m_encodingRef->toString(path, texturePath.length, IString::kShiftJIS);
+            IString *texture = m_encodingRef->toString(path, int(texturePath.size()), IString::kShiftJIS);
             if (texture->contains(separator)) {
                 Array<IString *> tokens;
                 texture->split(separator, 2, tokens);
@@ -420,7 +416,6 @@ private:
     }
 
     static const Color kWhiteColor;
-    const aiMaterial *m_materialRef;
     asset::Model *m_modelRef;
     IEncoding *m_encodingRef;
     IString *m_mainTexture;
@@ -555,6 +550,145 @@ private:
     int m_index;
 };
 
+#pragma pack(push, 1)
+
+struct CacheHeaderUnit {
+    uint8 signature[8];
+    uint32 version;
+    uint32 nvertices;
+    uint32 nindices;
+    uint32 nbatches;
+};
+
+struct CacheVertexUnit {
+    float32 position[3];
+    float32 normal[3];
+    float32 texcoord[3];
+    float32 tangent[3];
+    float32 bitangent[3];
+};
+
+struct CacheMaterialBatchUnit {
+    float32 ambient[4];
+    float32 diffuse[4];
+    float32 specular[4];
+    float32 emissive[4];
+    float32 shininess;
+    float32 opacity;
+    int32 materialIndex;
+    int32 primitiveType;
+    int32 indexOffset;
+    int32 nindices;
+    uint8 hasShininess;
+    uint8 hasOpacity;
+    uint8 isTwoSided;
+    uint8 reserved;
+    uint32 texturePathSize;
+};
+
+#pragma pack(pop)
+
+static const uint8 kCacheSignature[] = { 'V', 'P', 'V', 'L', '2', 'A', 'S', 'T' };
+static const uint32 kCacheVersion = 1;
+
+static inline vsize alignCacheSize(vsize size)
+{
+    return (size + 3) & ~vsize(3);
+}
+
+static inline void writeVector3(const Vector3 &value, float32 *output)
+{
+    output[0] = value.x();
+    output[1] = value.y();
+    output[2] = value.z();
+}
+
+static inline Vector3 readVector3(const float32 *input)
+{
+    return Vector3(input[0], input[1], input[2]);
+}
+
+static inline void writeColor(const Color &value, float32 *output)
+{
+    output[0] = value.x();
+    output[1] = value.y();
+    output[2] = value.z();
+    output[3] = value.w();
+}
+
+static inline Color readColor(const float32 *input)
+{
+    return Color(input[0], input[1], input[2], input[3]);
+}
+
+struct MeshInstance {
+    const aiMesh *mesh;
+    aiMatrix4x4 transform;
+};
+typedef std::pair<unsigned int, int> MaterialBatchKey;
+typedef std::map<MaterialBatchKey, std::vector<MeshInstance> > MeshInstanceMap;
+
+static int toPrimitiveType(const aiMesh *mesh)
+{
+    switch (mesh->mPrimitiveTypes) {
+    case aiPrimitiveType_LINE:
+        return asset::Model::kLines;
+    case aiPrimitiveType_POINT:
+        return asset::Model::kPoints;
+    default:
+        return asset::Model::kTriangles;
+    }
+}
+
+static void collectMeshInstancesRecurse(const aiScene *scene, const aiNode *node, const aiMatrix4x4 &parentTransform, MeshInstanceMap &instances)
+{
+    MeshInstance instance;
+    instance.transform = parentTransform * node->mTransformation;
+    const unsigned int nmeshes = node->mNumMeshes;
+    for (unsigned int i = 0; i < nmeshes; i++) {
+        const aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
+        instance.mesh = mesh;
+        instances[MaterialBatchKey(mesh->mMaterialIndex, toPrimitiveType(mesh))].push_back(instance);
+    }
+    const unsigned int nchildren = node->mChildren ? node->mNumChildren : 0;
+    for (unsigned int i = 0; i < nchildren; i++) {
+        collectMeshInstancesRecurse(scene, node->mChildren[i], instance.transform, instances);
+    }
+}
+
+static inline Vector3 toVector3(const aiVector3D &value)
+{
+    return Vector3(value.x, value.y, value.z);
+}
+
+static inline Vector3 toNormalizedVector3(const aiVector3D &value)
+{
+    Vector3 v(value.x, value.y, value.z);
+    return v.fuzzyZero() ? v : v.normalized();
+}
+
+static void setMaterialBatchProperties(const aiMaterial *material, asset::Model::MaterialBatch &batch)
+{
+    aiString texturePath;
+    aiColor4D color;
+    batch.texturePath.assign(material->GetTexture(aiTextureType_DIFFUSE, 0, &texturePath) == aiReturn_SUCCESS ? texturePath.data : "");
+    batch.ambient = aiGetMaterialColor(material, AI_MATKEY_COLOR_AMBIENT, &color) == aiReturn_SUCCESS ? Color(color.r, color.g, color.b, color.a) : Color(0, 0, 0, 1);
+    batch.diffuse = aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &color) == aiReturn_SUCCESS ? Color(color.r, color.g, color.b, color.a) : Color(1, 1, 1, 1);
+    batch.specular = aiGetMaterialColor(material, AI_MATKEY_COLOR_SPECULAR, &color) == aiReturn_SUCCESS ? Color(color.r, color.g, color.b, color.a) : Color(0, 0, 0, 1);
+    batch.emissive = aiGetMaterialColor(material, AI_MATKEY_COLOR_EMISSIVE, &color) == aiReturn_SUCCESS ? Color(color.r, color.g, color.b, color.a) : Color(0, 0, 0, 1);
+    float shininess = 0, strength = 0, opacity = 1;
+    const bool hasShininess = aiGetMaterialFloat(material, AI_MATKEY_SHININESS, &shininess) == aiReturn_SUCCESS;
+    if (hasShininess && aiGetMaterialFloat(material, AI_MATKEY_SHININESS_STRENGTH, &strength) == aiReturn_SUCCESS) {
+        shininess *= strength;
+    }
+    batch.shininess = shininess;
+    batch.hasShininess = hasShininess;
+    batch.hasOpacity = aiGetMaterialFloat(material, AI_MATKEY_OPACITY, &opacity) == aiReturn_SUCCESS;
+    batch.opacity = batch.hasOpacity ? opacity : 1;
+    int twoSided = 0;
+    batch.isTwoSided = aiGetMaterialInteger(material, AI_MATKEY_TWOSIDED, &twoSided) == aiReturn_SUCCESS && twoSided != 0;
+}
+
 class ProgressReporter : public Assimp::ProgressHandler {
 public:
     ProgressReporter(IProgressReporter *reporterRef)
@@ -640,15 +774,24 @@ Model::~Model()
 #if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
     m_scene = 0;
 #endif
+    internal::advanceModelGeneration();
 }
 
 bool Model::load(const uint8 *data, vsize size)
 {
 #if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
-    int flags = aiProcessPreset_TargetRealtime_Fast;
-    m_importer.SetProgressHandler(new ProgressReporter(m_progressReporterRef));
-    m_scene = m_importer.ReadFileFromMemory(data, size, flags, ".x");
-    m_importer.SetProgressHandler(0);
+    const bool isCache = isCacheData(data, size);
+    if (isCache) {
+        if (!loadCache(data, size)) {
+            return false;
+        }
+    }
+    else {
+        int flags = aiProcessPreset_TargetRealtime_Fast;
+        m_importer.SetProgressHandler(new ProgressReporter(m_progressReporterRef));
+        m_scene = m_importer.ReadFileFromMemory(data, size, flags, ".x");
+        m_importer.SetProgressHandler(0);
+    }
     const int nbones = m_bones.count();
     for (int i = 0; i < nbones; i++) {
         IBone *bone = m_bones[i];
@@ -660,8 +803,11 @@ bool Model::load(const uint8 *data, vsize size)
         m_name2morphRefs.insert(morph->name(IEncoding::kDefaultLanguage)->toHashString(), morph);
     }
     if (m_scene) {
-        setMaterialRefsRecurse(m_scene, m_scene->mRootNode);
-        setVertexRefsRecurse(m_scene, m_scene->mRootNode);
+        buildMaterialBatches(m_scene);
+    }
+    if (m_scene || isCache) {
+        setMaterialRefs();
+        setVertexRefs();
         return true;
     }
 #else
@@ -671,6 +817,94 @@ bool Model::load(const uint8 *data, vsize size)
     return false;
 }
 
+void Model::save(uint8 *data, vsize &written) const
+{
+#if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
+    uint8 *base = data;
+    CacheHeaderUnit header;
+    const int nvertices = m_meshVertices.count(), nindices = m_meshIndices.count(), nbatches = m_materialBatches.count();
+    internal::zerofill(&header, sizeof(header));
+    std::memcpy(header.signature, kCacheSignature, sizeof(header.signature));
+    header.version = kCacheVersion;
+    header.nvertices = nvertices;
+    header.nindices = nindices;
+    header.nbatches = nbatches;
+    internal::writeBytes(&header, sizeof(header), data);
+    /* vertices and indices are written contiguously so they can be used from mapped memory as is */
+    CacheVertexUnit vu;
+    for (int i = 0; i < nvertices; i++) {
+        const MeshVertex &vertex = m_meshVertices[i];
+        writeVector3(vertex.position, vu.position);
+        writeVector3(vertex.normal, vu.normal);
+        writeVector3(vertex.texcoord, vu.texcoord);
+        writeVector3(vertex.tangent, vu.tangent);
+        writeVector3(vertex.bitangent, vu.bitangent);
+        internal::writeBytes(&vu, sizeof(vu), data);
+    }
+    if (nindices > 0) {
+        internal::writeBytes(&m_meshIndices[0], sizeof(uint32) * nindices, data);
+    }
+    CacheMaterialBatchUnit bu;
+    for (int i = 0; i < nbatches; i++) {
+        const MaterialBatch &batch = m_materialBatches[i];
+        const vsize textureSize = batch.texturePath.size();
+        internal::zerofill(&bu, sizeof(bu));
+        writeColor(batch.ambient, bu.ambient);
+        writeColor(batch.diffuse, bu.diffuse);
+        writeColor(batch.specular, bu.specular);
+        writeColor(batch.emissive, bu.emissive);
+        bu.shininess = batch.shininess;
+        bu.opacity = batch.opacity;
+        bu.materialIndex = batch.materialIndex;
+        bu.primitiveType = batch.primitiveType;
+        bu.indexOffset = batch.indexOffset;
+        bu.nindices = batch.nindices;
+        bu.hasShininess = batch.hasShininess ? 1 : 0;
+        bu.hasOpacity = batch.hasOpacity ? 1 : 0;
+        bu.isTwoSided = batch.isTwoSided ? 1 : 0;
+        bu.texturePathSize = uint32(textureSize);
+        internal::writeBytes(&bu, sizeof(bu), data);
+        if (textureSize > 0) {
+            const vsize padding = alignCacheSize(textureSize) - textureSize;
+            internal::writeBytes(batch.texturePath.data(), textureSize, data);
+            internal::zerofill(data, padding);
+            data += padding;
+        }
+    }
+    written = data - base;
+#else
+    (void) data;
+    written = 0;
+#endif
+}
+
+vsize Model::estimateSize() const
+{
+#if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
+    vsize size = sizeof(CacheHeaderUnit);
+    size += sizeof(CacheVertexUnit) * m_meshVertices.count();
+    size += sizeof(uint32) * m_meshIndices.count();
+    const int nbatches = m_materialBatches.count();
+    for (int i = 0; i < nbatches; i++) {
+        size += sizeof(CacheMaterialBatchUnit) + alignCacheSize(m_materialBatches[i].texturePath.size());
+    }
+    return size;
+#else
+    return 0;
+#endif
+}
+
+bool Model::isCacheData(const uint8 *data, vsize size)
+{
+#if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
+    return data && size >= sizeof(CacheHeaderUnit) && internal::memcmp(data, kCacheSignature, sizeof(kCacheSignature)) == 0;
+#else
+    (void) data;
+    (void) size;
+    return false;
+#endif
+}
+
 IBone *Model::findBoneRef(const IString *value) const
 {
     IBone *const *bone = m_name2boneRefs.find(value->toHashString());
@@ -763,9 +997,13 @@ void Model::getBoundingBox(Vector3 &min, Vector3 &max) const
 {
     min.setZero();
     max.setZero();
-#if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
-    getBoundingBoxRecurse(m_scene, m_scene->mRootNode, min, max);
-#endif
+    const int nvertices = m_meshVertices.count();
+    const Scalar &scale = scaleFactor();
+    for (int i = 0; i < nvertices; i++) {
+        const Vector3 &position = m_meshVertices[i].position * scale;
+        min.setMin(position);
+        max.setMax(position);
+    }
 }
 
 void Model::setName(const IString *value, IEncoding::LanguageType /* type */)
@@ -853,6 +1091,12 @@ void Model::getAabb(Vector3 &min, Vector3 &max) const
     max = m_aabbMax;
 }
 
+bool Model::computeConservativeAabb(Vector3 & /* min */, Vector3 & /* max */, Array<Vector3> * /* materialAabbs */, Array<Scalar> * /* materialEdgeSizes */) const
+{
+    /* no skinning bones to derive the bounds from */
+    return false;
+}
+
 float32 Model::version() const
 {
     return 1.0f;
@@ -1047,56 +1291,161 @@ void Model::setIndicesRecurse(const aiScene *scene, const aiNode *node)
     }
 }
 
-void Model::setMaterialRefsRecurse(const aiScene *scene, const aiNode *node)
+void Model::setMaterialRefs()
 {
-    const unsigned int nmeshes = node->mNumMeshes;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const struct aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        const struct aiFace *faces = mesh->mFaces;
-        const unsigned int nfaces = mesh->mNumFaces;
-        unsigned int nindices = 0;
-        for (unsigned int j = 0; j < nfaces; j++) {
-            nindices += faces[j].mNumIndices;
-        }
-        m_materials.append(new Material(this, material, m_encodingRef, nindices, i));
+    const int nbatches = m_materialBatches.count();
+    for (int i = 0; i < nbatches; i++) {
+        m_materials.append(new Material(this, m_materialBatches[i], m_encodingRef, i));
     }
 }
 
-void Model::setVertexRefsRecurse(const aiScene *scene, const aiNode *node)
+void Model::setVertexRefs()
 {
-    const unsigned int nmeshes = node->mNumMeshes;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const aiVector3D *meshVertices = mesh->mVertices;
-        const aiVector3D *meshNormals = mesh->HasNormals() ? mesh->mNormals : 0;
-        const aiVector3D *meshTextureCoords = mesh->HasTextureCoords(0) ? mesh->mTextureCoords[0] : 0;
-        const unsigned int nvertices = mesh->mNumVertices;
-        for (unsigned int j = 0; j < nvertices; j++) {
-            const aiVector3D &v = meshVertices[j];
-            const aiVector3D &n = meshNormals ? meshVertices[j] : aiVector3D();
-            const aiVector3D &t = meshTextureCoords ? meshTextureCoords[j] : aiVector3D();
-            m_vertices.append(new Vertex(this, Vector3(v.x, v.y, v.z), Vector3(n.x, n.y, n.z), Vector3(t.x, t.y, t.z), j));
-        }
+    const int nvertices = m_meshVertices.count();
+    for (int i = 0; i < nvertices; i++) {
+        const MeshVertex &vertex = m_meshVertices[i];
+        m_vertices.append(new Vertex(this, vertex.position, vertex.normal, vertex.texcoord, i));
     }
 }
 
-void Model::getBoundingBoxRecurse(const aiScene *scene, const aiNode *node, Vector3 &min, Vector3 &max) const
+bool Model::loadCache(const uint8 *data, vsize size)
 {
-    const unsigned int nmeshes = node->mNumMeshes;
-    const Scalar &scale = scaleFactor();
-    Vector3 position;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const aiVector3D *vertices = mesh->mVertices;
-        const unsigned int nvertices = mesh->mNumVertices;
-        for (unsigned int j = 0; j < nvertices; j++) {
-            const aiVector3D &vertex = vertices[i] * scale;
-            position.setValue(vertex.x, vertex.y, vertex.z);
-            min.setMin(position);
-            max.setMax(position);
+    uint8 *ptr = const_cast<uint8 *>(data);
+    vsize rest = size;
+    CacheHeaderUnit header;
+    if (!internal::getTyped<CacheHeaderUnit>(ptr, rest, header) || header.version != kCacheVersion) {
+        VPVL2_LOG(WARNING, "Invalid asset cache header detected: size=" << size);
+        return false;
+    }
+    const uint32 nvertices = header.nvertices, nindices = header.nindices, nbatches = header.nbatches;
+    uint8 *verticesPtr = ptr, *indicesPtr = 0;
+    if (!internal::validateSize(ptr, sizeof(CacheVertexUnit), nvertices, rest)) {
+        VPVL2_LOG(WARNING, "Invalid asset cache vertices detected: size=" << nvertices << " rest=" << rest);
+        return false;
+    }
+    indicesPtr = ptr;
+    if (!internal::validateSize(ptr, sizeof(uint32), nindices, rest)) {
+        VPVL2_LOG(WARNING, "Invalid asset cache indices detected: size=" << nindices << " rest=" << rest);
+        return false;
+    }
+    m_meshVertices.clear();
+    m_meshIndices.clear();
+    m_materialBatches.clear();
+    m_meshVertices.reserve(nvertices);
+    m_meshIndices.reserve(nindices);
+    CacheVertexUnit vu;
+    MeshVertex vertex;
+    for (uint32 i = 0; i < nvertices; i++) {
+        internal::getData(verticesPtr + i * sizeof(vu), vu);
+        vertex.position = readVector3(vu.position);
+        vertex.normal = readVector3(vu.normal);
+        vertex.texcoord = readVector3(vu.texcoord);
+        vertex.tangent = readVector3(vu.tangent);
+        vertex.bitangent = readVector3(vu.bitangent);
+        m_meshVertices.append(vertex);
+    }
+    uint32 index = 0;
+    for (uint32 i = 0; i < nindices; i++) {
+        internal::getData(indicesPtr + i * sizeof(index), index);
+        if (index >= nvertices) {
+            VPVL2_LOG(WARNING, "Invalid asset cache index detected: index=" << index << " nvertices=" << nvertices);
+            return false;
+        }
+        m_meshIndices.append(index);
+    }
+    CacheMaterialBatchUnit bu;
+    MaterialBatch batch;
+    for (uint32 i = 0; i < nbatches; i++) {
+        if (!internal::getTyped<CacheMaterialBatchUnit>(ptr, rest, bu)) {
+            VPVL2_LOG(WARNING, "Invalid asset cache batch detected: index=" << i << " rest=" << rest);
+            return false;
+        }
+        const vsize textureSize = bu.texturePathSize;
+        const uint8 *texturePtr = ptr;
+        if (!internal::validateSize(ptr, alignCacheSize(textureSize), rest) ||
+                bu.indexOffset < 0 || bu.nindices < 0 || uint32(bu.indexOffset + bu.nindices) > nindices) {
+            VPVL2_LOG(WARNING, "Invalid asset cache batch range detected: index=" << i << " offset=" << bu.indexOffset << " size=" << bu.nindices);
+            return false;
+        }
+        batch.texturePath.assign(reinterpret_cast<const char *>(texturePtr), textureSize);
+        batch.ambient = readColor(bu.ambient);
+        batch.diffuse = readColor(bu.diffuse);
+        batch.specular = readColor(bu.specular);
+        batch.emissive = readColor(bu.emissive);
+        batch.shininess = bu.shininess;
+        batch.opacity = bu.opacity;
+        batch.materialIndex = bu.materialIndex;
+        batch.primitiveType = bu.primitiveType;
+        batch.indexOffset = bu.indexOffset;
+        batch.nindices = bu.nindices;
+        batch.hasShininess = bu.hasShininess != 0;
+        batch.hasOpacity = bu.hasOpacity != 0;
+        batch.isTwoSided = bu.isTwoSided != 0;
+        m_materialBatches.append(batch);
+    }
+    VPVL2_VLOG(1, "Loaded asset cache: batches=" << nbatches << " vertices=" << nvertices << " indices=" << nindices);
+    return true;
+}
+
+void Model::buildMaterialBatches(const aiScene *scene)
+{
+    /* bakes static node transforms and merges meshes sharing a material into one sub range */
+    MeshInstanceMap instances;
+    collectMeshInstancesRecurse(scene, scene->mRootNode, aiMatrix4x4(), instances);
+    m_meshVertices.clear();
+    m_meshIndices.clear();
+    m_materialBatches.clear();
+    MaterialBatch batch;
+    MeshVertex vertex;
+    for (MeshInstanceMap::const_iterator it = instances.begin(), end = instances.end(); it != end; it++) {
+        const std::vector<MeshInstance> &meshInstances = it->second;
+        const int ninstances = int(meshInstances.size());
+        setMaterialBatchProperties(scene->mMaterials[it->first.first], batch);
+        batch.materialIndex = it->first.first;
+        batch.primitiveType = it->first.second;
+        batch.indexOffset = m_meshIndices.count();
+        for (int i = 0; i < ninstances; i++) {
+            const MeshInstance &instance = meshInstances[i];
+            const aiMesh *mesh = instance.mesh;
+            const bool isIdentity = instance.transform.IsIdentity();
+            aiMatrix4x4 normalTransform4x4(instance.transform);
+            normalTransform4x4.Inverse().Transpose();
+            const aiMatrix3x3 transform3x3(instance.transform), normalTransform3x3(normalTransform4x4);
+            const aiVector3D *normals = mesh->HasNormals() ? mesh->mNormals : 0;
+            const aiVector3D *texcoords = mesh->HasTextureCoords(0) ? mesh->mTextureCoords[0] : 0;
+            const aiVector3D *tangents = mesh->HasTangentsAndBitangents() ? mesh->mTangents : 0;
+            const aiVector3D *bitangents = mesh->HasTangentsAndBitangents() ? mesh->mBitangents : 0;
+            const uint32 baseVertex = m_meshVertices.count();
+            const unsigned int nvertices = mesh->mNumVertices;
+            for (unsigned int j = 0; j < nvertices; j++) {
+                if (isIdentity) {
+                    vertex.position = toVector3(mesh->mVertices[j]);
+                    vertex.normal = normals ? toVector3(normals[j]) : kZeroV3;
+                    vertex.tangent = tangents ? toVector3(tangents[j]) : kZeroV3;
+                    vertex.bitangent = bitangents ? toVector3(bitangents[j]) : kZeroV3;
+                }
+                else {
+                    vertex.position = toVector3(instance.transform * mesh->mVertices[j]);
+                    vertex.normal = normals ? toNormalizedVector3(normalTransform3x3 * normals[j]) : kZeroV3;
+                    vertex.tangent = tangents ? toNormalizedVector3(transform3x3 * tangents[j]) : kZeroV3;
+                    vertex.bitangent = bitangents ? toNormalizedVector3(transform3x3 * bitangents[j]) : kZeroV3;
+                }
+                vertex.texcoord = texcoords ? toVector3(texcoords[j]) : kZeroV3;
+                m_meshVertices.append(vertex);
+            }
+            const unsigned int nfaces = mesh->mNumFaces;
+            for (unsigned int j = 0; j < nfaces; j++) {
+                const aiFace &face = mesh->mFaces[j];
+                const unsigned int nindices = face.mNumIndices;
+                for (unsigned int k = 0; k < nindices; k++) {
+                    m_meshIndices.append(baseVertex + face.mIndices[k]);
+                }
+            }
         }
+        batch.nindices = m_meshIndices.count() - batch.indexOffset;
+        m_materialBatches.append(batch);
     }
+    VPVL2_VLOG(1, "Flattened asset meshes: batches=" << m_materialBatches.count() << " vertices=" << m_meshVertices.count() << " indices=" << m_meshIndices.count());
 }
 #endif
 
@@ -36,6 +36,7 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/util.h"
 
 #if defined(VPVL2_ENABLE_QT)
@@ -93,6 +94,8 @@ static inline void ShutdownGoogleLogging() {}
 #define InstallFailureHandler(logdir)
 #endif
 
+static int g_modelGeneration = 0;
+
 }
 
 namespace vpvl2
@@ -153,6 +156,21 @@ void uninstallLogger()
     google::ShutdownGoogleLogging();
 }
 
+namespace internal
+{
+
+int modelGeneration() VPVL2_DECL_NOEXCEPT
+{
+    return g_modelGeneration;
+}
+
+void advanceModelGeneration() VPVL2_DECL_NOEXCEPT
+{
+    g_modelGeneration++;
+}
+
+} /* namespace internal */
+
 #if defined(VPVL2_ENABLE_QT)
 #undef ERROR
 QLoggingCategory &findLoggingBasicCategory(int level) {
@@ -259,7 +259,6 @@ struct Factory::PrivateContext
             keyframeTo->setName(keyframeFrom->name());
             keyframeTo->setLocalTranslation(keyframeFrom->localTranslation());
             keyframeTo->setLocalOrientation(keyframeFrom->localOrientation());
-            keyframeTo->setDefaultInterpolationParameter();
             keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionX, value);
             keyframeTo->setInterpolationParameter(IBoneKeyframe::kBonePositionX, value);
             keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionY, value);
@@ -272,7 +271,7 @@ struct Factory::PrivateContext
         }
         motion->setAllKeyframes(boneKeyframes, IKeyframe::kBoneKeyframe);
         const int nCameraKeyframes = source->countKeyframes(IKeyframe::kCameraKeyframe);
-        cameraKeyframes.resize(nCameraKeyframes);
+        cameraKeyframes.reserve(nCameraKeyframes);
         for (int i = 0; i < nCameraKeyframes; i++) {
             mvd::CameraKeyframe *keyframeTo = mvdCameraKeyframe = new mvd::CameraKeyframe(motion);
             const ICameraKeyframe *keyframeFrom = source->findCameraKeyframeRefAt(i);
@@ -282,7 +281,6 @@ struct Factory::PrivateContext
             keyframeTo->setFov(keyframeFrom->fov());
             keyframeTo->setDistance(keyframeFrom->distance());
             keyframeTo->setPerspective(keyframeFrom->isPerspective());
-            keyframeTo->setDefaultInterpolationParameter();
             keyframeFrom->getInterpolationParameter(ICameraKeyframe::kCameraLookAtX, value);
             keyframeTo->setInterpolationParameter(ICameraKeyframe::kCameraLookAtX, value);
             keyframeFrom->getInterpolationParameter(ICameraKeyframe::kCameraAngle, value);
@@ -328,6 +326,7 @@ struct Factory::PrivateContext
     vmd::Motion *createVMDFromMVD(mvd::Motion *source) const {
         vmd::Motion *motion = vmdPtr = new vmd::Motion(source->parentModelRef(), encodingRef);
         const int nBoneKeyframes = source->countKeyframes(IKeyframe::kBoneKeyframe);
+        IBoneKeyframe::InterpolationParameter parameter;
         QuadWord value;
         Array<IKeyframe *> boneKeyframes, cameraKeyframes, lightKeyframes, morphKeyframes;
         boneKeyframes.reserve(nBoneKeyframes);
@@ -338,15 +337,12 @@ struct Factory::PrivateContext
             keyframeTo->setName(keyframeFrom->name());
             keyframeTo->setLocalTranslation(keyframeFrom->localTranslation());
             keyframeTo->setLocalOrientation(keyframeFrom->localOrientation());
-            keyframeTo->setDefaultInterpolationParameter();
-            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionX, value);
-            keyframeTo->setInterpolationParameter(IBoneKeyframe::kBonePositionX, value);
-            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionY, value);
-            keyframeTo->setInterpolationParameter(IBoneKeyframe::kBonePositionY, value);
-            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionZ, value);
-            keyframeTo->setInterpolationParameter(IBoneKeyframe::kBonePositionZ, value);
-            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBoneRotation, value);
-            keyframeTo->setInterpolationParameter(IBoneKeyframe::kBoneRotation, value);
+            /* VMD packs all parameters into one table, so it is built once rather than per type */
+            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionX, parameter.x);
+            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionY, parameter.y);
+            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBonePositionZ, parameter.z);
+            keyframeFrom->getInterpolationParameter(IBoneKeyframe::kBoneRotation, parameter.rotation);
+            keyframeTo->setInterpolationParameters(parameter);
             boneKeyframes.append(keyframeTo);
         }
         motion->setAllKeyframes(boneKeyframes, IKeyframe::kBoneKeyframe);
@@ -361,7 +357,6 @@ struct Factory::PrivateContext
             keyframeTo->setFov(keyframeFrom->fov());
             keyframeTo->setDistance(keyframeFrom->distance());
             keyframeTo->setPerspective(keyframeFrom->isPerspective());
-            keyframeTo->setDefaultInterpolationParameter();
             keyframeFrom->getInterpolationParameter(ICameraKeyframe::kCameraLookAtX, value);
             keyframeTo->setInterpolationParameter(ICameraKeyframe::kCameraLookAtX, value);
             keyframeTo->setInterpolationParameter(ICameraKeyframe::kCameraLookAtY, value);
@@ -502,6 +497,30 @@ IModel *Factory::createModel(const uint8 *data, vsize size, bool &ok) const
     return model;
 }
 
+IModel *Factory::createModelInstance(IModel *source, bool &ok) const
+{
+    IModel *model = 0;
+    ok = false;
+    if (source && source->type() == IModel::kPMXModel) {
+        model = static_cast<pmx::Model *>(source)->createInstance();
+        if (model && m_context->progressReporterRef) {
+            model->setProgressReporterRef(m_context->progressReporterRef);
+        }
+        ok = model != 0;
+    }
+    else if (const vsize size = source ? source->estimateSize() : 0) {
+        Array<uint8> bytes;
+        bytes.resize(int(size));
+        vsize written = 0;
+        source->save(&bytes[0], written);
+        model = createModel(&bytes[0], written, ok);
+        if (!ok) {
+            internal::deleteObject(model);
+        }
+    }
+    return model;
+}
+
 IMotion *Factory::newMotion(IMotion::FormatType type, IModel *modelRef) const
 {
     switch (type) {
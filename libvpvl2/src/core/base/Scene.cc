@@ -37,6 +37,8 @@
 
 #include "vpvl2/vpvl2.h"
 #include "vpvl2/IApplicationContext.h"
+#include "vpvl2/internal/BoneBoundingBox.h"
+#include "vpvl2/internal/Frustum.h"
 #include "vpvl2/internal/util.h"
 
 #include "vpvl2/asset/Model.h"
@@ -373,6 +375,15 @@ struct Scene::PrivateContext VPVL2_DECL_FINAL
             return left->priority < right->priority;
         }
     };
+    struct CullingState VPVL2_DECL_FINAL {
+        CullingState()
+            : modelFlags(0)
+        {
+        }
+        /* bits of Scene::CullingTypeFlags the model/material is outside of */
+        int modelFlags;
+        Array<int> materialFlags;
+    };
 
     static void handleRegalErrorCallback(GLenum error) {
         (void) error;
@@ -389,12 +400,14 @@ struct Scene::PrivateContext VPVL2_DECL_FINAL
           currentTimeIndex(0),
           currentSeconds(0),
           preferredFPS(Scene::defaultFPS()),
-          ownMemory(ownMemory)
+          ownMemory(ownMemory),
+          enableCulling(false)
     {
     }
     ~PrivateContext() {
         destroyWorld();
         releaseAllRenderEngines();
+        cullingStates.releaseAll();
         motions.releaseAll();
         engines.releaseAll();
         models.releaseAll();
@@ -458,6 +471,12 @@ struct Scene::PrivateContext VPVL2_DECL_FINAL
                 break;
             }
         }
+        const HashPtr key(model);
+        if (CullingState *const *statePtr = cullingStates.find(key)) {
+            CullingState *state = *statePtr;
+            cullingStates.remove(key);
+            internal::deleteObject(state);
+        }
     }
     void removeMotionPtr(IMotion *motion) {
         const int nmotions = motions.count();
@@ -536,9 +555,120 @@ struct Scene::PrivateContext VPVL2_DECL_FINAL
         const int nengines = engines.count();
         for (int i = 0; i < nengines; i++) {
             IRenderEngine *engine = engines[i]->value;
-            engine->update();
+            /* skinning is skipped only if the model is drawn by none of the passes */
+            if (!isCulled(engine->parentModelRef(), -1, kCullingAll)
+                    || engine->hasPreProcess() || engine->hasPostProcess()) {
+                engine->update();
+            }
         }
     }
+    bool hasOffscreenRenderTargets() const {
+        static const IEffect::ScriptOrderType kScriptOrderTypes[] = {
+            IEffect::kPreProcess, IEffect::kStandard, IEffect::kPostProcess
+        };
+        Array<IEffect::OffscreenRenderTarget> renderTargets;
+        const int nengines = engines.count();
+        for (int i = 0; i < nengines; i++) {
+            const IRenderEngine *engine = engines[i]->value;
+            for (vsize j = 0; j < sizeof(kScriptOrderTypes) / sizeof(kScriptOrderTypes[0]); j++) {
+                if (const IEffect *effect = engine->effectRef(kScriptOrderTypes[j])) {
+                    effect->getOffscreenRenderTargets(renderTargets);
+                    if (renderTargets.count() > 0) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+    static void transformAabb(const Transform &transform, const Scalar &scaleFactor, const Vector3 &min, const Vector3 &max,
+                              Vector3 &worldMin, Vector3 &worldMax) {
+        worldMin.setValue(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY);
+        worldMax.setValue(-SIMD_INFINITY, -SIMD_INFINITY, -SIMD_INFINITY);
+        internal::BoneBoundingBox::transformExtent(transform, min * scaleFactor, max * scaleFactor, worldMin, worldMax);
+    }
+    int testCulling(const Transform &transform, const Scalar &scaleFactor, const Vector3 &min, const Vector3 &max,
+                    const Scalar &edgeWidth, const Vector3 &lightDirection) const {
+        int flags = 0;
+        Vector3 worldMin, worldMax, shadowMin, shadowMax;
+        transformAabb(transform, scaleFactor, min, max, worldMin, worldMax);
+        if (!viewFrustum.intersects(worldMin, worldMax)) {
+            flags |= kCullingViewFrustum;
+        }
+        /* edges are extruded along the normals in the model space */
+        const Vector3 edgeExtent(edgeWidth, edgeWidth, edgeWidth);
+        transformAabb(transform, scaleFactor, min - edgeExtent, max + edgeExtent, shadowMin, shadowMax);
+        if (!viewFrustum.intersects(shadowMin, shadowMax)) {
+            flags |= kCullingEdge;
+        }
+        if (internal::Frustum::projectOntoGround(worldMin, worldMax, lightDirection, shadowMin, shadowMax)
+                && !viewFrustum.intersects(shadowMin, shadowMax)) {
+            flags |= kCullingGroundShadow;
+        }
+        /* the shadow map pass is never rendered without IShadowMap */
+        if (!shadowMapRef || (shadowFrustum.isEnabled() && !shadowFrustum.intersects(worldMin, worldMax))) {
+            flags |= kCullingShadowFrustum;
+        }
+        return flags;
+    }
+    void updateCulling() {
+        const bool enabled = enableCulling && viewFrustum.isEnabled() && !hasOffscreenRenderTargets();
+        const Vector3 &lightDirection = light.direction(), &cameraPosition = camera.position();
+        Array<IMaterial *> materials;
+        Array<Vector3> materialAabbs;
+        Array<Scalar> materialEdgeSizes;
+        const int nmodels = models.count();
+        for (int i = 0; i < nmodels; i++) {
+            const IModel *model = models[i]->value;
+            const HashPtr key(model);
+            CullingState *state = 0;
+            if (CullingState *const *statePtr = cullingStates.find(key)) {
+                state = *statePtr;
+            }
+            else {
+                state = cullingStates.insert(key, new CullingState());
+            }
+            state->modelFlags = 0;
+            state->materialFlags.clear();
+            Vector3 aabbMin, aabbMax;
+            if (!enabled || !model->isVisible() || !model->computeConservativeAabb(aabbMin, aabbMax, &materialAabbs, &materialEdgeSizes)) {
+                continue;
+            }
+            /* same order as world matrix of IApplicationContext#getMatrix */
+            Transform transform(model->worldOrientation(), model->worldTranslation());
+            if (const IBone *parentBoneRef = model->parentBoneRef()) {
+                transform *= parentBoneRef->worldTransform();
+            }
+            const Scalar scaleFactor = btMax(model->scaleFactor(), Scalar(0));
+            const Scalar edgeScaleFactor = btMax(Scalar(model->edgeScaleFactor(cameraPosition)), Scalar(0));
+            model->getMaterialRefs(materials);
+            const int nmaterials = btMin(materialAabbs.count() / 2, btMin(materialEdgeSizes.count(), materials.count()));
+            Scalar modelEdgeWidth = 0;
+            for (int j = 0; j < nmaterials; j++) {
+                const Vector3 &materialMin = materialAabbs[j * 2], &materialMax = materialAabbs[j * 2 + 1];
+                const Scalar &edgeWidth = materialEdgeSizes[j] * btMax(Scalar(materials[j]->edgeSize()), Scalar(0)) * edgeScaleFactor;
+                int flags = kCullingAll;
+                if (materialMin.x() <= materialMax.x()) {
+                    flags = testCulling(transform, scaleFactor, materialMin, materialMax, edgeWidth, lightDirection);
+                }
+                modelEdgeWidth = btMax(modelEdgeWidth, edgeWidth);
+                state->materialFlags.append(flags);
+            }
+            state->modelFlags = testCulling(transform, scaleFactor, aabbMin, aabbMax, modelEdgeWidth, lightDirection);
+        }
+        /* matrices are valid only for the current frame, the next frame is not culled until they are set again */
+        viewFrustum.setMatrix(0);
+        shadowFrustum.setMatrix(0);
+    }
+    bool isCulled(const IModel *model, int materialIndex, int flags) const {
+        if (const CullingState *const *statePtr = cullingStates.find(HashPtr(model))) {
+            const CullingState *state = *statePtr;
+            const int value = materialIndex >= 0 && materialIndex < state->materialFlags.count()
+                    ? state->materialFlags[materialIndex] : state->modelFlags;
+            return flags != 0 && (value & flags) == flags;
+        }
+        return false;
+    }
     void updateCamera() {
         camera.updateTransform();
     }
@@ -632,7 +762,11 @@ struct Scene::PrivateContext VPVL2_DECL_FINAL
     IKeyframe::TimeIndex currentTimeIndex;
     float64 currentSeconds;
     Scalar preferredFPS;
+    PointerHash<HashPtr, CullingState> cullingStates;
+    internal::Frustum viewFrustum;
+    internal::Frustum shadowFrustum;
     bool ownMemory;
+    bool enableCulling;
 };
 
 bool Scene::initialize(void *opaque)
@@ -996,6 +1130,7 @@ void Scene::update(int flags)
      * #updateModels() performs transforming position to skinned position by the model's bones.
      */
     if (internal::hasFlagBits(flags, kUpdateRenderEngines)) {
+        m_context->updateCulling();
         m_context->updateRenderEngines();
     }
 }
@@ -1168,5 +1303,39 @@ void Scene::setWorldRef(btDiscreteDynamicsWorld *worldRef) VPVL2_DECL_NOEXCEPT
     m_context->setWorldRef(worldRef);
 }
 
+bool Scene::isCullingEnabled() const VPVL2_DECL_NOEXCEPT
+{
+    return m_context->enableCulling;
+}
+
+void Scene::setCullingEnable(bool value) VPVL2_DECL_NOEXCEPT
+{
+    m_context->enableCulling = value;
+}
+
+void Scene::setCullingMatrix(CullingTypeFlags type, const float32 *value) VPVL2_DECL_NOEXCEPT
+{
+    switch (type) {
+    case kCullingViewFrustum:
+        m_context->viewFrustum.setMatrix(value);
+        break;
+    case kCullingShadowFrustum:
+        m_context->shadowFrustum.setMatrix(value);
+        break;
+    default:
+        break;
+    }
+}
+
+bool Scene::isModelCulled(const IModel *model, int flags) const
+{
+    return m_context->enableCulling && m_context->isCulled(model, -1, flags);
+}
+
+bool Scene::isMaterialCulled(const IModel *model, int materialIndex, int flags) const
+{
+    return m_context->enableCulling && materialIndex >= 0 && m_context->isCulled(model, materialIndex, flags);
+}
+
 } /* namespace VPVL2_VERSION_NS */
 } /* namespace vpvl2 */
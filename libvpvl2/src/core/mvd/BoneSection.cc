@@ -36,6 +36,7 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/MotionHelper.h"
 
 #include "vpvl2/mvd/BoneKeyframe.h"
@@ -134,12 +135,19 @@ struct BoneSection::PrivateContext {
         name2tracks.releaseAll();
         allKeyframeRefs.clear();
         track2names.clear();
+        bindingCache.clear();
+    }
+    int findTrackKey(const BoneAnimationTrack *track) const {
+        const int *key = track2names.find(track);
+        return key ? *key : NameListSection::kNotFound;
     }
 
     IModel *modelRef;
     Array<IKeyframe *> allKeyframeRefs;
     PointerHash<HashInt, BoneAnimationTrack> name2tracks;
     Hash<HashPtr, int> track2names;
+    /* track ids are positions in name2tracks */
+    internal::ModelBindingCache<IBone> bindingCache;
 };
 
 BoneSection::BoneSection(const Motion *motionRef, IModel *modelRef)
@@ -199,6 +207,7 @@ void BoneSection::read(const uint8 *data)
     const int key = header.key;
     const IString *name = m_nameListSectionRef->value(key);
     BoneAnimationTrack *trackPtr = m_context->name2tracks.insert(key, new BoneAnimationTrack());
+    m_context->bindingCache.clear();
     m_context->track2names.insert(trackPtr, key);
     trackPtr->keyframes.reserve(nkeyframes);
     for (int i = 0; i < nkeyframes; i++) {
@@ -231,18 +240,17 @@ void BoneSection::setParentModel(IModel *modelRef)
     m_context->modelRef = modelRef;
     if (modelRef) {
         const int ntracks = m_context->name2tracks.count();
+        Array<const IString *> names;
+        names.reserve(ntracks);
         for (int i = 0; i < ntracks; i++) {
-            if (BoneAnimationTrack *const *track = m_context->name2tracks.value(i)) {
-                BoneAnimationTrack *trackRef = *track;
-                if (const int *keyPtr = m_context->track2names.find(trackRef)) {
-                    int key = *keyPtr;
-                    IBone *bone = modelRef->findBoneRef(m_nameListSectionRef->value(key));
-                    trackRef->boneRef = bone;
-                }
-                else {
-                    trackRef->boneRef = 0;
-                }
-            }
+            const int *key = m_context->track2names.find(*m_context->name2tracks.value(i));
+            names.append(key ? m_nameListSectionRef->value(*key) : 0);
+        }
+        /* bones are resolved once per model and reused while swapping models */
+        const Array<IBone *> &boneRefs = m_context->bindingCache.resolve(modelRef, names);
+        for (int i = 0; i < ntracks; i++) {
+            BoneAnimationTrack *trackRef = *m_context->name2tracks.value(i);
+            trackRef->boneRef = boneRefs[i];
         }
     }
 }
@@ -253,7 +261,8 @@ void BoneSection::write(uint8 *data) const
     for (int i = 0; i < ntracks; i++) {
         const BoneAnimationTrack *const *track = m_context->name2tracks.value(i);
         const BoneAnimationTrack *trackRef = *track;
-        if (const IBone *boneRef = trackRef->boneRef) {
+        const int key = m_context->findTrackKey(trackRef);
+        if (key != NameListSection::kNotFound) {
             const BoneAnimationTrack::KeyframeCollection &keyframes = trackRef->keyframes;
             const int nkeyframes = keyframes.count();
             const int nlayers = trackRef->countOfLayers;
@@ -264,7 +273,7 @@ void BoneSection::write(uint8 *data) const
             BoneSectionHeader header;
             header.countOfKeyframes = nkeyframes;
             header.countOfLayers = nlayers;
-            header.key = m_nameListSectionRef->key(boneRef->name(IEncoding::kDefaultLanguage));
+            header.key = key;
             header.sizeOfKeyframe = int32(BoneKeyframe::size());
             internal::writeBytes(&header, sizeof(header), data);
             for (int i = 0; i < nlayers; i++) {
@@ -286,7 +295,7 @@ vsize BoneSection::estimateSize() const
     for (int i = 0; i < ntracks; i++) {
         const BoneAnimationTrack *const *track = m_context->name2tracks.value(i);
         const BoneAnimationTrack *trackRef = *track;
-        if (trackRef->boneRef) {
+        if (m_context->findTrackKey(trackRef) != NameListSection::kNotFound) {
             const BoneAnimationTrack::KeyframeCollection &keyframes = trackRef->keyframes;
             const int nkeyframes = keyframes.count();
             size += sizeof(Motion::SectionTag);
@@ -328,6 +337,7 @@ void BoneSection::addKeyframe(IKeyframe *keyframe)
     }
     else if (m_context->modelRef) {
         trackPtr = m_context->name2tracks.insert(key, new BoneAnimationTrack());
+        m_context->bindingCache.clear();
         trackPtr->boneRef = m_context->modelRef->findBoneRef(keyframe->name());
         trackPtr->keyframes.append(keyframe);
         m_context->allKeyframeRefs.append(keyframe);
@@ -346,6 +356,7 @@ void BoneSection::removeKeyframe(IKeyframe *keyframe)
         if (trackPtr->keyframes.count() == 0) {
             m_context->name2tracks.remove(key);
             m_context->track2names.remove(trackPtr);
+            m_context->bindingCache.clear();
             internal::deleteObject(trackPtr);
         }
     }
@@ -370,14 +381,35 @@ void BoneSection::getAllKeyframes(Array<IKeyframe *> &value) const
 
 void BoneSection::setAllKeyframes(const Array<IKeyframe *> &value)
 {
-    release();
+    /* BaseSection::release resets the name list reference, so only the tracks are released here */
+    m_context->release();
+    m_durationTimeIndex = 0;
     const int nkeyframes = value.count();
+    m_context->allKeyframeRefs.reserve(nkeyframes);
     for (int i = 0; i < nkeyframes; i++) {
         IKeyframe *keyframe = value[i];
         if (keyframe && keyframe->type() == IKeyframe::kBoneKeyframe) {
+            const int key = m_nameListSectionRef->key(keyframe->name());
+            BoneAnimationTrack *const *track = m_context->name2tracks.find(key), *trackPtr = 0;
+            if (track) {
+                trackPtr = *track;
+            }
+            else {
+                trackPtr = m_context->name2tracks.insert(key, new BoneAnimationTrack());
+                m_context->track2names.insert(trackPtr, key);
+            }
+            trackPtr->keyframes.append(keyframe);
             m_context->allKeyframeRefs.append(keyframe);
+            btSetMax(m_durationTimeIndex, keyframe->timeIndex());
         }
     }
+    /* sorts and binds each track once instead of per added keyframe */
+    const int ntracks = m_context->name2tracks.count();
+    for (int i = 0; i < ntracks; i++) {
+        BoneAnimationTrack *trackPtr = *m_context->name2tracks.value(i);
+        trackPtr->keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+    }
+    setParentModel(m_context->modelRef);
 }
 
 void BoneSection::createFirstKeyframeUnlessFound()
@@ -36,6 +36,7 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/MotionHelper.h"
 
 #include "vpvl2/mvd/MorphKeyframe.h"
@@ -119,12 +120,19 @@ struct MorphSection::PrivateContext {
         name2tracks.releaseAll();
         allKeyframeRefs.clear();
         track2names.clear();
+        bindingCache.clear();
+    }
+    int findTrackKey(const MorphAnimationTrack *track) const {
+        const int *key = track2names.find(track);
+        return key ? *key : NameListSection::kNotFound;
     }
 
     IModel *modelRef;
     Array<IKeyframe *> allKeyframeRefs;
     PointerHash<HashInt, MorphAnimationTrack> name2tracks;
     Hash<HashPtr, int> track2names;
+    /* track ids are positions in name2tracks */
+    internal::ModelBindingCache<IMorph> bindingCache;
 };
 
 MorphSection::MorphSection(const Motion *motionRef, IModel *modelRef)
@@ -182,6 +190,7 @@ void MorphSection::read(const uint8 *data)
     const int key = header.key;
     const IString *name = m_nameListSectionRef->value(key);
     MorphAnimationTrack *trackPtr = m_context->name2tracks.insert(key, new MorphAnimationTrack());
+    m_context->bindingCache.clear();
     trackPtr->keyframes.reserve(nkeyframes);
     ptr += sizeof(header) + header.reserved;
     for (int i = 0; i < nkeyframes; i++) {
@@ -214,17 +223,17 @@ void MorphSection::setParentModel(IModel *model)
     m_context->modelRef = model;
     if (model) {
         const int ntracks = m_context->name2tracks.count();
+        Array<const IString *> names;
+        names.reserve(ntracks);
         for (int i = 0; i < ntracks; i++) {
-            if (MorphAnimationTrack *const *track = m_context->name2tracks.value(i)) {
-                MorphAnimationTrack *trackRef = *track;
-                if (const int *key = m_context->track2names.find(trackRef)) {
-                    IMorph *morph = model->findMorphRef(m_nameListSectionRef->value(*key));
-                    trackRef->morphRef = morph;
-                }
-                else {
-                    trackRef->morphRef = 0;
-                }
-            }
+            const int *key = m_context->track2names.find(*m_context->name2tracks.value(i));
+            names.append(key ? m_nameListSectionRef->value(*key) : 0);
+        }
+        /* morphs are resolved once per model and reused while swapping models */
+        const Array<IMorph *> &morphRefs = m_context->bindingCache.resolve(model, names);
+        for (int i = 0; i < ntracks; i++) {
+            MorphAnimationTrack *trackRef = *m_context->name2tracks.value(i);
+            trackRef->morphRef = morphRefs[i];
         }
     }
 }
@@ -235,7 +244,8 @@ void MorphSection::write(uint8 *data) const
     for (int i = 0; i < ntracks; i++) {
         const MorphAnimationTrack *const *track = m_context->name2tracks.value(i);
         const MorphAnimationTrack *trackRef = *track;
-        if (const IMorph *morph = trackRef->morphRef) {
+        const int key = m_context->findTrackKey(trackRef);
+        if (key != NameListSection::kNotFound) {
             const MorphAnimationTrack::KeyframeCollection &keyframes = trackRef->keyframes;
             const int nkeyframes = keyframes.count();
             Motion::SectionTag tag;
@@ -244,7 +254,7 @@ void MorphSection::write(uint8 *data) const
             internal::writeBytes(&tag, sizeof(tag), data);
             MorphSecionHeader header;
             header.countOfKeyframes = nkeyframes;
-            header.key = m_nameListSectionRef->key(morph->name(IEncoding::kDefaultLanguage));
+            header.key = key;
             header.reserved = 0;
             header.sizeOfKeyframe = int32(MorphKeyframe::size());
             internal::writeBytes(&header ,sizeof(header), data);
@@ -264,7 +274,7 @@ vsize MorphSection::estimateSize() const
     for (int i = 0; i < ntracks; i++) {
         const MorphAnimationTrack *const *track = m_context->name2tracks.value(i);
         const MorphAnimationTrack *trackPtr = *track;
-        if (trackPtr->morphRef) {
+        if (m_context->findTrackKey(trackPtr) != NameListSection::kNotFound) {
             const MorphAnimationTrack::KeyframeCollection &keyframes = trackPtr->keyframes;
             const int nkeyframes = keyframes.count();
             size += sizeof(Motion::SectionTag);
@@ -299,6 +309,7 @@ void MorphSection::addKeyframe(IKeyframe *keyframe)
     }
     else if (m_context->modelRef) {
         trackPtr = m_context->name2tracks.insert(key, new MorphAnimationTrack());
+        m_context->bindingCache.clear();
         trackPtr->morphRef = m_context->modelRef->findMorphRef(keyframe->name());
         trackPtr->keyframes.append(keyframe);
         m_context->allKeyframeRefs.append(keyframe);
@@ -316,6 +327,7 @@ void MorphSection::removeKeyframe(IKeyframe *keyframe)
         if (trackPtr->keyframes.count() == 0) {
             m_context->name2tracks.remove(key);
             m_context->track2names.remove(trackPtr);
+            m_context->bindingCache.clear();
             internal::deleteObject(trackPtr);
         }
     }
@@ -340,14 +352,35 @@ void MorphSection::getAllKeyframes(Array<IKeyframe *> &keyframes) const
 
 void MorphSection::setAllKeyframes(const Array<IKeyframe *> &value)
 {
-    release();
+    /* BaseSection::release resets the name list reference, so only the tracks are released here */
+    m_context->release();
+    m_durationTimeIndex = 0;
     const int nkeyframes = value.count();
+    m_context->allKeyframeRefs.reserve(nkeyframes);
     for (int i = 0; i < nkeyframes; i++) {
         IKeyframe *keyframe = value[i];
         if (keyframe && keyframe->type() == IKeyframe::kMorphKeyframe) {
+            const int key = m_nameListSectionRef->key(keyframe->name());
+            MorphAnimationTrack *const *track = m_context->name2tracks.find(key), *trackPtr = 0;
+            if (track) {
+                trackPtr = *track;
+            }
+            else {
+                trackPtr = m_context->name2tracks.insert(key, new MorphAnimationTrack());
+                m_context->track2names.insert(trackPtr, key);
+            }
+            trackPtr->keyframes.append(keyframe);
             m_context->allKeyframeRefs.append(keyframe);
+            btSetMax(m_durationTimeIndex, keyframe->timeIndex());
         }
     }
+    /* sorts and binds each track once instead of per added keyframe */
+    const int ntracks = m_context->name2tracks.count();
+    for (int i = 0; i < ntracks; i++) {
+        MorphAnimationTrack *trackPtr = *m_context->name2tracks.value(i);
+        trackPtr->keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+    }
+    setParentModel(m_context->modelRef);
 }
 
 void MorphSection::createFirstKeyframeUnlessFound()
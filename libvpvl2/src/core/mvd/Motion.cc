@@ -115,6 +115,9 @@ struct Motion::PrivateContext {
           error(kNoError),
           active(true)
     {
+        /* a motion not loaded from data is saved with the given encoding and the default frame rate */
+        info.encoding = encodingRef;
+        info.fps = 30;
         nameListSection = new NameListSection(encodingRef);
     }
     ~PrivateContext() {
@@ -61,14 +61,19 @@ struct NameSectionHeader {
 const int NameListSection::kNotFound = -1;
 
 NameListSection::NameListSection(IEncoding *encoding)
-    : m_encoding(encoding)
+    : m_encoding(encoding),
+      m_nextKey(0)
 {
 }
 
 NameListSection::~NameListSection()
 {
-    setParentModel(0);
+    m_strings.releaseAll();
+    m_key2StringRefs.clear();
+    m_string2Keys.clear();
+    m_transientKeys.clear();
     m_encoding = 0;
+    m_nextKey = 0;
 }
 
 bool NameListSection::preparse(uint8 *&ptr, vsize &rest, Motion::DataInfo & /* info */)
@@ -117,10 +122,11 @@ void NameListSection::read(const uint8 *data, const IString::Codec &codec)
     for (int i = 0; i < nnames; i++) {
         int keyIndex = internal::readUnsignedIndex(ptr, sizeof(i));
         internal::getText(ptr, rest, namePtr, size);
-        m_strings.append(m_encoding->toString(namePtr, codec, size));
+        m_strings.append(m_encoding->toString(namePtr, size, codec));
         const IString *s = m_strings[i];
         m_key2StringRefs.insert(keyIndex, s);
         m_string2Keys.insert(s->toHashString(), keyIndex);
+        btSetMax(m_nextKey, keyIndex + 1);
     }
 }
 
@@ -137,9 +143,11 @@ void NameListSection::write(uint8 *data, const Motion::DataInfo &info) const
     internal::writeBytes(&header, sizeof(header), data);
     const IString::Codec codec = info.codec;
     IEncoding *encodingRef = info.encoding;
-    for (int32 i = 0; i < nnames; i++) {
+    for (int i = 0; i < nnames; i++) {
         const IString *name = m_strings[i];
-        internal::writeBytes(&i, sizeof(i), data);
+        /* keys may be sparse after reading a file or dropping names of the detached model */
+        int32 keyIndex = *m_string2Keys.find(name->toHashString());
+        internal::writeBytes(&keyIndex, sizeof(keyIndex), data);
         internal::writeString(name, encodingRef, codec, data);
     }
 }
@@ -152,9 +160,9 @@ vsize NameListSection::estimateSize(const Motion::DataInfo &info) const
     const int nnames = m_strings.count();
     const IString::Codec codec = info.codec;
     IEncoding *encodingRef = info.encoding;
-    for (int32 i = 0; i < nnames; i++) {
+    for (int i = 0; i < nnames; i++) {
         const IString *name = m_strings[i];
-        size += sizeof(i);
+        size += sizeof(int32);
         size += internal::estimateSize(name, encodingRef, codec);
     }
     return size;
@@ -185,37 +193,57 @@ void NameListSection::getNames(Array<const IString *> &names) const
 
 void NameListSection::addName(const IString *name)
 {
-    if (!m_string2Keys.find(name->toHashString())) {
-        int key = m_strings.count();
-        const IString *value = m_strings.append(name->clone());
-        m_key2StringRefs.insert(key, value);
-        m_string2Keys.insert(value->toHashString(), key);
+    if (const int *key = m_string2Keys.find(name->toHashString())) {
+        /* a keyframe refers to the name so it must be kept after detaching the model */
+        m_transientKeys.remove(*key);
+    }
+    else {
+        addNewName(name);
     }
 }
 
 void NameListSection::setParentModel(const IModel *value)
 {
-    m_strings.releaseAll();
-    m_key2StringRefs.clear();
-    m_string2Keys.clear();
+    /*
+     * only IK bone names of the parent model are needed to write the model section and
+     * others are added by keyframes on demand, so names of the previous model that no
+     * keyframe refers are dropped and keys of existing tracks are kept stable
+     */
+    const int ntransients = m_transientKeys.count();
+    for (int i = 0; i < ntransients; i++) {
+        const int key = m_transientKeys[i];
+        if (const IString *const *valueRef = m_key2StringRefs.find(key)) {
+            const IString *name = *valueRef;
+            m_string2Keys.remove(name->toHashString());
+            m_key2StringRefs.remove(key);
+            m_strings.remove(name);
+            delete name;
+        }
+    }
+    m_transientKeys.clear();
     if (value) {
         Array<IBone *> boneRefs;
         value->getBoneRefs(boneRefs);
         const int nbones = boneRefs.count();
         for (int i = 0; i < nbones; i++) {
             const IBone *bone = boneRefs[i];
-            addName(bone->name(IEncoding::kDefaultLanguage));
-        }
-        Array<IMorph *> morphRefs;
-        value->getMorphRefs(morphRefs);
-        const int nmorphs = morphRefs.count();
-        for (int i = 0; i < nmorphs; i++) {
-            const IMorph *morph = morphRefs[i];
-            addName(morph->name(IEncoding::kDefaultLanguage));
+            const IString *name = bone->name(IEncoding::kDefaultLanguage);
+            if (bone->hasInverseKinematics() && name && !m_string2Keys.find(name->toHashString())) {
+                m_transientKeys.append(addNewName(name));
+            }
         }
     }
 }
 
+int NameListSection::addNewName(const IString *name)
+{
+    int key = m_nextKey++;
+    const IString *value = m_strings.append(name->clone());
+    m_key2StringRefs.insert(key, value);
+    m_string2Keys.insert(value->toHashString(), key);
+    return key;
+}
+
 IEncoding *NameListSection::encodingRef() const
 {
     return m_encoding;
@@ -36,6 +36,7 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/ModelHelper.h"
 
 #include "vpvl2/pmd/Bone.h"
@@ -85,6 +86,8 @@ struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
         const uint8_t *base = reinterpret_cast<const uint8_t *>(&kIdent.texcoord);
         switch (type) {
         case kBoneIndexStride:
+        case kBonePaletteIndexStride:
+            /* each material is one subset referencing its own bones, see DefaultMatrixBuffer */
             return reinterpret_cast<const uint8_t *>(&kIdent.boneIndices) - base;
         case kBoneWeightStride:
             return reinterpret_cast<const uint8_t *>(&kIdent.boneWeights) - base;
@@ -345,13 +348,20 @@ struct DefaultMatrixBuffer : public IModel::MatrixBuffer {
             buffer.delta = vertex->delta();
         }
     }
-    const float *bytes(int materialIndex) const {
+    int countSubsets(int materialIndex) const {
+        return internal::checkBound(materialIndex, 0, materials.count()) ? 1 : 0;
+    }
+    void getSubsetIndexRange(int materialIndex, int subsetIndex, int &offset, int &count) const {
+        offset = 0;
+        count = subsetIndex == 0 && internal::checkBound(materialIndex, 0, materials.count()) ? materials[materialIndex]->indexRange().count : 0;
+    }
+    const float *bytes(int materialIndex, int subsetIndex) const {
         int nmatrices = meshes.matrices.count();
-        return internal::checkBound(materialIndex, 0, nmatrices) ? meshes.matrices[materialIndex] : 0;
+        return subsetIndex == 0 && internal::checkBound(materialIndex, 0, nmatrices) ? meshes.matrices[materialIndex] : 0;
     }
-    size_t size(int materialIndex) const {
+    size_t size(int materialIndex, int subsetIndex) const {
         int nbones = meshes.bones.size();
-        return internal::checkBound(materialIndex, 0, nbones) ? meshes.bones[materialIndex].size() : 0;
+        return subsetIndex == 0 && internal::checkBound(materialIndex, 0, nbones) ? meshes.bones[materialIndex].size() : 0;
     }
 
     void initialize() {
@@ -462,6 +472,7 @@ Model::~Model()
     m_edgeColor.setZero();
     m_edgeWidth = 0;
     m_enableSkinning = false;
+    internal::advanceModelGeneration();
 }
 
 bool Model::load(const uint8_t *data, size_t size)
@@ -809,6 +820,12 @@ void Model::getAabb(Vector3 &min, Vector3 &max) const
     max = m_aabbMax;
 }
 
+bool Model::computeConservativeAabb(Vector3 & /* min */, Vector3 & /* max */, Array<Vector3> * /* materialAabbs */, Array<Scalar> * /* materialEdgeSizes */) const
+{
+    /* not supported */
+    return false;
+}
+
 void Model::setSkinnningEnable(bool value)
 {
     m_enableSkinning = value;
@@ -36,6 +36,9 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/BoneBoundingBox.h"
+#include "vpvl2/internal/BonePalette.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/ModelHelper.h"
 #include "vpvl2/pmd2/Bone.h"
 #include "vpvl2/pmd2/Joint.h"
@@ -182,15 +185,17 @@ struct DefaultIKConstraint : IBone::IKConstraint {
 struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
     struct Unit {
         Unit() {}
-        void update(const IVertex *vertex) {
-            const IBone *bone1 = vertex->boneRef(0), *bone2 = vertex->boneRef(1);
+        void update(const IVertex *vertex, const internal::BonePalette *paletteRef) {
+            const int boneIndex1 = vertex->boneRef(0)->index(), boneIndex2 = vertex->boneRef(1)->index();
             texcoord = vertex->textureCoord();
-            boneIndices.setValue(Scalar(bone1->index()), Scalar(bone2->index()), 0, 0);
+            boneIndices.setValue(Scalar(boneIndex1), Scalar(boneIndex2), 0, 0);
+            bonePaletteIndices.setValue(Scalar(paletteRef->boneSlot(boneIndex1)), Scalar(paletteRef->boneSlot(boneIndex2)), 0, 0);
             boneWeights.setValue(Scalar(vertex->weight(0)), 0, 0, 0);
         }
         Vector3 texcoord;
         Vector4 boneIndices;
         Vector4 boneWeights;
+        Vector4 bonePaletteIndices;
     };
     static const Unit kIdent;
 
@@ -212,6 +217,8 @@ struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
             return reinterpret_cast<const uint8 *>(&kIdent.boneIndices) - base;
         case kBoneWeightStride:
             return reinterpret_cast<const uint8 *>(&kIdent.boneWeights) - base;
+        case kBonePaletteIndexStride:
+            return reinterpret_cast<const uint8 *>(&kIdent.bonePaletteIndices) - base;
         case kTextureCoordStride:
             return reinterpret_cast<const uint8 *>(&kIdent.texcoord) - base;
         case kVertexStride:
@@ -235,9 +242,10 @@ struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
     void update(void *address) const {
         Unit *unitPtr = static_cast<Unit *>(address);
         const PointerArray<Vertex> &vertices = modelRef->vertices();
+        const internal::BonePalette *paletteRef = modelRef->bonePaletteRef();
         const int nvertices = vertices.count();
         for (int i = 0; i < nvertices; i++) {
-            unitPtr[i].update(vertices[i]);
+            unitPtr[i].update(vertices[i], paletteRef);
         }
     }
     const void *ident() const {
@@ -348,7 +356,7 @@ struct DefaultDynamicVertexBuffer : public IModel::DynamicVertexBuffer {
     }
     void computeAabb(const void *address, Array<Vector3> &values) const {
         const Array<Material *> &materials = modelRef->materials();
-        internal::ParallelComputeAabbProcessor<pmd2::Material, Unit> processor(&materials, &values, address);
+        internal::ParallelComputeAabbProcessor<pmd2::Material, Unit> processor(&materials, indexBufferRef, &values, address);
         processor.execute(enableParallelUpdate);
     }
     void setParallelUpdateEnable(bool value) {
@@ -421,50 +429,46 @@ struct DefaultIndexBuffer : public IModel::IndexBuffer {
 const uint16 DefaultIndexBuffer::kIdent;
 
 struct DefaultMatrixBuffer : public IModel::MatrixBuffer {
-    typedef btAlignedObjectArray<int> BoneIndices;
-    typedef btAlignedObjectArray<BoneIndices> MeshBoneIndices;
     typedef btAlignedObjectArray<Transform> MeshLocalTransforms;
-    typedef Array<float32 *> MeshMatrices;
-    struct SkinningMeshes {
-        MeshBoneIndices bones;
-        MeshLocalTransforms transforms;
-        MeshMatrices matrices;
-        BoneIndices bdef2;
-        ~SkinningMeshes() { matrices.releaseArrayAll(); }
-    };
 
-    DefaultMatrixBuffer(const IModel *model, const DefaultIndexBuffer *indexBuffer, DefaultDynamicVertexBuffer *dynamicBuffer)
+    DefaultMatrixBuffer(const Model *model, const DefaultIndexBuffer *indexBuffer, DefaultDynamicVertexBuffer *dynamicBuffer)
         : modelRef(model),
           indexBufferRef(indexBuffer),
-          dynamicBufferRef(dynamicBuffer)
+          dynamicBufferRef(dynamicBuffer),
+          paletteRef(0),
+          paletteGeneration(0)
     {
-        model->getBoneRefs(bones);
-        model->getMaterialRefs(materials);
-        model->getVertexRefs(vertices);
         initialize();
     }
     ~DefaultMatrixBuffer() {
+        matrices.releaseArrayAll();
         modelRef = 0;
         indexBufferRef = 0;
         dynamicBufferRef = 0;
+        paletteRef = 0;
+        paletteGeneration = 0;
     }
 
     void update(void *address) {
+        /* editing the model releases the palette, the subsets are rebuilt here and the matrices must follow them */
+        if (modelRef->bonePaletteRef()->generation() != paletteGeneration) {
+            initialize();
+        }
         const int nbones = bones.count();
-        MeshLocalTransforms &transforms = meshes.transforms;
         for (int i = 0; i < nbones; i++) {
             const IBone *bone = bones[i];
             transforms[i] = bone->localTransform();
         }
-        const int nmaterials = materials.count();
-        for (int i = 0; i < nmaterials; i++) {
-            const BoneIndices &boneIndices = meshes.bones[i];
-            const int nBoneIndices = boneIndices.size();
-            Scalar *matrices = meshes.matrices[i];
+        const Transform &staticBoneLocalTransform = Factory::sharedNullBoneRef()->localTransform();
+        const int nsubsets = btMin(matrices.count(), paletteRef->countAllSubsets());
+        for (int i = 0; i < nsubsets; i++) {
+            const Array<int> &boneIndices = paletteRef->subsetAt(i)->boneIndices;
+            const int nBoneIndices = boneIndices.count();
+            Scalar *matricesPtr = matrices[i];
             for (int j = 0; j < nBoneIndices; j++) {
                 const int boneIndex = boneIndices[j];
-                const Transform &transform = transforms[boneIndex];
-                transform.getOpenGLMatrix(&matrices[j * 16]);
+                const Transform &transform = boneIndex >= 0 ? transforms[boneIndex] : staticBoneLocalTransform;
+                transform.getOpenGLMatrix(&matricesPtr[j * 16]);
             }
         }
         const int nvertices = vertices.count();
@@ -476,63 +480,51 @@ struct DefaultMatrixBuffer : public IModel::MatrixBuffer {
             buffer.position.setW(Scalar(vertex->type()));
         }
     }
-    const float32 *bytes(int materialIndex) const {
-        int nmatrices = meshes.matrices.count();
-        return internal::checkBound(materialIndex, 0, nmatrices) ? meshes.matrices[materialIndex] : 0;
+    int countSubsets(int materialIndex) const {
+        return paletteRef->countSubsets(materialIndex);
     }
-    vsize size(int materialIndex) const {
-        int nbones = meshes.bones.size();
-        return internal::checkBound(materialIndex, 0, nbones) ? meshes.bones[materialIndex].size() : 0;
-    }
-
-    struct Predication {
-        bool operator()(const int left, const int right) const {
-            return left < right;
-        }
-    };
-    void addBoneIndices(const IVertex *vertex, const int offset, BoneIndices &indices) {
-        Predication predication;
-        int size = indices.size();
-        int index = vertex->boneRef(offset)->index();
-        if (size == 0) {
-            indices.push_back(index);
-            size = indices.size();
+    void getSubsetIndexRange(int materialIndex, int subsetIndex, int &offset, int &count) const {
+        if (const internal::BonePalette::Subset *subset = paletteRef->subsetAt(materialIndex, subsetIndex)) {
+            offset = subset->indexOffset;
+            count = subset->indexCount;
         }
-        else if (indices.findBinarySearch(index) == size) {
-            indices.push_back(index);
-            indices.quickSort(predication);
-            size = indices.size();
+        else {
+            offset = count = 0;
         }
     }
+    const float32 *bytes(int materialIndex, int subsetIndex) const {
+        const int index = paletteRef->findSubsetIndex(materialIndex, subsetIndex);
+        return internal::checkBound(index, 0, matrices.count()) ? matrices[index] : 0;
+    }
+    vsize size(int materialIndex, int subsetIndex) const {
+        const internal::BonePalette::Subset *subset = paletteRef->subsetAt(materialIndex, subsetIndex);
+        return subset ? subset->boneIndices.count() : 0;
+    }
+
     void initialize() {
-        const int nmaterials = materials.count();
-        BoneIndices boneIndices;
-        meshes.transforms.resize(bones.count());
-        int offset = 0;
-        for (int i = 0; i < nmaterials; i++) {
-            const IMaterial *material = materials[i];
-            const int nindices = material->indexRange().count;
-            for (int j = 0; j < nindices; j++) {
-                int vertexIndex = indexBufferRef->indexAt(offset + j);
-                meshes.bdef2.push_back(vertexIndex);
-                IVertex *vertex = vertices[i];
-                addBoneIndices(vertex, 0, boneIndices);
-                addBoneIndices(vertex, 1, boneIndices);
-            }
-            meshes.matrices.append(new Scalar[boneIndices.size() * 16]);
-            meshes.bones.push_back(boneIndices);
-            boneIndices.clear();
-            offset += nindices;
+        paletteRef = modelRef->bonePaletteRef();
+        paletteGeneration = paletteRef->generation();
+        modelRef->getBoneRefs(bones);
+        modelRef->getVertexRefs(vertices);
+        matrices.releaseArrayAll();
+        const int nsubsets = paletteRef->countAllSubsets();
+        transforms.resize(bones.count());
+        matrices.reserve(nsubsets);
+        for (int i = 0; i < nsubsets; i++) {
+            const vsize size = btMax(paletteRef->subsetAt(i)->boneIndices.count(), 1) * 16;
+            matrices.append(new Scalar[size]);
         }
     }
 
-    const IModel *modelRef;
+    const Model *modelRef;
     const DefaultIndexBuffer *indexBufferRef;
     DefaultDynamicVertexBuffer *dynamicBufferRef;
+    const internal::BonePalette *paletteRef;
+    uint32 paletteGeneration;
     Array<IBone *> bones;
-    Array<IMaterial *> materials;
     Array<IVertex *> vertices;
-    SkinningMeshes meshes;
+    MeshLocalTransforms transforms;
+    PointerArray<Scalar> matrices;
 };
 
 class BonePredication {
@@ -649,6 +641,8 @@ struct Model::PrivateContext {
         edgeColor.setZero();
         aabbMax.setZero();
         aabbMin.setZero();
+        boundingBox.invalidate();
+        bonePalette.release();
         edgeWidth = 0;
         visible = false;
         physicsEnabled = false;
@@ -890,6 +884,8 @@ struct Model::PrivateContext {
     Color edgeColor;
     Vector3 aabbMax;
     Vector3 aabbMin;
+    internal::BoneBoundingBox boundingBox;
+    internal::BonePalette bonePalette;
     IVertex::EdgeSizePrecision edgeWidth;
     bool hasEnglish;
     bool visible;
@@ -910,6 +906,7 @@ Model::~Model()
 {
     m_context->release();
     internal::deleteObject(m_context);
+    internal::advanceModelGeneration();
 }
 
 bool Model::preparse(const uint8 *data, vsize size, DataInfo &info)
@@ -1072,6 +1069,7 @@ bool Model::load(const uint8 *data, vsize size)
             m_context->dataInfo.error = info.error;
             return false;
         }
+        m_context->boundingBox.build(m_context->bones, m_context->vertices, m_context->indices, m_context->materials, m_context->morphs);
         m_context->reportProgress(VPVL2_CALCULATE_PROGRESS_PERCENTAGE(14));
         m_context->dataInfo = info;
 #undef VPVL2_CALCULATE_PROGRESS_PERCENTAGE
@@ -1665,6 +1663,35 @@ void Model::getAabb(Vector3 &min, Vector3 &max) const
     max = m_context->aabbMax;
 }
 
+const internal::BonePalette *Model::bonePaletteRef() const
+{
+    internal::BonePalette &bonePalette = m_context->bonePalette;
+    if (!bonePalette.isBuilt()) {
+        const PointerArray<Material> &materials = m_context->materials;
+        const int nmaterials = materials.count();
+        Array<int> vertexBones, materialIndexCounts;
+        internal::BonePalette::collectVertexBones(m_context->vertices, vertexBones);
+        materialIndexCounts.reserve(nmaterials);
+        for (int i = 0; i < nmaterials; i++) {
+            materialIndexCounts.append(materials[i]->indexRange().count);
+        }
+        if (!bonePalette.build(vertexBones, m_context->indices, materialIndexCounts)) {
+            VPVL2_LOG(WARNING, "Cannot assign bone palette slots, each material uploads the whole skeleton: name=" << internal::cstr(name(IEncoding::kDefaultLanguage), "(null)"));
+        }
+        VPVL2_VLOG(1, "Built bone palette: materials=" << nmaterials << " subsets=" << bonePalette.countAllSubsets());
+    }
+    return &bonePalette;
+}
+
+bool Model::computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const
+{
+    internal::BoneBoundingBox &boundingBox = m_context->boundingBox;
+    if (!boundingBox.isBuilt()) {
+        boundingBox.build(m_context->bones, m_context->vertices, m_context->indices, m_context->materials, m_context->morphs);
+    }
+    return boundingBox.compute(min, max, materialAabbs, materialEdgeSizes);
+}
+
 void Model::setAabb(const Vector3 &min, const Vector3 &max)
 {
     m_context->aabbMin = min;
@@ -1763,6 +1790,8 @@ IVertex *Model::findVertexRefAt(int value) const
 
 void Model::setIndices(const Array<int> &value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     const int nindices = value.count();
     const int nvertices = m_context->vertices.count();
     m_context->indices.clear();
@@ -1779,6 +1808,8 @@ void Model::setIndices(const Array<int> &value)
 
 void Model::addBone(IBone *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::addObject(this, value, m_context->bones);
     if (value) {
         if (const IString *name = value->name(IEncoding::kJapanese)) {
@@ -1808,11 +1839,14 @@ void Model::addLabel(ILabel *value)
 
 void Model::addMaterial(IMaterial *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::addObject(this, value, m_context->materials);
 }
 
 void Model::addMorph(IMorph *value)
 {
+    m_context->boundingBox.invalidate();
     internal::ModelHelper::addObject(this, value, m_context->morphs);
     if (value) {
         if (const IString *name = value->name(IEncoding::kJapanese)) {
@@ -1831,6 +1865,8 @@ void Model::addRigidBody(IRigidBody *value)
 
 void Model::addVertex(IVertex *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::addObject(this, value, m_context->vertices);
 }
 
@@ -1846,6 +1882,8 @@ void Model::addTexture(const IString *value)
 
 void Model::removeBone(IBone *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::removeObject(this, value, m_context->bones);
     internal::ModelHelper::removeBoneReferenceInBones(value, m_context->bones);
     internal::ModelHelper::removeBoneReferenceInRigidBodies(value, m_context->rigidBodies);
@@ -1867,12 +1905,15 @@ void Model::removeLabel(ILabel *value)
 
 void Model::removeMaterial(IMaterial *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::removeObject(this, value, m_context->materials);
     internal::ModelHelper::removeMaterialReferenceInVertices(value, m_context->vertices);
 }
 
 void Model::removeMorph(IMorph *value)
 {
+    m_context->boundingBox.invalidate();
     internal::ModelHelper::removeObject(this, value, m_context->morphs);
     if (value) {
         removeMorphHash(value);
@@ -1887,6 +1928,8 @@ void Model::removeRigidBody(IRigidBody *value)
 
 void Model::removeVertex(IVertex *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::removeObject(this, value, m_context->vertices);
     const int nmorphs = m_context->morphs.count();
     for (int i = 0; i < nmorphs; i++) {
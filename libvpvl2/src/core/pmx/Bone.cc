@@ -1400,6 +1400,13 @@ void Bone::getJointRefs(Array<IKJoint *> &value) const
     }
 }
 
+IBone::IKJoint *Bone::addIKJoint(IBone *targetBoneRef)
+{
+    DefaultIKJoint *joint = m_context->joints.append(new DefaultIKJoint(this));
+    joint->setTargetBoneRef(targetBoneRef);
+    return joint;
+}
+
 } /* namespace pmx */
 } /* namespace VPVL2_VERSION_NS */
 } /* namespace vpvl2 */
@@ -36,6 +36,9 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/BoneBoundingBox.h"
+#include "vpvl2/internal/BonePalette.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/ModelHelper.h"
 
 #include "vpvl2/pmx/Bone.h"
@@ -110,30 +113,14 @@ struct Flags
 #pragma pack(pop)
 
 struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
-    typedef btAlignedObjectArray<int32> BoneIndices;
-    typedef Array<BoneIndices> MeshBoneIndices;
-    typedef Hash<HashInt, int> BoneIndexHash;
-
     struct Unit {
         Unit() {}
-        static Scalar resolveRelativeBoneIndex(const IVertex *vertexRef, int offset, const BoneIndexHash *boneIndexHashes) {
-            if (const IBone *boneRef = vertexRef->boneRef(offset)) {
-                const int boneIndex = boneRef->index();
-#if 0
-                if (const int *boneIndexPtr = boneIndexHashes->find(boneIndex)) {
-                    const int relativeBoneIndex = *boneIndexPtr;
-                    return Scalar(relativeBoneIndex);
-                }
-#else
-                (void) boneIndexHashes;
-                return Scalar(boneIndex);
-#endif
-            }
-            return -1;
-        }
-        void update(const IVertex *vertexRef, const BoneIndexHash *boneIndexHashes) {
+        void update(const IVertex *vertexRef, const internal::BonePalette *paletteRef) {
             for (int i = 0; i < pmx::Vertex::kMaxBones; i++) {
-                boneIndices[i] = resolveRelativeBoneIndex(vertexRef, i, boneIndexHashes);
+                const IBone *boneRef = vertexRef->boneRef(i);
+                const int boneIndex = boneRef ? boneRef->index() : -1;
+                boneIndices[i] = Scalar(boneIndex);
+                bonePaletteIndices[i] = Scalar(paletteRef->boneSlot(boneIndex));
                 boneWeights[i] = Scalar(vertexRef->weight(i));
             }
             texcoord = vertexRef->textureCoord();
@@ -141,78 +128,15 @@ struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
         Vector3 texcoord;
         Vector4 boneIndices;
         Vector4 boneWeights;
+        Vector4 bonePaletteIndices;
     };
     static const Unit kIdent;
 
-    struct Predication {
-        inline bool operator()(const int left, const int right) const {
-            return left < right;
-        }
-    };
-    static void addBoneIndices(const IVertex *vertexRef, const int nindices, BoneIndices &indices) {
-        VPVL2_DCHECK(indices.size() > 0);
-        Predication predication;
-        int size = indices.size();
-        for (int i = 0; i < nindices; i++) {
-            int index = vertexRef->boneRef(i)->index();
-            if (indices.findBinarySearch(index) == size) {
-                indices.push_back(index);
-                indices.quickSort(predication);
-                size = indices.size();
-            }
-        }
-    }
-    static void addBoneIndices(const IVertex *vertexRef, BoneIndices &boneIndices) {
-        switch (vertexRef->type()) {
-        case IVertex::kBdef1:
-            addBoneIndices(vertexRef, 1, boneIndices);
-            break;
-        case IVertex::kBdef2:
-        case IVertex::kSdef:
-            addBoneIndices(vertexRef, 2, boneIndices);
-            break;
-        case IVertex::kBdef4:
-        case IVertex::kQdef:
-            addBoneIndices(vertexRef, 4, boneIndices);
-            break;
-        case IVertex::kMaxType:
-        default:
-            break;
-        }
-    }
-    static void updateBoneIndexHashes(const pmx::Model *modelRef, PointerArray<BoneIndexHash> &boneIndexHashes) {
-        const Array<pmx::Material *> &materialRefs = modelRef->materials();
-        const Array<pmx::Vertex *> &verticeRefs = modelRef->vertices();
-        const Array<int> &indices = modelRef->indices();
-        BoneIndices boneIndices;
-        boneIndexHashes.releaseAll();
-        const int nmaterials = materialRefs.count();
-        for (int i = 0, offset = 0; i < nmaterials; i++) {
-            const IMaterial *materialRef = materialRefs[i];
-            const int nindices = materialRef->indexRange().count;
-            boneIndices.clear();
-            boneIndices.push_back(-1);
-            for (int j = 0; j < nindices; j++) {
-                const int vertexIndex = indices[offset + j];
-                const IVertex *vertexRef = verticeRefs[vertexIndex];
-                addBoneIndices(vertexRef, boneIndices);
-            }
-            const int numBoneIndices = boneIndices.size();
-            BoneIndexHash *boneIndexHash = boneIndexHashes.append(new BoneIndexHash());
-            for (int j = 0; j < numBoneIndices; j++) {
-                const int boneIndex = boneIndices[j];
-                boneIndexHash->insert(boneIndex, j);
-            }
-            offset += nindices;
-        }
-    }
-
     DefaultStaticVertexBuffer(const pmx::Model *model)
         : modelRef(model)
     {
     }
     ~DefaultStaticVertexBuffer() {
-        boneIndexHashes.releaseAll();
         modelRef = 0;
     }
 
@@ -226,6 +150,8 @@ struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
             return reinterpret_cast<const uint8 *>(&kIdent.boneIndices) - base;
         case kBoneWeightStride:
             return reinterpret_cast<const uint8 *>(&kIdent.boneWeights) - base;
+        case kBonePaletteIndexStride:
+            return reinterpret_cast<const uint8 *>(&kIdent.bonePaletteIndices) - base;
         case kTextureCoordStride:
             return reinterpret_cast<const uint8 *>(&kIdent.texcoord) - base;
         case kVertexStride:
@@ -247,31 +173,19 @@ struct DefaultStaticVertexBuffer : public IModel::StaticVertexBuffer {
         return sizeof(kIdent);
     }
     void update(void *address) const {
-        const Array<pmx::Material *> &materials = modelRef->materials();
-        const Array<int> &indices = modelRef->indices();
         const Array<pmx::Vertex *> &vertices = modelRef->vertices();
-        const int nmaterials = materials.count();
+        const internal::BonePalette *paletteRef = modelRef->bonePaletteRef();
+        const int nvertices = vertices.count();
         Unit *unitPtr = static_cast<Unit *>(address);
-        updateBoneIndexHashes(modelRef, boneIndexHashes);
-        for (int i = 0, offset = 0; i < nmaterials; i++) {
-            const IMaterial *materialRef = materials[i];
-            const BoneIndexHash *boneIndexHashRef = boneIndexHashes[i];
-            const int nindices = materialRef->indexRange().count;
-            for (int j = 0; j < nindices; j++) {
-                const int vertexIndex = indices[offset + j];
-                const IVertex *vertex = vertices[vertexIndex];
-                unitPtr[vertexIndex].update(vertex, boneIndexHashRef);
-            }
-            offset += nindices;
+        for (int i = 0; i < nvertices; i++) {
+            unitPtr[i].update(vertices[i], paletteRef);
         }
-        boneIndexHashes.releaseAll();
     }
     const void *ident() const {
         return &kIdent;
     }
 
     const pmx::Model *modelRef;
-    mutable PointerArray<BoneIndexHash> boneIndexHashes;
 };
 const DefaultStaticVertexBuffer::Unit DefaultStaticVertexBuffer::kIdent = DefaultStaticVertexBuffer::Unit();
 
@@ -382,7 +296,7 @@ struct DefaultDynamicVertexBuffer : public IModel::DynamicVertexBuffer {
     }
     void computeAabb(const void *address, Array<Vector3> &values) const {
         const Array<pmx::Material *> &materials = modelRef->materials();
-        internal::ParallelComputeAabbProcessor<pmx::Material, Unit> processor(&materials, &values, address);
+        internal::ParallelComputeAabbProcessor<pmx::Material, Unit> processor(&materials, indexBufferRef, &values, address);
         processor.execute(enableParallelUpdate);
     }
     void setParallelUpdateEnable(bool value) {
@@ -535,43 +449,42 @@ struct DefaultIndexBuffer : public IModel::IndexBuffer {
 const int DefaultIndexBuffer::kIdent;
 
 struct DefaultMatrixBuffer : public IModel::MatrixBuffer {
-    typedef btAlignedObjectArray<Transform> MeshLocalTransforms;
-    typedef PointerArray<float32> MeshMatrices;
-    struct SkinningMeshes {
-        DefaultStaticVertexBuffer::MeshBoneIndices bones;
-        MeshMatrices matrices;
-        ~SkinningMeshes() { matrices.releaseArrayAll(); }
-    };
-
     DefaultMatrixBuffer(const pmx::Model *model,
                         const DefaultIndexBuffer *indexBuffer,
                         DefaultDynamicVertexBuffer *dynamicBuffer)
         : modelRef(model),
           indexBufferRef(indexBuffer),
-          dynamicBufferRef(dynamicBuffer)
+          dynamicBufferRef(dynamicBuffer),
+          paletteRef(0),
+          paletteGeneration(0)
     {
         initialize();
     }
     ~DefaultMatrixBuffer() {
+        matrices.releaseArrayAll();
         modelRef = 0;
         indexBufferRef = 0;
         dynamicBufferRef = 0;
+        paletteRef = 0;
+        paletteGeneration = 0;
     }
 
     void updateBoneLocalTransforms() {
+        /* editing the model releases the palette, the subsets are rebuilt here and the matrices must follow them */
+        if (modelRef->bonePaletteRef()->generation() != paletteGeneration) {
+            allocateMatrices();
+        }
         const Array<pmx::Bone *> &boneRefs = modelRef->bones();
-        const Array<pmx::Material *> &materialRefs = modelRef->materials();
         const Transform &staticBoneLocalTransform = Factory::sharedNullBoneRef()->localTransform();
-        const int nmaterials = materialRefs.count();
-        for (int i = 0; i < nmaterials; i++) {
-            const DefaultStaticVertexBuffer::BoneIndices &boneIndices = meshes.bones[i];
-            const int numBoneIndices = boneIndices.size();
-            float32 *matrices = meshes.matrices[i];
-            staticBoneLocalTransform.getOpenGLMatrix(matrices);
-            for (int j = 1; j < numBoneIndices; j++) {
+        const int nsubsets = btMin(matrices.count(), paletteRef->countAllSubsets());
+        for (int i = 0; i < nsubsets; i++) {
+            const Array<int> &boneIndices = paletteRef->subsetAt(i)->boneIndices;
+            const int numBoneIndices = boneIndices.count();
+            float32 *matricesPtr = matrices[i];
+            for (int j = 0; j < numBoneIndices; j++) {
                 const int boneIndex = boneIndices[j];
-                const Transform &localBoneTransform = boneRefs[boneIndex]->localTransform();
-                localBoneTransform.getOpenGLMatrix(&matrices[j * 16]);
+                const Transform &localBoneTransform = boneIndex >= 0 ? boneRefs[boneIndex]->localTransform() : staticBoneLocalTransform;
+                localBoneTransform.getOpenGLMatrix(&matricesPtr[j * 16]);
             }
         }
     }
@@ -579,46 +492,49 @@ struct DefaultMatrixBuffer : public IModel::MatrixBuffer {
     void update(void * /* address */) {
         updateBoneLocalTransforms();
     }
-    const float32 *bytes(int materialIndex) const {
-        int nmatrices = meshes.matrices.count();
-        return internal::checkBound(materialIndex, 0, nmatrices) ? meshes.matrices[materialIndex] : 0;
+    int countSubsets(int materialIndex) const {
+        return paletteRef->countSubsets(materialIndex);
+    }
+    void getSubsetIndexRange(int materialIndex, int subsetIndex, int &offset, int &count) const {
+        if (const internal::BonePalette::Subset *subset = paletteRef->subsetAt(materialIndex, subsetIndex)) {
+            offset = subset->indexOffset;
+            count = subset->indexCount;
+        }
+        else {
+            offset = count = 0;
+        }
+    }
+    const float32 *bytes(int materialIndex, int subsetIndex) const {
+        const int index = paletteRef->findSubsetIndex(materialIndex, subsetIndex);
+        return internal::checkBound(index, 0, matrices.count()) ? matrices[index] : 0;
     }
-    vsize size(int materialIndex) const {
-        int nbones = meshes.bones.count();
-        return internal::checkBound(materialIndex, 0, nbones) ? meshes.bones[materialIndex].size() : 0;
+    vsize size(int materialIndex, int subsetIndex) const {
+        const internal::BonePalette::Subset *subset = paletteRef->subsetAt(materialIndex, subsetIndex);
+        return subset ? subset->boneIndices.count() : 0;
     }
 
-    void initialize() {
-        const Array<pmx::Material *> &materialRefs = modelRef->materials();
-        const Array<pmx::Vertex *> &verticeRefs = modelRef->vertices();
-        const Array<int> &indices = modelRef->indices();
-        const int nmaterials = materialRefs.count();
-        DefaultStaticVertexBuffer::BoneIndices boneIndices;
-        meshes.bones.reserve(nmaterials);
-        meshes.matrices.reserve(nmaterials);
-        int offset = 0;
-        for (int i = 0; i < nmaterials; i++) {
-            const IMaterial *materialRef = materialRefs[i];
-            const int nindices = materialRef->indexRange().count;
-            boneIndices.clear();
-            boneIndices.push_back(-1);
-            for (int j = 0; j < nindices; j++) {
-                const int vertexIndex = indices[offset + j];
-                const IVertex *vertexRef = verticeRefs[vertexIndex];
-                DefaultStaticVertexBuffer::addBoneIndices(vertexRef, boneIndices);
-            }
-            const vsize size = boneIndices.size() * 16;
-            meshes.matrices.append(new float32[size]);
-            meshes.bones.append(boneIndices);
-            offset += nindices;
+    void allocateMatrices() {
+        paletteRef = modelRef->bonePaletteRef();
+        paletteGeneration = paletteRef->generation();
+        matrices.releaseArrayAll();
+        const int nsubsets = paletteRef->countAllSubsets();
+        matrices.reserve(nsubsets);
+        for (int i = 0; i < nsubsets; i++) {
+            const vsize size = btMax(paletteRef->subsetAt(i)->boneIndices.count(), 1) * 16;
+            matrices.append(new float32[size]);
         }
+    }
+    void initialize() {
+        allocateMatrices();
         updateBoneLocalTransforms();
     }
 
     const pmx::Model *modelRef;
     const DefaultIndexBuffer *indexBufferRef;
     DefaultDynamicVertexBuffer *dynamicBufferRef;
-    SkinningMeshes meshes;
+    const internal::BonePalette *paletteRef;
+    uint32 paletteGeneration;
+    PointerArray<float32> matrices;
 };
 
 }
@@ -631,6 +547,27 @@ namespace pmx
 {
 
 struct Model::PrivateContext {
+    /* serialized data and indices of a model shared with its instances */
+    struct SharedData {
+        SharedData()
+            : bytes(0),
+              size(0),
+              refCount(1)
+        {
+            internal::zerofill(&info, sizeof(info));
+        }
+        ~SharedData() {
+            internal::deleteObjectArray(bytes);
+            size = 0;
+            refCount = 0;
+        }
+        uint8 *bytes;
+        vsize size;
+        Model::DataInfo info;
+        Array<int> indices;
+        int refCount;
+    };
+
     PrivateContext(IEncoding *encoding, Model *self)
         : encodingRef(encoding),
           selfRef(self),
@@ -638,6 +575,8 @@ struct Model::PrivateContext {
           parentModelRef(0),
           parentBoneRef(0),
           progressReporterRef(0),
+          sharedData(0),
+          indicesRef(&indices),
           namePtr(0),
           englishNamePtr(0),
           commentPtr(0),
@@ -663,6 +602,7 @@ struct Model::PrivateContext {
 
     void release() {
         /* release objects order by reference dependency (no or child dependency first) */
+        releaseSharedData();
         vertices.releaseAll();
         materials.releaseAll();
         textures.releaseAll();
@@ -684,11 +624,83 @@ struct Model::PrivateContext {
         edgeColor.setZero();
         aabbMin.setZero();
         aabbMax.setZero();
+        boundingBox.invalidate();
+        bonePalette.release();
         position.setZero();
         rotation.setValue(0, 0, 0, 1);
         opacity = 1;
         scaleFactor = 1;
     }
+    SharedData *acquireSharedData() {
+        if (!sharedData) {
+            /* serialize once to parse objects of each instance without preparse and vertices */
+            SharedData *data = new SharedData();
+            data->size = selfRef->estimateSize();
+            data->bytes = new uint8[data->size];
+            selfRef->save(data->bytes, data->size);
+            data->info.encoding = encodingRef;
+            if (!selfRef->preparse(data->bytes, data->size, data->info)) {
+                internal::deleteObject(data);
+                return 0;
+            }
+            data->indices.copy(*indicesRef);
+            indices.clear();
+            indicesRef = &data->indices;
+            sharedData = data;
+        }
+        return sharedData;
+    }
+    void releaseSharedData() {
+        if (sharedData && --sharedData->refCount == 0) {
+            internal::deleteObject(sharedData);
+        }
+        sharedData = 0;
+        indices.clear();
+        indicesRef = &indices;
+    }
+    bool loadInstance(SharedData *data, const Array<Vertex *> &sourceVertices) {
+        const Model::DataInfo &info = data->info;
+        release();
+        sharedData = data;
+        sharedData->refCount++;
+        indicesRef = &data->indices;
+        parseNamesAndComments(info);
+        if (sourceVertices.count() == int(info.verticesCount)) {
+            shareVertices(sourceVertices);
+        }
+        else {
+            parseVertices(info);
+        }
+        parseTextures(info);
+        parseMaterials(info);
+        parseBones(info);
+        parseMorphs(info);
+        parseLabels(info);
+        parseRigidBodies(info);
+        parseJoints(info);
+        parseSoftBodies(info);
+        if (!loadObjects()) {
+            dataInfo.error = info.error;
+            return false;
+        }
+        selfRef->performUpdate();
+        dataInfo = info;
+        return true;
+    }
+    bool loadObjects() {
+        if (!Bone::loadBones(bones)
+                || !Material::loadMaterials(materials, textures, indicesRef->count())
+                || !Vertex::loadVertices(vertices, bones)
+                || !Morph::loadMorphs(morphs, bones, materials, rigidBodies, vertices)
+                || !Label::loadLabels(labels, bones, morphs)
+                || !RigidBody::loadRigidBodies(rigidBodies, bones)
+                || !Joint::loadJoints(joints, rigidBodies)
+                || !SoftBody::loadSoftBodies(softBodies)) {
+            return false;
+        }
+        Bone::sortBones(bones, bonesBeforePhysics, bonesAfterPhysics);
+        return true;
+    }
     void parseNamesAndComments(const Model::DataInfo &info) {
         IEncoding *encoding = info.encoding;
         codec = info.codec;
@@ -707,6 +719,13 @@ struct Model::PrivateContext {
             ptr += size;
         }
     }
+    void shareVertices(const Array<Vertex *> &sourceVertices) {
+        const int nvertices = sourceVertices.count();
+        for (int i = 0; i < nvertices; i++) {
+            Vertex *vertex = vertices.append(new Vertex(selfRef));
+            vertex->shareAttributes(sourceVertices[i]);
+        }
+    }
     void parseIndices(const Model::DataInfo &info) {
         const int nindices = int(info.indicesCount), nvertices = int(info.verticesCount);
         uint8 *ptr = info.indicesPtr;
@@ -736,6 +755,7 @@ struct Model::PrivateContext {
         }
     }
     void parseMaterials(const Model::DataInfo &info) {
+        const Array<int> &indices = *indicesRef;
         const int nmaterials = int(info.materialsCount), nindices = indices.count();
         int offset = 0;
         uint8 *ptr = info.materialsPtr;
@@ -858,8 +878,10 @@ struct Model::PrivateContext {
     IModel *parentModelRef;
     IBone *parentBoneRef;
     IProgressReporter *progressReporterRef;
+    SharedData *sharedData;
     PointerArray<Vertex> vertices;
     Array<int> indices;
+    const Array<int> *indicesRef;
     PointerArray<IString> textures;
     Hash<HashString, IString *> name2textureRefs;
     PointerArray<Material> materials;
@@ -881,6 +903,8 @@ struct Model::PrivateContext {
     Vector3 edgeColor;
     Vector3 aabbMax;
     Vector3 aabbMin;
+    internal::BoneBoundingBox boundingBox;
+    internal::BonePalette bonePalette;
     Vector3 position;
     Quaternion rotation;
     Scalar opacity;
@@ -900,6 +924,7 @@ Model::~Model()
 {
     m_context->release();
     internal::deleteObject(m_context);
+    internal::advanceModelGeneration();
 }
 
 bool Model::load(const uint8 *data, vsize size)
@@ -932,19 +957,12 @@ bool Model::load(const uint8 *data, vsize size)
         m_context->reportProgress(VPVL2_CALCULATE_PROGRESS_PERCENTAGE(11));
         m_context->parseSoftBodies(info);
         m_context->reportProgress(VPVL2_CALCULATE_PROGRESS_PERCENTAGE(12));
-        if (!Bone::loadBones(m_context->bones)
-                || !Material::loadMaterials(m_context->materials, m_context->textures, m_context->indices.count())
-                || !Vertex::loadVertices(m_context->vertices, m_context->bones)
-                || !Morph::loadMorphs(m_context->morphs, m_context->bones, m_context->materials, m_context->rigidBodies, m_context->vertices)
-                || !Label::loadLabels(m_context->labels, m_context->bones, m_context->morphs)
-                || !RigidBody::loadRigidBodies(m_context->rigidBodies, m_context->bones)
-                || !Joint::loadJoints(m_context->joints, m_context->rigidBodies)
-                || !SoftBody::loadSoftBodies(m_context->softBodies)) {
+        if (!m_context->loadObjects()) {
             m_context->dataInfo.error = info.error;
             return false;
         }
+        m_context->boundingBox.build(m_context->bones, m_context->vertices, *m_context->indicesRef, m_context->materials, m_context->morphs);
         m_context->reportProgress(VPVL2_CALCULATE_PROGRESS_PERCENTAGE(13));
-        Bone::sortBones(m_context->bones, m_context->bonesBeforePhysics, m_context->bonesAfterPhysics);
         m_context->reportProgress(VPVL2_CALCULATE_PROGRESS_PERCENTAGE(14));
         performUpdate();
         m_context->reportProgress(VPVL2_CALCULATE_PROGRESS_PERCENTAGE(15));
@@ -958,6 +976,26 @@ bool Model::load(const uint8 *data, vsize size)
     return false;
 }
 
+Model *Model::createInstance()
+{
+    PrivateContext::SharedData *data = m_context->acquireSharedData();
+    if (!data) {
+        VPVL2_LOG(WARNING, "Cannot create an instance of the model: error=" << m_context->dataInfo.error);
+        return 0;
+    }
+    Model *instance = new Model(m_context->encodingRef);
+    instance->setProgressReporterRef(m_context->progressReporterRef);
+    if (!instance->m_context->loadInstance(data, m_context->vertices)) {
+        internal::deleteObject(instance);
+    }
+    return instance;
+}
+
+const void *Model::sharedDataRef() const
+{
+    return m_context->sharedData;
+}
+
 void Model::save(uint8 *data, vsize &written) const
 {
     Header header;
@@ -982,10 +1020,10 @@ void Model::save(uint8 *data, vsize &written) const
     internal::writeString(m_context->commentPtr, encodingRef, codec, data);
     internal::writeString(m_context->englishCommentPtr, encodingRef, codec, data);
     Vertex::writeVertices(m_context->vertices, info, data);
-    const int nindices = m_context->indices.count();
+    const int nindices = m_context->indicesRef->count();
     internal::writeBytes(&nindices, sizeof(nindices), data);
     for (int i = 0; i < nindices; i++) {
-        const int index = m_context->indices[i];
+        const int index = (*m_context->indicesRef)[i];
         internal::writeSignedIndex(index, flags.vertexIndexSize, data);
     }
     const int ntextures = m_context->textures.count();
@@ -1019,7 +1057,7 @@ vsize Model::estimateSize() const
     size += internal::estimateSize(m_context->commentPtr, encodingRef, codec);
     size += internal::estimateSize(m_context->englishCommentPtr, encodingRef, codec);
     size += Vertex::estimateTotalSize(m_context->vertices, info);
-    const int nindices = m_context->indices.count();
+    const int nindices = m_context->indicesRef->count();
     size += sizeof(nindices);
     size += info.vertexIndexSize * nindices;
     const int ntextures = m_context->textures.count();
@@ -1169,7 +1207,7 @@ int Model::count(ObjectType value) const
         return nIK;
     }
     case kIndex: {
-        return m_context->indices.count();
+        return m_context->indicesRef->count();
     }
     case kJoint: {
         return m_context->joints.count();
@@ -1238,7 +1276,7 @@ void Model::getVertexRefs(Array<IVertex *> &value) const
 
 void Model::getIndices(Array<int> &value) const
 {
-    value.copy(m_context->indices);
+    value.copy(*m_context->indicesRef);
 }
 
 void Model::getIKConstraintRefs(Array<IBone::IKConstraint *> &value) const
@@ -1460,7 +1498,7 @@ const Array<Vertex *> &Model::vertices() const
 
 const Array<int> &Model::indices() const
 {
-    return m_context->indices;
+    return *m_context->indicesRef;
 }
 
 const Hash<HashString, IString *> &Model::textures() const
@@ -1668,7 +1706,7 @@ void Model::updateLocalTransform(Array<Bone *> &bones)
 void Model::getIndexBuffer(IndexBuffer *&indexBuffer) const
 {
     internal::deleteObject(indexBuffer);
-    indexBuffer = new DefaultIndexBuffer(m_context->indices, m_context->vertices.count());
+    indexBuffer = new DefaultIndexBuffer(*m_context->indicesRef, m_context->vertices.count());
 }
 
 void Model::getStaticVertexBuffer(StaticVertexBuffer *&staticBuffer) const
@@ -1717,6 +1755,35 @@ void Model::getAabb(Vector3 &min, Vector3 &max) const
     max = m_context->aabbMax;
 }
 
+const internal::BonePalette *Model::bonePaletteRef() const
+{
+    internal::BonePalette &bonePalette = m_context->bonePalette;
+    if (!bonePalette.isBuilt()) {
+        const Array<Material *> &materials = m_context->materials;
+        const int nmaterials = materials.count();
+        Array<int> vertexBones, materialIndexCounts;
+        internal::BonePalette::collectVertexBones(m_context->vertices, vertexBones);
+        materialIndexCounts.reserve(nmaterials);
+        for (int i = 0; i < nmaterials; i++) {
+            materialIndexCounts.append(materials[i]->indexRange().count);
+        }
+        if (!bonePalette.build(vertexBones, *m_context->indicesRef, materialIndexCounts)) {
+            VPVL2_LOG(WARNING, "Cannot assign bone palette slots, each material uploads the whole skeleton: name=" << internal::cstr(name(IEncoding::kDefaultLanguage), "(null)"));
+        }
+        VPVL2_VLOG(1, "Built bone palette: materials=" << nmaterials << " subsets=" << bonePalette.countAllSubsets());
+    }
+    return &bonePalette;
+}
+
+bool Model::computeConservativeAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes) const
+{
+    internal::BoneBoundingBox &boundingBox = m_context->boundingBox;
+    if (!boundingBox.isBuilt()) {
+        boundingBox.build(m_context->bones, m_context->vertices, *m_context->indicesRef, m_context->materials, m_context->morphs);
+    }
+    return boundingBox.compute(min, max, materialAabbs, materialEdgeSizes);
+}
+
 float32 Model::version() const
 {
     return m_context->dataInfo.version;
@@ -1833,6 +1900,8 @@ IVertex *Model::findVertexRefAt(int value) const
 
 void Model::setIndices(const Array<int> &value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     const int nindices = value.count();
     const int nvertices = m_context->vertices.count();
     m_context->indices.clear();
@@ -1845,10 +1914,13 @@ void Model::setIndices(const Array<int> &value)
             m_context->indices.append(0);
         }
     }
+    m_context->indicesRef = &m_context->indices;
 }
 
 void Model::addBone(IBone *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::addObject(this, value, m_context->bones);
     if (value) {
         if (const IString *name = value->name(IEncoding::kJapanese)) {
@@ -1873,11 +1945,14 @@ void Model::addLabel(ILabel *value)
 
 void Model::addMaterial(IMaterial *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::addObject(this, value, m_context->materials);
 }
 
 void Model::addMorph(IMorph *value)
 {
+    m_context->boundingBox.invalidate();
     internal::ModelHelper::addObject(this, value, m_context->morphs);
     if (value) {
         if (const IString *name = value->name(IEncoding::kJapanese)) {
@@ -1901,11 +1976,15 @@ void Model::addSoftBody(ISoftBody *value)
 
 void Model::addVertex(IVertex *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::addObject(this, value, m_context->vertices);
 }
 
 void Model::removeBone(IBone *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::removeObject(this, value, m_context->bones);
     internal::ModelHelper::removeBoneReferenceInBones(value, m_context->bones);
     internal::ModelHelper::removeBoneReferenceInRigidBodies(value, m_context->rigidBodies);
@@ -1941,6 +2020,8 @@ void Model::removeLabel(ILabel *value)
 
 void Model::removeMaterial(IMaterial *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::removeObject(this, value, m_context->materials);
     internal::ModelHelper::removeMaterialReferenceInVertices(value, m_context->vertices);
     const int nmorphs = m_context->morphs.count();
@@ -1964,6 +2045,7 @@ void Model::removeMaterial(IMaterial *value)
 
 void Model::removeMorph(IMorph *value)
 {
+    m_context->boundingBox.invalidate();
     internal::ModelHelper::removeObject(this, value, m_context->morphs);
     if (value) {
         removeMorphHash(value);
@@ -2027,6 +2109,8 @@ void Model::removeSoftBody(ISoftBody *value)
 
 void Model::removeVertex(IVertex *value)
 {
+    m_context->boundingBox.invalidate();
+    m_context->bonePalette.release();
     internal::ModelHelper::removeObject(this, value, m_context->vertices);
     const int nmorphs = m_context->morphs.count();
     for (int i = 0; i < nmorphs; i++) {
@@ -89,69 +89,128 @@ const int Vertex::kMaxBones = 4;
 const int Vertex::kMaxMorphs = 5;
 
 struct Vertex::PrivateContext {
+    /* immutable attributes read from the model data, shared between instances of the same model */
+    struct Attributes {
+        Attributes()
+            : origin(kZeroV3),
+              normal(kZeroV3),
+              texcoord(kZeroV3),
+              c(kZeroV3),
+              r0(kZeroV3),
+              r1(kZeroV3),
+              type(kBdef1),
+              edgeSize(0),
+              refCount(1)
+        {
+            for (int i = 0; i < kMaxBones; i++) {
+                weight[i] = 0;
+                boneIndices[i] = -1;
+            }
+            for (int i = 0; i < kMaxMorphs; i++) {
+                originUVs[i].setZero();
+            }
+        }
+        Attributes(const Attributes &value)
+            : origin(value.origin),
+              normal(value.normal),
+              texcoord(value.texcoord),
+              c(value.c),
+              r0(value.r0),
+              r1(value.r1),
+              type(value.type),
+              edgeSize(value.edgeSize),
+              refCount(1)
+        {
+            for (int i = 0; i < kMaxBones; i++) {
+                weight[i] = value.weight[i];
+                boneIndices[i] = value.boneIndices[i];
+            }
+            for (int i = 0; i < kMaxMorphs; i++) {
+                originUVs[i] = value.originUVs[i];
+            }
+        }
+        ~Attributes() {
+            origin.setZero();
+            normal.setZero();
+            texcoord.setZero();
+            c.setZero();
+            r0.setZero();
+            r1.setZero();
+            type = kBdef1;
+            edgeSize = 0;
+            refCount = 0;
+        }
+        Vector4 originUVs[kMaxMorphs];
+        Vector3 origin;
+        Vector3 normal;
+        Vector3 texcoord;
+        Vector3 c;
+        Vector3 r0;
+        Vector3 r1;
+        IVertex::Type type;
+        IVertex::EdgeSizePrecision edgeSize;
+        IVertex::WeightPrecision weight[kMaxBones];
+        int boneIndices[kMaxBones];
+        int refCount;
+    };
+
     PrivateContext(IModel *modelRef)
         : modelRef(modelRef),
           materialRef(Factory::sharedNullMaterialRef()),
-          origin(kZeroV3),
+          attributes(new Attributes()),
           morphDelta(kZeroV3),
-          normal(kZeroV3),
-          texcoord(kZeroV3),
-          c(kZeroV3),
-          r0(kZeroV3),
-          r1(kZeroV3),
-          type(kBdef1),
-          edgeSize(0),
           index(-1)
     {
         for (int i = 0; i < kMaxBones; i++) {
             boneRefs[i] = Factory::sharedNullBoneRef();
-            weight[i] = 0;
-            boneIndices[i] = -1;
         }
         for (int i = 0; i < kMaxMorphs; i++) {
-            originUVs[i].setZero();
             morphUVs[i].setZero();
         }
     }
     ~PrivateContext() {
+        releaseAttributes();
         modelRef = 0;
         materialRef = 0;
-        origin.setZero();
         morphDelta.setZero();
-        normal.setZero();
-        texcoord.setZero();
-        c.setZero();
-        r0.setZero();
-        r1.setZero();
-        type = kBdef1;
-        edgeSize = 0;
         index = -1;
         for (int i = 0; i < kMaxBones; i++) {
             boneRefs[i] = 0;
-            weight[i] = 0;
-            boneIndices[i] = -1;
         }
         for (int i = 0; i < kMaxMorphs; i++) {
-            originUVs[i].setZero();
             morphUVs[i].setZero();
         }
     }
+
+    void shareAttributes(Attributes *value) {
+        if (value != attributes) {
+            releaseAttributes();
+            attributes = value;
+            attributes->refCount++;
+        }
+    }
+    Attributes *detachAttributes() {
+        /* copy on write to keep the other instances untouched */
+        if (attributes->refCount > 1) {
+            Attributes *value = new Attributes(*attributes);
+            releaseAttributes();
+            attributes = value;
+        }
+        return attributes;
+    }
+    void releaseAttributes() {
+        if (attributes && --attributes->refCount == 0) {
+            delete attributes;
+        }
+        attributes = 0;
+    }
+
     IModel *modelRef;
     IBone *boneRefs[kMaxBones];
     IMaterial *materialRef;
-    Vector4 originUVs[kMaxMorphs];
+    Attributes *attributes;
     Vector4 morphUVs[kMaxMorphs];
-    Vector3 origin;
     Vector3 morphDelta;
-    Vector3 normal;
-    Vector3 texcoord;
-    Vector3 c;
-    Vector3 r0;
-    Vector3 r1;
-    IVertex::Type type;
-    IVertex::EdgeSizePrecision edgeSize;
-    IVertex::WeightPrecision weight[kMaxBones];
-    int boneIndices[kMaxBones];
     int index;
 };
 
@@ -229,9 +288,9 @@ bool Vertex::loadVertices(const Array<Vertex *> &vertices, const Array<Bone *> &
     for (int i = 0; i < nvertices; i++) {
         Vertex *vertex = vertices[i];
         vertex->setIndex(i);
-        switch (vertex->m_context->type) {
+        switch (vertex->m_context->attributes->type) {
         case kBdef1: {
-            int boneIndex = vertex->m_context->boneIndices[0];
+            int boneIndex = vertex->m_context->attributes->boneIndices[0];
             if (boneIndex >= 0) {
                 if (boneIndex >= nbones) {
                     VPVL2_LOG(WARNING, "Invalid PMX bone (Bdef1) specified: index=" << i << " bone=" << boneIndex);
@@ -250,7 +309,7 @@ bool Vertex::loadVertices(const Array<Vertex *> &vertices, const Array<Bone *> &
         case kSdef:
         {
             for (int j = 0; j < 2; j++) {
-                int boneIndex = vertex->m_context->boneIndices[j];
+                int boneIndex = vertex->m_context->attributes->boneIndices[j];
                 if (boneIndex >= 0) {
                     if (boneIndex >= nbones) {
                         VPVL2_LOG(WARNING, "Invalid PMX bone (Bdef2|Sdef) specified: index=" << i << " offset=" << j << " bone=" << boneIndex);
@@ -270,7 +329,7 @@ bool Vertex::loadVertices(const Array<Vertex *> &vertices, const Array<Bone *> &
         case kQdef:
         {
             for (int j = 0; j < 4; j++) {
-                int boneIndex = vertex->m_context->boneIndices[j];
+                int boneIndex = vertex->m_context->attributes->boneIndices[j];
                 if (boneIndex >= 0) {
                     if (boneIndex >= nbones) {
                         VPVL2_LOG(WARNING, "Invalid PMX bone (Bdef4|Qdef) specified: index=" << i << " offset=" << j << " bone=" << boneIndex);
@@ -318,73 +377,74 @@ vsize Vertex::estimateTotalSize(const Array<Vertex *> &vertices, const Model::Da
 void Vertex::read(const uint8 *data, const Model::DataInfo &info, vsize &size)
 {
     uint8 *ptr = const_cast<uint8 *>(data), *start = ptr;
+    m_context->detachAttributes();
     VertexUnit vertex;
     internal::getData(ptr, vertex);
-    internal::setPosition(vertex.position, m_context->origin);
-    VPVL2_VLOG(3, "PMXVertex: position=" << m_context->origin.x() << "," << m_context->origin.y() << "," << m_context->origin.z());
-    internal::setPosition(vertex.normal, m_context->normal);
-    VPVL2_VLOG(3, "PMXVertex: normal=" << m_context->normal.x() << "," << m_context->normal.y() << "," << m_context->normal.z());
+    internal::setPosition(vertex.position, m_context->attributes->origin);
+    VPVL2_VLOG(3, "PMXVertex: position=" << m_context->attributes->origin.x() << "," << m_context->attributes->origin.y() << "," << m_context->attributes->origin.z());
+    internal::setPosition(vertex.normal, m_context->attributes->normal);
+    VPVL2_VLOG(3, "PMXVertex: normal=" << m_context->attributes->normal.x() << "," << m_context->attributes->normal.y() << "," << m_context->attributes->normal.z());
     float32 u = vertex.texcoord[0], v = vertex.texcoord[1];
-    m_context->texcoord.setValue(u, v, 0);
-    VPVL2_VLOG(3, "PMXVertex: texcoord=" << m_context->texcoord.x() << "," << m_context->texcoord.y() << "," << m_context->texcoord.z());
+    m_context->attributes->texcoord.setValue(u, v, 0);
+    VPVL2_VLOG(3, "PMXVertex: texcoord=" << m_context->attributes->texcoord.x() << "," << m_context->attributes->texcoord.y() << "," << m_context->attributes->texcoord.z());
     ptr += sizeof(vertex);
     int additionalUVSize = int(info.additionalUVSize);
     AdditinalUVUnit uv;
-    m_context->originUVs[0].setValue(u, v, 0, 0);
+    m_context->attributes->originUVs[0].setValue(u, v, 0, 0);
     for (int i = 0; i < additionalUVSize; i++) {
         internal::getData(ptr, uv);
-        Vector4 &v = m_context->originUVs[i + 1];
+        Vector4 &v = m_context->attributes->originUVs[i + 1];
         v.setValue(uv.value[0], uv.value[1], uv.value[2], uv.value[3]);
         VPVL2_VLOG(3, "PMXVertex: uv(" << i << ")=" << v.x() << "," << v.y() << "," << v.z() << "," << v.w());
         ptr += sizeof(uv);
     }
-    m_context->type = static_cast<Type>(*reinterpret_cast<uint8 *>(ptr));
+    m_context->attributes->type = static_cast<Type>(*reinterpret_cast<uint8 *>(ptr));
     ptr += sizeof(uint8);
-    switch (m_context->type) {
+    switch (m_context->attributes->type) {
     case kBdef1: {
-        m_context->boneIndices[0] = internal::readSignedIndex(ptr, info.boneIndexSize);
-        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->type << " bone=" << m_context->boneIndices[0]);
+        m_context->attributes->boneIndices[0] = internal::readSignedIndex(ptr, info.boneIndexSize);
+        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->attributes->type << " bone=" << m_context->attributes->boneIndices[0]);
         break;
     }
     case kBdef2: {
         for (int i = 0; i < 2; i++) {
-            m_context->boneIndices[i] = internal::readSignedIndex(ptr, info.boneIndexSize);
+            m_context->attributes->boneIndices[i] = internal::readSignedIndex(ptr, info.boneIndexSize);
         }
         Bdef2Unit unit;
         internal::getData(ptr, unit);
-        m_context->weight[0] = btClamped(unit.weight, 0.0f, 1.0f);
-        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->type << " bone=" << m_context->boneIndices[0] << "," << m_context->boneIndices[1] << " weight=" << m_context->weight[0]);
+        m_context->attributes->weight[0] = btClamped(unit.weight, 0.0f, 1.0f);
+        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->attributes->type << " bone=" << m_context->attributes->boneIndices[0] << "," << m_context->attributes->boneIndices[1] << " weight=" << m_context->attributes->weight[0]);
         ptr += sizeof(unit);
         break;
     }
     case kBdef4:
     case kQdef: {
         for (int i = 0; i < 4; i++) {
-            m_context->boneIndices[i] = internal::readSignedIndex(ptr, info.boneIndexSize);
+            m_context->attributes->boneIndices[i] = internal::readSignedIndex(ptr, info.boneIndexSize);
         }
         Bdef4Unit unit;
         internal::getData(ptr, unit);
         for (int i = 0; i < 4; i++) {
-            m_context->weight[i] = btClamped(unit.weight[i], 0.0f, 1.0f);
+            m_context->attributes->weight[i] = btClamped(unit.weight[i], 0.0f, 1.0f);
         }
-        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->type << " bone=" << m_context->boneIndices[0] << "," << m_context->boneIndices[1] << "," << m_context->boneIndices[2] << "," << m_context->boneIndices[3] << " weight=" << m_context->weight[0] << "," << m_context->weight[1] << "," << m_context->weight[2] << "," << m_context->weight[3]);
+        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->attributes->type << " bone=" << m_context->attributes->boneIndices[0] << "," << m_context->attributes->boneIndices[1] << "," << m_context->attributes->boneIndices[2] << "," << m_context->attributes->boneIndices[3] << " weight=" << m_context->attributes->weight[0] << "," << m_context->attributes->weight[1] << "," << m_context->attributes->weight[2] << "," << m_context->attributes->weight[3]);
         ptr += sizeof(unit);
         break;
     }
     case kSdef: {
         for (int i = 0; i < 2; i++) {
-            m_context->boneIndices[i] = internal::readSignedIndex(ptr, info.boneIndexSize);
+            m_context->attributes->boneIndices[i] = internal::readSignedIndex(ptr, info.boneIndexSize);
         }
         SdefUnit unit;
         internal::getData(ptr, unit);
-        m_context->c.setValue(unit.c[0], unit.c[1], unit.c[2]);
-        m_context->r0.setValue(unit.r0[0], unit.r0[1], unit.r0[2]);
-        m_context->r1.setValue(unit.r1[0], unit.r1[1], unit.r1[2]);
-        m_context->weight[0] = btClamped(unit.weight, 0.0f, 1.0f);
-        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->type << " bone=" << m_context->boneIndices[0] << "," << m_context->boneIndices[1] << " weight=" << m_context->weight[0]);
-        VPVL2_VLOG(3, "PMXVertex: C=" << m_context->c.x() << "," << m_context->c.y() << "," << m_context->c.z());
-        VPVL2_VLOG(3, "PMXVertex: R0=" << m_context->r0.x() << "," << m_context->r0.y() << "," << m_context->r0.z());
-        VPVL2_VLOG(3, "PMXVertex: R1=" << m_context->r1.x() << "," << m_context->r1.y() << "," << m_context->r1.z());
+        m_context->attributes->c.setValue(unit.c[0], unit.c[1], unit.c[2]);
+        m_context->attributes->r0.setValue(unit.r0[0], unit.r0[1], unit.r0[2]);
+        m_context->attributes->r1.setValue(unit.r1[0], unit.r1[1], unit.r1[2]);
+        m_context->attributes->weight[0] = btClamped(unit.weight, 0.0f, 1.0f);
+        VPVL2_VLOG(3, "PMXVertex: type=" << m_context->attributes->type << " bone=" << m_context->attributes->boneIndices[0] << "," << m_context->attributes->boneIndices[1] << " weight=" << m_context->attributes->weight[0]);
+        VPVL2_VLOG(3, "PMXVertex: C=" << m_context->attributes->c.x() << "," << m_context->attributes->c.y() << "," << m_context->attributes->c.z());
+        VPVL2_VLOG(3, "PMXVertex: R0=" << m_context->attributes->r0.x() << "," << m_context->attributes->r0.y() << "," << m_context->attributes->r0.z());
+        VPVL2_VLOG(3, "PMXVertex: R1=" << m_context->attributes->r1.x() << "," << m_context->attributes->r1.y() << "," << m_context->attributes->r1.z());
         ptr += sizeof(unit);
         break;
     }
@@ -394,40 +454,45 @@ void Vertex::read(const uint8 *data, const Model::DataInfo &info, vsize &size)
     float32 edgeSize;
     internal::getData(ptr, edgeSize);
     ptr += sizeof(edgeSize);
-    m_context->edgeSize = edgeSize;
+    m_context->attributes->edgeSize = edgeSize;
     size = ptr - start;
 }
 
+void Vertex::shareAttributes(const Vertex *source)
+{
+    m_context->shareAttributes(source->m_context->attributes);
+}
+
 void Vertex::write(uint8 *&data, const Model::DataInfo &info) const
 {
     VertexUnit vu;
-    internal::getPosition(m_context->origin, vu.position);
-    internal::getPosition(m_context->normal, vu.normal);
-    vu.texcoord[0] = m_context->texcoord.x();
-    vu.texcoord[1] = m_context->texcoord.y();
+    internal::getPosition(m_context->attributes->origin, vu.position);
+    internal::getPosition(m_context->attributes->normal, vu.normal);
+    vu.texcoord[0] = m_context->attributes->texcoord.x();
+    vu.texcoord[1] = m_context->attributes->texcoord.y();
     internal::writeBytes(&vu, sizeof(vu), data);
     int additionalUVSize = int(info.additionalUVSize);
     AdditinalUVUnit avu;
     for (int i = 0; i < additionalUVSize; i++) {
-        const Vector4 &uv = m_context->originUVs[i + 1];
+        const Vector4 &uv = m_context->attributes->originUVs[i + 1];
         avu.value[0] = uv.x();
         avu.value[1] = uv.y();
         avu.value[2] = uv.z();
         avu.value[3] = uv.w();
         internal::writeBytes(&avu, sizeof(avu), data);
     }
-    internal::writeBytes(&m_context->type, sizeof(uint8), data);
+    internal::writeBytes(&m_context->attributes->type, sizeof(uint8), data);
     int boneIndexSize = int(info.boneIndexSize);
-    switch (m_context->type) {
+    switch (m_context->attributes->type) {
     case kBdef1: {
-        internal::writeSignedIndex(m_context->boneIndices[0], boneIndexSize, data);
+        internal::writeSignedIndex(m_context->attributes->boneIndices[0], boneIndexSize, data);
         break;
     }
     case kBdef2: {
         for (int i = 0; i < 2; i++) {
-            internal::writeSignedIndex(m_context->boneIndices[i], boneIndexSize, data);
+            internal::writeSignedIndex(m_context->attributes->boneIndices[i], boneIndexSize, data);
         }
-        float32 weight = float32(m_context->weight[0]);
+        float32 weight = float32(m_context->attributes->weight[0]);
         internal::writeBytes(&weight, sizeof(weight), data);
         break;
     }
@@ -435,36 +500,36 @@ void Vertex::write(uint8 *&data, const Model::DataInfo &info) const
     case kQdef:
     {
         for (int i = 0; i < 4; i++) {
-            internal::writeSignedIndex(m_context->boneIndices[i], boneIndexSize, data);
+            internal::writeSignedIndex(m_context->attributes->boneIndices[i], boneIndexSize, data);
         }
         for (int i = 0; i < 4; i++) {
-            float32 weight = float32(m_context->weight[i]);
+            float32 weight = float32(m_context->attributes->weight[i]);
             internal::writeBytes(&weight, sizeof(weight), data);
         }
         break;
     }
     case kSdef: {
         for (int i = 0; i < 2; i++) {
-            internal::writeSignedIndex(m_context->boneIndices[i], boneIndexSize, data);
+            internal::writeSignedIndex(m_context->attributes->boneIndices[i], boneIndexSize, data);
         }
         SdefUnit unit;
-        unit.c[0] = m_context->c.x();
-        unit.c[1] = m_context->c.y();
-        unit.c[2] = m_context->c.z();
-        unit.r0[0] = m_context->r0.x();
-        unit.r0[1] = m_context->r0.y();
-        unit.r0[2] = m_context->r0.z();
-        unit.r1[0] = m_context->r1.x();
-        unit.r1[1] = m_context->r1.y();
-        unit.r1[2] = m_context->r1.z();
-        unit.weight = float(m_context->weight[0]);
+        unit.c[0] = m_context->attributes->c.x();
+        unit.c[1] = m_context->attributes->c.y();
+        unit.c[2] = m_context->attributes->c.z();
+        unit.r0[0] = m_context->attributes->r0.x();
+        unit.r0[1] = m_context->attributes->r0.y();
+        unit.r0[2] = m_context->attributes->r0.z();
+        unit.r1[0] = m_context->attributes->r1.x();
+        unit.r1[1] = m_context->attributes->r1.y();
+        unit.r1[2] = m_context->attributes->r1.z();
+        unit.weight = float(m_context->attributes->weight[0]);
         internal::writeBytes(&unit, sizeof(unit), data);
         break;
     }
     default: /* unexpected value */
         return;
     }
-    float32 edgeSize = float32(m_context->edgeSize);
+    float32 edgeSize = float32(m_context->attributes->edgeSize);
     internal::writeBytes(&edgeSize, sizeof(edgeSize), data);
 }
 
@@ -475,7 +540,7 @@ vsize Vertex::estimateSize(const Model::DataInfo &info) const
     size += sizeof(AdditinalUVUnit) * info.additionalUVSize;
     size += sizeof(uint8);
     size += sizeof(float32); /* edgeSize */
-    switch (m_context->type) {
+    switch (m_context->attributes->type) {
     case kBdef1:
         size += info.boneIndexSize;
         break;
@@ -523,27 +588,27 @@ void Vertex::mergeMorph(const Morph::Vertex *morph, const IMorph::WeightPrecisio
 
 void Vertex::performSkinning(Vector3 &position, Vector3 &normal) const
 {
-    const Vector3 &vertexPosition = m_context->origin + m_context->morphDelta;
-    switch (m_context->type) {
+    const Vector3 &vertexPosition = m_context->attributes->origin + m_context->morphDelta;
+    switch (m_context->attributes->type) {
     case kBdef1: {
-        internal::ModelHelper::transformVertex(m_context->boneRefs[0]->localTransform(), vertexPosition, m_context->normal, position, normal);
+        internal::ModelHelper::transformVertex(m_context->boneRefs[0]->localTransform(), vertexPosition, m_context->attributes->normal, position, normal);
         break;
     }
     case kBdef2:
     case kSdef: {
-        const WeightPrecision &weight = m_context->weight[0];
+        const WeightPrecision &weight = m_context->attributes->weight[0];
         if (btFuzzyZero(Scalar(1 - weight))) {
             const Transform &transform = m_context->boneRefs[0]->localTransform();
-            internal::ModelHelper::transformVertex(transform, vertexPosition, m_context->normal, position, normal);
+            internal::ModelHelper::transformVertex(transform, vertexPosition, m_context->attributes->normal, position, normal);
         }
         else if (btFuzzyZero(Scalar(weight))) {
             const Transform &transform = m_context->boneRefs[1]->localTransform();
-            internal::ModelHelper::transformVertex(transform, vertexPosition, m_context->normal, position, normal);
+            internal::ModelHelper::transformVertex(transform, vertexPosition, m_context->attributes->normal, position, normal);
         }
         else {
             const Transform &transformA = m_context->boneRefs[0]->localTransform();
             const Transform &transformB = m_context->boneRefs[1]->localTransform();
-            internal::ModelHelper::transformVertex(transformA, transformB, vertexPosition, m_context->normal, position, normal, weight);
+            internal::ModelHelper::transformVertex(transformA, transformB, vertexPosition, m_context->attributes->normal, position, normal, weight);
         }
         break;
     }
@@ -553,14 +618,14 @@ void Vertex::performSkinning(Vector3 &position, Vector3 &normal) const
         const Transform &transformC = m_context->boneRefs[2]->localTransform();
         const Transform &transformD = m_context->boneRefs[3]->localTransform();
         const Vector3 &v1 = transformA * vertexPosition;
-        const Vector3 &n1 = transformA.getBasis() * m_context->normal;
+        const Vector3 &n1 = transformA.getBasis() * m_context->attributes->normal;
         const Vector3 &v2 = transformB * vertexPosition;
-        const Vector3 &n2 = transformB.getBasis() * m_context->normal;
+        const Vector3 &n2 = transformB.getBasis() * m_context->attributes->normal;
         const Vector3 &v3 = transformC * vertexPosition;
-        const Vector3 &n3 = transformC.getBasis() * m_context->normal;
+        const Vector3 &n3 = transformC.getBasis() * m_context->attributes->normal;
         const Vector3 &v4 = transformD * vertexPosition;
-        const Vector3 &n4 = transformD.getBasis() * m_context->normal;
-        const WeightPrecision &w1 = m_context->weight[0], &w2 = m_context->weight[1], &w3 = m_context->weight[2], &w4 = m_context->weight[3];
+        const Vector3 &n4 = transformD.getBasis() * m_context->attributes->normal;
+        const WeightPrecision &w1 = m_context->attributes->weight[0], &w2 = m_context->attributes->weight[1], &w3 = m_context->attributes->weight[2], &w4 = m_context->attributes->weight[3];
         const WeightPrecision &s  = w1 + w2 + w3 + w4, &w1s = w1 / s, &w2s = w2 / s, &w3s = w3 / s, &w4s = w4 / s;
         position = v1 * Scalar(w1s) + v2 * Scalar(w2s) + v3 * Scalar(w3s) + v4 * Scalar(w4s);
         normal   = n1 * Scalar(w1s) + n2 * Scalar(w2s) + n3 * Scalar(w3s) + n4 * Scalar(w4s);
@@ -579,7 +644,7 @@ IModel *Vertex::parentModelRef() const
 
 Vector3 Vertex::origin() const
 {
-    return m_context->origin;
+    return m_context->attributes->origin;
 }
 
 Vector3 Vertex::delta() const
@@ -589,22 +654,22 @@ Vector3 Vertex::delta() const
 
 Vector3 Vertex::normal() const
 {
-    return m_context->normal;
+    return m_context->attributes->normal;
 }
 
 Vector3 Vertex::textureCoord() const
 {
-    return m_context->texcoord;
+    return m_context->attributes->texcoord;
 }
 
 IVertex::Type Vertex::type() const
 {
-    return m_context->type;
+    return m_context->attributes->type;
 }
 
 IVertex::EdgeSizePrecision Vertex::edgeSize() const
 {
-    return m_context->edgeSize;
+    return m_context->attributes->edgeSize;
 }
 
 int Vertex::index() const
@@ -614,23 +679,23 @@ int Vertex::index() const
 
 Vector3 Vertex::sdefC() const
 {
-    return m_context->c;
+    return m_context->attributes->c;
 }
 
 Vector3 Vertex::sdefR0() const
 {
-    return m_context->r0;
+    return m_context->attributes->r0;
 }
 
 Vector3 Vertex::sdefR1() const
 {
-    return m_context->r1;
+    return m_context->attributes->r1;
 }
 
 Vector4 Vertex::uv(int index) const
 {
     if (internal::checkBound(index, 0, kMaxMorphs - 1)) {
-        const Vector4 &origin = m_context->originUVs[index + 1], &morph = m_context->morphUVs[index + 1];
+        const Vector4 &origin = m_context->attributes->originUVs[index + 1], &morph = m_context->morphUVs[index + 1];
         return Vector4(origin.x() + morph.x(), origin.y() + morph.y(), origin.z() + morph.z(), origin.w() + morph.w());
     }
     return kZeroV4;
@@ -638,7 +703,7 @@ Vector4 Vertex::uv(int index) const
 
 Vector4 Vertex::originUV(int index) const
 {
-    return internal::checkBound(index, 0, kMaxMorphs - 1) ? m_context->originUVs[index + 1] : kZeroV4;
+    return internal::checkBound(index, 0, kMaxMorphs - 1) ? m_context->attributes->originUVs[index + 1] : kZeroV4;
     }
 
     Vector4 Vertex::morphUV(int index) const
@@ -648,7 +713,7 @@ Vector4 Vertex::originUV(int index) const
 
 IVertex::WeightPrecision Vertex::weight(int index) const
 {
-    return internal::checkBound(index, 0, kMaxBones) ? m_context->weight[index] : 0;
+    return internal::checkBound(index, 0, kMaxBones) ? m_context->attributes->weight[index] : 0;
 }
 
 IBone *Vertex::boneRef(int index) const
@@ -663,23 +728,23 @@ IMaterial *Vertex::materialRef() const
 
 void Vertex::setOrigin(const Vector3 &value)
 {
-    m_context->origin = value;
+    m_context->detachAttributes()->origin = value;
 }
 
 void Vertex::setNormal(const Vector3 &value)
 {
-    m_context->normal = value;
+    m_context->detachAttributes()->normal = value;
 }
 
 void Vertex::setTextureCoord(const Vector3 &value)
 {
-    m_context->texcoord = value;
+    m_context->detachAttributes()->texcoord = value;
 }
 
 void Vertex::setOriginUV(int index, const Vector4 &value)
 {
     if (internal::checkBound(index, 0, kMaxBones - 1)) {
-        m_context->originUVs[index + 1] = value;
+        m_context->detachAttributes()->originUVs[index + 1] = value;
     }
 }
 
@@ -692,18 +757,18 @@ void Vertex::setMorphUV(int index, const Vector4 &value)
 
 void Vertex::setType(Type value)
 {
-    m_context->type = value;
+    m_context->detachAttributes()->type = value;
 }
 
 void Vertex::setEdgeSize(const EdgeSizePrecision &value)
 {
-    m_context->edgeSize = value;
+    m_context->detachAttributes()->edgeSize = value;
 }
 
 void Vertex::setWeight(int index, const WeightPrecision &weight)
 {
     if (internal::checkBound(index, 0, kMaxBones)) {
-        m_context->weight[index] = weight;
+        m_context->detachAttributes()->weight[index] = weight;
     }
 }
 
@@ -712,11 +777,11 @@ void Vertex::setBoneRef(int index, IBone *value)
     if (internal::checkBound(index, 0, kMaxBones)) {
         if (value) {
             m_context->boneRefs[index] = value;
-            m_context->boneIndices[index] = value->index();
+            m_context->detachAttributes()->boneIndices[index] = value->index();
         }
         else {
             m_context->boneRefs[index] = Factory::sharedNullBoneRef();
-            m_context->boneIndices[index] = -1;
+            m_context->detachAttributes()->boneIndices[index] = -1;
         }
     }
 }
@@ -728,17 +793,17 @@ void Vertex::setMaterialRef(IMaterial *value)
 
 void Vertex::setSdefC(const Vector3 &value)
 {
-    m_context->c = value;
+    m_context->detachAttributes()->c = value;
 }
 
 void Vertex::setSdefR0(const Vector3 &value)
 {
-    m_context->r0 = value;
+    m_context->detachAttributes()->r0 = value;
 }
 
 void Vertex::setSdefR1(const Vector3 &value)
 {
-    m_context->r1 = value;
+    m_context->detachAttributes()->r1 = value;
 }
 
 void Vertex::setIndex(int value)
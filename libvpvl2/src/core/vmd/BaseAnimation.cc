@@ -49,17 +49,33 @@ namespace VPVL2_VERSION_NS
 namespace vmd
 {
 
+struct BaseAnimation::KeyframeBucket {
+    KeyframeBucket(int key)
+        : key(key)
+    {
+    }
+    const int key;
+    Array<IKeyframe *> keyframes;
+};
+
 BaseAnimation::BaseAnimation()
-    : m_lastTimeIndex(0),
+    : m_sharedAnimationRef(0),
+      m_numIndexedKeyframes(0),
+      m_lastTimeIndex(0),
       m_durationTimeIndex(0),
       m_currentTimeIndex(0),
-      m_previousTimeIndex(0)
+      m_previousTimeIndex(0),
+      m_numBucketedKeyframes(0)
 {
 }
 
 BaseAnimation::~BaseAnimation()
 {
+    m_timeIndex2buckets.releaseAll();
     m_keyframes.releaseAll();
+    m_sharedAnimationRef = 0;
+    m_numIndexedKeyframes = 0;
+    m_numBucketedKeyframes = 0;
     m_lastTimeIndex = 0;
     m_durationTimeIndex = 0.0f;
     m_currentTimeIndex = 0.0f;
@@ -84,14 +100,39 @@ void BaseAnimation::reset()
     m_previousTimeIndex = 0.0f;
 }
 
+void BaseAnimation::update()
+{
+    if (m_sharedAnimationRef) {
+        /* keyframes are sorted by the shared animation, only follow its duration */
+        m_durationTimeIndex = m_sharedAnimationRef->m_durationTimeIndex;
+        return;
+    }
+    /* keyframes may be retimed in place, so only sort when the order is actually broken */
+    if (!internal::MotionHelper::isKeyframesSorted(m_keyframes)) {
+        m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+        m_lastTimeIndex = 0;
+    }
+    const int nkeyframes = m_keyframes.count();
+    m_durationTimeIndex = nkeyframes > 0 ? m_keyframes[nkeyframes - 1]->timeIndex() : 0;
+    updateKeyframeBuckets();
+}
+
 void BaseAnimation::addKeyframe(IKeyframe *keyframe)
 {
+    /* keyframes are sorted once in update() instead of on each addition */
     m_keyframes.append(keyframe);
+    addKeyframeToBucket(keyframe);
+    btSetMax(m_durationTimeIndex, keyframe->timeIndex());
 }
 
 void BaseAnimation::removeKeyframe(IKeyframe *keyframe)
 {
-    m_keyframes.remove(keyframe);
+    if (internal::MotionHelper::removeKeyframeSorted(keyframe, m_keyframes)) {
+        const int nkeyframes = m_keyframes.count();
+        m_durationTimeIndex = nkeyframes > 0 ? m_keyframes[nkeyframes - 1]->timeIndex() : 0;
+        m_lastTimeIndex = 0;
+    }
+    removeKeyframeFromBucket(keyframe);
 }
 
 void BaseAnimation::deleteKeyframe(IKeyframe *&keyframe)
@@ -102,23 +143,42 @@ void BaseAnimation::deleteKeyframe(IKeyframe *&keyframe)
 
 void BaseAnimation::getKeyframes(const IKeyframe::TimeIndex &timeIndex, Array<IKeyframe *> &keyframes) const
 {
-    const int nkeyframes = m_keyframes.count();
-    for (int i = 0; i < nkeyframes; i++) {
-        IKeyframe *keyframe = m_keyframes[i];
-        if (keyframe->timeIndex() == timeIndex) {
-            keyframes.append(keyframe);
+    if (m_sharedAnimationRef) {
+        /* instances use the time buckets of the source instead of building their own */
+        m_sharedAnimationRef->getKeyframes(timeIndex, keyframes);
+    }
+    else if (!isKeyframeBucketsValid()) {
+        /* buckets are rebuilt on next update, lookups never modify them */
+        const int nkeyframes = m_keyframes.count();
+        for (int i = 0; i < nkeyframes; i++) {
+            IKeyframe *keyframe = m_keyframes[i];
+            if (keyframe->timeIndex() == timeIndex) {
+                keyframes.append(keyframe);
+            }
+        }
+    }
+    else if (const KeyframeBucket *const *bucketPtr = m_timeIndex2buckets.find(HashInt(int(timeIndex)))) {
+        const Array<IKeyframe *> &bucketKeyframes = (*bucketPtr)->keyframes;
+        const int nkeyframes = bucketKeyframes.count();
+        for (int i = 0; i < nkeyframes; i++) {
+            IKeyframe *keyframe = bucketKeyframes[i];
+            if (keyframe->timeIndex() == timeIndex) {
+                keyframes.append(keyframe);
+            }
         }
     }
 }
 
 void BaseAnimation::getAllKeyframes(Array<IKeyframe *> &value) const
 {
-    value.copy(m_keyframes);
+    value.copy(keyframeRefs());
 }
 
 void BaseAnimation::setAllKeyframes(const Array<IKeyframe *> &value, IKeyframe::Type type)
 {
+    /* detaches from the shared animation and takes ownership of the given keyframes */
     m_keyframes.releaseAll();
+    m_sharedAnimationRef = 0;
     const int nkeyframes = value.count();
     m_keyframes.reserve(nkeyframes);
     for (int i = 0; i < nkeyframes; i++) {
@@ -127,6 +187,20 @@ void BaseAnimation::setAllKeyframes(const Array<IKeyframe *> &value, IKeyframe::
             m_keyframes.append(keyframe);
         }
     }
+    m_numIndexedKeyframes = -1;
+    m_numBucketedKeyframes = -1;
+}
+
+void BaseAnimation::shareKeyframes(const BaseAnimation *source)
+{
+    /* keyframes of the source are read through keyframeRefs(), only the playback state is owned */
+    m_keyframes.releaseAll();
+    m_timeIndex2buckets.releaseAll();
+    m_sharedAnimationRef = source;
+    m_durationTimeIndex = source ? source->m_durationTimeIndex : 0;
+    m_lastTimeIndex = 0;
+    m_numIndexedKeyframes = -1;
+    m_numBucketedKeyframes = 0;
 }
 
 IKeyframe::SmoothPrecision BaseAnimation::interpolateTimeIndex(const IKeyframe::TimeIndex &from, const IKeyframe::TimeIndex &to) const
@@ -134,6 +208,88 @@ IKeyframe::SmoothPrecision BaseAnimation::interpolateTimeIndex(const IKeyframe::
     return internal::MotionHelper::interpolateTimeIndex(m_currentTimeIndex, from, to);
 }
 
+void BaseAnimation::addKeyframeToBucket(IKeyframe *keyframe)
+{
+    /* called after the keyframe is added to m_keyframes */
+    if (m_numBucketedKeyframes != m_keyframes.count() - 1) {
+        m_numBucketedKeyframes = -1;
+        return;
+    }
+    appendKeyframeToBucket(keyframe);
+    m_numBucketedKeyframes++;
+}
+
+void BaseAnimation::removeKeyframeFromBucket(IKeyframe *keyframe)
+{
+    /* called after the keyframe is removed from m_keyframes */
+    if (m_numBucketedKeyframes == m_keyframes.count() + 1) {
+        if (KeyframeBucket *const *bucketPtr = m_timeIndex2buckets.find(HashInt(int(keyframe->timeIndex())))) {
+            Array<IKeyframe *> &bucketKeyframes = (*bucketPtr)->keyframes;
+            const int nkeyframes = bucketKeyframes.count();
+            bucketKeyframes.remove(keyframe);
+            if (bucketKeyframes.count() != nkeyframes) {
+                m_numBucketedKeyframes--;
+                return;
+            }
+        }
+    }
+    /* the keyframe was retimed in place or not bucketed, rebuild all on next lookup */
+    m_numBucketedKeyframes = -1;
+}
+
+void BaseAnimation::updateKeyframeBuckets()
+{
+    if (!isKeyframeBucketsValid()) {
+        rebuildKeyframeBuckets();
+        return;
+    }
+    /* move keyframes retimed in place since they were bucketed */
+    Array<IKeyframe *> movedKeyframes;
+    const int nbuckets = m_timeIndex2buckets.count();
+    for (int i = 0; i < nbuckets; i++) {
+        KeyframeBucket *bucket = *m_timeIndex2buckets.value(i);
+        Array<IKeyframe *> &bucketKeyframes = bucket->keyframes;
+        for (int j = bucketKeyframes.count() - 1; j >= 0; j--) {
+            IKeyframe *keyframe = bucketKeyframes[j];
+            if (int(keyframe->timeIndex()) != bucket->key) {
+                movedKeyframes.append(keyframe);
+                bucketKeyframes.removeAt(j);
+            }
+        }
+    }
+    const int nmoved = movedKeyframes.count();
+    m_numBucketedKeyframes -= nmoved;
+    for (int i = 0; i < nmoved; i++) {
+        IKeyframe *keyframe = movedKeyframes[i];
+        appendKeyframeToBucket(keyframe);
+        m_numBucketedKeyframes++;
+    }
+}
+
+void BaseAnimation::appendKeyframeToBucket(IKeyframe *keyframe)
+{
+    const HashInt key(int(keyframe->timeIndex()));
+    KeyframeBucket *const *bucketPtr = m_timeIndex2buckets.find(key);
+    KeyframeBucket *bucket = bucketPtr ? *bucketPtr : m_timeIndex2buckets.insert(key, new KeyframeBucket(key.getUid1()));
+    bucket->keyframes.append(keyframe);
+}
+
+void BaseAnimation::rebuildKeyframeBuckets()
+{
+    m_timeIndex2buckets.releaseAll();
+    const int nkeyframes = m_keyframes.count();
+    for (int i = 0; i < nkeyframes; i++) {
+        IKeyframe *keyframe = m_keyframes[i];
+        appendKeyframeToBucket(keyframe);
+    }
+    m_numBucketedKeyframes = nkeyframes;
+}
+
+bool BaseAnimation::isKeyframeBucketsValid() const
+{
+    return m_numBucketedKeyframes == m_keyframes.count();
+}
+
 } /* namespace vmd */
 } /* namespace VPVL2_VERSION_NS */
 } /* namespace vpvl2 */
@@ -38,6 +38,7 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/MotionHelper.h"
 
 #include "vpvl2/IBoneKeyframe.h"
@@ -51,13 +52,29 @@ namespace VPVL2_VERSION_NS
 namespace vmd
 {
 
-struct BoneAnimation::PrivateContext {
-    IBone *bone;
+struct BoneAnimation::Track {
+    Track(const IString *name, int index)
+        : name(name->clone()),
+          index(index),
+          sorted(true)
+    {
+    }
+    ~Track() {
+        internal::deleteObject(name);
+    }
+
+    /* owns the key of m_name2tracks as keyframes referring the name may be deleted first */
+    IString *name;
     Array<BoneKeyframe *> keyframeRefs;
-    Vector3 position;
-    Quaternion rotation;
-    int lastIndex;
+    int index;
+    bool sorted;
 
+    void sortKeyframes() {
+        if (!sorted) {
+            keyframeRefs.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+            sorted = true;
+        }
+    }
     bool isNull() const {
         if (keyframeRefs.count() == 1) {
             const IBoneKeyframe *keyframe = keyframeRefs[0];
@@ -68,6 +85,27 @@ struct BoneAnimation::PrivateContext {
     }
 };
 
+struct BoneAnimation::PrivateContext {
+    PrivateContext(const Track *trackRef)
+        : trackRef(trackRef),
+          bone(0),
+          lastIndex(0)
+    {
+        position.setZero();
+        rotation.setValue(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    ~PrivateContext() {
+        trackRef = 0;
+        bone = 0;
+    }
+
+    const Track *trackRef;
+    IBone *bone;
+    Vector3 position;
+    Quaternion rotation;
+    int lastIndex;
+};
+
 IKeyframe::SmoothPrecision BoneAnimation::weightValue(const BoneKeyframe *keyframe,
                                                       const IKeyframe::SmoothPrecision &w,
                                                       int at)
@@ -98,6 +136,9 @@ void BoneAnimation::lerpVector3(const BoneKeyframe *keyframe,
 BoneAnimation::BoneAnimation(IEncoding *encoding)
     : BaseAnimation(),
       m_encodingRef(encoding),
+      m_tracksRevision(0),
+      m_contextsRevision(0),
+      m_bindingCache(new internal::ModelBindingCache<IBone>()),
       m_modelRef(0),
       m_enableNullFrame(false)
 {
@@ -105,7 +146,9 @@ BoneAnimation::BoneAnimation(IEncoding *encoding)
 
 BoneAnimation::~BoneAnimation()
 {
-    m_name2contexts.releaseAll();
+    m_contexts.releaseAll();
+    m_name2tracks.releaseAll();
+    internal::deleteObject(m_bindingCache);
     m_modelRef = 0;
 }
 
@@ -123,16 +166,22 @@ void BoneAnimation::read(const uint8 *data, int size)
 void BoneAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
 {
     if (m_modelRef) {
-        const int ncontexts = m_name2contexts.count();
+        /* tracks of instances are sorted by the shared animation */
+        const int ntracks = m_name2tracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            Track *track = *m_name2tracks.value(i);
+            track->sortKeyframes();
+        }
+        const int ncontexts = m_contexts.count();
         for (int i = 0; i < ncontexts; i++) {
-            PrivateContext *keyframes = *m_name2contexts.value(i);
-            if (m_enableNullFrame && keyframes->isNull()) {
+            PrivateContext *context = m_contexts[i];
+            IBone *bone = context->bone;
+            if (!bone || (m_enableNullFrame && context->trackRef->isNull())) {
                 continue;
             }
-            calculateKeyframes(timeIndexAt, keyframes);
-            IBone *bone = keyframes->bone;
-            bone->setLocalTranslation(keyframes->position);
-            bone->setLocalOrientation(keyframes->rotation);
+            calculateKeyframes(timeIndexAt, context);
+            bone->setLocalTranslation(context->position);
+            bone->setLocalOrientation(context->rotation);
         }
         m_previousTimeIndex = m_currentTimeIndex;
         m_currentTimeIndex = timeIndexAt;
@@ -149,39 +198,140 @@ void BoneAnimation::createFirstKeyframeUnlessFound()
             const IBone *bone = bones[i];
             const IString *name = bone->name(IEncoding::kDefaultLanguage);
             if (name && name->size() > 0 && !findKeyframe(0, name)) {
-                BoneKeyframe *keyframe = m_keyframes.append(new BoneKeyframe(m_encodingRef));
+                BoneKeyframe *keyframe = new BoneKeyframe(m_encodingRef);
                 keyframe->setName(name);
                 keyframe->setTimeIndex(0);
                 keyframe->setLocalTranslation(kZeroV3);
                 keyframe->setLocalOrientation(Quaternion::getIdentity());
                 keyframe->setDefaultInterpolationParameter();
-                m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+                addKeyframe(keyframe);
             }
         }
     }
 }
 
+void BoneAnimation::update()
+{
+    updateTracks();
+    if (m_contextsRevision != tracksOwnerRef()->m_tracksRevision) {
+        createPrivateContexts();
+    }
+    else {
+        updateDurationTimeIndex();
+    }
+    updateKeyframeBuckets();
+}
+
+void BoneAnimation::addKeyframe(IKeyframe *keyframe)
+{
+    const bool indexed = m_numIndexedKeyframes == m_keyframes.count();
+    m_keyframes.append(keyframe);
+    addKeyframeToBucket(keyframe);
+    if (indexed) {
+        BoneKeyframe *boneKeyframe = static_cast<BoneKeyframe *>(keyframe);
+        const bool bound = m_contextsRevision == m_tracksRevision;
+        if (Track *track = resolveTrack(boneKeyframe->name())) {
+            if (!internal::MotionHelper::appendKeyframe(boneKeyframe, track->keyframeRefs)) {
+                /* sorted once on next seek or update instead of shifting the track on each addition */
+                track->sorted = false;
+            }
+            if (bound && m_contextsRevision != m_tracksRevision) {
+                /* a new track is always appended to the last of m_name2tracks */
+                PrivateContext *context = m_contexts.append(new PrivateContext(track));
+                context->bone = m_modelRef ? m_modelRef->findBoneRef(track->name) : 0;
+                m_contextsRevision = m_tracksRevision;
+                m_bindingCache->clear();
+            }
+            if (m_contextsRevision == m_tracksRevision && m_contexts[track->index]->bone) {
+                btSetMax(m_durationTimeIndex, boneKeyframe->timeIndex());
+            }
+        }
+        m_numIndexedKeyframes++;
+    }
+}
+
+void BoneAnimation::removeKeyframe(IKeyframe *keyframe)
+{
+    const int nkeyframes = m_keyframes.count();
+    const bool indexed = m_numIndexedKeyframes == nkeyframes;
+    if (!internal::MotionHelper::removeKeyframeSorted(keyframe, m_keyframes)) {
+        return;
+    }
+    removeKeyframeFromBucket(keyframe);
+    if (!indexed) {
+        return;
+    }
+    m_numIndexedKeyframes--;
+    const IString *name = keyframe->name();
+    Track *const *trackPtr = name ? m_name2tracks.find(name->toHashString()) : 0;
+    if (trackPtr && internal::MotionHelper::removeKeyframeSorted(keyframe, (*trackPtr)->keyframeRefs)) {
+        Track *track = *trackPtr;
+        if (track->keyframeRefs.count() == 0) {
+            const bool bound = m_contextsRevision == m_tracksRevision;
+            const int index = track->index;
+            /* both of m_name2tracks and m_contexts move the last item to the removed position */
+            m_name2tracks.remove(name->toHashString());
+            if (index < m_name2tracks.count()) {
+                (*m_name2tracks.value(index))->index = index;
+            }
+            m_tracksRevision++;
+            if (bound) {
+                PrivateContext *context = m_contexts[index];
+                m_contexts.removeAt(index);
+                internal::deleteObject(context);
+                m_contextsRevision = m_tracksRevision;
+            }
+            /* track ids are positions in m_name2tracks, so cached bindings are stale now */
+            m_bindingCache->clear();
+            internal::deleteObject(track);
+        }
+        if (keyframe->timeIndex() >= m_durationTimeIndex) {
+            updateTracks();
+            updateDurationTimeIndex();
+        }
+    }
+    else {
+        /* not indexed by its current name (renamed in place?), rebuild the track index on next update */
+        m_numIndexedKeyframes = -1;
+    }
+}
+
 void BoneAnimation::setParentModelRef(IModel *model)
 {
-    createPrivateContexts(model);
     m_modelRef = model;
+    updateTracks();
+    if (m_contextsRevision != tracksOwnerRef()->m_tracksRevision) {
+        createPrivateContexts();
+    }
+    else {
+        bindPrivateContexts();
+    }
 }
 
 BoneKeyframe *BoneAnimation::findKeyframeAt(int i) const
 {
-    return internal::checkBound(i, 0, m_keyframes.count()) ? reinterpret_cast<BoneKeyframe *>(m_keyframes[i]) : 0;
+    return internal::checkBound(i, 0, countKeyframes()) ? reinterpret_cast<BoneKeyframe *>(keyframeRefs()[i]) : 0;
 }
 
 BoneKeyframe *BoneAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex, const IString *name) const
 {
     if (name) {
         const HashString &key = name->toHashString();
-        PrivateContext *const *ptr = m_name2contexts.find(key);
-        if (ptr) {
-            const PrivateContext *context = *ptr;
-            const Array<BoneKeyframe *> &keyframeRefs = context->keyframeRefs;
-            int index = findKeyframeIndex(timeIndex, keyframeRefs);
-            return index != -1 ? keyframeRefs[index] : 0;
+        if (const Track *const *ptr = tracksOwnerRef()->m_name2tracks.find(key)) {
+            const Track *track = *ptr;
+            const Array<BoneKeyframe *> &keyframeRefs = track->keyframeRefs;
+            if (track->sorted) {
+                int index = findKeyframeIndex(timeIndex, keyframeRefs);
+                return index != -1 ? keyframeRefs[index] : 0;
+            }
+            /* the track is sorted on next seek or update, lookups never modify tracks */
+            const int nkeyframes = keyframeRefs.count();
+            for (int i = 0; i < nkeyframes; i++) {
+                BoneKeyframe *keyframe = keyframeRefs[i];
+                if (keyframe->timeIndex() == timeIndex) {
+                    return keyframe;
+                }
+            }
         }
     }
     else {
@@ -190,48 +340,112 @@ BoneKeyframe *BoneAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex,
     return 0;
 }
 
-void BoneAnimation::createPrivateContexts(IModel *model)
+const BoneAnimation *BoneAnimation::tracksOwnerRef() const
 {
-    if (model) {
+    /* instances refer tracks of the shared animation instead of building their own */
+    return m_sharedAnimationRef ? static_cast<const BoneAnimation *>(m_sharedAnimationRef) : this;
+}
+
+void BoneAnimation::updateTracks()
+{
+    if (m_sharedAnimationRef) {
+        return;
+    }
+    else if (m_numIndexedKeyframes != m_keyframes.count()) {
         const int nkeyframes = m_keyframes.count();
-        m_name2contexts.releaseAll();
-        m_durationTimeIndex = 0;
+        m_name2tracks.releaseAll();
         // Build internal node to find by name, not frame index
         for (int i = 0; i < nkeyframes; i++) {
             BoneKeyframe *keyframe = reinterpret_cast<BoneKeyframe *>(m_keyframes.at(i));
-            const IString *name = keyframe->name();
-            const HashString &key = name->toHashString();
-            PrivateContext **ptr = m_name2contexts[key], *context;
-            if (ptr) {
-                context = *ptr;
-                context->keyframeRefs.append(keyframe);
-            }
-            else if (IBone *bone = model->findBoneRef(name)) {
-                PrivateContext *context = m_name2contexts.insert(key, new PrivateContext());
-                context->keyframeRefs.append(keyframe);
-                context->bone = bone;
-                context->lastIndex = 0;
-                context->position.setZero();
-                context->rotation.setValue(0.0f, 0.0f, 0.0f, 1.0f);
+            if (Track *track = resolveTrack(keyframe->name())) {
+                track->keyframeRefs.append(keyframe);
+                track->sorted = false;
             }
         }
-        // Sort frames from each internal nodes by frame index ascend
-        const int ncontexts = m_name2contexts.count();
+        m_numIndexedKeyframes = nkeyframes;
+        m_tracksRevision++;
+    }
+    // Sort frames from each internal nodes by frame index ascend
+    const int ntracks = m_name2tracks.count();
+    for (int i = 0; i < ntracks; i++) {
+        /* keyframes may be retimed in place, so only sort tracks whose order is actually broken */
+        Track *track = *m_name2tracks.value(i);
+        track->sorted = track->sorted && internal::MotionHelper::isKeyframesSorted(track->keyframeRefs);
+        track->sortKeyframes();
+    }
+}
+
+void BoneAnimation::createPrivateContexts()
+{
+    const BoneAnimation *owner = tracksOwnerRef();
+    const int ntracks = owner->m_name2tracks.count();
+    m_contexts.releaseAll();
+    m_contexts.reserve(ntracks);
+    for (int i = 0; i < ntracks; i++) {
+        m_contexts.append(new PrivateContext(*owner->m_name2tracks.value(i)));
+    }
+    m_contextsRevision = owner->m_tracksRevision;
+    /* track ids are positions in m_name2tracks, so cached bindings are stale now */
+    m_bindingCache->clear();
+    bindPrivateContexts();
+}
+
+void BoneAnimation::bindPrivateContexts()
+{
+    const int ncontexts = m_contexts.count();
+    if (m_modelRef) {
+        Array<const IString *> names;
+        names.reserve(ncontexts);
+        for (int i = 0; i < ncontexts; i++) {
+            names.append(m_contexts[i]->trackRef->name);
+        }
+        /* bones are resolved once per model and reused while swapping models */
+        const Array<IBone *> &boneRefs = m_bindingCache->resolve(m_modelRef, names);
         for (int i = 0; i < ncontexts; i++) {
-            PrivateContext *context = *m_name2contexts.value(i);
-            Array<BoneKeyframe *> &keyframeRefs = context->keyframeRefs;
-            keyframeRefs.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
-            btSetMax(m_durationTimeIndex, keyframeRefs[keyframeRefs.count() - 1]->timeIndex());
+            PrivateContext *context = m_contexts[i];
+            context->bone = boneRefs[i];
         }
     }
     else {
-        VPVL2_LOG(WARNING, "Null model is passed");
+        for (int i = 0; i < ncontexts; i++) {
+            PrivateContext *context = m_contexts[i];
+            context->bone = 0;
+        }
+    }
+    updateDurationTimeIndex();
+}
+
+BoneAnimation::Track *BoneAnimation::resolveTrack(const IString *name)
+{
+    if (Track *const *ptr = m_name2tracks.find(name->toHashString())) {
+        return *ptr;
+    }
+    Track *track = new Track(name, m_name2tracks.count());
+    m_tracksRevision++;
+    return m_name2tracks.insert(track->name->toHashString(), track);
+}
+
+void BoneAnimation::updateDurationTimeIndex()
+{
+    m_durationTimeIndex = 0;
+    const int ncontexts = m_contexts.count();
+    for (int i = 0; i < ncontexts; i++) {
+        const PrivateContext *context = m_contexts[i];
+        if (!context->bone) {
+            continue;
+        }
+        const Array<BoneKeyframe *> &keyframeRefs = context->trackRef->keyframeRefs;
+        btSetMax(m_durationTimeIndex, keyframeRefs[keyframeRefs.count() - 1]->timeIndex());
     }
 }
 
 void BoneAnimation::calculateKeyframes(const IKeyframe::TimeIndex &timeIndexAt, PrivateContext *context)
 {
-    Array<BoneKeyframe *> &keyframes = context->keyframeRefs;
+    const Array<BoneKeyframe *> &keyframes = context->trackRef->keyframeRefs;
+    if (context->lastIndex >= keyframes.count()) {
+        /* the track may be shrunk since the last seek */
+        context->lastIndex = 0;
+    }
     int fromIndex, toIndex;
     internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, context->lastIndex, fromIndex, toIndex, keyframes);
     const BoneKeyframe *keyframeFrom = keyframes.at(fromIndex), *keyframeTo = keyframes.at(toIndex);
@@ -275,9 +489,9 @@ void BoneAnimation::calculateKeyframes(const IKeyframe::TimeIndex &timeIndexAt,
 void BoneAnimation::reset()
 {
     BaseAnimation::reset();
-    const int ncontexts = m_name2contexts.count();
+    const int ncontexts = m_contexts.count();
     for (int i = 0; i < ncontexts; i++) {
-        PrivateContext *context = *m_name2contexts.value(i);
+        PrivateContext *context = m_contexts[i];
         context->lastIndex = 0;
     }
 }
@@ -189,6 +189,20 @@ void BoneKeyframe::getInterpolationParameter(InterpolationType type, QuadWord &v
 void BoneKeyframe::setInterpolationParameter(InterpolationType type, const QuadWord &value)
 {
     setInterpolationParameterInternal(type, value);
+    updateInterpolationTable();
+}
+
+void BoneKeyframe::setInterpolationParameters(const InterpolationParameter &value)
+{
+    setInterpolationParameterInternal(kBonePositionX, value.x);
+    setInterpolationParameterInternal(kBonePositionY, value.y);
+    setInterpolationParameterInternal(kBonePositionZ, value.z);
+    setInterpolationParameterInternal(kBoneRotation, value.rotation);
+    updateInterpolationTable();
+}
+
+void BoneKeyframe::updateInterpolationTable()
+{
     int8 table[kTableSize];
     internal::zerofill(table, sizeof(table));
     for (int i = 0; i < 4; i++) {
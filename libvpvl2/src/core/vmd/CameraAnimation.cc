@@ -111,7 +111,7 @@ void CameraAnimation::read(const uint8 *data, int size)
 void CameraAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
 {
     int fromIndex, toIndex;
-    internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, m_keyframes);
+    internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, keyframeRefs());
     const CameraKeyframe *keyframeFrom = findKeyframeAt(fromIndex), *keyframeTo = findKeyframeAt(toIndex);
     CameraKeyframe *keyframeForInterpolation = const_cast<CameraKeyframe *>(keyframeTo);
     const IKeyframe::TimeIndex &timeIndexFrom = keyframeFrom->timeIndex(), &timeIndexTo = keyframeTo->timeIndex();
@@ -192,27 +192,15 @@ void CameraAnimation::createFirstKeyframeUnlessFound()
     }
 }
 
-void CameraAnimation::update()
-{
-    int nkeyframes = m_keyframes.count();
-    if (nkeyframes > 0) {
-        m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
-        m_durationTimeIndex = m_keyframes[m_keyframes.count() - 1]->timeIndex();
-    }
-    else {
-        m_durationTimeIndex = 0;
-    }
-}
-
 CameraKeyframe *CameraAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex) const
 {
-    int index = findKeyframeIndex(timeIndex, m_keyframes);
-    return index != -1 ? reinterpret_cast<CameraKeyframe *>(m_keyframes[index]) : 0;
+    int index = findKeyframeIndex(timeIndex, keyframeRefs());
+    return index != -1 ? reinterpret_cast<CameraKeyframe *>(keyframeRefs()[index]) : 0;
 }
 
 CameraKeyframe *CameraAnimation::findKeyframeAt(int i) const
 {
-    return internal::checkBound(i, 0, m_keyframes.count()) ? reinterpret_cast<CameraKeyframe *>(m_keyframes[i]) : 0;
+    return internal::checkBound(i, 0, keyframeRefs().count()) ? reinterpret_cast<CameraKeyframe *>(keyframeRefs()[i]) : 0;
 }
 
 } /* namespace vmd */
@@ -0,0 +1,625 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
+#include "vpvl2/internal/MotionHelper.h"
+#include "vpvl2/internal/util.h"
+
+#include "vpvl2/vmd/BoneAnimation.h"
+#include "vpvl2/vmd/BoneKeyframe.h"
+#include "vpvl2/vmd/CompressedBoneAnimation.h"
+
+namespace
+{
+
+using namespace vpvl2;
+
+static const int kNumInterpolationTables = IBoneKeyframe::kMaxBoneInterpolationType;
+static const int kInterpolationTableSize = vmd::BoneKeyframe::kTableSize;
+static const int kMaxInterpolationParameters = 0xffff;
+static const Scalar kMaxQuantizedOrientation = Scalar(0x7fff);
+static const Scalar kMaxQuantizedTranslation = Scalar(0xffff);
+static const Scalar kSqrtHalf = Scalar(0.70710678118654752440);
+
+static inline uint16 quantizeOrientationComponent(const Scalar &value)
+{
+    /* the smallest three components are in [-sqrt(0.5), sqrt(0.5)] */
+    const Scalar normalized = btClamped((value / kSqrtHalf) * 0.5f + 0.5f, Scalar(0), Scalar(1));
+    return static_cast<uint16>(normalized * kMaxQuantizedOrientation + 0.5f);
+}
+
+static inline Scalar dequantizeOrientationComponent(uint16 value)
+{
+    return ((value & 0x7fff) / kMaxQuantizedOrientation * 2 - 1) * kSqrtHalf;
+}
+
+static void encodeOrientation(const Quaternion &value, uint16 *words)
+{
+    Quaternion q(value);
+    if (btFuzzyZero(q.length2())) {
+        q = Quaternion::getIdentity();
+    }
+    else {
+        q.normalize();
+    }
+    int largest = 0;
+    for (int i = 1; i < 4; i++) {
+        if (btFabs(q[i]) > btFabs(q[largest])) {
+            largest = i;
+        }
+    }
+    /* the sign of the largest component is kept to decompress exactly the same quaternion, not its negation */
+    const Scalar &sign = q[largest] < 0 ? -1 : 1;
+    for (int i = 0, j = 0; i < 4; i++) {
+        if (i != largest) {
+            words[j++] = quantizeOrientationComponent(q[i] * sign);
+        }
+    }
+    words[0] |= (largest & 0x2) << 14;
+    words[1] |= (largest & 0x1) << 15;
+    words[2] |= sign < 0 ? 0x8000 : 0;
+}
+
+static void decodeOrientation(const uint16 *words, Quaternion &value)
+{
+    const int largest = ((words[0] >> 14) & 0x2) | ((words[1] >> 15) & 0x1);
+    const Scalar &sign = (words[2] & 0x8000) ? -1 : 1;
+    Scalar components[4], sum = 0;
+    for (int i = 0, j = 0; i < 4; i++) {
+        if (i != largest) {
+            const Scalar &v = dequantizeOrientationComponent(words[j++]);
+            components[i] = v * sign;
+            sum += v * v;
+        }
+    }
+    components[largest] = btSqrt(btMax(Scalar(1) - sum, Scalar(0))) * sign;
+    value.setValue(components[0], components[1], components[2], components[3]);
+}
+
+static void appendVariableLength(uint32 value, Array<uint8> &bytes)
+{
+    while (value >= 0x80) {
+        bytes.append(static_cast<uint8>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.append(static_cast<uint8>(value));
+}
+
+static inline uint32 readVariableLength(const uint8 *&ptr)
+{
+    uint32 value = 0;
+    int shift = 0;
+    while (*ptr & 0x80) {
+        value |= uint32(*ptr++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= uint32(*ptr++) << shift;
+    return value;
+}
+
+} /* namespace anonymous */
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace vmd
+{
+
+struct CompressedBoneAnimation::PrivateContext {
+    struct Track {
+        Track(const IString *name)
+            : name(name->clone()),
+              boneRef(0),
+              keyframeOffset(0),
+              nkeyframes(0),
+              checkpointOffset(0),
+              translationOffset(-1),
+              lastTimeIndex(0)
+        {
+            translationMin.setZero();
+            translationStep.setZero();
+        }
+        ~Track() {
+            internal::deleteObject(name);
+            boneRef = 0;
+        }
+        IString *name;
+        IBone *boneRef;
+        int keyframeOffset;
+        int nkeyframes;
+        int checkpointOffset;
+        /* -1 if the translation of all keyframes is translationMin */
+        int translationOffset;
+        uint32 lastTimeIndex;
+        Vector3 translationMin;
+        Vector3 translationStep;
+    };
+    struct Checkpoint {
+        uint32 timeIndex;
+        /* offset of the delta of the keyframe next to the checkpoint in timeIndexDeltas */
+        int deltaOffset;
+    };
+    struct InterpolationParameter {
+        uint8 values[kNumInterpolationTables * 4];
+        uint8 linearMask;
+        /* offset of each table in tableValues or -1 if the interpolation is linear */
+        int tableOffsets[kNumInterpolationTables];
+        bool equals(const InterpolationParameter &other) const {
+            for (int i = 0; i < int(sizeof(values)); i++) {
+                if (values[i] != other.values[i]) {
+                    return false;
+                }
+            }
+            return linearMask == other.linearMask;
+        }
+        unsigned int hash() const {
+            return static_cast<unsigned int>(internal::hashBytes(&linearMask, sizeof(linearMask), internal::hashBytes(values, sizeof(values))));
+        }
+    };
+    struct KeyframeTimeIndexPredication {
+        bool operator()(const BoneKeyframe *left, const BoneKeyframe *right) const {
+            return left->timeIndex() < right->timeIndex();
+        }
+    };
+
+    PrivateContext()
+        : modelRef(0),
+          currentTimeIndex(0),
+          durationTimeIndex(0),
+          maxTranslationError(0),
+          nkeyframes(0)
+    {
+    }
+    ~PrivateContext() {
+        release();
+    }
+
+    void release() {
+        tracks.releaseAll();
+        bindingCache.clear();
+        checkpoints.clear();
+        parameters.clear();
+        parameterIndices.clear();
+        tableValues.clear();
+        timeIndexDeltas.clear();
+        orientations.clear();
+        translations.clear();
+        parameterIds.clear();
+        currentTimeIndex = 0;
+        durationTimeIndex = 0;
+        maxTranslationError = 0;
+        nkeyframes = 0;
+    }
+    int addInterpolationParameter(const BoneKeyframe *keyframe) {
+        InterpolationParameter parameter;
+        const bool *linear = keyframe->linear();
+        QuadWord value;
+        parameter.linearMask = 0;
+        for (int i = 0; i < kNumInterpolationTables; i++) {
+            keyframe->getInterpolationParameter(static_cast<IBoneKeyframe::InterpolationType>(i), value);
+            for (int j = 0; j < 4; j++) {
+                parameter.values[i * 4 + j] = static_cast<uint8>(value[j]);
+            }
+            parameter.linearMask |= linear[i] ? (1 << i) : 0;
+            parameter.tableOffsets[i] = -1;
+        }
+        const HashInt key(int(parameter.hash()));
+        const int *indexPtr = parameterIndices.find(key);
+        if (indexPtr && parameters[*indexPtr].equals(parameter)) {
+            return *indexPtr;
+        }
+        const int nparameters = parameters.count();
+        if (indexPtr) {
+            /* hash collision, rare enough to look up all parameters */
+            for (int i = 0; i < nparameters; i++) {
+                if (parameters[i].equals(parameter)) {
+                    return i;
+                }
+            }
+        }
+        if (nparameters >= kMaxInterpolationParameters) {
+            return -1;
+        }
+        const IKeyframe::SmoothPrecision *const *tables = keyframe->interpolationTable();
+        for (int i = 0; i < kNumInterpolationTables; i++) {
+            if (!linear[i]) {
+                const IKeyframe::SmoothPrecision *table = tables[i];
+                parameter.tableOffsets[i] = tableValues.count();
+                for (int j = 0; j <= kInterpolationTableSize; j++) {
+                    tableValues.append(table[j]);
+                }
+            }
+        }
+        parameters.append(parameter);
+        if (!indexPtr) {
+            parameterIndices.insert(key, nparameters);
+        }
+        return nparameters;
+    }
+    bool addTrack(Track *track, Array<BoneKeyframe *> &keyframes) {
+        const int nkeyframesOfTrack = keyframes.count();
+        keyframes.sort(KeyframeTimeIndexPredication());
+        Vector3 translationMax(-SIMD_INFINITY, -SIMD_INFINITY, -SIMD_INFINITY);
+        track->translationMin.setValue(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY);
+        for (int i = 0; i < nkeyframesOfTrack; i++) {
+            const Vector3 &translation = keyframes[i]->localTranslation();
+            track->translationMin.setMin(translation);
+            translationMax.setMax(translation);
+        }
+        const Vector3 &extent = translationMax - track->translationMin;
+        bool constant = true;
+        for (int i = 0; i < 3; i++) {
+            if (extent[i] > 0) {
+                track->translationStep[i] = extent[i] / kMaxQuantizedTranslation;
+                btSetMax(maxTranslationError, track->translationStep[i] * 0.5f);
+                constant = false;
+            }
+        }
+        track->keyframeOffset = parameterIds.count();
+        track->nkeyframes = nkeyframesOfTrack;
+        track->checkpointOffset = checkpoints.count();
+        track->translationOffset = constant ? -1 : translations.count();
+        uint32 previousTimeIndex = 0;
+        for (int i = 0; i < nkeyframesOfTrack; i++) {
+            const BoneKeyframe *keyframe = keyframes[i];
+            const uint32 timeIndex = static_cast<uint32>(keyframe->timeIndex());
+            if (i > 0) {
+                appendVariableLength(timeIndex - previousTimeIndex, timeIndexDeltas);
+            }
+            if (i % kCheckpointInterval == 0) {
+                Checkpoint checkpoint;
+                checkpoint.timeIndex = timeIndex;
+                checkpoint.deltaOffset = timeIndexDeltas.count();
+                checkpoints.append(checkpoint);
+            }
+            previousTimeIndex = timeIndex;
+            uint16 words[3];
+            encodeOrientation(keyframe->localOrientation(), words);
+            for (int j = 0; j < 3; j++) {
+                orientations.append(words[j]);
+            }
+            if (!constant) {
+                const Vector3 &translation = keyframe->localTranslation() - track->translationMin;
+                for (int j = 0; j < 3; j++) {
+                    const Scalar &step = track->translationStep[j];
+                    translations.append(step > 0 ? static_cast<uint16>(btMin(translation[j] / step + 0.5f, kMaxQuantizedTranslation)) : 0);
+                }
+            }
+            const int parameterId = addInterpolationParameter(keyframe);
+            if (parameterId < 0) {
+                return false;
+            }
+            parameterIds.append(static_cast<uint16>(parameterId));
+        }
+        track->lastTimeIndex = previousTimeIndex;
+        nkeyframes += nkeyframesOfTrack;
+        return true;
+    }
+    void bindTracks() {
+        const int ntracks = tracks.count();
+        durationTimeIndex = 0;
+        if (modelRef) {
+            Array<const IString *> names;
+            names.reserve(ntracks);
+            for (int i = 0; i < ntracks; i++) {
+                names.append(tracks[i]->name);
+            }
+            const Array<IBone *> &boneRefs = bindingCache.resolve(modelRef, names);
+            for (int i = 0; i < ntracks; i++) {
+                Track *track = tracks[i];
+                track->boneRef = boneRefs[i];
+                if (track->boneRef) {
+                    btSetMax(durationTimeIndex, IKeyframe::TimeIndex(track->lastTimeIndex));
+                }
+            }
+        }
+        else {
+            for (int i = 0; i < ntracks; i++) {
+                tracks[i]->boneRef = 0;
+            }
+        }
+    }
+    void getKeyframe(const Track *track, int index, Vector3 &position, Quaternion &rotation) const {
+        const int offset = track->keyframeOffset + index;
+        decodeOrientation(&orientations[offset * 3], rotation);
+        if (track->translationOffset >= 0) {
+            const uint16 *words = &translations[track->translationOffset + index * 3];
+            const Vector3 &step = track->translationStep;
+            position = track->translationMin + Vector3(words[0] * step.x(), words[1] * step.y(), words[2] * step.z());
+        }
+        else {
+            position = track->translationMin;
+        }
+    }
+    int findKeyframeIndex(const Track *track, const IKeyframe::TimeIndex &timeIndexAt, uint32 &timeIndexFrom, uint32 &timeIndexTo) const {
+        /* find the last checkpoint not after the time index and decode deltas from it */
+        const int ncheckpoints = (track->nkeyframes + kCheckpointInterval - 1) / kCheckpointInterval;
+        const Checkpoint *checkpointPtr = &checkpoints[track->checkpointOffset];
+        int low = 0, high = ncheckpoints;
+        while (low + 1 < high) {
+            const int middle = (low + high) / 2;
+            if (IKeyframe::TimeIndex(checkpointPtr[middle].timeIndex) <= timeIndexAt) {
+                low = middle;
+            }
+            else {
+                high = middle;
+            }
+        }
+        const Checkpoint &checkpoint = checkpointPtr[low];
+        const uint8 *ptr = timeIndexDeltas.count() > 0 ? &timeIndexDeltas[0] + checkpoint.deltaOffset : 0;
+        const int nkeyframesOfTrack = track->nkeyframes;
+        int index = low * kCheckpointInterval;
+        timeIndexFrom = timeIndexTo = checkpoint.timeIndex;
+        while (IKeyframe::TimeIndex(timeIndexTo) < timeIndexAt && index + 1 < nkeyframesOfTrack) {
+            timeIndexFrom = timeIndexTo;
+            timeIndexTo += readVariableLength(ptr);
+            index++;
+        }
+        return index;
+    }
+    void calculateKeyframes(const IKeyframe::TimeIndex &timeIndexAt, const Track *track, Vector3 &position, Quaternion &rotation) const {
+        const IKeyframe::TimeIndex timeIndex = btMin(timeIndexAt, IKeyframe::TimeIndex(track->lastTimeIndex));
+        uint32 timeIndexFrom, timeIndexTo;
+        const int toIndex = findKeyframeIndex(track, timeIndex, timeIndexFrom, timeIndexTo);
+        if (timeIndex >= IKeyframe::TimeIndex(timeIndexTo)) {
+            getKeyframe(track, toIndex, position, rotation);
+            return;
+        }
+        Vector3 positionFrom, positionTo;
+        Quaternion rotationFrom, rotationTo;
+        getKeyframe(track, toIndex - 1, positionFrom, rotationFrom);
+        if (timeIndex <= IKeyframe::TimeIndex(timeIndexFrom)) {
+            position = positionFrom;
+            rotation = rotationFrom;
+            return;
+        }
+        getKeyframe(track, toIndex, positionTo, rotationTo);
+        const InterpolationParameter &parameter = parameters[parameterIds[track->keyframeOffset + toIndex]];
+        const IKeyframe::SmoothPrecision &w = internal::MotionHelper::interpolateTimeIndex(timeIndex, timeIndexFrom, timeIndexTo);
+        IKeyframe::SmoothPrecision values[kNumInterpolationTables];
+        for (int i = 0; i < kNumInterpolationTables; i++) {
+            const int offset = parameter.tableOffsets[i];
+            if (offset >= 0) {
+                /* same as BoneAnimation::weightValue */
+                const IKeyframe::SmoothPrecision *v = &tableValues[offset];
+                const uint16 index = static_cast<int16>(w * kInterpolationTableSize);
+                values[i] = v[index] + (v[index + 1] - v[index]) * (w * kInterpolationTableSize - index);
+            }
+            else {
+                values[i] = w;
+            }
+        }
+        position.setValue(Scalar(internal::MotionHelper::lerp(positionFrom.x(), positionTo.x(), values[0])),
+                          Scalar(internal::MotionHelper::lerp(positionFrom.y(), positionTo.y(), values[1])),
+                          Scalar(internal::MotionHelper::lerp(positionFrom.z(), positionTo.z(), values[2])));
+        rotation = rotationFrom.slerp(rotationTo, Scalar(values[3]));
+    }
+
+    PointerArray<Track> tracks;
+    Array<Checkpoint> checkpoints;
+    Array<InterpolationParameter> parameters;
+    Hash<HashInt, int> parameterIndices;
+    Array<IKeyframe::SmoothPrecision> tableValues;
+    Array<uint8> timeIndexDeltas;
+    Array<uint16> orientations;
+    Array<uint16> translations;
+    Array<uint16> parameterIds;
+    internal::ModelBindingCache<IBone> bindingCache;
+    IModel *modelRef;
+    IKeyframe::TimeIndex currentTimeIndex;
+    IKeyframe::TimeIndex durationTimeIndex;
+    Scalar maxTranslationError;
+    int nkeyframes;
+};
+
+CompressedBoneAnimation::CompressedBoneAnimation()
+    : m_context(new PrivateContext())
+{
+}
+
+CompressedBoneAnimation::~CompressedBoneAnimation()
+{
+    internal::deleteObject(m_context);
+}
+
+bool CompressedBoneAnimation::compress(const BoneAnimation &animation)
+{
+    m_context->release();
+    Hash<HashString, int> name2indices;
+    PointerArray<Array<BoneKeyframe *> > keyframesOfTracks;
+    const int nkeyframes = animation.countKeyframes();
+    for (int i = 0; i < nkeyframes; i++) {
+        BoneKeyframe *keyframe = animation.findKeyframeAt(i);
+        const IString *name = keyframe->name();
+        if (!name) {
+            continue;
+        }
+        const HashString &key = name->toHashString();
+        if (const int *indexPtr = name2indices.find(key)) {
+            keyframesOfTracks[*indexPtr]->append(keyframe);
+        }
+        else {
+            PrivateContext::Track *track = m_context->tracks.append(new PrivateContext::Track(name));
+            name2indices.insert(track->name->toHashString(), keyframesOfTracks.count());
+            keyframesOfTracks.append(new Array<BoneKeyframe *>())->append(keyframe);
+        }
+    }
+    const int ntracks = m_context->tracks.count();
+    bool compressed = true;
+    for (int i = 0; i < ntracks && compressed; i++) {
+        compressed = m_context->addTrack(m_context->tracks[i], *keyframesOfTracks[i]);
+    }
+    keyframesOfTracks.releaseAll();
+    if (!compressed) {
+        VPVL2_LOG(WARNING, "Too many interpolation parameters to compress bone keyframes: " << nkeyframes);
+        m_context->release();
+        return false;
+    }
+    /* the hash is only used while compressing */
+    m_context->parameterIndices.clear();
+    m_context->bindTracks();
+    VPVL2_VLOG(1, "Compressed " << m_context->nkeyframes << " bone keyframes of " << ntracks << " tracks to " << estimateMemorySize() << " bytes");
+    return true;
+}
+
+void CompressedBoneAnimation::decompress(Array<BoneKeyframe *> &keyframes, IEncoding *encodingRef) const
+{
+    const int ntracks = m_context->tracks.count();
+    keyframes.reserve(keyframes.count() + m_context->nkeyframes);
+    IBoneKeyframe::InterpolationParameter parameter;
+    QuadWord *values[] = { &parameter.x, &parameter.y, &parameter.z, &parameter.rotation };
+    Vector3 position;
+    Quaternion rotation;
+    for (int i = 0; i < ntracks; i++) {
+        const PrivateContext::Track *track = m_context->tracks[i];
+        const PrivateContext::Checkpoint &checkpoint = m_context->checkpoints[track->checkpointOffset];
+        /* deltas of a track are stored contiguously from its first checkpoint */
+        const uint8 *ptr = m_context->timeIndexDeltas.count() > 0 ? &m_context->timeIndexDeltas[0] + checkpoint.deltaOffset : 0;
+        uint32 timeIndex = checkpoint.timeIndex;
+        for (int j = 0, nkeyframes = track->nkeyframes; j < nkeyframes; j++) {
+            if (j > 0) {
+                timeIndex += readVariableLength(ptr);
+            }
+            const PrivateContext::InterpolationParameter &p = m_context->parameters[m_context->parameterIds[track->keyframeOffset + j]];
+            for (int k = 0; k < kNumInterpolationTables; k++) {
+                values[k]->setValue(p.values[k * 4], p.values[k * 4 + 1], p.values[k * 4 + 2], p.values[k * 4 + 3]);
+            }
+            m_context->getKeyframe(track, j, position, rotation);
+            BoneKeyframe *keyframe = new BoneKeyframe(encodingRef);
+            keyframe->setName(track->name);
+            keyframe->setTimeIndex(IKeyframe::TimeIndex(timeIndex));
+            keyframe->setLocalTranslation(position);
+            keyframe->setLocalOrientation(rotation);
+            keyframe->setInterpolationParameters(parameter);
+            keyframes.append(keyframe);
+        }
+    }
+}
+
+void CompressedBoneAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
+{
+    if (m_context->modelRef) {
+        const int ntracks = m_context->tracks.count();
+        Vector3 position;
+        Quaternion rotation;
+        for (int i = 0; i < ntracks; i++) {
+            const PrivateContext::Track *track = m_context->tracks[i];
+            if (IBone *bone = track->boneRef) {
+                m_context->calculateKeyframes(timeIndexAt, track, position, rotation);
+                bone->setLocalTranslation(position);
+                bone->setLocalOrientation(rotation);
+            }
+        }
+        m_context->currentTimeIndex = timeIndexAt;
+    }
+}
+
+void CompressedBoneAnimation::reset()
+{
+    m_context->currentTimeIndex = 0;
+}
+
+void CompressedBoneAnimation::setParentModelRef(IModel *model)
+{
+    m_context->modelRef = model;
+    m_context->bindTracks();
+}
+
+vsize CompressedBoneAnimation::estimateMemorySize() const
+{
+    vsize size = sizeof(*m_context);
+    size += m_context->tracks.count() * (sizeof(PrivateContext::Track) + sizeof(PrivateContext::Track *));
+    size += m_context->checkpoints.count() * sizeof(PrivateContext::Checkpoint);
+    size += m_context->parameters.count() * sizeof(PrivateContext::InterpolationParameter);
+    size += m_context->tableValues.count() * sizeof(IKeyframe::SmoothPrecision);
+    size += m_context->timeIndexDeltas.count() * sizeof(uint8);
+    size += m_context->orientations.count() * sizeof(uint16);
+    size += m_context->translations.count() * sizeof(uint16);
+    size += m_context->parameterIds.count() * sizeof(uint16);
+    return size;
+}
+
+int CompressedBoneAnimation::countTracks() const
+{
+    return m_context->tracks.count();
+}
+
+int CompressedBoneAnimation::countKeyframes() const
+{
+    return m_context->nkeyframes;
+}
+
+int CompressedBoneAnimation::countInterpolationParameters() const
+{
+    return m_context->parameters.count();
+}
+
+Scalar CompressedBoneAnimation::maxTranslationError() const
+{
+    return m_context->maxTranslationError;
+}
+
+IModel *CompressedBoneAnimation::parentModelRef() const
+{
+    return m_context->modelRef;
+}
+
+IKeyframe::TimeIndex CompressedBoneAnimation::currentTimeIndex() const
+{
+    return m_context->currentTimeIndex;
+}
+
+IKeyframe::TimeIndex CompressedBoneAnimation::duration() const
+{
+    return m_context->durationTimeIndex;
+}
+
+Scalar CompressedBoneAnimation::maxOrientationError()
+{
+    /*
+     * each of the smallest three components is off by half of the quantization step at most,
+     * and the largest one (at least 0.5) by sum(|v| * error) / 0.5 derived from 1 - sum(v^2)
+     */
+    const Scalar &error = kSqrtHalf / kMaxQuantizedOrientation;
+    return error * (1 + 3 * kSqrtHalf * 2);
+}
+
+} /* namespace vmd */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
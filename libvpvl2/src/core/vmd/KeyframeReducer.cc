@@ -0,0 +1,557 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/MotionHelper.h"
+
+#include "vpvl2/vmd/BoneKeyframe.h"
+#include "vpvl2/vmd/KeyframeReducer.h"
+#include "vpvl2/vmd/MorphKeyframe.h"
+#include "vpvl2/vmd/Motion.h"
+
+#ifdef VPVL2_LINK_INTEL_TBB
+#include <tbb/tbb.h>
+#endif
+
+namespace
+{
+
+using namespace vpvl2;
+
+static const int kNumChannels = IBoneKeyframe::kMaxBoneInterpolationType;
+static const int kTableSize = vmd::BoneKeyframe::kTableSize;
+/* fitting starts from curves of control points on this grid whose tables are built once */
+static const uint8 kGridValues[] = { 0, 32, 64, 96, 127 };
+static const int kGridSize = sizeof(kGridValues) / sizeof(kGridValues[0]);
+static const int kMaxControlPointValue = 127;
+/* segments are extended over this number of failed fits to find a farther keyframe */
+static const int kMaxConsecutiveFailures = 8;
+/* each extension fits all samples of the segment again, so bound it to keep reducing linear */
+static const int kMaxSegmentLength = 256;
+
+struct Curve {
+    Curve()
+        : parameter(vmd::BoneKeyframe::kDefaultInterpolationParameterValue),
+          linear(true)
+    {
+    }
+    void build(const int *values) {
+        /* x1, y1, x2, y2 as BoneKeyframe::getInterpolationParameter */
+        parameter.setValue(Scalar(values[0]), Scalar(values[1]), Scalar(values[2]), Scalar(values[3]));
+        linear = values[0] == values[1] && values[2] == values[3];
+        if (!linear) {
+            IKeyframe::SmoothPrecision *ptr = table;
+            internal::InterpolationTable::build(values[0] / 127.0f, values[2] / 127.0f,
+                                                values[1] / 127.0f, values[3] / 127.0f, kTableSize, ptr);
+        }
+    }
+    inline IKeyframe::SmoothPrecision weight(const IKeyframe::SmoothPrecision &w) const {
+        if (linear) {
+            return w;
+        }
+        /* same as BoneAnimation::weightValue */
+        const uint16 index = static_cast<int16>(w * kTableSize);
+        return table[index] + (table[index + 1] - table[index]) * (w * kTableSize - index);
+    }
+    QuadWord parameter;
+    IKeyframe::SmoothPrecision table[kTableSize + 1];
+    bool linear;
+};
+
+static inline Scalar orientationDifference(const Quaternion &left, const Quaternion &right)
+{
+    return 2 * btAcos(btMin(btFabs(left.dot(right)), Scalar(1)));
+}
+
+} /* namespace anonymous */
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace vmd
+{
+
+struct KeyframeReducer::PrivateContext {
+    struct BoneTrack {
+        Array<BoneKeyframe *> keyframeRefs;
+        Array<IKeyframe::TimeIndex> timeIndices;
+        Array<Vector3> positions;
+        Array<Quaternion> rotations;
+        /* index of the kept keyframe and interpolation parameters of its four channels */
+        Array<int> keptIndices;
+        Array<QuadWord> keptParameters;
+    };
+    struct MorphTrack {
+        Array<MorphKeyframe *> keyframeRefs;
+        Array<IKeyframe::TimeIndex> timeIndices;
+        Array<IMorph::WeightPrecision> weights;
+        Array<int> keptIndices;
+    };
+    struct KeyframeTimeIndexPredication {
+        bool operator()(const IKeyframe *left, const IKeyframe *right) const {
+            return left->timeIndex() < right->timeIndex();
+        }
+    };
+
+    class ParallelReduceProcessor VPVL2_DECL_FINAL {
+    public:
+        ParallelReduceProcessor(const PrivateContext *context)
+            : m_contextRef(context)
+        {
+        }
+        ~ParallelReduceProcessor() {
+            m_contextRef = 0;
+        }
+
+        inline void performReduce(int i) const {
+            const int nboneTracks = m_contextRef->boneTracks.count();
+            if (i < nboneTracks) {
+                m_contextRef->reduceBoneTrack(m_contextRef->boneTracks[i]);
+            }
+            else {
+                m_contextRef->reduceMorphTrack(m_contextRef->morphTracks[i - nboneTracks]);
+            }
+        }
+#ifdef VPVL2_LINK_INTEL_TBB
+        void operator()(const tbb::blocked_range<int> &range) const {
+            for (int i = range.begin(), end = range.end(); i != end; ++i) {
+                performReduce(i);
+            }
+        }
+#endif /* VPVL2_LINK_INTEL_TBB */
+        void execute() {
+            const int ntracks = m_contextRef->boneTracks.count() + m_contextRef->morphTracks.count();
+#if defined(VPVL2_LINK_INTEL_TBB)
+            tbb::parallel_for(tbb::blocked_range<int>(0, ntracks, 1), *this);
+#else
+#ifdef VPVL2_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < ntracks; ++i) {
+                performReduce(i);
+            }
+#endif
+        }
+
+    private:
+        const PrivateContext *m_contextRef;
+    };
+
+    PrivateContext()
+        : translationTolerance(0.01f),
+          orientationTolerance(btRadians(0.1f)),
+          morphWeightTolerance(0.005f),
+          nsourceKeyframes(0),
+          nreducedKeyframes(0)
+    {
+    }
+    ~PrivateContext() {
+        boneTracks.releaseAll();
+        morphTracks.releaseAll();
+    }
+
+    void buildCurves() {
+        if (gridCurves.count() > 0) {
+            return;
+        }
+        gridCurves.resize(kGridSize * kGridSize * kGridSize * kGridSize);
+        int indices[4], values[4], offset = 0;
+        for (indices[0] = 0; indices[0] < kGridSize; indices[0]++) {
+            for (indices[1] = 0; indices[1] < kGridSize; indices[1]++) {
+                for (indices[2] = 0; indices[2] < kGridSize; indices[2]++) {
+                    for (indices[3] = 0; indices[3] < kGridSize; indices[3]++) {
+                        for (int i = 0; i < 4; i++) {
+                            values[i] = kGridValues[indices[i]];
+                        }
+                        gridCurves[offset++].build(values);
+                    }
+                }
+            }
+        }
+    }
+    static Scalar maxError(const Curve &curve, const Scalar &from, const Scalar &to, const Scalar *values,
+                           const IKeyframe::SmoothPrecision *weights, int nvalues, const Scalar &cutoff) {
+        Scalar error = 0;
+        for (int i = 0; i < nvalues && error < cutoff; i++) {
+            const Scalar &value = Scalar(internal::MotionHelper::lerp(from, to, curve.weight(weights[i])));
+            btSetMax(error, btFabs(value - values[i]));
+        }
+        return error;
+    }
+    bool fitCurve(const Scalar &from, const Scalar &to, const Scalar *values,
+                  const IKeyframe::SmoothPrecision *weights, int nvalues, const Scalar &tolerance, Curve &result) const {
+        /* linear first as most of keyframes of captured motions are linear */
+        result = Curve();
+        Scalar bestError = maxError(result, from, to, values, weights, nvalues, SIMD_INFINITY);
+        if (bestError <= tolerance) {
+            return true;
+        }
+        else if (btFuzzyZero(to - from)) {
+            /* no curve can move the value */
+            return false;
+        }
+        const int ncurves = gridCurves.count();
+        for (int i = 0; i < ncurves && bestError > tolerance; i++) {
+            const Curve &curve = gridCurves[i];
+            const Scalar &error = maxError(curve, from, to, values, weights, nvalues, bestError);
+            if (error < bestError) {
+                bestError = error;
+                result = curve;
+            }
+        }
+        /* descend to neighbor control points from the best curve of the grid */
+        int best[4], candidate[4];
+        for (int i = 0; i < 4; i++) {
+            best[i] = int(result.parameter[i]);
+        }
+        Curve curve;
+        for (int step = 16; step > 0 && bestError > tolerance; step /= 2) {
+            bool improved = true;
+            while (improved && bestError > tolerance) {
+                improved = false;
+                for (int i = 0; i < 4; i++) {
+                    for (int direction = -1; direction <= 1; direction += 2) {
+                        const int value = best[i] + direction * step;
+                        if (value < 0 || value > kMaxControlPointValue) {
+                            continue;
+                        }
+                        for (int j = 0; j < 4; j++) {
+                            candidate[j] = best[j];
+                        }
+                        candidate[i] = value;
+                        curve.build(candidate);
+                        const Scalar &error = maxError(curve, from, to, values, weights, nvalues, bestError);
+                        if (error < bestError) {
+                            bestError = error;
+                            best[i] = value;
+                            result = curve;
+                            improved = true;
+                        }
+                    }
+                }
+            }
+        }
+        return bestError <= tolerance;
+    }
+    bool fitBoneSegment(const BoneTrack *track, int from, int to, QuadWord *parameters,
+                        Array<IKeyframe::SmoothPrecision> &weights, Array<Scalar> &values) const {
+        const int nvalues = to - from - 1;
+        if (nvalues <= 0) {
+            const BoneKeyframe *keyframe = track->keyframeRefs[to];
+            for (int i = 0; i < kNumChannels; i++) {
+                keyframe->getInterpolationParameter(static_cast<IBoneKeyframe::InterpolationType>(i), parameters[i]);
+            }
+            return true;
+        }
+        weights.resize(nvalues);
+        values.resize(nvalues);
+        const IKeyframe::TimeIndex &timeIndexFrom = track->timeIndices[from], &timeIndexTo = track->timeIndices[to];
+        for (int i = 0; i < nvalues; i++) {
+            weights[i] = internal::MotionHelper::interpolateTimeIndex(track->timeIndices[from + i + 1], timeIndexFrom, timeIndexTo);
+        }
+        const Vector3 &positionFrom = track->positions[from], &positionTo = track->positions[to];
+        Curve curve;
+        for (int axis = 0; axis < 3; axis++) {
+            for (int i = 0; i < nvalues; i++) {
+                values[i] = track->positions[from + i + 1][axis];
+            }
+            if (!fitCurve(positionFrom[axis], positionTo[axis], &values[0], &weights[0], nvalues, translationTolerance, curve)) {
+                return false;
+            }
+            parameters[axis] = curve.parameter;
+        }
+        /* fit the angle along the arc then check the actual difference of slerp including off the arc */
+        const Quaternion &rotationFrom = track->rotations[from], &rotationTo = track->rotations[to];
+        for (int i = 0; i < nvalues; i++) {
+            values[i] = orientationDifference(rotationFrom, track->rotations[from + i + 1]);
+        }
+        if (!fitCurve(0, orientationDifference(rotationFrom, rotationTo), &values[0], &weights[0], nvalues, orientationTolerance, curve)) {
+            return false;
+        }
+        for (int i = 0; i < nvalues; i++) {
+            const Quaternion &rotation = rotationFrom.slerp(rotationTo, Scalar(curve.weight(weights[i])));
+            if (orientationDifference(rotation, track->rotations[from + i + 1]) > orientationTolerance) {
+                return false;
+            }
+        }
+        parameters[3] = curve.parameter;
+        return true;
+    }
+    void reduceBoneTrack(BoneTrack *track) const {
+        const int nkeyframes = track->keyframeRefs.count();
+        QuadWord parameters[kNumChannels], fittedParameters[kNumChannels];
+        Array<IKeyframe::SmoothPrecision> weights;
+        Array<Scalar> values;
+        int from = 0;
+        track->keptIndices.append(0);
+        for (int i = 0; i < kNumChannels; i++) {
+            track->keyframeRefs[0]->getInterpolationParameter(static_cast<IBoneKeyframe::InterpolationType>(i), fittedParameters[i]);
+            track->keptParameters.append(fittedParameters[i]);
+        }
+        while (from < nkeyframes - 1) {
+            int to = from + 1, nfailures = 0;
+            const int end = btMin(nkeyframes, from + kMaxSegmentLength + 1);
+            fitBoneSegment(track, from, to, fittedParameters, weights, values);
+            for (int next = to + 1; next < end && nfailures < kMaxConsecutiveFailures; next++) {
+                if (fitBoneSegment(track, from, next, parameters, weights, values)) {
+                    to = next;
+                    nfailures = 0;
+                    for (int i = 0; i < kNumChannels; i++) {
+                        fittedParameters[i] = parameters[i];
+                    }
+                }
+                else {
+                    nfailures++;
+                }
+            }
+            track->keptIndices.append(to);
+            for (int i = 0; i < kNumChannels; i++) {
+                track->keptParameters.append(fittedParameters[i]);
+            }
+            from = to;
+        }
+    }
+    void reduceMorphTrack(MorphTrack *track) const {
+        const int nkeyframes = track->keyframeRefs.count();
+        int from = 0;
+        track->keptIndices.append(0);
+        while (from < nkeyframes - 1) {
+            int to = from + 1, nfailures = 0;
+            const int end = btMin(nkeyframes, from + kMaxSegmentLength + 1);
+            for (int next = to + 1; next < end && nfailures < kMaxConsecutiveFailures; next++) {
+                const IKeyframe::TimeIndex &timeIndexFrom = track->timeIndices[from], &timeIndexTo = track->timeIndices[next];
+                const IMorph::WeightPrecision &weightFrom = track->weights[from], &weightTo = track->weights[next];
+                bool fitted = true;
+                for (int i = from + 1; i < next && fitted; i++) {
+                    const IKeyframe::SmoothPrecision &w = internal::MotionHelper::interpolateTimeIndex(track->timeIndices[i], timeIndexFrom, timeIndexTo);
+                    const IMorph::WeightPrecision &weight = internal::MotionHelper::lerp(weightFrom, weightTo, w);
+                    fitted = btFabs(Scalar(weight - track->weights[i])) <= morphWeightTolerance;
+                }
+                if (fitted) {
+                    to = next;
+                    nfailures = 0;
+                }
+                else {
+                    nfailures++;
+                }
+            }
+            track->keptIndices.append(to);
+            from = to;
+        }
+    }
+    template<typename TTrack, typename TKeyframe>
+    void buildTracks(const BaseAnimation &animation, PointerArray<TTrack> &tracks, Array<IKeyframe *> &untracked) {
+        Hash<HashString, TTrack *> name2tracks;
+        const int nkeyframes = animation.countKeyframes();
+        Array<IKeyframe *> keyframes;
+        animation.getAllKeyframes(keyframes);
+        for (int i = 0; i < nkeyframes; i++) {
+            TKeyframe *keyframe = static_cast<TKeyframe *>(keyframes[i]);
+            if (const IString *name = keyframe->name()) {
+                const HashString &key = name->toHashString();
+                TTrack *const *trackPtr = name2tracks.find(key);
+                TTrack *track = trackPtr ? *trackPtr : tracks.append(new TTrack());
+                if (!trackPtr) {
+                    name2tracks.insert(key, track);
+                }
+                track->keyframeRefs.append(keyframe);
+            }
+            else {
+                untracked.append(keyframe->clone());
+            }
+        }
+        const int ntracks = tracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            Array<TKeyframe *> &keyframeRefs = tracks[i]->keyframeRefs;
+            keyframeRefs.sort(KeyframeTimeIndexPredication());
+            /* only the last one of keyframes at the same time index is effective */
+            Array<TKeyframe *> uniqueKeyframeRefs;
+            const int nkeyframesOfTrack = keyframeRefs.count();
+            for (int j = 0; j < nkeyframesOfTrack; j++) {
+                if (j + 1 < nkeyframesOfTrack && keyframeRefs[j + 1]->timeIndex() == keyframeRefs[j]->timeIndex()) {
+                    continue;
+                }
+                uniqueKeyframeRefs.append(keyframeRefs[j]);
+            }
+            keyframeRefs.copy(uniqueKeyframeRefs);
+        }
+    }
+    void buildBoneTracks(const BaseAnimation &animation, Array<IKeyframe *> &untracked) {
+        buildTracks<BoneTrack, BoneKeyframe>(animation, boneTracks, untracked);
+        const int ntracks = boneTracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            BoneTrack *track = boneTracks[i];
+            const int nkeyframes = track->keyframeRefs.count();
+            track->timeIndices.reserve(nkeyframes);
+            track->positions.reserve(nkeyframes);
+            track->rotations.reserve(nkeyframes);
+            for (int j = 0; j < nkeyframes; j++) {
+                const BoneKeyframe *keyframe = track->keyframeRefs[j];
+                track->timeIndices.append(keyframe->timeIndex());
+                track->positions.append(keyframe->localTranslation());
+                track->rotations.append(keyframe->localOrientation());
+            }
+        }
+    }
+    void buildMorphTracks(const BaseAnimation &animation, Array<IKeyframe *> &untracked) {
+        buildTracks<MorphTrack, MorphKeyframe>(animation, morphTracks, untracked);
+        const int ntracks = morphTracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            MorphTrack *track = morphTracks[i];
+            const int nkeyframes = track->keyframeRefs.count();
+            track->timeIndices.reserve(nkeyframes);
+            track->weights.reserve(nkeyframes);
+            for (int j = 0; j < nkeyframes; j++) {
+                const MorphKeyframe *keyframe = track->keyframeRefs[j];
+                track->timeIndices.append(keyframe->timeIndex());
+                track->weights.append(keyframe->weight());
+            }
+        }
+    }
+    void collectBoneKeyframes(Array<IKeyframe *> &keyframes) const {
+        const int ntracks = boneTracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            const BoneTrack *track = boneTracks[i];
+            const int nkept = track->keptIndices.count();
+            for (int j = 0; j < nkept; j++) {
+                IBoneKeyframe *keyframe = track->keyframeRefs[track->keptIndices[j]]->clone();
+                for (int k = 0; k < kNumChannels; k++) {
+                    const QuadWord &parameter = track->keptParameters[j * kNumChannels + k];
+                    keyframe->setInterpolationParameter(static_cast<IBoneKeyframe::InterpolationType>(k), parameter);
+                }
+                keyframes.append(keyframe);
+            }
+        }
+    }
+    void collectMorphKeyframes(Array<IKeyframe *> &keyframes) const {
+        const int ntracks = morphTracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            const MorphTrack *track = morphTracks[i];
+            const int nkept = track->keptIndices.count();
+            for (int j = 0; j < nkept; j++) {
+                keyframes.append(track->keyframeRefs[track->keptIndices[j]]->clone());
+            }
+        }
+    }
+
+    Array<Curve> gridCurves;
+    PointerArray<BoneTrack> boneTracks;
+    PointerArray<MorphTrack> morphTracks;
+    Scalar translationTolerance;
+    Scalar orientationTolerance;
+    IMorph::WeightPrecision morphWeightTolerance;
+    int nsourceKeyframes;
+    int nreducedKeyframes;
+};
+
+KeyframeReducer::KeyframeReducer()
+    : m_context(new PrivateContext())
+{
+}
+
+KeyframeReducer::~KeyframeReducer()
+{
+    internal::deleteObject(m_context);
+}
+
+bool KeyframeReducer::reduce(Motion *motion)
+{
+    if (!motion || motion->isSharedInstance()) {
+        return false;
+    }
+    Array<IKeyframe *> boneKeyframes, morphKeyframes;
+    m_context->nsourceKeyframes = motion->countKeyframes(IKeyframe::kBoneKeyframe) + motion->countKeyframes(IKeyframe::kMorphKeyframe);
+    m_context->buildCurves();
+    m_context->buildBoneTracks(motion->boneAnimation(), boneKeyframes);
+    m_context->buildMorphTracks(motion->morphAnimation(), morphKeyframes);
+    PrivateContext::ParallelReduceProcessor processor(m_context);
+    processor.execute();
+    m_context->collectBoneKeyframes(boneKeyframes);
+    m_context->collectMorphKeyframes(morphKeyframes);
+    m_context->boneTracks.releaseAll();
+    m_context->morphTracks.releaseAll();
+    motion->setAllKeyframes(boneKeyframes, IKeyframe::kBoneKeyframe);
+    motion->setAllKeyframes(morphKeyframes, IKeyframe::kMorphKeyframe);
+    m_context->nreducedKeyframes = boneKeyframes.count() + morphKeyframes.count();
+    VPVL2_VLOG(1, "Reduced keyframes from " << m_context->nsourceKeyframes << " to " << m_context->nreducedKeyframes);
+    return true;
+}
+
+int KeyframeReducer::countSourceKeyframes() const
+{
+    return m_context->nsourceKeyframes;
+}
+
+int KeyframeReducer::countReducedKeyframes() const
+{
+    return m_context->nreducedKeyframes;
+}
+
+Scalar KeyframeReducer::translationTolerance() const
+{
+    return m_context->translationTolerance;
+}
+
+Scalar KeyframeReducer::orientationTolerance() const
+{
+    return m_context->orientationTolerance;
+}
+
+IMorph::WeightPrecision KeyframeReducer::morphWeightTolerance() const
+{
+    return m_context->morphWeightTolerance;
+}
+
+void KeyframeReducer::setTranslationTolerance(const Scalar &value)
+{
+    m_context->translationTolerance = value;
+}
+
+void KeyframeReducer::setOrientationTolerance(const Scalar &value)
+{
+    m_context->orientationTolerance = value;
+}
+
+void KeyframeReducer::setMorphWeightTolerance(const IMorph::WeightPrecision &value)
+{
+    m_context->morphWeightTolerance = value;
+}
+
+} /* namespace vmd */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
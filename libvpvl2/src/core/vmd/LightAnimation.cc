@@ -80,7 +80,7 @@ void LightAnimation::read(const uint8 *data, int size)
 void LightAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
 {
     int fromIndex, toIndex;
-    internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, m_keyframes);
+    internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, keyframeRefs());
     const LightKeyframe *keyframeFrom = findKeyframeAt(fromIndex), *keyframeTo = findKeyframeAt(toIndex);
     const IKeyframe::TimeIndex &timeIndexFrom = keyframeFrom->timeIndex(), timeIndexTo = keyframeTo->timeIndex();
     const Vector3 &colorFrom = keyframeFrom->color(), &directionFrom = keyframeFrom->direction();
@@ -109,27 +109,15 @@ void LightAnimation::createFirstKeyframeUnlessFound()
     }
 }
 
-void LightAnimation::update()
-{
-    int nkeyframes = m_keyframes.count();
-    if (nkeyframes > 0) {
-        m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
-        m_durationTimeIndex = m_keyframes[m_keyframes.count() - 1]->timeIndex();
-    }
-    else {
-        m_durationTimeIndex = 0;
-    }
-}
-
 LightKeyframe *LightAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex) const
 {
-    int index = findKeyframeIndex(timeIndex, m_keyframes);
-    return index != -1 ? reinterpret_cast<LightKeyframe *>(m_keyframes[index]) : 0;
+    int index = findKeyframeIndex(timeIndex, keyframeRefs());
+    return index != -1 ? reinterpret_cast<LightKeyframe *>(keyframeRefs()[index]) : 0;
 }
 
 LightKeyframe *LightAnimation::findKeyframeAt(int i) const
 {
-    return internal::checkBound(i, 0, m_keyframes.count()) ? reinterpret_cast<LightKeyframe *>(m_keyframes[i]) : 0;
+    return internal::checkBound(i, 0, keyframeRefs().count()) ? reinterpret_cast<LightKeyframe *>(keyframeRefs()[i]) : 0;
 }
 
 } /* namespace vmd */
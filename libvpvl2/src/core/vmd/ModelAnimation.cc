@@ -74,9 +74,9 @@ void ModelAnimation::read(const uint8 *data, int size)
 
 void ModelAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
 {
-    if (m_modelRef && m_keyframes.count() > 0) {
+    if (m_modelRef && countKeyframes() > 0) {
         int fromIndex, toIndex;
-        internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, m_keyframes);
+        internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, keyframeRefs());
         const ModelKeyframe *keyframeFrom = findKeyframeAt(fromIndex);
         keyframeFrom->updateInverseKinematics(m_modelRef);
         m_modelRef->setVisible(keyframeFrom->isVisible());
@@ -100,24 +100,13 @@ void ModelAnimation::setParentModelRef(IModel *model)
     m_modelRef = model;
 }
 
-void ModelAnimation::update()
-{
-    int nkeyframes = m_keyframes.count();
-    if (nkeyframes > 0) {
-        m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
-        m_durationTimeIndex = m_keyframes[m_keyframes.count() - 1]->timeIndex();
-    }
-    else {
-        m_durationTimeIndex = 0;
-    }
-}
-
 vsize ModelAnimation::estimateSize() const
 {
     vsize size = 0;
-    const int nkeyframes = m_keyframes.count();
+    const Array<IKeyframe *> &keyframes = keyframeRefs();
+    const int nkeyframes = keyframes.count();
     for (int i = 0; i < nkeyframes; i++) {
-        IKeyframe *keyframe = m_keyframes[i];
+        IKeyframe *keyframe = keyframes[i];
         size += keyframe->estimateSize();
     }
     return size;
@@ -125,13 +114,13 @@ vsize ModelAnimation::estimateSize() const
 
 ModelKeyframe *ModelAnimation::findKeyframeAt(int i) const
 {
-    return internal::checkBound(i, 0, m_keyframes.count()) ? reinterpret_cast<ModelKeyframe *>(m_keyframes[i]) : 0;
+    return internal::checkBound(i, 0, keyframeRefs().count()) ? reinterpret_cast<ModelKeyframe *>(keyframeRefs()[i]) : 0;
 }
 
 ModelKeyframe *ModelAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex) const
 {
-    int index = findKeyframeIndex(timeIndex, m_keyframes);
-    return index != -1 ? reinterpret_cast<ModelKeyframe *>(m_keyframes[index]) : 0;
+    int index = findKeyframeIndex(timeIndex, keyframeRefs());
+    return index != -1 ? reinterpret_cast<ModelKeyframe *>(keyframeRefs()[index]) : 0;
 }
 
 } /* namespace vmd */
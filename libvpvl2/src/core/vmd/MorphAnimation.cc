@@ -38,6 +38,7 @@
 */
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/MotionHelper.h"
 
 #include "vpvl2/vmd/MorphAnimation.h"
@@ -50,12 +51,29 @@ namespace VPVL2_VERSION_NS
 namespace vmd
 {
 
-struct MorphAnimation::PrivateContext {
-    IMorph *morph;
+struct MorphAnimation::Track {
+    Track(const IString *name, int index)
+        : name(name->clone()),
+          index(index),
+          sorted(true)
+    {
+    }
+    ~Track() {
+        internal::deleteObject(name);
+    }
+
+    /* owns the key of m_name2tracks as keyframes referring the name may be deleted first */
+    IString *name;
     Array<MorphKeyframe *> keyframeRefs;
-    IMorph::WeightPrecision weight;
-    int lastIndex;
+    int index;
+    bool sorted;
 
+    void sortKeyframes() {
+        if (!sorted) {
+            keyframeRefs.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+            sorted = true;
+        }
+    }
     bool isNull() const {
         if (keyframeRefs.count() == 1) {
             const MorphKeyframe *keyframe = keyframeRefs[0];
@@ -65,9 +83,31 @@ struct MorphAnimation::PrivateContext {
     }
 };
 
+struct MorphAnimation::PrivateContext {
+    PrivateContext(const Track *trackRef)
+        : trackRef(trackRef),
+          morph(0),
+          weight(0),
+          lastIndex(0)
+    {
+    }
+    ~PrivateContext() {
+        trackRef = 0;
+        morph = 0;
+    }
+
+    const Track *trackRef;
+    IMorph *morph;
+    IMorph::WeightPrecision weight;
+    int lastIndex;
+};
+
 MorphAnimation::MorphAnimation(IEncoding *encoding)
     : BaseAnimation(),
       m_encodingRef(encoding),
+      m_tracksRevision(0),
+      m_contextsRevision(0),
+      m_bindingCache(new internal::ModelBindingCache<IMorph>()),
       m_modelRef(0),
       m_enableNullFrame(false)
 {
@@ -75,7 +115,9 @@ MorphAnimation::MorphAnimation(IEncoding *encoding)
 
 MorphAnimation::~MorphAnimation()
 {
-    m_name2contexts.releaseAll();
+    m_contexts.releaseAll();
+    m_name2tracks.releaseAll();
+    internal::deleteObject(m_bindingCache);
     m_modelRef = 0;
 }
 
@@ -93,14 +135,20 @@ void MorphAnimation::read(const uint8 *data, int size)
 void MorphAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
 {
     if (m_modelRef) {
-        const int ncontexts = m_name2contexts.count();
+        /* tracks of instances are sorted by the shared animation */
+        const int ntracks = m_name2tracks.count();
+        for (int i = 0; i < ntracks; i++) {
+            Track *track = *m_name2tracks.value(i);
+            track->sortKeyframes();
+        }
+        const int ncontexts = m_contexts.count();
         for (int i = 0; i < ncontexts; i++) {
-            PrivateContext *context = *m_name2contexts.value(i);
-            if (m_enableNullFrame && context->isNull()) {
+            PrivateContext *context = m_contexts[i];
+            IMorph *morph = context->morph;
+            if (!morph || (m_enableNullFrame && context->trackRef->isNull())) {
                 continue;
             }
             calculateFrames(timeIndexAt, context);
-            IMorph *morph = context->morph;
             morph->setWeight(context->weight);
         }
         m_previousTimeIndex = m_currentTimeIndex;
@@ -118,82 +166,247 @@ void MorphAnimation::createFirstKeyframeUnlessFound()
             const IMorph *morph = morphs[i];
             const IString *name = morph->name(IEncoding::kDefaultLanguage);
             if (name && name->size() > 0 && !findKeyframe(0, name)) {
-                MorphKeyframe *keyframe = m_keyframes.append(new MorphKeyframe(m_encodingRef));
+                MorphKeyframe *keyframe = new MorphKeyframe(m_encodingRef);
                 keyframe->setName(name);
                 keyframe->setTimeIndex(0);
                 keyframe->setWeight(0);
-                m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
+                addKeyframe(keyframe);
             }
         }
     }
 }
 
+void MorphAnimation::update()
+{
+    updateTracks();
+    if (m_contextsRevision != tracksOwnerRef()->m_tracksRevision) {
+        createPrivateContexts();
+    }
+    else {
+        updateDurationTimeIndex();
+    }
+    updateKeyframeBuckets();
+}
+
+void MorphAnimation::addKeyframe(IKeyframe *keyframe)
+{
+    const bool indexed = m_numIndexedKeyframes == m_keyframes.count();
+    m_keyframes.append(keyframe);
+    addKeyframeToBucket(keyframe);
+    if (indexed) {
+        MorphKeyframe *morphKeyframe = static_cast<MorphKeyframe *>(keyframe);
+        const bool bound = m_contextsRevision == m_tracksRevision;
+        if (Track *track = resolveTrack(morphKeyframe->name())) {
+            if (!internal::MotionHelper::appendKeyframe(morphKeyframe, track->keyframeRefs)) {
+                /* sorted once on next seek or update instead of shifting the track on each addition */
+                track->sorted = false;
+            }
+            if (bound && m_contextsRevision != m_tracksRevision) {
+                /* a new track is always appended to the last of m_name2tracks */
+                PrivateContext *context = m_contexts.append(new PrivateContext(track));
+                context->morph = m_modelRef ? m_modelRef->findMorphRef(track->name) : 0;
+                m_contextsRevision = m_tracksRevision;
+                m_bindingCache->clear();
+            }
+            if (m_contextsRevision == m_tracksRevision && m_contexts[track->index]->morph) {
+                btSetMax(m_durationTimeIndex, morphKeyframe->timeIndex());
+            }
+        }
+        m_numIndexedKeyframes++;
+    }
+}
+
+void MorphAnimation::removeKeyframe(IKeyframe *keyframe)
+{
+    const int nkeyframes = m_keyframes.count();
+    const bool indexed = m_numIndexedKeyframes == nkeyframes;
+    if (!internal::MotionHelper::removeKeyframeSorted(keyframe, m_keyframes)) {
+        return;
+    }
+    removeKeyframeFromBucket(keyframe);
+    if (!indexed) {
+        return;
+    }
+    m_numIndexedKeyframes--;
+    const IString *name = keyframe->name();
+    Track *const *trackPtr = name ? m_name2tracks.find(name->toHashString()) : 0;
+    if (trackPtr && internal::MotionHelper::removeKeyframeSorted(keyframe, (*trackPtr)->keyframeRefs)) {
+        Track *track = *trackPtr;
+        if (track->keyframeRefs.count() == 0) {
+            const bool bound = m_contextsRevision == m_tracksRevision;
+            const int index = track->index;
+            /* both of m_name2tracks and m_contexts move the last item to the removed position */
+            m_name2tracks.remove(name->toHashString());
+            if (index < m_name2tracks.count()) {
+                (*m_name2tracks.value(index))->index = index;
+            }
+            m_tracksRevision++;
+            if (bound) {
+                PrivateContext *context = m_contexts[index];
+                m_contexts.removeAt(index);
+                internal::deleteObject(context);
+                m_contextsRevision = m_tracksRevision;
+            }
+            /* track ids are positions in m_name2tracks, so cached bindings are stale now */
+            m_bindingCache->clear();
+            internal::deleteObject(track);
+        }
+        if (keyframe->timeIndex() >= m_durationTimeIndex) {
+            updateTracks();
+            updateDurationTimeIndex();
+        }
+    }
+    else {
+        /* not indexed by its current name (renamed in place?), rebuild the track index on next update */
+        m_numIndexedKeyframes = -1;
+    }
+}
+
 void MorphAnimation::setParentModelRef(IModel *model)
 {
-    createPrivateContexts(model);
     m_modelRef = model;
+    updateTracks();
+    if (m_contextsRevision != tracksOwnerRef()->m_tracksRevision) {
+        createPrivateContexts();
+    }
+    else {
+        bindPrivateContexts();
+    }
 }
 
-void MorphAnimation::createPrivateContexts(const IModel *model)
+const MorphAnimation *MorphAnimation::tracksOwnerRef() const
 {
-    if (model) {
+    /* instances refer tracks of the shared animation instead of building their own */
+    return m_sharedAnimationRef ? static_cast<const MorphAnimation *>(m_sharedAnimationRef) : this;
+}
+
+void MorphAnimation::updateTracks()
+{
+    if (m_sharedAnimationRef) {
+        return;
+    }
+    else if (m_numIndexedKeyframes != m_keyframes.count()) {
         const int nkeyframes = m_keyframes.count();
-        m_name2contexts.releaseAll();
-        m_durationTimeIndex = 0;
+        m_name2tracks.releaseAll();
         // Build internal node to find by name, not frame index
         for (int i = 0; i < nkeyframes; i++) {
             MorphKeyframe *keyframe = reinterpret_cast<MorphKeyframe *>(m_keyframes.at(i));
-            const IString *name = keyframe->name();
-            const HashString &key = name->toHashString();
-            PrivateContext **ptr = m_name2contexts[key], *context;
-            if (ptr) {
-                context = *ptr;
-                context->keyframeRefs.append(keyframe);
-            }
-            else if (IMorph *morph = model->findMorphRef(name)) {
-                PrivateContext *context = m_name2contexts.insert(key, new PrivateContext());
-                context->keyframeRefs.append(keyframe);
-                context->morph = morph;
-                context->lastIndex = 0;
-                context->weight = 0.0f;
+            if (Track *track = resolveTrack(keyframe->name())) {
+                track->keyframeRefs.append(keyframe);
+                track->sorted = false;
             }
         }
-        // Sort frames from each internal nodes by frame index ascend
-        const int ncontexts = m_name2contexts.count();
+        m_numIndexedKeyframes = nkeyframes;
+        m_tracksRevision++;
+    }
+    // Sort frames from each internal nodes by frame index ascend
+    const int ntracks = m_name2tracks.count();
+    for (int i = 0; i < ntracks; i++) {
+        /* keyframes may be retimed in place, so only sort tracks whose order is actually broken */
+        Track *track = *m_name2tracks.value(i);
+        track->sorted = track->sorted && internal::MotionHelper::isKeyframesSorted(track->keyframeRefs);
+        track->sortKeyframes();
+    }
+}
+
+void MorphAnimation::createPrivateContexts()
+{
+    const MorphAnimation *owner = tracksOwnerRef();
+    const int ntracks = owner->m_name2tracks.count();
+    m_contexts.releaseAll();
+    m_contexts.reserve(ntracks);
+    for (int i = 0; i < ntracks; i++) {
+        m_contexts.append(new PrivateContext(*owner->m_name2tracks.value(i)));
+    }
+    m_contextsRevision = owner->m_tracksRevision;
+    /* track ids are positions in m_name2tracks, so cached bindings are stale now */
+    m_bindingCache->clear();
+    bindPrivateContexts();
+}
+
+void MorphAnimation::bindPrivateContexts()
+{
+    const int ncontexts = m_contexts.count();
+    if (m_modelRef) {
+        Array<const IString *> names;
+        names.reserve(ncontexts);
         for (int i = 0; i < ncontexts; i++) {
-            PrivateContext *context = *m_name2contexts.value(i);
-            Array<MorphKeyframe *> &keyframeRefs = context->keyframeRefs;
-            keyframeRefs.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
-            btSetMax(m_durationTimeIndex, keyframeRefs[keyframeRefs.count() - 1]->timeIndex());
+            names.append(m_contexts[i]->trackRef->name);
+        }
+        /* morphs are resolved once per model and reused while swapping models */
+        const Array<IMorph *> &morphRefs = m_bindingCache->resolve(m_modelRef, names);
+        for (int i = 0; i < ncontexts; i++) {
+            PrivateContext *context = m_contexts[i];
+            context->morph = morphRefs[i];
         }
     }
+    else {
+        for (int i = 0; i < ncontexts; i++) {
+            PrivateContext *context = m_contexts[i];
+            context->morph = 0;
+        }
+    }
+    updateDurationTimeIndex();
+}
+
+MorphAnimation::Track *MorphAnimation::resolveTrack(const IString *name)
+{
+    if (Track *const *ptr = m_name2tracks.find(name->toHashString())) {
+        return *ptr;
+    }
+    Track *track = new Track(name, m_name2tracks.count());
+    m_tracksRevision++;
+    return m_name2tracks.insert(track->name->toHashString(), track);
+}
+
+void MorphAnimation::updateDurationTimeIndex()
+{
+    m_durationTimeIndex = 0;
+    const int ncontexts = m_contexts.count();
+    for (int i = 0; i < ncontexts; i++) {
+        const PrivateContext *context = m_contexts[i];
+        if (!context->morph) {
+            continue;
+        }
+        const Array<MorphKeyframe *> &keyframeRefs = context->trackRef->keyframeRefs;
+        btSetMax(m_durationTimeIndex, keyframeRefs[keyframeRefs.count() - 1]->timeIndex());
+    }
 }
 
 void MorphAnimation::reset()
 {
     BaseAnimation::reset();
-    const int ncontexts = m_name2contexts.count();
+    const int ncontexts = m_contexts.count();
     for (int i = 0; i < ncontexts; i++) {
-        PrivateContext *context = *m_name2contexts.value(i);
+        PrivateContext *context = m_contexts[i];
         context->lastIndex = 0;
     }
 }
 
 MorphKeyframe *MorphAnimation::findKeyframeAt(int i) const
 {
-    return internal::checkBound(i, 0, m_keyframes.count()) ? reinterpret_cast<MorphKeyframe *>(m_keyframes[i]) : 0;
+    return internal::checkBound(i, 0, countKeyframes()) ? reinterpret_cast<MorphKeyframe *>(keyframeRefs()[i]) : 0;
 }
 
 MorphKeyframe *MorphAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex, const IString *name) const
 {
     if (name) {
         const HashString &key = name->toHashString();
-        PrivateContext *const *ptr = m_name2contexts.find(key);
-        if (ptr) {
-            const PrivateContext *context = *ptr;
-            const Array<MorphKeyframe *> &keyframeRefs = context->keyframeRefs;
-            int index = findKeyframeIndex(timeIndex, keyframeRefs);
-            return index != -1 ? keyframeRefs[index] : 0;
+        if (const Track *const *ptr = tracksOwnerRef()->m_name2tracks.find(key)) {
+            const Track *track = *ptr;
+            const Array<MorphKeyframe *> &keyframeRefs = track->keyframeRefs;
+            if (track->sorted) {
+                int index = findKeyframeIndex(timeIndex, keyframeRefs);
+                return index != -1 ? keyframeRefs[index] : 0;
+            }
+            /* the track is sorted on next seek or update, lookups never modify tracks */
+            const int nkeyframes = keyframeRefs.count();
+            for (int i = 0; i < nkeyframes; i++) {
+                MorphKeyframe *keyframe = keyframeRefs[i];
+                if (keyframe->timeIndex() == timeIndex) {
+                    return keyframe;
+                }
+            }
         }
     }
     else {
@@ -204,7 +417,11 @@ MorphKeyframe *MorphAnimation::findKeyframe(const IKeyframe::TimeIndex &timeInde
 
 void MorphAnimation::calculateFrames(const IKeyframe::TimeIndex &timeIndexAt, PrivateContext *context)
 {
-    const Array<MorphKeyframe *> &keyframes = context->keyframeRefs;
+    const Array<MorphKeyframe *> &keyframes = context->trackRef->keyframeRefs;
+    if (context->lastIndex >= keyframes.count()) {
+        /* the track may be shrunk since the last seek */
+        context->lastIndex = 0;
+    }
     int fromIndex, toIndex;
     internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, context->lastIndex, fromIndex, toIndex, keyframes);
     const MorphKeyframe *keyframeFrom = keyframes.at(fromIndex), *keyframeTo = keyframes.at(toIndex);
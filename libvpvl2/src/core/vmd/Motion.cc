@@ -44,6 +44,7 @@
 #include "vpvl2/vmd/BoneKeyframe.h"
 #include "vpvl2/vmd/CameraAnimation.h"
 #include "vpvl2/vmd/CameraKeyframe.h"
+#include "vpvl2/vmd/CompressedBoneAnimation.h"
 #include "vpvl2/vmd/LightAnimation.h"
 #include "vpvl2/vmd/LightKeyframe.h"
 #include "vpvl2/vmd/ModelAnimation.h"
@@ -68,12 +69,15 @@ struct Motion::PrivateContext {
         : motionPtr(0),
           parentSceneRef(0),
           parentModelRef(modelRef),
+          sharedContextRef(0),
           encodingRef(encodingRef),
           name(0),
+          compressedBoneMotion(0),
           boneMotion(encodingRef),
           morphMotion(encodingRef),
           modelMotion(modelRef, encodingRef),
           error(kNoError),
+          numRefs(1),
           active(true)
     {
         type2animationRefs.insert(IKeyframe::kBoneKeyframe, &boneMotion);
@@ -110,10 +114,52 @@ struct Motion::PrivateContext {
     void parseModelKeyframes(const Motion::DataInfo &info) {
         modelMotion.read(info.modelKeyframePtr, info.modelKeyframeCount);
     }
+    static void releaseRef(PrivateContext *&context) {
+        /* keyframes of the source motion are kept alive until all of the instances are deleted */
+        if (--context->numRefs == 0) {
+            internal::deleteObject(context);
+        }
+        context = 0;
+    }
+    void shareAnimations(PrivateContext *source) {
+        boneMotion.shareKeyframes(&source->boneMotion);
+        cameraMotion.shareKeyframes(&source->cameraMotion);
+        morphMotion.shareKeyframes(&source->morphMotion);
+        lightMotion.shareKeyframes(&source->lightMotion);
+        modelMotion.shareKeyframes(&source->modelMotion);
+        projectMotion.shareKeyframes(&source->projectMotion);
+        sharedContextRef = source;
+        source->numRefs++;
+    }
+    bool isEditable() const {
+        if (sharedContextRef) {
+            VPVL2_LOG(WARNING, "Keyframes of the shared motion instance cannot be modified, modify the source motion instead");
+            return false;
+        }
+        return true;
+    }
+    bool isCompacted(IKeyframe::Type type) const {
+        if (type == IKeyframe::kBoneKeyframe && compressedBoneMotion) {
+            VPVL2_LOG(WARNING, "Compacted bone keyframes cannot be modified, load the motion again instead");
+            return true;
+        }
+        return false;
+    }
+    bool isRemovable() const {
+        if (!isEditable()) {
+            return false;
+        }
+        else if (numRefs > 1) {
+            VPVL2_LOG(WARNING, "Keyframes shared with motion instances cannot be removed, delete the instances first");
+            return false;
+        }
+        return true;
+    }
     void release() {
         /* retain model reference */
         internal::deleteObject(name);
         internal::deleteObject(motionPtr);
+        internal::deleteObject(compressedBoneMotion);
         parentSceneRef = 0;
         motionPtr = 0;
         error = kNoError;
@@ -123,8 +169,10 @@ struct Motion::PrivateContext {
     IMotion *motionPtr;
     Scene *parentSceneRef;
     IModel *parentModelRef;
+    PrivateContext *sharedContextRef;
     IEncoding *encodingRef;
     IString *name;
+    CompressedBoneAnimation *compressedBoneMotion;
     Motion::DataInfo dataInfo;
     BoneAnimation boneMotion;
     CameraAnimation cameraMotion;
@@ -134,6 +182,7 @@ struct Motion::PrivateContext {
     ProjectAnimation projectMotion;
     Hash<HashInt, BaseAnimation *> type2animationRefs;
     Motion::Error error;
+    int numRefs;
     bool active;
 };
 
@@ -146,7 +195,11 @@ Motion::Motion(IModel *modelRef, IEncoding *encodingRef)
 
 Motion::~Motion()
 {
-    internal::deleteObject(m_context);
+    PrivateContext *sharedContext = m_context->sharedContextRef;
+    PrivateContext::releaseRef(m_context);
+    if (sharedContext) {
+        PrivateContext::releaseRef(sharedContext);
+    }
 }
 
 bool Motion::preparse(const uint8 *data, vsize size, DataInfo &info)
@@ -289,7 +342,10 @@ bool Motion::load(const uint8 *data, vsize size)
 {
     DataInfo info;
     internal::zerofill(&info, sizeof(info));
-    if (preparse(data, size, info)) {
+    if (!m_context->isRemovable()) {
+        return false;
+    }
+    else if (preparse(data, size, info)) {
         m_context->release();
         m_context->parseHeader(info);
         m_context->parseBoneKeyframes(info);
@@ -308,12 +364,26 @@ void Motion::save(uint8 *data) const
 {
     internal::writeBytes(kSignature, kSignatureSize, data);
     internal::writeStringAsByteArray(m_context->name, m_context->encodingRef, IString::kShiftJIS, kNameSize, data);
-    int32 nBoneKeyframes = m_context->boneMotion.countKeyframes();
-    internal::writeBytes(&nBoneKeyframes, sizeof(nBoneKeyframes), data);
-    for (int32 i = 0; i < nBoneKeyframes; i++) {
-        BoneKeyframe *keyframe = m_context->boneMotion.findKeyframeAt(i);
-        keyframe->write(data);
-        data += BoneKeyframe::strideSize();
+    if (const CompressedBoneAnimation *compressedBoneMotion = m_context->compressedBoneMotion) {
+        /* compacted bone keyframes are written within the quantization error */
+        PointerArray<BoneKeyframe> keyframes;
+        compressedBoneMotion->decompress(keyframes, m_context->encodingRef);
+        int32 nBoneKeyframes = keyframes.count();
+        internal::writeBytes(&nBoneKeyframes, sizeof(nBoneKeyframes), data);
+        for (int32 i = 0; i < nBoneKeyframes; i++) {
+            keyframes[i]->write(data);
+            data += BoneKeyframe::strideSize();
+        }
+        keyframes.releaseAll();
+    }
+    else {
+        int32 nBoneKeyframes = m_context->boneMotion.countKeyframes();
+        internal::writeBytes(&nBoneKeyframes, sizeof(nBoneKeyframes), data);
+        for (int32 i = 0; i < nBoneKeyframes; i++) {
+            BoneKeyframe *keyframe = m_context->boneMotion.findKeyframeAt(i);
+            keyframe->write(data);
+            data += BoneKeyframe::strideSize();
+        }
     }
     int32 nMorphKeyframes = m_context->morphMotion.countKeyframes();
     internal::writeBytes(&nMorphKeyframes, sizeof(nMorphKeyframes), data);
@@ -338,14 +408,13 @@ void Motion::save(uint8 *data) const
     }
     int32 emptyShadowKeyframes = 0;
     internal::writeBytes(&emptyShadowKeyframes, sizeof(emptyShadowKeyframes), data);
+    /* the count is always written as estimateSize counts it */
     int32 nModelKeyframes = m_context->modelMotion.countKeyframes();
-    if (nModelKeyframes > 0) {
-        internal::writeBytes(&nModelKeyframes, sizeof(nModelKeyframes), data);
-        for (int32 i = 0; i < nModelKeyframes; i++) {
-            ModelKeyframe *keyframe = m_context->modelMotion.findKeyframeAt(i);
-            keyframe->write(data);
-            data += keyframe->estimateSize();
-        }
+    internal::writeBytes(&nModelKeyframes, sizeof(nModelKeyframes), data);
+    for (int32 i = 0; i < nModelKeyframes; i++) {
+        ModelKeyframe *keyframe = m_context->modelMotion.findKeyframeAt(i);
+        keyframe->write(data);
+        data += keyframe->estimateSize();
     }
 }
 
@@ -361,8 +430,10 @@ vsize Motion::estimateSize() const
      * selfshadow size
      * model size
      */
+    const CompressedBoneAnimation *compressedBoneMotion = m_context->compressedBoneMotion;
+    const int nBoneKeyframes = compressedBoneMotion ? compressedBoneMotion->countKeyframes() : m_context->boneMotion.countKeyframes();
     return kSignatureSize + kNameSize + sizeof(int32) * 6
-            + m_context->boneMotion.countKeyframes() * BoneKeyframe::strideSize()
+            + nBoneKeyframes * BoneKeyframe::strideSize()
             + m_context->morphMotion.countKeyframes() * MorphKeyframe::strideSize()
             + m_context->cameraMotion.countKeyframes() * CameraKeyframe::strideSize()
             + m_context->lightMotion.countKeyframes() * LightKeyframe::strideSize()
@@ -380,6 +451,9 @@ void Motion::setParentModelRef(IModel *value)
     m_context->boneMotion.setParentModelRef(value);
     m_context->morphMotion.setParentModelRef(value);
     m_context->modelMotion.setParentModelRef(value);
+    if (m_context->compressedBoneMotion) {
+        m_context->compressedBoneMotion->setParentModelRef(value);
+    }
     m_context->parentModelRef = value;
     if (value) {
         if (const IString *name = value->name(IEncoding::kDefaultLanguage)) {
@@ -400,7 +474,12 @@ void Motion::seekSceneSeconds(const float64 &seconds, Scene *scene)
 
 void Motion::seekTimeIndex(const IKeyframe::TimeIndex &timeIndex)
 {
-    m_context->boneMotion.seek(timeIndex);
+    if (m_context->compressedBoneMotion) {
+        m_context->compressedBoneMotion->seek(timeIndex);
+    }
+    else {
+        m_context->boneMotion.seek(timeIndex);
+    }
     m_context->morphMotion.seek(timeIndex);
     m_context->modelMotion.seek(timeIndex);
     m_context->active = durationTimeIndex() > timeIndex;
@@ -437,6 +516,10 @@ void Motion::reset()
     m_context->boneMotion.reset();
     m_context->morphMotion.reset();
     m_context->projectMotion.reset();
+    if (m_context->compressedBoneMotion) {
+        m_context->compressedBoneMotion->seek(0);
+        m_context->compressedBoneMotion->reset();
+    }
     m_context->active = true;
 }
 
@@ -454,12 +537,18 @@ IKeyframe::TimeIndex Motion::durationTimeIndex() const
     btSetMax(duration, m_context->morphMotion.duration());
     btSetMax(duration, m_context->modelMotion.duration());
     btSetMax(duration, m_context->projectMotion.duration());
+    if (m_context->compressedBoneMotion) {
+        btSetMax(duration, m_context->compressedBoneMotion->duration());
+    }
     return duration;
 }
 
 bool Motion::isReachedTo(const IKeyframe::TimeIndex &atEnd) const
 {
     if (m_context->active) {
+        if (m_context->compressedBoneMotion && !internal::MotionHelper::isReachedToDuration(*m_context->compressedBoneMotion, atEnd)) {
+            return false;
+        }
         return internal::MotionHelper::isReachedToDuration(m_context->boneMotion, atEnd) &&
                 internal::MotionHelper::isReachedToDuration(m_context->cameraMotion, atEnd) &&
                 internal::MotionHelper::isReachedToDuration(m_context->lightMotion, atEnd) &&
@@ -520,7 +609,7 @@ IProjectKeyframe *Motion::createProjectKeyframe()
 
 void Motion::addKeyframe(IKeyframe *value)
 {
-    if (!value || value->layerIndex() != 0) {
+    if (!value || value->layerIndex() != 0 || !m_context->isEditable() || m_context->isCompacted(value->type())) {
         return;
     }
     if (BaseAnimation *const *animationPtr = m_context->type2animationRefs.find(value->type())) {
@@ -535,6 +624,9 @@ void Motion::replaceKeyframe(IKeyframe *value, bool alsoDelete)
         VPVL2_LOG(WARNING, "null keyframe cannot be replaced");
         return;
     }
+    else if (!m_context->isRemovable() || m_context->isCompacted(value->type())) {
+        return;
+    }
     IKeyframe *keyframeToDelete = 0;
     switch (value->type()) {
     case IKeyframe::kBoneKeyframe: {
@@ -572,9 +664,9 @@ void Motion::replaceKeyframe(IKeyframe *value, bool alsoDelete)
     case IKeyframe::kModelKeyframe: {
         keyframeToDelete = m_context->modelMotion.findKeyframe(value->timeIndex());
         if (keyframeToDelete) {
-            m_context->morphMotion.removeKeyframe(keyframeToDelete);
+            m_context->modelMotion.removeKeyframe(keyframeToDelete);
         }
-        m_context->morphMotion.addKeyframe(value);
+        m_context->modelMotion.addKeyframe(value);
         break;
     }
     case IKeyframe::kProjectKeyframe: {
@@ -713,6 +805,9 @@ void Motion::removeKeyframe(IKeyframe *value)
         VPVL2_LOG(WARNING, "null keyframe or keyframe timeIndex is 0 cannot be removed");
         return;
     }
+    else if (!m_context->isRemovable()) {
+        return;
+    }
     IKeyframe::Type type = value->type();
     if (BaseAnimation *const *animationPtr = m_context->type2animationRefs.find(value->type())) {
         BaseAnimation *animation = *animationPtr;
@@ -728,6 +823,9 @@ void Motion::deleteKeyframe(IKeyframe *&value)
         VPVL2_LOG(WARNING, "null keyframe or keyframe timeIndex is 0 cannot be deleted");
         return;
     }
+    else if (!m_context->isRemovable()) {
+        return;
+    }
     IKeyframe::Type type = value->type();
     if (BaseAnimation *const *animationPtr = m_context->type2animationRefs.find(value->type())) {
         BaseAnimation *animation = *animationPtr;
@@ -739,9 +837,15 @@ void Motion::deleteKeyframe(IKeyframe *&value)
 
 void Motion::update(IKeyframe::Type type)
 {
+    /* instances follow changes of the source motion in update of each animation */
     switch (type) {
     case IKeyframe::kBoneKeyframe:
-        m_context->boneMotion.setParentModelRef(m_context->parentModelRef);
+        if (m_context->boneMotion.parentModelRef() == m_context->parentModelRef) {
+            m_context->boneMotion.update();
+        }
+        else {
+            m_context->boneMotion.setParentModelRef(m_context->parentModelRef);
+        }
         break;
     case IKeyframe::kCameraKeyframe:
         m_context->cameraMotion.update();
@@ -750,7 +854,12 @@ void Motion::update(IKeyframe::Type type)
         m_context->lightMotion.update();
         break;
     case IKeyframe::kMorphKeyframe:
-        m_context->morphMotion.setParentModelRef(m_context->parentModelRef);
+        if (m_context->morphMotion.parentModelRef() == m_context->parentModelRef) {
+            m_context->morphMotion.update();
+        }
+        else {
+            m_context->morphMotion.setParentModelRef(m_context->parentModelRef);
+        }
         break;
     case IKeyframe::kProjectKeyframe:
         m_context->projectMotion.update();
@@ -764,10 +873,21 @@ void Motion::update(IKeyframe::Type type)
 IMotion *Motion::clone() const
 {
     IMotion *dest = m_context->motionPtr = new Motion(m_context->parentModelRef, m_context->encodingRef);
-    const int nbkeyframes = m_context->boneMotion.countKeyframes();
-    for (int i = 0; i < nbkeyframes; i++) {
-        BoneKeyframe *keyframe = m_context->boneMotion.findKeyframeAt(i);
-        dest->addKeyframe(keyframe->clone());
+    if (const CompressedBoneAnimation *compressedBoneMotion = m_context->compressedBoneMotion) {
+        /* the copy has editable bone keyframes decompressed within the quantization error */
+        Array<BoneKeyframe *> keyframes;
+        compressedBoneMotion->decompress(keyframes, m_context->encodingRef);
+        const int nbkeyframes = keyframes.count();
+        for (int i = 0; i < nbkeyframes; i++) {
+            dest->addKeyframe(keyframes[i]);
+        }
+    }
+    else {
+        const int nbkeyframes = m_context->boneMotion.countKeyframes();
+        for (int i = 0; i < nbkeyframes; i++) {
+            BoneKeyframe *keyframe = m_context->boneMotion.findKeyframeAt(i);
+            dest->addKeyframe(keyframe->clone());
+        }
     }
     const int nckeyframes = m_context->cameraMotion.countKeyframes();
     for (int i = 0; i < nckeyframes; i++) {
@@ -795,6 +915,55 @@ IMotion *Motion::clone() const
     return dest;
 }
 
+Motion *Motion::createInstance(IModel *modelRef) const
+{
+    /* instances of an instance share keyframes of the root motion */
+    PrivateContext *source = m_context->sharedContextRef ? m_context->sharedContextRef : m_context;
+    if (source->compressedBoneMotion) {
+        VPVL2_LOG(WARNING, "Compacted bone keyframes cannot be shared with instances");
+        return 0;
+    }
+    Motion *instance = new Motion(modelRef, m_context->encodingRef);
+    PrivateContext *context = instance->m_context;
+    context->shareAnimations(source);
+    internal::setString(source->name, context->name);
+    instance->setParentModelRef(modelRef);
+    instance->setNullFrameEnable(isNullFrameEnabled());
+    return instance;
+}
+
+bool Motion::isSharedInstance() const
+{
+    return m_context->sharedContextRef != 0;
+}
+
+bool Motion::compactBoneKeyframes()
+{
+    if (m_context->compressedBoneMotion) {
+        return true;
+    }
+    else if (!m_context->isRemovable()) {
+        return false;
+    }
+    CompressedBoneAnimation *animation = new CompressedBoneAnimation();
+    if (!animation->compress(m_context->boneMotion)) {
+        internal::deleteObject(animation);
+        return false;
+    }
+    animation->setParentModelRef(m_context->parentModelRef);
+    m_context->compressedBoneMotion = animation;
+    /* the compressed animation owns copies of track names, so keyframes can be deleted now */
+    Array<IKeyframe *> keyframes;
+    m_context->boneMotion.setAllKeyframes(keyframes, IKeyframe::kBoneKeyframe);
+    m_context->boneMotion.update();
+    return true;
+}
+
+const CompressedBoneAnimation *Motion::compressedBoneAnimation() const
+{
+    return m_context->compressedBoneMotion;
+}
+
 void Motion::getAllKeyframeRefs(Array<IKeyframe *> &value, IKeyframe::Type type)
 {
     if (const BaseAnimation *const *animationPtr = m_context->type2animationRefs.find(type)) {
@@ -805,7 +974,10 @@ void Motion::getAllKeyframeRefs(Array<IKeyframe *> &value, IKeyframe::Type type)
 
 void Motion::setAllKeyframes(const Array<IKeyframe *> &value, IKeyframe::Type type)
 {
-    if (BaseAnimation *const *animationPtr = m_context->type2animationRefs.find(type)) {
+    if (!m_context->isRemovable() || m_context->isCompacted(type)) {
+        return;
+    }
+    else if (BaseAnimation *const *animationPtr = m_context->type2animationRefs.find(type)) {
         BaseAnimation *animation = *animationPtr;
         animation->setAllKeyframes(value, type);
         update(type);
@@ -814,7 +986,12 @@ void Motion::setAllKeyframes(const Array<IKeyframe *> &value, IKeyframe::Type ty
 
 void Motion::createFirstKeyframesUnlessFound()
 {
-    m_context->boneMotion.createFirstKeyframeUnlessFound();
+    if (!m_context->isEditable()) {
+        return;
+    }
+    if (!m_context->compressedBoneMotion) {
+        m_context->boneMotion.createFirstKeyframeUnlessFound();
+    }
     m_context->cameraMotion.createFirstKeyframeUnlessFound();
     m_context->lightMotion.createFirstKeyframeUnlessFound();
     // m_context->modelMotion.createFirstKeyframeUnlessFound();
@@ -76,7 +76,7 @@ void ProjectAnimation::read(const uint8 *data, int size)
 void ProjectAnimation::seek(const IKeyframe::TimeIndex &timeIndexAt)
 {
     int fromIndex, toIndex;
-    internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, m_keyframes);
+    internal::MotionHelper::findKeyframeIndices(timeIndexAt, m_currentTimeIndex, m_lastTimeIndex, fromIndex, toIndex, keyframeRefs());
     const ProjectKeyframe *keyframeFrom = findKeyframeAt(fromIndex), *keyframeTo = findKeyframeAt(toIndex);
     const IKeyframe::TimeIndex &timeIndexFrom = keyframeFrom->timeIndex(), timeIndexTo = keyframeTo->timeIndex();
     const IMorph::WeightPrecision &distanceFrom = keyframeFrom->shadowDistance();
@@ -100,27 +100,15 @@ void ProjectAnimation::createFirstKeyframeUnlessFound()
     }
 }
 
-void ProjectAnimation::update()
-{
-    int nkeyframes = m_keyframes.count();
-    if (nkeyframes > 0) {
-        m_keyframes.sort(internal::MotionHelper::KeyframeTimeIndexPredication());
-        m_durationTimeIndex = m_keyframes[m_keyframes.count() - 1]->timeIndex();
-    }
-    else {
-        m_durationTimeIndex = 0;
-    }
-}
-
 ProjectKeyframe *ProjectAnimation::findKeyframe(const IKeyframe::TimeIndex &timeIndex) const
 {
-    int index = findKeyframeIndex(timeIndex, m_keyframes);
-    return index != -1 ? reinterpret_cast<ProjectKeyframe *>(m_keyframes[index]) : 0;
+    int index = findKeyframeIndex(timeIndex, keyframeRefs());
+    return index != -1 ? reinterpret_cast<ProjectKeyframe *>(keyframeRefs()[index]) : 0;
 }
 
 ProjectKeyframe *ProjectAnimation::findKeyframeAt(int i) const
 {
-    return internal::checkBound(i, 0, m_keyframes.count()) ? reinterpret_cast<ProjectKeyframe *>(m_keyframes[i]) : 0;
+    return internal::checkBound(i, 0, keyframeRefs().count()) ? reinterpret_cast<ProjectKeyframe *>(keyframeRefs()[i]) : 0;
 }
 
 } /* namespace vmd */
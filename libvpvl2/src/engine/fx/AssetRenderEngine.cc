@@ -45,12 +45,6 @@
 #include "vpvl2/gl/VertexBundle.h"
 #include "vpvl2/gl/VertexBundleLayout.h"
 
-#if defined(VPVL2_LINK_ASSIMP3)
-#include <assimp/scene.h>
-#elif defined(VPVL2_LINK_ASSIMP)
-#include <assimp/aiScene.h>
-#endif
-
 namespace vpvl2
 {
 namespace VPVL2_VERSION_NS
@@ -96,10 +90,6 @@ public:
         m_parentRenderEngineRef = 0;
     }
 
-    void setMesh(const aiMesh *value) {
-        m_mesh = value;
-    }
-
 protected:
     typedef void (GLAPIENTRY * PFNGLDRAWELEMENTSBASEVERTEXPROC) (GLenum mode, GLsizei count, GLenum type, void* indices, GLint basevertex);
     typedef void (GLAPIENTRY * PFNGLDRAWELEMENTSPROC) (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices);
@@ -116,12 +106,11 @@ protected:
         }
     }
     void rebindVertexBundle() {
-        m_parentRenderEngineRef->bindVertexBundle(m_mesh);
+        m_parentRenderEngineRef->bindVertexBundle();
     }
 
 private:
     AssetRenderEngine *m_parentRenderEngineRef;
-    const aiMesh *m_mesh;
 
     VPVL2_DISABLE_COPY_AND_ASSIGN(PrivateEffectEngine)
 };
@@ -139,6 +128,8 @@ AssetRenderEngine::AssetRenderEngine(IApplicationContext *applicationContextRef,
       m_applicationContextRef(applicationContextRef),
       m_sceneRef(scene),
       m_modelRef(model),
+      m_vbo(0),
+      m_vao(0),
       m_defaultEffectRef(0),
       m_nvertices(0),
       m_nmeshes(0),
@@ -163,79 +154,59 @@ IModel *AssetRenderEngine::parentModelRef() const
 
 bool AssetRenderEngine::upload(void *userData)
 {
-    bool ret = true;
-    const aiScene *scene = m_modelRef->aiScenePtr();
-    if (!scene) {
+    const Array<asset::Model::MaterialBatch> &batches = m_modelRef->materialBatches();
+    const int nbatches = batches.count();
+    if (nbatches == 0) {
         return true;
     }
     pushAnnotationGroup(std::string("AssetRenderEngine#upload name=").append(internal::cstr(m_modelRef->name(IEncoding::kDefaultLanguage), "")).c_str(), m_applicationContextRef);
-    const unsigned int nmaterials = scene->mNumMaterials;
-    aiString texturePath;
-    std::string path, mainTexture, subTexture;
-    PrivateEffectEngine *engine = 0;
+    std::string mainTexture, subTexture;
     int flags = 0;
     if (PrivateEffectEngine *const *enginePtr = m_effectEngines.find(IEffect::kStandard)) {
-        engine = *enginePtr;
-        if (engine->materialTexture.isMipmapEnabled()) {
+        if ((*enginePtr)->materialTexture.isMipmapEnabled()) {
             flags |= IApplicationContext::kGenerateTextureMipmap;
         }
     }
-    for (unsigned int i = 0; i < nmaterials; i++) {
-        const aiMaterial *material = scene->mMaterials[i];
-        aiReturn found = AI_SUCCESS;
-        int textureIndex = 0;
-        while (found == AI_SUCCESS) {
-            found = material->GetTexture(aiTextureType_DIFFUSE, textureIndex, &texturePath);
-            path = texturePath.data;
-            if (PrivateEffectEngine::splitTexturePath(path, mainTexture, subTexture)) {
-                if (m_textureMap[mainTexture] == 0) {
-                    IString *mainTexturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(mainTexture.c_str()));
-                    if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(mainTexturePath, flags, userData)) {
-                        m_textureMap[mainTexture] = m_allocatedTextures.insert(texturePtr, texturePtr);
-                        if (engine) {
-                            engine->materialTexture.setTexture(texturePtr, texturePtr);
-                        }
-                        VPVL2_VLOG(2, "Loaded a main texture: name=" << internal::cstr(mainTexturePath, "(null)") << " ID=" << texturePtr);
-                    }
-                    internal::deleteObject(mainTexturePath);
-                }
-                if (m_textureMap[subTexture] == 0) {
-                    IString *subTexturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(subTexture.c_str()));
-                    if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(subTexturePath, flags, userData)) {
-                        m_textureMap[subTexture] = m_allocatedTextures.insert(texturePtr, texturePtr);
-                        if (engine) {
-                            engine->materialSphereMap.setTexture(texturePtr, texturePtr);
-                        }
-                        VPVL2_VLOG(2, "Loaded a sub texture: name=" << internal::cstr(subTexturePath, "(null)") << " ID=" << texturePtr);
-                    }
-                    internal::deleteObject(subTexturePath);
-                }
-            }
-            else if (m_textureMap[mainTexture] == 0) {
-                IString *mainTexturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(mainTexture.c_str()));
-                if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(mainTexturePath, flags, userData)) {
-                    m_textureMap[mainTexture] = m_allocatedTextures.insert(texturePtr, texturePtr);
-                    if (engine) {
-                        engine->materialTexture.setTexture(texturePtr, texturePtr);
-                    }
-                    VPVL2_VLOG(2, "Loaded a main texture: name=" << internal::cstr(mainTexturePath, "(null)") << " ID=" << texturePtr);
-                }
-                internal::deleteObject(mainTexturePath);
-            }
-            textureIndex++;
+    for (int i = 0; i < nbatches; i++) {
+        const std::string &path = batches[i].texturePath;
+        if (path.empty()) {
+            continue;
+        }
+        if (PrivateEffectEngine::splitTexturePath(path, mainTexture, subTexture)) {
+            uploadTexture(mainTexture, flags, false, userData);
+            uploadTexture(subTexture, flags, true, userData);
+        }
+        else {
+            uploadTexture(mainTexture, flags, false, userData);
         }
     }
-    ret = uploadRecurse(scene, scene->mRootNode, userData);
-    m_modelRef->setVisible(ret);
+    const Array<asset::Model::MeshVertex> &meshVertices = m_modelRef->meshVertices();
+    const int nvertices = meshVertices.count();
+    Vertices assetVertices;
+    Vertex assetVertex;
+    assetVertices.reserve(nvertices);
+    for (int i = 0; i < nvertices; i++) {
+        const asset::Model::MeshVertex &vertex = meshVertices[i];
+        assetVertex.position = vertex.position;
+        assetVertex.normal = vertex.normal;
+        assetVertex.texcoord = vertex.texcoord;
+        assetVertex.tangent = vertex.tangent;
+        assetVertex.bitangent = vertex.bitangent;
+        assetVertices.append(assetVertex);
+    }
+    createVertexBundle(assetVertices, m_modelRef->meshIndices());
+    m_nvertices = nvertices;
+    m_nmeshes = nbatches;
+    m_modelRef->setVisible(true);
     popAnnotationGroup(m_applicationContextRef);
-    return ret;
+    return true;
 }
 
 void AssetRenderEngine::release()
 {
     pushAnnotationGroup(std::string("AssetRenderEngine#release name=").append(internal::cstr(m_modelRef->name(IEncoding::kDefaultLanguage), "")).c_str(), m_applicationContextRef);
-    m_vao.releaseAll();
-    m_vbo.releaseAll();
+    internal::deleteObject(m_vao);
+    internal::deleteObject(m_vbo);
     m_allocatedTextures.releaseAll();
     m_effectEngines.releaseAll();
     m_oseffects.releaseAll();
@@ -273,8 +244,35 @@ void AssetRenderEngine::renderModel(IEffect::Pass *overridePass)
     }
     initializeEffectParameters();
     refreshEffect();
-    const aiScene *a = m_modelRef->aiScenePtr();
-    renderRecurse(a, a->mRootNode, overridePass, hasShadowMap);
+    const int nbatches = m_modelRef->materialBatches().count();
+    const char *target = hasShadowMap ? "object_ss" : "object";
+    EffectEngine::DrawPrimitiveCommand command;
+    bool hasTexture = false, hasSphereMap = false;
+    /* all batches share one vertex bundle so only material parameters change between subsets */
+    bindVertexBundle();
+    for (int i = 0; i < nbatches; i++) {
+        setAssetMaterial(i, hasTexture, hasSphereMap);
+        if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique(target, i, nbatches, hasTexture, hasSphereMap, false)) {
+            if (overridePass) {
+                technique->setOverridePass(overridePass);
+            }
+            else {
+                Array<IEffect::Pass *> passes;
+                technique->getOverridePasses(passes);
+                if (passes.count() > 0) {
+                    overridePass = passes[0];
+                    technique = m_currentEffectEngineRef->findDefaultTechnique(target, i, nbatches, hasTexture, hasSphereMap, false);
+                    technique->setOverridePass(overridePass);
+                }
+            }
+            setDrawCommand(command, i);
+            annotate("renderModel: model=%s subset=%d", m_modelRef->name(IEncoding::kDefaultLanguage)->toByteArray(), i);
+            pushAnnotationGroup("AssetRenderEngine::PrivateEffectEngine#executeTechniquePasses", m_applicationContextRef);
+            m_currentEffectEngineRef->executeTechniquePasses(technique, command, 0);
+            popAnnotationGroup(m_applicationContextRef);
+        }
+    }
+    unbindVertexBundle();
     if (!m_cullFaceState) {
         enable(kGL_CULL_FACE);
         m_cullFaceState = true;
@@ -301,9 +299,25 @@ void AssetRenderEngine::renderZPlot(IEffect::Pass *overridePass)
     pushAnnotationGroup(std::string("AssetRenderEngine#renderZPlot name=").append(internal::cstr(m_modelRef->name(IEncoding::kDefaultLanguage), "")).c_str(), m_applicationContextRef);
     initializeEffectParameters();
     refreshEffect();
-    const aiScene *a = m_modelRef->aiScenePtr();
+    const Array<asset::Model::MaterialBatch> &batches = m_modelRef->materialBatches();
+    const int nbatches = batches.count();
+    EffectEngine::DrawPrimitiveCommand command;
     disable(kGL_CULL_FACE);
-    renderZPlotRecurse(a, a->mRootNode, overridePass);
+    bindVertexBundle();
+    for (int i = 0; i < nbatches; i++) {
+        if (btFuzzyZero(batches[i].diffuse.w() - 0.98f)) {
+            continue;
+        }
+        if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique("zplot", i, nbatches, false, false, false)) {
+            technique->setOverridePass(overridePass);
+            setDrawCommand(command, i);
+            annotate("renderZplot: model=%s subset=%d", m_modelRef->name(IEncoding::kDefaultLanguage)->toByteArray(), i);
+            pushAnnotationGroup("AssetRenderEngine::PrivateEffectEngine#executeTechniquePasses", m_applicationContextRef);
+            m_currentEffectEngineRef->executeTechniquePasses(technique, command, 0);
+            popAnnotationGroup(m_applicationContextRef);
+        }
+    }
+    unbindVertexBundle();
     enable(kGL_CULL_FACE);
     popAnnotationGroup(m_applicationContextRef);
 }
@@ -378,33 +392,25 @@ void AssetRenderEngine::setEffect(IEffect *effectRef, IEffect::ScriptOrderType t
             PrivateEffectEngine *previous = m_currentEffectEngineRef;
             m_currentEffectEngineRef = new PrivateEffectEngine(this, resolver);
             m_currentEffectEngineRef->setEffect(effectRef, userData, false);
-            const aiScene *scene = m_modelRef->aiScenePtr();
-            if (scene && m_currentEffectEngineRef->scriptOrder() == IEffect::kStandard) {
-                const unsigned int nmaterials = scene->mNumMaterials;
-                std::string texture, mainTexture, subTexture;
-                aiString texturePath;
+            const Array<asset::Model::MaterialBatch> &batches = m_modelRef->materialBatches();
+            if (batches.count() > 0 && m_currentEffectEngineRef->scriptOrder() == IEffect::kStandard) {
+                const int nbatches = batches.count();
+                std::string mainTexture, subTexture;
                 /* copy current material textures/spheres parameters to offscreen effect */
-                for (unsigned int i = 0; i < nmaterials; i++) {
-                    const aiMaterial *material = scene->mMaterials[i];
-                    aiReturn found = AI_SUCCESS;
-                    int textureIndex = 0;
-                    while (found == AI_SUCCESS) {
-                        found = material->GetTexture(aiTextureType_DIFFUSE, textureIndex, &texturePath);
-                        if (found != AI_SUCCESS) {
-                            break;
-                        }
-                        texture = texturePath.data;
-                        if (PrivateEffectEngine::splitTexturePath(texture, mainTexture, subTexture)) {
-                            Textures::const_iterator sub = m_textureMap.find(subTexture);
-                            if (sub != m_textureMap.end()) {
-                                m_currentEffectEngineRef->materialSphereMap.setTexture(sub->second, sub->second);
-                            }
-                        }
-                        Textures::const_iterator main = m_textureMap.find(mainTexture);
-                        if (main != m_textureMap.end()) {
-                            m_currentEffectEngineRef->materialTexture.setTexture(main->second, main->second);
+                for (int i = 0; i < nbatches; i++) {
+                    const std::string &texture = batches[i].texturePath;
+                    if (texture.empty()) {
+                        continue;
+                    }
+                    if (PrivateEffectEngine::splitTexturePath(texture, mainTexture, subTexture)) {
+                        Textures::const_iterator sub = m_textureMap.find(subTexture);
+                        if (sub != m_textureMap.end()) {
+                            m_currentEffectEngineRef->materialSphereMap.setTexture(sub->second, sub->second);
                         }
-                        textureIndex++;
+                    }
+                    Textures::const_iterator main = m_textureMap.find(mainTexture);
+                    if (main != m_textureMap.end()) {
+                        m_currentEffectEngineRef->materialTexture.setTexture(main->second, main->second);
                     }
                 }
                 m_oseffects.append(m_currentEffectEngineRef);
@@ -472,106 +478,34 @@ bool AssetRenderEngine::testVisible()
     return visible;
 }
 
-void AssetRenderEngine::bindVertexBundle(const aiMesh *mesh)
+void AssetRenderEngine::bindVertexBundle()
 {
-    m_currentEffectEngineRef->setMesh(mesh);
-    if (mesh) {
-        VertexBundleLayout *const *layout = m_vao.find(mesh);
-        if (layout && !(*layout)->bind()) {
-            VertexBundle *bundle = *m_vbo.find(mesh);
-            bundle->bind(VertexBundle::kVertexBuffer, 0);
-            bindStaticVertexAttributePointers();
-            bundle->bind(VertexBundle::kIndexBuffer, 0);
-        }
+    if (m_vao && !m_vao->bind()) {
+        m_vbo->bind(VertexBundle::kVertexBuffer, 0);
+        bindStaticVertexAttributePointers();
+        m_vbo->bind(VertexBundle::kIndexBuffer, 0);
     }
 }
 
-bool AssetRenderEngine::uploadRecurse(const aiScene *scene, const aiNode *node, void *userData)
+void AssetRenderEngine::uploadTexture(const std::string &path, int flags, bool isSphereMap, void *userData)
 {
-    pushAnnotationGroup("AssetRenderEngine#uploadRecurse", m_applicationContextRef);
-    const unsigned int nmeshes = node->mNumMeshes;
-    bool ret = true;
-    m_nmeshes = nmeshes;
-    Vertices assetVertices;
-    Vertex assetVertex;
-    Array<int> vertexIndices;
-    assetVertex.position.setW(1);
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const unsigned int nfaces = mesh->mNumFaces;
-        unsigned int numIndices = 0;
-        switch (mesh->mPrimitiveTypes) {
-        case aiPrimitiveType_LINE:
-            numIndices = 1;
-            break;
-        case aiPrimitiveType_POINT:
-            numIndices = 2;
-            break;
-        case aiPrimitiveType_TRIANGLE:
-            numIndices = 3;
-            break;
-        default:
-            break;
-        }
-        for (unsigned int j = 0; j < nfaces; j++) {
-            const struct aiFace &face = mesh->mFaces[j];
-            for (unsigned int k = 0; k < numIndices; k++) {
-                int vertexIndex = face.mIndices[k];
-                vertexIndices.append(vertexIndex);
-            }
-        }
-        const bool hasNormals = mesh->HasNormals();
-        const bool hasTexCoords = mesh->HasTextureCoords(0);
-        const bool hasTangent = mesh->HasTangentsAndBitangents();
-        const aiVector3D *vertices = mesh->mVertices;
-        const aiVector3D *normals = hasNormals ? mesh->mNormals : 0;
-        const aiVector3D *texcoords = hasTexCoords ? mesh->mTextureCoords[0] : 0;
-        const aiVector3D *tangents = hasTangent ? mesh->mTangents : 0;
-        const aiVector3D *bitangents = hasTangent ? mesh->mBitangents : 0;
-        const unsigned int nvertices = mesh->mNumVertices;
-        for (unsigned int j = 0; j < nvertices; j++) {
-            const aiVector3D &vertex = vertices[j];
-            assetVertex.position.setValue(vertex.x, vertex.y, vertex.z);
-            if (hasNormals) {
-                const aiVector3D &normal = normals[j];
-                assetVertex.normal.setValue(normal.x, normal.y, normal.z);
-            }
-            else {
-                assetVertex.normal.setZero();
-            }
-            if (hasTexCoords) {
-                const aiVector3D &texcoord = texcoords[j];
-                assetVertex.texcoord.setValue(texcoord.x, texcoord.y, texcoord.z);
-            }
-            else {
-                assetVertex.texcoord.setZero();
-            }
-            if (hasTangent) {
-                const aiVector3D &tangent = tangents[j];
-                const aiVector3D &bitangent = bitangents[j];
-                assetVertex.tangent.setValue(tangent.x, tangent.y, tangent.z);
-                assetVertex.bitangent.setValue(bitangent.x, bitangent.y, bitangent.z);
-            }
-            else {
-                assetVertex.tangent.setZero();
-                assetVertex.bitangent.setZero();
+    if (m_textureMap[path] == 0) {
+        IString *texturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(path.c_str()));
+        if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(texturePath, flags, userData)) {
+            m_textureMap[path] = m_allocatedTextures.insert(texturePtr, texturePtr);
+            if (PrivateEffectEngine *const *enginePtr = m_effectEngines.find(IEffect::kStandard)) {
+                PrivateEffectEngine *engine = *enginePtr;
+                if (isSphereMap) {
+                    engine->materialSphereMap.setTexture(texturePtr, texturePtr);
+                }
+                else {
+                    engine->materialTexture.setTexture(texturePtr, texturePtr);
+                }
             }
-            assetVertices.append(assetVertex);
-        }
-        createVertexBundle(mesh, assetVertices, vertexIndices);
-        assetVertices.clear();
-        vertexIndices.clear();
-        unbindVertexBundle(mesh);
-    }
-    const unsigned int nChildNodes = node->mChildren ? node->mNumChildren : 0;
-    for (unsigned int i = 0; i < nChildNodes; i++) {
-        ret = uploadRecurse(scene, node->mChildren[i], userData);
-        if (!ret) {
-            return ret;
+            VPVL2_VLOG(2, "Loaded a texture: name=" << internal::cstr(texturePath, "(null)") << " ID=" << texturePtr);
         }
+        internal::deleteObject(texturePath);
     }
-    popAnnotationGroup(m_applicationContextRef);
-    return ret;
 }
 
 void AssetRenderEngine::initializeEffectParameters()
@@ -595,91 +529,16 @@ void AssetRenderEngine::refreshEffect()
     }
 }
 
-void AssetRenderEngine::renderRecurse(const aiScene *scene, const aiNode *node, IEffect::Pass *overridePass, const bool hasShadowMap)
-{
-    pushAnnotationGroup("AssetRenderEngine#renderRecurse", m_applicationContextRef);
-    const unsigned int nmeshes = node->mNumMeshes;
-    EffectEngine::DrawPrimitiveCommand command;
-    bool hasTexture = false, hasSphereMap = false;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const char *target = hasShadowMap ? "object_ss" : "object";
-        const aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        setAssetMaterial(material, hasTexture, hasSphereMap);
-        if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique(target, i, nmeshes, hasTexture, hasSphereMap, false)) {
-            vsize nindices = *m_numIndices.find(mesh);
-            if (overridePass) {
-                technique->setOverridePass(overridePass);
-            }
-            else {
-                Array<IEffect::Pass *> passes;
-                technique->getOverridePasses(passes);
-                if (passes.count() > 0) {
-                    overridePass = passes[0];
-                    technique = m_currentEffectEngineRef->findDefaultTechnique(target, i, nmeshes, hasTexture, hasSphereMap, false);
-                    technique->setOverridePass(overridePass);
-                }
-            }
-            bindVertexBundle(mesh);
-            command.count = nindices;
-            setDrawCommandMode(command, mesh);
-            annotate("renderModel: model=%s mesh=%d", m_modelRef->name(IEncoding::kDefaultLanguage)->toByteArray(), i);
-            pushAnnotationGroup("AssetRenderEngine::PrivateEffectEngine#executeTechniquePasses", m_applicationContextRef);
-            m_currentEffectEngineRef->executeTechniquePasses(technique, command, 0);
-            popAnnotationGroup(m_applicationContextRef);
-            unbindVertexBundle(mesh);
-        }
-    }
-    const unsigned int nChildNodes = node->mChildren ? node->mNumChildren : 0;
-    for (unsigned int i = 0; i < nChildNodes; i++) {
-        renderRecurse(scene, node->mChildren[i], overridePass, hasShadowMap);
-    }
-    popAnnotationGroup(m_applicationContextRef);
-}
-
-void AssetRenderEngine::renderZPlotRecurse(const aiScene *scene, const aiNode *node, IEffect::Pass *overridePass)
+void AssetRenderEngine::setAssetMaterial(int batchIndex, bool &hasTexture, bool &hasSphereMap)
 {
-    pushAnnotationGroup("AssetRenderEngine#renderZPlotRecurse", m_applicationContextRef);
-    const unsigned int nmeshes = node->mNumMeshes;
-    aiColor4D diffuseColor;
-    EffectEngine::DrawPrimitiveCommand command;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const struct aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        if (material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuseColor) == aiReturn_SUCCESS && btFuzzyZero(diffuseColor.a - 0.98f)) {
-            continue;
-        }
-        bindVertexBundle(mesh);
-        if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique("zplot", i, nmeshes, false, false, false)) {
-            technique->setOverridePass(overridePass);
-            vsize nindices = *m_numIndices.find(mesh);
-            command.count = nindices;
-            setDrawCommandMode(command, mesh);
-            annotate("renderZplot: model=%s mesh=%d", m_modelRef->name(IEncoding::kDefaultLanguage)->toByteArray(), i);
-            pushAnnotationGroup("AssetRenderEngine::PrivateEffectEngine#executeTechniquePasses", m_applicationContextRef);
-            m_currentEffectEngineRef->executeTechniquePasses(technique, command, 0);
-            popAnnotationGroup(m_applicationContextRef);
-        }
-        unbindVertexBundle(mesh);
-    }
-    const unsigned int nChildNodes = node->mChildren ? node->mNumChildren : 0;
-    for (unsigned int i = 0; i < nChildNodes; i++) {
-        renderZPlotRecurse(scene, node->mChildren[i], overridePass);
-    }
-    popAnnotationGroup(m_applicationContextRef);
-}
-
-void AssetRenderEngine::setAssetMaterial(const aiMaterial *material, bool &hasTexture, bool &hasSphereMap)
-{
-    int textureIndex = 0;
+    const asset::Model::MaterialBatch &batch = m_modelRef->materialBatches()[batchIndex];
     ITexture *mainTextureRef = 0, *sphereTextureRef = 0;
     std::string mainTexturePath, subTexturePath;
-    aiString texturePath;
     hasTexture = false;
     hasSphereMap = false;
-    if (material->GetTexture(aiTextureType_DIFFUSE, textureIndex, &texturePath) == aiReturn_SUCCESS) {
+    if (!batch.texturePath.empty()) {
         bool isAdditive = false;
-        if (PrivateEffectEngine::splitTexturePath(texturePath.data, mainTexturePath, subTexturePath)) {
+        if (PrivateEffectEngine::splitTexturePath(batch.texturePath, mainTexturePath, subTexturePath)) {
             sphereTextureRef = m_textureMap[subTexturePath];
             isAdditive = subTexturePath.find(".spa") != std::string::npos;
             m_currentEffectEngineRef->spadd.setValue(isAdditive);
@@ -698,45 +557,17 @@ void AssetRenderEngine::setAssetMaterial(const aiMaterial *material, bool &hasTe
     // * ambient = diffuse
     // * specular / 10
     // * emissive
-    aiColor4D emissive, diffuse, specular;
+    static const float kDivide = 10.0;
+    const Color &diffuse = batch.diffuse, &specular = batch.specular;
     Color color;
-    if (material->Get(AI_MATKEY_COLOR_EMISSIVE, emissive) == aiReturn_SUCCESS) {
-        color.setValue(emissive.r, emissive.g, emissive.b, emissive.a);
-    }
-    else {
-        color.setValue(0, 0, 0, 1);
-    }
-    m_currentEffectEngineRef->emissive.setGeometryColor(color);
-    if (material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse) == aiReturn_SUCCESS) {
-        color.setValue(diffuse.r, diffuse.g, diffuse.b, diffuse.a * m_modelRef->opacity());
-    }
-    else {
-        color.setValue(1, 1, 1, m_modelRef->opacity());
-    }
+    m_currentEffectEngineRef->emissive.setGeometryColor(batch.emissive);
+    color.setValue(diffuse.x(), diffuse.y(), diffuse.z(), diffuse.w() * m_modelRef->opacity());
     m_currentEffectEngineRef->ambient.setGeometryColor(color);
     m_currentEffectEngineRef->diffuse.setGeometryColor(color);
-    if (material->Get(AI_MATKEY_COLOR_SPECULAR, specular) == aiReturn_SUCCESS) {
-        static const float kDivide = 10.0;
-        color.setValue(specular.r / kDivide, specular.g / kDivide, specular.b / kDivide, specular.a);
-    }
-    else {
-        color.setValue(0, 0, 0, 1);
-    }
+    color.setValue(specular.x() / kDivide, specular.y() / kDivide, specular.z() / kDivide, specular.w());
     m_currentEffectEngineRef->specular.setGeometryColor(color);
-    float shininess = 0, strength = 0;
-    int ret1 = material->Get(AI_MATKEY_SHININESS, shininess);
-    int ret2 = material->Get(AI_MATKEY_SHININESS_STRENGTH, strength);
-    if (ret1 == aiReturn_SUCCESS && ret2 == aiReturn_SUCCESS) {
-        m_currentEffectEngineRef->specularPower.setGeometryValue(shininess * strength);
-    }
-    else if (ret1 == aiReturn_SUCCESS) {
-        m_currentEffectEngineRef->specularPower.setGeometryValue(shininess);
-    }
-    else {
-        m_currentEffectEngineRef->specularPower.setGeometryValue(1);
-    }
-    int twoside = 0;
-    if (material->Get(AI_MATKEY_TWOSIDED, twoside) == aiReturn_SUCCESS && twoside && m_cullFaceState) {
+    m_currentEffectEngineRef->specularPower.setGeometryValue(batch.hasShininess ? batch.shininess : 1);
+    if (batch.isTwoSided && m_cullFaceState) {
         disable(kGL_CULL_FACE);
         m_cullFaceState = false;
     }
@@ -746,14 +577,12 @@ void AssetRenderEngine::setAssetMaterial(const aiMaterial *material, bool &hasTe
     }
 }
 
-void AssetRenderEngine::createVertexBundle(const aiMesh *mesh,
-                                           const Vertices &vertices,
-                                           const Indices &indices)
+void AssetRenderEngine::createVertexBundle(const Vertices &vertices, const Indices &indices)
 {
     const IApplicationContext::FunctionResolver *resolver = m_applicationContextRef->sharedFunctionResolverInstance();
-    pushAnnotationGroup("AssetRenderEngine#uploadRecurse", resolver);
-    VertexBundleLayout *layout = m_vao.insert(mesh, new VertexBundleLayout(resolver));
-    VertexBundle *bundle = m_vbo.insert(mesh, new VertexBundle(resolver));
+    pushAnnotationGroup("AssetRenderEngine#createVertexBundle", resolver);
+    VertexBundleLayout *layout = m_vao = new VertexBundleLayout(resolver);
+    VertexBundle *bundle = m_vbo = new VertexBundle(resolver);
     vsize isize = sizeof(indices[0]) * indices.count();
     annotate("createVertexBundle: model=%s", m_modelRef->name(IEncoding::kDefaultLanguage)->toByteArray());
     bundle->create(VertexBundle::kIndexBuffer, 0, VertexBundle::kGL_STATIC_DRAW, &indices[0], isize);
@@ -768,14 +597,12 @@ void AssetRenderEngine::createVertexBundle(const aiMesh *mesh,
     bindStaticVertexAttributePointers();
     bundle->bind(VertexBundle::kIndexBuffer, 0);
     layout->unbind();
-    m_numIndices.insert(mesh, indices.count());
     popAnnotationGroup(resolver);
 }
 
-void AssetRenderEngine::unbindVertexBundle(const aiMesh *mesh)
+void AssetRenderEngine::unbindVertexBundle()
 {
-    VertexBundleLayout *const *layout = m_vao.find(mesh);
-    if (layout && !(*layout)->unbind()) {
+    if (m_vao && !m_vao->unbind()) {
         IEffect *effectRef = m_currentEffectEngineRef->effect();
         effectRef->deactivateVertexAttribute(IEffect::kPositionVertexAttribute);
         effectRef->deactivateVertexAttribute(IEffect::kNormalVertexAttribute);
@@ -784,9 +611,8 @@ void AssetRenderEngine::unbindVertexBundle(const aiMesh *mesh)
             IEffect::VertexAttributeType attribType = static_cast<IEffect::VertexAttributeType>(int(IModel::DynamicVertexBuffer::kUVA1Stride) + i);
             effectRef->deactivateVertexAttribute(attribType);
         }
-        VertexBundle *bundle = *m_vbo.find(mesh);
-        bundle->unbind(VertexBundle::kVertexBuffer);
-        bundle->unbind(VertexBundle::kIndexBuffer);
+        m_vbo->unbind(VertexBundle::kVertexBuffer);
+        m_vbo->unbind(VertexBundle::kIndexBuffer);
     }
 }
 
@@ -819,21 +645,23 @@ void AssetRenderEngine::bindStaticVertexAttributePointers()
     popAnnotationGroup(m_applicationContextRef);
 }
 
-void AssetRenderEngine::setDrawCommandMode(EffectEngine::DrawPrimitiveCommand &command, const aiMesh *mesh)
+void AssetRenderEngine::setDrawCommand(EffectEngine::DrawPrimitiveCommand &command, int batchIndex)
 {
-    switch (mesh->mPrimitiveTypes) {
-    case aiPrimitiveType_LINE:
+    const asset::Model::MaterialBatch &batch = m_modelRef->materialBatches()[batchIndex];
+    switch (batch.primitiveType) {
+    case asset::Model::kLines:
         command.mode = kGL_LINES;
         break;
-    case aiPrimitiveType_POINT:
+    case asset::Model::kPoints:
         command.mode = kGL_POINTS;
         break;
-    case aiPrimitiveType_TRIANGLE:
-        command.mode = kGL_TRIANGLES;
-        break;
+    case asset::Model::kTriangles:
     default:
+        command.mode = kGL_TRIANGLES;
         break;
     }
+    command.count = batch.nindices;
+    command.offset = batch.indexOffset * sizeof(uint32);
 }
 
 void AssetRenderEngine::annotate(const char * const format, ...)
@@ -38,6 +38,7 @@
 #include "vpvl2/fx/PMXRenderEngine.h"
 
 #include "vpvl2/vpvl2.h"
+#include "vpvl2/internal/ModelHelper.h"
 #include "vpvl2/internal/util.h" /* internal::snprintf */
 #include "vpvl2/cl/PMXAccelerator.h"
 #include "vpvl2/gl/Texture2D.h"
@@ -294,7 +295,8 @@ PMXRenderEngine::PMXRenderEngine(IApplicationContext *applicationContextRef,
       m_aabbMin(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY),
       m_aabbMax(-SIMD_INFINITY, -SIMD_INFINITY, -SIMD_INFINITY),
       m_cullFaceState(true),
-      m_updateEvenBuffer(true)
+      m_updateEvenBuffer(true),
+      m_enableExactAabb(false)
 {
     VPVL2_DCHECK(modelRef);
     VPVL2_DCHECK(sceneRef);
@@ -440,6 +442,8 @@ void PMXRenderEngine::release()
 #ifdef VPVL2_ENABLE_OPENCL
     internal::deleteObject(m_accelerator);
 #endif
+    m_exactAabbBuffer.clear();
+    m_exactAabbs.clear();
     m_aabbMin.setZero();
     m_aabbMax.setZero();
     m_defaultEffectRef = 0;
@@ -500,11 +504,7 @@ void PMXRenderEngine::update()
         else {
             m_bundle->bind(VertexBundle::kVertexBuffer, vbo);
             if (void *address = m_bundle->map(VertexBundle::kVertexBuffer, 0, m_dynamicBuffer->size())) {
-                m_dynamicBuffer->performTransform(address, m_sceneRef->cameraRef()->position());
-#if 0 // due to SEGV on several models
-                Array<Vector3> aabb;
-                m_dynamicBuffer->computeAabb(address, aabb);
-#endif
+                performSkinning(address);
                 m_bundle->unmap(VertexBundle::kVertexBuffer, address);
             }
             m_bundle->unbind(VertexBundle::kVertexBuffer);
@@ -518,6 +518,7 @@ void PMXRenderEngine::update()
 void PMXRenderEngine::setUpdateOptions(int options)
 {
     m_dynamicBuffer->setParallelUpdateEnable(internal::hasFlagBits(options, kParallelUpdate));
+    m_enableExactAabb = internal::hasFlagBits(options, kExactAabbUpdate);
 }
 
 void PMXRenderEngine::renderModel(IEffect::Pass *overridePass)
@@ -545,7 +546,7 @@ void PMXRenderEngine::renderModel(IEffect::Pass *overridePass)
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
-        if (material->isVisible()) {
+        if (material->isVisible() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingViewFrustum)) {
             const MaterialContext &materialContext = m_materialContexts[i];
             const ITexture *mainTextureRef = materialContext.mainTextureRef, *sphereTextureRef = materialContext.sphereTextureRef;
             const char *const target = hasShadowMap && material->isShadowMapEnabled() ? "object_ss" : "object";
@@ -601,7 +602,7 @@ void PMXRenderEngine::renderEdge(IEffect::Pass *overridePass)
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
-        if (material->isVisible() && material->isEdgeEnabled()) {
+        if (material->isVisible() && material->isEdgeEnabled() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingEdge)) {
             if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique("edge", i, nmaterials, false, false, true)) {
                 technique->setOverridePass(overridePass);
                 updateDrawPrimitivesCommand(material, command);
@@ -638,7 +639,7 @@ void PMXRenderEngine::renderShadow(IEffect::Pass *overridePass)
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
-        if (material->isVisible() && material->isCastingShadowEnabled()) {
+        if (material->isVisible() && material->isCastingShadowEnabled() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingGroundShadow)) {
             if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique("shadow", i, nmaterials, false, false, true)) {
                 technique->setOverridePass(overridePass);
                 updateDrawPrimitivesCommand(material, command);
@@ -675,7 +676,7 @@ void PMXRenderEngine::renderZPlot(IEffect::Pass *overridePass)
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
-        if (material->isVisible() && material->isCastingShadowMapEnabled()) {
+        if (material->isVisible() && material->isCastingShadowMapEnabled() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingShadowFrustum)) {
             if (IEffect::Technique *technique = m_currentEffectEngineRef->findTechnique("zplot", i, nmaterials, false, false, true)) {
                 technique->setOverridePass(overridePass);
                 updateDrawPrimitivesCommand(material, command);
@@ -1063,6 +1064,12 @@ void PMXRenderEngine::updateDrawPrimitivesCommand(const IMaterial *material, Eff
     command.count = range.count;
 }
 
+void PMXRenderEngine::performSkinning(void *address)
+{
+    internal::ModelHelper::performSkinning(m_modelRef, m_dynamicBuffer, address, m_sceneRef->cameraRef()->position(),
+                                           m_enableExactAabb, m_exactAabbBuffer, m_exactAabbs, m_aabbMin, m_aabbMax);
+}
+
 void PMXRenderEngine::updateMaterialParameters(const IMaterial *material, const MaterialContext &context)
 {
     const Color &toonColor = context.toonTextureColor, &diffuse = material->diffuse();
@@ -50,11 +50,6 @@
 #include "vpvl2/gl/VertexBundleLayout.h"
 
 #include <map>
-#if defined(VPVL2_LINK_ASSIMP3)
-#include <assimp/scene.h>
-#elif defined(VPVL2_LINK_ASSIMP)
-#include <assimp/aiScene.h>
-#endif
 
 namespace vpvl2
 {
@@ -183,20 +178,27 @@ class AssetRenderEngine::PrivateContext
 public:
     typedef std::map<std::string, ITexture *> Textures;
     PrivateContext()
-        : cullFaceState(true)
+        : vbo(0),
+          vao(0),
+          assetProgram(0),
+          zplotProgram(0),
+          cullFaceState(true)
     {
     }
     virtual ~PrivateContext() {
+        internal::deleteObject(vao);
+        internal::deleteObject(vbo);
+        internal::deleteObject(assetProgram);
+        internal::deleteObject(zplotProgram);
         allocatedTextures.releaseAll();
     }
 
     Textures textures;
     PointerHash<HashPtr, ITexture> allocatedTextures;
-    std::map<const struct aiMesh *, int> indices;
-    std::map<const struct aiMesh *, VertexBundle *> vbo;
-    std::map<const struct aiMesh *, VertexBundleLayout *> vao;
-    std::map<const struct aiNode *, AssetRenderEngine::Program *> assetPrograms;
-    std::map<const struct aiNode *, ZPlotProgram *> zplotPrograms;
+    VertexBundle *vbo;
+    VertexBundleLayout *vao;
+    AssetRenderEngine::Program *assetProgram;
+    ZPlotProgram *zplotProgram;
     bool cullFaceState;
 };
 
@@ -227,6 +229,19 @@ bool SplitTexturePath(const std::string &path, std::string &mainTexture, std::st
     }
 }
 
+GLenum PrimitiveModeOf(const asset::Model::MaterialBatch &batch)
+{
+    switch (batch.primitiveType) {
+    case asset::Model::kLines:
+        return kGL_LINES;
+    case asset::Model::kPoints:
+        return kGL_POINTS;
+    case asset::Model::kTriangles:
+    default:
+        return kGL_TRIANGLES;
+    }
+}
+
 AssetRenderEngine::AssetRenderEngine(IApplicationContext *applicationContextRef, Scene *scene, asset::Model *model)
     : cullFace(reinterpret_cast<PFNGLCULLFACEPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glCullFace"))),
       enable(reinterpret_cast<PFNGLENABLEPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glEnable"))),
@@ -255,10 +270,42 @@ AssetRenderEngine::~AssetRenderEngine()
 
 void AssetRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
 {
-    if (!m_modelRef || !m_modelRef->isVisible())
+    if (!m_modelRef || !m_modelRef->isVisible() || !m_context->assetProgram)
         return;
-    const aiScene *a = m_modelRef->aiScenePtr();
-    renderRecurse(a, a->mRootNode);
+    const Array<asset::Model::MaterialBatch> &batches = m_modelRef->materialBatches();
+    const int nbatches = batches.count();
+    float matrix4x4[16];
+    Program *program = m_context->assetProgram;
+    program->bind();
+    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
+                                       IApplicationContext::kViewMatrix
+                                       | IApplicationContext::kProjectionMatrix
+                                       | IApplicationContext::kCameraMatrix);
+    program->setViewProjectionMatrix(matrix4x4);
+    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
+                                       IApplicationContext::kWorldMatrix
+                                       | IApplicationContext::kViewMatrix
+                                       | IApplicationContext::kProjectionMatrix
+                                       | IApplicationContext::kLightMatrix);
+    program->setLightViewProjectionMatrix(matrix4x4);
+    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
+                                       IApplicationContext::kWorldMatrix
+                                       | IApplicationContext::kCameraMatrix);
+    program->setModelMatrix(matrix4x4);
+    const ILight *light = m_sceneRef->lightRef();
+    program->setLightColor(light->color());
+    program->setLightDirection(light->direction());
+    program->setOpacity(m_modelRef->opacity());
+    program->setCameraPosition(m_sceneRef->cameraRef()->lookAt());
+    /* all batches share one vertex bundle so only material state changes between draws */
+    bindVertexBundle();
+    for (int i = 0; i < nbatches; i++) {
+        const asset::Model::MaterialBatch &batch = batches[i];
+        setAssetMaterial(i, program);
+        drawElements(PrimitiveModeOf(batch), batch.nindices, kGL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(batch.indexOffset * sizeof(uint32)));
+    }
+    unbindVertexBundle();
+    program->unbind();
     if (!m_context->cullFaceState) {
         enable(kGL_CULL_FACE);
         m_context->cullFaceState = true;
@@ -277,11 +324,29 @@ void AssetRenderEngine::renderShadow(IEffect::Pass * /* overridePass */)
 
 void AssetRenderEngine::renderZPlot(IEffect::Pass * /* overridePass */)
 {
-    if (!m_modelRef || !m_modelRef->isVisible())
+    if (!m_modelRef || !m_modelRef->isVisible() || !m_context->assetProgram)
         return;
-    const aiScene *a = m_modelRef->aiScenePtr();
+    const Array<asset::Model::MaterialBatch> &batches = m_modelRef->materialBatches();
+    const int nbatches = batches.count();
+    float matrix4x4[16];
+    Program *program = m_context->assetProgram;
     disable(kGL_CULL_FACE);
-    renderZPlotRecurse(a, a->mRootNode);
+    program->bind();
+    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
+                                       IApplicationContext::kWorldMatrix
+                                       | IApplicationContext::kViewMatrix
+                                       | IApplicationContext::kProjectionMatrix
+                                       | IApplicationContext::kCameraMatrix);
+    program->setModelViewProjectionMatrix(matrix4x4);
+    bindVertexBundle();
+    for (int i = 0; i < nbatches; i++) {
+        const asset::Model::MaterialBatch &batch = batches[i];
+        if (batch.hasOpacity && btFuzzyZero(batch.opacity - 0.98f))
+            continue;
+        drawElements(PrimitiveModeOf(batch), batch.nindices, kGL_UNSIGNED_INT, reinterpret_cast<const GLvoid *>(batch.indexOffset * sizeof(uint32)));
+    }
+    unbindVertexBundle();
+    program->unbind();
     enable(kGL_CULL_FACE);
 }
 
@@ -295,74 +360,62 @@ bool AssetRenderEngine::upload(void *userData)
     if (!m_modelRef) {
         return false;
     }
-    const aiScene *scene = m_modelRef->aiScenePtr();
-    if (!scene) {
+    const Array<asset::Model::MaterialBatch> &batches = m_modelRef->materialBatches();
+    const int nbatches = batches.count();
+    if (nbatches == 0) {
         return false;
     }
     bool ret = true;
-    const unsigned int nmaterials = scene->mNumMaterials;
-    aiString texturePath;
-    std::string path, mainTexture, subTexture;
-    for (unsigned int i = 0; i < nmaterials; i++) {
-        aiMaterial *material = scene->mMaterials[i];
-        aiReturn found = AI_SUCCESS;
-        int textureIndex = 0;
-        while (found == AI_SUCCESS) {
-            found = material->GetTexture(aiTextureType_DIFFUSE, textureIndex, &texturePath);
-            path = texturePath.data;
-            if (SplitTexturePath(path, mainTexture, subTexture)) {
-                if (m_context->textures[mainTexture] == 0) {
-                    IString *mainTexturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(mainTexture.c_str()));
-                    if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(mainTexturePath, 0, userData)) {
-                        m_context->textures[mainTexture] = m_context->allocatedTextures.insert(texturePtr, texturePtr);
-                        VPVL2_VLOG(2, "Loaded a main texture: name=" << internal::cstr(mainTexturePath, "(null)") << " ID=" << texturePtr);
-                        internal::deleteObject(mainTexturePath);
-                    }
-                    else {
-                        internal::deleteObject(mainTexturePath);
-                        return ret;
-                    }
-                }
-                if (m_context->textures[subTexture] == 0) {
-                    IString *subTexturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(subTexture.c_str()));
-                    if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(subTexturePath, 0, userData)) {
-                        m_context->textures[subTexture] = m_context->allocatedTextures.insert(texturePtr, texturePtr);
-                        VPVL2_VLOG(2, "Loaded a sub texture: name=" << internal::cstr(subTexturePath, "(null)") << " ID=" << texturePtr);
-                        internal::deleteObject(subTexturePath);
-                    }
-                    else {
-                        internal::deleteObject(subTexturePath);
-                        return ret;
-                    }
-                }
-            }
-            else if (m_context->textures[mainTexture] == 0) {
-                IString *mainTexturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(mainTexture.c_str()));
-                if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(mainTexturePath, 0, userData)) {
-                    m_context->textures[mainTexture] = m_context->allocatedTextures.insert(texturePtr, texturePtr);
-                    VPVL2_VLOG(2, "Loaded a main texture: name=" << internal::cstr(mainTexturePath, "(null)") << " ID=" << texturePtr);
-                    internal::deleteObject(mainTexturePath);
-                }
-                else {
-                    internal::deleteObject(mainTexturePath);
-                    return ret;
-                }
+    std::string mainTexture, subTexture;
+    for (int i = 0; i < nbatches; i++) {
+        const std::string &path = batches[i].texturePath;
+        if (path.empty()) {
+            continue;
+        }
+        if (SplitTexturePath(path, mainTexture, subTexture)) {
+            if (!uploadTexture(mainTexture, userData) || !uploadTexture(subTexture, userData)) {
+                return ret;
             }
-            textureIndex++;
         }
+        else if (!uploadTexture(mainTexture, userData)) {
+            return ret;
+        }
+    }
+    const IApplicationContext::FunctionResolver *resolver = m_applicationContextRef->sharedFunctionResolverInstance();
+    Program *assetProgram = m_context->assetProgram = new Program(resolver);
+    if (!createProgram(assetProgram,
+                       IApplicationContext::kModelVertexShader,
+                       IApplicationContext::kModelFragmentShader,
+                       userData)) {
+        return ret;
     }
-    ret = uploadRecurse(scene, scene->mRootNode, userData);
+    ZPlotProgram *zplotProgram = m_context->zplotProgram = new ZPlotProgram(resolver);
+    if (!createProgram(zplotProgram,
+                       IApplicationContext::kZPlotVertexShader,
+                       IApplicationContext::kZPlotFragmentShader,
+                       userData)) {
+        return ret;
+    }
+    const Array<asset::Model::MeshVertex> &meshVertices = m_modelRef->meshVertices();
+    const int nvertices = meshVertices.count();
+    Vertices assetVertices;
+    Vertex assetVertex;
+    assetVertices.reserve(nvertices);
+    for (int i = 0; i < nvertices; i++) {
+        const asset::Model::MeshVertex &vertex = meshVertices[i];
+        const Vector3 &position = vertex.position;
+        assetVertex.position.setValue(position.x(), position.y(), position.z(), 1);
+        assetVertex.normal = vertex.normal;
+        assetVertex.texcoord = vertex.texcoord;
+        assetVertices.append(assetVertex);
+    }
+    createVertexBundle(assetVertices, m_modelRef->meshIndices());
     m_modelRef->setVisible(ret);
     return ret;
 }
 
 void AssetRenderEngine::release()
 {
-    if (m_modelRef) {
-        if (const aiScene *scene = m_modelRef->aiScenePtr()) {
-            deleteRecurse(scene, scene->mRootNode);
-        }
-    }
     internal::deleteObject(m_context);
     m_modelRef = 0;
 }
@@ -422,96 +475,31 @@ bool AssetRenderEngine::testVisible()
     return true;
 }
 
-bool AssetRenderEngine::uploadRecurse(const aiScene *scene, const aiNode *node, void *userData)
+bool AssetRenderEngine::uploadTexture(const std::string &path, void *userData)
 {
-    bool ret = true;
-    const unsigned int nmeshes = node->mNumMeshes;
-    const IApplicationContext::FunctionResolver *resolver = m_applicationContextRef->sharedFunctionResolverInstance();
-    Program *assetProgram = m_context->assetPrograms[node] = new Program(resolver);
-    if (!createProgram(assetProgram,
-                       IApplicationContext::kModelVertexShader,
-                       IApplicationContext::kModelFragmentShader,
-                       userData)) {
-        return ret;
-    }
-    ZPlotProgram *zplotProgram = m_context->zplotPrograms[node] = new ZPlotProgram(resolver);
-    if (!createProgram(zplotProgram,
-                       IApplicationContext::kZPlotVertexShader,
-                       IApplicationContext::kZPlotFragmentShader,
-                       userData)) {
-        return ret;
-    }
-    Vertices assetVertices;
-    Vertex assetVertex;
-    Array<int> vertexIndices;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const unsigned int nfaces = mesh->mNumFaces;
-        for (unsigned int j = 0; j < nfaces; j++) {
-            const struct aiFace &face = mesh->mFaces[j];
-            const unsigned int nindices = face.mNumIndices;
-            for (unsigned int k = 0; k < nindices; k++) {
-                int vertexIndex = face.mIndices[k];
-                vertexIndices.append(vertexIndex);
-            }
+    if (m_context->textures[path] == 0) {
+        IString *texturePath = m_applicationContextRef->toUnicode(reinterpret_cast<const uint8 *>(path.c_str()));
+        if (ITexture *texturePtr = m_applicationContextRef->uploadModelTexture(texturePath, 0, userData)) {
+            m_context->textures[path] = m_context->allocatedTextures.insert(texturePtr, texturePtr);
+            VPVL2_VLOG(2, "Loaded a texture: name=" << internal::cstr(texturePath, "(null)") << " ID=" << texturePtr);
+            internal::deleteObject(texturePath);
         }
-        const bool hasNormals = mesh->HasNormals();
-        const bool hasTexCoords = mesh->HasTextureCoords(0);
-        const aiVector3D *vertices = mesh->mVertices;
-        const aiVector3D *normals = hasNormals ? mesh->mNormals : 0;
-        const aiVector3D *texcoords = hasTexCoords ? mesh->mTextureCoords[0] : 0;
-        const unsigned int nvertices = mesh->mNumVertices;
-        for (unsigned int j = 0; j < nvertices; j++) {
-            const aiVector3D &vertex = vertices[j];
-            assetVertex.position.setValue(vertex.x, vertex.y, vertex.z, 1);
-            if (normals) {
-                const aiVector3D &normal = normals[j];
-                assetVertex.normal.setValue(normal.x, normal.y, normal.z);
-            }
-            if (texcoords) {
-                const aiVector3D &texcoord = texcoords[j];
-                assetVertex.texcoord.setValue(texcoord.x, texcoord.y, texcoord.z);
-            }
-            assetVertices.append(assetVertex);
+        else {
+            internal::deleteObject(texturePath);
+            return false;
         }
-        createVertexBundle(mesh, assetVertices, vertexIndices);
-        assetVertices.clear();
-        vertexIndices.clear();
-        unbindVertexBundle(mesh);
-    }
-    const unsigned int nChildNodes = node->mNumChildren;
-    for (unsigned int i = 0; i < nChildNodes; i++) {
-        ret = uploadRecurse(scene, node->mChildren[i], userData);
-        if (!ret)
-            return ret;
-    }
-    return ret;
-}
-
-void AssetRenderEngine::deleteRecurse(const aiScene *scene, const aiNode *node)
-{
-    const unsigned int nmeshes = node->mNumMeshes;
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        internal::deleteObject(m_context->vao[mesh]);
-        internal::deleteObject(m_context->vbo[mesh]);
     }
-    internal::deleteObject(m_context->assetPrograms[node]);
-    internal::deleteObject(m_context->zplotPrograms[node]);
-    const unsigned int nChildNodes = node->mChildren ? node->mNumChildren : 0;
-    for (unsigned int i = 0; i < nChildNodes; i++)
-        deleteRecurse(scene, node->mChildren[i]);
+    return true;
 }
 
-void AssetRenderEngine::setAssetMaterial(const aiMaterial *material, Program *program)
+void AssetRenderEngine::setAssetMaterial(int batchIndex, Program *program)
 {
-    int textureIndex = 0;
+    const asset::Model::MaterialBatch &batch = m_modelRef->materialBatches()[batchIndex];
     const ITexture *textureRef = 0;
     std::string mainTexture, subTexture;
-    aiString texturePath;
-    if (material->GetTexture(aiTextureType_DIFFUSE, textureIndex, &texturePath) == aiReturn_SUCCESS) {
+    if (!batch.texturePath.empty()) {
         bool isAdditive = false;
-        if (SplitTexturePath(texturePath.data, mainTexture, subTexture)) {
+        if (SplitTexturePath(batch.texturePath, mainTexture, subTexture)) {
             textureRef = m_context->textures[subTexture];
             isAdditive = subTexture.find(".spa") != std::string::npos;
             program->setSubTexture(textureRef);
@@ -528,51 +516,30 @@ void AssetRenderEngine::setAssetMaterial(const aiMaterial *material, Program *pr
         program->setMainTexture(0);
         program->setSubTexture(0);
     }
-    aiColor4D ambient, diffuse, specular;
+    const Color &ambient = batch.ambient, &diffuse = batch.diffuse, &specular = batch.specular;
     const Vector3 &lc = m_sceneRef->lightRef()->color();
     Color la, mc, md, ms;
-    aiGetMaterialColor(material, AI_MATKEY_COLOR_AMBIENT, &ambient);
-    aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &diffuse);
     la.setValue(0.7f - lc.x(), 0.7f - lc.y(), 0.7f - lc.z(), 1.0);
-    mc.setValue(diffuse.r * la.x() + ambient.r, diffuse.g * la.y() + ambient.g, diffuse.b * la.z() + ambient.b, diffuse.a);
-    md.setValue(diffuse.r, diffuse.g, diffuse.b, diffuse.a);
+    mc.setValue(diffuse.x() * la.x() + ambient.x(), diffuse.y() * la.y() + ambient.y(), diffuse.z() * la.z() + ambient.z(), diffuse.w());
+    md.setValue(diffuse.x(), diffuse.y(), diffuse.z(), diffuse.w());
     program->setMaterialColor(mc);
     program->setMaterialDiffuse(md);
-    aiGetMaterialColor(material, AI_MATKEY_COLOR_SPECULAR, &specular);
-    ms.setValue(specular.r * lc.x(), specular.g * lc.y(), specular.b * lc.z(), specular.a);
+    ms.setValue(specular.x() * lc.x(), specular.y() * lc.y(), specular.z() * lc.z(), specular.w());
     program->setMaterialSpecular(ms);
-    float shininess, strength;
-    int ret1 = aiGetMaterialFloat(material, AI_MATKEY_SHININESS, &shininess);
-    int ret2 = aiGetMaterialFloat(material, AI_MATKEY_SHININESS_STRENGTH, &strength);
-    if (ret1 == aiReturn_SUCCESS && ret2 == aiReturn_SUCCESS) {
-        program->setMaterialShininess(shininess * strength);
-    }
-    else if (ret1 == aiReturn_SUCCESS) {
-        program->setMaterialShininess(shininess);
-    }
-    else {
-        program->setMaterialShininess(15.0f);
-    }
-    float opacity;
-    if (aiGetMaterialFloat(material, AI_MATKEY_OPACITY, &opacity) == aiReturn_SUCCESS) {
-        program->setOpacity(opacity * m_modelRef->opacity());
-    }
-    else {
-        program->setOpacity(m_modelRef->opacity());
-    }
+    program->setMaterialShininess(batch.hasShininess ? batch.shininess : 15.0f);
+    program->setOpacity(batch.opacity * m_modelRef->opacity());
     GLuint textureID = 0;
     if (const IShadowMap *shadowMap = m_sceneRef->shadowMapRef()) {
         const void *textureRef = shadowMap->textureRef();
         textureID = textureRef ? *static_cast<const GLuint *>(textureRef) : 0;
     }
-    if (textureID && !btFuzzyZero(opacity - 0.98f)) {
+    if (textureID && !btFuzzyZero(batch.opacity - 0.98f)) {
         program->setDepthTexture(textureID);
     }
     else {
         program->setDepthTexture(0);
     }
-    int twoside;
-    if (aiGetMaterialInteger(material, AI_MATKEY_TWOSIDED, &twoside) == aiReturn_SUCCESS && twoside && !m_context->cullFaceState) {
+    if (batch.isTwoSided && !m_context->cullFaceState) {
         enable(kGL_CULL_FACE);
         m_context->cullFaceState = true;
     }
@@ -582,76 +549,6 @@ void AssetRenderEngine::setAssetMaterial(const aiMaterial *material, Program *pr
     }
 }
 
-void AssetRenderEngine::renderRecurse(const aiScene *scene, const aiNode *node)
-{
-    const unsigned int nmeshes = node->mNumMeshes;
-    float matrix4x4[16];
-    Program *program = m_context->assetPrograms[node];
-    program->bind();
-    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
-                                       IApplicationContext::kViewMatrix
-                                       | IApplicationContext::kProjectionMatrix
-                                       | IApplicationContext::kCameraMatrix);
-    program->setViewProjectionMatrix(matrix4x4);
-    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
-                                       IApplicationContext::kWorldMatrix
-                                       | IApplicationContext::kViewMatrix
-                                       | IApplicationContext::kProjectionMatrix
-                                       | IApplicationContext::kLightMatrix);
-    program->setLightViewProjectionMatrix(matrix4x4);
-    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
-                                       IApplicationContext::kWorldMatrix
-                                       | IApplicationContext::kCameraMatrix);
-    program->setModelMatrix(matrix4x4);
-    const ILight *light = m_sceneRef->lightRef();
-    program->setLightColor(light->color());
-    program->setLightDirection(light->direction());
-    program->setOpacity(m_modelRef->opacity());
-    program->setCameraPosition(m_sceneRef->cameraRef()->lookAt());
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        setAssetMaterial(scene->mMaterials[mesh->mMaterialIndex], program);
-        bindVertexBundle(mesh);
-        vsize nindices = m_context->indices[mesh];
-        drawElements(kGL_TRIANGLES, nindices, kGL_UNSIGNED_INT, 0);
-        unbindVertexBundle(mesh);
-    }
-    program->unbind();
-    const unsigned int nChildNodes = node->mNumChildren;
-    for (unsigned int i = 0; i < nChildNodes; i++)
-        renderRecurse(scene, node->mChildren[i]);
-}
-
-void AssetRenderEngine::renderZPlotRecurse(const aiScene *scene, const aiNode *node)
-{
-    static const Vertex v;
-    float matrix4x4[16], opacity;
-    const unsigned int nmeshes = node->mNumMeshes;
-    Program *program = m_context->assetPrograms[node];
-    program->bind();
-    m_applicationContextRef->getMatrix(matrix4x4, m_modelRef,
-                                       IApplicationContext::kWorldMatrix
-                                       | IApplicationContext::kViewMatrix
-                                       | IApplicationContext::kProjectionMatrix
-                                       | IApplicationContext::kCameraMatrix);
-    program->setModelViewProjectionMatrix(matrix4x4);
-    for (unsigned int i = 0; i < nmeshes; i++) {
-        const struct aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        const struct aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        bool succeeded = aiGetMaterialFloat(material, AI_MATKEY_OPACITY, &opacity) == aiReturn_SUCCESS;
-        if (succeeded && btFuzzyZero(opacity - 0.98f))
-            continue;
-        bindVertexBundle(mesh);
-        vsize nindices = m_context->indices[mesh];
-        drawElements(kGL_TRIANGLES, nindices, kGL_UNSIGNED_INT, 0);
-        unbindVertexBundle(mesh);
-    }
-    program->unbind();
-    const unsigned int nChildNodes = node->mNumChildren;
-    for (unsigned int i = 0; i < nChildNodes; i++)
-        renderZPlotRecurse(scene, node->mChildren[i]);
-}
-
 bool AssetRenderEngine::createProgram(BaseShaderProgram *program,
                                       IApplicationContext::ShaderType vertexShaderType,
                                       IApplicationContext::ShaderType fragmentShaderType,
@@ -661,6 +558,7 @@ bool AssetRenderEngine::createProgram(BaseShaderProgram *program,
     IString *fragmentShaderSource = 0;
     vertexShaderSource = m_applicationContextRef->loadShaderSource(vertexShaderType, m_modelRef, userData);
     fragmentShaderSource = m_applicationContextRef->loadShaderSource(fragmentShaderType, m_modelRef, userData);
+    program->setBinaryCacheRef(m_applicationContextRef->sharedProgramBinaryCacheInstance());
     program->addShaderSource(vertexShaderSource, ShaderProgram::kGL_VERTEX_SHADER);
     program->addShaderSource(fragmentShaderSource, ShaderProgram::kGL_FRAGMENT_SHADER);
     bool ok = program->linkProgram();
@@ -669,45 +567,40 @@ bool AssetRenderEngine::createProgram(BaseShaderProgram *program,
     return ok;
 }
 
-void AssetRenderEngine::createVertexBundle(const aiMesh *mesh,
-                                           const Vertices &vertices,
-                                           const Indices &indices)
+void AssetRenderEngine::createVertexBundle(const Vertices &vertices, const Indices &indices)
 {
     const IApplicationContext::FunctionResolver *resolver = m_applicationContextRef->sharedFunctionResolverInstance();
-    m_context->vao.insert(std::make_pair(mesh, new VertexBundleLayout(resolver)));
-    m_context->vbo.insert(std::make_pair(mesh, new VertexBundle(resolver)));
-    VertexBundle *bundle = m_context->vbo[mesh];
+    VertexBundleLayout *layout = m_context->vao = new VertexBundleLayout(resolver);
+    VertexBundle *bundle = m_context->vbo = new VertexBundle(resolver);
     vsize isize = sizeof(indices[0]) * indices.count();
     bundle->create(VertexBundle::kIndexBuffer, 0, VertexBundle::kGL_STATIC_DRAW, &indices[0], isize);
     VPVL2_VLOG(2, "Binding asset index buffer to the vertex buffer object");
     vsize vsize = vertices.count() * sizeof(vertices[0]);
     bundle->create(VertexBundle::kVertexBuffer, 0, VertexBundle::kGL_STATIC_DRAW, &vertices[0].position, vsize);
     VPVL2_VLOG(2, "Binding asset vertex buffer to the vertex buffer object");
-    VertexBundleLayout *layout = m_context->vao[mesh];
     if (layout->create() && layout->bind()) {
         VPVL2_VLOG(2, "Created an vertex array object: " << layout->name());
     }
     bundle->bind(VertexBundle::kVertexBuffer, 0);
     bindStaticVertexAttributePointers();
     bundle->bind(VertexBundle::kIndexBuffer, 0);
-    unbindVertexBundle(mesh);
-    m_context->indices[mesh] = indices.count();
+    unbindVertexBundle();
 }
 
-void AssetRenderEngine::bindVertexBundle(const aiMesh *mesh)
+void AssetRenderEngine::bindVertexBundle()
 {
-    if (!m_context->vao[mesh]->bind()) {
-        VertexBundle *bundle = m_context->vbo[mesh];
+    if (!m_context->vao->bind()) {
+        VertexBundle *bundle = m_context->vbo;
         bundle->bind(VertexBundle::kVertexBuffer, 0);
         bindStaticVertexAttributePointers();
         bundle->bind(VertexBundle::kIndexBuffer, 0);
     }
 }
 
-void AssetRenderEngine::unbindVertexBundle(const aiMesh *mesh)
+void AssetRenderEngine::unbindVertexBundle()
 {
-    if (!m_context->vao[mesh]->unbind()) {
-        VertexBundle *bundle = m_context->vbo[mesh];
+    if (!m_context->vao->unbind()) {
+        VertexBundle *bundle = m_context->vbo;
         bundle->unbind(VertexBundle::kVertexBuffer);
         bundle->unbind(VertexBundle::kIndexBuffer);
     }
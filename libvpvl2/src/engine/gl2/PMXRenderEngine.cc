@@ -40,11 +40,14 @@
 #include "vpvl2/vpvl2.h"
 
 #include "EngineCommon.h"
+#include "vpvl2/gl/RingBuffer.h"
 #include "vpvl2/gl/VertexBundle.h"
 #include "vpvl2/gl/VertexBundleLayout.h"
+#include "vpvl2/internal/ModelHelper.h"
 #include "vpvl2/internal/util.h" /* internal::snprintf */
 #include "vpvl2/gl2/PMXRenderEngine.h"
 #include "vpvl2/cl/PMXAccelerator.h"
+#include "vpvl2/pmx/Model.h"
 
 using namespace vpvl2::VPVL2_VERSION_NS;
 using namespace vpvl2::VPVL2_VERSION_NS::gl;
@@ -389,22 +392,29 @@ namespace gl2
 class PMXRenderEngine::PrivateContext
 {
 public:
-    PrivateContext(const IModel *model, const IApplicationContext::FunctionResolver *resolver, bool isVertexShaderSkinning)
-        : modelRef(model),
+    PrivateContext(const IModel *model, IApplicationContext *applicationContextRef, bool isVertexShaderSkinning)
+        : applicationContextRef(applicationContextRef),
+          modelRef(model),
+          sharedDataRef(0),
           indexBuffer(0),
           staticBuffer(0),
           dynamicBuffer(0),
           matrixBuffer(0),
+          ringBuffer(0),
           edgeProgram(0),
           modelProgram(0),
           shadowProgram(0),
           zplotProgram(0),
-          buffer(resolver),
+          buffer(applicationContextRef->sharedFunctionResolverInstance()),
           aabbMin(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY),
           aabbMax(-SIMD_INFINITY, -SIMD_INFINITY, -SIMD_INFINITY),
+          lastCameraPosition(SIMD_INFINITY, SIMD_INFINITY, SIMD_INFINITY),
+          lastEdgeWidth(0),
           cullFaceState(true),
           isVertexShaderSkinning(isVertexShaderSkinning),
-          updateEven(true)
+          updateEven(true),
+          enableExactAabb(false),
+          enableSkipUnchanged(false)
     {
         model->getIndexBuffer(indexBuffer);
         model->getStaticVertexBuffer(staticBuffer);
@@ -427,6 +437,7 @@ public:
             indexType = kGL_UNSIGNED_INT;
             break;
         }
+        const IApplicationContext::FunctionResolver *resolver = applicationContextRef->sharedFunctionResolverInstance();
         for (int i = 0; i < kMaxVertexArrayObjectType; i++) {
             bundles[i] = new VertexBundleLayout(resolver);
         }
@@ -435,7 +446,9 @@ public:
         for (int i = 0; i < kMaxVertexArrayObjectType; i++) {
             internal::deleteObject(bundles[i]);
         }
+        releaseSharedStaticBuffers();
         allocatedTextures.releaseAll();
+        internal::deleteObject(ringBuffer);
         internal::deleteObject(indexBuffer);
         internal::deleteObject(dynamicBuffer);
         internal::deleteObject(staticBuffer);
@@ -447,8 +460,112 @@ public:
         aabbMax.setZero();
         cullFaceState = false;
         isVertexShaderSkinning = false;
+        enableExactAabb = false;
+        enableSkipUnchanged = false;
+        applicationContextRef = 0;
     }
 
+    void performSkinning(void *address, const Vector3 &cameraPosition) {
+        internal::ModelHelper::performSkinning(modelRef, dynamicBuffer, address, cameraPosition, enableExactAabb,
+                                               exactAabbBuffer, exactAabbs, aabbMin, aabbMax);
+    }
+
+    bool createRingBuffer(const IApplicationContext::FunctionResolver *resolver) {
+        internal::deleteObject(ringBuffer);
+        ringBuffer = new RingBuffer(resolver);
+        if (ringBuffer->create(dynamicBuffer->size())) {
+            /* the ring buffer owns the name, draws select the current segment by the base vertex */
+            buffer.share(VertexBundle::kVertexBuffer, kModelDynamicVertexBufferEven, ringBuffer->name());
+            updateEven = false;
+            return true;
+        }
+        internal::deleteObject(ringBuffer);
+        return false;
+    }
+    GLint ringBaseVertex() const {
+        if (ringBuffer) {
+            return GLint(ringBuffer->segmentOffset() / dynamicBuffer->strideSize());
+        }
+        return 0;
+    }
+    /* compares bone transforms, morph weights and the camera with the last uploaded frame */
+    bool testPoseChanged(const Vector3 &cameraPosition) {
+        bool changed = lastCameraPosition != cameraPosition || lastEdgeWidth != modelRef->edgeWidth();
+        lastCameraPosition = cameraPosition;
+        lastEdgeWidth = modelRef->edgeWidth();
+        modelRef->getBoneRefs(boneRefs);
+        const int nbones = boneRefs.count();
+        if (lastBoneTransforms.count() != nbones) {
+            lastBoneTransforms.resize(nbones);
+            changed = true;
+        }
+        for (int i = 0; i < nbones; i++) {
+            const Transform &transform = boneRefs[i]->localTransform();
+            if (!(lastBoneTransforms[i] == transform)) {
+                lastBoneTransforms[i] = transform;
+                changed = true;
+            }
+        }
+        modelRef->getMorphRefs(morphRefs);
+        const int nmorphs = morphRefs.count();
+        if (lastMorphWeights.count() != nmorphs) {
+            lastMorphWeights.resize(nmorphs);
+            changed = true;
+        }
+        for (int i = 0; i < nmorphs; i++) {
+            const IMorph::WeightPrecision &weight = morphRefs[i]->weight();
+            if (lastMorphWeights[i] != weight) {
+                lastMorphWeights[i] = weight;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+    bool acquireSharedStaticBuffers() {
+        if (modelRef->type() == IModel::kPMXModel) {
+            sharedDataRef = static_cast<const pmx::Model *>(modelRef)->sharedDataRef();
+        }
+        if (sharedDataRef) {
+            /* static buffers belong to the GL context, so they are registered to the application context */
+            if (IApplicationContext::SharedModelBuffers *buffers = applicationContextRef->findSharedModelBuffersRef(sharedDataRef)) {
+                buffer.share(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer, buffers->staticVertexBuffer);
+                buffer.share(VertexBundle::kIndexBuffer, kModelIndexBuffer, buffers->indexBuffer);
+                buffers->refCount++;
+                return true;
+            }
+        }
+        return false;
+    }
+    void registerSharedStaticBuffers() {
+        if (sharedDataRef) {
+            GLuint staticVertexBuffer = buffer.findName(kModelStaticVertexBuffer), indexBuffer = buffer.indexBufferName();
+            IApplicationContext::SharedModelBuffers buffers;
+            buffers.staticVertexBuffer = staticVertexBuffer;
+            buffers.indexBuffer = indexBuffer;
+            buffers.refCount = 1;
+            if (applicationContextRef->addSharedModelBuffers(sharedDataRef, buffers)) {
+                buffer.share(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer, staticVertexBuffer);
+                buffer.share(VertexBundle::kIndexBuffer, kModelIndexBuffer, indexBuffer);
+            }
+            else {
+                /* the application context does not keep shared buffers, so this engine owns them */
+                sharedDataRef = 0;
+            }
+        }
+    }
+    void releaseSharedStaticBuffers() {
+        if (sharedDataRef) {
+            if (IApplicationContext::SharedModelBuffers *buffers = applicationContextRef->findSharedModelBuffersRef(sharedDataRef)) {
+                if (--buffers->refCount == 0) {
+                    /* the last engine deletes buffers with its own bundle */
+                    buffer.unshare(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer);
+                    buffer.unshare(VertexBundle::kIndexBuffer, kModelIndexBuffer);
+                    applicationContextRef->removeSharedModelBuffers(sharedDataRef);
+                }
+            }
+            sharedDataRef = 0;
+        }
+    }
     void getVertexBundleType(VertexArrayObjectType &vao, VertexBufferObjectType &vbo) {
         if (updateEven) {
             vao = kVertexArrayObjectOdd;
@@ -470,11 +587,14 @@ public:
         }
     }
 
+    IApplicationContext *applicationContextRef;
     const IModel *modelRef;
+    const void *sharedDataRef;
     IModel::IndexBuffer *indexBuffer;
     IModel::StaticVertexBuffer *staticBuffer;
     IModel::DynamicVertexBuffer *dynamicBuffer;
     IModel::MatrixBuffer *matrixBuffer;
+    RingBuffer *ringBuffer;
     EdgeProgram *edgeProgram;
     ModelProgram *modelProgram;
     ShadowProgram *shadowProgram;
@@ -484,14 +604,24 @@ public:
     GLenum indexType;
     PointerHash<HashPtr, ITexture> allocatedTextures;
     Array<MaterialTextureRefs> materialTextureRefs;
+    Array<uint8> exactAabbBuffer;
+    Array<Vector3> exactAabbs;
     Vector3 aabbMin;
     Vector3 aabbMax;
+    Array<IBone *> boneRefs;
+    Array<IMorph *> morphRefs;
+    Array<Transform> lastBoneTransforms;
+    Array<IMorph::WeightPrecision> lastMorphWeights;
+    Vector3 lastCameraPosition;
+    IVertex::EdgeSizePrecision lastEdgeWidth;
 #ifdef VPVL2_ENABLE_OPENCL
     cl::PMXAccelerator::VertexBufferBridgeArray buffers;
 #endif
     bool cullFaceState;
     bool isVertexShaderSkinning;
     bool updateEven;
+    bool enableExactAabb;
+    bool enableSkipUnchanged;
 };
 
 PMXRenderEngine::PMXRenderEngine(IApplicationContext *applicationContextRef,
@@ -502,6 +632,7 @@ PMXRenderEngine::PMXRenderEngine(IApplicationContext *applicationContextRef,
       enable(reinterpret_cast<PFNGLENABLEPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glEnable"))),
       disable(reinterpret_cast<PFNGLDISABLEPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glDisable"))),
       drawElements(reinterpret_cast<PFNGLDRAWELEMENTSPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glDrawElements"))),
+      drawElementsBaseVertex(0),
       genQueries(reinterpret_cast<PFNGLGENQUERIESPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glGenQueries"))),
       beginQuery(reinterpret_cast<PFNGLBEGINQUERYPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glBeginQuery"))),
       endQuery(reinterpret_cast<PFNGLENDQUERYPROC>(applicationContextRef->sharedFunctionResolverInstance()->resolveSymbol("glEndQuery"))),
@@ -513,8 +644,12 @@ PMXRenderEngine::PMXRenderEngine(IApplicationContext *applicationContextRef,
       m_applicationContextRef(applicationContextRef),
       m_sceneRef(scene),
       m_modelRef(modelRef),
-      m_context(new PrivateContext(modelRef, applicationContextRef->sharedFunctionResolverInstance(), m_sceneRef->accelerationType() == Scene::kVertexShaderAccelerationType1))
+      m_context(new PrivateContext(modelRef, applicationContextRef, m_sceneRef->accelerationType() == Scene::kVertexShaderAccelerationType1))
 {
+    const IApplicationContext::FunctionResolver *resolver = applicationContextRef->sharedFunctionResolverInstance();
+    if (resolver->query(IApplicationContext::FunctionResolver::kQueryVersion) >= gl::makeVersion(3, 2) || resolver->hasExtension("ARB_draw_elements_base_vertex")) {
+        drawElementsBaseVertex = reinterpret_cast<PFNGLDRAWELEMENTSBASEVERTEXPROC>(resolver->resolveSymbol("glDrawElementsBaseVertex"));
+    }
 }
 
 PMXRenderEngine::~PMXRenderEngine()
@@ -541,7 +676,7 @@ bool PMXRenderEngine::upload(void *userData)
     const IApplicationContext::FunctionResolver *resolver = m_applicationContextRef->sharedFunctionResolverInstance();
     if (!m_context) {
         vss = m_sceneRef->accelerationType() == Scene::kVertexShaderAccelerationType1;
-        m_context = new PrivateContext(m_modelRef, resolver, vss);
+        m_context = new PrivateContext(m_modelRef, m_applicationContextRef, vss);
     }
     vss = m_context->isVertexShaderSkinning;
     EdgeProgram *edgeProgram = m_context->edgeProgram = new EdgeProgram(resolver);
@@ -580,20 +715,37 @@ bool PMXRenderEngine::upload(void *userData)
         return false;
     }
     VertexBundle &buffer = m_context->buffer;
-    buffer.create(VertexBundle::kVertexBuffer, kModelDynamicVertexBufferEven, VertexBundle::kGL_DYNAMIC_DRAW, 0, m_context->dynamicBuffer->size());
-    buffer.create(VertexBundle::kVertexBuffer, kModelDynamicVertexBufferOdd, VertexBundle::kGL_DYNAMIC_DRAW, 0, m_context->dynamicBuffer->size());
-    VPVL2_VLOG(2, "Binding model dynamic vertex buffer to the vertex buffer object: size=" << m_context->dynamicBuffer->size());
-    const IModel::StaticVertexBuffer *staticBuffer = m_context->staticBuffer;
-    buffer.create(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer, VertexBundle::kGL_STATIC_DRAW, 0, staticBuffer->size());
-    buffer.bind(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer);
-    void *address = buffer.map(VertexBundle::kVertexBuffer, 0, staticBuffer->size());
-    staticBuffer->update(address);
-    VPVL2_VLOG(2, "Binding model static vertex buffer to the vertex buffer object: ptr=" << address << " size=" << staticBuffer->size());
-    buffer.unmap(VertexBundle::kVertexBuffer, address);
-    buffer.unbind(VertexBundle::kVertexBuffer);
-    const IModel::IndexBuffer *indexBuffer = m_context->indexBuffer;
-    buffer.create(VertexBundle::kIndexBuffer, kModelIndexBuffer, VertexBundle::kGL_STATIC_DRAW, indexBuffer->bytes(), indexBuffer->size());
-    VPVL2_VLOG(2, "Binding indices to the vertex buffer object: ptr=" << indexBuffer->bytes() << " size=" << indexBuffer->size());
+    bool useRingBuffer = drawElementsBaseVertex != 0;
+#ifdef VPVL2_ENABLE_OPENCL
+    /* the accelerator writes into the even and odd buffers */
+    useRingBuffer &= !(m_accelerator && m_accelerator->isAvailable());
+#endif
+    if (useRingBuffer && m_context->createRingBuffer(resolver)) {
+        VPVL2_VLOG(2, "Binding model dynamic vertex buffer to the ring buffer: size=" << m_context->dynamicBuffer->size());
+    }
+    else {
+        buffer.create(VertexBundle::kVertexBuffer, kModelDynamicVertexBufferEven, VertexBundle::kGL_DYNAMIC_DRAW, 0, m_context->dynamicBuffer->size());
+        buffer.create(VertexBundle::kVertexBuffer, kModelDynamicVertexBufferOdd, VertexBundle::kGL_DYNAMIC_DRAW, 0, m_context->dynamicBuffer->size());
+        VPVL2_VLOG(2, "Binding model dynamic vertex buffer to the vertex buffer object: size=" << m_context->dynamicBuffer->size());
+    }
+    m_context->releaseSharedStaticBuffers();
+    if (m_context->acquireSharedStaticBuffers()) {
+        VPVL2_VLOG(2, "Sharing static vertex buffer and indices of the instanced model: shared=" << m_context->sharedDataRef);
+    }
+    else {
+        const IModel::StaticVertexBuffer *staticBuffer = m_context->staticBuffer;
+        buffer.create(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer, VertexBundle::kGL_STATIC_DRAW, 0, staticBuffer->size());
+        buffer.bind(VertexBundle::kVertexBuffer, kModelStaticVertexBuffer);
+        void *address = buffer.map(VertexBundle::kVertexBuffer, 0, staticBuffer->size());
+        staticBuffer->update(address);
+        VPVL2_VLOG(2, "Binding model static vertex buffer to the vertex buffer object: ptr=" << address << " size=" << staticBuffer->size());
+        buffer.unmap(VertexBundle::kVertexBuffer, address);
+        buffer.unbind(VertexBundle::kVertexBuffer);
+        const IModel::IndexBuffer *indexBuffer = m_context->indexBuffer;
+        buffer.create(VertexBundle::kIndexBuffer, kModelIndexBuffer, VertexBundle::kGL_STATIC_DRAW, indexBuffer->bytes(), indexBuffer->size());
+        VPVL2_VLOG(2, "Binding indices to the vertex buffer object: ptr=" << indexBuffer->bytes() << " size=" << indexBuffer->size());
+        m_context->registerSharedStaticBuffers();
+    }
     VertexBundleLayout *bundleME = m_context->bundles[kVertexArrayObjectEven];
     if (bundleME->create() && bundleME->bind()) {
         VPVL2_VLOG(2, "Binding an vertex array object for even frame: " << bundleME->name());
@@ -601,7 +753,7 @@ bool PMXRenderEngine::upload(void *userData)
     }
     bundleME->unbind();
     VertexBundleLayout *bundleMO = m_context->bundles[kVertexArrayObjectOdd];
-    if (bundleMO->create() && bundleMO->bind()) {
+    if (!m_context->ringBuffer && bundleMO->create() && bundleMO->bind()) {
         VPVL2_VLOG(2, "Binding an vertex array object for odd frame: " << bundleMO->name());
         createVertexBundle(kModelDynamicVertexBufferOdd);
     }
@@ -613,7 +765,7 @@ bool PMXRenderEngine::upload(void *userData)
     }
     bundleEE->unbind();
     VertexBundleLayout *bundleEO = m_context->bundles[kEdgeVertexArrayObjectOdd];
-    if (bundleEO->create() && bundleEO->bind()) {
+    if (!m_context->ringBuffer && bundleEO->create() && bundleEO->bind()) {
         VPVL2_VLOG(2, "Binding an edge vertex array object for odd frame: " << bundleEO->name());
         createEdgeBundle(kModelDynamicVertexBufferOdd);
     }
@@ -654,13 +806,30 @@ void PMXRenderEngine::update()
 {
     if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
         return;
+    if (RingBuffer *ringBuffer = m_context->ringBuffer) {
+        const Vector3 &cameraPosition = m_sceneRef->cameraRef()->position();
+        /* an unchanged pose keeps drawing the segment written last */
+        if (m_context->enableSkipUnchanged && !m_context->testPoseChanged(cameraPosition)) {
+            return;
+        }
+        if (void *address = ringBuffer->begin()) {
+            m_context->performSkinning(address, cameraPosition);
+            if (m_context->isVertexShaderSkinning) {
+                m_context->matrixBuffer->update(address);
+            }
+            ringBuffer->markDirty(0, m_context->dynamicBuffer->size());
+            ringBuffer->end();
+        }
+        m_modelRef->setAabb(m_context->aabbMin, m_context->aabbMax);
+        return;
+    }
     VertexBufferObjectType vbo = m_context->updateEven
             ? kModelDynamicVertexBufferEven : kModelDynamicVertexBufferOdd;
     IModel::DynamicVertexBuffer *dynamicBuffer = m_context->dynamicBuffer;
     m_context->buffer.bind(VertexBundle::kVertexBuffer, vbo);
     if (void *address = m_context->buffer.map(VertexBundle::kVertexBuffer, 0, dynamicBuffer->size())) {
         const ICamera *camera = m_sceneRef->cameraRef();
-        dynamicBuffer->performTransform(address, camera->position());
+        m_context->performSkinning(address, camera->position());
         if (m_context->isVertexShaderSkinning) {
             m_context->matrixBuffer->update(address);
         }
@@ -682,12 +851,14 @@ void PMXRenderEngine::setUpdateOptions(int options)
     if (m_context) {
         IModel::DynamicVertexBuffer *dynamicBuffer = m_context->dynamicBuffer;
         dynamicBuffer->setParallelUpdateEnable(internal::hasFlagBits(options, kParallelUpdate));
+        m_context->enableExactAabb = internal::hasFlagBits(options, kExactAabbUpdate);
+        m_context->enableSkipUnchanged = internal::hasFlagBits(options, kSkipUnchangedUpdate);
     }
 }
 
 void PMXRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
 {
-    if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
+    if (!m_modelRef || !m_modelRef->isVisible() || !m_context || m_sceneRef->isModelCulled(m_modelRef, Scene::kCullingViewFrustum))
         return;
     ModelProgram *modelProgram = m_context->modelProgram;
     modelProgram->bind();
@@ -725,8 +896,7 @@ void PMXRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
     Array<IMaterial *> materials;
     m_modelRef->getMaterialRefs(materials);
     const int nmaterials = materials.count();
-    const bool hasModelTransparent = !btFuzzyZero(opacity - 1.0f),
-            isVertexShaderSkinning = m_context->isVertexShaderSkinning;
+    const bool hasModelTransparent = !btFuzzyZero(opacity - 1.0f);
     const Vector3 &lc = light->color();
     bool &cullFaceState = m_context->cullFaceState;
     Color diffuse, specular;
@@ -734,6 +904,10 @@ void PMXRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
     bindVertexBundle();
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
+        if (m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingViewFrustum)) {
+            offset += material->indexRange().count * size;
+            continue;
+        }
         const MaterialTextureRefs &materialPrivate = m_context->materialTextureRefs[i];
         const Color &ma = material->ambient(), &md = material->diffuse(), &ms = material->specular();
         diffuse.setValue(ma.x() + md.x() * lc.x(), ma.y() + md.y() * lc.y(), ma.z() + md.z() * lc.z(), md.w());
@@ -751,10 +925,6 @@ void PMXRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
             modelProgram->setDepthTexture(textureID);
         else
             modelProgram->setDepthTexture(0);
-        if (isVertexShaderSkinning) {
-            const IModel::MatrixBuffer *matrixBuffer = m_context->matrixBuffer;
-            modelProgram->setBoneMatrices(matrixBuffer->bytes(i), matrixBuffer->size(i));
-        }
         if (!hasModelTransparent && cullFaceState && material->isCullingDisabled()) {
             disable(kGL_CULL_FACE);
             cullFaceState = false;
@@ -764,7 +934,7 @@ void PMXRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
             cullFaceState = true;
         }
         const int nindices = material->indexRange().count;
-        drawElements(kGL_TRIANGLES, nindices, m_context->indexType, reinterpret_cast<const GLvoid *>(offset));
+        drawMaterial(modelProgram, i, nindices, offset);
         offset += nindices * size;
     }
     unbindVertexBundle();
@@ -777,7 +947,7 @@ void PMXRenderEngine::renderModel(IEffect::Pass * /* overridePass */)
 
 void PMXRenderEngine::renderShadow(IEffect::Pass * /* overridePass */)
 {
-    if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
+    if (!m_modelRef || !m_modelRef->isVisible() || !m_context || m_sceneRef->isModelCulled(m_modelRef, Scene::kCullingGroundShadow))
         return;
     ShadowProgram *shadowProgram = m_context->shadowProgram;
     shadowProgram->bind();
@@ -794,19 +964,14 @@ void PMXRenderEngine::renderShadow(IEffect::Pass * /* overridePass */)
     Array<IMaterial *> materials;
     m_modelRef->getMaterialRefs(materials);
     const int nmaterials = materials.count();
-    const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
     vsize offset = 0, size = m_context->indexBuffer->strideSize();
     bindVertexBundle();
     disable(kGL_CULL_FACE);
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
-        if (material->isCastingShadowEnabled()) {
-            if (isVertexShaderSkinning) {
-                const IModel::MatrixBuffer *matrixBuffer = m_context->matrixBuffer;
-                shadowProgram->setBoneMatrices(matrixBuffer->bytes(i), matrixBuffer->size(i));
-            }
-            drawElements(kGL_TRIANGLES, nindices, m_context->indexType, reinterpret_cast<const GLvoid *>(offset));
+        if (material->isCastingShadowEnabled() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingGroundShadow)) {
+            drawMaterial(shadowProgram, i, nindices, offset);
         }
         offset += nindices * size;
     }
@@ -817,7 +982,8 @@ void PMXRenderEngine::renderShadow(IEffect::Pass * /* overridePass */)
 
 void PMXRenderEngine::renderEdge(IEffect::Pass * /* overridePass */)
 {
-    if (!m_modelRef || !m_modelRef->isVisible() || btFuzzyZero(Scalar(m_modelRef->edgeWidth())) || !m_context)
+    if (!m_modelRef || !m_modelRef->isVisible() || btFuzzyZero(Scalar(m_modelRef->edgeWidth())) || !m_context
+            || m_sceneRef->isModelCulled(m_modelRef, Scene::kCullingEdge))
         return;
     EdgeProgram *edgeProgram = m_context->edgeProgram;
     edgeProgram->bind();
@@ -850,13 +1016,11 @@ void PMXRenderEngine::renderEdge(IEffect::Pass * /* overridePass */)
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
         edgeProgram->setColor(material->edgeColor());
-        if (material->isEdgeEnabled()) {
+        if (material->isEdgeEnabled() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingEdge)) {
             if (isVertexShaderSkinning) {
-                const IModel::MatrixBuffer *matrixBuffer = m_context->matrixBuffer;
-                edgeProgram->setBoneMatrices(matrixBuffer->bytes(i), matrixBuffer->size(i));
                 edgeProgram->setSize(Scalar(material->edgeSize() * edgeScaleFactor));
             }
-            drawElements(kGL_TRIANGLES, nindices, m_context->indexType, reinterpret_cast<const GLvoid *>(offset));
+            drawMaterial(edgeProgram, i, nindices, offset);
         }
         offset += nindices * size;
     }
@@ -870,7 +1034,7 @@ void PMXRenderEngine::renderEdge(IEffect::Pass * /* overridePass */)
 
 void PMXRenderEngine::renderZPlot(IEffect::Pass * /* overridePass */)
 {
-    if (!m_modelRef || !m_modelRef->isVisible() || !m_context)
+    if (!m_modelRef || !m_modelRef->isVisible() || !m_context || m_sceneRef->isModelCulled(m_modelRef, Scene::kCullingShadowFrustum))
         return;
     ExtendedZPlotProgram *zplotProgram = m_context->zplotProgram;
     zplotProgram->bind();
@@ -884,19 +1048,14 @@ void PMXRenderEngine::renderZPlot(IEffect::Pass * /* overridePass */)
     Array<IMaterial *> materials;
     m_modelRef->getMaterialRefs(materials);
     const int nmaterials = materials.count();
-    const bool isVertexShaderSkinning = m_context->isVertexShaderSkinning;
     vsize offset = 0, size = m_context->indexBuffer->strideSize();
     bindVertexBundle();
     disable(kGL_CULL_FACE);
     for (int i = 0; i < nmaterials; i++) {
         const IMaterial *material = materials[i];
         const int nindices = material->indexRange().count;
-        if (material->isCastingShadowMapEnabled()) {
-            if (isVertexShaderSkinning) {
-                const IModel::MatrixBuffer *matrixBuffer = m_context->matrixBuffer;
-                zplotProgram->setBoneMatrices(matrixBuffer->bytes(i), matrixBuffer->size(i));
-            }
-            drawElements(kGL_TRIANGLES, nindices, m_context->indexType, reinterpret_cast<const GLvoid *>(offset));
+        if (material->isCastingShadowMapEnabled() && !m_sceneRef->isMaterialCulled(m_modelRef, i, Scene::kCullingShadowFrustum)) {
+            drawMaterial(zplotProgram, i, nindices, offset);
         }
         offset += nindices * size;
     }
@@ -965,6 +1124,7 @@ bool PMXRenderEngine::createProgram(BaseShaderProgram *program,
         vertexShaderSource = m_applicationContextRef->loadShaderSource(vertexShaderType, m_modelRef, userData);
     }
     fragmentShaderSource = m_applicationContextRef->loadShaderSource(fragmentShaderType, m_modelRef, userData);
+    program->setBinaryCacheRef(m_applicationContextRef->sharedProgramBinaryCacheInstance());
     program->addShaderSource(vertexShaderSource, ShaderProgram::kGL_VERTEX_SHADER);
     program->addShaderSource(fragmentShaderSource, ShaderProgram::kGL_FRAGMENT_SHADER);
     bool ok = program->linkProgram();
@@ -1142,7 +1302,8 @@ void PMXRenderEngine::bindStaticVertexAttributePointers()
                         size, reinterpret_cast<const GLvoid *>(offset));
     enableVertexAttribArray(IModel::Buffer::kTextureCoordStride);
     if (m_context->isVertexShaderSkinning) {
-        offset = staticBuffer->strideOffset(IModel::StaticVertexBuffer::kBoneIndexStride);
+        /* the skinning shaders index the palette of the subset being drawn */
+        offset = staticBuffer->strideOffset(IModel::StaticVertexBuffer::kBonePaletteIndexStride);
         vertexAttribPointer(IModel::Buffer::kBoneIndexStride, 4, kGL_FLOAT, kGL_FALSE,
                             size, reinterpret_cast<const GLvoid *>(offset));
         enableVertexAttribArray(IModel::Buffer::kBoneIndexStride);
@@ -1153,6 +1314,36 @@ void PMXRenderEngine::bindStaticVertexAttributePointers()
     }
 }
 
+void PMXRenderEngine::drawIndices(int nindices, vsize offset)
+{
+    if (m_context->ringBuffer) {
+        drawElementsBaseVertex(kGL_TRIANGLES, nindices, m_context->indexType, reinterpret_cast<const GLvoid *>(offset), m_context->ringBaseVertex());
+    }
+    else {
+        drawElements(kGL_TRIANGLES, nindices, m_context->indexType, reinterpret_cast<const GLvoid *>(offset));
+    }
+}
+
+template<typename TProgram>
+void PMXRenderEngine::drawMaterial(TProgram *program, int materialIndex, int nindices, vsize offset)
+{
+    if (m_context->isVertexShaderSkinning) {
+        /* draw each subset with only its own bone palette */
+        const IModel::MatrixBuffer *matrixBuffer = m_context->matrixBuffer;
+        const vsize size = m_context->indexBuffer->strideSize();
+        const int nsubsets = matrixBuffer->countSubsets(materialIndex);
+        for (int i = 0; i < nsubsets; i++) {
+            int subsetOffset = 0, subsetCount = 0;
+            matrixBuffer->getSubsetIndexRange(materialIndex, i, subsetOffset, subsetCount);
+            program->setBoneMatrices(matrixBuffer->bytes(materialIndex, i), matrixBuffer->size(materialIndex, i));
+            drawIndices(subsetCount, offset + subsetOffset * size);
+        }
+    }
+    else {
+        drawIndices(nindices, offset);
+    }
+}
+
 } /* namespace gl2 */
 } /* namespace VPVL2_VERSION_NS */
 } /* namespace vpvl2 */
@@ -51,6 +51,10 @@
 #endif
 #include <FxParser.h>
 
+#include <sys/stat.h>
+#include <cstdlib>
+#include <sstream>
+
 namespace {
 
 using namespace vpvl2::VPVL2_VERSION_NS;
@@ -77,7 +81,8 @@ static void handleIncludeCallback(const char *incName, FILE *&fp, const char *&b
             VPVL2_VLOG(2, "include=" << s);
             if (FILE *f = fopen(s.c_str(), "r")) {
                 fp = f;
-                break;
+                buf = 0;
+                return;
             }
         }
         fp = 0;
@@ -85,6 +90,238 @@ static void handleIncludeCallback(const char *incName, FILE *&fp, const char *&b
     }
 }
 
+/* tag of the preprocessed effect source stored in IApplicationContext::ProgramBinaryCache */
+static const uint32 kPreprocessedEffectFormat = 0x58465650; /* "VPFX" */
+static const int kMaxIncludeDepth = 16;
+
+struct IncludeDependency {
+    std::string path;
+    uint64 size;
+    uint64 modified;
+};
+
+static std::string absolutePath(const std::string &path)
+{
+#if defined(VPVL2_OS_WINDOWS)
+    char buffer[_MAX_PATH];
+    if (_fullpath(buffer, path.c_str(), sizeof(buffer))) {
+        return buffer;
+    }
+#else
+    if (char *resolved = realpath(path.c_str(), 0)) {
+        const std::string value(resolved);
+        free(resolved);
+        return value;
+    }
+#endif
+    return path;
+}
+
+static bool readFileContent(const std::string &path, std::string &content)
+{
+    if (FILE *fp = fopen(path.c_str(), "rb")) {
+        char buffer[4096];
+        vsize nread = 0;
+        content.clear();
+        while ((nread = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+            content.append(buffer, nread);
+        }
+        fclose(fp);
+        return true;
+    }
+    return false;
+}
+
+static bool statFile(const std::string &path, IncludeDependency &dependency)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        dependency.path = path;
+        dependency.size = st.st_size;
+        dependency.modified = st.st_mtime;
+        return true;
+    }
+    return false;
+}
+
+static bool extractIncludeName(const std::string &line, std::string &name)
+{
+    vsize offset = line.find_first_not_of(" \t");
+    if (offset == std::string::npos || line.compare(offset, 8, "#include") != 0) {
+        return false;
+    }
+    vsize begin = line.find_first_of("\"<", offset + 8);
+    if (begin == std::string::npos) {
+        return false;
+    }
+    vsize end = line.find_first_of(line[begin] == '<' ? ">" : "\"", begin + 1);
+    if (end == std::string::npos) {
+        return false;
+    }
+    name.assign(line, begin + 1, end - begin - 1);
+    return true;
+}
+
+static void appendLineMarker(int line, int sourceIndex, std::string &output)
+{
+    std::ostringstream stream;
+    stream << "#line " << line << " " << sourceIndex << "\n";
+    output.append(stream.str());
+}
+
+static bool preprocessEffectSource(const std::string &source,
+                                   const std::string &name,
+                                   const std::string &baseDirectory,
+                                   int depth,
+                                   int &nsources,
+                                   std::string &output,
+                                   std::vector<IncludeDependency> &dependencies)
+{
+    /*
+     * inlines #include directives the same order as handleIncludeCallback resolves, and marks
+     * each inlined range with #line so compile errors still point to lines of the original file
+     */
+    if (depth > kMaxIncludeDepth) {
+        VPVL2_LOG(WARNING, "Effect includes are nested too deeply: name=" << name << " depth=" << depth);
+        return false;
+    }
+    const int sourceIndex = nsources++;
+    VPVL2_VLOG(2, "Preprocessing effect source: index=" << sourceIndex << " name=" << name);
+    std::istringstream stream(source);
+    std::string line, includeName, path, content;
+    int lineNumber = 0;
+    appendLineMarker(1, sourceIndex, output);
+    while (std::getline(stream, line)) {
+        lineNumber++;
+        if (!extractIncludeName(line, includeName)) {
+            output.append(line);
+            output.append("\n");
+            continue;
+        }
+        bool resolved = false;
+        StringMap::const_iterator it = g_includeBuffers.find(includeName);
+        if (it != g_includeBuffers.end()) {
+            if (!preprocessEffectSource(it->second, includeName, baseDirectory, depth + 1, nsources, output, dependencies)) {
+                return false;
+            }
+            resolved = true;
+        }
+        else {
+            StringList candidates(g_includePaths);
+            candidates.push_back(baseDirectory);
+            for (StringList::const_iterator it2 = candidates.begin(), end = candidates.end(); it2 != end; it2++) {
+                path.assign(*it2);
+                path.append("/");
+                path.append(includeName);
+                IncludeDependency dependency;
+                if (statFile(path, dependency) && readFileContent(path, content)) {
+                    dependencies.push_back(dependency);
+                    if (!preprocessEffectSource(content, path, baseDirectory, depth + 1, nsources, output, dependencies)) {
+                        return false;
+                    }
+                    resolved = true;
+                    break;
+                }
+            }
+        }
+        if (!resolved) {
+            VPVL2_LOG(WARNING, "Cannot resolve the effect include: name=" << includeName << " from=" << name << " line=" << lineNumber);
+            return false;
+        }
+        appendLineMarker(lineNumber + 1, sourceIndex, output);
+    }
+    return true;
+}
+
+static std::string makeEffectCacheKey(const std::string &rootPath, const std::string &baseDirectory, const std::string &source)
+{
+    /*
+     * the same source resolves includes differently by its location, so the absolute location is
+     * a part of the key. in-memory include buffers are also hashed, file includes are validated by
+     * their stamps on restore
+     */
+    uint64 hash = internal::hashBytes(rootPath.c_str(), rootPath.size());
+    hash = internal::hashBytes(baseDirectory.c_str(), baseDirectory.size(), hash);
+    hash = internal::hashBytes(source.c_str(), source.size(), hash);
+    for (StringMap::const_iterator it = g_includeBuffers.begin(), end = g_includeBuffers.end(); it != end; it++) {
+        hash = internal::hashBytes(it->first.c_str(), it->first.size(), hash);
+        hash = internal::hashBytes(it->second.c_str(), it->second.size(), hash);
+    }
+    for (StringList::const_iterator it = g_includePaths.begin(), end = g_includePaths.end(); it != end; it++) {
+        hash = internal::hashBytes(it->c_str(), it->size(), hash);
+    }
+    std::ostringstream stream;
+    stream << "fx-" << std::hex << hash;
+    return stream.str();
+}
+
+template<typename T>
+static void writeValue(const T &value, std::string &bytes)
+{
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template<typename T>
+static bool readValue(const uint8 *&ptr, const uint8 *end, T &value)
+{
+    if (ptr + sizeof(value) > end) {
+        return false;
+    }
+    std::memcpy(&value, ptr, sizeof(value));
+    ptr += sizeof(value);
+    return true;
+}
+
+static void storePreprocessedSource(IApplicationContext::ProgramBinaryCache *cacheRef,
+                                    const std::string &key,
+                                    const std::string &source,
+                                    const std::vector<IncludeDependency> &dependencies)
+{
+    std::string bytes;
+    writeValue(uint32(dependencies.size()), bytes);
+    for (std::vector<IncludeDependency>::const_iterator it = dependencies.begin(), end = dependencies.end(); it != end; it++) {
+        writeValue(uint32(it->path.size()), bytes);
+        bytes.append(it->path);
+        writeValue(it->size, bytes);
+        writeValue(it->modified, bytes);
+    }
+    bytes.append(source);
+    cacheRef->storeProgramBinary(key.c_str(), kPreprocessedEffectFormat, reinterpret_cast<const uint8 *>(bytes.data()), bytes.size());
+}
+
+static bool restorePreprocessedSource(IApplicationContext::ProgramBinaryCache *cacheRef,
+                                      const std::string &key,
+                                      std::string &source)
+{
+    Array<uint8> bytes;
+    uint32 format = 0, ndependencies = 0, length = 0;
+    if (!cacheRef->findProgramBinary(key.c_str(), format, bytes) || format != kPreprocessedEffectFormat || bytes.count() == 0) {
+        return false;
+    }
+    const uint8 *ptr = &bytes[0], *end = ptr + bytes.count();
+    if (!readValue(ptr, end, ndependencies)) {
+        return false;
+    }
+    for (uint32 i = 0; i < ndependencies; i++) {
+        IncludeDependency expected, actual;
+        if (!readValue(ptr, end, length) || ptr + length > end) {
+            return false;
+        }
+        expected.path.assign(reinterpret_cast<const char *>(ptr), length);
+        ptr += length;
+        if (!readValue(ptr, end, expected.size) || !readValue(ptr, end, expected.modified)) {
+            return false;
+        }
+        /* stale if any included file was modified since the source was preprocessed */
+        if (!statFile(expected.path, actual) || actual.size != expected.size || actual.modified != expected.modified) {
+            VPVL2_VLOG(2, "Preprocessed effect cache is stale: key=" << key << " include=" << expected.path);
+            return false;
+        }
+    }
+    source.assign(reinterpret_cast<const char *>(ptr), end - ptr);
+    return true;
+}
+
 static void handleErrorCallback(const char *message)
 {
     VPVL2_LOG(WARNING, message);
@@ -192,8 +429,34 @@ IEffect *EffectContext::compileFromFile(const IString *pathRef, IApplicationCont
 {
     nvFX::IContainer *container = 0;
     if (pathRef) {
+        const std::string path(reinterpret_cast<const char *>(pathRef->toByteArray()));
+        IApplicationContext::ProgramBinaryCache *cacheRef = applicationContextRef ? applicationContextRef->sharedProgramBinaryCacheInstance() : 0;
+        std::string content, source;
+        if (cacheRef && readFileContent(path, content)) {
+            /* compiles from preprocessed source to skip resolving includes on warm start */
+            const std::string &rootPath = absolutePath(path);
+            const vsize offset = rootPath.find_last_of("/\\");
+            const std::string &baseDirectory = offset != std::string::npos ? rootPath.substr(0, offset) : std::string(".");
+            const std::string &key = makeEffectCacheKey(rootPath, baseDirectory, content);
+            if (!restorePreprocessedSource(cacheRef, key, source)) {
+                std::vector<IncludeDependency> dependencies;
+                int nsources = 0;
+                source.clear();
+                if (!preprocessEffectSource(content, rootPath, baseDirectory, 0, nsources, source, dependencies)) {
+                    return 0;
+                }
+                storePreprocessedSource(cacheRef, key, source, dependencies);
+                VPVL2_VLOG(2, "Stored preprocessed effect: path=" << rootPath << " key=" << key << " includes=" << dependencies.size());
+            }
+            container = nvFX::IContainer::create();
+            if (nvFX::loadEffect(container, source.c_str())) {
+                return new nvfx::Effect(this, applicationContextRef, container, pathRef);
+            }
+            nvFX::IContainer::destroy(container);
+            return 0;
+        }
         container = nvFX::IContainer::create();
-        if (nvFX::loadEffectFromFile(container, reinterpret_cast<const char *>(pathRef->toByteArray()))) {
+        if (nvFX::loadEffectFromFile(container, path.c_str())) {
             return new nvfx::Effect(this, applicationContextRef, container, pathRef);
         }
     }
@@ -48,10 +48,59 @@ using namespace vpvl2::VPVL2_VERSION_NS::extensions::icu4c;
 #endif
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <map>
 
-#include "ioapi.h"
-#include "unzip.h"
+#if !defined(VPVL2_OS_WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef VPVL2_LINK_INTEL_TBB
+#include <tbb/tbb.h>
+#endif
+
+#include <zlib.h>
+
+namespace
+{
+
+using namespace vpvl2;
+
+static const uint32 kLocalFileHeaderSignature = 0x04034b50;
+static const uint32 kCentralDirectoryHeaderSignature = 0x02014b50;
+static const uint32 kEndOfCentralDirectorySignature = 0x06054b50;
+static const uint32 kZip64EndOfCentralDirectorySignature = 0x06064b50;
+static const uint32 kZip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+static const vsize kLocalFileHeaderSize = 30;
+static const vsize kCentralDirectoryHeaderSize = 46;
+static const vsize kEndOfCentralDirectorySize = 22;
+static const vsize kZip64EndOfCentralDirectorySize = 56;
+static const vsize kZip64EndOfCentralDirectoryLocatorSize = 20;
+static const uint64 kMaxEntrySize = 0xffffffffull;
+static const vsize kMaxCommentSize = 0xffff;
+static const uint16 kZip64ExtraFieldTag = 0x0001;
+
+static inline uint16 readUInt16(const uint8 *ptr)
+{
+    return uint16(ptr[0] | (ptr[1] << 8));
+}
+
+static inline uint32 readUInt32(const uint8 *ptr)
+{
+    return uint32(ptr[0]) | (uint32(ptr[1]) << 8) | (uint32(ptr[2]) << 16) | (uint32(ptr[3]) << 24);
+}
+
+static inline uint64 readUInt64(const uint8 *ptr)
+{
+    return uint64(readUInt32(ptr)) | (uint64(readUInt32(ptr + 4)) << 32);
+}
+
+} /* namespace anonymous */
 
 namespace vpvl2
 {
@@ -61,8 +110,81 @@ namespace extensions
 {
 
 struct Archive::PrivateContext {
+    struct Entry {
+        Entry()
+            : localHeaderOffset(0),
+              compressedSize(0),
+              uncompressedSize(0),
+              crc(0),
+              method(0)
+        {
+        }
+        std::string rawPath;
+        std::string lowerPath;
+        uint64 localHeaderOffset;
+        uint64 compressedSize;
+        uint64 uncompressedSize;
+        uint32 crc;
+        uint16 method;
+    };
+    struct UncompressJob {
+        UncompressJob(const Entry *entry, std::string *bytes)
+            : entryRef(entry),
+              bytesRef(bytes),
+              result(false)
+        {
+        }
+        const Entry *entryRef;
+        std::string *bytesRef;
+        bool result;
+    };
+    class ParallelUncompressProcessor VPVL2_DECL_FINAL {
+    public:
+        ParallelUncompressProcessor(const PrivateContext *context, Array<UncompressJob *> *jobsRef)
+            : m_contextRef(context),
+              m_jobsRef(jobsRef)
+        {
+        }
+        ~ParallelUncompressProcessor() {
+            m_contextRef = 0;
+            m_jobsRef = 0;
+        }
+
+        inline void performUncompress(int i) const {
+            UncompressJob *job = m_jobsRef->at(i);
+            std::string &bytes = *job->bytesRef;
+            job->result = bytes.empty() || m_contextRef->readEntry(*job->entryRef, reinterpret_cast<uint8 *>(&bytes[0]), bytes.size());
+        }
+#ifdef VPVL2_LINK_INTEL_TBB
+        void operator()(const tbb::blocked_range<int> &range) const {
+            for (int i = range.begin(), end = range.end(); i != end; ++i) {
+                performUncompress(i);
+            }
+        }
+#endif /* VPVL2_LINK_INTEL_TBB */
+        void execute() {
+            const int njobs = m_jobsRef->count();
+#if defined(VPVL2_LINK_INTEL_TBB)
+            tbb::parallel_for(tbb::blocked_range<int>(0, njobs, 1), *this);
+#else
+#ifdef VPVL2_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < njobs; ++i) {
+                performUncompress(i);
+            }
+#endif
+        }
+
+    private:
+        const PrivateContext *m_contextRef;
+        Array<UncompressJob *> *m_jobsRef;
+    };
+
     PrivateContext(IEncoding *encodingRef)
-        : file(0),
+        : address(0),
+          size(0),
+          opaque(-1),
           error(kNone),
           encodingRef(encodingRef)
     {
@@ -71,50 +193,248 @@ struct Archive::PrivateContext {
         close();
     }
 
+    bool mapFile(const std::string &path) {
+#if defined(VPVL2_OS_WINDOWS)
+        /* fallback to read whole file into memory */
+        std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+        if (!stream.good()) {
+            return false;
+        }
+        stream.seekg(0, std::ios::end);
+        size = vsize(stream.tellg());
+        stream.seekg(0, std::ios::beg);
+        address = new uint8[size];
+        if (!stream.read(reinterpret_cast<char *>(address), size).good()) {
+            internal::deleteObjectArray(address);
+            size = 0;
+            return false;
+        }
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat sb;
+        if (::fstat(fd, &sb) == -1 || sb.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void *ptr = ::mmap(0, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        address = static_cast<uint8 *>(ptr);
+        size = sb.st_size;
+        opaque = fd;
+#endif
+        return true;
+    }
+    void unmapFile() {
+#if defined(VPVL2_OS_WINDOWS)
+        internal::deleteObjectArray(address);
+#else
+        if (address) {
+            ::munmap(address, size);
+            address = 0;
+        }
+        if (opaque >= 0) {
+            ::close(int(opaque));
+            opaque = -1;
+        }
+#endif
+        size = 0;
+    }
     bool close() {
         originalEntries.clear();
-        unicodePath2RawPath.clear();
-        int ret = unzClose(file);
-        file = 0;
-        return ret == Z_OK;
+        unicodePath2Entries.clear();
+        unmapFile();
+        return true;
     }
-    bool uncompressEntry(const std::string &entry, const unz_file_info &finfo) {
-        std::string &bytes = originalEntries[entry];
-        uint32 size(finfo.uncompressed_size);
-        bytes.resize(size);
-        VPVL2_VLOG(2, "filename=" << entry << " size=" << size);
-        int err = unzOpenCurrentFile(file);
-        if (err != Z_OK) {
-            VPVL2_LOG(WARNING, "Cannot open the file " << entry << " in zip: " << err);
-            error = kOpenCurrentFileError;
+    bool findEndOfCentralDirectory(uint64 &offset, uint64 &nentries) const {
+        if (size < kEndOfCentralDirectorySize) {
             return false;
         }
-        err = unzReadCurrentFile(file, &bytes[0], size);
-        if (err < 0) {
-            VPVL2_LOG(WARNING, "Cannot read the file " << entry << " in zip: " << err);
-            error = kReadCurrentFileError;
+        /* end of central directory record is placed before the archive comment at the last of file */
+        const vsize lowerBound = size > kEndOfCentralDirectorySize + kMaxCommentSize ? size - kEndOfCentralDirectorySize - kMaxCommentSize : 0;
+        for (vsize i = size - kEndOfCentralDirectorySize + 1; i-- > lowerBound; ) {
+            const uint8 *ptr = address + i;
+            if (readUInt32(ptr) == kEndOfCentralDirectorySignature) {
+                nentries = readUInt16(ptr + 10);
+                offset = readUInt32(ptr + 16);
+                if ((nentries == 0xffff || offset == 0xffffffff) && i >= kZip64EndOfCentralDirectoryLocatorSize) {
+                    const uint8 *locator = ptr - kZip64EndOfCentralDirectoryLocatorSize;
+                    if (readUInt32(locator) == kZip64EndOfCentralDirectoryLocatorSignature) {
+                        const uint64 recordOffset = readUInt64(locator + 8);
+                        if (recordOffset + kZip64EndOfCentralDirectorySize > size) {
+                            return false;
+                        }
+                        const uint8 *record = address + recordOffset;
+                        if (readUInt32(record) != kZip64EndOfCentralDirectorySignature) {
+                            return false;
+                        }
+                        nentries = readUInt64(record + 32);
+                        offset = readUInt64(record + 48);
+                    }
+                }
+                return offset < size;
+            }
+        }
+        return false;
+    }
+    void readZip64ExtraField(const uint8 *ptr, vsize length, Entry &entry, bool hasUncompressedSize, bool hasCompressedSize, bool hasOffset) const {
+        const uint8 *end = ptr + length;
+        while (ptr + 4 <= end) {
+            const uint16 tag = readUInt16(ptr), fieldSize = readUInt16(ptr + 2);
+            const uint8 *field = ptr + 4, *fieldEnd = field + fieldSize;
+            if (fieldEnd > end) {
+                break;
+            }
+            if (tag == kZip64ExtraFieldTag) {
+                if (hasUncompressedSize && field + 8 <= fieldEnd) {
+                    entry.uncompressedSize = readUInt64(field);
+                    field += 8;
+                }
+                if (hasCompressedSize && field + 8 <= fieldEnd) {
+                    entry.compressedSize = readUInt64(field);
+                    field += 8;
+                }
+                if (hasOffset && field + 8 <= fieldEnd) {
+                    entry.localHeaderOffset = readUInt64(field);
+                }
+                break;
+            }
+            ptr = fieldEnd;
+        }
+    }
+    bool buildIndex(Archive::EntryNames &entries) {
+        uint64 offset = 0, nentries = 0;
+        if (!findEndOfCentralDirectory(offset, nentries)) {
+            VPVL2_LOG(WARNING, "Cannot find the end of central directory record in zip");
+            error = kGetCurrentFileError;
             return false;
         }
-        err = unzCloseCurrentFile(file);
-        if (err != Z_OK) {
-            VPVL2_LOG(WARNING, "Cannot close the file " << entry << " in zip: " << err);
-            error = kCloseCurrentFileError;
+        for (uint64 i = 0; i < nentries; i++) {
+            if (offset + kCentralDirectoryHeaderSize > size) {
+                error = kGetCurrentFileError;
+                return false;
+            }
+            const uint8 *ptr = address + offset;
+            if (readUInt32(ptr) != kCentralDirectoryHeaderSignature) {
+                VPVL2_LOG(WARNING, "Invalid central directory header signature at " << offset << " in zip");
+                error = kGoToNextFileError;
+                return false;
+            }
+            const vsize filenameLength = readUInt16(ptr + 28), extraLength = readUInt16(ptr + 30), commentLength = readUInt16(ptr + 32);
+            const uint64 recordSize = kCentralDirectoryHeaderSize + filenameLength + extraLength + commentLength;
+            if (offset + recordSize > size) {
+                error = kGetCurrentFileError;
+                return false;
+            }
+            Entry entry;
+            entry.method = readUInt16(ptr + 10);
+            entry.crc = readUInt32(ptr + 16);
+            entry.compressedSize = readUInt32(ptr + 20);
+            entry.uncompressedSize = readUInt32(ptr + 24);
+            entry.localHeaderOffset = readUInt32(ptr + 42);
+            entry.rawPath.assign(reinterpret_cast<const char *>(ptr + kCentralDirectoryHeaderSize), filenameLength);
+            readZip64ExtraField(ptr + kCentralDirectoryHeaderSize + filenameLength, extraLength, entry,
+                                entry.uncompressedSize == 0xffffffff, entry.compressedSize == 0xffffffff, entry.localHeaderOffset == 0xffffffff);
+            /* an unreadable entry is skipped so other entries of the archive can be still read */
+            offset += recordSize;
+            if (entry.method != 0 && entry.method != Z_DEFLATED) {
+                VPVL2_LOG(WARNING, "Skipped unsupported compression method " << entry.method << " of " << entry.rawPath << " in zip");
+                continue;
+            }
+            else if (entry.compressedSize > kMaxEntrySize || entry.uncompressedSize > kMaxEntrySize) {
+                /* zlib takes sizes as uInt */
+                VPVL2_LOG(WARNING, "Skipped too large entry " << entry.rawPath << " (" << entry.uncompressedSize << " bytes) in zip");
+                continue;
+            }
+            const uint8 *rawPathPtr = reinterpret_cast<const uint8 *>(entry.rawPath.data());
+            IString *s = encodingRef->toString(rawPathPtr, entry.rawPath.size(), IString::kShiftJIS);
+            const std::string &value = String::toStdString(static_cast<const String *>(s)->value());
+            /* normalize filename with lower */
+            entry.lowerPath = String::toStdString(static_cast<const String *>(s)->value().toLower());
+            entries.push_back(value);
+            unicodePath2Entries.insert(std::make_pair(value, entry));
+            internal::deleteObject(s);
+        }
+        return true;
+    }
+    const uint8 *findEntryData(const Entry &entry) const {
+        /* local file header may have different length of extra field from central directory */
+        const uint64 offset = entry.localHeaderOffset;
+        if (offset + kLocalFileHeaderSize > size) {
+            return 0;
+        }
+        const uint8 *ptr = address + offset;
+        if (readUInt32(ptr) != kLocalFileHeaderSignature) {
+            return 0;
+        }
+        const uint64 dataOffset = offset + kLocalFileHeaderSize + readUInt16(ptr + 26) + readUInt16(ptr + 28);
+        if (dataOffset + entry.compressedSize > size) {
+            return 0;
+        }
+        return address + dataOffset;
+    }
+    bool readEntry(const Entry &entry, uint8 *buffer, vsize bufferSize) const {
+        /* this method only reads the mapped memory and can be called from multiple threads */
+        const uint8 *data = findEntryData(entry);
+        if (!data || bufferSize < entry.uncompressedSize) {
+            return false;
+        }
+        if (entry.method == 0) {
+            std::memcpy(buffer, data, vsize(entry.uncompressedSize));
+        }
+        else {
+            z_stream stream;
+            std::memset(&stream, 0, sizeof(stream));
+            /* negative window bits means raw deflate stream without zlib header */
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+                return false;
+            }
+            stream.next_in = const_cast<Bytef *>(data);
+            stream.avail_in = uInt(entry.compressedSize);
+            stream.next_out = buffer;
+            stream.avail_out = uInt(entry.uncompressedSize);
+            int ret = inflate(&stream, Z_FINISH);
+            inflateEnd(&stream);
+            if (ret != Z_STREAM_END || stream.total_out != entry.uncompressedSize) {
+                return false;
+            }
+        }
+        return crc32(crc32(0, 0, 0), buffer, uInt(entry.uncompressedSize)) == entry.crc;
+    }
+    bool uncompressEntry(const std::string &key, const Entry &entry) {
+        std::string &bytes = originalEntries[key];
+        bytes.resize(vsize(entry.uncompressedSize));
+        VPVL2_VLOG(2, "filename=" << key << " size=" << entry.uncompressedSize);
+        if (!bytes.empty() && !readEntry(entry, reinterpret_cast<uint8 *>(&bytes[0]), bytes.size())) {
+            VPVL2_LOG(WARNING, "Cannot read the file " << key << " in zip");
+            originalEntries.erase(key);
+            error = kReadCurrentFileError;
             return false;
         }
         return true;
     }
+    const Entry *findEntry(const std::string &name) const {
+        UnicodePath2EntryMap::const_iterator it = unicodePath2Entries.find(resolvePath(name));
+        return it != unicodePath2Entries.end() ? &it->second : 0;
+    }
     std::string resolvePath(const std::string &value) const {
         return basePath.empty() ? value : basePath + "/" + value;
     }
 
     typedef std::map<std::string, std::string> EntryDataMap;
-    typedef std::map<std::string, std::string> UnicodePath2RawPathMap;
-    unzFile file;
-    unz_global_info header;
+    typedef std::map<std::string, Entry> UnicodePath2EntryMap;
+    uint8 *address;
+    vsize size;
+    intptr_t opaque;
     Archive::ErrorType error;
     const IEncoding *encodingRef;
     EntryDataMap originalEntries;
-    UnicodePath2RawPathMap unicodePath2RawPath;
+    UnicodePath2EntryMap unicodePath2Entries;
     std::string basePath;
 };
 
@@ -130,57 +450,18 @@ Archive::~Archive()
 
 bool Archive::open(const IString *filename, EntryNames &entries)
 {
-    m_context->file = unzOpen(reinterpret_cast<const char *>(filename->toByteArray()));
-    if (m_context->file) {
-        unz_file_info info;
-        std::string path;
-        int err = unzGetGlobalInfo(m_context->file, &m_context->header);
-        if (err == UNZ_OK) {
-            uLong nentries = m_context->header.number_entry;
-            for (uLong i = 0; i < nentries; i++) {
-                err = unzGetCurrentFileInfo(m_context->file, &info, 0, 0, 0, 0, 0, 0);
-                if (err == UNZ_OK && (info.compression_method == 0 || info.compression_method == Z_DEFLATED)) {
-                    path.resize(info.size_filename);
-                    err = unzGetCurrentFileInfo(m_context->file, &info, &path[0], info.size_filename, 0, 0, 0, 0);
-                    if (err == UNZ_OK) {
-                        const uint8 *ptr = reinterpret_cast<const uint8 *>(path.data());
-                        IString *s = m_context->encodingRef->toString(ptr, path.size(), IString::kShiftJIS);
-                        const std::string &value = String::toStdString(static_cast<const String *>(s)->value());
-                        entries.push_back(value);
-                        m_context->unicodePath2RawPath.insert(std::make_pair(value, path));
-                        internal::deleteObject(s);
-                    }
-                    else {
-                        VPVL2_LOG(WARNING, "Cannot get current file " << path << " in zip: " << err);
-                        m_context->error = kGetCurrentFileError;
-                        break;
-                    }
-                }
-                else {
-                    VPVL2_LOG(WARNING, "Cannot get current file " << path << " in zip: " << err);
-                    m_context->error = kGetCurrentFileError;
-                    break;
-                }
-                if (i + 1 < nentries) {
-                    err = unzGoToNextFile(m_context->file);
-                    if (err != UNZ_OK) {
-                        VPVL2_LOG(WARNING, "Cannot seek next current file from " << path << " in zip: " << err);
-                        m_context->error = kGoToNextFileError;
-                        break;
-                    }
-                }
-            }
-            if (err == Z_OK) {
-                err = unzGoToFirstFile(m_context->file);
-                if (err != Z_OK) {
-                    VPVL2_LOG(WARNING, "Cannot seek to the first file in zip: " << err);
-                    m_context->error = kGoToFirstFileError;
-                }
-            }
-        }
-        return err == Z_OK;
+    m_context->close();
+    if (!m_context->mapFile(reinterpret_cast<const char *>(filename->toByteArray()))) {
+        VPVL2_LOG(WARNING, "Cannot map the zip file: " << filename->toByteArray());
+        m_context->error = kMapFileError;
+        return false;
     }
-    return false;
+    /* builds the index of all entries from the central directory once */
+    if (!m_context->buildIndex(entries)) {
+        m_context->close();
+        return false;
+    }
+    return true;
 }
 
 bool Archive::close()
@@ -190,75 +471,78 @@ bool Archive::close()
 
 bool Archive::uncompress(const EntrySet &entries)
 {
-    if (m_context->file == 0) {
+    if (!m_context->address) {
         return false;
     }
-    unz_file_info info;
-    std::string filename, entry;
-    uLong nentries = m_context->header.number_entry;
-    int err = Z_OK;
-    for (uLong i = 0; i < nentries; i++) {
-        err = unzGetCurrentFileInfo(m_context->file, &info, 0, 0, 0, 0, 0, 0);
-        if (err == UNZ_OK && (info.compression_method == 0 || info.compression_method == Z_DEFLATED)) {
-            filename.resize(info.size_filename);
-            err = unzGetCurrentFileInfo(m_context->file, &info, &filename[0], info.size_filename, 0, 0, 0, 0);
-            if (err == UNZ_OK) {
-                const uint8 *ptr = reinterpret_cast<const uint8 *>(filename.data());
-                if (IString *name = m_context->encodingRef->toString(ptr, filename.size(), IString::kShiftJIS)) {
-                    /* normalize filename with lower */
-                    entry.assign(String::toStdString(static_cast<const String *>(name)->value().toLower()));
-                    internal::deleteObject(name);
-                }
-                if (entries.find(entry) != entries.end() && !m_context->uncompressEntry(entry, info)) {
-                    return false;
-                }
-            }
-            else {
-                m_context->error = kGetCurrentFileError;
-                break;
-            }
-        }
-        else {
-            m_context->error = kGetCurrentFileError;
-            break;
-        }
-        if (i + 1 < nentries) {
-            err = unzGoToNextFile(m_context->file);
-            if (err != UNZ_OK) {
-                VPVL2_LOG(WARNING, "Cannot seek next current file in zip: " << err);
-                m_context->error = kGoToNextFileError;
-                break;
-            }
+    /* allocates buffers serially and inflates all of requested entries in parallel */
+    PointerArray<PrivateContext::UncompressJob> jobs;
+    for (PrivateContext::UnicodePath2EntryMap::const_iterator it = m_context->unicodePath2Entries.begin(); it != m_context->unicodePath2Entries.end(); ++it) {
+        const std::string &entry = it->second.lowerPath;
+        if (entries.find(entry) != entries.end()) {
+            std::string &bytes = m_context->originalEntries[entry];
+            bytes.resize(vsize(it->second.uncompressedSize));
+            jobs.append(new PrivateContext::UncompressJob(&it->second, &bytes));
         }
     }
-    if (err == Z_OK) {
-        err = unzGoToFirstFile(m_context->file);
-        if (err != Z_OK) {
-            VPVL2_LOG(WARNING, "Cannot seek to the first file in zip: " << err);
-            m_context->error = kGoToFirstFileError;
+    PrivateContext::ParallelUncompressProcessor processor(m_context, &jobs);
+    processor.execute();
+    bool ok = true;
+    const int njobs = jobs.count();
+    for (int i = 0; i < njobs; i++) {
+        const PrivateContext::UncompressJob *job = jobs[i];
+        if (!job->result) {
+            VPVL2_LOG(WARNING, "Cannot read the file " << job->entryRef->rawPath << " in zip");
+            m_context->error = kReadCurrentFileError;
+            ok = false;
         }
     }
-    return err == Z_OK;
+    jobs.releaseAll();
+    return ok;
 }
 
 bool Archive::uncompressEntry(const std::string &name)
 {
     const std::string &key = m_context->resolvePath(name);
-    PrivateContext::UnicodePath2RawPathMap::const_iterator it = m_context->unicodePath2RawPath.find(key);
-    bool ok = false;
-    if (it != m_context->unicodePath2RawPath.end()) {
-        int err = unzLocateFile(m_context->file, it->second.c_str(), 1);
-        if (err == Z_OK) {
-            unz_file_info finfo;
-            unzGetCurrentFileInfo(m_context->file, &finfo, 0, 0, 0, 0, 0, 0);
-            ok = m_context->uncompressEntry(it->first, finfo);
-            unzGoToFirstFile(m_context->file);
-        }
-        else {
-            VPVL2_LOG(WARNING, "Cannot locate to the file << " << name << " in zip: " << err);
+    PrivateContext::UnicodePath2EntryMap::const_iterator it = m_context->unicodePath2Entries.find(key);
+    if (it != m_context->unicodePath2Entries.end()) {
+        return m_context->originalEntries.find(it->first) != m_context->originalEntries.end() ||
+                m_context->uncompressEntry(it->first, it->second);
+    }
+    VPVL2_LOG(WARNING, "Cannot locate to the file << " << name << " in zip");
+    return false;
+}
+
+vsize Archive::entrySize(const std::string &name) const
+{
+    const PrivateContext::Entry *entry = m_context->findEntry(name);
+    return entry ? vsize(entry->uncompressedSize) : 0;
+}
+
+bool Archive::readEntry(const std::string &name, uint8 *buffer, vsize size) const
+{
+    const PrivateContext::Entry *entry = m_context->findEntry(name);
+    return entry && buffer && m_context->readEntry(*entry, buffer, size);
+}
+
+const uint8 *Archive::storedEntryRef(const std::string &name, vsize &size) const
+{
+    const PrivateContext::Entry *entry = m_context->findEntry(name);
+    if (entry && entry->method == 0) {
+        if (const uint8 *ptr = m_context->findEntryData(*entry)) {
+            size = vsize(entry->uncompressedSize);
+            return ptr;
         }
     }
-    return ok;
+    size = 0;
+    return 0;
+}
+
+void Archive::releaseEntry(const std::string &name)
+{
+    std::string ln = name;
+    std::transform(ln.begin(), ln.end(), ln.begin(), ::tolower);
+    m_context->originalEntries.erase(m_context->resolvePath(name));
+    m_context->originalEntries.erase(m_context->resolvePath(ln));
 }
 
 void Archive::setBasePath(const std::string &value)
@@ -343,6 +343,17 @@ static inline const char *DebugMessageTypeToString(gl::GLenum value)
     }
 }
 
+static inline std::string toNormalizedTexturePath(const IString *name)
+{
+    std::string newName = static_cast<const String *>(name)->toStdString();
+    std::string::size_type pos(newName.find('\\'));
+    while (pos != std::string::npos) {
+        newName.replace(pos, 1, "/");
+        pos = newName.find('\\', pos + 1);
+    }
+    return newName;
+}
+
 static inline IString *toIStringFromUtf8(const std::string &bytes)
 {
     return bytes.empty() ? 0 : String::create(bytes);
@@ -365,6 +376,7 @@ BaseApplicationContext::ModelContext::ModelContext(BaseApplicationContext *appli
       m_maxAnisotropyValue(0),
       m_flipVertically(flipVertically)
 {
+    m_textureDecoder.setCacheRef(applicationContextRef->textureCacheRef());
     IApplicationContext::FunctionResolver *resolver = applicationContextRef->sharedFunctionResolverInstance();
     if (resolver->hasExtension("EXT_texture_filter_anisotropic")) {
         typedef void (GLAPIENTRY * PFNGLGETFLOATVPROC)(GLenum pname, GLfloat *values);
@@ -374,6 +386,7 @@ BaseApplicationContext::ModelContext::ModelContext(BaseApplicationContext *appli
 
 BaseApplicationContext::ModelContext::~ModelContext()
 {
+    m_textureDecoder.release();
     m_archiveRef = 0;
     m_applicationContextRef = 0;
     m_directoryRef = 0;
@@ -419,6 +432,60 @@ void BaseApplicationContext::ModelContext::storeTexture(const std::string &key,
     }
 }
 
+void BaseApplicationContext::ModelContext::prefetchTextures(const IModel *modelRef, bool enableMipmap)
+{
+    VPVL2_DCHECK(modelRef);
+    Array<const IString *> textureRefs;
+    modelRef->getTextureRefs(textureRefs);
+    /* reading encoded bytes is done serially because neither Archive nor mapFile is thread safe */
+    PointerArray<MapBuffer> buffers;
+    PointerArray<Array<uint8> > entries;
+    const String *directoryRef = static_cast<const String *>(m_directoryRef);
+    const int ntextures = textureRefs.count(), flags = (m_flipVertically ? TextureDecoder::kFlipVertically : 0) |
+            (enableMipmap ? TextureDecoder::kGenerateMipmaps : 0);
+    for (int i = 0; i < ntextures; i++) {
+        const std::string &name = toNormalizedTexturePath(textureRefs[i]);
+        if (name.empty()) {
+            continue;
+        }
+        else if (m_archiveRef) {
+            vsize size = 0;
+            if (const uint8 *bytesRef = m_archiveRef->storedEntryRef(name, size)) {
+                /* stored entries are decoded from the mapped archive without copying */
+                m_textureDecoder.addJob(name, bytesRef, size, flags);
+            }
+            else if ((size = m_archiveRef->entrySize(name)) > 0) {
+                Array<uint8> *bytes = entries.append(new Array<uint8>());
+                bytes->resize(int(size));
+                if (m_archiveRef->readEntry(name, &bytes->at(0), size)) {
+                    m_textureDecoder.addJob(name, &bytes->at(0), size, flags);
+                }
+            }
+            /* decoded images are kept by the decoder, so the archive does not have to keep the entry */
+            m_archiveRef->releaseEntry(name);
+        }
+        else if (directoryRef) {
+            const std::string &path = directoryRef->toStdString() + "/" + name;
+            if (m_textureRefCache.find(path) == m_textureRefCache.end() && m_applicationContextRef->existsFile(path)) {
+                MapBuffer *buffer = buffers.append(new MapBuffer(m_applicationContextRef));
+                if (m_applicationContextRef->mapFile(path, buffer)) {
+                    m_textureDecoder.addJob(path, buffer->address, buffer->size, flags);
+                }
+            }
+        }
+    }
+    /* decoding and flipping are done concurrently, uploading is deferred to createTextureFrom* on this thread */
+    m_textureDecoder.decode(true);
+    buffers.releaseAll();
+    entries.releaseAll();
+    VPVL2_VLOG(2, "Prefetched " << m_textureDecoder.countImages() << " textures of " << ntextures);
+}
+
+bool BaseApplicationContext::ModelContext::isTexturePrefetched(const std::string &key) const
+{
+    return m_textureDecoder.findImage(key) != 0;
+}
+
 int BaseApplicationContext::ModelContext::countTextures() const
 {
     return m_textureRefCache.size();
@@ -453,11 +520,17 @@ ITexture *BaseApplicationContext::ModelContext::createTextureFromFile(const std:
     if (findTexture(path, textureRef)) {
         VPVL2_VLOG(2, path << " is already cached, skipped.");
     }
-    else {
-        IStringSmartPtr pathPtr(String::create(path));
-        textureRef = m_applicationContextRef->uploadTextureFromFile(pathPtr.get(), m_flipVertically);
+    else if (const TextureDecoder::Image *imageRef = m_textureDecoder.findImage(path)) {
+        textureRef = m_applicationContextRef->uploadTexture(imageRef);
         storeTexture(path, flags, textureRef);
     }
+    else {
+        /* Loading major image format (BMP/JPG/PNG/TGA/DDS) texture with stb_image.c */
+        MapBuffer buffer(m_applicationContextRef);
+        if (m_applicationContextRef->mapFile(path, &buffer)) {
+            textureRef = createTextureFromMemory(buffer.address, buffer.size, path, flags);
+        }
+    }
     return textureRef;
 }
 
@@ -469,9 +542,15 @@ ITexture *BaseApplicationContext::ModelContext::createTextureFromMemory(const ui
         VPVL2_VLOG(2, key << " is already cached, skipped.");
         return textureRef;
     }
-    textureRef = m_applicationContextRef->uploadTextureFromMemory(data, size, m_flipVertically);
-    if (!textureRef) {
-        VPVL2_LOG(WARNING, "Cannot load texture with key " << key << ": " << stbi_failure_reason());
+    const TextureDecoder::Image *imageRef = m_textureDecoder.findImage(key);
+    if (!imageRef) {
+        /* decodes the texture on this thread (or restores from the texture cache) if it's not prefetched */
+        m_textureDecoder.addJob(key, data, size, m_flipVertically ? TextureDecoder::kFlipVertically : TextureDecoder::kNone);
+        m_textureDecoder.decode(false);
+        imageRef = m_textureDecoder.findImage(key);
+    }
+    if (!imageRef || !(textureRef = m_applicationContextRef->uploadTexture(imageRef))) {
+        VPVL2_LOG(WARNING, "Cannot load texture with key " << key);
         return 0;
     }
     storeTexture(key, flags, textureRef);
@@ -519,6 +598,13 @@ BaseApplicationContext::BaseApplicationContext(Scene *sceneRef, IEncoding *encod
       m_viewportRegionInvalidated(false),
       m_hasDepthClamp(false)
 {
+    /* decoded textures are also written to the directory to skip decoding on next session if specified */
+    m_textureCache.setDirectory(m_configRef->value("dir.cache.textures", std::string()));
+    /* decoded textures no longer used by any model are evicted when the cache exceeds the budget */
+    const int maxTextureCacheMegabytes = m_configRef->value("cache.textures.max.megabytes", int(TextureCache::kDefaultMaxBytes >> 20));
+    m_textureCache.setMaxBytes(vsize(btMax(maxTextureCacheMegabytes, 0)) << 20);
+    /* linked program binaries are shared in this session and also written to the directory if specified */
+    m_programBinaryCache.setDirectory(m_configRef->value("dir.cache.shaders", std::string()));
 }
 
 void BaseApplicationContext::initializeOpenGLContext(bool enableDebug)
@@ -576,12 +662,15 @@ void BaseApplicationContext::release()
     m_basename2ModelRefs.clear();
     m_modelRef2Paths.clear();
     m_sharedParameters.clear();
+    m_sharedModelBuffers.releaseAll();
     m_offscreenTechniques.clear();
     m_effectRef2ModelRefs.clear();
     m_effectRef2Owners.clear();
     m_effectRef2Paths.clear();
     m_effectRef2ParameterUIs.clear();
     m_effectCaches.releaseAll();
+    m_textureCache.release();
+    m_programBinaryCache.release();
     popAnnotationGroup(this);
 }
 
@@ -619,12 +708,7 @@ ITexture *BaseApplicationContext::uploadEffectTexture(const IString *name, const
 ITexture *BaseApplicationContext::uploadModelTexture(const IString *name, int flags, void *userData)
 {
     ModelContext *context = static_cast<ModelContext *>(userData);
-    std::string newName = static_cast<const String *>(name)->toStdString();
-    std::string::size_type pos(newName.find('\\'));
-    while (pos != std::string::npos) {
-        newName.replace(pos, 1, "/");
-        pos = newName.find('\\', pos + 1);
-    }
+    const std::string &newName = toNormalizedTexturePath(name);
     ITexture *texturePtr = 0;
     if (internal::hasFlagBits(flags, IApplicationContext::kToonTexture)) {
         if (!internal::hasFlagBits(flags, IApplicationContext::kSystemToonTexture)) {
@@ -1557,6 +1641,37 @@ void BaseApplicationContext::setSamplesMSAA(int value)
     m_samplesMSAA = value;
 }
 
+TextureCache *BaseApplicationContext::textureCacheRef()
+{
+    return &m_textureCache;
+}
+
+IApplicationContext::ProgramBinaryCache *BaseApplicationContext::sharedProgramBinaryCacheInstance() const
+{
+    return &m_programBinaryCache;
+}
+
+IApplicationContext::SharedModelBuffers *BaseApplicationContext::findSharedModelBuffersRef(const void *key)
+{
+    SharedModelBuffers *const *buffers = m_sharedModelBuffers.find(key);
+    return buffers ? *buffers : 0;
+}
+
+IApplicationContext::SharedModelBuffers *BaseApplicationContext::addSharedModelBuffers(const void *key, const SharedModelBuffers &value)
+{
+    removeSharedModelBuffers(key);
+    return m_sharedModelBuffers.insert(key, new SharedModelBuffers(value));
+}
+
+void BaseApplicationContext::removeSharedModelBuffers(const void *key)
+{
+    if (SharedModelBuffers *const *buffers = m_sharedModelBuffers.find(key)) {
+        SharedModelBuffers *value = *buffers;
+        m_sharedModelBuffers.remove(key);
+        internal::deleteObject(value);
+    }
+}
+
 Scene *BaseApplicationContext::sceneRef() const
 {
     return m_sceneRef;
@@ -1574,6 +1689,10 @@ void BaseApplicationContext::setCameraMatrices(const glm::mat4 &world, const glm
     m_cameraWorldMatrix = world;
     m_cameraViewMatrix = view;
     m_cameraProjectionMatrix = projection;
+    if (m_sceneRef) {
+        const glm::mat4 &viewProjection = projection * view * world;
+        m_sceneRef->setCullingMatrix(Scene::kCullingViewFrustum, glm::value_ptr(viewProjection));
+    }
 }
 
 void BaseApplicationContext::getLightMatrices(glm::mat4 &world, glm::mat4 &view, glm::mat4 &projection) const
@@ -1588,6 +1707,10 @@ void BaseApplicationContext::setLightMatrices(const glm::mat4 &world, const glm:
     m_lightWorldMatrix = world;
     m_lightViewMatrix = view;
     m_lightProjectionMatrix = projection;
+    if (m_sceneRef) {
+        const glm::mat4 &viewProjection = projection * view * world;
+        m_sceneRef->setCullingMatrix(Scene::kCullingShadowFrustum, glm::value_ptr(viewProjection));
+    }
 }
 
 void BaseApplicationContext::updateCameraMatrices()
@@ -1696,12 +1819,39 @@ ITexture *BaseApplicationContext::uploadTexture(const void *ptr, const BaseSurfa
     return texture;
 }
 
+ITexture *BaseApplicationContext::uploadTexture(const TextureDecoder::Image *imageRef) const
+{
+    VPVL2_DCHECK(imageRef && imageRef->isDecoded());
+    FunctionResolver *resolver = sharedFunctionResolverInstance();
+    pushAnnotationGroup("BaseApplicationContext#createTexture", resolver);
+    Texture2D *texture = new (std::nothrow) Texture2D(resolver, defaultTextureFormat(), imageRef->levelSize(0), 0);
+    if (texture) {
+        texture->create();
+        texture->bind();
+        const int nlevels = imageRef->countLevels();
+        if (nlevels > 1) {
+            /* mipmaps are already generated on CPU by TextureDecoder */
+            Array<const void *> levels;
+            for (int i = 0; i < nlevels; i++) {
+                levels.append(imageRef->levelPixels(i));
+            }
+            texture->fillPixelLevels(&levels[0], nlevels);
+        }
+        else {
+            texture->fillPixels(imageRef->levelPixels(0));
+            texture->generateMipmaps();
+        }
+        texture->unbind();
+    }
+    popAnnotationGroup(resolver);
+    return texture;
+}
+
 ITexture *BaseApplicationContext::uploadTextureFromMemory(const uint8 *data, vsize size, bool flipVertically)
 {
     VPVL2_DCHECK(data && size > 0);
     Vector3 textureSize;
     ITexture *texturePtr = 0;
-    int x = 0, y = 0, ncomponents = 0;
 #ifdef VPVL2_LINK_FREEIMAGE
     FIMEMORY *memory = FreeImage_OpenMemory(const_cast<uint8_t *>(data), size);
     FREE_IMAGE_FORMAT format = FreeImage_GetFileTypeFromMemory(memory);
@@ -1730,22 +1880,10 @@ ITexture *BaseApplicationContext::uploadTextureFromMemory(const uint8 *data, vsi
     FreeImage_CloseMemory(memory);
 #endif
     /* Loading major image format (BMP/JPG/PNG/TGA/DDS) texture with stb_image.c */
-    const int rc = 4;
-    if (stbi_uc *ptr = stbi_load_from_memory(data, int(size), &x, &y, &ncomponents, rc)) {
-        textureSize.setValue(Scalar(x), Scalar(y), 1);
-        if (flipVertically) {
-            for (int j = 0, height = y >> 1; j < height; ++j) {
-                stbi_uc *p1 = ptr + j * x * rc;
-                stbi_uc *p2 = ptr + (y - 1 - j) * x * rc;
-                for (int i = 0, width = x * rc; i < width; ++i) {
-                    stbi_uc t = p1[i];
-                    p1[i] = p2[i];
-                    p2[i] = t;
-                }
-            }
-        }
-        texturePtr = uploadTexture(ptr, defaultTextureFormat(), textureSize);
-        stbi_image_free(ptr);
+    TextureDecoder::Image image(std::string(), data, size, flipVertically ? TextureDecoder::kFlipVertically : TextureDecoder::kNone);
+    image.decode();
+    if (image.isDecoded()) {
+        texturePtr = uploadTexture(&image);
     }
     return texturePtr;
 }
@@ -156,6 +156,7 @@ uint8 *Encoding::toByteArray(const IString *value, IString::Codec codec, int &si
         if (data) {
             data[0] = 0;
         }
+        size = 1;
     }
     return data;
 }
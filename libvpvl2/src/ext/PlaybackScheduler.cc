@@ -0,0 +1,373 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include <vpvl2/extensions/PlaybackScheduler.h>
+
+#include <vpvl2/Scene.h>
+#include <vpvl2/extensions/World.h>
+#include <vpvl2/internal/util.h>
+
+#if defined(VPVL2_OS_WINDOWS)
+#include <windows.h>
+#elif defined(VPVL2_OS_OSX) || defined(VPVL2_OS_IOS)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+struct PlaybackScheduler::PrivateContext {
+    static const float64 kMaxClockExtrapolationSeconds;
+    static const float64 kFrameCostSmoothingFactor;
+
+    PrivateContext(Scene *sceneRef, World *worldRef)
+        : sceneRef(sceneRef),
+          worldRef(worldRef),
+          clockRef(0),
+          baseTimeIndex(0),
+          currentTimeIndex(0),
+          baseClockSeconds(0),
+          elapsedSeconds(0),
+          physicsAccumulatorSeconds(0),
+          lastClockSeconds(0),
+          clockChangedAt(0),
+          frameBeganAt(0),
+          lastSlot(-1),
+          physicsFPS(worldRef ? worldRef->baseFPS() : Scalar(60)),
+          maxPhysicsSubSteps(kDefaultMaxPhysicsSubSteps),
+          maxConsecutiveSkips(kDefaultMaxConsecutiveSkips),
+          numConsecutiveSkips(0),
+          lateThreshold(kDefaultLateThreshold),
+          running(false),
+          framePending(false)
+    {
+    }
+    ~PrivateContext() {
+        sceneRef = 0;
+        worldRef = 0;
+        clockRef = 0;
+        running = false;
+        framePending = false;
+    }
+
+    float64 frameInterval() const {
+        const Scalar &fps = sceneRef->preferredFPS();
+        return 1.0 / (fps > 0 ? fps : Scene::defaultFPS());
+    }
+    float64 peekClockSeconds() const {
+        if (clockRef) {
+            const float64 value = clockRef->currentSeconds();
+            if (value != lastClockSeconds) {
+                return value;
+            }
+            /* audio clocks advance per buffer, fill the gap with the monotonic clock */
+            return value + btMin(monotonicClock.currentSeconds() - clockChangedAt, kMaxClockExtrapolationSeconds);
+        }
+        return monotonicClock.currentSeconds();
+    }
+    float64 sampleClockSeconds() {
+        if (clockRef) {
+            const float64 value = clockRef->currentSeconds();
+            if (value != lastClockSeconds) {
+                lastClockSeconds = value;
+                clockChangedAt = monotonicClock.currentSeconds();
+            }
+        }
+        return peekClockSeconds();
+    }
+    void rebase(const IKeyframe::TimeIndex &timeIndex) {
+        if (clockRef) {
+            lastClockSeconds = clockRef->currentSeconds();
+            clockChangedAt = monotonicClock.currentSeconds();
+            baseClockSeconds = lastClockSeconds;
+        }
+        else {
+            baseClockSeconds = monotonicClock.currentSeconds();
+        }
+        baseTimeIndex = currentTimeIndex = timeIndex;
+        elapsedSeconds = 0;
+        physicsAccumulatorSeconds = 0;
+        lastSlot = -1;
+        numConsecutiveSkips = 0;
+        framePending = false;
+    }
+    void stepPhysics(const float64 &deltaSeconds) {
+        if (!worldRef || physicsFPS <= 0 || deltaSeconds <= 0) {
+            return;
+        }
+        const float64 step = 1.0 / physicsFPS;
+        physicsAccumulatorSeconds += deltaSeconds;
+        const int64 nsteps = int64(physicsAccumulatorSeconds / step);
+        physicsAccumulatorSeconds -= nsteps * step;
+        /* drop the remainder instead of spiraling after a long stall */
+        const int64 nperformed = btMin(nsteps, int64(maxPhysicsSubSteps));
+        for (int64 i = 0; i < nperformed; i++) {
+            worldRef->stepFixedSimulation(Scalar(step));
+        }
+        statistics.numPhysicsSteps += nperformed;
+        statistics.numDiscardedPhysicsSteps += nsteps - nperformed;
+    }
+
+    Scene *sceneRef;
+    World *worldRef;
+    IClock *clockRef;
+    MonotonicClock monotonicClock;
+    Statistics statistics;
+    IKeyframe::TimeIndex baseTimeIndex;
+    IKeyframe::TimeIndex currentTimeIndex;
+    float64 baseClockSeconds;
+    float64 elapsedSeconds;
+    float64 physicsAccumulatorSeconds;
+    float64 lastClockSeconds;
+    float64 clockChangedAt;
+    float64 frameBeganAt;
+    int64 lastSlot;
+    Scalar physicsFPS;
+    int maxPhysicsSubSteps;
+    int maxConsecutiveSkips;
+    int numConsecutiveSkips;
+    float64 lateThreshold;
+    bool running;
+    bool framePending;
+};
+
+const float64 PlaybackScheduler::PrivateContext::kMaxClockExtrapolationSeconds = 0.1;
+const float64 PlaybackScheduler::PrivateContext::kFrameCostSmoothingFactor = 0.125;
+const int PlaybackScheduler::kDefaultMaxPhysicsSubSteps = 4;
+const int PlaybackScheduler::kDefaultMaxConsecutiveSkips = 4;
+const float64 PlaybackScheduler::kDefaultLateThreshold = 0.5;
+
+float64 PlaybackScheduler::MonotonicClock::currentSeconds() const
+{
+#if defined(VPVL2_OS_WINDOWS)
+    LARGE_INTEGER counter, frequency;
+    ::QueryPerformanceCounter(&counter);
+    ::QueryPerformanceFrequency(&frequency);
+    return float64(counter.QuadPart) / float64(frequency.QuadPart);
+#elif defined(VPVL2_OS_OSX) || defined(VPVL2_OS_IOS)
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return float64(mach_absolute_time()) * info.numer / info.denom * 1e-9;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return float64(ts.tv_sec) + float64(ts.tv_nsec) * 1e-9;
+#endif
+}
+
+PlaybackScheduler::PlaybackScheduler(Scene *sceneRef, World *worldRef)
+    : m_context(new PrivateContext(sceneRef, worldRef))
+{
+}
+
+PlaybackScheduler::~PlaybackScheduler()
+{
+    internal::deleteObject(m_context);
+}
+
+void PlaybackScheduler::start()
+{
+    if (!m_context->running) {
+        m_context->rebase(m_context->sceneRef->currentTimeIndex());
+        m_context->running = true;
+    }
+}
+
+void PlaybackScheduler::stop()
+{
+    m_context->running = false;
+    m_context->framePending = false;
+}
+
+void PlaybackScheduler::seek(const IKeyframe::TimeIndex &timeIndex)
+{
+    Scene *sceneRef = m_context->sceneRef;
+    m_context->rebase(timeIndex);
+    sceneRef->seekTimeIndex(timeIndex, Scene::kUpdateAll);
+    sceneRef->update(Scene::kUpdateAll | Scene::kResetMotionState);
+}
+
+PlaybackScheduler::FrameStatus PlaybackScheduler::tick()
+{
+    if (!m_context->running) {
+        return kFrameIdle;
+    }
+    const float64 beganAt = m_context->monotonicClock.currentSeconds();
+    /* the clock must not go backward unless #seek is called */
+    const float64 elapsed = btMax(m_context->sampleClockSeconds() - m_context->baseClockSeconds, m_context->elapsedSeconds);
+    m_context->stepPhysics(elapsed - m_context->elapsedSeconds);
+    m_context->elapsedSeconds = elapsed;
+    const float64 interval = m_context->frameInterval();
+    const int64 slot = int64(elapsed / interval);
+    if (slot <= m_context->lastSlot) {
+        return kFrameIdle;
+    }
+    Statistics &statistics = m_context->statistics;
+    statistics.numMissedFrames += slot - m_context->lastSlot - 1;
+    m_context->lastSlot = slot;
+    const float64 slotSeconds = slot * interval;
+    m_context->currentTimeIndex = m_context->baseTimeIndex + IKeyframe::TimeIndex(slotSeconds * Scene::defaultFPS());
+    Scene *sceneRef = m_context->sceneRef;
+    sceneRef->seekTimeIndex(m_context->currentTimeIndex, Scene::kUpdateAll);
+    /* lateness is the projected finish of this frame past the end of its slot */
+    const float64 cost = statistics.averageFrameCostSeconds;
+    const float64 lateness = elapsed + cost - (slotSeconds + interval);
+    statistics.maxLatenessSeconds = btMax(statistics.maxLatenessSeconds, lateness);
+    /* skipping cannot help when a single frame costs more than the interval */
+    if (lateness > m_context->lateThreshold * interval && cost < interval
+            && m_context->numConsecutiveSkips < m_context->maxConsecutiveSkips) {
+        /* keep bones in sync with physics but skip skinning and rendering */
+        sceneRef->update(Scene::kUpdateCamera | Scene::kUpdateLight | Scene::kUpdateModels);
+        statistics.numSkippedFrames++;
+        m_context->numConsecutiveSkips++;
+        return kFrameSkipped;
+    }
+    sceneRef->update(Scene::kUpdateAll);
+    statistics.numPresentedFrames++;
+    m_context->numConsecutiveSkips = 0;
+    m_context->frameBeganAt = beganAt;
+    m_context->framePending = true;
+    return kFramePresent;
+}
+
+void PlaybackScheduler::finishFrame()
+{
+    if (m_context->framePending) {
+        Statistics &statistics = m_context->statistics;
+        const float64 cost = m_context->monotonicClock.currentSeconds() - m_context->frameBeganAt;
+        const float64 &factor = PrivateContext::kFrameCostSmoothingFactor;
+        statistics.averageFrameCostSeconds = statistics.averageFrameCostSeconds > 0
+                ? statistics.averageFrameCostSeconds * (1.0 - factor) + cost * factor : cost;
+        m_context->framePending = false;
+    }
+}
+
+float64 PlaybackScheduler::secondsUntilNextFrame() const
+{
+    if (!m_context->running) {
+        return 0;
+    }
+    const float64 elapsed = m_context->peekClockSeconds() - m_context->baseClockSeconds;
+    const float64 next = (m_context->lastSlot + 1) * m_context->frameInterval();
+    return btMax(next - elapsed, 0.0);
+}
+
+void PlaybackScheduler::resetStatistics()
+{
+    m_context->statistics = Statistics();
+}
+
+bool PlaybackScheduler::isRunning() const
+{
+    return m_context->running;
+}
+
+IKeyframe::TimeIndex PlaybackScheduler::currentTimeIndex() const
+{
+    return m_context->currentTimeIndex;
+}
+
+const PlaybackScheduler::Statistics &PlaybackScheduler::statistics() const
+{
+    return m_context->statistics;
+}
+
+PlaybackScheduler::IClock *PlaybackScheduler::clockRef() const
+{
+    return m_context->clockRef;
+}
+
+void PlaybackScheduler::setClockRef(IClock *value)
+{
+    if (m_context->clockRef != value) {
+        m_context->clockRef = value;
+        if (m_context->running) {
+            m_context->rebase(m_context->currentTimeIndex);
+        }
+    }
+}
+
+Scalar PlaybackScheduler::physicsFPS() const
+{
+    return m_context->physicsFPS;
+}
+
+void PlaybackScheduler::setPhysicsFPS(const Scalar &value)
+{
+    m_context->physicsFPS = value;
+}
+
+int PlaybackScheduler::maxPhysicsSubSteps() const
+{
+    return m_context->maxPhysicsSubSteps;
+}
+
+void PlaybackScheduler::setMaxPhysicsSubSteps(int value)
+{
+    m_context->maxPhysicsSubSteps = btMax(value, 1);
+}
+
+int PlaybackScheduler::maxConsecutiveSkips() const
+{
+    return m_context->maxConsecutiveSkips;
+}
+
+void PlaybackScheduler::setMaxConsecutiveSkips(int value)
+{
+    m_context->maxConsecutiveSkips = btMax(value, 0);
+}
+
+float64 PlaybackScheduler::lateThreshold() const
+{
+    return m_context->lateThreshold;
+}
+
+void PlaybackScheduler::setLateThreshold(const float64 &value)
+{
+    m_context->lateThreshold = value;
+}
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
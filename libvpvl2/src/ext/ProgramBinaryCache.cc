@@ -0,0 +1,169 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/internal/util.h>
+#include <vpvl2/extensions/ProgramBinaryCache.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+struct ProgramBinaryCache::PrivateContext {
+    struct Binary {
+        Binary()
+            : format(0)
+        {
+        }
+        uint32 format;
+        std::string bytes;
+    };
+    typedef std::map<std::string, Binary> BinaryMap;
+    static const char kSignature[8];
+    static const vsize kHeaderSize = sizeof(kSignature) + sizeof(uint32);
+
+    std::string pathOf(const std::string &key) const {
+        return directory + "/" + key + ".vpvl2prog";
+    }
+    bool restore(const std::string &key, Binary &binary) const {
+        std::ifstream stream(pathOf(key).c_str(), std::ios::in | std::ios::binary);
+        if (stream.good()) {
+            const std::string bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            if (bytes.size() > kHeaderSize && std::memcmp(bytes.data(), kSignature, sizeof(kSignature)) == 0) {
+                std::memcpy(&binary.format, bytes.data() + sizeof(kSignature), sizeof(binary.format));
+                binary.bytes.assign(bytes, kHeaderSize, std::string::npos);
+                return true;
+            }
+            VPVL2_LOG(WARNING, "Cannot restore the cached program binary: " << pathOf(key));
+        }
+        return false;
+    }
+    void store(const std::string &key, const Binary &binary) const {
+        /* write to the temporary file and rename it to prevent other sessions from reading incomplete file */
+        const std::string &path = pathOf(key), &temporaryPath = path + ".tmp";
+        std::ofstream stream(temporaryPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (stream.good()
+                && stream.write(kSignature, sizeof(kSignature)).good()
+                && stream.write(reinterpret_cast<const char *>(&binary.format), sizeof(binary.format)).good()
+                && stream.write(binary.bytes.data(), binary.bytes.size()).good()) {
+            stream.close();
+            if (std::rename(temporaryPath.c_str(), path.c_str()) == 0) {
+                return;
+            }
+        }
+        VPVL2_LOG(WARNING, "Cannot write the cached program binary: " << path);
+        std::remove(temporaryPath.c_str());
+    }
+
+    BinaryMap binaries;
+    std::string directory;
+};
+const char ProgramBinaryCache::PrivateContext::kSignature[8] = { 'V', 'P', 'V', 'L', '2', 'P', 'G', 'B' };
+
+ProgramBinaryCache::ProgramBinaryCache()
+    : m_context(new PrivateContext())
+{
+}
+
+ProgramBinaryCache::~ProgramBinaryCache()
+{
+    internal::deleteObject(m_context);
+}
+
+bool ProgramBinaryCache::findProgramBinary(const char *key, uint32 &format, Array<uint8> &bytes)
+{
+    PrivateContext::BinaryMap::const_iterator it = m_context->binaries.find(key);
+    if (it == m_context->binaries.end() && !m_context->directory.empty()) {
+        PrivateContext::Binary binary;
+        if (m_context->restore(key, binary)) {
+            VPVL2_VLOG(2, "Restored the cached program binary: " << m_context->pathOf(key));
+            it = m_context->binaries.insert(std::make_pair(std::string(key), binary)).first;
+        }
+    }
+    if (it != m_context->binaries.end()) {
+        const PrivateContext::Binary &binary = it->second;
+        format = binary.format;
+        bytes.resize(int(binary.bytes.size()));
+        internal::copyBytes(&bytes[0], reinterpret_cast<const uint8 *>(binary.bytes.data()), binary.bytes.size());
+        return true;
+    }
+    return false;
+}
+
+void ProgramBinaryCache::storeProgramBinary(const char *key, uint32 format, const uint8 *bytes, vsize size)
+{
+    PrivateContext::Binary binary;
+    binary.format = format;
+    binary.bytes.assign(reinterpret_cast<const char *>(bytes), size);
+    m_context->binaries[key] = binary;
+    if (!m_context->directory.empty()) {
+        m_context->store(key, binary);
+    }
+}
+
+int ProgramBinaryCache::countBinaries() const
+{
+    return int(m_context->binaries.size());
+}
+
+void ProgramBinaryCache::release()
+{
+    m_context->binaries.clear();
+}
+
+std::string ProgramBinaryCache::directory() const
+{
+    return m_context->directory;
+}
+
+void ProgramBinaryCache::setDirectory(const std::string &value)
+{
+    m_context->directory = value;
+}
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
@@ -38,6 +38,112 @@
 #include <vpvl2/extensions/icu4c/String.h>
 #include <vpvl2/internal/util.h>
 
+#include <unicode/ustring.h>
+#include <unicode/utf8.h>
+
+#if defined(VPVL2_LINK_INTEL_TBB)
+#include <tbb/spin_mutex.h>
+#elif !defined(VPVL2_OS_WINDOWS)
+#include <pthread.h>
+#endif
+
+namespace {
+
+/*
+ * strings are interned from any thread (e.g. motions converted in parallel), so the table
+ * must be locked in every configuration. the fallback locks are POD and initialized
+ * statically so they can be used even while other static objects are being constructed
+ */
+#if defined(VPVL2_LINK_INTEL_TBB)
+typedef tbb::spin_mutex InternerMutex;
+static InternerMutex g_internerMutex;
+#elif defined(VPVL2_OS_WINDOWS)
+struct InternerMutex {
+    struct scoped_lock {
+        scoped_lock(InternerMutex &mutex)
+            : m_lockRef(&mutex.lock)
+        {
+            AcquireSRWLockExclusive(m_lockRef);
+        }
+        ~scoped_lock() {
+            ReleaseSRWLockExclusive(m_lockRef);
+        }
+        SRWLOCK *m_lockRef;
+    };
+    SRWLOCK lock;
+};
+static InternerMutex g_internerMutex = { SRWLOCK_INIT };
+#else
+struct InternerMutex {
+    struct scoped_lock {
+        scoped_lock(InternerMutex &mutex)
+            : m_mutexRef(&mutex.mutex)
+        {
+            pthread_mutex_lock(m_mutexRef);
+        }
+        ~scoped_lock() {
+            pthread_mutex_unlock(m_mutexRef);
+        }
+        pthread_mutex_t *m_mutexRef;
+    };
+    pthread_mutex_t mutex;
+};
+static InternerMutex g_internerMutex = { PTHREAD_MUTEX_INITIALIZER };
+#endif
+
+/*
+ * reference counts and the UTF-16 form of an interned entry are updated without the lock
+ * above, so lookups and copies of strings created before do not contend with each other
+ */
+#if defined(VPVL2_OS_WINDOWS)
+typedef LONG AtomicInt;
+static inline AtomicInt loadAtomic(volatile AtomicInt *value)
+{
+    /* volatile reads have acquire semantics on MSVC */
+    return *value;
+}
+static inline AtomicInt addAtomic(volatile AtomicInt *value, AtomicInt delta)
+{
+    return InterlockedExchangeAdd(value, delta) + delta;
+}
+static inline bool compareAndSwapAtomic(volatile AtomicInt *value, AtomicInt expected, AtomicInt desired)
+{
+    return InterlockedCompareExchange(value, desired, expected) == expected;
+}
+static inline void *loadPointer(void **ptr)
+{
+    return *static_cast<void *volatile *>(ptr);
+}
+static inline bool compareAndSwapPointer(void **ptr, void *expected, void *desired)
+{
+    return InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+}
+#else
+typedef int AtomicInt;
+static inline AtomicInt loadAtomic(volatile AtomicInt *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+static inline AtomicInt addAtomic(volatile AtomicInt *value, AtomicInt delta)
+{
+    return __atomic_add_fetch(value, delta, __ATOMIC_ACQ_REL);
+}
+static inline bool compareAndSwapAtomic(volatile AtomicInt *value, AtomicInt expected, AtomicInt desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+static inline void *loadPointer(void **ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+static inline bool compareAndSwapPointer(void **ptr, void *expected, void *desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+}
+
 namespace vpvl2
 {
 namespace VPVL2_VERSION_NS
@@ -47,9 +153,146 @@ namespace extensions
 namespace icu4c
 {
 
+struct String::Entry {
+    typedef Hash<HashString, Entry *> Table;
+
+    static InternerMutex &mutex() {
+        return g_internerMutex;
+    }
+    static Table &table() {
+        /* intentionally never destructed to allow strings to be released after static destruction */
+        static Table *t = new Table();
+        return *t;
+    }
+    static vsize countUTF16Length(const std::string &value) {
+        /* preflights the conversion of UnicodeString::fromUTF8 to count invalid bytes as it does */
+        UErrorCode status = U_ZERO_ERROR;
+        int32_t length = 0;
+        u_strFromUTF8WithSub(0, 0, &length, value.data(), int32_t(value.size()), 0xfffd, 0, &status);
+        return vsize(length);
+    }
+    static bool hasUnpairedSurrogate(const UnicodeString &value) {
+        const int32_t length = value.length();
+        for (int32_t i = 0; i < length; i++) {
+            const UChar c = value.charAt(i);
+            if (U16_IS_LEAD(c) && i + 1 < length && U16_IS_TRAIL(value.charAt(i + 1))) {
+                i++;
+            }
+            else if (U16_IS_SURROGATE(c)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    static void toGeneralizedUTF8(const UnicodeString &value, std::string &bytes) {
+        /* unpaired surrogates are encoded as is, which never collides with any valid UTF-8 */
+        const int32_t length = value.length();
+        for (int32_t i = 0; i < length; i = value.moveIndex32(i, 1)) {
+            uint8_t buffer[U8_MAX_LENGTH];
+            int32_t offset = 0;
+            U8_APPEND_UNSAFE(buffer, offset, value.char32At(i));
+            bytes.append(reinterpret_cast<const char *>(buffer), offset);
+        }
+    }
+    static Entry *acquire(const std::string &value) {
+        return acquire(value, 0);
+    }
+    static Entry *acquire(const UnicodeString &value) {
+        std::string bytes;
+        if (hasUnpairedSurrogate(value)) {
+            /* UTF-8 cannot hold unpaired surrogates, so the entry keeps the original UTF-16 */
+            toGeneralizedUTF8(value, bytes);
+            return acquire(bytes, &value);
+        }
+        value.toUTF8String(bytes);
+        return acquire(bytes, 0);
+    }
+    static Entry *acquire(const std::string &key, const UnicodeString *valueRef) {
+        InternerMutex::scoped_lock lock(mutex());
+        Table &t = table();
+        Entry *entry = 0;
+        if (Entry *const *e = t.find(HashString(key.c_str()))) {
+            entry = *e;
+        }
+        else {
+            entry = new Entry(key, valueRef);
+            t.insert(entry->toHashString(), entry);
+        }
+        addAtomic(&entry->refCount, 1);
+        return entry;
+    }
+    static void retain(Entry *entry) {
+        /* the caller holds a reference, so the entry cannot be released concurrently */
+        addAtomic(&entry->refCount, 1);
+    }
+    static void release(Entry *&entry) {
+        AtomicInt refCount = loadAtomic(&entry->refCount);
+        while (refCount > 1) {
+            if (compareAndSwapAtomic(&entry->refCount, refCount, refCount - 1)) {
+                entry = 0;
+                return;
+            }
+            refCount = loadAtomic(&entry->refCount);
+        }
+        /* dropping the last reference is done in the lock as acquire may find the entry meanwhile */
+        InternerMutex::scoped_lock lock(mutex());
+        if (addAtomic(&entry->refCount, -1) == 0) {
+            table().remove(entry->toHashString());
+            internal::deleteObject(entry);
+        }
+        entry = 0;
+    }
+    static vsize count() {
+        InternerMutex::scoped_lock lock(mutex());
+        return table().count();
+    }
+
+    Entry(const std::string &key, const UnicodeString *valueRef)
+        : key(key),
+          hash(HashString(this->key.c_str()).m_hash),
+          length(valueRef ? vsize(valueRef->length()) : countUTF16Length(key)),
+          unicodeValue(valueRef ? new UnicodeString(*valueRef) : 0),
+          refCount(0)
+    {
+        if (valueRef) {
+            /* unpaired surrogates are replaced with U+FFFD as UnicodeString::toUTF8String does */
+            valueRef->toUTF8String(replacedUTF8);
+        }
+    }
+    ~Entry() {
+        internal::deleteObject(unicodeValue);
+    }
+    HashString toHashString() const {
+        return HashString(key.c_str(), hash);
+    }
+    const std::string &utf8() const {
+        return replacedUTF8.empty() ? key : replacedUTF8;
+    }
+    const UnicodeString &value() {
+        void **ptr = reinterpret_cast<void **>(&unicodeValue);
+        if (void *valueRef = loadPointer(ptr)) {
+            return *static_cast<UnicodeString *>(valueRef);
+        }
+        /* built once outside of the lock, the value of the thread losing the race is discarded */
+        UnicodeString *newValue = new UnicodeString(UnicodeString::fromUTF8(key));
+        if (!compareAndSwapPointer(ptr, 0, newValue)) {
+            internal::deleteObject(newValue);
+        }
+        return *static_cast<UnicodeString *>(loadPointer(ptr));
+    }
+
+    /* UTF-8 of the contents, or generalized UTF-8 keeping unpaired surrogates */
+    const std::string key;
+    const unsigned int hash;
+    const vsize length;
+    std::string replacedUTF8;
+    UnicodeString *unicodeValue;
+    volatile AtomicInt refCount;
+};
+
 IString *String::create(const std::string &value)
 {
-    return new String(UnicodeString::fromUTF8(value), IString::kUTF8, 0);
+    return new String(Entry::acquire(value), IString::kUTF8, 0);
 }
 
 std::string String::toStdString(const UnicodeString &value)
@@ -63,42 +306,56 @@ std::string String::toStdString(const UnicodeString &value)
     return str;
 }
 
+vsize String::countInternedStrings()
+{
+    return Entry::count();
+}
+
 String::String(const UnicodeString &value, Codec codec, const Converter *converterRef)
     : m_converterRef(converterRef),
-      m_value(value),
-      m_codec(codec),
-      m_utf8(toStdString(value))
+      m_entry(0),
+      m_codec(codec)
+{
+    m_entry = Entry::acquire(value);
+}
+
+String::String(Entry *entry, Codec codec, const Converter *converterRef)
+    : m_converterRef(converterRef),
+      m_entry(entry),
+      m_codec(codec)
 {
 }
 
 String::~String()
 {
+    Entry::release(m_entry);
     m_converterRef = 0;
 }
 
 bool String::startsWith(const IString *value) const
 {
-    return m_value.startsWith(static_cast<const String *>(value)->value()) == TRUE;
+    return unicodeValue().startsWith(static_cast<const String *>(value)->unicodeValue()) == TRUE;
 }
 
 bool String::contains(const IString *value) const
 {
-    return m_value.indexOf(static_cast<const String *>(value)->value()) != -1;
+    return unicodeValue().indexOf(static_cast<const String *>(value)->unicodeValue()) != -1;
 }
 
 bool String::endsWith(const IString *value) const
 {
-    return m_value.endsWith(static_cast<const String *>(value)->value()) == TRUE;
+    return unicodeValue().endsWith(static_cast<const String *>(value)->unicodeValue()) == TRUE;
 }
 
 void String::split(const IString *separator, int maxTokens, Array<IString *> &tokens) const
 {
     tokens.clear();
+    const UnicodeString &value = unicodeValue();
     if (maxTokens > 0) {
-        const UnicodeString &sep = static_cast<const String *>(separator)->value();
+        const UnicodeString &sep = static_cast<const String *>(separator)->unicodeValue();
         int32 offset = 0, pos = 0, size = sep.length(), nwords = 0;
-        while ((pos = m_value.indexOf(sep, offset)) >= 0) {
-            tokens.append(new String(m_value.tempSubString(offset, pos - offset), m_codec, m_converterRef));
+        while ((pos = value.indexOf(sep, offset)) >= 0) {
+            tokens.append(new String(value.tempSubString(offset, pos - offset), m_codec, m_converterRef));
             offset = pos + size;
             nwords++;
             if (nwords >= maxTokens) {
@@ -108,23 +365,22 @@ void String::split(const IString *separator, int maxTokens, Array<IString *> &to
         if (maxTokens - nwords == 0) {
             int lastArrayOffset = tokens.count() - 1;
             IString *s = tokens[lastArrayOffset];
-            const UnicodeString &s2 = static_cast<const String *>(s)->value();
-            const UnicodeString &sp = static_cast<const String *>(separator)->value();
-            tokens[lastArrayOffset] = new String(s2 + sp + m_value.tempSubString(offset), m_codec, m_converterRef);
+            const UnicodeString &s2 = static_cast<const String *>(s)->unicodeValue();
+            tokens[lastArrayOffset] = new String(s2 + sep + value.tempSubString(offset), m_codec, m_converterRef);
             internal::deleteObject(s);
         }
     }
     else if (maxTokens == 0) {
-        tokens.append(new String(m_value, m_codec, m_converterRef));
+        tokens.append(clone());
     }
     else {
-        const UnicodeString &sep = static_cast<const String *>(separator)->value();
+        const UnicodeString &sep = static_cast<const String *>(separator)->unicodeValue();
         int32 offset = 0, pos = 0, size = sep.length();
-        while ((pos = m_value.indexOf(sep, offset)) >= 0) {
-            tokens.append(new String(m_value.tempSubString(offset, pos - offset), m_codec, m_converterRef));
+        while ((pos = value.indexOf(sep, offset)) >= 0) {
+            tokens.append(new String(value.tempSubString(offset, pos - offset), m_codec, m_converterRef));
             offset = pos + size;
         }
-        tokens.append(new String(m_value.tempSubString(offset), m_codec, m_converterRef));
+        tokens.append(new String(value.tempSubString(offset), m_codec, m_converterRef));
     }
 }
 
@@ -134,9 +390,9 @@ IString *String::join(const Array<IString *> &tokens) const
     const int ntokens = tokens.count();
     for (int i = 0 ; i < ntokens; i++) {
         const IString *token = tokens[i];
-        s.append(static_cast<const String *>(token)->value());
+        s.append(static_cast<const String *>(token)->unicodeValue());
         if (i != ntokens - 1) {
-            s.append(m_value);
+            s.append(unicodeValue());
         }
     }
     return new String(s, m_codec, m_converterRef);
@@ -144,38 +400,45 @@ IString *String::join(const Array<IString *> &tokens) const
 
 IString *String::clone() const
 {
-    return new String(m_value, m_codec, m_converterRef);
+    Entry::retain(m_entry);
+    return new String(m_entry, m_codec, m_converterRef);
 }
 
 const HashString String::toHashString() const
 {
-    /* first argument of HashString's construct must be on memory after calling this (toHashString) */
-    return HashString(m_utf8.c_str());
+    /* the interned buffer and its hash stay on memory while this instance is alive */
+    return m_entry->toHashString();
 }
 
 bool String::equals(const IString *value) const
 {
-    return value && m_value.compare(static_cast<const String *>(value)->value()) == 0;
+    /* interned strings are equal only if they share the same entry */
+    return value && m_entry == static_cast<const String *>(value)->m_entry;
 }
 
 UnicodeString String::value() const
 {
-    return m_value;
+    return unicodeValue();
 }
 
 std::string String::toStdString() const
 {
-    return m_utf8;
+    return m_entry->utf8();
 }
 
 const uint8 *String::toByteArray() const
 {
-    return reinterpret_cast<const uint8 *>(m_utf8.c_str());
+    return reinterpret_cast<const uint8 *>(m_entry->utf8().c_str());
 }
 
 vsize String::size() const
 {
-    return m_value.length();
+    return m_entry->length;
+}
+
+const UnicodeString &String::unicodeValue() const
+{
+    return m_entry->value();
 }
 
 } /* namespace icu4c */
@@ -0,0 +1,294 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/internal/util.h>
+#include <vpvl2/extensions/TextureCache.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+struct TextureCache::PrivateContext {
+    struct Entry {
+        Entry(TextureDecoder::Image *value, uint64 timestamp)
+            : image(value),
+              nrefs(1),
+              lastUsed(timestamp)
+        {
+        }
+        TextureDecoder::Image *image;
+        int nrefs;
+        uint64 lastUsed;
+    };
+    typedef std::map<TextureCache::Key, Entry> EntryMap;
+    PrivateContext()
+        : totalBytes(0),
+          maxBytes(kDefaultMaxBytes),
+          timestamp(0)
+    {
+    }
+    ~PrivateContext() {
+        releaseAll();
+    }
+
+    void release() {
+        /* images still referenced are kept until releaseImageRef is called for them */
+        EntryMap::iterator it = entries.begin();
+        while (it != entries.end()) {
+            Entry &entry = it->second;
+            if (entry.nrefs == 0) {
+                totalBytes -= entry.image->totalBytes();
+                internal::deleteObject(entry.image);
+                entries.erase(it++);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    void releaseAll() {
+        for (EntryMap::iterator it = entries.begin(); it != entries.end(); it++) {
+            delete it->second.image;
+        }
+        entries.clear();
+        totalBytes = 0;
+    }
+    const TextureDecoder::Image *acquire(Entry &entry) {
+        entry.nrefs++;
+        entry.lastUsed = ++timestamp;
+        return entry.image;
+    }
+    const TextureDecoder::Image *add(const TextureCache::Key &key, TextureDecoder::Image *image) {
+        entries.insert(std::make_pair(key, Entry(image, ++timestamp)));
+        totalBytes += image->totalBytes();
+        evict();
+        return image;
+    }
+    void evict() {
+        /* number of textures is small enough to find the least recently used image by linear search */
+        while (totalBytes > maxBytes) {
+            EntryMap::iterator leastRecentlyUsed = entries.end();
+            for (EntryMap::iterator it = entries.begin(); it != entries.end(); it++) {
+                const Entry &entry = it->second;
+                if (entry.nrefs == 0 && (leastRecentlyUsed == entries.end() || entry.lastUsed < leastRecentlyUsed->second.lastUsed)) {
+                    leastRecentlyUsed = it;
+                }
+            }
+            if (leastRecentlyUsed == entries.end()) {
+                /* all of remaining images are still referenced */
+                break;
+            }
+            TextureDecoder::Image *image = leastRecentlyUsed->second.image;
+            VPVL2_VLOG(2, "Evicted the cached texture: " << leastRecentlyUsed->first.toString());
+            totalBytes -= image->totalBytes();
+            internal::deleteObject(image);
+            entries.erase(leastRecentlyUsed);
+        }
+    }
+    std::string pathOf(const TextureCache::Key &key) const {
+        return directory + "/" + key.toString() + ".vpvl2tex";
+    }
+    TextureDecoder::Image *restore(const TextureCache::Key &key) const {
+        std::ifstream stream(pathOf(key).c_str(), std::ios::in | std::ios::binary);
+        if (stream.good()) {
+            const std::string bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            TextureDecoder::Image *image = new TextureDecoder::Image(key.toString(), 0, 0, key.flags);
+            if (image->restore(reinterpret_cast<const uint8 *>(bytes.data()), bytes.size())) {
+                return image;
+            }
+            VPVL2_LOG(WARNING, "Cannot restore the cached texture: " << pathOf(key));
+            internal::deleteObject(image);
+        }
+        return 0;
+    }
+    void store(const TextureCache::Key &key, const TextureDecoder::Image *image) const {
+        /* write to the temporary file and rename it to prevent other sessions from reading incomplete file */
+        const std::string &path = pathOf(key), &temporaryPath = path + ".tmp";
+        std::string bytes;
+        image->serialize(bytes);
+        std::ofstream stream(temporaryPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (stream.good() && stream.write(bytes.data(), bytes.size()).good()) {
+            stream.close();
+            if (std::rename(temporaryPath.c_str(), path.c_str()) == 0) {
+                return;
+            }
+        }
+        VPVL2_LOG(WARNING, "Cannot write the cached texture: " << path);
+        std::remove(temporaryPath.c_str());
+    }
+
+    EntryMap entries;
+    std::string directory;
+    vsize totalBytes;
+    vsize maxBytes;
+    uint64 timestamp;
+};
+
+TextureCache::Key::Key()
+    : hash(0),
+      size(0),
+      flags(0)
+{
+}
+
+bool TextureCache::Key::operator<(const Key &other) const
+{
+    if (hash != other.hash) {
+        return hash < other.hash;
+    }
+    else if (size != other.size) {
+        return size < other.size;
+    }
+    return flags < other.flags;
+}
+
+std::string TextureCache::Key::toString() const
+{
+    std::ostringstream stream;
+    stream << std::hex << hash << std::dec << "-" << size << "-" << flags;
+    return stream.str();
+}
+
+TextureCache::Key TextureCache::createKey(const uint8 *data, vsize size, int flags)
+{
+    Key key;
+    key.hash = internal::hashBytes(data, size);
+    key.size = size;
+    key.flags = flags;
+    return key;
+}
+
+TextureCache::TextureCache()
+    : m_context(new PrivateContext())
+{
+}
+
+TextureCache::~TextureCache()
+{
+    internal::deleteObject(m_context);
+}
+
+const TextureDecoder::Image *TextureCache::find(const Key &key)
+{
+    PrivateContext::EntryMap::iterator it = m_context->entries.find(key);
+    if (it != m_context->entries.end()) {
+        return m_context->acquire(it->second);
+    }
+    else if (!m_context->directory.empty()) {
+        if (TextureDecoder::Image *image = m_context->restore(key)) {
+            VPVL2_VLOG(2, "Restored the cached texture: " << m_context->pathOf(key));
+            return m_context->add(key, image);
+        }
+    }
+    return 0;
+}
+
+const TextureDecoder::Image *TextureCache::insert(const Key &key, TextureDecoder::Image *image)
+{
+    VPVL2_DCHECK(image && image->isDecoded());
+    PrivateContext::EntryMap::iterator it = m_context->entries.find(key);
+    if (it != m_context->entries.end()) {
+        /* same content is decoded at the same time, uses the previous one */
+        internal::deleteObject(image);
+        return m_context->acquire(it->second);
+    }
+    if (!m_context->directory.empty()) {
+        m_context->store(key, image);
+    }
+    return m_context->add(key, image);
+}
+
+void TextureCache::releaseImageRef(const Key &key)
+{
+    PrivateContext::EntryMap::iterator it = m_context->entries.find(key);
+    if (it != m_context->entries.end() && it->second.nrefs > 0) {
+        PrivateContext::Entry &entry = it->second;
+        entry.nrefs--;
+        entry.lastUsed = ++m_context->timestamp;
+        m_context->evict();
+    }
+}
+
+int TextureCache::countImages() const
+{
+    return int(m_context->entries.size());
+}
+
+vsize TextureCache::totalBytes() const
+{
+    return m_context->totalBytes;
+}
+
+void TextureCache::release()
+{
+    m_context->release();
+}
+
+vsize TextureCache::maxBytes() const
+{
+    return m_context->maxBytes;
+}
+
+void TextureCache::setMaxBytes(vsize value)
+{
+    m_context->maxBytes = value;
+    m_context->evict();
+}
+
+std::string TextureCache::directory() const
+{
+    return m_context->directory;
+}
+
+void TextureCache::setDirectory(const std::string &value)
+{
+    m_context->directory = value;
+}
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
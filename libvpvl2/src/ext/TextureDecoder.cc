@@ -0,0 +1,473 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/internal/util.h>
+#include <vpvl2/extensions/TextureCache.h>
+#include <vpvl2/extensions/TextureDecoder.h>
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+#ifdef VPVL2_LINK_INTEL_TBB
+#include <tbb/tbb.h>
+#endif
+
+/* Simple OpenGL Image Library */
+#include "stb_image_aug.h"
+
+namespace
+{
+
+using namespace vpvl2;
+using namespace vpvl2::extensions;
+
+class ParallelDecodeImageProcessor VPVL2_DECL_FINAL {
+public:
+    ParallelDecodeImageProcessor(const Array<TextureDecoder::Image *> *imagesRef)
+        : m_imagesRef(imagesRef)
+    {
+    }
+    ~ParallelDecodeImageProcessor() {
+        m_imagesRef = 0;
+    }
+
+    inline void performDecode(int i) const {
+        m_imagesRef->at(i)->decode();
+    }
+#ifdef VPVL2_LINK_INTEL_TBB
+    void operator()(const tbb::blocked_range<int> &range) const {
+        for (int i = range.begin(), end = range.end(); i != end; ++i) {
+            performDecode(i);
+        }
+    }
+#endif /* VPVL2_LINK_INTEL_TBB */
+    void execute(bool enableParallel) {
+        const int nimages = m_imagesRef->count();
+#if defined(VPVL2_LINK_INTEL_TBB)
+        if (enableParallel) {
+            /* each image has different cost to decode so splits by one image */
+            tbb::parallel_for(tbb::blocked_range<int>(0, nimages, 1), *this);
+        }
+        else {
+#else
+        {
+            (void) enableParallel;
+#endif
+#ifdef VPVL2_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic) if(enableParallel)
+#endif
+            for (int i = 0; i < nimages; ++i) {
+                performDecode(i);
+            }
+        }
+    }
+
+private:
+    const Array<TextureDecoder::Image *> *m_imagesRef;
+};
+
+static void InitializeZlibDefaultTables()
+{
+    /*
+     * stb_image builds the fixed huffman tables of zlib (used by PNG) lazily on the first
+     * decoding and it races between decoding threads, so inflates an empty fixed huffman
+     * block on the calling thread to build them before decoding in parallel
+     */
+    static const char kEmptyFixedHuffmanBlock[] = { 0x78, char(0x9c), 0x03, 0x00 };
+    int length = 0;
+    char *ptr = stbi_zlib_decode_malloc(kEmptyFixedHuffmanBlock, int(sizeof(kEmptyFixedHuffmanBlock)), &length);
+    stbi_image_free(ptr);
+}
+
+} /* namespace anonymous */
+
+namespace vpvl2
+{
+namespace VPVL2_VERSION_NS
+{
+namespace extensions
+{
+
+struct TextureDecoder::PrivateContext {
+    typedef std::map<std::string, const TextureDecoder::Image *> ImageRefMap;
+    struct PendingImage {
+        PendingImage(TextureDecoder::Image *image, const TextureCache::Key &key, const uint8 *data, vsize size)
+            : imageRef(image),
+              cacheKey(key),
+              dataRef(data),
+              dataSize(size)
+        {
+        }
+        TextureDecoder::Image *imageRef;
+        TextureCache::Key cacheKey;
+        const uint8 *dataRef;
+        vsize dataSize;
+    };
+    PrivateContext()
+        : cacheRef(0)
+    {
+    }
+    ~PrivateContext() {
+        release();
+        cacheRef = 0;
+    }
+
+    void release() {
+        /* images shared with the texture cache can be evicted after releasing references */
+        if (cacheRef) {
+            for (std::vector<TextureCache::Key>::const_iterator it = acquiredCacheKeys.begin(); it != acquiredCacheKeys.end(); it++) {
+                cacheRef->releaseImageRef(*it);
+            }
+        }
+        acquiredCacheKeys.clear();
+        pendingImages.clear();
+        key2ImageRefs.clear();
+        images.releaseAll();
+    }
+
+    PointerArray<TextureDecoder::Image> images;
+    std::vector<PendingImage> pendingImages;
+    std::vector<TextureCache::Key> acquiredCacheKeys;
+    ImageRefMap key2ImageRefs;
+    TextureCache *cacheRef;
+};
+
+#pragma pack(push, 1)
+
+struct ImageHeader {
+    uint8 signature[8];
+    int32 flags;
+    int32 nlevels;
+};
+
+struct ImageLevelHeader {
+    int32 width;
+    int32 height;
+};
+
+#pragma pack(pop)
+
+static const uint8 kImageSignature[] = { 'V', 'P', 'V', 'L', '2', 'T', 'X', '1' };
+
+TextureDecoder::Image::Image(const std::string &key, const uint8 *dataRef, vsize size, int flags)
+    : m_key(key),
+      m_dataRef(dataRef),
+      m_dataSize(size),
+      m_flags(flags),
+      m_pixels(0)
+{
+}
+
+TextureDecoder::Image::~Image()
+{
+    m_mipmaps.releaseArrayAll();
+    stbi_image_free(m_pixels);
+    m_pixels = 0;
+    m_dataRef = 0;
+}
+
+void TextureDecoder::Image::decode()
+{
+    if (isDecoded() || !m_dataRef) {
+        return;
+    }
+    int x = 0, y = 0, ncomponents = 0;
+    if (stbi_uc *ptr = stbi_load_from_memory(m_dataRef, int(m_dataSize), &x, &y, &ncomponents, kNumComponents)) {
+        m_pixels = ptr;
+        m_levelRefs.append(m_pixels);
+        m_sizes.append(Vector3(Scalar(x), Scalar(y), 1));
+        if (internal::hasFlagBits(m_flags, kFlipVertically)) {
+            flipVertically();
+        }
+        if (internal::hasFlagBits(m_flags, kGenerateMipmaps)) {
+            generateMipmaps();
+        }
+    }
+    /*
+     * the reason of the failure is not read here because stbi_failure_reason() is shared
+     * between threads and may be overwritten by another job (see TextureDecoder::decode)
+     */
+    /* encoded data is no longer needed (and may be unmapped by the caller) */
+    m_dataRef = 0;
+}
+
+bool TextureDecoder::Image::restore(const uint8 *data, vsize size)
+{
+    VPVL2_DCHECK(!isDecoded());
+    ImageHeader header;
+    if (!data || size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.signature, kImageSignature, sizeof(kImageSignature)) != 0 ||
+            header.flags != m_flags || header.nlevels <= 0) {
+        return false;
+    }
+    /* validate whole payload before taking ownership of restored bytes */
+    vsize offset = sizeof(header);
+    Array<vsize> offsets;
+    Array<Vector3> sizes;
+    for (int i = 0; i < header.nlevels; i++) {
+        ImageLevelHeader levelHeader;
+        if (offset + sizeof(levelHeader) > size) {
+            return false;
+        }
+        std::memcpy(&levelHeader, data + offset, sizeof(levelHeader));
+        offset += sizeof(levelHeader);
+        const vsize bytes = vsize(levelHeader.width) * vsize(levelHeader.height) * kNumComponents;
+        if (levelHeader.width <= 0 || levelHeader.height <= 0 || offset + bytes > size) {
+            return false;
+        }
+        offsets.append(offset);
+        sizes.append(Vector3(Scalar(levelHeader.width), Scalar(levelHeader.height), 1));
+        offset += bytes;
+    }
+    m_restoredBytes.assign(reinterpret_cast<const char *>(data), size);
+    const uint8 *ptr = reinterpret_cast<const uint8 *>(m_restoredBytes.data());
+    for (int i = 0; i < header.nlevels; i++) {
+        m_levelRefs.append(ptr + offsets[i]);
+        m_sizes.append(sizes[i]);
+    }
+    m_dataRef = 0;
+    return true;
+}
+
+void TextureDecoder::Image::serialize(std::string &bytes) const
+{
+    VPVL2_DCHECK(isDecoded());
+    ImageHeader header;
+    std::memcpy(header.signature, kImageSignature, sizeof(kImageSignature));
+    header.flags = m_flags;
+    header.nlevels = m_levelRefs.count();
+    bytes.clear();
+    bytes.reserve(sizeof(header) + sizeof(ImageLevelHeader) * header.nlevels + totalBytes());
+    bytes.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int i = 0; i < header.nlevels; i++) {
+        const Vector3 &size = m_sizes[i];
+        ImageLevelHeader levelHeader;
+        levelHeader.width = int32(size.x());
+        levelHeader.height = int32(size.y());
+        bytes.append(reinterpret_cast<const char *>(&levelHeader), sizeof(levelHeader));
+        bytes.append(reinterpret_cast<const char *>(m_levelRefs[i]), levelBytes(i));
+    }
+}
+
+bool TextureDecoder::Image::isDecoded() const
+{
+    return m_levelRefs.count() > 0;
+}
+
+int TextureDecoder::Image::countLevels() const
+{
+    return m_levelRefs.count();
+}
+
+const uint8 *TextureDecoder::Image::levelPixels(int level) const
+{
+    VPVL2_DCHECK(level >= 0 && level < m_levelRefs.count());
+    return m_levelRefs[level];
+}
+
+Vector3 TextureDecoder::Image::levelSize(int level) const
+{
+    VPVL2_DCHECK(level >= 0 && level < m_sizes.count());
+    return m_sizes[level];
+}
+
+vsize TextureDecoder::Image::levelBytes(int level) const
+{
+    const Vector3 &size = levelSize(level);
+    return vsize(size.x()) * vsize(size.y()) * kNumComponents;
+}
+
+vsize TextureDecoder::Image::totalBytes() const
+{
+    vsize bytes = 0;
+    for (int i = 0, nlevels = countLevels(); i < nlevels; i++) {
+        bytes += levelBytes(i);
+    }
+    return bytes;
+}
+
+const std::string &TextureDecoder::Image::key() const
+{
+    return m_key;
+}
+
+void TextureDecoder::Image::flipVertically()
+{
+    const Vector3 &size = m_sizes[0];
+    const int width = int(size.x()), height = int(size.y());
+    const vsize stride = vsize(width) * kNumComponents;
+    uint8 *row = new uint8[stride];
+    for (int j = 0, half = height >> 1; j < half; ++j) {
+        uint8 *p1 = m_pixels + j * stride;
+        uint8 *p2 = m_pixels + (height - 1 - j) * stride;
+        std::memcpy(row, p1, stride);
+        std::memcpy(p1, p2, stride);
+        std::memcpy(p2, row, stride);
+    }
+    internal::deleteObjectArray(row);
+}
+
+void TextureDecoder::Image::generateMipmaps()
+{
+    const uint8 *source = m_pixels;
+    int width = int(m_sizes[0].x()), height = int(m_sizes[0].y());
+    while (width > 1 || height > 1) {
+        /* 2x2 box filter, the last column/row is clamped on odd sized level */
+        const int newWidth = btMax(width >> 1, 1), newHeight = btMax(height >> 1, 1);
+        const vsize sourceStride = vsize(width) * kNumComponents;
+        uint8 *dest = new uint8[vsize(newWidth) * newHeight * kNumComponents], *destPtr = dest;
+        for (int j = 0; j < newHeight; j++) {
+            const uint8 *row0 = source + vsize(btMin(j * 2, height - 1)) * sourceStride;
+            const uint8 *row1 = source + vsize(btMin(j * 2 + 1, height - 1)) * sourceStride;
+            for (int i = 0; i < newWidth; i++) {
+                const int offset0 = btMin(i * 2, width - 1) * kNumComponents;
+                const int offset1 = btMin(i * 2 + 1, width - 1) * kNumComponents;
+                for (int k = 0; k < kNumComponents; k++) {
+                    const int value = row0[offset0 + k] + row0[offset1 + k] + row1[offset0 + k] + row1[offset1 + k];
+                    *destPtr++ = uint8((value + 2) >> 2);
+                }
+            }
+        }
+        m_mipmaps.append(dest);
+        m_levelRefs.append(dest);
+        m_sizes.append(Vector3(Scalar(newWidth), Scalar(newHeight), 1));
+        source = dest;
+        width = newWidth;
+        height = newHeight;
+    }
+}
+
+TextureDecoder::TextureDecoder()
+    : m_context(new PrivateContext())
+{
+}
+
+TextureDecoder::~TextureDecoder()
+{
+    internal::deleteObject(m_context);
+}
+
+void TextureDecoder::addJob(const std::string &key, const uint8 *data, vsize size, int flags)
+{
+    VPVL2_DCHECK(!key.empty());
+    if (data && size > 0 && m_context->key2ImageRefs.find(key) == m_context->key2ImageRefs.end()) {
+        const TextureCache::Key &cacheKey = TextureCache::createKey(data, size, flags);
+        if (TextureCache *cacheRef = m_context->cacheRef) {
+            if (const Image *imageRef = cacheRef->find(cacheKey)) {
+                VPVL2_VLOG(2, key << " is found in the texture cache as " << cacheKey.toString());
+                m_context->key2ImageRefs.insert(std::make_pair(key, imageRef));
+                m_context->acquiredCacheKeys.push_back(cacheKey);
+                return;
+            }
+        }
+        Image *image = m_context->images.append(new Image(key, data, size, flags));
+        m_context->key2ImageRefs.insert(std::make_pair(key, image));
+        m_context->pendingImages.push_back(PrivateContext::PendingImage(image, cacheKey, data, size));
+    }
+}
+
+void TextureDecoder::decode(bool enableParallel)
+{
+    Array<Image *> imageRefs;
+    const int nimages = int(m_context->pendingImages.size());
+    for (int i = 0; i < nimages; i++) {
+        imageRefs.append(m_context->pendingImages[i].imageRef);
+    }
+    if (enableParallel) {
+        InitializeZlibDefaultTables();
+    }
+    ParallelDecodeImageProcessor processor(&imageRefs);
+    processor.execute(enableParallel);
+    TextureCache *cacheRef = m_context->cacheRef;
+    for (int i = 0; i < nimages; i++) {
+        const PrivateContext::PendingImage &pending = m_context->pendingImages[i];
+        Image *image = pending.imageRef;
+        if (!image->isDecoded()) {
+            /* decodes the broken image again on this thread to get the reason of the failure */
+            int x = 0, y = 0, ncomponents = 0;
+            stbi_image_free(stbi_load_from_memory(pending.dataRef, int(pending.dataSize), &x, &y, &ncomponents, kNumComponents));
+            const char *reason = stbi_failure_reason();
+            VPVL2_LOG(WARNING, "Cannot decode texture with key " << image->key() << ": " << (reason ? reason : "(unknown)"));
+        }
+        else if (cacheRef) {
+            /* ownership of the decoded image is transferred to the texture cache to share it */
+            const std::string key = image->key();
+            m_context->images.remove(image);
+            m_context->key2ImageRefs[key] = cacheRef->insert(pending.cacheKey, image);
+            m_context->acquiredCacheKeys.push_back(pending.cacheKey);
+        }
+    }
+    m_context->pendingImages.clear();
+}
+
+const TextureDecoder::Image *TextureDecoder::findImage(const std::string &key) const
+{
+    PrivateContext::ImageRefMap::const_iterator it = m_context->key2ImageRefs.find(key);
+    if (it != m_context->key2ImageRefs.end() && it->second->isDecoded()) {
+        return it->second;
+    }
+    return 0;
+}
+
+int TextureDecoder::countImages() const
+{
+    return int(m_context->key2ImageRefs.size());
+}
+
+void TextureDecoder::release()
+{
+    m_context->release();
+}
+
+TextureCache *TextureDecoder::cacheRef() const
+{
+    return m_context->cacheRef;
+}
+
+void TextureDecoder::setCacheRef(TextureCache *value)
+{
+    m_context->cacheRef = value;
+}
+
+} /* namespace extensions */
+} /* namespace VPVL2_VERSION_NS */
+} /* namespace vpvl2 */
@@ -164,6 +164,13 @@ void World::stepSimulation(const Scalar &deltaTimeIndex, const Scalar &motionFPS
     m_context->world->stepSimulation(v, PrivateContext::kMaxSubSteps, 1.0f / m_context->baseFPS);
 }
 
+void World::stepFixedSimulation(const Scalar &fixedTimeStep)
+{
+    /* advance exactly one substep so the caller can own the accumulator (see PlaybackScheduler) */
+    const Scalar &v = fixedTimeStep * m_context->timeScale;
+    m_context->world->stepSimulation(v, 1, v);
+}
+
 const Vector3 World::gravity() const
 {
     return m_context->world->getGravity();
@@ -67,6 +67,7 @@
 #include "vpvl2/vmd/Motion.h"
 
 #include <tinyxml2.h>
+#include <cmath>
 #include <set>
 #include <string>
 #include <sstream>
@@ -74,6 +75,10 @@
 #include <map>
 #include <algorithm>
 
+#ifdef VPVL2_LINK_INTEL_TBB
+#include <tbb/tbb.h>
+#endif
+
 using namespace tinyxml2;
 
 namespace vpvl2
@@ -113,6 +118,91 @@ struct XMLProject::PrivateContext {
     typedef std::map<XMLProject::UUID, IModel *> ModelMap;
     typedef std::map<XMLProject::UUID, IMotion *> MotionMap;
 
+    static const int kMaxDecodeValues = 24;
+    typedef std::map<std::string, IString *> NameMap;
+
+    struct KeyframeRange {
+        KeyframeRange(IMotion *motion, State value, const XMLElement *element)
+            : motionRef(motion),
+              animationElementRef(element),
+              state(value)
+        {
+        }
+        ~KeyframeRange() {
+            /* keyframes that are not attached to the motion yet */
+            keyframes.releaseAll();
+            motionRef = 0;
+            animationElementRef = 0;
+        }
+        bool hasName() const {
+            return state == kVMDBoneMotion || state == kVMDMorphMotion;
+        }
+        bool isDecodableInParallel() const {
+            return state == kVMDBoneMotion || state == kVMDMorphMotion ||
+                    state == kVMDCameraMotion || state == kVMDLightMotion;
+        }
+        IMotion *motionRef;
+        const XMLElement *animationElementRef;
+        Array<const XMLElement *> elementRefs;
+        Array<const IString *> nameRefs;
+        Array<IKeyframe *> keyframes;
+        State state;
+    };
+    struct PendingMotion {
+        PendingMotion(IMotion *value)
+            : motion(value)
+        {
+        }
+        ~PendingMotion() {
+            ranges.releaseAll();
+            internal::deleteObject(motion);
+        }
+        IMotion *motion;
+        PointerArray<KeyframeRange> ranges;
+        XMLProject::UUID uuid;
+        std::string parentModel;
+    };
+    class ParallelDecodeKeyframeProcessor {
+    public:
+        ParallelDecodeKeyframeProcessor(KeyframeRange *range)
+            : m_rangeRef(range)
+        {
+        }
+        ~ParallelDecodeKeyframeProcessor() {
+            m_rangeRef = 0;
+        }
+
+        inline void performDecode(int index) const {
+            KeyframeRange *range = m_rangeRef;
+            range->keyframes[index] = decodeKeyframe(range->motionRef, range->state,
+                                                     range->elementRefs[index], range->nameRefs[index]);
+        }
+#ifdef VPVL2_LINK_INTEL_TBB
+        void operator()(const tbb::blocked_range<int> &range) const {
+            for (int i = range.begin(), end = range.end(); i != end; ++i) {
+                performDecode(i);
+            }
+        }
+#endif /* VPVL2_LINK_INTEL_TBB */
+        void execute() const {
+            const int nkeyframes = m_rangeRef->elementRefs.count();
+            m_rangeRef->keyframes.resize(nkeyframes);
+#ifdef VPVL2_LINK_INTEL_TBB
+            tbb::parallel_for(tbb::blocked_range<int>(0, nkeyframes), *this);
+#else /* VPVL2_LINK_INTEL_TBB */
+#ifdef VPVL2_ENABLE_OPENMP
+#pragma omp parallel for
+#endif
+            for (int i = 0; i < nkeyframes; i++) {
+                performDecode(i);
+            }
+#endif /* VPVL2_LINK_INTEL_TBB */
+        }
+
+    private:
+        mutable KeyframeRange *m_rangeRef;
+    };
+
     static inline const char *projectPrefix() {
         return "vpvm";
     }
@@ -222,12 +312,115 @@ struct XMLProject::PrivateContext {
         return false;
     }
 
+    static inline bool isSeparator(char c) {
+        return c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+    static const char *parseNumber(const char *ptr, float64 &value) {
+        static const float64 kPowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                               1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+        static const int kMaxSignificantDigits = 18;
+        const char *start = ptr;
+        bool negative = false;
+        if (*ptr == '-' || *ptr == '+') {
+            negative = *ptr == '-';
+            ptr++;
+        }
+        uint64 mantissa = 0;
+        int ndigits = 0, exponent = 0;
+        const char *digitsStart = ptr;
+        for (; *ptr >= '0' && *ptr <= '9'; ptr++) {
+            if (ndigits < kMaxSignificantDigits) {
+                mantissa = mantissa * 10 + (*ptr - '0');
+                ndigits += mantissa > 0 ? 1 : 0;
+            }
+            else {
+                exponent++;
+            }
+        }
+        if (*ptr == '.') {
+            ptr++;
+            for (; *ptr >= '0' && *ptr <= '9'; ptr++) {
+                if (ndigits < kMaxSignificantDigits) {
+                    mantissa = mantissa * 10 + (*ptr - '0');
+                    ndigits += mantissa > 0 ? 1 : 0;
+                    exponent--;
+                }
+            }
+        }
+        if (ptr == digitsStart || (ptr == digitsStart + 1 && *digitsStart == '.')) {
+            /* not a number */
+            return start;
+        }
+        if (*ptr == 'e' || *ptr == 'E') {
+            const char *exponentStart = ptr++;
+            bool negativeExponent = false;
+            if (*ptr == '-' || *ptr == '+') {
+                negativeExponent = *ptr == '-';
+                ptr++;
+            }
+            if (*ptr >= '0' && *ptr <= '9') {
+                int e = 0;
+                for (; *ptr >= '0' && *ptr <= '9'; ptr++) {
+                    e = btMin(e * 10 + (*ptr - '0'), 1024);
+                }
+                exponent += negativeExponent ? -e : e;
+            }
+            else {
+                ptr = exponentStart;
+            }
+        }
+        float64 v = float64(mantissa);
+        if (exponent < 0) {
+            v = -exponent <= kMaxSignificantDigits ? v / kPowersOf10[-exponent] : v * std::pow(10.0, exponent);
+        }
+        else if (exponent > 0) {
+            v = exponent <= kMaxSignificantDigits ? v * kPowersOf10[exponent] : v * std::pow(10.0, exponent);
+        }
+        value = negative ? -v : v;
+        return ptr;
+    }
+    static float64 parseScalar(const char *ptr) {
+        float64 value = 0;
+        if (ptr) {
+            while (isSeparator(*ptr)) {
+                ptr++;
+            }
+            parseNumber(ptr, value);
+        }
+        return value;
+    }
+    /* parses comma or space separated values without allocations and returns number of all tokens */
+    static int parseFloatArray(const char *ptr, float32 *values, int nvalues) {
+        int ntokens = 0;
+        float64 value = 0;
+        while (ptr) {
+            while (isSeparator(*ptr)) {
+                ptr++;
+            }
+            if (!*ptr) {
+                break;
+            }
+            const char *next = parseNumber(ptr, value);
+            if (next == ptr) {
+                return -1;
+            }
+            if (ntokens < nvalues) {
+                values[ntokens] = float32(value);
+            }
+            ntokens++;
+            ptr = next;
+        }
+        return ntokens;
+    }
+
     PrivateContext(Scene *scene, XMLProject::IDelegate *delegate, Factory *factory)
         : delegateRef(delegate),
           sceneRef(scene),
           factoryRef(factory),
           currentString(0),
           currentMotion(0),
+          currentPendingMotion(0),
+          currentRange(0),
           currentMotionType(IMotion::kVMDFormat),
           state(kInitial),
           depth(0),
@@ -240,7 +433,11 @@ struct XMLProject::PrivateContext {
         modelRefs.clear();
         motionRefs.clear();
         internal::deleteObject(currentString);
-        internal::deleteObject(currentMotion);
+        internal::deleteObject(currentPendingMotion);
+        pendingMotions.releaseAll();
+        releaseInternedNames();
+        currentMotion = 0;
+        currentRange = 0;
         state = kInitial;
         depth = 0;
         dirty = false;
@@ -861,7 +1058,7 @@ struct XMLProject::PrivateContext {
                 readLocalSettingKey(firstAttribute);
             }
             else if (state == kAnimation && equalsToElement(element, "vpvm:animation")) {
-                readMotionType(firstAttribute);
+                readMotionType(element, firstAttribute);
             }
             else if (equalsToElement(element, "vpvm:keyframe")) {
 #if 0
@@ -874,56 +1071,7 @@ struct XMLProject::PrivateContext {
             }
         }
         else if (depth == 4 && equalsToElement(element, "vpvm:keyframe")) {
-            switch (state) {
-            case kVMDBoneMotion:
-                readVMDBoneKeyframe(firstAttribute);
-                break;
-            case kVMDMorphMotion:
-                readVMDMorphKeyframe(firstAttribute);
-                break;
-            case kVMDCameraMotion:
-                readVMDCameraKeyframe(firstAttribute);
-                break;
-            case kVMDLightMotion:
-                readVMDLightKeyframe(firstAttribute);
-                break;
-            case kMVDAssetMotion:
-                readMVDAssetKeyframe(firstAttribute);
-                break;
-            case kMVDBoneMotion:
-                readMVDBoneKeyframe(firstAttribute);
-                break;
-            case kMVDCameraMotion:
-                readMVDCameraKeyframe(firstAttribute);
-                break;
-            case kMVDEffectMotion:
-                readMVDEffectKeyframe(firstAttribute);
-                break;
-            case kMVDLightMotion:
-                readMVDLightKeyframe(firstAttribute);
-                break;
-            case kMVDModelMotion:
-                readMVDModelKeyframe(firstAttribute);
-                break;
-            case kMVDMorphMotion:
-                readMVDMorphKeyframe(firstAttribute);
-                break;
-            case kMVDProjectMotion:
-                readMVDProjectKeyframe(firstAttribute);
-                break;
-            case kInitial:
-            case kProject:
-            case kSettings:
-            case kPhysics:
-            case kModels:
-            case kModel:
-            case kAssets:
-            case kAsset:
-            case kMotions:
-            case kAnimation:
-            default:
-                break;
-            }
+            collectKeyframe(element, firstAttribute);
         }
         else {
             return false;
@@ -1096,26 +1244,28 @@ struct XMLProject::PrivateContext {
                 currentMotionType = IMotion::kMVDFormat;
             }
         }
-        internal::deleteObject(currentMotion);
-        currentMotion = factoryRef->newMotion(currentMotionType, 0);
+        internal::deleteObject(currentPendingMotion);
+        IMotion *motion = factoryRef->newMotion(currentMotionType, 0);
         if (!parentModel.empty()) {
             ModelMap::const_iterator it = modelRefs.find(parentModel);
             if (it != modelRefs.end()) {
-                currentMotion->setParentModelRef(it->second);
+                motion->setParentModelRef(it->second);
             }
             else {
                 ModelMap::const_iterator it2 = assetRefs.find(parentModel);
                 if (it2 != assetRefs.end()) {
-                    currentMotion->setParentModelRef(it2->second);
+                    motion->setParentModelRef(it2->second);
                 }
             }
         }
+        currentPendingMotion = new PendingMotion(motion);
+        currentRange = 0;
         pushState(kAnimation);
     }
     void readLocalSettingKey(const XMLAttribute *firstAttribute) {
         readGlobalSettingKey(firstAttribute);
     }
-    void readMotionType(const XMLAttribute *firstAttribute) {
+    void readMotionType(const XMLElement &element, const XMLAttribute *firstAttribute) {
         bool isMVD = currentMotionType == IMotion::kMVDFormat;
         for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
             if (!equalsToAttribute(attr, "type")) {
@@ -1163,150 +1313,205 @@ struct XMLProject::PrivateContext {
                 }
             }
         }
+        /* keyframes are decoded after scanning the whole document (see flushPendingMotions) */
+        if (state != kAnimation && currentPendingMotion) {
+            currentRange = currentPendingMotion->ranges.append(new KeyframeRange(currentPendingMotion->motion, state, &element));
+        }
+        else {
+            currentRange = 0;
+        }
     }
-    void readVMDBoneKeyframe(const XMLAttribute *firstAttribute) {
-        if (IBoneKeyframe *keyframe = factoryRef->createBoneKeyframe(currentMotion)) {
-            Array<std::string> tokens;
-            Vector4 vec4(kZeroV4);
-            Vector3 vec3(kZeroV3);
-            QuadWord qw(0, 0, 0, 0);
-            keyframe->setDefaultInterpolationParameter();
+    void collectKeyframe(const XMLElement &element, const XMLAttribute *firstAttribute) {
+        if (!currentRange) {
+            return;
+        }
+        const IString *nameRef = 0;
+        if (currentRange->hasName()) {
             for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
                 if (equalsToAttribute(attr, "name")) {
-                    internal::deleteObject(currentString);
-                    currentString = delegateRef->toStringFromStd(attr->Value());
-                    keyframe->setName(currentString);
+                    nameRef = internName(attr->Value());
                 }
-                else if (equalsToAttribute(attr, "index")) {
-                    keyframe->setTimeIndex(IKeyframe::TimeIndex(attr->DoubleValue()));
-                }
-                else if (equalsToAttribute(attr, "position")) {
-                    splitString(attr->Value(), tokens);
-                    if (tryCreateVector3(tokens, vec3)) {
+            }
+        }
+        currentRange->elementRefs.append(&element);
+        currentRange->nameRefs.append(nameRef);
+    }
+    const IString *internName(const char *value) {
+        NameMap::const_iterator it = internedNames.find(value);
+        if (it != internedNames.end()) {
+            return it->second;
+        }
+        IString *name = delegateRef->toStringFromStd(value);
+        internedNames.insert(std::make_pair(std::string(value), name));
+        return name;
+    }
+    void releaseInternedNames() {
+        for (NameMap::iterator it = internedNames.begin(); it != internedNames.end(); it++) {
+            delete it->second;
+        }
+        internedNames.clear();
+    }
+    static IKeyframe *decodeVMDBoneKeyframe(IMotion *motion, const XMLAttribute *firstAttribute, const IString *name) {
+        IBoneKeyframe *keyframe = motion->createBoneKeyframe();
+        float32 values[kMaxDecodeValues];
+        keyframe->setDefaultInterpolationParameter();
+        if (name) {
+            keyframe->setName(name);
+        }
+        for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
+            if (equalsToAttribute(attr, "index")) {
+                keyframe->setTimeIndex(IKeyframe::TimeIndex(parseScalar(attr->Value())));
+            }
+            else if (equalsToAttribute(attr, "position")) {
+                if (parseFloatArray(attr->Value(), values, 3) == 3) {
 #ifdef VPVL2_COORDINATE_OPENGL
-                        vec3.setValue(vec3.x(), vec3.y(), -vec3.z());
+                    keyframe->setLocalTranslation(Vector3(values[0], values[1], -values[2]));
 #else
-                        vec3.setValue(vec3.x(), vec3.y(), vec3.z());
+                    keyframe->setLocalTranslation(Vector3(values[0], values[1], values[2]));
 #endif
-                        keyframe->setLocalTranslation(vec3);
-                    }
                 }
-                else if (equalsToAttribute(attr, "rotation")) {
-                    splitString(attr->Value(), tokens);
-                    if (tryCreateVector4(tokens, vec4)) {
-                        Quaternion rotation;
+            }
+            else if (equalsToAttribute(attr, "rotation")) {
+                if (parseFloatArray(attr->Value(), values, 4) == 4) {
 #ifdef VPVL2_COORDINATE_OPENGL
-                        rotation.setValue(-vec4.x(), -vec4.y(), vec4.z(), vec4.w());
+                    keyframe->setLocalOrientation(Quaternion(-values[0], -values[1], values[2], values[3]));
 #else
-                        rotation.setValue(vec4.x(), vec4.y(), vec4.z(), vec4.w());
+                    keyframe->setLocalOrientation(Quaternion(values[0], values[1], values[2], values[3]));
 #endif
-                        keyframe->setLocalOrientation(rotation);
-                    }
                 }
-                else if (equalsToAttribute(attr, "interpolation")) {
-                    splitString(attr->Value(), tokens);
-                    if (tokens.count() == 16) {
-                        for (int i = 0; i < 4; i++) {
-                            setQuadWordValues(tokens, qw, i * 4);
-                            keyframe->setInterpolationParameter(static_cast<IBoneKeyframe::InterpolationType>(i), qw);
-                        }
+            }
+            else if (equalsToAttribute(attr, "interpolation")) {
+                if (parseFloatArray(attr->Value(), values, 16) == 16) {
+                    for (int i = 0; i < 4; i++) {
+                        const float32 *v = &values[i * 4];
+                        keyframe->setInterpolationParameter(static_cast<IBoneKeyframe::InterpolationType>(i), QuadWord(v[0], v[1], v[2], v[3]));
                     }
                 }
             }
-            currentMotion->addKeyframe(keyframe);
         }
+        return keyframe;
     }
-    void readVMDCameraKeyframe(const XMLAttribute *firstAttribute) {
-        if (ICameraKeyframe *keyframe = factoryRef->createCameraKeyframe(currentMotion)) {
-            Vector3 vec3(kZeroV3);
-            QuadWord qw(0, 0, 0, 0);
-            Array<std::string> tokens;
-            keyframe->setDefaultInterpolationParameter();
-            for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
-                if (equalsToAttribute(attr, "fovy")) {
-                    keyframe->setFov(attr->FloatValue());
-                }
-                else if (equalsToAttribute(attr, "index")) {
-                    keyframe->setTimeIndex(IKeyframe::TimeIndex(attr->DoubleValue()));
-                }
-                else if (equalsToAttribute(attr, "angle")) {
-                    splitString(attr->Value(), tokens);
-                    if (tryCreateVector3(tokens, vec3)) {
+    static IKeyframe *decodeVMDCameraKeyframe(IMotion *motion, const XMLAttribute *firstAttribute) {
+        ICameraKeyframe *keyframe = motion->createCameraKeyframe();
+        float32 values[kMaxDecodeValues];
+        keyframe->setDefaultInterpolationParameter();
+        for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
+            if (equalsToAttribute(attr, "fovy")) {
+                keyframe->setFov(float32(parseScalar(attr->Value())));
+            }
+            else if (equalsToAttribute(attr, "index")) {
+                keyframe->setTimeIndex(IKeyframe::TimeIndex(parseScalar(attr->Value())));
+            }
+            else if (equalsToAttribute(attr, "angle")) {
+                if (parseFloatArray(attr->Value(), values, 3) == 3) {
 #ifdef VPVL2_COORDINATE_OPENGL
-                        vec3.setValue(-btDegrees(vec3.x()), -btDegrees(vec3.y()), -btDegrees(vec3.z()));
+                    keyframe->setAngle(Vector3(-btDegrees(values[0]), -btDegrees(values[1]), -btDegrees(values[2])));
 #else
-                        vec3.setValue(btDegrees(vec3.x()), btDegrees(vec3.y()), -btDegrees(vec3.z()));
+                    keyframe->setAngle(Vector3(btDegrees(values[0]), btDegrees(values[1]), -btDegrees(values[2])));
 #endif
-                        keyframe->setAngle(vec3);
-                    }
                 }
-                else if (equalsToAttribute(attr, "position")) {
-                    splitString(attr->Value(), tokens);
-                    if (tryCreateVector3(tokens, vec3)) {
+            }
+            else if (equalsToAttribute(attr, "position")) {
+                if (parseFloatArray(attr->Value(), values, 3) == 3) {
 #ifdef VPVL2_COORDINATE_OPENGL
-                        vec3.setValue(vec3.x(), vec3.y(), -vec3.z());
+                    keyframe->setLookAt(Vector3(values[0], values[1], -values[2]));
 #else
-                        vec3.setValue(vec3.x(), vec3.y(), vec3.z());
+                    keyframe->setLookAt(Vector3(values[0], values[1], values[2]));
 #endif
-                        keyframe->setLookAt(vec3);
-                    }
                 }
-                else if (equalsToAttribute(attr, "distance")) {
-                    keyframe->setDistance(attr->FloatValue());
-                }
-                else if (equalsToAttribute(attr, "interpolation")) {
-                    splitString(attr->Value(), tokens);
-                    if (tokens.count() == 24) {
-                        for (int i = 0; i < 6; i++) {
-                            setQuadWordValues(tokens, qw, i * 4);
-                            keyframe->setInterpolationParameter(static_cast<ICameraKeyframe::InterpolationType>(i), qw);
-                        }
+            }
+            else if (equalsToAttribute(attr, "distance")) {
+                keyframe->setDistance(float32(parseScalar(attr->Value())));
+            }
+            else if (equalsToAttribute(attr, "interpolation")) {
+                if (parseFloatArray(attr->Value(), values, 24) == 24) {
+                    for (int i = 0; i < 6; i++) {
+                        const float32 *v = &values[i * 4];
+                        keyframe->setInterpolationParameter(static_cast<ICameraKeyframe::InterpolationType>(i), QuadWord(v[0], v[1], v[2], v[3]));
                     }
                 }
             }
-            currentMotion->addKeyframe(keyframe);
         }
+        return keyframe;
     }
-    void readVMDLightKeyframe(const XMLAttribute *firstAttribute) {
-        if (ILightKeyframe *keyframe = factoryRef->createLightKeyframe(currentMotion)) {
-            Array<std::string> tokens;
-            Vector3 vec3(kZeroV3);
-            for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
-                if (equalsToAttribute(attr, "index")) {
-                    keyframe->setTimeIndex(IKeyframe::TimeIndex(attr->DoubleValue()));
-                }
-                else if (equalsToAttribute(attr, "color")) {
-                    splitString(attr->Value(), tokens);
-                    if (tryCreateVector3(tokens, vec3)) {
-                        keyframe->setColor(vec3);
-                    }
+    static IKeyframe *decodeVMDLightKeyframe(IMotion *motion, const XMLAttribute *firstAttribute) {
+        ILightKeyframe *keyframe = motion->createLightKeyframe();
+        float32 values[kMaxDecodeValues];
+        for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
+            if (equalsToAttribute(attr, "index")) {
+                keyframe->setTimeIndex(IKeyframe::TimeIndex(parseScalar(attr->Value())));
+            }
+            else if (equalsToAttribute(attr, "color")) {
+                if (parseFloatArray(attr->Value(), values, 3) == 3) {
+                    keyframe->setColor(Vector3(values[0], values[1], values[2]));
                 }
-                else if (equalsToAttribute(attr, "direction")) {
-                    splitString(attr->Value(), tokens);
-                    if (tryCreateVector3(tokens, vec3)) {
-                        keyframe->setDirection(vec3);
-                    }
+            }
+            else if (equalsToAttribute(attr, "direction")) {
+                if (parseFloatArray(attr->Value(), values, 3) == 3) {
+                    keyframe->setDirection(Vector3(values[0], values[1], values[2]));
                 }
             }
-            currentMotion->addKeyframe(keyframe);
         }
+        return keyframe;
     }
-    void readVMDMorphKeyframe(const XMLAttribute *firstAttribute) {
-        if (IMorphKeyframe *keyframe = factoryRef->createMorphKeyframe(currentMotion)) {
-            for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
-                if (equalsToAttribute(attr, "name")) {
-                    internal::deleteObject(currentString);
-                    currentString = delegateRef->toStringFromStd(attr->Value());
-                    keyframe->setName(currentString);
-                }
-                else if (equalsToAttribute(attr, "index")) {
-                    keyframe->setTimeIndex(IKeyframe::TimeIndex(attr->DoubleValue()));
-                }
-                else if (equalsToAttribute(attr, "weight")) {
-                    keyframe->setWeight(IMorph::WeightPrecision(attr->DoubleValue()));
-                }
+    static IKeyframe *decodeVMDMorphKeyframe(IMotion *motion, const XMLAttribute *firstAttribute, const IString *name) {
+        IMorphKeyframe *keyframe = motion->createMorphKeyframe();
+        if (name) {
+            keyframe->setName(name);
+        }
+        for (const XMLAttribute *attr = firstAttribute; attr; attr = attr->Next()) {
+            if (equalsToAttribute(attr, "index")) {
+                keyframe->setTimeIndex(IKeyframe::TimeIndex(parseScalar(attr->Value())));
             }
-            currentMotion->addKeyframe(keyframe);
+            else if (equalsToAttribute(attr, "weight")) {
+                keyframe->setWeight(IMorph::WeightPrecision(parseScalar(attr->Value())));
+            }
+        }
+        return keyframe;
+    }
+    static IKeyframe *decodeKeyframe(IMotion *motion, State state, const XMLElement *element, const IString *name) {
+        const XMLAttribute *firstAttribute = element->FirstAttribute();
+        switch (state) {
+        case kVMDBoneMotion:
+            return decodeVMDBoneKeyframe(motion, firstAttribute, name);
+        case kVMDMorphMotion:
+            return decodeVMDMorphKeyframe(motion, firstAttribute, name);
+        case kVMDCameraMotion:
+            return decodeVMDCameraKeyframe(motion, firstAttribute);
+        case kVMDLightMotion:
+            return decodeVMDLightKeyframe(motion, firstAttribute);
+        default:
+            return 0;
+        }
+    }
+    void readKeyframe(State state, const XMLAttribute *firstAttribute) {
+        switch (state) {
+        case kMVDAssetMotion:
+            readMVDAssetKeyframe(firstAttribute);
+            break;
+        case kMVDBoneMotion:
+            readMVDBoneKeyframe(firstAttribute);
+            break;
+        case kMVDCameraMotion:
+            readMVDCameraKeyframe(firstAttribute);
+            break;
+        case kMVDEffectMotion:
+            readMVDEffectKeyframe(firstAttribute);
+            break;
+        case kMVDLightMotion:
+            readMVDLightKeyframe(firstAttribute);
+            break;
+        case kMVDModelMotion:
+            readMVDModelKeyframe(firstAttribute);
+            break;
+        case kMVDMorphMotion:
+            readMVDMorphKeyframe(firstAttribute);
+            break;
+        case kMVDProjectMotion:
+            readMVDProjectKeyframe(firstAttribute);
+            break;
+        default:
+            break;
         }
     }
     void readMVDAssetKeyframe(const XMLAttribute *firstAttribute) {
@@ -1589,32 +1794,82 @@ struct XMLProject::PrivateContext {
         uuid.clear();
     }
     void addMotion() {
-        if (!uuid.empty()) {
-            if (uuid != XMLProject::kNullUUID && currentMotion) {
-                MotionMap::iterator it = motionRefs.find(uuid);
-                if (it != motionRefs.end()) {
-                    sceneRef->removeMotion(it->second);
-                    internal::deleteObject(it->second);
-                    motionRefs.erase(it);
-                }
-                if (!parentModel.empty()) {
-                    ModelMap::const_iterator it2 = modelRefs.find(parentModel);
-                    if (it2 != modelRefs.end()) {
-                        currentMotion->setParentModelRef(it2->second);
-                    }
+        if (!uuid.empty() && uuid != XMLProject::kNullUUID && currentPendingMotion) {
+            currentPendingMotion->uuid = uuid;
+            currentPendingMotion->parentModel = parentModel;
+            pendingMotions.append(currentPendingMotion);
+        }
+        else {
+            internal::deleteObject(currentPendingMotion);
+        }
+        currentPendingMotion = 0;
+        currentRange = 0;
+        uuid.clear();
+        parentModel.clear();
+        popState(kMotions);
+    }
+    void attachMotion(PendingMotion *pending) {
+        IMotion *motion = pending->motion;
+        const int nranges = pending->ranges.count();
+        for (int i = 0; i < nranges; i++) {
+            KeyframeRange *range = pending->ranges[i];
+            if (range->isDecodableInParallel()) {
+                Array<IKeyframe *> &keyframes = range->keyframes;
+                const int nkeyframes = keyframes.count();
+                for (int j = 0; j < nkeyframes; j++) {
+                    motion->addKeyframe(keyframes[j]);
                 }
-                motionRefs.insert(std::make_pair(uuid, currentMotion));
-                currentMotion->createFirstKeyframesUnlessFound();
-                sceneRef->addMotion(currentMotion);
+                keyframes.clear();
             }
             else {
-                internal::deleteObject(currentMotion);
+                const Array<const XMLElement *> &elements = range->elementRefs;
+                const int nelements = elements.count();
+                currentMotion = motion;
+                for (int j = 0; j < nelements; j++) {
+                    readKeyframe(range->state, elements[j]->FirstAttribute());
+                }
+                currentMotion = 0;
             }
-            currentMotion = 0;
         }
-        uuid.clear();
-        parentModel.clear();
-        popState(kMotions);
+        const XMLProject::UUID &motionUUID = pending->uuid;
+        MotionMap::iterator it = motionRefs.find(motionUUID);
+        if (it != motionRefs.end()) {
+            sceneRef->removeMotion(it->second);
+            internal::deleteObject(it->second);
+            motionRefs.erase(it);
+        }
+        if (!pending->parentModel.empty()) {
+            ModelMap::const_iterator it2 = modelRefs.find(pending->parentModel);
+            if (it2 != modelRefs.end()) {
+                motion->setParentModelRef(it2->second);
+            }
+        }
+        motionRefs.insert(std::make_pair(motionUUID, motion));
+        motion->createFirstKeyframesUnlessFound();
+        sceneRef->addMotion(motion);
+        pending->motion = 0;
+    }
+    void flushPendingMotions() {
+        /* decode all keyframes at first, and attach motions to the scene after all decoding has finished */
+        const int nmotions = pendingMotions.count();
+        for (int i = 0; i < nmotions; i++) {
+            const PendingMotion *pending = pendingMotions[i];
+            const int nranges = pending->ranges.count();
+            for (int j = 0; j < nranges; j++) {
+                KeyframeRange *range = pending->ranges[j];
+                if (range->isDecodableInParallel()) {
+                    ParallelDecodeKeyframeProcessor processor(range);
+                    processor.execute();
+                }
+            }
+        }
+        for (int i = 0; i < nmotions; i++) {
+            attachMotion(pendingMotions[i]);
+        }
+        pendingMotions.releaseAll();
+        internal::deleteObject(currentPendingMotion);
+        currentRange = 0;
+        releaseInternedNames();
     }
 
     bool save(XMLPrinter &printer) {
@@ -1819,6 +2074,10 @@ struct XMLProject::PrivateContext {
     XMLProject::UUID uuid;
     const IString *currentString;
     IMotion *currentMotion;
+    PendingMotion *currentPendingMotion;
+    KeyframeRange *currentRange;
+    PointerArray<PendingMotion> pendingMotions;
+    NameMap internedNames;
     IMotion::FormatType currentMotionType;
     State state;
     int depth;
@@ -1928,7 +2187,9 @@ bool XMLProject::load(const char *path)
     bool ret = false;
     if (document.LoadFile(path) == XML_NO_ERROR) {
         PrivateContext::Reader reader(m_context);
-        ret = m_context->validate(document.Accept(&reader));
+        bool accepted = document.Accept(&reader);
+        m_context->flushPendingMotions();
+        ret = m_context->validate(accepted);
         if (ret) {
             m_context->sort();
             m_context->restoreStates();
@@ -1946,7 +2207,9 @@ bool XMLProject::load(const uint8 *data, vsize size)
     bool ret = false;
     if (document.Parse(reinterpret_cast<const char *>(data), size) == XML_NO_ERROR) {
         PrivateContext::Reader reader(m_context);
-        ret = m_context->validate(document.Accept(&reader));
+        bool accepted = document.Accept(&reader);
+        m_context->flushPendingMotions();
+        ret = m_context->validate(accepted);
         if (ret) {
             m_context->sort();
             m_context->restoreStates();
@@ -2,6 +2,8 @@
 #include "vpvl2/extensions/Archive.h"
 #include "vpvl2/extensions/icu4c/Encoding.h"
 
+#include <zlib.h>
+
 using namespace vpvl2;
 using namespace vpvl2::extensions;
 using namespace vpvl2::extensions::icu4c;
@@ -69,6 +71,94 @@ static void UncompressArchive(Archive &archive, Archive::EntryNames &entries)
     ASSERT_TRUE(archive.open(&path, entries));
 }
 
+struct ZipEntry {
+    ZipEntry(const QByteArray &n, const QByteArray &d, quint16 m, quint64 s)
+        : name(n),
+          data(d),
+          method(m),
+          zip64Size(s)
+    {
+    }
+    QByteArray name;
+    QByteArray data;
+    quint16 method;
+    quint64 zip64Size;
+};
+
+static void AppendUInt16(QByteArray &bytes, quint16 value)
+{
+    bytes.append(char(value & 0xff)).append(char(value >> 8));
+}
+
+static void AppendUInt32(QByteArray &bytes, quint32 value)
+{
+    AppendUInt16(bytes, quint16(value & 0xffff));
+    AppendUInt16(bytes, quint16(value >> 16));
+}
+
+static void AppendUInt64(QByteArray &bytes, quint64 value)
+{
+    AppendUInt32(bytes, quint32(value & 0xffffffff));
+    AppendUInt32(bytes, quint32(value >> 32));
+}
+
+static QByteArray CreateZip(const QList<ZipEntry> &entries)
+{
+    /* writes the sizes with zip64 extra field if zip64Size is not zero */
+    QByteArray bytes, centralDirectory;
+    foreach (const ZipEntry &entry, entries) {
+        const quint32 offset = quint32(bytes.size());
+        const quint32 crc = quint32(crc32(crc32(0, 0, 0), reinterpret_cast<const Bytef *>(entry.data.constData()), uInt(entry.data.size())));
+        const quint32 size = entry.zip64Size > 0 ? 0xffffffff : quint32(entry.data.size());
+        QByteArray extra;
+        if (entry.zip64Size > 0) {
+            AppendUInt16(extra, 0x0001);
+            AppendUInt16(extra, 16);
+            AppendUInt64(extra, entry.zip64Size);
+            AppendUInt64(extra, entry.zip64Size);
+        }
+        AppendUInt32(bytes, 0x04034b50);
+        AppendUInt16(bytes, 20);
+        AppendUInt16(bytes, 0);
+        AppendUInt16(bytes, entry.method);
+        AppendUInt32(bytes, 0);
+        AppendUInt32(bytes, crc);
+        AppendUInt32(bytes, size);
+        AppendUInt32(bytes, size);
+        AppendUInt16(bytes, quint16(entry.name.size()));
+        AppendUInt16(bytes, 0);
+        bytes.append(entry.name).append(entry.data);
+        AppendUInt32(centralDirectory, 0x02014b50);
+        AppendUInt16(centralDirectory, 45);
+        AppendUInt16(centralDirectory, 20);
+        AppendUInt16(centralDirectory, 0);
+        AppendUInt16(centralDirectory, entry.method);
+        AppendUInt32(centralDirectory, 0);
+        AppendUInt32(centralDirectory, crc);
+        AppendUInt32(centralDirectory, size);
+        AppendUInt32(centralDirectory, size);
+        AppendUInt16(centralDirectory, quint16(entry.name.size()));
+        AppendUInt16(centralDirectory, quint16(extra.size()));
+        AppendUInt16(centralDirectory, 0);
+        AppendUInt16(centralDirectory, 0);
+        AppendUInt16(centralDirectory, 0);
+        AppendUInt32(centralDirectory, 0);
+        AppendUInt32(centralDirectory, offset);
+        centralDirectory.append(entry.name).append(extra);
+    }
+    const quint32 centralDirectoryOffset = quint32(bytes.size());
+    bytes.append(centralDirectory);
+    AppendUInt32(bytes, 0x06054b50);
+    AppendUInt16(bytes, 0);
+    AppendUInt16(bytes, 0);
+    AppendUInt16(bytes, quint16(entries.size()));
+    AppendUInt16(bytes, quint16(entries.size()));
+    AppendUInt32(bytes, quint32(centralDirectory.size()));
+    AppendUInt32(bytes, centralDirectoryOffset);
+    AppendUInt16(bytes, 0);
+    return bytes;
+}
+
 static const QStringList AllEntries()
 {
     QStringList entries;
@@ -148,3 +238,59 @@ TEST(ArchiveTest, UncompressWithSetBasePath)
     ASSERT_TRUE(dataRef2);
     ASSERT_EQ(dataRef2, dataRef);
 }
+
+TEST(ArchiveTest, ReadEntryWithoutUncompress)
+{
+    Encoding encoding(0);
+    Archive archive(&encoding);
+    Archive::EntryNames entries;
+    UncompressArchive(archive, entries);
+    ASSERT_EQ(vsize(10), archive.entrySize("path/to/entry.txt"));
+    ASSERT_EQ(vsize(0), archive.entrySize("not/found.txt"));
+    char buffer[16] = { 0 };
+    ASSERT_FALSE(archive.readEntry("path/to/entry.txt", reinterpret_cast<uint8 *>(buffer), 4));
+    ASSERT_TRUE(archive.readEntry("path/to/entry.txt", reinterpret_cast<uint8 *>(buffer), sizeof(buffer)));
+    ASSERT_STREQ("entry.txt\n", buffer);
+    /* readEntry doesn't hold uncompressed data */
+    ASSERT_FALSE(archive.dataRef("path/to/entry.txt"));
+}
+
+TEST(ArchiveTest, StoredEntryRef)
+{
+    Encoding encoding(0);
+    Archive archive(&encoding);
+    Archive::EntryNames entries;
+    UncompressArchive(archive, entries);
+    vsize size = 0;
+    const uint8 *ptr = archive.storedEntryRef("foo.txt", size);
+    ASSERT_TRUE(ptr);
+    ASSERT_EQ(vsize(4), size);
+    ASSERT_EQ(std::string("foo\n"), std::string(reinterpret_cast<const char *>(ptr), size));
+    ASSERT_FALSE(archive.storedEntryRef("not/found.txt", size));
+    ASSERT_EQ(vsize(0), size);
+}
+
+TEST(ArchiveTest, SkipUnreadableEntries)
+{
+    QList<ZipEntry> zipEntries;
+    zipEntries << ZipEntry("stored.txt", "stored\n", 0, 0);
+    /* bzip2 is not supported */
+    zipEntries << ZipEntry("bzip2.txt", "bzip2\n", 12, 0);
+    /* entries of 4GiB and above cannot be passed to zlib */
+    zipEntries << ZipEntry("huge.txt", "huge\n", 0, Q_UINT64_C(0x100000000));
+    QTemporaryFile file;
+    ASSERT_TRUE(file.open());
+    file.write(CreateZip(zipEntries));
+    file.close();
+    Encoding encoding(0);
+    Archive archive(&encoding);
+    Archive::EntryNames entries;
+    String path(fromQString(file.fileName()));
+    ASSERT_TRUE(archive.open(&path, entries));
+    ASSERT_EQ(vsize(1), entries.size());
+    ASSERT_EQ(std::string("stored.txt"), entries[0]);
+    ASSERT_TRUE(archive.uncompressEntry("stored.txt"));
+    ASSERT_STREQ("stored\n", archive.dataRef("stored.txt")->c_str());
+    ASSERT_EQ(vsize(0), archive.entrySize("bzip2.txt"));
+    ASSERT_EQ(vsize(0), archive.entrySize("huge.txt"));
+}
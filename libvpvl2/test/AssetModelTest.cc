@@ -6,6 +6,12 @@
 #include "vpvl2/extensions/icu4c/Encoding.h"
 #include "vpvl2/asset/Model.h"
 
+#if defined(VPVL2_LINK_ASSIMP3)
+#include <assimp/scene.h>
+#elif defined(VPVL2_LINK_ASSIMP)
+#include <assimp/aiScene.h>
+#endif
+
 #include "mock/Bone.h"
 
 using namespace ::testing;
@@ -79,3 +85,184 @@ TEST(AssetModelTest, OpacityMorph)
     morphRef->setWeight(expected2);
     ASSERT_FLOAT_EQ(expected2, model.opacity());
 }
+
+namespace {
+
+template<typename T>
+static void appendValue(const T &value, std::string &bytes)
+{
+    bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void buildTriangleCache(std::string &bytes)
+{
+    bytes.append("VPVL2AST", 8);
+    appendValue(uint32(1), bytes); /* version */
+    appendValue(uint32(3), bytes); /* vertices */
+    appendValue(uint32(3), bytes); /* indices */
+    appendValue(uint32(1), bytes); /* batches */
+    for (int i = 0; i < 3; i++) {
+        /* position, normal, texcoord, tangent and bitangent */
+        for (int j = 0; j < 15; j++) {
+            appendValue(float32(i * 15 + j), bytes);
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        appendValue(uint32(i), bytes);
+    }
+    for (int i = 0; i < 16; i++) {
+        appendValue(float32(i) / 16.0f, bytes); /* ambient, diffuse, specular and emissive */
+    }
+    appendValue(float32(8), bytes); /* shininess */
+    appendValue(float32(0.5), bytes); /* opacity */
+    appendValue(int32(0), bytes); /* material index */
+    appendValue(int32(Model::kTriangles), bytes);
+    appendValue(int32(0), bytes); /* index offset */
+    appendValue(int32(3), bytes); /* number of indices */
+    appendValue(uint32(0x00010101), bytes); /* flags and reserved */
+    appendValue(uint32(0), bytes); /* texture path size */
+}
+
+}
+
+TEST(AssetModelTest, LoadAndSaveCache)
+{
+    Encoding::Dictionary dict;
+    Encoding encoding(&dict);
+    std::string bytes;
+    buildTriangleCache(bytes);
+    const uint8 *data = reinterpret_cast<const uint8 *>(bytes.data());
+    ASSERT_TRUE(Model::isCacheData(data, bytes.size()));
+    asset::Model model(&encoding);
+    ASSERT_TRUE(model.load(data, bytes.size()));
+    ASSERT_EQ(3, model.meshVertices().count());
+    ASSERT_EQ(3, model.meshIndices().count());
+    ASSERT_EQ(1, model.materialBatches().count());
+    ASSERT_TRUE(CompareVector(Vector3(15, 16, 17), model.meshVertices()[1].position));
+    const Model::MaterialBatch &batch = model.materialBatches()[0];
+    ASSERT_EQ(3, batch.nindices);
+    ASSERT_FLOAT_EQ(0.5, batch.opacity);
+    ASSERT_TRUE(batch.hasShininess && batch.hasOpacity && batch.isTwoSided);
+    Array<IMaterial *> materials;
+    model.getMaterialRefs(materials);
+    ASSERT_EQ(1, materials.count());
+    ASSERT_EQ(bytes.size(), model.estimateSize());
+    std::string saved(model.estimateSize(), 0);
+    vsize written = 0;
+    model.save(reinterpret_cast<uint8 *>(&saved[0]), written);
+    ASSERT_EQ(bytes.size(), written);
+    ASSERT_EQ(bytes, saved);
+}
+
+TEST(AssetModelTest, RejectTruncatedCache)
+{
+    Encoding::Dictionary dict;
+    Encoding encoding(&dict);
+    std::string bytes;
+    buildTriangleCache(bytes);
+    bytes.resize(bytes.size() - 8);
+    asset::Model model(&encoding);
+    ASSERT_FALSE(model.load(reinterpret_cast<const uint8 *>(bytes.data()), bytes.size()));
+}
+
+#if defined(VPVL2_LINK_ASSIMP) || defined(VPVL2_LINK_ASSIMP3)
+
+namespace {
+
+static aiMesh *createMesh(unsigned int materialIndex, unsigned int primitiveType, const aiVector3D &origin)
+{
+    /* a triangle or a line starts from the origin */
+    const unsigned int nvertices = primitiveType == aiPrimitiveType_LINE ? 2 : 3;
+    aiMesh *mesh = new aiMesh();
+    mesh->mMaterialIndex = materialIndex;
+    mesh->mPrimitiveTypes = primitiveType;
+    mesh->mNumVertices = nvertices;
+    mesh->mVertices = new aiVector3D[nvertices];
+    for (unsigned int i = 0; i < nvertices; i++) {
+        mesh->mVertices[i] = aiVector3D(origin.x + (i == 1 ? 1 : 0), origin.y + (i == 2 ? 1 : 0), origin.z);
+    }
+    mesh->mNumFaces = 1;
+    mesh->mFaces = new aiFace[1];
+    mesh->mFaces[0].mNumIndices = nvertices;
+    mesh->mFaces[0].mIndices = new unsigned int[nvertices];
+    for (unsigned int i = 0; i < nvertices; i++) {
+        mesh->mFaces[0].mIndices[i] = i;
+    }
+    return mesh;
+}
+
+static aiNode *createNode(aiNode *parent, unsigned int nmeshes, const unsigned int *meshes)
+{
+    aiNode *node = new aiNode();
+    node->mParent = parent;
+    node->mNumMeshes = nmeshes;
+    node->mMeshes = new unsigned int[nmeshes];
+    for (unsigned int i = 0; i < nmeshes; i++) {
+        node->mMeshes[i] = meshes[i];
+    }
+    return node;
+}
+
+}
+
+TEST(AssetModelTest, BuildMaterialBatches)
+{
+    Encoding::Dictionary dict;
+    Encoding encoding(&dict);
+    std::unique_ptr<aiScene> scene(new aiScene());
+    scene->mNumMaterials = 2;
+    scene->mMaterials = new aiMaterial *[2];
+    scene->mMaterials[0] = new aiMaterial();
+    scene->mMaterials[1] = new aiMaterial();
+    scene->mNumMeshes = 4;
+    scene->mMeshes = new aiMesh *[4];
+    scene->mMeshes[0] = createMesh(0, aiPrimitiveType_TRIANGLE, aiVector3D(0, 0, 0));
+    scene->mMeshes[1] = createMesh(0, aiPrimitiveType_TRIANGLE, aiVector3D(10, 0, 0));
+    scene->mMeshes[2] = createMesh(0, aiPrimitiveType_LINE, aiVector3D(20, 0, 0));
+    scene->mMeshes[3] = createMesh(1, aiPrimitiveType_TRIANGLE, aiVector3D(30, 0, 0));
+    /* root -> translated (mesh 0) -> child (mesh 1, 2 and 3) */
+    static const unsigned int kTranslatedMeshes[] = { 0 }, kChildMeshes[] = { 1, 2, 3 };
+    scene->mRootNode = createNode(0, 0, 0);
+    aiNode *translated = createNode(scene->mRootNode, 1, kTranslatedMeshes);
+    aiMatrix4x4::Translation(aiVector3D(1, 2, 3), translated->mTransformation);
+    scene->mRootNode->mNumChildren = 1;
+    scene->mRootNode->mChildren = new aiNode *[1];
+    scene->mRootNode->mChildren[0] = translated;
+    translated->mNumChildren = 1;
+    translated->mChildren = new aiNode *[1];
+    translated->mChildren[0] = createNode(translated, 3, kChildMeshes);
+    asset::Model model(&encoding);
+    model.buildMaterialBatches(scene.get());
+    /* meshes 0 and 1 share a material, the line mesh is split even though its material is same */
+    const Array<Model::MaterialBatch> &batches = model.materialBatches();
+    ASSERT_EQ(3, batches.count());
+    ASSERT_EQ(0, batches[0].materialIndex);
+    ASSERT_EQ(int(Model::kTriangles), batches[0].primitiveType);
+    ASSERT_EQ(0, batches[0].indexOffset);
+    ASSERT_EQ(6, batches[0].nindices);
+    ASSERT_EQ(0, batches[1].materialIndex);
+    ASSERT_EQ(int(Model::kLines), batches[1].primitiveType);
+    ASSERT_EQ(6, batches[1].indexOffset);
+    ASSERT_EQ(2, batches[1].nindices);
+    ASSERT_EQ(1, batches[2].materialIndex);
+    ASSERT_EQ(int(Model::kTriangles), batches[2].primitiveType);
+    ASSERT_EQ(8, batches[2].indexOffset);
+    ASSERT_EQ(3, batches[2].nindices);
+    /* transforms of all ancestors are baked into vertices */
+    const Array<Model::MeshVertex> &vertices = model.meshVertices();
+    ASSERT_EQ(11, vertices.count());
+    ASSERT_TRUE(CompareVector(Vector3(1, 2, 3), vertices[0].position));
+    ASSERT_TRUE(CompareVector(Vector3(2, 2, 3), vertices[1].position));
+    ASSERT_TRUE(CompareVector(Vector3(11, 2, 3), vertices[3].position));
+    ASSERT_TRUE(CompareVector(Vector3(21, 2, 3), vertices[6].position));
+    ASSERT_TRUE(CompareVector(Vector3(31, 3, 3), vertices[10].position));
+    /* indices of merged meshes are rebased to the merged vertices */
+    const Array<uint32> &indices = model.meshIndices();
+    ASSERT_EQ(11, indices.count());
+    ASSERT_EQ(3u, indices[3]);
+    ASSERT_EQ(5u, indices[5]);
+    ASSERT_EQ(7u, indices[7]);
+    ASSERT_EQ(10u, indices[10]);
+}
+
+#endif
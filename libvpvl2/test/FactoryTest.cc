@@ -19,6 +19,7 @@
 #include "mock/Morph.h"
 
 #include <tuple>
+#include <vector>
 
 #ifdef VPVL2_LINK_VPVL
 #include "vpvl2/pmd/Model.h"
@@ -207,6 +208,60 @@ TEST_P(MotionConversionTest, ConvertCameraMotion)
     }
 }
 
+TEST(FactoryTest, ConvertMotionWithoutModel)
+{
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    Factory factory(&encoding);
+    String boneName1("bone1"), boneName2("bone2"), morphName("morph");
+    const String *boneNames[] = { &boneName1, &boneName2 };
+    vmd::Motion source(0, &encoding);
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 3; j++) {
+            vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+            keyframe->setName(boneNames[i]);
+            keyframe->setTimeIndex(j * 10 + i);
+            keyframe->setLocalTranslation(Vector3(i, j, 1));
+            keyframe->setLocalOrientation(Quaternion(0, 0, 0, 1));
+            keyframe->setInterpolationParameter(IBoneKeyframe::kBonePositionY, QuadWord(8, 16, 32, 64));
+            keyframe->setInterpolationParameter(IBoneKeyframe::kBoneRotation, QuadWord(24, 48, 72, 96));
+            source.addKeyframe(keyframe);
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        vmd::MorphKeyframe *keyframe = new vmd::MorphKeyframe(&encoding);
+        keyframe->setName(&morphName);
+        keyframe->setTimeIndex(i * 10);
+        keyframe->setWeight(i * 0.5);
+        source.addKeyframe(keyframe);
+    }
+    source.update(IKeyframe::kBoneKeyframe);
+    source.update(IKeyframe::kMorphKeyframe);
+    /* keyframes of bones and morphs must be kept without a model to bind */
+    std::unique_ptr<IMotion> converted(factory.convertMotion(&source, IMotion::kMVDFormat));
+    ASSERT_EQ(6, converted->countKeyframes(IKeyframe::kBoneKeyframe));
+    ASSERT_EQ(2, converted->countKeyframes(IKeyframe::kMorphKeyframe));
+    std::vector<uint8> bytes(converted->estimateSize());
+    converted->save(&bytes[0]);
+    mvd::Motion loaded(0, &encoding);
+    ASSERT_TRUE(loaded.load(&bytes[0], bytes.size()));
+    std::unique_ptr<IMotion> dest(factory.convertMotion(&loaded, IMotion::kVMDFormat));
+    ASSERT_EQ(6, dest->countKeyframes(IKeyframe::kBoneKeyframe));
+    ASSERT_EQ(2, dest->countKeyframes(IKeyframe::kMorphKeyframe));
+    for (int i = 0; i < 6; i++) {
+        const IBoneKeyframe *expected = source.findBoneKeyframeRefAt(i);
+        const IBoneKeyframe *actual = dest->findBoneKeyframeRef(expected->timeIndex(), expected->name(), 0);
+        ASSERT_TRUE(actual);
+        ASSERT_TRUE(CompareBoneKeyframe(*expected, *actual));
+    }
+    for (int i = 0; i < 2; i++) {
+        const IMorphKeyframe *expected = source.findMorphKeyframeRefAt(i);
+        const IMorphKeyframe *actual = dest->findMorphKeyframeRef(expected->timeIndex(), expected->name(), 0);
+        ASSERT_TRUE(actual);
+        ASSERT_TRUE(CompareMorphKeyframe(*expected, *actual));
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(FactoryInstance, FactoryModelTest, Values(IModel::kAssetModel, IModel::kPMDModel, IModel::kPMXModel));
 INSTANTIATE_TEST_CASE_P(FactoryInstance, MotionConversionTest,
                         Combine(Values("vmd", "mvd"), Values(IMotion::kVMDFormat, IMotion::kMVDFormat)));
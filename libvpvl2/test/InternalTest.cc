@@ -1,8 +1,12 @@
 #include "Common.h"
 #include "vpvl2/extensions/icu4c/Encoding.h"
 #include "vpvl2/extensions/icu4c/String.h"
+#include "vpvl2/internal/BonePalette.h"
+#include "vpvl2/internal/ModelBindingCache.h"
 #include "vpvl2/internal/MotionHelper.h"
 #include "vpvl2/internal/util.h"
+#include "mock/Bone.h"
+#include "mock/Model.h"
 #include <limits>
 
 using namespace ::testing;
@@ -248,3 +252,178 @@ TEST(InternalTest, ToggleFlag)
     vpvl2::internal::toggleFlag(0x0400, false, flag);
     ASSERT_EQ(0x0000, int(flag));
 }
+
+namespace {
+
+void AssertBonePaletteCoversMaterials(const BonePalette &palette,
+                                      const Array<int> &vertexBones,
+                                      const Array<int> &indices,
+                                      const Array<int> &materialIndexCounts)
+{
+    for (int i = 0, offset = 0, nmaterials = materialIndexCounts.count(); i < nmaterials; i++) {
+        int covered = 0;
+        for (int j = 0, nsubsets = palette.countSubsets(i); j < nsubsets; j++) {
+            const BonePalette::Subset *subset = palette.subsetAt(i, j);
+            ASSERT_TRUE(subset);
+            ASSERT_EQ(covered, subset->indexOffset);
+            if (!palette.isFallback()) {
+                ASSERT_LE(subset->boneIndices.count(), palette.paletteSize());
+            }
+            for (int k = 0; k < subset->indexCount; k++) {
+                const int vertexIndex = indices[offset + subset->indexOffset + k];
+                for (int l = 0; l < BonePalette::kMaxVertexBones; l++) {
+                    const int boneIndex = vertexBones[vertexIndex * BonePalette::kMaxVertexBones + l];
+                    if (boneIndex >= 0) {
+                        const int slot = palette.boneSlot(boneIndex);
+                        ASSERT_TRUE(slot >= 0 && slot < subset->boneIndices.count());
+                        ASSERT_EQ(boneIndex, subset->boneIndices[slot]);
+                    }
+                }
+            }
+            covered += subset->indexCount;
+        }
+        ASSERT_EQ(materialIndexCounts[i], covered);
+        offset += materialIndexCounts[i];
+    }
+}
+
+void BuildBoneStrip(int nbones, Array<int> &vertexBones, Array<int> &indices)
+{
+    /* vertex i is weighted to bone i / 2 and (i + 1) / 2, triangles walk along the strip */
+    const int nvertices = nbones * 2;
+    vertexBones.resize(nvertices * BonePalette::kMaxVertexBones);
+    for (int i = 0; i < nvertices; i++) {
+        int *bonesPtr = &vertexBones[i * BonePalette::kMaxVertexBones];
+        bonesPtr[0] = i / 2;
+        bonesPtr[1] = btMin((i + 1) / 2, nbones - 1);
+        bonesPtr[2] = bonesPtr[3] = -1;
+    }
+    for (int i = 0; i < nvertices - 2; i++) {
+        indices.append(i);
+        indices.append(i + 1);
+        indices.append(i + 2);
+    }
+}
+
+}
+
+TEST(InternalTest, BonePaletteKeepsSmallMaterialsWhole)
+{
+    Array<int> vertexBones, indices, materialIndexCounts;
+    BuildBoneStrip(16, vertexBones, indices);
+    materialIndexCounts.append(indices.count() / 3 / 2 * 3);
+    materialIndexCounts.append(indices.count() - materialIndexCounts[0]);
+    BonePalette palette;
+    ASSERT_TRUE(palette.build(vertexBones, indices, materialIndexCounts));
+    ASSERT_TRUE(palette.isBuilt());
+    ASSERT_FALSE(palette.isFallback());
+    ASSERT_EQ(1, palette.countSubsets(0));
+    ASSERT_EQ(1, palette.countSubsets(1));
+    ASSERT_EQ(0, palette.countSubsets(2));
+    ASSERT_FALSE(palette.subsetAt(2, 0));
+    AssertBonePaletteCoversMaterials(palette, vertexBones, indices, materialIndexCounts);
+}
+
+TEST(InternalTest, BonePaletteSplitsLargeMaterials)
+{
+    Array<int> vertexBones, indices, materialIndexCounts;
+    BuildBoneStrip(100, vertexBones, indices);
+    materialIndexCounts.append(indices.count());
+    BonePalette palette(12);
+    ASSERT_TRUE(palette.build(vertexBones, indices, materialIndexCounts));
+    ASSERT_EQ(12, palette.paletteSize());
+    ASSERT_LT(1, palette.countSubsets(0));
+    ASSERT_EQ(palette.countSubsets(0), palette.countAllSubsets());
+    AssertBonePaletteCoversMaterials(palette, vertexBones, indices, materialIndexCounts);
+    palette.release();
+    ASSERT_FALSE(palette.isBuilt());
+    ASSERT_EQ(0, palette.countAllSubsets());
+    ASSERT_EQ(-1, palette.boneSlot(0));
+}
+
+TEST(InternalTest, BonePaletteFallsBackToWholeSkeleton)
+{
+    /* bone 0 shares a triangle with every other bone, more than a palette can hold */
+    const int nbones = 20;
+    Array<int> vertexBones, indices, materialIndexCounts;
+    vertexBones.resize(nbones * BonePalette::kMaxVertexBones);
+    for (int i = 0; i < nbones; i++) {
+        int *bonesPtr = &vertexBones[i * BonePalette::kMaxVertexBones];
+        bonesPtr[0] = i;
+        bonesPtr[1] = bonesPtr[2] = bonesPtr[3] = -1;
+    }
+    for (int i = 1; i < nbones - 1; i++) {
+        indices.append(0);
+        indices.append(i);
+        indices.append(i + 1);
+    }
+    materialIndexCounts.append(indices.count());
+    BonePalette palette(12);
+    ASSERT_FALSE(palette.build(vertexBones, indices, materialIndexCounts));
+    ASSERT_TRUE(palette.isBuilt());
+    ASSERT_TRUE(palette.isFallback());
+    ASSERT_EQ(1, palette.countSubsets(0));
+    ASSERT_EQ(nbones, palette.subsetAt(0, 0)->boneIndices.count());
+    for (int i = 0; i < nbones; i++) {
+        ASSERT_EQ(i, palette.boneSlot(i));
+    }
+    AssertBonePaletteCoversMaterials(palette, vertexBones, indices, materialIndexCounts);
+}
+
+TEST(InternalTest, ModelBindingCacheReusesBindings)
+{
+    String bone1Name("bone1"), bone2Name("bone2"), missingName("missing");
+    MockIBone bone;
+    EXPECT_CALL(bone, name(_)).WillRepeatedly(Return(&bone2Name));
+    EXPECT_CALL(bone, index()).WillRepeatedly(Return(1));
+    MockIModel model;
+    EXPECT_CALL(model, count(IModel::kBone)).WillRepeatedly(Return(2));
+    EXPECT_CALL(model, findBoneRef(_)).Times(2).WillRepeatedly(Return(static_cast<IBone *>(0)));
+    EXPECT_CALL(model, findBoneRef(&bone2Name)).Times(1).WillOnce(Return(&bone));
+    EXPECT_CALL(model, findBoneRefAt(1)).WillRepeatedly(Return(&bone));
+    Array<const IString *> names;
+    names.append(&bone1Name);
+    names.append(&bone2Name);
+    names.append(&missingName);
+    ModelBindingCache<IBone> cache;
+    const Array<IBone *> &boneRefs = cache.resolve(&model, names);
+    ASSERT_EQ(3, boneRefs.count());
+    ASSERT_EQ(0, boneRefs[0]);
+    ASSERT_EQ(&bone, boneRefs[1]);
+    ASSERT_EQ(0, boneRefs[2]);
+    /* the second resolution only validates the cached bones */
+    const Array<IBone *> &boneRefs2 = cache.resolve(&model, names);
+    ASSERT_EQ(&bone, boneRefs2[1]);
+    ASSERT_EQ(1, cache.countBindings());
+    cache.remove(&model);
+    ASSERT_EQ(0, cache.countBindings());
+}
+
+TEST(InternalTest, ModelBindingCacheKeepsBindingsUntilModelIsDeleted)
+{
+    String boneName("bone");
+    MockIBone bone, bone2;
+    EXPECT_CALL(bone, name(_)).WillRepeatedly(Return(&boneName));
+    EXPECT_CALL(bone, index()).WillRepeatedly(Return(0));
+    EXPECT_CALL(bone2, name(_)).WillRepeatedly(Return(&boneName));
+    EXPECT_CALL(bone2, index()).WillRepeatedly(Return(0));
+    MockIModel model, model2;
+    EXPECT_CALL(model, count(IModel::kBone)).WillRepeatedly(Return(1));
+    EXPECT_CALL(model, findBoneRefAt(0)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model2, count(IModel::kBone)).WillRepeatedly(Return(1));
+    EXPECT_CALL(model2, findBoneRefAt(0)).WillRepeatedly(Return(&bone2));
+    /* swapping between models does not resolve by name again */
+    EXPECT_CALL(model, findBoneRef(&boneName)).Times(2).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model2, findBoneRef(&boneName)).Times(1).WillOnce(Return(&bone2));
+    Array<const IString *> names;
+    names.append(&boneName);
+    ModelBindingCache<IBone> cache;
+    ASSERT_EQ(&bone, cache.resolve(&model, names)[0]);
+    ASSERT_EQ(&bone2, cache.resolve(&model2, names)[0]);
+    ASSERT_EQ(&bone, cache.resolve(&model, names)[0]);
+    ASSERT_EQ(2, cache.countBindings());
+    /* deleting any model drops all of bindings as the address may be reused */
+    vpvl2::internal::advanceModelGeneration();
+    ASSERT_EQ(&bone, cache.resolve(&model, names)[0]);
+    ASSERT_EQ(1, cache.countBindings());
+}
@@ -347,6 +347,62 @@ TEST(MVDMotionTest, SaveModelKeyframe)
     ASSERT_FALSE(cloned->isVisible());
 }
 
+struct MockBoneRefs {
+    void getBoneRefs(Array<IBone *> &value) {
+        value.copy(boneRefs);
+    }
+    Array<IBone *> boneRefs;
+};
+
+TEST(MVDMotionTest, DropNamesOfDetachedModel)
+{
+    Encoding encoding(0);
+    String ikBoneName("IK"), boneName("bone"), trackName("track"), otherIKBoneName("other IK");
+    MockIBone ikBone, bone, otherIKBone;
+    EXPECT_CALL(ikBone, name(IEncoding::kDefaultLanguage)).WillRepeatedly(Return(&ikBoneName));
+    EXPECT_CALL(ikBone, hasInverseKinematics()).WillRepeatedly(Return(true));
+    EXPECT_CALL(bone, name(IEncoding::kDefaultLanguage)).WillRepeatedly(Return(&boneName));
+    EXPECT_CALL(bone, hasInverseKinematics()).WillRepeatedly(Return(false));
+    EXPECT_CALL(otherIKBone, name(IEncoding::kDefaultLanguage)).WillRepeatedly(Return(&otherIKBoneName));
+    EXPECT_CALL(otherIKBone, hasInverseKinematics()).WillRepeatedly(Return(true));
+    MockBoneRefs bones, otherBones;
+    bones.boneRefs.append(&ikBone);
+    bones.boneRefs.append(&bone);
+    otherBones.boneRefs.append(&otherIKBone);
+    MockIModel model, otherModel;
+    EXPECT_CALL(model, getBoneRefs(_)).WillRepeatedly(Invoke(&bones, &MockBoneRefs::getBoneRefs));
+    EXPECT_CALL(otherModel, getBoneRefs(_)).WillRepeatedly(Invoke(&otherBones, &MockBoneRefs::getBoneRefs));
+    mvd::NameListSection section(&encoding);
+    section.addName(&trackName);
+    section.setParentModel(&model);
+    /* only IK bones are referred from the model section */
+    ASSERT_NE(mvd::NameListSection::kNotFound, section.key(&ikBoneName));
+    ASSERT_EQ(mvd::NameListSection::kNotFound, section.key(&boneName));
+    section.setParentModel(&otherModel);
+    ASSERT_EQ(mvd::NameListSection::kNotFound, section.key(&ikBoneName));
+    ASSERT_EQ(0, section.key(&trackName));
+    const int otherIKBoneKey = section.key(&otherIKBoneName);
+    ASSERT_NE(mvd::NameListSection::kNotFound, otherIKBoneKey);
+    /* a name referred by a keyframe is kept after detaching the model */
+    section.addName(&otherIKBoneName);
+    section.setParentModel(0);
+    ASSERT_EQ(otherIKBoneKey, section.key(&otherIKBoneName));
+    /* keys are saved as is even if they are sparse */
+    mvd::Motion::DataInfo info;
+    info.encoding = &encoding;
+    std::unique_ptr<uint8[]> ptr(new uint8[section.estimateSize(info)]);
+    section.write(ptr.get(), info);
+    mvd::NameListSection newSection(&encoding);
+    newSection.read(ptr.get() + sizeof(mvd::Motion::SectionTag), info.codec);
+    Array<const IString *> names;
+    newSection.getNames(names);
+    ASSERT_EQ(2, names.count());
+    ASSERT_EQ(0, newSection.key(&trackName));
+    ASSERT_EQ(otherIKBoneKey, newSection.key(&otherIKBoneName));
+    newSection.addName(&boneName);
+    ASSERT_LT(otherIKBoneKey, newSection.key(&boneName));
+}
+
 /*
 TEST(MVDMotionTest, SaveLightKeyframe)
 {
@@ -0,0 +1,81 @@
+#include "Common.h"
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/extensions/PlaybackScheduler.h"
+#include "mock/Motion.h"
+
+using namespace ::testing;
+using namespace vpvl2;
+using namespace vpvl2::extensions;
+
+namespace {
+
+struct ManualClock : PlaybackScheduler::IClock {
+    ManualClock() : seconds(0) {}
+    float64 currentSeconds() const { return seconds; }
+    float64 seconds;
+};
+
+}
+
+TEST(PlaybackSchedulerTest, QuantizeToFrameSlots)
+{
+    Scene scene(true);
+    ManualClock clock;
+    PlaybackScheduler scheduler(&scene, 0);
+    scheduler.setClockRef(&clock);
+    ASSERT_EQ(PlaybackScheduler::kFrameIdle, scheduler.tick());
+    scheduler.start();
+    ASSERT_TRUE(scheduler.isRunning());
+    ASSERT_EQ(PlaybackScheduler::kFramePresent, scheduler.tick());
+    ASSERT_FLOAT_EQ(0, scheduler.currentTimeIndex());
+    /* same slot must not be updated twice */
+    ASSERT_EQ(PlaybackScheduler::kFrameIdle, scheduler.tick());
+    clock.seconds = 1.5 / Scene::defaultFPS();
+    ASSERT_EQ(PlaybackScheduler::kFramePresent, scheduler.tick());
+    ASSERT_FLOAT_EQ(1, scheduler.currentTimeIndex());
+    ASSERT_FLOAT_EQ(1, scene.currentTimeIndex());
+    /* the clock going backward is ignored until seek */
+    clock.seconds = 0;
+    ASSERT_EQ(PlaybackScheduler::kFrameIdle, scheduler.tick());
+    ASSERT_EQ(2, scheduler.statistics().numPresentedFrames);
+    ASSERT_EQ(0, scheduler.statistics().numDroppedFrames());
+}
+
+TEST(PlaybackSchedulerTest, CountMissedFrames)
+{
+    Scene scene(true);
+    ManualClock clock;
+    PlaybackScheduler scheduler(&scene, 0);
+    scheduler.setClockRef(&clock);
+    scheduler.start();
+    scheduler.tick();
+    clock.seconds = 4.5 / Scene::defaultFPS();
+    ASSERT_EQ(PlaybackScheduler::kFramePresent, scheduler.tick());
+    ASSERT_FLOAT_EQ(4, scheduler.currentTimeIndex());
+    ASSERT_EQ(3, scheduler.statistics().numMissedFrames);
+    ASSERT_EQ(3, scheduler.statistics().numDroppedFrames());
+    scheduler.resetStatistics();
+    ASSERT_EQ(0, scheduler.statistics().numDroppedFrames());
+}
+
+TEST(PlaybackSchedulerTest, SeekMotions)
+{
+    Scene scene(true);
+    ManualClock clock;
+    MockIMotion motion;
+    EXPECT_CALL(motion, type()).WillRepeatedly(Return(IMotion::kMaxFormatType));
+    scene.addMotion(&motion);
+    PlaybackScheduler scheduler(&scene, 0);
+    scheduler.setClockRef(&clock);
+    clock.seconds = 10;
+    EXPECT_CALL(motion, seekTimeIndex(42)).WillOnce(Return());
+    scheduler.seek(42);
+    scheduler.start();
+    EXPECT_CALL(motion, seekTimeIndex(42)).WillOnce(Return());
+    ASSERT_EQ(PlaybackScheduler::kFramePresent, scheduler.tick());
+    clock.seconds = 10 + 1.5 / Scene::defaultFPS();
+    EXPECT_CALL(motion, seekTimeIndex(43)).WillOnce(Return());
+    ASSERT_EQ(PlaybackScheduler::kFramePresent, scheduler.tick());
+    scene.removeMotion(&motion);
+}
@@ -0,0 +1,94 @@
+#include "Common.h"
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/extensions/ProgramBinaryCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+using namespace ::testing;
+using namespace vpvl2;
+using namespace vpvl2::extensions;
+
+namespace {
+
+static const uint8 kBinary[] = { 0xde, 0xad, 0xbe, 0xef, 0x01, 0x02 };
+
+static bool FindBinary(ProgramBinaryCache &cache, const char *key, uint32 expectedFormat)
+{
+    uint32 format = 0;
+    Array<uint8> bytes;
+    if (!cache.findProgramBinary(key, format, bytes)) {
+        return false;
+    }
+    return format == expectedFormat
+            && bytes.count() == int(sizeof(kBinary))
+            && std::memcmp(&bytes[0], kBinary, sizeof(kBinary)) == 0;
+}
+
+}
+
+TEST(ProgramBinaryCacheTest, FindAndStore)
+{
+    ProgramBinaryCache cache;
+    uint32 format = 0;
+    Array<uint8> bytes;
+    ASSERT_FALSE(cache.findProgramBinary("program", format, bytes));
+    cache.storeProgramBinary("program", 42, kBinary, sizeof(kBinary));
+    ASSERT_EQ(1, cache.countBinaries());
+    ASSERT_TRUE(FindBinary(cache, "program", 42));
+    ASSERT_FALSE(cache.findProgramBinary("other", format, bytes));
+    /* storing the same key replaces the binary */
+    cache.storeProgramBinary("program", 43, kBinary, sizeof(kBinary));
+    ASSERT_EQ(1, cache.countBinaries());
+    ASSERT_TRUE(FindBinary(cache, "program", 43));
+    cache.release();
+    ASSERT_EQ(0, cache.countBinaries());
+    ASSERT_FALSE(cache.findProgramBinary("program", format, bytes));
+}
+
+TEST(ProgramBinaryCacheTest, RestoreFromDirectory)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const std::string &path = directory.path().toStdString();
+    {
+        ProgramBinaryCache cache;
+        cache.setDirectory(path);
+        cache.storeProgramBinary("program", 42, kBinary, sizeof(kBinary));
+    }
+    ProgramBinaryCache cache;
+    cache.setDirectory(path);
+    ASSERT_EQ(0, cache.countBinaries());
+    ASSERT_TRUE(FindBinary(cache, "program", 42));
+    ASSERT_EQ(1, cache.countBinaries());
+    /* the cache without directory never reads the files */
+    ProgramBinaryCache memoryOnly;
+    uint32 format = 0;
+    Array<uint8> bytes;
+    ASSERT_FALSE(memoryOnly.findProgramBinary("program", format, bytes));
+}
+
+TEST(ProgramBinaryCacheTest, RejectBrokenSignature)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const std::string &path = directory.path().toStdString();
+    {
+        ProgramBinaryCache cache;
+        cache.setDirectory(path);
+        cache.storeProgramBinary("program", 42, kBinary, sizeof(kBinary));
+    }
+    {
+        std::fstream stream((path + "/program.vpvl2prog").c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        ASSERT_TRUE(stream.good());
+        stream.write("X", 1);
+    }
+    ProgramBinaryCache cache;
+    cache.setDirectory(path);
+    uint32 format = 0;
+    Array<uint8> bytes;
+    ASSERT_FALSE(cache.findProgramBinary("program", format, bytes));
+    ASSERT_EQ(0, cache.countBinaries());
+}
@@ -0,0 +1,170 @@
+#include "Common.h"
+#include "vpvl2/gl/RingBuffer.h"
+
+using namespace ::testing;
+using namespace vpvl2;
+using namespace vpvl2::gl;
+
+namespace {
+
+struct FlushedRange {
+    FlushedRange(GLintptr offset, GLsizeiptr size) : offset(offset), size(size) {}
+    bool operator==(const FlushedRange &other) const { return offset == other.offset && size == other.size; }
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+/* records calls instead of talking to the driver, so the ring buffer can be tested without a context */
+struct FakeDriver {
+    static uint8 storage[1024];
+    static std::vector<FlushedRange> flushed;
+    static GLintptr mappedOffset;
+    static int nmaps;
+    static int nfences;
+    static bool failMap;
+    static void GLAPIENTRY genBuffers(GLsizei /* n */, GLuint *buffers) { *buffers = 1; }
+    static void GLAPIENTRY bindBuffer(GLenum /* target */, GLuint /* buffer */) {}
+    static void GLAPIENTRY bufferData(GLenum /* target */, GLsizeiptr /* size */, const GLvoid * /* data */, GLenum /* usage */) {}
+    static void GLAPIENTRY bufferStorage(GLenum /* target */, GLsizeiptr /* size */, const GLvoid * /* data */, GLbitfield /* flags */) {}
+    static void GLAPIENTRY deleteBuffers(GLsizei /* n */, const GLuint * /* buffers */) {}
+    static GLboolean GLAPIENTRY unmapBuffer(GLenum /* target */) { return 1; }
+    static GLvoid *GLAPIENTRY mapBufferRange(GLenum /* target */, GLintptr offset, GLsizeiptr /* length */, GLbitfield /* access */) {
+        if (failMap) {
+            return 0;
+        }
+        mappedOffset = offset;
+        nmaps++;
+        return storage + offset;
+    }
+    static void GLAPIENTRY flushMappedBufferRange(GLenum /* target */, GLintptr offset, GLsizeiptr length) {
+        flushed.push_back(FlushedRange(offset, length));
+    }
+    static void *GLAPIENTRY fenceSync(GLenum /* condition */, GLbitfield /* flags */) { nfences++; return storage; }
+    static GLenum GLAPIENTRY clientWaitSync(void * /* sync */, GLbitfield /* flags */, uint64 /* timeout */) { return RingBuffer::kGL_ALREADY_SIGNALED; }
+    static void GLAPIENTRY deleteSync(void * /* sync */) {}
+    static void reset() {
+        flushed.clear();
+        mappedOffset = 0;
+        nmaps = 0;
+        nfences = 0;
+        failMap = false;
+    }
+};
+uint8 FakeDriver::storage[1024];
+std::vector<FlushedRange> FakeDriver::flushed;
+GLintptr FakeDriver::mappedOffset = 0;
+int FakeDriver::nmaps = 0;
+int FakeDriver::nfences = 0;
+bool FakeDriver::failMap = false;
+
+struct FakeResolver : IApplicationContext::FunctionResolver {
+    FakeResolver(int version, bool hasBufferStorage) : version(version), hasBufferStorage(hasBufferStorage) {}
+    bool hasExtension(const char * /* name */) const { return false; }
+    void *resolveSymbol(const char *name) const {
+        const std::string s(name);
+        if (s == "glGenBuffers") return reinterpret_cast<void *>(&FakeDriver::genBuffers);
+        if (s == "glBindBuffer") return reinterpret_cast<void *>(&FakeDriver::bindBuffer);
+        if (s == "glBufferData") return reinterpret_cast<void *>(&FakeDriver::bufferData);
+        if (s == "glBufferStorage") return hasBufferStorage ? reinterpret_cast<void *>(&FakeDriver::bufferStorage) : 0;
+        if (s == "glDeleteBuffers") return reinterpret_cast<void *>(&FakeDriver::deleteBuffers);
+        if (s == "glUnmapBuffer") return reinterpret_cast<void *>(&FakeDriver::unmapBuffer);
+        if (s == "glMapBufferRange") return reinterpret_cast<void *>(&FakeDriver::mapBufferRange);
+        if (s == "glFlushMappedBufferRange") return reinterpret_cast<void *>(&FakeDriver::flushMappedBufferRange);
+        if (s == "glFenceSync") return reinterpret_cast<void *>(&FakeDriver::fenceSync);
+        if (s == "glClientWaitSync") return reinterpret_cast<void *>(&FakeDriver::clientWaitSync);
+        if (s == "glDeleteSync") return reinterpret_cast<void *>(&FakeDriver::deleteSync);
+        return 0;
+    }
+    int query(QueryType /* type */) const { return version; }
+    int version;
+    bool hasBufferStorage;
+};
+
+void writeFrame(RingBuffer &ringBuffer, vsize offset, vsize size)
+{
+    ASSERT_TRUE(ringBuffer.begin());
+    ringBuffer.markDirty(offset, size);
+    ringBuffer.end();
+}
+
+}
+
+TEST(RingBufferTest, RequiresSync)
+{
+    FakeResolver resolver(gl::makeVersion(2, 1), false);
+    RingBuffer ringBuffer(&resolver);
+    ASSERT_FALSE(ringBuffer.isSupported());
+    ASSERT_FALSE(ringBuffer.create(100));
+    ASSERT_EQ(RingBuffer::kNoneMap, ringBuffer.mapType());
+}
+
+TEST(RingBufferTest, PersistentMapFlushesOnlyDirtyRanges)
+{
+    FakeDriver::reset();
+    FakeResolver resolver(gl::makeVersion(4, 4), true);
+    RingBuffer ringBuffer(&resolver, 3);
+    ASSERT_TRUE(ringBuffer.create(100));
+    ASSERT_EQ(RingBuffer::kPersistentMap, ringBuffer.mapType());
+    ASSERT_EQ(1, FakeDriver::nmaps);
+    /* every segment is uploaded whole once */
+    for (int i = 0; i < 3; i++) {
+        writeFrame(ringBuffer, 0, 100);
+        ASSERT_EQ(i, ringBuffer.currentSegment());
+        ASSERT_EQ(FlushedRange(i * 100, 100), FakeDriver::flushed.back());
+    }
+    FakeDriver::flushed.clear();
+    /* segments still have to catch up with the full writes of the previous two frames */
+    writeFrame(ringBuffer, 10, 20);
+    writeFrame(ringBuffer, 10, 20);
+    ASSERT_EQ(FlushedRange(0, 100), FakeDriver::flushed[0]);
+    ASSERT_EQ(FlushedRange(100, 100), FakeDriver::flushed[1]);
+    writeFrame(ringBuffer, 10, 20);
+    ASSERT_EQ(FlushedRange(210, 20), FakeDriver::flushed[2]);
+    /* clean frames flush what the other segments have changed since */
+    writeFrame(ringBuffer, 0, 0);
+    writeFrame(ringBuffer, 0, 0);
+    ASSERT_EQ(FlushedRange(10, 20), FakeDriver::flushed[3]);
+    ASSERT_EQ(FlushedRange(110, 20), FakeDriver::flushed[4]);
+    writeFrame(ringBuffer, 0, 0);
+    ASSERT_EQ(std::vector<FlushedRange>::size_type(5), FakeDriver::flushed.size());
+    ASSERT_EQ(1, FakeDriver::nmaps);
+    ASSERT_EQ(8, FakeDriver::nfences);
+}
+
+TEST(RingBufferTest, FlushExplicitMapsEachSegment)
+{
+    FakeDriver::reset();
+    FakeResolver resolver(gl::makeVersion(3, 2), false);
+    RingBuffer ringBuffer(&resolver, 2);
+    ASSERT_TRUE(ringBuffer.create(64));
+    ASSERT_EQ(RingBuffer::kFlushExplicitMap, ringBuffer.mapType());
+    writeFrame(ringBuffer, 0, 64);
+    writeFrame(ringBuffer, 0, 64);
+    ASSERT_EQ(GLintptr(64), FakeDriver::mappedOffset);
+    writeFrame(ringBuffer, 8, 16);
+    /* offsets are relative to the mapped segment */
+    ASSERT_EQ(GLintptr(0), FakeDriver::mappedOffset);
+    ASSERT_EQ(FlushedRange(0, 64), FakeDriver::flushed.back());
+    writeFrame(ringBuffer, 0, 0);
+    ASSERT_EQ(FlushedRange(8, 16), FakeDriver::flushed.back());
+    ASSERT_EQ(4, FakeDriver::nmaps);
+}
+
+TEST(RingBufferTest, KeepSegmentIfMappingFailed)
+{
+    FakeDriver::reset();
+    FakeResolver resolver(gl::makeVersion(3, 2), false);
+    RingBuffer ringBuffer(&resolver, 3);
+    ASSERT_TRUE(ringBuffer.create(32));
+    writeFrame(ringBuffer, 0, 32);
+    ASSERT_EQ(0, ringBuffer.currentSegment());
+    FakeDriver::failMap = true;
+    ASSERT_FALSE(ringBuffer.begin());
+    ASSERT_FALSE(ringBuffer.begin());
+    ASSERT_EQ(0, ringBuffer.currentSegment());
+    FakeDriver::failMap = false;
+    writeFrame(ringBuffer, 0, 32);
+    ASSERT_EQ(1, ringBuffer.currentSegment());
+    ASSERT_EQ(GLintptr(32), FakeDriver::mappedOffset);
+    ASSERT_EQ(FlushedRange(0, 32), FakeDriver::flushed.back());
+}
@@ -3,7 +3,9 @@
 #include "vpvl2/vpvl2.h"
 #include "vpvl2/IApplicationContext.h"
 #include "vpvl2/extensions/icu4c/Encoding.h"
+#include "vpvl2/internal/Frustum.h"
 #include "mock/ApplicationContext.h"
+#include "mock/Material.h"
 #include "mock/Model.h"
 #include "mock/Motion.h"
 #include "mock/RenderEngine.h"
@@ -484,6 +486,182 @@ TEST(SceneTest, CreateRenderEngine)
     ASSERT_EQ(static_cast<IRenderEngine *>(0), scene.createRenderEngine(&applicationContext, 0, 0));
 }
 
+static const float32 kIdentityMatrix[] = {
+    1, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1
+};
+
+static bool ComputeCullingAabb(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes)
+{
+    /* the first material is inside of the clip space and the second one is out of it */
+    min.setValue(-1, -1, -1);
+    max.setValue(11, 1, 1);
+    materialAabbs->clear();
+    materialAabbs->append(Vector3(-1, -1, -1));
+    materialAabbs->append(Vector3(1, 1, 1));
+    materialAabbs->append(Vector3(10, 0, 0));
+    materialAabbs->append(Vector3(11, 1, 1));
+    materialEdgeSizes->clear();
+    materialEdgeSizes->append(1);
+    materialEdgeSizes->append(1);
+    return true;
+}
+
+TEST(SceneTest, FrustumPlanes)
+{
+    vpvl2::internal::Frustum frustum;
+    ASSERT_FALSE(frustum.isEnabled());
+    /* the clip space of the identity matrix is [-1, 1] of each axis */
+    frustum.setMatrix(kIdentityMatrix);
+    ASSERT_TRUE(frustum.isEnabled());
+    static const Vector3 kNormals[] = {
+        Vector3(1, 0, 0), Vector3(-1, 0, 0), Vector3(0, 1, 0), Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1)
+    };
+    for (int i = 0; i < vpvl2::internal::Frustum::kMaxPlaneType; i++) {
+        Vector3 normal;
+        Scalar distance;
+        frustum.getPlane(static_cast<vpvl2::internal::Frustum::PlaneType>(i), normal, distance);
+        ASSERT_EQ(kNormals[i], normal);
+        ASSERT_FLOAT_EQ(1, distance);
+    }
+    ASSERT_TRUE(frustum.intersects(Vector3(-0.5f, -0.5f, -0.5f), Vector3(0.5f, 0.5f, 0.5f)));
+    ASSERT_TRUE(frustum.intersects(Vector3(0.5f, 0.5f, 0.5f), Vector3(2, 2, 2)));
+    ASSERT_TRUE(frustum.intersects(Vector3(-2, -2, -2), Vector3(2, 2, 2)));
+    ASSERT_FALSE(frustum.intersects(Vector3(1.5f, -0.5f, -0.5f), Vector3(2, 0.5f, 0.5f)));
+    ASSERT_FALSE(frustum.intersects(Vector3(-0.5f, -0.5f, -3), Vector3(0.5f, 0.5f, -2)));
+    /* translating the clip space by 0.5 along x axis moves the left and right planes */
+    float32 matrix[16];
+    std::copy(kIdentityMatrix, kIdentityMatrix + 16, matrix);
+    matrix[12] = 0.5f;
+    frustum.setMatrix(matrix);
+    Vector3 normal;
+    Scalar distance;
+    frustum.getPlane(vpvl2::internal::Frustum::kLeftPlane, normal, distance);
+    ASSERT_FLOAT_EQ(1.5f, distance);
+    frustum.getPlane(vpvl2::internal::Frustum::kRightPlane, normal, distance);
+    ASSERT_FLOAT_EQ(0.5f, distance);
+    ASSERT_TRUE(frustum.intersects(Vector3(-1.4f, 0, 0), Vector3(-1.2f, 0, 0)));
+    ASSERT_FALSE(frustum.intersects(Vector3(0.6f, 0, 0), Vector3(0.8f, 0, 0)));
+    frustum.setMatrix(0);
+    ASSERT_FALSE(frustum.isEnabled());
+}
+
+TEST(SceneTest, FrustumProjectOntoGround)
+{
+    Vector3 shadowMin, shadowMax;
+    /* the shadow bounds contain both of the box and the projected box */
+    ASSERT_TRUE(vpvl2::internal::Frustum::projectOntoGround(Vector3(0, 1, 0), Vector3(1, 2, 1), Vector3(1, -1, 0), shadowMin, shadowMax));
+    ASSERT_EQ(Vector3(0, 0, 0), shadowMin);
+    ASSERT_EQ(Vector3(3, 2, 1), shadowMax);
+    /* the direction of the light does not matter */
+    ASSERT_TRUE(vpvl2::internal::Frustum::projectOntoGround(Vector3(0, 1, 0), Vector3(1, 2, 1), Vector3(-1, 1, 0), shadowMin, shadowMax));
+    ASSERT_EQ(Vector3(0, 0, 0), shadowMin);
+    ASSERT_EQ(Vector3(3, 2, 1), shadowMax);
+    /* a box under the ground is projected upward */
+    ASSERT_TRUE(vpvl2::internal::Frustum::projectOntoGround(Vector3(0, -2, 0), Vector3(1, -1, 1), Vector3(0, -1, 1), shadowMin, shadowMax));
+    ASSERT_EQ(Vector3(0, -2, -2), shadowMin);
+    ASSERT_EQ(Vector3(1, 0, 1), shadowMax);
+    /* the light parallel to the ground never casts the shadow */
+    ASSERT_FALSE(vpvl2::internal::Frustum::projectOntoGround(Vector3(0, 1, 0), Vector3(1, 2, 1), Vector3(1, 0, 0), shadowMin, shadowMax));
+}
+
+TEST(SceneTest, CullModelsAndMaterials)
+{
+    MockIMaterial material;
+    EXPECT_CALL(material, edgeSize()).WillRepeatedly(Return(1));
+    std::unique_ptr<MockIModel> model(new MockIModel());
+    std::unique_ptr<MockIRenderEngine> engine(new MockIRenderEngine());
+    String s(UnicodeString::fromUTF8("This is a test model."));
+    /* ignore setting setParentSceneRef */
+    EXPECT_CALL(*model, type()).WillRepeatedly(Return(IModel::kMaxModelType));
+    EXPECT_CALL(*model, name(IEncoding::kDefaultLanguage)).WillRepeatedly(Return(&s));
+    EXPECT_CALL(*model, joinWorld(0)).Times(1);
+    EXPECT_CALL(*model, isVisible()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*model, computeConservativeAabb(_, _, _, _)).WillRepeatedly(Invoke(ComputeCullingAabb));
+    EXPECT_CALL(*model, getMaterialRefs(_)).WillRepeatedly(Invoke([&material](Array<IMaterial *> &value) {
+        value.clear();
+        value.append(&material);
+        value.append(&material);
+    }));
+    EXPECT_CALL(*model, worldOrientation()).WillRepeatedly(Return(Quaternion::getIdentity()));
+    EXPECT_CALL(*model, worldTranslation()).WillRepeatedly(Return(kZeroV3));
+    EXPECT_CALL(*model, parentBoneRef()).WillRepeatedly(Return(static_cast<IBone *>(0)));
+    EXPECT_CALL(*model, scaleFactor()).WillRepeatedly(Return(1));
+    EXPECT_CALL(*model, edgeScaleFactor(_)).WillOnce(Return(0)).WillRepeatedly(Return(10));
+    EXPECT_CALL(*engine, parentModelRef()).WillRepeatedly(Return(model.get()));
+    EXPECT_CALL(*engine, effectRef(_)).WillRepeatedly(Return(static_cast<IEffect *>(0)));
+    EXPECT_CALL(*engine, hasPreProcess()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*engine, hasPostProcess()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*engine, update()).Times(5);
+    EXPECT_CALL(*engine, release()).WillOnce(Return());
+    Scene scene(true);
+    const IModel *modelRef = model.get();
+    scene.addModel(model.release(), engine.release(), 0);
+    ASSERT_FALSE(scene.isCullingEnabled());
+    scene.setCullingEnable(true);
+    /* nothing is culled until the matrix of the view frustum is set */
+    scene.update(Scene::kUpdateRenderEngines);
+    ASSERT_FALSE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingViewFrustum));
+    scene.setCullingMatrix(Scene::kCullingViewFrustum, kIdentityMatrix);
+    scene.update(Scene::kUpdateRenderEngines);
+    ASSERT_FALSE(scene.isModelCulled(modelRef, Scene::kCullingViewFrustum));
+    ASSERT_FALSE(scene.isMaterialCulled(modelRef, 0, Scene::kCullingViewFrustum));
+    ASSERT_TRUE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingViewFrustum));
+    /* the ground shadow of the second material falls outside of the view along the default light */
+    ASSERT_FALSE(scene.isMaterialCulled(modelRef, 0, Scene::kCullingGroundShadow));
+    ASSERT_TRUE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingGroundShadow));
+    /* the shadow map pass is culled without IShadowMap */
+    ASSERT_TRUE(scene.isMaterialCulled(modelRef, 0, Scene::kCullingShadowFrustum));
+    ASSERT_TRUE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingEdge));
+    ASSERT_TRUE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingViewFrustum | Scene::kCullingEdge));
+    /* wide edges of the second material reach the view */
+    scene.setCullingMatrix(Scene::kCullingViewFrustum, kIdentityMatrix);
+    scene.update(Scene::kUpdateRenderEngines);
+    ASSERT_TRUE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingViewFrustum));
+    ASSERT_FALSE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingEdge));
+    /* the matrix is used only by one update not to cull with the frustum of the previous frame */
+    scene.update(Scene::kUpdateRenderEngines);
+    ASSERT_FALSE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingViewFrustum));
+    scene.setCullingMatrix(Scene::kCullingViewFrustum, kIdentityMatrix);
+    scene.update(Scene::kUpdateRenderEngines);
+    scene.setCullingEnable(false);
+    ASSERT_FALSE(scene.isMaterialCulled(modelRef, 1, Scene::kCullingViewFrustum));
+}
+
+TEST(SceneTest, SkipUpdatingCulledModel)
+{
+    std::unique_ptr<MockIModel> model(new MockIModel());
+    std::unique_ptr<MockIRenderEngine> engine(new MockIRenderEngine());
+    String s(UnicodeString::fromUTF8("This is a test model."));
+    EXPECT_CALL(*model, type()).WillRepeatedly(Return(IModel::kMaxModelType));
+    EXPECT_CALL(*model, name(IEncoding::kDefaultLanguage)).WillRepeatedly(Return(&s));
+    EXPECT_CALL(*model, joinWorld(0)).Times(1);
+    EXPECT_CALL(*model, isVisible()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*model, computeConservativeAabb(_, _, _, _)).WillRepeatedly(Invoke(ComputeCullingAabb));
+    EXPECT_CALL(*model, getMaterialRefs(_)).WillRepeatedly(Return());
+    EXPECT_CALL(*model, worldOrientation()).WillRepeatedly(Return(Quaternion::getIdentity()));
+    /* moves the whole model far away from the view */
+    EXPECT_CALL(*model, worldTranslation()).WillRepeatedly(Return(Vector3(100, 0, 0)));
+    EXPECT_CALL(*model, parentBoneRef()).WillRepeatedly(Return(static_cast<IBone *>(0)));
+    EXPECT_CALL(*model, scaleFactor()).WillRepeatedly(Return(1));
+    EXPECT_CALL(*model, edgeScaleFactor(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*engine, parentModelRef()).WillRepeatedly(Return(model.get()));
+    EXPECT_CALL(*engine, effectRef(_)).WillRepeatedly(Return(static_cast<IEffect *>(0)));
+    EXPECT_CALL(*engine, hasPreProcess()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*engine, hasPostProcess()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*engine, update()).Times(0);
+    EXPECT_CALL(*engine, release()).WillOnce(Return());
+    Scene scene(true);
+    const IModel *modelRef = model.get();
+    scene.addModel(model.release(), engine.release(), 0);
+    scene.setCullingEnable(true);
+    scene.setCullingMatrix(Scene::kCullingViewFrustum, kIdentityMatrix);
+    scene.update(Scene::kUpdateRenderEngines);
+    ASSERT_TRUE(scene.isModelCulled(modelRef, Scene::kCullingAll));
+}
+
 TEST(SceneModel, HandleDefaultCamera)
 {
     Scene scene(true);
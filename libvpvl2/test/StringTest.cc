@@ -2,6 +2,8 @@
 #include "vpvl2/extensions/icu4c/Encoding.h"
 #include "vpvl2/extensions/icu4c/String.h"
 
+#include <cstdio>
+
 using namespace ::testing;
 using namespace vpvl2;
 using namespace vpvl2::extensions::icu4c;
@@ -65,6 +67,89 @@ TEST(String, Clone)
     ASSERT_TRUE(c2.get() != s.get());
 }
 
+TEST(String, Intern)
+{
+    const vsize count = String::countInternedStrings();
+    std::unique_ptr<String> s1(new String("interned")), s2(new String("interned"));
+    ASSERT_EQ(count + 1, String::countInternedStrings());
+    ASSERT_EQ(s1->toByteArray(), s2->toByteArray());
+    ASSERT_TRUE(s1->equals(s2.get()));
+    std::unique_ptr<IString> c(s1->clone()), other(new String("not interned"));
+    ASSERT_EQ(count + 2, String::countInternedStrings());
+    ASSERT_TRUE(c->equals(s2.get()));
+    ASSERT_FALSE(c->equals(other.get()));
+    s1.reset();
+    s2.reset();
+    ASSERT_STREQ("interned", reinterpret_cast<const char *>(c->toByteArray()));
+    c.reset();
+    other.reset();
+    ASSERT_EQ(count, String::countInternedStrings());
+}
+
+namespace {
+
+class InternStringThread : public QThread {
+public:
+    void run() {
+        /* acquires and releases the same entries as other threads */
+        for (int i = 0; i < 10000; i++) {
+            char value[16];
+            snprintf(value, sizeof(value), "thread%d", i % 8);
+            String s1(value), s2(value);
+            std::unique_ptr<IString> c(s1.clone());
+            if (!c->equals(&s2) || s1.value() != s2.value()) {
+                failed = true;
+            }
+        }
+    }
+    bool failed;
+};
+
+}
+
+TEST(String, InternFromThreads)
+{
+    const vsize count = String::countInternedStrings();
+    String held("thread0");
+    InternStringThread threads[4];
+    for (int i = 0; i < 4; i++) {
+        threads[i].failed = false;
+        threads[i].start();
+    }
+    for (int i = 0; i < 4; i++) {
+        threads[i].wait();
+        ASSERT_FALSE(threads[i].failed);
+    }
+    ASSERT_EQ(count + 1, String::countInternedStrings());
+}
+
+TEST(String, LengthOfNonASCII)
+{
+    String c("\xe3\x81\x84\xe3\x82\x8d\xe3\x81\xaf\xf0\x9f\x8d\xa3");
+    ASSERT_EQ(c.value().length(), int32_t(c.size()));
+}
+
+TEST(String, LengthOfInvalidUTF8)
+{
+    /* a stray continuation byte, an invalid lead byte and a truncated sequence */
+    std::unique_ptr<IString> s(String::create("a\x80" "b\xf8" "c\xe3\x81"));
+    ASSERT_EQ(static_cast<const String *>(s.get())->value().length(), int32_t(s->size()));
+}
+
+TEST(String, KeepUnpairedSurrogates)
+{
+    UnicodeString lead, trail;
+    lead.append(UChar(0x61)).append(UChar(0xd800));
+    trail.append(UChar(0x61)).append(UChar(0xdc00));
+    String s1(lead), s2(trail), s3(lead);
+    ASSERT_TRUE(s1.value() == lead);
+    ASSERT_TRUE(s2.value() == trail);
+    ASSERT_FALSE(s1.equals(&s2));
+    ASSERT_TRUE(s1.equals(&s3));
+    ASSERT_EQ(vsize(2), s1.size());
+    ASSERT_STREQ("a\xef\xbf\xbd", s1.toStdString().c_str());
+}
+
 TEST(String, ToHashString)
 {
     Hash<HashString, int> hash;
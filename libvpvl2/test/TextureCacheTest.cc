@@ -0,0 +1,201 @@
+#include "Common.h"
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/extensions/TextureCache.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+
+using namespace ::testing;
+using namespace vpvl2;
+using namespace vpvl2::extensions;
+
+namespace {
+
+static std::string CreateTGA(int width, int height, uint8 seed)
+{
+    /* uncompressed 32bit true color image stored from top to bottom */
+    std::string bytes(18, 0);
+    bytes[2] = 2;
+    bytes[12] = char(width & 0xff);
+    bytes[13] = char(width >> 8);
+    bytes[14] = char(height & 0xff);
+    bytes[15] = char(height >> 8);
+    bytes[16] = 32;
+    bytes[17] = 0x28;
+    for (int i = 0, npixels = width * height; i < npixels; i++) {
+        bytes.push_back(char(seed + i));
+        bytes.push_back(char(seed));
+        bytes.push_back(char(i));
+        bytes.push_back(char(0xff));
+    }
+    return bytes;
+}
+
+static TextureDecoder::Image *CreateImage(const std::string &bytes, int flags)
+{
+    TextureDecoder::Image *image = new TextureDecoder::Image("test", reinterpret_cast<const uint8 *>(bytes.data()), bytes.size(), flags);
+    image->decode();
+    return image;
+}
+
+static TextureCache::Key CreateKey(const std::string &bytes, int flags)
+{
+    return TextureCache::createKey(reinterpret_cast<const uint8 *>(bytes.data()), bytes.size(), flags);
+}
+
+}
+
+TEST(TextureCacheTest, CreateKey)
+{
+    const std::string &bytes = CreateTGA(2, 2, 0), &other = CreateTGA(2, 2, 1);
+    const TextureCache::Key &key = CreateKey(bytes, TextureDecoder::kNone);
+    ASSERT_FALSE(key < CreateKey(bytes, TextureDecoder::kNone));
+    ASSERT_FALSE(CreateKey(bytes, TextureDecoder::kNone) < key);
+    ASSERT_NE(key.toString(), CreateKey(bytes, TextureDecoder::kFlipVertically).toString());
+    ASSERT_NE(key.toString(), CreateKey(other, TextureDecoder::kNone).toString());
+}
+
+TEST(TextureCacheTest, FindAndInsert)
+{
+    const std::string &bytes = CreateTGA(4, 4, 0);
+    const TextureCache::Key &key = CreateKey(bytes, TextureDecoder::kNone);
+    TextureCache cache;
+    ASSERT_FALSE(cache.find(key));
+    TextureDecoder::Image *image = CreateImage(bytes, TextureDecoder::kNone);
+    ASSERT_EQ(image, cache.insert(key, image));
+    ASSERT_EQ(image, cache.find(key));
+    ASSERT_EQ(1, cache.countImages());
+    ASSERT_EQ(image->totalBytes(), cache.totalBytes());
+    /* the image decoded at the same time is discarded */
+    ASSERT_EQ(image, cache.insert(key, CreateImage(bytes, TextureDecoder::kNone)));
+    ASSERT_EQ(1, cache.countImages());
+    ASSERT_FALSE(cache.find(CreateKey(bytes, TextureDecoder::kFlipVertically)));
+}
+
+TEST(TextureCacheTest, EvictLeastRecentlyUsedImages)
+{
+    const std::string sources[] = { CreateTGA(4, 4, 0), CreateTGA(4, 4, 1), CreateTGA(4, 4, 2) };
+    TextureCache::Key keys[3];
+    TextureCache cache;
+    const vsize bytesPerImage = 4 * 4 * TextureDecoder::kNumComponents;
+    cache.setMaxBytes(bytesPerImage * 2);
+    for (int i = 0; i < 3; i++) {
+        keys[i] = CreateKey(sources[i], TextureDecoder::kNone);
+        cache.insert(keys[i], CreateImage(sources[i], TextureDecoder::kNone));
+    }
+    /* referenced images are never evicted even if the cache exceeds the budget */
+    ASSERT_EQ(3, cache.countImages());
+    cache.releaseImageRef(keys[1]);
+    ASSERT_EQ(2, cache.countImages());
+    ASSERT_FALSE(cache.find(keys[1]));
+    cache.releaseImageRef(keys[0]);
+    cache.releaseImageRef(keys[2]);
+    ASSERT_EQ(2, cache.countImages());
+    /* keys[0] is the least recently used one */
+    cache.find(keys[2]);
+    cache.releaseImageRef(keys[2]);
+    cache.setMaxBytes(bytesPerImage);
+    ASSERT_EQ(1, cache.countImages());
+    ASSERT_EQ(bytesPerImage, cache.totalBytes());
+    ASSERT_TRUE(cache.find(keys[2]));
+    cache.releaseImageRef(keys[2]);
+    /* zero budget drops images once all of references are released */
+    cache.setMaxBytes(0);
+    ASSERT_EQ(0, cache.countImages());
+    ASSERT_EQ(vsize(0), cache.totalBytes());
+}
+
+TEST(TextureCacheTest, ReleaseOnlyUnreferencedImages)
+{
+    const std::string sources[] = { CreateTGA(4, 4, 0), CreateTGA(4, 4, 1) };
+    TextureCache::Key keys[2];
+    TextureCache cache;
+    for (int i = 0; i < 2; i++) {
+        keys[i] = CreateKey(sources[i], TextureDecoder::kNone);
+        cache.insert(keys[i], CreateImage(sources[i], TextureDecoder::kNone));
+    }
+    cache.releaseImageRef(keys[0]);
+    cache.release();
+    ASSERT_EQ(1, cache.countImages());
+    ASSERT_EQ(vsize(4 * 4 * TextureDecoder::kNumComponents), cache.totalBytes());
+    ASSERT_FALSE(cache.find(keys[0]));
+    /* the referenced image is still alive and can be found again */
+    const TextureDecoder::Image *image = cache.find(keys[1]);
+    ASSERT_TRUE(image);
+    cache.releaseImageRef(keys[1]);
+    cache.releaseImageRef(keys[1]);
+    cache.release();
+    ASSERT_EQ(0, cache.countImages());
+}
+
+TEST(TextureCacheTest, SerializeAndRestore)
+{
+    const std::string &bytes = CreateTGA(5, 3, 8);
+    const int flags = TextureDecoder::kGenerateMipmaps;
+    std::unique_ptr<TextureDecoder::Image> image(CreateImage(bytes, flags));
+    std::string serialized;
+    image->serialize(serialized);
+    TextureDecoder::Image restored("test", 0, 0, flags);
+    ASSERT_TRUE(restored.restore(reinterpret_cast<const uint8 *>(serialized.data()), serialized.size()));
+    ASSERT_EQ(image->countLevels(), restored.countLevels());
+    for (int i = 0; i < image->countLevels(); i++) {
+        ASSERT_EQ(image->levelSize(i), restored.levelSize(i));
+        ASSERT_EQ(0, std::memcmp(image->levelPixels(i), restored.levelPixels(i), image->levelBytes(i)));
+    }
+    /* different flags */
+    TextureDecoder::Image flipped("test", 0, 0, TextureDecoder::kFlipVertically);
+    ASSERT_FALSE(flipped.restore(reinterpret_cast<const uint8 *>(serialized.data()), serialized.size()));
+    /* truncated payload */
+    TextureDecoder::Image truncated("test", 0, 0, flags);
+    ASSERT_FALSE(truncated.restore(reinterpret_cast<const uint8 *>(serialized.data()), serialized.size() - 1));
+    ASSERT_FALSE(truncated.isDecoded());
+    /* broken signature */
+    serialized[0] = 'X';
+    TextureDecoder::Image broken("test", 0, 0, flags);
+    ASSERT_FALSE(broken.restore(reinterpret_cast<const uint8 *>(serialized.data()), serialized.size()));
+}
+
+TEST(TextureCacheTest, RestoreFromDirectory)
+{
+    QTemporaryDir directory;
+    ASSERT_TRUE(directory.isValid());
+    const std::string &bytes = CreateTGA(4, 2, 0);
+    const TextureCache::Key &key = CreateKey(bytes, TextureDecoder::kNone);
+    std::unique_ptr<TextureDecoder::Image> image(CreateImage(bytes, TextureDecoder::kNone));
+    {
+        TextureCache cache;
+        cache.setDirectory(directory.path().toStdString());
+        cache.insert(key, CreateImage(bytes, TextureDecoder::kNone));
+    }
+    TextureCache cache;
+    cache.setDirectory(directory.path().toStdString());
+    const TextureDecoder::Image *restoredRef = cache.find(key);
+    ASSERT_TRUE(restoredRef);
+    ASSERT_EQ(image->levelSize(0), restoredRef->levelSize(0));
+    ASSERT_EQ(0, std::memcmp(image->levelPixels(0), restoredRef->levelPixels(0), image->levelBytes(0)));
+    ASSERT_FALSE(cache.find(CreateKey(bytes, TextureDecoder::kFlipVertically)));
+}
+
+TEST(TextureCacheTest, ShareImagesBetweenDecoders)
+{
+    const std::string &bytes = CreateTGA(4, 4, 0);
+    const uint8 *data = reinterpret_cast<const uint8 *>(bytes.data());
+    TextureCache cache;
+    cache.setMaxBytes(0);
+    TextureDecoder decoder1, decoder2;
+    decoder1.setCacheRef(&cache);
+    decoder2.setCacheRef(&cache);
+    decoder1.addJob("a", data, bytes.size(), TextureDecoder::kNone);
+    decoder1.decode(false);
+    decoder2.addJob("b", data, bytes.size(), TextureDecoder::kNone);
+    decoder2.decode(false);
+    ASSERT_TRUE(decoder1.findImage("a"));
+    ASSERT_EQ(decoder1.findImage("a"), decoder2.findImage("b"));
+    ASSERT_EQ(1, cache.countImages());
+    decoder1.release();
+    ASSERT_EQ(1, cache.countImages());
+    decoder2.release();
+    ASSERT_EQ(0, cache.countImages());
+}
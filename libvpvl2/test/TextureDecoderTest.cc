@@ -0,0 +1,132 @@
+#include "Common.h"
+
+#include "vpvl2/vpvl2.h"
+#include "vpvl2/extensions/TextureDecoder.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace ::testing;
+using namespace vpvl2;
+using namespace vpvl2::extensions;
+
+namespace {
+
+static std::string CreateTGA(int width, int height, uint8 seed)
+{
+    /* uncompressed 32bit true color image stored from top to bottom */
+    std::string bytes(18, 0);
+    bytes[2] = 2;
+    bytes[12] = char(width & 0xff);
+    bytes[13] = char(width >> 8);
+    bytes[14] = char(height & 0xff);
+    bytes[15] = char(height >> 8);
+    bytes[16] = 32;
+    bytes[17] = 0x28;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            /* BGRA */
+            bytes.push_back(char(seed + x));
+            bytes.push_back(char(seed + y));
+            bytes.push_back(char(seed));
+            bytes.push_back(char(0xff));
+        }
+    }
+    return bytes;
+}
+
+static const uint8 *DataOf(const std::string &bytes)
+{
+    return reinterpret_cast<const uint8 *>(bytes.data());
+}
+
+}
+
+TEST(TextureDecoderTest, DecodeImage)
+{
+    const std::string &bytes = CreateTGA(4, 2, 16);
+    TextureDecoder::Image image("test", DataOf(bytes), bytes.size(), TextureDecoder::kNone);
+    ASSERT_FALSE(image.isDecoded());
+    image.decode();
+    ASSERT_TRUE(image.isDecoded());
+    ASSERT_EQ(1, image.countLevels());
+    ASSERT_EQ(Vector3(4, 2, 1), image.levelSize(0));
+    ASSERT_EQ(vsize(4 * 2 * TextureDecoder::kNumComponents), image.levelBytes(0));
+    const uint8 *pixels = image.levelPixels(0);
+    /* RGBA of (x, y) = (3, 1) */
+    const uint8 *pixel = pixels + (1 * 4 + 3) * TextureDecoder::kNumComponents;
+    ASSERT_EQ(16, pixel[0]);
+    ASSERT_EQ(17, pixel[1]);
+    ASSERT_EQ(19, pixel[2]);
+    ASSERT_EQ(0xff, pixel[3]);
+}
+
+TEST(TextureDecoderTest, FlipVertically)
+{
+    const std::string &bytes = CreateTGA(3, 3, 0);
+    TextureDecoder::Image image("test", DataOf(bytes), bytes.size(), TextureDecoder::kFlipVertically);
+    image.decode();
+    ASSERT_TRUE(image.isDecoded());
+    const uint8 *pixels = image.levelPixels(0);
+    const vsize stride = 3 * TextureDecoder::kNumComponents;
+    ASSERT_EQ(2, pixels[1]);
+    ASSERT_EQ(1, pixels[stride + 1]);
+    ASSERT_EQ(0, pixels[stride * 2 + 1]);
+}
+
+TEST(TextureDecoderTest, GenerateMipmaps)
+{
+    const std::string &bytes = CreateTGA(8, 3, 0);
+    TextureDecoder::Image image("test", DataOf(bytes), bytes.size(), TextureDecoder::kGenerateMipmaps);
+    image.decode();
+    /* 8x3, 4x1, 2x1, 1x1 */
+    ASSERT_EQ(4, image.countLevels());
+    ASSERT_EQ(Vector3(4, 1, 1), image.levelSize(1));
+    ASSERT_EQ(Vector3(2, 1, 1), image.levelSize(2));
+    ASSERT_EQ(Vector3(1, 1, 1), image.levelSize(3));
+    /* blue channel of the first texel of the level 1 is the average of x = 0, 1, 0, 1 */
+    ASSERT_EQ(1, image.levelPixels(1)[2]);
+    ASSERT_EQ(0xff, image.levelPixels(3)[3]);
+}
+
+TEST(TextureDecoderTest, RejectBrokenImage)
+{
+    const std::string bytes(32, 'x');
+    TextureDecoder::Image image("broken", DataOf(bytes), bytes.size(), TextureDecoder::kNone);
+    image.decode();
+    ASSERT_FALSE(image.isDecoded());
+    ASSERT_EQ(0, image.countLevels());
+}
+
+class TextureDecoderParallelTest : public TestWithParam<bool> {};
+
+TEST_P(TextureDecoderParallelTest, DecodeAllJobs)
+{
+    static const int kNumImages = 32;
+    std::string sources[kNumImages];
+    TextureDecoder decoder;
+    for (int i = 0; i < kNumImages; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "image%d", i);
+        sources[i] = CreateTGA(16 + i, 8, uint8(i));
+        decoder.addJob(key, DataOf(sources[i]), sources[i].size(), TextureDecoder::kGenerateMipmaps);
+    }
+    /* the same key is decoded only once */
+    decoder.addJob("image0", DataOf(sources[1]), sources[1].size(), TextureDecoder::kNone);
+    decoder.addJob("broken", DataOf(sources[0]), 8, TextureDecoder::kNone);
+    decoder.decode(GetParam());
+    ASSERT_EQ(kNumImages + 1, decoder.countImages());
+    ASSERT_FALSE(decoder.findImage("broken"));
+    for (int i = 0; i < kNumImages; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "image%d", i);
+        const TextureDecoder::Image *imageRef = decoder.findImage(key);
+        ASSERT_TRUE(imageRef);
+        ASSERT_EQ(Vector3(Scalar(16 + i), 8, 1), imageRef->levelSize(0));
+        ASSERT_EQ(uint8(i), imageRef->levelPixels(0)[2]);
+    }
+    decoder.release();
+    ASSERT_EQ(0, decoder.countImages());
+}
+
+INSTANTIATE_TEST_CASE_P(TextureDecoderInstance, TextureDecoderParallelTest, Bool());
@@ -7,6 +7,8 @@
 #include "vpvl2/vmd/BoneKeyframe.h"
 #include "vpvl2/vmd/CameraAnimation.h"
 #include "vpvl2/vmd/CameraKeyframe.h"
+#include "vpvl2/vmd/CompressedBoneAnimation.h"
+#include "vpvl2/vmd/KeyframeReducer.h"
 #include "vpvl2/vmd/LightAnimation.h"
 #include "vpvl2/vmd/LightKeyframe.h"
 #include "vpvl2/vmd/ModelAnimation.h"
@@ -332,6 +334,46 @@ TEST(VMDMotionTest, SaveMotion)
     }
 }
 
+TEST(VMDMotionTest, SaveAndLoadShortNames)
+{
+    Encoding encoding(0);
+    String modelName("model"), boneName("bone"), morphName("morph");
+    MockIModel model;
+    EXPECT_CALL(model, name(_)).WillRepeatedly(Return(&modelName));
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Return(static_cast<IBone *>(0)));
+    EXPECT_CALL(model, findMorphRef(_)).WillRepeatedly(Return(static_cast<IMorph *>(0)));
+    vmd::Motion motion(0, &encoding);
+    motion.setParentModelRef(&model);
+    vmd::BoneKeyframe *boneKeyframe = new vmd::BoneKeyframe(&encoding);
+    boneKeyframe->setName(&boneName);
+    boneKeyframe->setTimeIndex(42);
+    boneKeyframe->setLocalTranslation(Vector3(1, 2, 3));
+    boneKeyframe->setDefaultInterpolationParameter();
+    motion.addKeyframe(boneKeyframe);
+    vmd::MorphKeyframe *morphKeyframe = new vmd::MorphKeyframe(&encoding);
+    morphKeyframe->setName(&morphName);
+    morphKeyframe->setTimeIndex(84);
+    morphKeyframe->setWeight(0.5);
+    motion.addKeyframe(morphKeyframe);
+    motion.update(IKeyframe::kBoneKeyframe);
+    motion.update(IKeyframe::kMorphKeyframe);
+    /* names shorter than their fixed length fields must not shift following fields */
+    const vsize size = motion.estimateSize();
+    std::unique_ptr<uint8[]> data(new uint8[size]);
+    motion.save(data.get());
+    vmd::Motion motion2(0, &encoding);
+    ASSERT_TRUE(motion2.load(data.get(), size));
+    ASSERT_TRUE(motion2.name()->equals(&modelName));
+    ASSERT_EQ(1, motion2.countKeyframes(IKeyframe::kBoneKeyframe));
+    const IBoneKeyframe *boneKeyframe2 = motion2.findBoneKeyframeRef(42, &boneName, 0);
+    ASSERT_TRUE(boneKeyframe2);
+    ASSERT_TRUE(CompareVector(Vector3(1, 2, 3), boneKeyframe2->localTranslation()));
+    ASSERT_EQ(1, motion2.countKeyframes(IKeyframe::kMorphKeyframe));
+    const IMorphKeyframe *morphKeyframe2 = motion2.findMorphKeyframeRef(84, &morphName, 0);
+    ASSERT_TRUE(morphKeyframe2);
+    ASSERT_FLOAT_EQ(0.5f, float(morphKeyframe2->weight()));
+}
+
 TEST(VMDMotionTest, CloneMotion)
 {
     QFile file("motion.vmd");
@@ -763,6 +805,554 @@ TEST(VMDMotionTest, AddAndRemoveMorphKeyframes)
     }
 }
 
+TEST(VMDMotionTest, UpdateBoneTrackIndexIncrementally)
+{
+    Encoding encoding(0);
+    String name("bone"), renamed("renamed");
+    MockIModel model;
+    MockIBone bone;
+    vmd::Motion motion(&model, &encoding);
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(bone, setLocalTranslation(_)).Times(AnyNumber());
+    EXPECT_CALL(bone, setLocalOrientation(_)).Times(AnyNumber());
+    motion.update(IKeyframe::kBoneKeyframe);
+    // keyframes added out of order are sorted once on lookup
+    IKeyframe::TimeIndex timeIndices[] = { 30, 10, 20, 0 };
+    vmd::BoneKeyframe *keyframes[4];
+    for (int i = 0; i < 4; i++) {
+        vmd::BoneKeyframe *keyframe = keyframes[i] = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(timeIndices[i]);
+        keyframe->setName(&name);
+        keyframe->setLocalTranslation(Vector3(0, 0, timeIndices[i]));
+        keyframe->setDefaultInterpolationParameter();
+        motion.addKeyframe(keyframe);
+    }
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(keyframes[i], motion.findBoneKeyframeRef(timeIndices[i], &name, 0));
+    }
+    ASSERT_EQ(IKeyframe::TimeIndex(30), motion.durationTimeIndex());
+    {
+        EXPECT_CALL(bone, setLocalTranslation(Vector3(0, 0, 15))).Times(1);
+        motion.seekTimeIndex(15);
+        Mock::VerifyAndClearExpectations(&bone);
+        EXPECT_CALL(bone, setLocalTranslation(_)).Times(AnyNumber());
+        EXPECT_CALL(bone, setLocalOrientation(_)).Times(AnyNumber());
+    }
+    // retimed in place
+    keyframes[1]->setTimeIndex(40);
+    motion.update(IKeyframe::kBoneKeyframe);
+    ASSERT_EQ(keyframes[1], motion.findBoneKeyframeRef(40, &name, 0));
+    ASSERT_EQ(static_cast<IBoneKeyframe *>(0), motion.findBoneKeyframeRef(10, &name, 0));
+    ASSERT_EQ(IKeyframe::TimeIndex(40), motion.durationTimeIndex());
+    {
+        Array<IKeyframe *> found;
+        motion.getKeyframeRefs(40, 0, IKeyframe::kBoneKeyframe, found);
+        ASSERT_EQ(1, found.count());
+        ASSERT_EQ(keyframes[1], found[0]);
+        found.clear();
+        motion.getKeyframeRefs(10, 0, IKeyframe::kBoneKeyframe, found);
+        ASSERT_EQ(0, found.count());
+    }
+    // removed from both of the track and the bucket
+    motion.removeKeyframe(keyframes[1]);
+    motion.update(IKeyframe::kBoneKeyframe);
+    ASSERT_EQ(3, motion.countKeyframes(IKeyframe::kBoneKeyframe));
+    // the order of the rest is kept
+    ASSERT_EQ(keyframes[2], motion.findBoneKeyframeRefAt(1));
+    ASSERT_EQ(keyframes[3], motion.findBoneKeyframeRefAt(2));
+    ASSERT_EQ(static_cast<IBoneKeyframe *>(0), motion.findBoneKeyframeRef(40, &name, 0));
+    ASSERT_EQ(IKeyframe::TimeIndex(30), motion.durationTimeIndex());
+    {
+        Array<IKeyframe *> found;
+        motion.getKeyframeRefs(40, 0, IKeyframe::kBoneKeyframe, found);
+        ASSERT_EQ(0, found.count());
+    }
+    // renamed in place, the track index is rebuilt on remove and re-add
+    keyframes[1]->setTimeIndex(10);
+    keyframes[1]->setName(&renamed);
+    motion.addKeyframe(keyframes[1]);
+    motion.update(IKeyframe::kBoneKeyframe);
+    ASSERT_EQ(keyframes[1], motion.findBoneKeyframeRef(10, &renamed, 0));
+    keyframes[2]->setName(&renamed);
+    motion.removeKeyframe(keyframes[2]);
+    motion.addKeyframe(keyframes[2]);
+    motion.update(IKeyframe::kBoneKeyframe);
+    ASSERT_EQ(keyframes[2], motion.findBoneKeyframeRef(20, &renamed, 0));
+    ASSERT_EQ(static_cast<IBoneKeyframe *>(0), motion.findBoneKeyframeRef(20, &name, 0));
+    ASSERT_EQ(keyframes[0], motion.findBoneKeyframeRef(30, &name, 0));
+}
+
+TEST(VMDMotionTest, UpdateMorphTrackIndexIncrementally)
+{
+    Encoding encoding(0);
+    String name("morph");
+    MockIModel model;
+    MockIMorph morph;
+    vmd::Motion motion(&model, &encoding);
+    EXPECT_CALL(model, findMorphRef(_)).WillRepeatedly(Return(&morph));
+    EXPECT_CALL(morph, setWeight(_)).Times(AnyNumber());
+    motion.update(IKeyframe::kMorphKeyframe);
+    IKeyframe::TimeIndex timeIndices[] = { 20, 0, 10 };
+    vmd::MorphKeyframe *keyframes[3];
+    for (int i = 0; i < 3; i++) {
+        vmd::MorphKeyframe *keyframe = keyframes[i] = new vmd::MorphKeyframe(&encoding);
+        keyframe->setTimeIndex(timeIndices[i]);
+        keyframe->setName(&name);
+        keyframe->setWeight(timeIndices[i] / 20.0f);
+        motion.addKeyframe(keyframe);
+    }
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(keyframes[i], motion.findMorphKeyframeRef(timeIndices[i], &name, 0));
+    }
+    {
+        EXPECT_CALL(morph, setWeight(0.25)).Times(1);
+        motion.seekTimeIndex(5);
+        Mock::VerifyAndClearExpectations(&morph);
+        EXPECT_CALL(morph, setWeight(_)).Times(AnyNumber());
+    }
+    keyframes[1]->setTimeIndex(30);
+    motion.update(IKeyframe::kMorphKeyframe);
+    ASSERT_EQ(keyframes[1], motion.findMorphKeyframeRef(30, &name, 0));
+    ASSERT_EQ(IKeyframe::TimeIndex(30), motion.durationTimeIndex());
+    motion.removeKeyframe(keyframes[1]);
+    motion.update(IKeyframe::kMorphKeyframe);
+    ASSERT_EQ(static_cast<IMorphKeyframe *>(0), motion.findMorphKeyframeRef(30, &name, 0));
+    ASSERT_EQ(IKeyframe::TimeIndex(20), motion.durationTimeIndex());
+    delete keyframes[1];
+}
+
+TEST(VMDMotionTest, ShareKeyframesWithInstances)
+{
+    Encoding encoding(0);
+    String name("bone");
+    MockIModel model, model2;
+    MockIBone bone, bone2;
+    vmd::Motion motion(&model, &encoding);
+    EXPECT_CALL(model, findBoneRef(_)).Times(AtLeast(1)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model2, findBoneRef(_)).Times(AtLeast(1)).WillRepeatedly(Return(&bone2));
+    EXPECT_CALL(model2, name(_)).WillRepeatedly(Return(static_cast<const IString *>(0)));
+    IKeyframe::TimeIndex timeIndices[] = { 0, 42 };
+    for (int i = 0; i < 2; i++) {
+        vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(timeIndices[i]);
+        keyframe->setName(&name);
+        keyframe->setLocalTranslation(Vector3(0, 0, timeIndices[i]));
+        keyframe->setDefaultInterpolationParameter();
+        motion.addKeyframe(keyframe);
+    }
+    motion.update(IKeyframe::kBoneKeyframe);
+    std::unique_ptr<vmd::Motion> instance(motion.createInstance(&model2));
+    ASSERT_TRUE(instance->isSharedInstance());
+    ASSERT_FALSE(motion.isSharedInstance());
+    ASSERT_EQ(&model2, instance->parentModelRef());
+    ASSERT_EQ(2, instance->countKeyframes(IKeyframe::kBoneKeyframe));
+    ASSERT_EQ(motion.findBoneKeyframeRefAt(1), instance->findBoneKeyframeRefAt(1));
+    ASSERT_EQ(motion.durationTimeIndex(), instance->durationTimeIndex());
+    {
+        // seeking the instance should only move the bone of the bound model
+        EXPECT_CALL(bone, setLocalTranslation(_)).Times(0);
+        EXPECT_CALL(bone2, setLocalTranslation(Vector3(0, 0, 42))).Times(1);
+        EXPECT_CALL(bone2, setLocalOrientation(_)).Times(1);
+        instance->seekTimeIndex(42);
+        Mock::VerifyAndClearExpectations(&bone);
+        Mock::VerifyAndClearExpectations(&bone2);
+    }
+    {
+        // keyframes of the instance cannot be modified
+        std::unique_ptr<vmd::BoneKeyframe> keyframe(new vmd::BoneKeyframe(&encoding));
+        keyframe->setTimeIndex(84);
+        keyframe->setName(&name);
+        instance->addKeyframe(keyframe.get());
+        instance->update(IKeyframe::kBoneKeyframe);
+        ASSERT_EQ(2, instance->countKeyframes(IKeyframe::kBoneKeyframe));
+        // but follows modification of the source motion
+        motion.addKeyframe(keyframe.release());
+        motion.update(IKeyframe::kBoneKeyframe);
+        instance->update(IKeyframe::kBoneKeyframe);
+        ASSERT_EQ(3, instance->countKeyframes(IKeyframe::kBoneKeyframe));
+        ASSERT_EQ(IKeyframe::TimeIndex(84), instance->durationTimeIndex());
+    }
+    // instances of the instance share keyframes of the source motion
+    std::unique_ptr<vmd::Motion> instance2(instance->createInstance(&model2));
+    ASSERT_EQ(motion.findBoneKeyframeRefAt(2), instance2->findBoneKeyframeRefAt(2));
+    {
+        // shared keyframes cannot be removed while the instances exist
+        IKeyframe *keyframe = motion.findBoneKeyframeRef(42, &name, 0);
+        motion.deleteKeyframe(keyframe);
+        ASSERT_TRUE(keyframe);
+        ASSERT_EQ(3, motion.countKeyframes(IKeyframe::kBoneKeyframe));
+        motion.setAllKeyframes(Array<IKeyframe *>(), IKeyframe::kBoneKeyframe);
+        ASSERT_EQ(3, motion.countKeyframes(IKeyframe::kBoneKeyframe));
+        Array<IKeyframe *> keyframes;
+        instance->getKeyframeRefs(42, 0, IKeyframe::kBoneKeyframe, keyframes);
+        ASSERT_EQ(1, keyframes.count());
+        ASSERT_EQ(keyframe, keyframes[0]);
+    }
+    instance2.reset();
+    {
+        // can be removed again after all of the instances are deleted
+        std::unique_ptr<vmd::Motion> source(new vmd::Motion(&model, &encoding));
+        vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(42);
+        keyframe->setName(&name);
+        source->addKeyframe(keyframe);
+        source->update(IKeyframe::kBoneKeyframe);
+        std::unique_ptr<vmd::Motion> sourceInstance(source->createInstance(&model2));
+        IKeyframe *keyframeToDelete = keyframe;
+        source->deleteKeyframe(keyframeToDelete);
+        ASSERT_EQ(1, source->countKeyframes(IKeyframe::kBoneKeyframe));
+        sourceInstance.reset();
+        source->deleteKeyframe(keyframeToDelete);
+        ASSERT_EQ(0, source->countKeyframes(IKeyframe::kBoneKeyframe));
+    }
+    {
+        // tracks added to the source motion are bound on next update of the instance
+        String name2("bone2");
+        vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(0);
+        keyframe->setName(&name2);
+        keyframe->setLocalTranslation(Vector3(1, 2, 3));
+        keyframe->setDefaultInterpolationParameter();
+        motion.addKeyframe(keyframe);
+        motion.update(IKeyframe::kBoneKeyframe);
+        instance->update(IKeyframe::kBoneKeyframe);
+        ASSERT_EQ(keyframe, instance->findBoneKeyframeRef(0, &name2, 0));
+        EXPECT_CALL(bone2, setLocalTranslation(Vector3(0, 0, 0))).Times(1);
+        EXPECT_CALL(bone2, setLocalTranslation(Vector3(1, 2, 3))).Times(1);
+        EXPECT_CALL(bone2, setLocalOrientation(_)).Times(2);
+        instance->seekTimeIndex(0);
+        Mock::VerifyAndClearExpectations(&bone2);
+    }
+}
+
+TEST(VMDMotionTest, InstancesOutliveSourceMotion)
+{
+    Encoding encoding(0);
+    String name("bone");
+    MockIModel model, model2;
+    MockIBone bone, bone2;
+    std::unique_ptr<vmd::Motion> motion(new vmd::Motion(&model, &encoding));
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model2, findBoneRef(_)).WillRepeatedly(Return(&bone2));
+    EXPECT_CALL(model2, name(_)).WillRepeatedly(Return(static_cast<const IString *>(0)));
+    for (int i = 0; i < 2; i++) {
+        vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(i * 42);
+        keyframe->setName(&name);
+        keyframe->setLocalTranslation(Vector3(0, 0, i * 42));
+        keyframe->setDefaultInterpolationParameter();
+        motion->addKeyframe(keyframe);
+    }
+    motion->update(IKeyframe::kBoneKeyframe);
+    std::unique_ptr<vmd::Motion> instance(motion->createInstance(&model2));
+    // keyframes are kept alive by the instance
+    motion.reset();
+    instance->update(IKeyframe::kBoneKeyframe);
+    ASSERT_EQ(2, instance->countKeyframes(IKeyframe::kBoneKeyframe));
+    EXPECT_CALL(bone2, setLocalTranslation(Vector3(0, 0, 42))).Times(1);
+    EXPECT_CALL(bone2, setLocalOrientation(_)).Times(1);
+    instance->seekTimeIndex(42);
+    std::unique_ptr<vmd::Motion> instance2(instance->createInstance(&model2));
+    instance.reset();
+    ASSERT_EQ(2, instance2->countKeyframes(IKeyframe::kBoneKeyframe));
+}
+
+TEST(VMDMotionTest, CompressBoneKeyframes)
+{
+    Encoding encoding(0);
+    String dense("dense"), sparse("sparse"), fixed("fixed");
+    const IString *names[] = { &dense, &sparse, &fixed };
+    static const int kNumBones = 3;
+    MockIModel model;
+    NiceMock<MockIBone> bones[kNumBones];
+    Vector3 positions[kNumBones];
+    Quaternion rotations[kNumBones];
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Invoke([&](const IString *name) -> IBone * {
+        for (int i = 0; i < kNumBones; i++) {
+            if (name->equals(names[i])) {
+                return &bones[i];
+            }
+        }
+        return 0;
+    }));
+    for (int i = 0; i < kNumBones; i++) {
+        ON_CALL(bones[i], setLocalTranslation(_)).WillByDefault(SaveArg<0>(&positions[i]));
+        ON_CALL(bones[i], setLocalOrientation(_)).WillByDefault(SaveArg<0>(&rotations[i]));
+    }
+    vmd::BoneAnimation animation(&encoding);
+    const QuadWord parameters[] = { QuadWord(20, 20, 107, 107), QuadWord(64, 0, 64, 127), QuadWord(10, 90, 30, 120) };
+    for (int i = 0; i <= 300; i++) {
+        const bool isSparse = i % 30 == 0, isFixed = i % 7 == 0;
+        for (int j = 0; j < kNumBones; j++) {
+            if ((j == 1 && !isSparse) || (j == 2 && !isFixed)) {
+                continue;
+            }
+            /* rotate around a tilted axis through the negative hemisphere of w */
+            const Scalar &angle = Scalar(i) * 0.05f * (j + 1), &s = btSin(angle * 0.5f);
+            vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+            keyframe->setName(names[j]);
+            keyframe->setTimeIndex(i);
+            keyframe->setLocalTranslation(j == 2 ? kZeroV3 : Vector3(btSin(i * 0.1f) * 10, i * 0.25f, -i * 0.5f * j));
+            keyframe->setLocalOrientation(Quaternion(s * 0.48f, s * 0.6f, s * 0.64f, btCos(angle * 0.5f)));
+            keyframe->setDefaultInterpolationParameter();
+            keyframe->setInterpolationParameter(vmd::BoneKeyframe::kBonePositionX, parameters[(i + j) % 3]);
+            keyframe->setInterpolationParameter(vmd::BoneKeyframe::kBoneRotation, parameters[(i / 30) % 3]);
+            animation.addKeyframe(keyframe);
+        }
+    }
+    animation.update();
+    vmd::CompressedBoneAnimation compressed;
+    ASSERT_TRUE(compressed.compress(animation));
+    ASSERT_EQ(kNumBones, compressed.countTracks());
+    ASSERT_EQ(animation.countKeyframes(), compressed.countKeyframes());
+    ASSERT_GE(9, compressed.countInterpolationParameters());
+    ASSERT_GT(animation.countKeyframes() * vmd::BoneKeyframe::strideSize(), compressed.estimateMemorySize());
+    animation.setParentModelRef(&model);
+    compressed.setParentModelRef(&model);
+    ASSERT_EQ(animation.duration(), compressed.duration());
+    /* seek forward and backward to check the checkpoint lookup of both directions */
+    const Scalar &translationError = compressed.maxTranslationError() + 0.0001f;
+    const Scalar &orientationError = vmd::CompressedBoneAnimation::maxOrientationError() * 2 + 0.0001f;
+    for (int i = 0; i <= 620; i++) {
+        const IKeyframe::TimeIndex timeIndex(i <= 310 ? i : 620 - i);
+        Vector3 expectedPositions[kNumBones];
+        Quaternion expectedRotations[kNumBones];
+        animation.seek(timeIndex);
+        for (int j = 0; j < kNumBones; j++) {
+            expectedPositions[j] = positions[j];
+            expectedRotations[j] = rotations[j];
+        }
+        compressed.seek(timeIndex);
+        for (int j = 0; j < kNumBones; j++) {
+            for (int k = 0; k < 3; k++) {
+                ASSERT_NEAR(expectedPositions[j][k], positions[j][k], translationError) << "bone " << j << " at " << timeIndex;
+            }
+            for (int k = 0; k < 4; k++) {
+                ASSERT_NEAR(expectedRotations[j][k], rotations[j][k], orientationError) << "bone " << j << " at " << timeIndex;
+            }
+        }
+    }
+    /* tracks not found in the model are not sought */
+    compressed.setParentModelRef(0);
+    ASSERT_EQ(IKeyframe::TimeIndex(0), compressed.duration());
+    animation.setParentModelRef(0);
+}
+
+TEST(VMDMotionTest, CompactBoneKeyframes)
+{
+    Encoding encoding(0);
+    String name("bone");
+    MockIModel model;
+    NiceMock<MockIBone> bone;
+    Vector3 position;
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model, name(_)).WillRepeatedly(Return(static_cast<const IString *>(0)));
+    ON_CALL(bone, setLocalTranslation(_)).WillByDefault(SaveArg<0>(&position));
+    vmd::Motion motion(&model, &encoding);
+    IKeyframe::TimeIndex timeIndices[] = { 0, 42 };
+    for (int i = 0; i < 2; i++) {
+        vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(timeIndices[i]);
+        keyframe->setName(&name);
+        keyframe->setLocalTranslation(Vector3(0, 0, timeIndices[i]));
+        keyframe->setDefaultInterpolationParameter();
+        motion.addKeyframe(keyframe);
+    }
+    motion.update(IKeyframe::kBoneKeyframe);
+    {
+        // compaction is rejected while keyframes are shared with the instance
+        std::unique_ptr<vmd::Motion> instance(motion.createInstance(&model));
+        ASSERT_FALSE(motion.compactBoneKeyframes());
+        ASSERT_FALSE(motion.compressedBoneAnimation());
+    }
+    ASSERT_TRUE(motion.compactBoneKeyframes());
+    const vmd::CompressedBoneAnimation *animation = motion.compressedBoneAnimation();
+    ASSERT_TRUE(animation);
+    ASSERT_EQ(2, animation->countKeyframes());
+    ASSERT_EQ(&model, animation->parentModelRef());
+    // bone keyframes are deleted and replaced with the compressed one
+    ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kBoneKeyframe));
+    ASSERT_EQ(IKeyframe::TimeIndex(42), motion.durationTimeIndex());
+    motion.seekTimeIndex(21);
+    ASSERT_TRUE(CompareVector(Vector3(0, 0, 21), position));
+    ASSERT_FALSE(motion.isReachedTo(42));
+    motion.seekTimeIndex(42);
+    ASSERT_TRUE(CompareVector(Vector3(0, 0, 42), position));
+    ASSERT_TRUE(motion.isReachedTo(42));
+    {
+        // compacted bone keyframes cannot be modified nor shared
+        vmd::BoneKeyframe keyframe(&encoding);
+        keyframe.setName(&name);
+        keyframe.setTimeIndex(84);
+        motion.addKeyframe(&keyframe);
+        ASSERT_EQ(0, motion.countKeyframes(IKeyframe::kBoneKeyframe));
+        ASSERT_FALSE(motion.createInstance(&model));
+    }
+    motion.setParentModelRef(0);
+    ASSERT_FALSE(animation->parentModelRef());
+}
+
+TEST(VMDMotionTest, SaveAndCloneCompactedMotion)
+{
+    Encoding encoding(0);
+    String name("bone");
+    MockIModel model;
+    NiceMock<MockIBone> bone;
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model, name(_)).WillRepeatedly(Return(static_cast<const IString *>(0)));
+    vmd::Motion motion(&model, &encoding);
+    const QuadWord parameter(20, 40, 80, 100);
+    IKeyframe::TimeIndex timeIndices[] = { 0, 42, 300 };
+    for (int i = 0; i < 3; i++) {
+        vmd::BoneKeyframe *keyframe = new vmd::BoneKeyframe(&encoding);
+        keyframe->setTimeIndex(timeIndices[i]);
+        keyframe->setName(&name);
+        keyframe->setLocalTranslation(Vector3(1, 2, timeIndices[i]));
+        keyframe->setLocalOrientation(Quaternion(0, btSin(Scalar(timeIndices[i] / 600.0)), 0, btCos(Scalar(timeIndices[i] / 600.0))));
+        keyframe->setDefaultInterpolationParameter();
+        keyframe->setInterpolationParameter(vmd::BoneKeyframe::kBoneRotation, parameter);
+        motion.addKeyframe(keyframe);
+    }
+    motion.update(IKeyframe::kBoneKeyframe);
+    ASSERT_TRUE(motion.compactBoneKeyframes());
+    const Scalar &maxTranslationError = motion.compressedBoneAnimation()->maxTranslationError();
+    // compacted bone keyframes are saved as decompressed ones
+    std::unique_ptr<uint8[]> bytes(new uint8[motion.estimateSize()]);
+    motion.save(bytes.get());
+    vmd::Motion loadedMotion(0, &encoding);
+    ASSERT_TRUE(loadedMotion.load(bytes.get(), motion.estimateSize()));
+    // the clone has editable bone keyframes
+    std::unique_ptr<IMotion> clonedMotion(motion.clone());
+    ASSERT_FALSE(static_cast<vmd::Motion *>(clonedMotion.get())->compressedBoneAnimation());
+    IMotion *motions[] = { &loadedMotion, clonedMotion.get() };
+    for (int i = 0; i < 2; i++) {
+        IMotion *m = motions[i];
+        ASSERT_EQ(3, m->countKeyframes(IKeyframe::kBoneKeyframe));
+        for (int j = 0; j < 3; j++) {
+            const IBoneKeyframe *keyframe = m->findBoneKeyframeRef(timeIndices[j], &name, 0);
+            ASSERT_TRUE(keyframe);
+            const Vector3 &translation = keyframe->localTranslation();
+            ASSERT_NEAR(timeIndices[j], translation.z(), maxTranslationError + 0.0001);
+            ASSERT_NEAR(1, translation.x(), 0.0001);
+            const Quaternion expected(0, btSin(Scalar(timeIndices[j] / 600.0)), 0, btCos(Scalar(timeIndices[j] / 600.0)));
+            ASSERT_NEAR(1, btFabs(expected.dot(keyframe->localOrientation())), vmd::CompressedBoneAnimation::maxOrientationError());
+            QuadWord value;
+            keyframe->getInterpolationParameter(vmd::BoneKeyframe::kBoneRotation, value);
+            ASSERT_TRUE(CompareVector(parameter, value));
+        }
+    }
+}
+
+TEST(VMDMotionTest, ReduceKeyframes)
+{
+    Encoding encoding(0);
+    String name("bone");
+    MockIModel model;
+    NiceMock<MockIBone> bone;
+    NiceMock<MockIMorph> morph;
+    Vector3 position;
+    Quaternion rotation;
+    IMorph::WeightPrecision weight = 0;
+    EXPECT_CALL(model, findBoneRef(_)).WillRepeatedly(Return(&bone));
+    EXPECT_CALL(model, findMorphRef(_)).WillRepeatedly(Return(&morph));
+    ON_CALL(bone, setLocalTranslation(_)).WillByDefault(SaveArg<0>(&position));
+    ON_CALL(bone, setLocalOrientation(_)).WillByDefault(SaveArg<0>(&rotation));
+    ON_CALL(morph, setWeight(_)).WillByDefault(SaveArg<0>(&weight));
+    /* sample a sparse motion on every frame as motion capture does */
+    static const int kDuration = 240;
+    vmd::Motion sparse(&model, &encoding), dense(&model, &encoding);
+    const QuadWord parameters[] = { QuadWord(64, 0, 64, 127), QuadWord(16, 80, 96, 112), QuadWord(20, 20, 107, 107) };
+    for (int i = 0; i <= kDuration; i += 60) {
+        const Scalar &angle = Scalar(i) * 0.01f, &s = btSin(angle);
+        vmd::BoneKeyframe *boneKeyframe = new vmd::BoneKeyframe(&encoding);
+        boneKeyframe->setName(&name);
+        boneKeyframe->setTimeIndex(i);
+        boneKeyframe->setLocalTranslation(Vector3(i * 0.1f, (i % 120) * 0.05f, 0));
+        boneKeyframe->setLocalOrientation(Quaternion(s * 0.6f, 0, s * 0.8f, btCos(angle)));
+        boneKeyframe->setDefaultInterpolationParameter();
+        boneKeyframe->setInterpolationParameter(vmd::BoneKeyframe::kBonePositionX, parameters[(i / 60) % 3]);
+        boneKeyframe->setInterpolationParameter(vmd::BoneKeyframe::kBoneRotation, parameters[(i / 60 + 1) % 3]);
+        sparse.addKeyframe(boneKeyframe);
+        vmd::MorphKeyframe *morphKeyframe = new vmd::MorphKeyframe(&encoding);
+        morphKeyframe->setName(&name);
+        morphKeyframe->setTimeIndex(i);
+        morphKeyframe->setWeight(i % 120 == 0 ? 0 : 1);
+        sparse.addKeyframe(morphKeyframe);
+    }
+    sparse.update(IKeyframe::kBoneKeyframe);
+    sparse.update(IKeyframe::kMorphKeyframe);
+    Vector3 positions[kDuration + 1];
+    Quaternion rotations[kDuration + 1];
+    IMorph::WeightPrecision weights[kDuration + 1];
+    for (int i = 0; i <= kDuration; i++) {
+        sparse.seekTimeIndex(i);
+        positions[i] = position;
+        rotations[i] = rotation;
+        weights[i] = weight;
+        vmd::BoneKeyframe *boneKeyframe = new vmd::BoneKeyframe(&encoding);
+        boneKeyframe->setName(&name);
+        boneKeyframe->setTimeIndex(i);
+        boneKeyframe->setLocalTranslation(position);
+        boneKeyframe->setLocalOrientation(rotation);
+        boneKeyframe->setDefaultInterpolationParameter();
+        dense.addKeyframe(boneKeyframe);
+        vmd::MorphKeyframe *morphKeyframe = new vmd::MorphKeyframe(&encoding);
+        morphKeyframe->setName(&name);
+        morphKeyframe->setTimeIndex(i);
+        morphKeyframe->setWeight(weight);
+        dense.addKeyframe(morphKeyframe);
+    }
+    dense.update(IKeyframe::kBoneKeyframe);
+    dense.update(IKeyframe::kMorphKeyframe);
+    vmd::KeyframeReducer reducer;
+    reducer.setTranslationTolerance(0.005f);
+    reducer.setOrientationTolerance(btRadians(0.1f));
+    reducer.setMorphWeightTolerance(0.001f);
+    ASSERT_TRUE(reducer.reduce(&dense));
+    ASSERT_EQ((kDuration + 1) * 2, reducer.countSourceKeyframes());
+    ASSERT_EQ(dense.countKeyframes(IKeyframe::kBoneKeyframe) + dense.countKeyframes(IKeyframe::kMorphKeyframe), reducer.countReducedKeyframes());
+    ASSERT_GE(reducer.countSourceKeyframes() / 5, reducer.countReducedKeyframes());
+    /* morph keyframes are linear, so only the sampled ones are left */
+    ASSERT_EQ(5, dense.countKeyframes(IKeyframe::kMorphKeyframe));
+    ASSERT_EQ(IKeyframe::TimeIndex(kDuration), dense.durationTimeIndex());
+    for (int i = 0; i <= kDuration; i++) {
+        dense.seekTimeIndex(i);
+        for (int j = 0; j < 3; j++) {
+            ASSERT_NEAR(positions[i][j], position[j], reducer.translationTolerance() + 0.0001f) << "at " << i;
+        }
+        ASSERT_GE(reducer.orientationTolerance() + 0.001f, 2 * btAcos(btMin(btFabs(rotations[i].dot(rotation)), Scalar(1)))) << "at " << i;
+        ASSERT_NEAR(weights[i], weight, reducer.morphWeightTolerance() + 0.0001f) << "at " << i;
+    }
+}
+
+TEST(VMDMotionTest, ReduceLongLinearTrack)
+{
+    Encoding encoding(0);
+    String name("bone");
+    vmd::Motion motion(0, &encoding);
+    static const int kDuration = 2000;
+    for (int i = 0; i <= kDuration; i++) {
+        vmd::BoneKeyframe *boneKeyframe = new vmd::BoneKeyframe(&encoding);
+        boneKeyframe->setName(&name);
+        boneKeyframe->setTimeIndex(i);
+        boneKeyframe->setLocalTranslation(Vector3(i * 0.1f, 0, 0));
+        boneKeyframe->setDefaultInterpolationParameter();
+        motion.addKeyframe(boneKeyframe);
+        vmd::MorphKeyframe *morphKeyframe = new vmd::MorphKeyframe(&encoding);
+        morphKeyframe->setName(&name);
+        morphKeyframe->setTimeIndex(i);
+        morphKeyframe->setWeight(i / Scalar(kDuration));
+        motion.addKeyframe(morphKeyframe);
+    }
+    motion.update(IKeyframe::kBoneKeyframe);
+    motion.update(IKeyframe::kMorphKeyframe);
+    vmd::KeyframeReducer reducer;
+    ASSERT_TRUE(reducer.reduce(&motion));
+    /* segments of a linear track are split at the maximum length of 256 keyframes */
+    ASSERT_EQ(9, motion.countKeyframes(IKeyframe::kBoneKeyframe));
+    ASSERT_EQ(9, motion.countKeyframes(IKeyframe::kMorphKeyframe));
+}
+
 TEST(VMDMotionTest, AddAndRemoveNullKeyframe)
 {
     /* should happen nothing */
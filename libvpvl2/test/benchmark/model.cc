@@ -0,0 +1,233 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/extensions/icu4c/Encoding.h>
+#include <vpvl2/extensions/icu4c/String.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+using namespace vpvl2;
+using namespace vpvl2::extensions::icu4c;
+
+namespace {
+
+static const int kNumInstances = 16;
+static const int kNumBones = 64;
+static const int kGridSize = 192;
+
+static vsize CurrentHeapBytes()
+{
+    /* counts blocks allocated by both operator new and btAlignedAlloc */
+#if defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return vsize(info.uordblks) + vsize(info.hblkhd);
+#elif defined(__APPLE__)
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(0, &statistics);
+    return statistics.size_in_use;
+#else
+    return 0;
+#endif
+}
+
+static double ElapsedMilliseconds(std::clock_t start)
+{
+    return double(std::clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static bool ReadFile(const char *path, std::vector<uint8> &bytes)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (stream.is_open()) {
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+    return false;
+}
+
+static void CreateGridModel(const Factory &factory, std::vector<uint8> &bytes)
+{
+    /* a skinned grid of kGridSize^2 vertices bound to a chain of kNumBones bones */
+    IModel *model = factory.newModel(IModel::kPMXModel);
+    String name(UnicodeString::fromUTF8("grid"));
+    model->setName(&name, IEncoding::kDefaultLanguage);
+    model->setName(&name, IEncoding::kEnglish);
+    Array<IBone *> bones;
+    char boneName[32];
+    for (int i = 0; i < kNumBones; i++) {
+        snprintf(boneName, sizeof(boneName), "bone%d", i);
+        String s(UnicodeString::fromUTF8(boneName));
+        IBone *bone = model->createBone();
+        bone->setName(&s, IEncoding::kDefaultLanguage);
+        bone->setName(&s, IEncoding::kEnglish);
+        bone->setOrigin(Vector3(0, Scalar(i), 0));
+        bone->setParentBoneRef(i > 0 ? bones[i - 1] : 0);
+        model->addBone(bone);
+        bones.append(bone);
+    }
+    for (int y = 0; y < kGridSize; y++) {
+        for (int x = 0; x < kGridSize; x++) {
+            const Scalar v = Scalar(y) / kGridSize;
+            const int boneIndex = int(v * (kNumBones - 1));
+            IVertex *vertex = model->createVertex();
+            vertex->setOrigin(Vector3(Scalar(x) / kGridSize, v * kNumBones, 0));
+            vertex->setNormal(kUnitZ);
+            vertex->setTextureCoord(Vector3(Scalar(x) / kGridSize, v, 0));
+            vertex->setType(IVertex::kBdef2);
+            vertex->setBoneRef(0, bones[boneIndex]);
+            vertex->setBoneRef(1, bones[btMin(boneIndex + 1, kNumBones - 1)]);
+            vertex->setWeight(0, 0.5);
+            model->addVertex(vertex);
+        }
+    }
+    Array<int> indices;
+    for (int y = 0; y < kGridSize - 1; y++) {
+        for (int x = 0; x < kGridSize - 1; x++) {
+            const int i = y * kGridSize + x;
+            indices.append(i);
+            indices.append(i + 1);
+            indices.append(i + kGridSize);
+            indices.append(i + 1);
+            indices.append(i + kGridSize + 1);
+            indices.append(i + kGridSize);
+        }
+    }
+    model->setIndices(indices);
+    IMaterial *material = model->createMaterial();
+    material->setName(&name, IEncoding::kDefaultLanguage);
+    material->setName(&name, IEncoding::kEnglish);
+    IMaterial::IndexRange range;
+    range.count = indices.count();
+    material->setIndexRange(range);
+    model->addMaterial(material);
+    bytes.resize(model->estimateSize());
+    vsize written = 0;
+    model->save(&bytes[0], written);
+    bytes.resize(written);
+    delete model;
+}
+
+static void ReleaseModels(std::vector<IModel *> &models)
+{
+    for (std::vector<IModel *>::const_iterator it = models.begin(); it != models.end(); ++it) {
+        delete *it;
+    }
+    models.clear();
+}
+
+static bool MeasureLoads(const Factory &factory, const std::vector<uint8> &bytes, vsize &used, double &elapsed)
+{
+    std::vector<IModel *> models;
+    const vsize base = CurrentHeapBytes();
+    const std::clock_t start = std::clock();
+    bool ok = true;
+    for (int i = 0; i < kNumInstances && ok; i++) {
+        models.push_back(factory.createModel(&bytes[0], bytes.size(), ok));
+    }
+    elapsed = ElapsedMilliseconds(start);
+    used = CurrentHeapBytes() - base;
+    ReleaseModels(models);
+    return ok;
+}
+
+static bool MeasureInstances(const Factory &factory, const std::vector<uint8> &bytes, vsize &used, double &elapsed)
+{
+    std::vector<IModel *> models;
+    const vsize base = CurrentHeapBytes();
+    const std::clock_t start = std::clock();
+    bool ok = true;
+    IModel *source = factory.createModel(&bytes[0], bytes.size(), ok);
+    models.push_back(source);
+    for (int i = 1; i < kNumInstances && ok; i++) {
+        models.push_back(factory.createModelInstance(source, ok));
+    }
+    elapsed = ElapsedMilliseconds(start);
+    used = CurrentHeapBytes() - base;
+    ReleaseModels(models);
+    return ok;
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint8> bytes;
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    Factory factory(&encoding);
+    if (argc >= 2) {
+        if (!ReadFile(argv[1], bytes)) {
+            std::fprintf(stderr, "usage: %s [model.pmx]\n", argv[0]);
+            return 1;
+        }
+    }
+    else {
+        CreateGridModel(factory, bytes);
+    }
+    vsize loadBytes = 0, instanceBytes = 0;
+    double loadElapsed = 0, instanceElapsed = 0;
+    if (!MeasureLoads(factory, bytes, loadBytes, loadElapsed) ||
+            !MeasureInstances(factory, bytes, instanceBytes, instanceElapsed)) {
+        std::fprintf(stderr, "cannot load the model: %s\n", argc >= 2 ? argv[1] : "(grid)");
+        return 1;
+    }
+    std::printf("model: %lu bytes, %d copies\n", static_cast<unsigned long>(bytes.size()), kNumInstances);
+    std::printf("%10s %16s %16s %12s\n", "mode", "heap total", "heap each", "cpu ms");
+    std::printf("%10s %16lu %16lu %12.1f\n", "load",
+                static_cast<unsigned long>(loadBytes),
+                static_cast<unsigned long>(loadBytes / kNumInstances),
+                loadElapsed);
+    std::printf("%10s %16lu %16lu %12.1f\n", "instance",
+                static_cast<unsigned long>(instanceBytes),
+                static_cast<unsigned long>(instanceBytes / kNumInstances),
+                instanceElapsed);
+    std::printf("saving: memory %.1fx, load time %.1fx\n",
+                instanceBytes > 0 ? double(loadBytes) / double(instanceBytes) : 0.0,
+                instanceElapsed > 0 ? loadElapsed / instanceElapsed : 0.0);
+    return 0;
+}
@@ -0,0 +1,236 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/extensions/icu4c/Encoding.h>
+#include <vpvl2/extensions/icu4c/String.h>
+#include <vpvl2/vmd/Motion.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+using namespace vpvl2;
+using namespace vpvl2::extensions::icu4c;
+
+namespace {
+
+static const int kNumBones = 64;
+static const int kNumKeyframesPerBone = 120;
+static const int kKeyframeInterval = 5;
+static const int kNumInstances[] = { 8, 32 };
+
+static vsize CurrentHeapBytes()
+{
+    /* counts blocks allocated by both operator new and btAlignedAlloc */
+#if defined(__GLIBC__)
+    struct mallinfo info = mallinfo();
+    return vsize(info.uordblks) + vsize(info.hblkhd);
+#elif defined(__APPLE__)
+    malloc_statistics_t statistics;
+    malloc_zone_statistics(0, &statistics);
+    return statistics.size_in_use;
+#else
+    return 0;
+#endif
+}
+
+static bool ReadFile(const char *path, std::vector<uint8> &bytes)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (stream.is_open()) {
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+    return false;
+}
+
+static IModel *CreateModel(const Factory &factory, const std::vector<uint8> &bytes)
+{
+    if (!bytes.empty()) {
+        bool ok = false;
+        IModel *model = factory.createModel(&bytes[0], bytes.size(), ok);
+        if (!ok) {
+            delete model;
+            model = 0;
+        }
+        return model;
+    }
+    IModel *model = factory.newModel(IModel::kPMXModel);
+    char name[32];
+    for (int i = 0; i < kNumBones; i++) {
+        snprintf(name, sizeof(name), "bone%d", i);
+        String s(UnicodeString::fromUTF8(name));
+        IBone *bone = model->createBone();
+        bone->setName(&s, IEncoding::kDefaultLanguage);
+        model->addBone(bone);
+    }
+    return model;
+}
+
+static vmd::Motion *CreateMotion(const Factory &factory, IModel *model, IEncoding *encoding, const std::vector<uint8> &bytes)
+{
+    vmd::Motion *motion = new vmd::Motion(model, encoding);
+    if (!bytes.empty()) {
+        if (!motion->load(&bytes[0], bytes.size())) {
+            delete motion;
+            motion = 0;
+        }
+        return motion;
+    }
+    char name[32];
+    for (int i = 0; i < kNumBones; i++) {
+        snprintf(name, sizeof(name), "bone%d", i);
+        String s(UnicodeString::fromUTF8(name));
+        for (int j = 1; j <= kNumKeyframesPerBone; j++) {
+            IBoneKeyframe *keyframe = factory.createBoneKeyframe(motion);
+            keyframe->setName(&s);
+            keyframe->setTimeIndex(j * kKeyframeInterval);
+            keyframe->setLocalTranslation(Vector3(i, j, i + j));
+            keyframe->setLocalOrientation(Quaternion(kUnitY, btRadians(j)));
+            keyframe->setDefaultInterpolationParameter();
+            motion->addKeyframe(keyframe);
+        }
+    }
+    motion->update(IKeyframe::kBoneKeyframe);
+    motion->createFirstKeyframesUnlessFound();
+    return motion;
+}
+
+static void SeekAll(const std::vector<IMotion *> &motions, const IKeyframe::TimeIndex &duration)
+{
+    for (IKeyframe::TimeIndex timeIndex = 0; timeIndex <= duration; timeIndex += kKeyframeInterval) {
+        for (std::vector<IMotion *>::const_iterator it = motions.begin(); it != motions.end(); ++it) {
+            (*it)->seekTimeIndex(timeIndex);
+        }
+    }
+}
+
+static vsize MeasureClones(const vmd::Motion *source, const std::vector<IModel *> &models, int ninstances)
+{
+    std::vector<IMotion *> motions;
+    const vsize base = CurrentHeapBytes();
+    for (int i = 0; i < ninstances; i++) {
+        IMotion *motion = source->clone();
+        motion->setParentModelRef(models[i]);
+        motions.push_back(motion);
+    }
+    SeekAll(motions, source->durationTimeIndex());
+    const vsize used = CurrentHeapBytes() - base;
+    for (std::vector<IMotion *>::const_iterator it = motions.begin(); it != motions.end(); ++it) {
+        delete *it;
+    }
+    return used;
+}
+
+static vsize MeasureInstances(const vmd::Motion *source, const std::vector<IModel *> &models, int ninstances)
+{
+    std::vector<IMotion *> motions;
+    const vsize base = CurrentHeapBytes();
+    for (int i = 0; i < ninstances; i++) {
+        motions.push_back(source->createInstance(models[i]));
+    }
+    SeekAll(motions, source->durationTimeIndex());
+    const vsize used = CurrentHeapBytes() - base;
+    for (std::vector<IMotion *>::const_iterator it = motions.begin(); it != motions.end(); ++it) {
+        delete *it;
+    }
+    return used;
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint8> modelBytes, motionBytes;
+    if (argc >= 3 && !(ReadFile(argv[1], modelBytes) && ReadFile(argv[2], motionBytes))) {
+        std::fprintf(stderr, "usage: %s [model.pmx motion.vmd]\n", argv[0]);
+        return 1;
+    }
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    Factory factory(&encoding);
+    const int maxInstances = kNumInstances[sizeof(kNumInstances) / sizeof(kNumInstances[0]) - 1];
+    std::vector<IModel *> models;
+    for (int i = 0; i < maxInstances + 1; i++) {
+        if (IModel *model = CreateModel(factory, modelBytes)) {
+            models.push_back(model);
+        }
+        else {
+            std::fprintf(stderr, "cannot load the model: %s\n", argv[1]);
+            return 1;
+        }
+    }
+    const vsize base = CurrentHeapBytes();
+    std::auto_ptr<vmd::Motion> source(CreateMotion(factory, models.back(), &encoding, motionBytes));
+    if (!source.get()) {
+        std::fprintf(stderr, "cannot load the motion: %s\n", argv[2]);
+        return 1;
+    }
+    const vsize sourceBytes = CurrentHeapBytes() - base;
+    std::printf("source motion: %d bone keyframes, %d morph keyframes, %lu bytes\n",
+                source->countKeyframes(IKeyframe::kBoneKeyframe),
+                source->countKeyframes(IKeyframe::kMorphKeyframe),
+                static_cast<unsigned long>(sourceBytes));
+    std::printf("%10s %16s %16s %16s %16s %8s\n", "instances", "clone total", "clone each", "shared total", "shared each", "ratio");
+    for (vsize i = 0; i < sizeof(kNumInstances) / sizeof(kNumInstances[0]); i++) {
+        const int ninstances = kNumInstances[i];
+        const vsize clones = MeasureClones(source.get(), models, ninstances);
+        const vsize instances = MeasureInstances(source.get(), models, ninstances);
+        std::printf("%10d %16lu %16lu %16lu %16lu %7.1fx\n",
+                    ninstances,
+                    static_cast<unsigned long>(clones),
+                    static_cast<unsigned long>(clones / ninstances),
+                    static_cast<unsigned long>(instances),
+                    static_cast<unsigned long>(instances / ninstances),
+                    instances > 0 ? double(clones) / double(instances) : 0.0);
+    }
+    source.reset();
+    for (std::vector<IModel *>::const_iterator it = models.begin(); it != models.end(); ++it) {
+        delete *it;
+    }
+    return 0;
+}
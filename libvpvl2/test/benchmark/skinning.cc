@@ -0,0 +1,506 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * Times each stage of CPU skinning separately over many frames and writes the results as JSON:
+ *
+ *   seek       Scene#seekTimeIndex (motion evaluation)
+ *   update     IModel#performUpdate (bone/morph/IK solving)
+ *   transform  IModel::DynamicVertexBuffer#performTransform (skinning)
+ *   aabb       IModel::DynamicVertexBuffer#computeAabb
+ *
+ * Each model runs in serial mode, OpenMP mode (when built with VPVL2_ENABLE_OPENMP) and
+ * TBB mode (when built with VPVL2_LINK_INTEL_TBB).
+ */
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/extensions/icu4c/Encoding.h>
+#include <vpvl2/extensions/icu4c/String.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(VPVL2_OS_WINDOWS)
+#include <windows.h>
+#elif defined(VPVL2_OS_OSX) || defined(VPVL2_OS_IOS)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vpvl2;
+using namespace vpvl2::extensions::icu4c;
+
+namespace {
+
+static const int kDefaultNumFrames = 600;
+static const int kDefaultGridSize = 128;
+static const int kNumGridBones = 64;
+static const int kKeyframeInterval = 5;
+static const int kNumKeyframesPerBone = 24;
+
+enum Mode {
+    kSerialMode,
+    kOpenMPMode,
+    kIntelTBBMode,
+    kMaxMode
+};
+
+enum Stage {
+    kSeekStage,
+    kUpdateStage,
+    kTransformStage,
+    kAabbStage,
+    kBoneAabbStage,
+    kMaxStage
+};
+
+static const char *const kModeNames[kMaxMode] = { "serial", "openmp", "tbb" };
+static const char *const kStageNames[kMaxStage] = { "seek", "update", "transform", "aabb", "bone_aabb" };
+
+struct StageResult {
+    StageResult()
+        : total(0),
+          min(SIMD_INFINITY),
+          max(0),
+          count(0)
+    {
+    }
+    void add(float64 seconds) {
+        total += seconds;
+        btSetMin(min, seconds);
+        btSetMax(max, seconds);
+        count++;
+    }
+    float64 total;
+    float64 min;
+    float64 max;
+    int count;
+};
+
+struct ModelEntry {
+    ModelEntry()
+        : model(0),
+          motion(0)
+    {
+        for (int i = 0; i < kMaxMode; i++) {
+            available[i] = false;
+        }
+    }
+    std::string label;
+    std::string modelPath;
+    std::string motionPath;
+    IModel *model;
+    IMotion *motion;
+    StageResult results[kMaxMode][kMaxStage];
+    bool available[kMaxMode];
+};
+
+static float64 CurrentSeconds()
+{
+    /* wall clock, std::clock would sum CPU time of all worker threads in parallel modes */
+#if defined(VPVL2_OS_WINDOWS)
+    LARGE_INTEGER counter, frequency;
+    ::QueryPerformanceCounter(&counter);
+    ::QueryPerformanceFrequency(&frequency);
+    return float64(counter.QuadPart) / float64(frequency.QuadPart);
+#elif defined(VPVL2_OS_OSX) || defined(VPVL2_OS_IOS)
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return float64(mach_absolute_time()) * info.numer / info.denom * 1e-9;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return float64(ts.tv_sec) + float64(ts.tv_nsec) * 1e-9;
+#endif
+}
+
+static bool ReadFile(const std::string &path, std::vector<uint8> &bytes)
+{
+    std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+    if (stream.is_open()) {
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+    return false;
+}
+
+static IModel *CreateGridModel(const Factory &factory, int gridSize)
+{
+    /* a skinned grid of gridSize^2 vertices bound to a chain of kNumGridBones bones */
+    IModel *model = factory.newModel(IModel::kPMXModel);
+    String name(UnicodeString::fromUTF8("grid"));
+    model->setName(&name, IEncoding::kDefaultLanguage);
+    Array<IBone *> bones;
+    char boneName[32];
+    for (int i = 0; i < kNumGridBones; i++) {
+        snprintf(boneName, sizeof(boneName), "bone%d", i);
+        String s(UnicodeString::fromUTF8(boneName));
+        IBone *bone = model->createBone();
+        bone->setName(&s, IEncoding::kDefaultLanguage);
+        bone->setOrigin(Vector3(0, Scalar(i), 0));
+        bone->setParentBoneRef(i > 0 ? bones[i - 1] : 0);
+        bone->setRotateable(true);
+        bone->setMovable(true);
+        model->addBone(bone);
+        bones.append(bone);
+    }
+    IMaterial *material = model->createMaterial();
+    material->setName(&name, IEncoding::kDefaultLanguage);
+    model->addMaterial(material);
+    for (int y = 0; y < gridSize; y++) {
+        for (int x = 0; x < gridSize; x++) {
+            const Scalar v = Scalar(y) / gridSize;
+            const int boneIndex = int(v * (kNumGridBones - 1));
+            IVertex *vertex = model->createVertex();
+            vertex->setOrigin(Vector3(Scalar(x) / gridSize, v * kNumGridBones, 0));
+            vertex->setNormal(kUnitZ);
+            vertex->setTextureCoord(Vector3(Scalar(x) / gridSize, v, 0));
+            vertex->setType(IVertex::kBdef2);
+            vertex->setBoneRef(0, bones[boneIndex]);
+            vertex->setBoneRef(1, bones[btMin(boneIndex + 1, kNumGridBones - 1)]);
+            vertex->setWeight(0, 0.5);
+            vertex->setMaterialRef(material);
+            model->addVertex(vertex);
+        }
+    }
+    Array<int> indices;
+    for (int y = 0; y < gridSize - 1; y++) {
+        for (int x = 0; x < gridSize - 1; x++) {
+            const int i = y * gridSize + x;
+            indices.append(i);
+            indices.append(i + 1);
+            indices.append(i + gridSize);
+            indices.append(i + 1);
+            indices.append(i + gridSize + 1);
+            indices.append(i + gridSize);
+        }
+    }
+    model->setIndices(indices);
+    IMaterial::IndexRange range;
+    range.count = indices.count();
+    material->setIndexRange(range);
+    return model;
+}
+
+static IMotion *CreateSyntheticMotion(const Factory &factory, IModel *model)
+{
+    /* rotates and translates every bone of the model so skinning touches all vertices */
+    IMotion *motion = factory.newMotion(IMotion::kVMDFormat, model);
+    Array<IBone *> bones;
+    model->getBoneRefs(bones);
+    for (int i = 0, nbones = bones.count(); i < nbones; i++) {
+        const IBone *bone = bones[i];
+        for (int j = 0; j <= kNumKeyframesPerBone; j++) {
+            IBoneKeyframe *keyframe = factory.createBoneKeyframe(motion);
+            keyframe->setName(bone->name(IEncoding::kDefaultLanguage));
+            keyframe->setTimeIndex(j * kKeyframeInterval);
+            keyframe->setLocalTranslation(Vector3(0, Scalar(j % 2) * 0.1f, 0));
+            keyframe->setLocalOrientation(Quaternion(kUnitZ, btRadians(Scalar((j % 4) * 5))));
+            keyframe->setDefaultInterpolationParameter();
+            motion->addKeyframe(keyframe);
+        }
+    }
+    motion->update(IKeyframe::kBoneKeyframe);
+    return motion;
+}
+
+static bool LoadEntry(const Factory &factory, ModelEntry &entry, int gridSize)
+{
+    std::vector<uint8> bytes;
+    bool ok = true;
+    if (entry.modelPath.empty()) {
+        char label[64];
+        snprintf(label, sizeof(label), "grid%dx%d", gridSize, gridSize);
+        entry.label = label;
+        entry.model = CreateGridModel(factory, gridSize);
+    }
+    else if (ReadFile(entry.modelPath, bytes)) {
+        entry.label = entry.modelPath;
+        entry.model = factory.createModel(&bytes[0], bytes.size(), ok);
+    }
+    if (!entry.model || !ok) {
+        std::fprintf(stderr, "cannot load the model: %s\n", entry.modelPath.c_str());
+        return false;
+    }
+    if (!entry.motionPath.empty()) {
+        if (!ReadFile(entry.motionPath, bytes)) {
+            std::fprintf(stderr, "cannot read the motion: %s\n", entry.motionPath.c_str());
+            return false;
+        }
+        entry.motion = factory.createMotion(&bytes[0], bytes.size(), entry.model, ok);
+        if (!ok) {
+            std::fprintf(stderr, "cannot load the motion: %s\n", entry.motionPath.c_str());
+            return false;
+        }
+    }
+    else {
+        entry.motion = CreateSyntheticMotion(factory, entry.model);
+    }
+    return true;
+}
+
+static bool EnableMode(Mode mode, IModel::DynamicVertexBuffer *dynamicBuffer)
+{
+    bool available = false;
+    switch (mode) {
+    case kSerialMode:
+#ifdef _OPENMP
+        omp_set_num_threads(1);
+#endif
+        available = true;
+        break;
+    case kOpenMPMode:
+#ifdef _OPENMP
+        omp_set_num_threads(omp_get_num_procs());
+        available = true;
+#endif
+        break;
+    case kIntelTBBMode:
+#ifdef VPVL2_LINK_INTEL_TBB
+        available = true;
+#endif
+        break;
+    default:
+        break;
+    }
+    if (dynamicBuffer) {
+        dynamicBuffer->setParallelUpdateEnable(mode == kIntelTBBMode);
+    }
+    return available;
+}
+
+static void RunMode(Mode mode, Scene &scene, ModelEntry &entry, int nframes)
+{
+    IModel *model = entry.model;
+    IModel::IndexBuffer *indexBuffer = 0;
+    IModel::DynamicVertexBuffer *dynamicBuffer = 0;
+    model->getIndexBuffer(indexBuffer);
+    model->getDynamicVertexBuffer(dynamicBuffer, indexBuffer);
+    entry.available[mode] = EnableMode(mode, dynamicBuffer);
+    if (!entry.available[mode]) {
+        delete dynamicBuffer;
+        delete indexBuffer;
+        return;
+    }
+    void *address = 0;
+    if (dynamicBuffer && dynamicBuffer->size() > 0) {
+        address = btAlignedAlloc(dynamicBuffer->size(), 16);
+        dynamicBuffer->setupBindPose(address);
+    }
+    Array<Vector3> aabb;
+    Vector3 aabbMin, aabbMax;
+    const Vector3 cameraPosition(0, 10, -50);
+    const IKeyframe::TimeIndex duration = btMax(entry.motion->durationTimeIndex(), IKeyframe::TimeIndex(1));
+    StageResult *results = entry.results[mode];
+    scene.seekTimeIndex(0, Scene::kUpdateModels);
+    model->resetMotionState(0);
+    for (int i = 0; i < nframes; i++) {
+        const IKeyframe::TimeIndex timeIndex = IKeyframe::TimeIndex(i % int(duration + 1));
+        float64 start = CurrentSeconds();
+        scene.seekTimeIndex(timeIndex, Scene::kUpdateModels);
+        results[kSeekStage].add(CurrentSeconds() - start);
+        start = CurrentSeconds();
+        model->performUpdate();
+        results[kUpdateStage].add(CurrentSeconds() - start);
+        if (address) {
+            start = CurrentSeconds();
+            dynamicBuffer->performTransform(address, cameraPosition);
+            results[kTransformStage].add(CurrentSeconds() - start);
+            start = CurrentSeconds();
+            aabb.clear();
+            dynamicBuffer->computeAabb(address, aabb);
+            results[kAabbStage].add(CurrentSeconds() - start);
+        }
+        start = CurrentSeconds();
+        model->computeConservativeAabb(aabbMin, aabbMax, 0, 0);
+        results[kBoneAabbStage].add(CurrentSeconds() - start);
+    }
+    btAlignedFree(address);
+    delete dynamicBuffer;
+    delete indexBuffer;
+}
+
+static std::string EscapeJson(const std::string &value)
+{
+    std::string escaped;
+    for (std::string::const_iterator it = value.begin(); it != value.end(); ++it) {
+        const char c = *it;
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static void WriteJson(FILE *fp, const std::vector<ModelEntry> &entries, int nframes)
+{
+    std::fprintf(fp, "{\n  \"version\": \"%s\",\n  \"revision\": \"%s\",\n  \"frames\": %d,\n  \"models\": [",
+                 libraryVersionString(), libraryCommitRevisionString(), nframes);
+    for (vsize i = 0; i < entries.size(); i++) {
+        const ModelEntry &entry = entries[i];
+        const IModel *model = entry.model;
+        std::fprintf(fp, "%s\n    {\n      \"name\": \"%s\",\n      \"type\": %d,\n      \"vertices\": %d,\n      \"bones\": %d,\n      \"morphs\": %d,\n      \"modes\": {",
+                     i > 0 ? "," : "", EscapeJson(entry.label).c_str(), int(model->type()),
+                     model->count(IModel::kVertex), model->count(IModel::kBone), model->count(IModel::kMorph));
+        bool firstMode = true;
+        for (int mode = 0; mode < kMaxMode; mode++) {
+            if (!entry.available[mode]) {
+                continue;
+            }
+            std::fprintf(fp, "%s\n        \"%s\": {", firstMode ? "" : ",", kModeNames[mode]);
+            firstMode = false;
+            bool firstStage = true;
+            for (int stage = 0; stage < kMaxStage; stage++) {
+                const StageResult &result = entry.results[mode][stage];
+                if (result.count == 0) {
+                    continue;
+                }
+                std::fprintf(fp, "%s\n          \"%s\": { \"total_ms\": %.3f, \"mean_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f }",
+                             firstStage ? "" : ",", kStageNames[stage], result.total * 1e3,
+                             result.total * 1e6 / result.count, result.min * 1e6, result.max * 1e6);
+                firstStage = false;
+            }
+            std::fprintf(fp, "\n        }");
+        }
+        std::fprintf(fp, "\n      }\n    }");
+    }
+    std::fprintf(fp, "\n  ]\n}\n");
+}
+
+static void PrintUsage(const char *argv0)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--frames N] [--grid N] [--output results.json] [model [--motion motion]]...\n"
+                 "  models may be PMD, PMX or asset files (including ones written by the model generator),\n"
+                 "  a synthetic grid model is used when no model is given\n",
+                 argv0);
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char *argv[])
+{
+    std::vector<ModelEntry> entries;
+    std::string outputPath;
+    int nframes = kDefaultNumFrames, gridSize = kDefaultGridSize;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            nframes = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--grid") == 0 && hasValue) {
+            gridSize = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--motion") == 0 && hasValue && !entries.empty()) {
+            entries.back().motionPath = argv[++i];
+        }
+        else if (argv[i][0] != '-') {
+            entries.push_back(ModelEntry());
+            entries.back().modelPath = argv[i];
+        }
+        else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (nframes <= 0 || gridSize <= 1) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (entries.empty()) {
+        entries.push_back(ModelEntry());
+    }
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    Factory factory(&encoding);
+    int result = 0;
+    for (vsize i = 0; i < entries.size() && result == 0; i++) {
+        ModelEntry &entry = entries[i];
+        if (!LoadEntry(factory, entry, gridSize)) {
+            result = 1;
+            break;
+        }
+        /* only motions are registered, Scene#addModel requires a render engine */
+        Scene scene(false);
+        scene.addMotion(entry.motion);
+        for (int mode = 0; mode < kMaxMode; mode++) {
+            RunMode(Mode(mode), scene, entry, nframes);
+            std::fprintf(stderr, "%s: %s %s\n", entry.label.c_str(), kModeNames[mode], entry.available[mode] ? "done" : "skipped");
+        }
+        scene.removeMotion(entry.motion);
+    }
+    if (result == 0) {
+        FILE *fp = outputPath.empty() ? stdout : std::fopen(outputPath.c_str(), "w");
+        if (fp) {
+            WriteJson(fp, entries, nframes);
+            if (fp != stdout) {
+                std::fclose(fp);
+            }
+        }
+        else {
+            std::fprintf(stderr, "cannot open the output: %s\n", outputPath.c_str());
+            result = 1;
+        }
+    }
+    for (std::vector<ModelEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        delete it->motion;
+        delete it->model;
+    }
+    return result;
+}
@@ -0,0 +1,166 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+/*
+ * Measures decoding textures with TextureDecoder in serial and parallel modes without
+ * any OpenGL context. Decodes given image files or synthetic TGA images if no file is given.
+ */
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/extensions/TextureDecoder.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#if defined(VPVL2_OS_WINDOWS)
+#include <windows.h>
+#elif defined(VPVL2_OS_OSX) || defined(VPVL2_OS_IOS)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+using namespace vpvl2;
+using namespace vpvl2::extensions;
+
+namespace {
+
+static const int kDefaultNumImages = 64;
+static const int kDefaultImageSize = 512;
+static const int kNumIterations = 4;
+
+static float64 CurrentSeconds()
+{
+    /* wall clock, std::clock would sum CPU time of all worker threads in parallel mode */
+#if defined(VPVL2_OS_WINDOWS)
+    LARGE_INTEGER counter, frequency;
+    ::QueryPerformanceCounter(&counter);
+    ::QueryPerformanceFrequency(&frequency);
+    return float64(counter.QuadPart) / float64(frequency.QuadPart);
+#elif defined(VPVL2_OS_OSX) || defined(VPVL2_OS_IOS)
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return float64(mach_absolute_time()) * info.numer / info.denom * 1e-9;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return float64(ts.tv_sec) + float64(ts.tv_nsec) * 1e-9;
+#endif
+}
+
+static bool ReadFile(const char *path, std::string &bytes)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (stream.is_open()) {
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+    return false;
+}
+
+static std::string CreateTGA(int size, int seed)
+{
+    /* uncompressed 32bit true color image stored from top to bottom */
+    std::string bytes(18, 0);
+    bytes[2] = 2;
+    bytes[12] = char(size & 0xff);
+    bytes[13] = char(size >> 8);
+    bytes[14] = char(size & 0xff);
+    bytes[15] = char(size >> 8);
+    bytes[16] = 32;
+    bytes[17] = 0x28;
+    bytes.reserve(bytes.size() + vsize(size) * size * 4);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            bytes.push_back(char(x ^ seed));
+            bytes.push_back(char(y ^ seed));
+            bytes.push_back(char(x + y));
+            bytes.push_back(char(0xff));
+        }
+    }
+    return bytes;
+}
+
+static float64 Measure(const std::vector<std::string> &sources, int flags, bool enableParallel)
+{
+    float64 total = 0;
+    for (int i = 0; i < kNumIterations; i++) {
+        TextureDecoder decoder;
+        char key[32];
+        for (vsize j = 0; j < sources.size(); j++) {
+            const std::string &bytes = sources[j];
+            snprintf(key, sizeof(key), "image%d", int(j));
+            decoder.addJob(key, reinterpret_cast<const uint8 *>(bytes.data()), bytes.size(), flags);
+        }
+        const float64 start = CurrentSeconds();
+        decoder.decode(enableParallel);
+        total += CurrentSeconds() - start;
+    }
+    return total / kNumIterations;
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; i++) {
+        std::string bytes;
+        if (!ReadFile(argv[i], bytes)) {
+            std::fprintf(stderr, "usage: %s [image...]\n", argv[0]);
+            return 1;
+        }
+        sources.push_back(bytes);
+    }
+    if (sources.empty()) {
+        for (int i = 0; i < kDefaultNumImages; i++) {
+            sources.push_back(CreateTGA(kDefaultImageSize, i));
+        }
+    }
+    static const int kFlags[] = { TextureDecoder::kNone, TextureDecoder::kFlipVertically | TextureDecoder::kGenerateMipmaps };
+    static const char *const kFlagNames[] = { "decode", "decode+flip+mipmap" };
+    for (int i = 0; i < 2; i++) {
+        const float64 serial = Measure(sources, kFlags[i], false);
+        const float64 parallel = Measure(sources, kFlags[i], true);
+        std::fprintf(stdout, "%s: images=%d serial=%.3fms parallel=%.3fms speedup=%.2fx\n",
+                     kFlagNames[i], int(sources.size()), serial * 1e3, parallel * 1e3, parallel > 0 ? serial / parallel : 0);
+    }
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <vpvl2/vpvl2.h>
 #include <vpvl2/extensions/BaseApplicationContext.h> /* BaseApplicationContext::initializeOnce */
 #include <vpvl2/extensions/icu4c/Encoding.h>
+#include <vpvl2/pmx/Bone.h> /* pmx::Bone#addIKJoint */
 
 #include <stdio.h>
 #include <set>
@@ -1161,14 +1162,528 @@ void CreateCameraMotion(IMotion *motion, double seconds, const std::string &outp
     }
 }
 
+/*
+ * Synthetic scenes for scaling tests. Everything is derived from SyntheticOptions::seed,
+ * so the same options always produce byte identical files on every platform.
+ */
+struct SyntheticOptions {
+    SyntheticOptions()
+        : output("synthetic"),
+          seed(1),
+          nvertices(100000),
+          nmaterials(16),
+          nbones(256),
+          nIKChains(4),
+          IKChainLength(3),
+          nmorphs(64),
+          morphSparsity(0.05f),
+          nrigidBodies(64),
+          duration(3600),
+          boneKeyframeInterval(5),
+          morphKeyframeInterval(10),
+          keyedBoneRatio(1.0f),
+          writeVMD(true),
+          writeMVD(true)
+    {
+    }
+    std::string output;
+    uint32 seed;
+    int nvertices;
+    int nmaterials;
+    int nbones;
+    int nIKChains;
+    int IKChainLength;
+    int nmorphs;
+    float32 morphSparsity;
+    int nrigidBodies;
+    int duration;
+    int boneKeyframeInterval;
+    int morphKeyframeInterval;
+    float32 keyedBoneRatio;
+    bool writeVMD;
+    bool writeMVD;
+};
+
+class SyntheticRandom {
+public:
+    enum Stream {
+        kBoneStream = 1,
+        kVertexStream,
+        kMaterialStream,
+        kMorphStream,
+        kRigidBodyStream,
+        kMotionStream
+    };
+    /* each object type has its own stream so changing one count does not reshuffle others */
+    SyntheticRandom(uint32 seed, Stream stream)
+        : m_state((seed ^ (uint32(stream) * 0x9e3779b9u)) | 1)
+    {
+        for (int i = 0; i < 8; i++) {
+            next();
+        }
+    }
+
+    uint32 next() {
+        /* xorshift32, rand() differs between C runtimes */
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+    Scalar uniform() {
+        return Scalar(next() >> 8) / Scalar(1 << 24);
+    }
+    Scalar uniform(const Scalar &min, const Scalar &max) {
+        return min + (max - min) * uniform();
+    }
+    int range(int n) {
+        return n > 0 ? int(next() % uint32(n)) : 0;
+    }
+    Vector3 vector3(const Scalar &min, const Scalar &max) {
+        const Scalar &x = uniform(min, max), &y = uniform(min, max), &z = uniform(min, max);
+        return Vector3(x, y, z);
+    }
+
+private:
+    uint32 m_state;
+};
+
+template<typename T>
+static void SetSyntheticName(const char *name, T *object)
+{
+    String s(UnicodeString::fromUTF8(name));
+    object->setName(&s, IEncoding::kJapanese);
+    object->setName(&s, IEncoding::kEnglish);
+}
+
+static IBone *CreateSyntheticBone(IModel *model, int index, IBone *parentBoneRef, const Vector3 &origin)
+{
+    IBone *bone = model->createBone();
+    char name[32];
+    snprintf(name, sizeof(name), "bone%05d", index);
+    SetSyntheticName(name, bone);
+    bone->setOrigin(origin);
+    bone->setParentBoneRef(parentBoneRef);
+    bone->setRotateable(true);
+    bone->setMovable(true);
+    bone->setVisible(true);
+    bone->setInteractive(true);
+    model->addBone(bone);
+    return bone;
+}
+
+static void CreateSyntheticBones(IModel *model, const SyntheticOptions &options, Array<IBone *> &skinningBones)
+{
+    SyntheticRandom random(options.seed, SyntheticRandom::kBoneStream);
+    int index = 0;
+    IBone *root = CreateSyntheticBone(model, index++, 0, kZeroV3);
+    skinningBones.append(root);
+    for (int i = 1; i < options.nbones; i++) {
+        /* prefers recent bones as parent so the hierarchy has long chains like limbs and hair */
+        const int nbones = skinningBones.count();
+        const int window = btMin(nbones, 8);
+        IBone *parent = skinningBones[random.uniform() < 0.75f ? nbones - 1 - random.range(window) : random.range(nbones)];
+        const Vector3 &origin = parent->origin() + random.vector3(-0.5f, 0.5f) + Vector3(0, 0.5f, 0);
+        skinningBones.append(CreateSyntheticBone(model, index++, parent, origin));
+    }
+    for (int i = 0; i < options.nIKChains && options.IKChainLength > 0; i++) {
+        /* chain of links + tip bone, solved by an IK bone placed at the tip */
+        IBone *parent = skinningBones[random.range(skinningBones.count())];
+        Array<IBone *> links;
+        for (int j = 0; j <= options.IKChainLength; j++) {
+            const Vector3 &origin = parent->origin() + Vector3(0, -1, 0) + random.vector3(-0.2f, 0.2f);
+            parent = CreateSyntheticBone(model, index++, parent, origin);
+            links.append(parent);
+        }
+        IBone *tip = links[links.count() - 1];
+        pmx::Bone *IKBone = static_cast<pmx::Bone *>(CreateSyntheticBone(model, index++, root, tip->origin()));
+        IKBone->setHasInverseKinematics(true);
+        IKBone->setEffectorBoneRef(tip);
+        IKBone->setNumIterations(40);
+        IKBone->setAngleLimit(btRadians(114.5916f) / 4);
+        for (int j = links.count() - 2; j >= 0; j--) {
+            IBone::IKJoint *joint = IKBone->addIKJoint(links[j]);
+            if (j == links.count() - 2) {
+                /* knee like link */
+                joint->setHasAngleLimit(true);
+                joint->setLowerLimit(Vector3(-btRadians(180), 0, 0));
+                joint->setUpperLimit(Vector3(-btRadians(0.5f), 0, 0));
+            }
+        }
+        for (int j = 0; j < links.count() - 1; j++) {
+            skinningBones.append(links[j]);
+        }
+    }
+}
+
+static void CreateSyntheticMesh(IModel *model, const SyntheticOptions &options, const Array<IBone *> &bones)
+{
+    SyntheticRandom vertexRandom(options.seed, SyntheticRandom::kVertexStream);
+    const int nvertices = btMax(options.nvertices, 3), nbones = bones.count();
+    const int width = btMax(int(btSqrt(Scalar(nvertices))), 2);
+    const int height = (nvertices + width - 1) / width;
+    for (int i = 0; i < nvertices; i++) {
+        const int x = i % width, y = i / width;
+        const int boneIndex = int(Scalar(y) / height * nbones) % nbones;
+        IBone *bone = bones[boneIndex], *parent = bone->parentBoneRef();
+        IVertex *vertex = model->createVertex();
+        vertex->setOrigin(bone->origin() + vertexRandom.vector3(-0.25f, 0.25f));
+        vertex->setNormal(vertexRandom.vector3(-1, 1).safeNormalize());
+        vertex->setTextureCoord(Vector3(Scalar(x) / width, Scalar(y) / height, 0));
+        vertex->setEdgeSize(1);
+        const Scalar &selector = vertexRandom.uniform();
+        if (selector < 0.2f || !parent) {
+            vertex->setType(IVertex::kBdef1);
+            vertex->setBoneRef(0, bone);
+        }
+        else if (selector < 0.9f) {
+            vertex->setType(IVertex::kBdef2);
+            vertex->setBoneRef(0, bone);
+            vertex->setBoneRef(1, parent);
+            vertex->setWeight(0, vertexRandom.uniform(0.2f, 1.0f));
+        }
+        else {
+            Scalar weights[4], sum = 0;
+            vertex->setType(IVertex::kBdef4);
+            for (int j = 0; j < 4; j++) {
+                weights[j] = vertexRandom.uniform(0.1f, 1.0f);
+                sum += weights[j];
+            }
+            for (int j = 0; j < 4; j++) {
+                vertex->setBoneRef(j, j == 0 ? bone : bones[vertexRandom.range(nbones)]);
+                vertex->setWeight(j, weights[j] / sum);
+            }
+        }
+        model->addVertex(vertex);
+    }
+    Array<int> indices;
+    for (int y = 0; y < height - 1; y++) {
+        for (int x = 0; x < width - 1; x++) {
+            const int i = y * width + x;
+            if (i + width + 1 < nvertices) {
+                indices.append(i);
+                indices.append(i + 1);
+                indices.append(i + width);
+                indices.append(i + 1);
+                indices.append(i + width + 1);
+                indices.append(i + width);
+            }
+        }
+    }
+    model->setIndices(indices);
+    SyntheticRandom materialRandom(options.seed, SyntheticRandom::kMaterialStream);
+    const int ntriangles = indices.count() / 3, nmaterials = btMax(btMin(options.nmaterials, ntriangles), 1);
+    for (int i = 0, offset = 0; i < nmaterials; i++) {
+        const int end = (i == nmaterials - 1) ? ntriangles : ntriangles * (i + 1) / nmaterials;
+        IMaterial *material = model->createMaterial();
+        char name[32];
+        snprintf(name, sizeof(name), "material%04d", i);
+        SetSyntheticName(name, material);
+        material->setAmbient(Color(materialRandom.uniform(), materialRandom.uniform(), materialRandom.uniform(), 1));
+        material->setDiffuse(Color(materialRandom.uniform(), materialRandom.uniform(), materialRandom.uniform(), 1));
+        material->setSpecular(Color(materialRandom.uniform(), materialRandom.uniform(), materialRandom.uniform(), 1));
+        material->setShininess(materialRandom.uniform(1, 50));
+        material->setEdgeColor(Color(0, 0, 0, 1));
+        material->setEdgeSize(1);
+        material->setFlags(IMaterial::kCastingShadow | IMaterial::kCastingShadowMap | IMaterial::kEnableShadowMap | IMaterial::kEnableEdge);
+        IMaterial::IndexRange range;
+        range.start = offset * 3;
+        range.end = end * 3;
+        range.count = range.end - range.start;
+        material->setIndexRange(range);
+        model->addMaterial(material);
+        offset = end;
+    }
+}
+
+static void CreateSyntheticMorphs(IModel *model, const SyntheticOptions &options)
+{
+    SyntheticRandom random(options.seed, SyntheticRandom::kMorphStream);
+    Array<IVertex *> vertices;
+    model->getVertexRefs(vertices);
+    const int nvertices = vertices.count();
+    /* morphSparsity is the ratio of vertices moved by each vertex morph */
+    const int nmorphVertices = btMax(int(nvertices * btMin(btMax(options.morphSparsity, 0.0f), 1.0f)), 1);
+    for (int i = 0; i < options.nmorphs; i++) {
+        IMorph *morph = model->createMorph();
+        char name[32];
+        snprintf(name, sizeof(name), "morph%04d", i);
+        SetSyntheticName(name, morph);
+        morph->setType(IMorph::kVertexMorph);
+        morph->setCategory(static_cast<IMorph::Category>(IMorph::kEyeblow + i % (IMorph::kMaxCategoryType - IMorph::kEyeblow)));
+        /* a contiguous region like a face part, starting from a random vertex */
+        const int start = random.range(nvertices);
+        for (int j = 0; j < nmorphVertices; j++) {
+            IMorph::Vertex *vmorph = new IMorph::Vertex();
+            vmorph->vertex = vertices[(start + j) % nvertices];
+            vmorph->index = uint32(vmorph->vertex->index());
+            vmorph->position = random.vector3(-0.1f, 0.1f);
+            morph->addVertexMorph(vmorph);
+        }
+        model->addMorph(morph);
+    }
+}
+
+static void CreateSyntheticRigidBodies(IModel *model, const SyntheticOptions &options, const Array<IBone *> &bones)
+{
+    SyntheticRandom random(options.seed, SyntheticRandom::kRigidBodyStream);
+    Array<IRigidBody *> bodies;
+    for (int i = 0; i < options.nrigidBodies; i++) {
+        /* the first body is kinematic and the rest are chained to the previous one by springs */
+        IBone *bone = bones[i == 0 ? 0 : random.range(bones.count())];
+        IRigidBody *body = model->createRigidBody();
+        char name[32];
+        snprintf(name, sizeof(name), "body%04d", i);
+        SetSyntheticName(name, body);
+        body->setBoneRef(bone);
+        body->setShapeType(static_cast<IRigidBody::ShapeType>(i % IRigidBody::kMaxShapeType));
+        body->setObjectType(i == 0 ? IRigidBody::kStaticObject : (i % 4 == 0 ? IRigidBody::kAlignedObject : IRigidBody::kDynamicObject));
+        body->setPosition(bone->origin());
+        body->setRotation(random.vector3(0, btRadians(30)));
+        body->setSize(random.vector3(0.1f, 0.5f));
+        body->setMass(random.uniform(0.5f, 2.0f));
+        body->setLinearDamping(0.5f);
+        body->setAngularDamping(0.5f);
+        body->setRestitution(0);
+        body->setFriction(0.5f);
+        body->setCollisionGroupID(uint8(i % 16));
+        body->setCollisionMask(uint16(0xffff & ~(1 << (i % 16))));
+        model->addRigidBody(body);
+        if (i > 0) {
+            IJoint *joint = model->createJoint();
+            snprintf(name, sizeof(name), "joint%04d", i - 1);
+            SetSyntheticName(name, joint);
+            joint->setType(IJoint::kGeneric6DofSpringConstraint);
+            joint->setRigidBody1Ref(bodies[i - 1]);
+            joint->setRigidBody2Ref(body);
+            joint->setPosition(bone->origin());
+            joint->setRotationLowerLimit(Vector3(-btRadians(30), -btRadians(30), -btRadians(30)));
+            joint->setRotationUpperLimit(Vector3(btRadians(30), btRadians(30), btRadians(30)));
+            joint->setRotationStiffness(Vector3(10, 10, 10));
+            model->addJoint(joint);
+        }
+        bodies.append(body);
+    }
+}
+
+static bool SaveModel(const IModel *model, const std::string &path)
+{
+    std::vector<uint8> buffer(model->estimateSize());
+    vsize written = 0;
+    model->save(buffer.data(), written);
+    if (FILE *fp = fopen(path.c_str(), "wb")) {
+        fwrite(buffer.data(), written, 1, fp);
+        fclose(fp);
+        return true;
+    }
+    return false;
 }
 
-int main(int /* argc */, char *argv[])
+static bool SaveMotion(const IMotion *motion, const std::string &path)
+{
+    std::vector<uint8> buffer(motion->estimateSize());
+    motion->save(buffer.data());
+    if (FILE *fp = fopen(path.c_str(), "wb")) {
+        fwrite(buffer.data(), buffer.size(), 1, fp);
+        fclose(fp);
+        return true;
+    }
+    return false;
+}
+
+void CreateSyntheticModel(IModel *model, const SyntheticOptions &options)
+{
+    Array<IBone *> skinningBones;
+    CreateSyntheticBones(model, options, skinningBones);
+    CreateSyntheticMesh(model, options, skinningBones);
+    CreateSyntheticMorphs(model, options);
+    CreateSyntheticRigidBodies(model, options, skinningBones);
+    {
+        ILabel *label = model->createLabel();
+        SetSyntheticName("bones0", label);
+        Array<IBone *> bones;
+        model->getBoneRefs(bones);
+        for (int i = 0, nbones = bones.count(); i < nbones; i++) {
+            label->addBoneRef(bones[i]);
+        }
+        model->addLabel(label);
+    }
+    {
+        ILabel *label = model->createLabel();
+        SetSyntheticName("morphs0", label);
+        Array<IMorph *> morphs;
+        model->getMorphRefs(morphs);
+        for (int i = 0, nmorphs = morphs.count(); i < nmorphs; i++) {
+            label->addMorphRef(morphs[i]);
+        }
+        model->addLabel(label);
+    }
+    char comment[256];
+    snprintf(comment, sizeof(comment), "synthetic model: seed=%u vertices=%d bones=%d morphs=%d bodies=%d",
+             options.seed, options.nvertices, options.nbones, options.nmorphs, options.nrigidBodies);
+    String c(UnicodeString::fromUTF8(comment));
+    char name[32];
+    snprintf(name, sizeof(name), "synthetic%u", options.seed);
+    SetSyntheticName(name, model);
+    model->setComment(&c, IEncoding::kJapanese);
+    model->setComment(&c, IEncoding::kEnglish);
+    model->setVersion(2.0);
+}
+
+void CreateSyntheticMotion(const Factory &factory, IMotion *motion, const IModel *model, const SyntheticOptions &options)
+{
+    /* same stream for VMD and MVD so both formats carry the same keyframes */
+    SyntheticRandom random(options.seed, SyntheticRandom::kMotionStream);
+    Array<IBone *> bones;
+    model->getBoneRefs(bones);
+    const int boneInterval = btMax(options.boneKeyframeInterval, 1);
+    for (int i = 0, nbones = bones.count(); i < nbones; i++) {
+        const IBone *bone = bones[i];
+        if (i > 0 && random.uniform() >= options.keyedBoneRatio) {
+            continue;
+        }
+        const bool movable = i == 0 || bone->hasInverseKinematics();
+        for (int timeIndex = 0; timeIndex <= options.duration; timeIndex += boneInterval) {
+            IBoneKeyframe *keyframe = factory.createBoneKeyframe(motion);
+            keyframe->setDefaultInterpolationParameter();
+            keyframe->setName(bone->name(IEncoding::kJapanese));
+            keyframe->setTimeIndex(timeIndex);
+            keyframe->setLocalTranslation(movable ? random.vector3(-1, 1) : kZeroV3);
+            keyframe->setLocalOrientation(Quaternion(random.uniform(-0.5f, 0.5f), random.uniform(-0.5f, 0.5f), random.uniform(-0.5f, 0.5f)));
+            motion->addKeyframe(keyframe);
+        }
+    }
+    Array<IMorph *> morphs;
+    model->getMorphRefs(morphs);
+    const int morphInterval = btMax(options.morphKeyframeInterval, 1);
+    for (int i = 0, nmorphs = morphs.count(); i < nmorphs; i++) {
+        const IMorph *morph = morphs[i];
+        for (int timeIndex = 0; timeIndex <= options.duration; timeIndex += morphInterval) {
+            IMorphKeyframe *keyframe = factory.createMorphKeyframe(motion);
+            keyframe->setName(morph->name(IEncoding::kJapanese));
+            keyframe->setTimeIndex(timeIndex);
+            keyframe->setWeight(random.uniform() < 0.5f ? 0 : random.uniform());
+            motion->addKeyframe(keyframe);
+        }
+    }
+    motion->update(IKeyframe::kBoneKeyframe);
+    motion->update(IKeyframe::kMorphKeyframe);
+}
+
+static bool ParseSyntheticOptions(int argc, char *argv[], SyntheticOptions &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const char *value = argv[++i];
+        if (arg == "--output") {
+            options.output = value;
+        }
+        else if (arg == "--seed") {
+            options.seed = uint32(strtoul(value, 0, 10));
+        }
+        else if (arg == "--vertices") {
+            options.nvertices = atoi(value);
+        }
+        else if (arg == "--materials") {
+            options.nmaterials = atoi(value);
+        }
+        else if (arg == "--bones") {
+            options.nbones = btMax(atoi(value), 1);
+        }
+        else if (arg == "--ik-chains") {
+            options.nIKChains = atoi(value);
+        }
+        else if (arg == "--ik-chain-length") {
+            options.IKChainLength = atoi(value);
+        }
+        else if (arg == "--morphs") {
+            options.nmorphs = atoi(value);
+        }
+        else if (arg == "--morph-sparsity") {
+            options.morphSparsity = float32(atof(value));
+        }
+        else if (arg == "--rigid-bodies") {
+            options.nrigidBodies = atoi(value);
+        }
+        else if (arg == "--duration") {
+            options.duration = atoi(value);
+        }
+        else if (arg == "--bone-keyframe-interval") {
+            options.boneKeyframeInterval = atoi(value);
+        }
+        else if (arg == "--morph-keyframe-interval") {
+            options.morphKeyframeInterval = atoi(value);
+        }
+        else if (arg == "--keyed-bones") {
+            options.keyedBoneRatio = float32(atof(value));
+        }
+        else if (arg == "--motion-format") {
+            const std::string format(value);
+            options.writeVMD = format == "vmd" || format == "both";
+            options.writeMVD = format == "mvd" || format == "both";
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int GenerateSyntheticScene(const Factory &factory, const SyntheticOptions &options)
+{
+    std::auto_ptr<IModel> model(factory.newModel(IModel::kPMXModel));
+    CreateSyntheticModel(model.get(), options);
+    if (!SaveModel(model.get(), options.output + ".pmx")) {
+        fprintf(stderr, "cannot write %s.pmx\n", options.output.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%s.pmx: vertices=%d bones=%d morphs=%d bodies=%d joints=%d\n", options.output.c_str(),
+            model->count(IModel::kVertex), model->count(IModel::kBone), model->count(IModel::kMorph),
+            model->count(IModel::kRigidBody), model->count(IModel::kJoint));
+    const IMotion::FormatType formats[] = { IMotion::kVMDFormat, IMotion::kMVDFormat };
+    const bool enabled[] = { options.writeVMD, options.writeMVD };
+    const char *extensions[] = { ".vmd", ".mvd" };
+    for (int i = 0; i < 2; i++) {
+        if (!enabled[i]) {
+            continue;
+        }
+        std::auto_ptr<IMotion> motion(factory.newMotion(formats[i], model.get()));
+        CreateSyntheticMotion(factory, motion.get(), model.get(), options);
+        const std::string &path = options.output + extensions[i];
+        if (!SaveMotion(motion.get(), path)) {
+            fprintf(stderr, "cannot write %s\n", path.c_str());
+            return 1;
+        }
+        fprintf(stderr, "%s: bone keyframes=%d morph keyframes=%d\n", path.c_str(),
+                motion->countKeyframes(IKeyframe::kBoneKeyframe), motion->countKeyframes(IKeyframe::kMorphKeyframe));
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char *argv[])
 {
     BaseApplicationContext::initializeOnce(argv[0], 0, 2);
     Encoding::Dictionary dictionary;
     Encoding encoding(&dictionary);
     Factory factory(&encoding);
+    if (argc > 1) {
+        SyntheticOptions options;
+        if (!ParseSyntheticOptions(argc, argv, options)) {
+            fprintf(stderr,
+                    "usage: %s [--output prefix] [--seed N] [--vertices N] [--materials N] [--bones N]\n"
+                    "          [--ik-chains N] [--ik-chain-length N] [--morphs N] [--morph-sparsity ratio]\n"
+                    "          [--rigid-bodies N] [--duration frames] [--bone-keyframe-interval N]\n"
+                    "          [--morph-keyframe-interval N] [--keyed-bones ratio] [--motion-format vmd|mvd|both]\n",
+                    argv[0]);
+            return 1;
+        }
+        return GenerateSyntheticScene(factory, options);
+    }
     {
         std::auto_ptr<IModel> pmd(factory.newModel(IModel::kPMDModel));
         CreateModel(pmd.get(), "output.pmd");
@@ -45,6 +45,14 @@ class MockIApplicationContext : public IApplicationContext {
       bool(const char *name, SharedTextureParameter &parameter));
   MOCK_CONST_METHOD0(sharedFunctionResolverInstance,
       FunctionResolver*());
+  MOCK_CONST_METHOD0(sharedProgramBinaryCacheInstance,
+      IApplicationContext::ProgramBinaryCache*());
+  MOCK_METHOD1(findSharedModelBuffersRef,
+      SharedModelBuffers*(const void *key));
+  MOCK_METHOD2(addSharedModelBuffers,
+      SharedModelBuffers*(const void *key, const SharedModelBuffers &value));
+  MOCK_METHOD1(removeSharedModelBuffers,
+      void(const void *key));
 };
 
 }  // namespace VPVL2_VERSION_NS
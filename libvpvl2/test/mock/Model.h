@@ -115,6 +115,8 @@ class MockIModel : public IModel {
       void(const Vector3 &min, const Vector3 &max));
   MOCK_CONST_METHOD2(getAabb,
       void(Vector3 &min, Vector3 &max));
+  MOCK_CONST_METHOD4(computeConservativeAabb,
+      bool(Vector3 &min, Vector3 &max, Array<Vector3> *materialAabbs, Array<Scalar> *materialEdgeSizes));
   MOCK_CONST_METHOD0(version,
       float32());
   MOCK_METHOD1(setVersion,
@@ -1,5 +1,95 @@
 #include "Common.h"
 
+#include <vector>
+
+namespace {
+
+static void CreateSkinnedModel(Model &model)
+{
+    /* a chain of three bones skinned by all of deformation types available in PMX 2.0 */
+    static const IVertex::Type kTypes[] = { IVertex::kBdef1, IVertex::kBdef2, IVertex::kBdef4, IVertex::kSdef };
+    static const int kNumBones = 3, kNumVertices = 30, kNumMaterials = 2;
+    IBone *bones[kNumBones];
+    char buffer[32];
+    for (int i = 0; i < kNumBones; i++) {
+        IBone *bone = bones[i] = model.createBone();
+        snprintf(buffer, sizeof(buffer), "bone%d", i);
+        String name(buffer);
+        bone->setName(&name, IEncoding::kJapanese);
+        bone->setOrigin(Vector3(0, Scalar(i), 0));
+        bone->setParentBoneRef(i > 0 ? bones[i - 1] : 0);
+        bone->setRotateable(true);
+        bone->setMovable(true);
+        bone->setVisible(true);
+        model.addBone(bone);
+    }
+    for (int i = 0; i < kNumVertices; i++) {
+        IVertex *vertex = model.createVertex();
+        const IVertex::Type type = kTypes[i % 4];
+        IBone *bone = bones[i % kNumBones], *parent = bones[(i + 1) % kNumBones];
+        vertex->setOrigin(bone->origin() + Vector3(Scalar(i % 3) - 1, Scalar(i % 2) * 0.5f, Scalar(i % 5) * 0.25f));
+        vertex->setNormal(Vector3(0, 0, 1));
+        vertex->setTextureCoord(Vector3(Scalar(i) / kNumVertices, 0, 0));
+        vertex->setEdgeSize(1);
+        vertex->setType(type);
+        vertex->setBoneRef(0, bone);
+        switch (type) {
+        case IVertex::kBdef2:
+        case IVertex::kSdef:
+            vertex->setBoneRef(1, parent);
+            vertex->setWeight(0, 0.75f);
+            break;
+        case IVertex::kBdef4:
+            for (int j = 1; j < 4; j++) {
+                vertex->setBoneRef(j, bones[(i + j) % kNumBones]);
+            }
+            for (int j = 0; j < 4; j++) {
+                vertex->setWeight(j, 0.25f);
+            }
+            break;
+        default:
+            break;
+        }
+        if (type == IVertex::kSdef) {
+            vertex->setSdefC((bone->origin() + parent->origin()) * 0.5f);
+            vertex->setSdefR0(bone->origin());
+            vertex->setSdefR1(parent->origin());
+        }
+        model.addVertex(vertex);
+    }
+    Array<int> indices;
+    for (int i = 0; i < kNumVertices; i++) {
+        indices.append(i);
+    }
+    model.setIndices(indices);
+    for (int i = 0, nindicesPerMaterial = kNumVertices / kNumMaterials; i < kNumMaterials; i++) {
+        IMaterial *material = model.createMaterial();
+        snprintf(buffer, sizeof(buffer), "material%d", i);
+        String name(buffer);
+        material->setName(&name, IEncoding::kJapanese);
+        material->setDiffuse(Color(1, 1, 1, 1));
+        material->setEdgeColor(Color(0, 0, 0, 1));
+        material->setEdgeSize(1);
+        material->setFlags(IMaterial::kEnableEdge);
+        IMaterial::IndexRange range;
+        range.start = i * nindicesPerMaterial;
+        range.end = range.start + nindicesPerMaterial;
+        range.count = nindicesPerMaterial;
+        material->setIndexRange(range);
+        model.addMaterial(material);
+    }
+}
+
+static void SaveModel(const Model &model, std::vector<uint8> &bytes)
+{
+    vsize written = 0;
+    bytes.resize(model.estimateSize());
+    model.save(bytes.data(), written);
+    bytes.resize(written);
+}
+
+}
+
 TEST(PMXModelTest, UnknownLanguageTest)
 {
     Encoding encoding(0);
@@ -91,6 +181,147 @@ TEST(PMXModelTest, ParseRealPMX)
     }
 }
 
+TEST(PMXModelTest, CreateInstance)
+{
+    Encoding::Dictionary dict;
+    Encoding encoding(&dict);
+    std::vector<uint8> bytes;
+    {
+        Model model(&encoding);
+        CreateSkinnedModel(model);
+        SaveModel(model, bytes);
+    }
+    Factory factory(&encoding);
+    bool ok = false;
+    std::unique_ptr<IModel> source(factory.createModel(bytes.data(), bytes.size(), ok));
+    ASSERT_TRUE(ok);
+    std::unique_ptr<IModel> instance(factory.createModelInstance(source.get(), ok));
+    ASSERT_TRUE(ok);
+    ASSERT_EQ(IModel::kPMXModel, instance->type());
+    const pmx::Model *sourceModel = static_cast<const pmx::Model *>(source.get());
+    const pmx::Model *instanceModel = static_cast<const pmx::Model *>(instance.get());
+    ASSERT_TRUE(sourceModel->sharedDataRef());
+    ASSERT_EQ(sourceModel->sharedDataRef(), instanceModel->sharedDataRef());
+    ASSERT_EQ(&sourceModel->indices(), &instanceModel->indices());
+    ASSERT_EQ(30, instance->count(IModel::kVertex));
+    ASSERT_EQ(source->count(IModel::kVertex), instance->count(IModel::kVertex));
+    ASSERT_EQ(source->count(IModel::kBone), instance->count(IModel::kBone));
+    ASSERT_EQ(source->count(IModel::kMorph), instance->count(IModel::kMorph));
+    ASSERT_EQ(source->count(IModel::kMaterial), instance->count(IModel::kMaterial));
+    /* pose and morph weights belong to each instance */
+    Array<IBone *> sourceBones, instanceBones;
+    source->getBoneRefs(sourceBones);
+    instance->getBoneRefs(instanceBones);
+    ASSERT_NE(sourceBones[0], instanceBones[0]);
+    instanceBones[0]->setLocalTranslation(Vector3(1, 2, 3));
+    ASSERT_EQ(kZeroV3, sourceBones[0]->localTranslation());
+    /* vertex attributes are copied on write */
+    Array<IVertex *> sourceVertices, vertices;
+    source->getVertexRefs(sourceVertices);
+    instance->getVertexRefs(vertices);
+    const Vector3 origin = sourceVertices[0]->origin();
+    vertices[0]->setOrigin(origin + Vector3(1, 1, 1));
+    ASSERT_EQ(origin, sourceVertices[0]->origin());
+    /* the instance keeps working after the source is deleted */
+    const int nvertices = instance->count(IModel::kVertex);
+    source.reset();
+    vertices.clear();
+    instance->getVertexRefs(vertices);
+    ASSERT_EQ(nvertices, vertices.count());
+    ASSERT_EQ(instance.get(), vertices[nvertices - 1]->parentModelRef());
+    ASSERT_EQ(IVertex::kSdef, vertices[3]->type());
+}
+
+TEST(PMXModelTest, ConservativeAabbContainsSkinnedVertices)
+{
+    Encoding encoding(0);
+    Model source(&encoding);
+    CreateSkinnedModel(source);
+    std::vector<uint8> bytes;
+    SaveModel(source, bytes);
+    Model model(&encoding);
+    ASSERT_TRUE(model.load(bytes.data(), bytes.size()));
+    Array<IBone *> bones;
+    model.getBoneRefs(bones);
+    const int nbones = bones.count();
+    for (int i = 0; i < nbones; i++) {
+        bones[i]->setLocalOrientation(Quaternion(Vector3(1, 0, 1).normalized(), 0.1f * (i % 5)));
+    }
+    model.performUpdate();
+    IModel::IndexBuffer *indexBuffer = 0;
+    IModel::DynamicVertexBuffer *dynamicBuffer = 0;
+    model.getIndexBuffer(indexBuffer);
+    model.getDynamicVertexBuffer(dynamicBuffer, indexBuffer);
+    std::unique_ptr<IModel::IndexBuffer> indexBufferPtr(indexBuffer);
+    std::unique_ptr<IModel::DynamicVertexBuffer> dynamicBufferPtr(dynamicBuffer);
+    void *address = btAlignedAlloc(dynamicBuffer->size(), 16);
+    dynamicBuffer->setupBindPose(address);
+    dynamicBuffer->performTransform(address, kZeroV3);
+    Array<Vector3> exact;
+    dynamicBuffer->computeAabb(address, exact);
+    btAlignedFree(address);
+    const int nmaterials = model.count(IModel::kMaterial);
+    ASSERT_EQ((nmaterials + 1) * 2, exact.count());
+    Vector3 min, max;
+    Array<Vector3> materials;
+    Array<Scalar> edgeSizes;
+    ASSERT_TRUE(model.computeConservativeAabb(min, max, &materials, &edgeSizes));
+    ASSERT_EQ(nmaterials * 2, materials.count());
+    ASSERT_EQ(nmaterials, edgeSizes.count());
+    ASSERT_FLOAT_EQ(1, edgeSizes[0]);
+    const Scalar epsilon = 0.001f;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_LE(min[i], exact[nmaterials * 2][i] + epsilon);
+        ASSERT_GE(max[i], exact[nmaterials * 2 + 1][i] - epsilon);
+    }
+    for (int i = 0; i < nmaterials; i++) {
+        for (int j = 0; j < 3; j++) {
+            ASSERT_LE(materials[i * 2][j], exact[i * 2][j] + epsilon);
+            ASSERT_GE(materials[i * 2 + 1][j], exact[i * 2 + 1][j] - epsilon);
+        }
+    }
+}
+
+TEST(PMXModelTest, ReallocateMatrixBufferAfterEditing)
+{
+    Encoding encoding(0);
+    Model source(&encoding);
+    CreateSkinnedModel(source);
+    std::vector<uint8> bytes;
+    SaveModel(source, bytes);
+    Model model(&encoding);
+    ASSERT_TRUE(model.load(bytes.data(), bytes.size()));
+    IModel::IndexBuffer *indexBuffer = 0;
+    IModel::DynamicVertexBuffer *dynamicBuffer = 0;
+    IModel::MatrixBuffer *matrixBuffer = 0;
+    model.getIndexBuffer(indexBuffer);
+    model.getDynamicVertexBuffer(dynamicBuffer, indexBuffer);
+    model.getMatrixBuffer(matrixBuffer, dynamicBuffer, indexBuffer);
+    std::unique_ptr<IModel::IndexBuffer> indexBufferPtr(indexBuffer);
+    std::unique_ptr<IModel::DynamicVertexBuffer> dynamicBufferPtr(dynamicBuffer);
+    std::unique_ptr<IModel::MatrixBuffer> matrixBufferPtr(matrixBuffer);
+    ASSERT_TRUE(matrixBuffer->bytes(1, 0));
+    ASSERT_FALSE(matrixBuffer->bytes(2, 0));
+    /* splits the last material into two, adding a material rebuilds the bone palette */
+    Array<IMaterial *> materials;
+    model.getMaterialRefs(materials);
+    IMaterial::IndexRange range = materials[1]->indexRange(), splitted = range;
+    range.count = range.end - range.start - 6;
+    range.end = range.start + range.count;
+    materials[1]->setIndexRange(range);
+    splitted.start = range.end;
+    splitted.count = splitted.end - splitted.start;
+    IMaterial *material = model.createMaterial();
+    material->setIndexRange(splitted);
+    model.addMaterial(material);
+    matrixBuffer->update(0);
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(1, matrixBuffer->countSubsets(i));
+        ASSERT_TRUE(matrixBuffer->bytes(i, 0));
+        ASSERT_LT(vsize(0), matrixBuffer->size(i, 0));
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(PMXModelInstance, PMXFragmentTest, Values(1, 2, 4));
 INSTANTIATE_TEST_CASE_P(PMXModelInstance, PMXFragmentWithUVTest, Combine(Values(1, 2, 4),
                                                                          Values(pmx::Morph::kTexCoordMorph,
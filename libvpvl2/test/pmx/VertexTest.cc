@@ -127,6 +127,28 @@ TEST(PMXVertexTest, NullRef)
     ASSERT_EQ(vertex.materialRef(), Factory::sharedNullMaterialRef());
 }
 
+TEST(PMXVertexTest, ShareAttributes)
+{
+    Vertex source(0), instance(0);
+    std::unique_ptr<Bone> bone(new Bone(0));
+    source.setOrigin(Vector3(1, 2, 3));
+    source.setType(Vertex::kBdef2);
+    source.setWeight(0, 0.25);
+    instance.shareAttributes(&source);
+    ASSERT_EQ(source.origin(), instance.origin());
+    ASSERT_EQ(source.type(), instance.type());
+    ASSERT_EQ(source.weight(0), instance.weight(0));
+    /* per instance values must not be shared */
+    instance.setBoneRef(1, bone.get());
+    ASSERT_EQ(Factory::sharedNullBoneRef(), source.boneRef(1));
+    /* modifying the instance must not change the source */
+    instance.setOrigin(Vector3(4, 5, 6));
+    ASSERT_EQ(Vector3(1, 2, 3), source.origin());
+    ASSERT_EQ(Vector3(4, 5, 6), instance.origin());
+    source.setWeight(0, 0.75);
+    ASSERT_FLOAT_EQ(0.25f, instance.weight(0));
+}
+
 TEST(PMXVertexTest, PerformSkinningBdef1)
 {
     pmx::Vertex v(0);
@@ -0,0 +1,234 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * Motion format converter.
+ *
+ * Converts VMD files to MVD and MVD files to VMD. Each file is written next to the source
+ * (or into the output directory) with the extension of the other format, for example:
+ *
+ *   vpvl2_convert --output-dir converted motions/*.vmd
+ *
+ * Files are converted in parallel if Intel TBB or OpenMP is available, each job has its own
+ * encoding and factory since ICU converters cannot be shared between threads.
+ */
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/extensions/icu4c/Encoding.h>
+
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifdef VPVL2_LINK_INTEL_TBB
+#include <tbb/tbb.h>
+#endif
+
+using namespace vpvl2;
+using namespace vpvl2::extensions::icu4c;
+
+namespace {
+
+struct ConvertJob {
+    ConvertJob(const std::string &inputPath, const std::string &outputPath, IMotion::FormatType type)
+        : inputPath(inputPath),
+          outputPath(outputPath),
+          type(type),
+          result(false)
+    {
+    }
+    std::string inputPath;
+    std::string outputPath;
+    IMotion::FormatType type;
+    bool result;
+};
+
+static bool ReadFile(const std::string &path, std::vector<uint8> &bytes)
+{
+    std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+    if (stream.is_open()) {
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+    return false;
+}
+
+static bool WriteFile(const std::string &path, const std::vector<uint8> &bytes)
+{
+    std::ofstream stream(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (stream.is_open()) {
+        stream.write(reinterpret_cast<const char *>(&bytes[0]), bytes.size());
+        return stream.good();
+    }
+    return false;
+}
+
+static bool HasExtension(const std::string &path, const char *extension)
+{
+    const std::string::size_type position = path.rfind('.');
+    if (position != std::string::npos) {
+        std::string value = path.substr(position + 1);
+        for (std::string::iterator it = value.begin(); it != value.end(); ++it) {
+            *it = char(std::tolower(*it));
+        }
+        return value == extension;
+    }
+    return false;
+}
+
+static std::string ResolveOutputPath(const std::string &inputPath, const std::string &outputDirectory, const char *extension)
+{
+    std::string path = inputPath.substr(0, inputPath.rfind('.') + 1) + extension;
+    if (!outputDirectory.empty()) {
+        const std::string::size_type position = path.find_last_of("/\\");
+        path = outputDirectory + "/" + (position != std::string::npos ? path.substr(position + 1) : path);
+    }
+    return path;
+}
+
+static bool Convert(const ConvertJob &job)
+{
+    std::vector<uint8> bytes;
+    if (!ReadFile(job.inputPath, bytes)) {
+        return false;
+    }
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    Factory factory(&encoding);
+    bool ok = false;
+    IMotion *source = factory.createMotion(&bytes[0], bytes.size(), 0, ok);
+    IMotion *dest = ok ? factory.convertMotion(source, job.type) : 0;
+    if (dest) {
+        std::vector<uint8> output(dest->estimateSize());
+        dest->save(&output[0]);
+        ok = WriteFile(job.outputPath, output);
+    }
+    else {
+        ok = false;
+    }
+    delete dest;
+    delete source;
+    return ok;
+}
+
+class ParallelConvertProcessor {
+public:
+    ParallelConvertProcessor(std::vector<ConvertJob> *jobsRef)
+        : m_jobsRef(jobsRef)
+    {
+    }
+    ~ParallelConvertProcessor() {
+        m_jobsRef = 0;
+    }
+
+    inline void performConvert(int i) const {
+        ConvertJob &job = m_jobsRef->at(i);
+        job.result = Convert(job);
+    }
+#ifdef VPVL2_LINK_INTEL_TBB
+    void operator()(const tbb::blocked_range<int> &range) const {
+        for (int i = range.begin(), end = range.end(); i != end; ++i) {
+            performConvert(i);
+        }
+    }
+#endif /* VPVL2_LINK_INTEL_TBB */
+    void execute() {
+        const int njobs = int(m_jobsRef->size());
+        /*
+         * jobs share nothing but the string interner of icu4c::String, which is guarded by
+         * g_internerMutex in src/ext/String.cc (tbb::spin_mutex with TBB, otherwise SRWLOCK or
+         * pthread_mutex_t), so OpenMP threads without TBB are safe as well
+         */
+#if defined(VPVL2_LINK_INTEL_TBB)
+        tbb::parallel_for(tbb::blocked_range<int>(0, njobs, 1), *this);
+#else
+#ifdef VPVL2_ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < njobs; ++i) {
+            performConvert(i);
+        }
+#endif
+    }
+
+private:
+    std::vector<ConvertJob> *m_jobsRef;
+};
+
+} /* namespace anonymous */
+
+int main(int argc, char *argv[])
+{
+    std::vector<ConvertJob> jobs;
+    std::string outputDirectory;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+        if (arg == "--output-dir" && i + 1 < argc) {
+            outputDirectory = argv[++i];
+        }
+        else if (HasExtension(arg, "vmd")) {
+            jobs.push_back(ConvertJob(arg, ResolveOutputPath(arg, outputDirectory, "mvd"), IMotion::kMVDFormat));
+        }
+        else if (HasExtension(arg, "mvd")) {
+            jobs.push_back(ConvertJob(arg, ResolveOutputPath(arg, outputDirectory, "vmd"), IMotion::kVMDFormat));
+        }
+        else {
+            std::fprintf(stderr, "unknown motion format: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (jobs.empty()) {
+        std::fprintf(stderr, "usage: %s [--output-dir dir] motion.vmd|motion.mvd...\n", argv[0]);
+        return 1;
+    }
+    ParallelConvertProcessor processor(&jobs);
+    processor.execute();
+    int nfailed = 0;
+    for (std::vector<ConvertJob>::const_iterator it = jobs.begin(); it != jobs.end(); ++it) {
+        if (it->result) {
+            std::fprintf(stderr, "%s -> %s\n", it->inputPath.c_str(), it->outputPath.c_str());
+        }
+        else {
+            std::fprintf(stderr, "cannot convert the motion: %s\n", it->inputPath.c_str());
+            nfailed++;
+        }
+    }
+    return nfailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/**
+
+ Copyright (c) 2010-2014  hkrn
+
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+
+ - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above
+   copyright notice, this list of conditions and the following
+   disclaimer in the documentation and/or other materials provided
+   with the distribution.
+ - Neither the name of the MMDAI project team nor the names of
+   its contributors may be used to endorse or promote products
+   derived from this software without specific prior written
+   permission.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * Motion keyframe reducer.
+ *
+ * Removes redundant bone and morph keyframes of a dense motion such as motion captured one
+ * and writes the result as a VMD file, for example:
+ *
+ *   vpvl2_reduce --translation-tolerance 0.01 --orientation-tolerance 0.5 in.vmd out.vmd
+ */
+
+#include <vpvl2/vpvl2.h>
+#include <vpvl2/extensions/icu4c/Encoding.h>
+#include <vpvl2/vmd/KeyframeReducer.h>
+#include <vpvl2/vmd/Motion.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace vpvl2;
+using namespace vpvl2::extensions::icu4c;
+
+namespace {
+
+struct Options {
+    Options()
+        : translationTolerance(-1),
+          orientationTolerance(-1),
+          morphTolerance(-1),
+          inputPath(0),
+          outputPath(0)
+    {
+    }
+    float translationTolerance;
+    float orientationTolerance;
+    float morphTolerance;
+    const char *inputPath;
+    const char *outputPath;
+};
+
+static void PrintUsage(const char *argv0)
+{
+    std::fprintf(stderr,
+                 "usage: %s [options] input.vmd output.vmd\n"
+                 "  --translation-tolerance <value>  maximum bone translation error\n"
+                 "  --orientation-tolerance <degree> maximum bone orientation error\n"
+                 "  --morph-tolerance <value>        maximum morph weight error\n",
+                 argv0);
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++) {
+        const std::string arg(argv[i]);
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--translation-tolerance" && hasValue) {
+            options.translationTolerance = float(std::atof(argv[++i]));
+        }
+        else if (arg == "--orientation-tolerance" && hasValue) {
+            options.orientationTolerance = float(std::atof(argv[++i]));
+        }
+        else if (arg == "--morph-tolerance" && hasValue) {
+            options.morphTolerance = float(std::atof(argv[++i]));
+        }
+        else if (!options.inputPath) {
+            options.inputPath = argv[i];
+        }
+        else if (!options.outputPath) {
+            options.outputPath = argv[i];
+        }
+        else {
+            return false;
+        }
+    }
+    return options.inputPath && options.outputPath;
+}
+
+static bool ReadFile(const char *path, std::vector<uint8> &bytes)
+{
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if (stream.is_open()) {
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        return !bytes.empty();
+    }
+    return false;
+}
+
+static bool WriteFile(const char *path, const std::vector<uint8> &bytes)
+{
+    std::ofstream stream(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (stream.is_open()) {
+        stream.write(reinterpret_cast<const char *>(&bytes[0]), bytes.size());
+        return stream.good();
+    }
+    return false;
+}
+
+} /* namespace anonymous */
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    std::vector<uint8> bytes;
+    if (!ReadFile(options.inputPath, bytes)) {
+        std::fprintf(stderr, "cannot read the motion: %s\n", options.inputPath);
+        return 1;
+    }
+    Encoding::Dictionary dictionary;
+    Encoding encoding(&dictionary);
+    vmd::Motion motion(0, &encoding);
+    if (!motion.load(&bytes[0], bytes.size())) {
+        std::fprintf(stderr, "cannot load the motion: %s\n", options.inputPath);
+        return 1;
+    }
+    vmd::KeyframeReducer reducer;
+    if (options.translationTolerance >= 0) {
+        reducer.setTranslationTolerance(options.translationTolerance);
+    }
+    if (options.orientationTolerance >= 0) {
+        reducer.setOrientationTolerance(btRadians(options.orientationTolerance));
+    }
+    if (options.morphTolerance >= 0) {
+        reducer.setMorphWeightTolerance(options.morphTolerance);
+    }
+    if (!reducer.reduce(&motion)) {
+        std::fprintf(stderr, "cannot reduce the motion: %s\n", options.inputPath);
+        return 1;
+    }
+    std::vector<uint8> output(motion.estimateSize());
+    motion.save(&output[0]);
+    if (!WriteFile(options.outputPath, output)) {
+        std::fprintf(stderr, "cannot write the motion: %s\n", options.outputPath);
+        return 1;
+    }
+    const int source = reducer.countSourceKeyframes(), reduced = reducer.countReducedKeyframes();
+    std::fprintf(stderr, "%s: %d keyframes -> %d keyframes (%.1fx), %lu bytes -> %lu bytes\n",
+                 options.inputPath, source, reduced, reduced > 0 ? float(source) / reduced : 0.0f,
+                 static_cast<unsigned long>(bytes.size()), static_cast<unsigned long>(output.size()));
+    return 0;
+}